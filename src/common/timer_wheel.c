@@ -0,0 +1,143 @@
+// 分层时间轮实现
+#include "xsan_timer_wheel.h"
+#include "xsan_memory.h" // For XSAN_CALLOC, XSAN_FREE
+#include "../../include/xsan_error.h" // 统一错误码头文件
+
+#define XSAN_TIMER_WHEEL_SLOT_MASK (XSAN_TIMER_WHEEL_SLOTS - 1)
+
+// Level L holds timers expiring between 64^L and 64^(L+1) ticks from now. Level 0 is
+// scanned every tick; a higher-level slot is cascaded (re-inserted one level down) when
+// the level below it wraps, as in the classic kernel timer wheel.
+struct xsan_timer_wheel {
+    uint32_t tick_us;
+    uint64_t origin_us;         // Time of tick 0
+    uint64_t current_tick;      // Last tick processed
+    uint32_t armed_count;
+    xsan_timer_t *slots[XSAN_TIMER_WHEEL_LEVELS][XSAN_TIMER_WHEEL_SLOTS];
+};
+
+static void _timer_link(xsan_timer_wheel_t *wheel, xsan_timer_t *timer) {
+    uint64_t expires = timer->expires_tick;
+    uint64_t delta = (expires > wheel->current_tick) ? expires - wheel->current_tick : 0;
+    uint32_t level = 0;
+    while (level < XSAN_TIMER_WHEEL_LEVELS - 1 &&
+           delta >= (1ull << (XSAN_TIMER_WHEEL_SLOT_BITS * (level + 1)))) {
+        level++;
+    }
+    // Overdue timers go into the slot being processed now.
+    uint64_t index_tick = (delta == 0) ? wheel->current_tick : expires;
+    uint32_t slot = (uint32_t)(index_tick >> (XSAN_TIMER_WHEEL_SLOT_BITS * level)) & XSAN_TIMER_WHEEL_SLOT_MASK;
+
+    xsan_timer_t **head = &wheel->slots[level][slot];
+    timer->prev = NULL;
+    timer->next = *head;
+    if (*head) (*head)->prev = timer;
+    *head = timer;
+    timer->slot_head = head;
+}
+
+static void _timer_unlink(xsan_timer_t *timer) {
+    if (timer->prev) timer->prev->next = timer->next;
+    else *timer->slot_head = timer->next;
+    if (timer->next) timer->next->prev = timer->prev;
+    timer->prev = timer->next = NULL;
+    timer->slot_head = NULL;
+}
+
+void xsan_timer_init(xsan_timer_t *timer, xsan_timer_cb_t cb, void *cb_arg) {
+    if (!timer) return;
+    timer->prev = timer->next = NULL;
+    timer->slot_head = NULL;
+    timer->expires_tick = 0;
+    timer->cb = cb;
+    timer->cb_arg = cb_arg;
+}
+
+xsan_timer_wheel_t *xsan_timer_wheel_create(uint32_t tick_us, uint64_t now_us) {
+    if (tick_us == 0) return NULL;
+    xsan_timer_wheel_t *wheel = (xsan_timer_wheel_t *)XSAN_CALLOC(1, sizeof(xsan_timer_wheel_t));
+    if (!wheel) return NULL;
+    wheel->tick_us = tick_us;
+    wheel->origin_us = now_us;
+    return wheel;
+}
+
+void xsan_timer_wheel_destroy(xsan_timer_wheel_t *wheel) {
+    if (!wheel) return;
+    XSAN_FREE(wheel);
+}
+
+xsan_error_t xsan_timer_wheel_arm(xsan_timer_wheel_t *wheel, xsan_timer_t *timer, uint64_t timeout_us) {
+    if (!wheel || !timer || !timer->cb) return XSAN_ERROR_INVALID_PARAM;
+    if (timer->slot_head) {
+        _timer_unlink(timer);
+        wheel->armed_count--;
+    }
+    // Rounded up without adding first, which would wrap for timeouts near UINT64_MAX.
+    uint64_t ticks = timeout_us / wheel->tick_us + (timeout_us % wheel->tick_us != 0);
+    if (ticks == 0) ticks = 1;
+    if (ticks > XSAN_TIMER_WHEEL_MAX_TICKS) ticks = XSAN_TIMER_WHEEL_MAX_TICKS;
+    timer->expires_tick = wheel->current_tick + ticks;
+    _timer_link(wheel, timer);
+    wheel->armed_count++;
+    return XSAN_OK;
+}
+
+bool xsan_timer_wheel_cancel(xsan_timer_wheel_t *wheel, xsan_timer_t *timer) {
+    if (!wheel || !timer || !timer->slot_head) return false;
+    _timer_unlink(timer);
+    wheel->armed_count--;
+    return true;
+}
+
+// Re-inserts every timer of one higher-level slot relative to the current tick.
+static void _timer_wheel_cascade(xsan_timer_wheel_t *wheel, uint32_t level) {
+    uint32_t slot = (uint32_t)(wheel->current_tick >> (XSAN_TIMER_WHEEL_SLOT_BITS * level)) & XSAN_TIMER_WHEEL_SLOT_MASK;
+    xsan_timer_t *list = wheel->slots[level][slot];
+    wheel->slots[level][slot] = NULL;
+    while (list) {
+        xsan_timer_t *timer = list;
+        list = timer->next;
+        _timer_link(wheel, timer);
+    }
+}
+
+static uint32_t _timer_wheel_run_tick(xsan_timer_wheel_t *wheel) {
+    uint64_t tick = wheel->current_tick;
+    for (uint32_t level = 1; level < XSAN_TIMER_WHEEL_LEVELS; ++level) {
+        if ((tick & ((1ull << (XSAN_TIMER_WHEEL_SLOT_BITS * level)) - 1)) != 0) break;
+        _timer_wheel_cascade(wheel, level);
+    }
+
+    uint32_t fired = 0;
+    xsan_timer_t **head = &wheel->slots[0][tick & XSAN_TIMER_WHEEL_SLOT_MASK];
+    // Pop one at a time: a callback may cancel or re-arm any timer, including others in this slot.
+    while (*head) {
+        xsan_timer_t *timer = *head;
+        _timer_unlink(timer);
+        wheel->armed_count--;
+        fired++;
+        timer->cb(timer, timer->cb_arg);
+    }
+    return fired;
+}
+
+uint32_t xsan_timer_wheel_advance(xsan_timer_wheel_t *wheel, uint64_t now_us) {
+    if (!wheel || now_us < wheel->origin_us) return 0;
+    uint64_t target = (now_us - wheel->origin_us) / wheel->tick_us;
+    uint32_t fired = 0;
+    while (wheel->current_tick < target) {
+        if (wheel->armed_count == 0) {
+            // Nothing can fire; skip the idle ticks instead of walking them.
+            wheel->current_tick = target;
+            break;
+        }
+        wheel->current_tick++;
+        fired += _timer_wheel_run_tick(wheel);
+    }
+    return fired;
+}
+
+uint32_t xsan_timer_wheel_count(const xsan_timer_wheel_t *wheel) {
+    return wheel ? wheel->armed_count : 0;
+}
@@ -74,15 +74,10 @@ xsan_error_t xsan_spdk_manager_opts_init(const char *app_name,
                                          const char *reactor_mask,
                                          bool enable_rpc,
                                          const char *rpc_addr) {
-    // 参数校验优先
-    if (!app_name || !spdk_conf_file) {
-        XSAN_LOG_ERROR("SPDK manager opts init: missing app_name or conf_file");
-        return XSAN_ERROR_CONFIG_PARSE;
-    }
-    // 初始化 opts 结构体
+    // 初始化 opts 结构体 (app_name 与 spdk_conf_file 均可为 NULL, 见头文件说明)
     spdk_app_opts_init(&g_xsan_spdk_app_opts, sizeof(g_xsan_spdk_app_opts));
     g_xsan_spdk_opts_customized = true;
-    g_xsan_spdk_app_opts.name = app_name;
+    g_xsan_spdk_app_opts.name = app_name ? app_name : "xsan_default_app";
     g_xsan_spdk_app_opts.json_config_file = spdk_conf_file;
     if (reactor_mask) {
         g_xsan_spdk_app_opts.reactor_mask = reactor_mask;
@@ -92,10 +87,20 @@ xsan_error_t xsan_spdk_manager_opts_init(const char *app_name,
     } else {
         g_xsan_spdk_app_opts.rpc_addr = NULL;
     }
-    XSAN_LOG_INFO("SPDK manager opts initialized: %s, conf: %s", app_name, spdk_conf_file);
+    XSAN_LOG_INFO("SPDK manager opts initialized: %s, conf: %s", g_xsan_spdk_app_opts.name,
+                  spdk_conf_file ? spdk_conf_file : "(none)");
     return XSAN_OK;
 }
 
+void xsan_spdk_manager_set_shutdown_cb(xsan_spdk_app_shutdown_fn_t shutdown_fn) {
+    if (!g_xsan_spdk_opts_customized) {
+        spdk_app_opts_init(&g_xsan_spdk_app_opts, sizeof(g_xsan_spdk_app_opts));
+        g_xsan_spdk_app_opts.name = "xsan_default_app";
+        g_xsan_spdk_opts_customized = true;
+    }
+    g_xsan_spdk_app_opts.shutdown_cb = shutdown_fn;
+}
+
 xsan_error_t xsan_spdk_manager_start_app(xsan_spdk_app_start_fn_t start_fn, void *fn_arg) {
     if (!g_xsan_spdk_opts_customized) {
         XSAN_LOG_INFO("SPDK options not explicitly customized by xsan_spdk_manager_opts_init(), using defaults.");
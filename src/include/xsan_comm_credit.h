@@ -0,0 +1,116 @@
+#ifndef XSAN_COMM_CREDIT_H
+#define XSAN_COMM_CREDIT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Credit accounting behind node comm's flow control (XSAN_COMM_FEATURE_FLOW_CONTROL). Both
+// sides count every message except node comm's own from the start of the connection, and
+// grants carry cumulative limits, so a late or repeated grant is harmless.
+
+/**
+ * @brief Receive-side released totals of one connection. Payloads give their credit back when
+ * they are freed, possibly on another thread and after the connection is gone, so the totals
+ * are refcounted: the connection holds one reference and every payload still holding credit
+ * holds another.
+ */
+typedef struct xsan_comm_credit_acct {
+    uint32_t refs;
+    uint64_t released_bytes;    ///< Payload bytes of counted messages freed so far (atomic)
+    uint64_t released_msgs;     ///< Counted messages freed so far (atomic)
+} xsan_comm_credit_acct_t;
+
+/**
+ * @brief Credit held by one received payload; acct is NULL once released or if none was charged.
+ */
+typedef struct {
+    xsan_comm_credit_acct_t *acct;
+    uint32_t bytes;
+} xsan_comm_rx_credit_t;
+
+/**
+ * @brief Receive side of one connection: the window granted to the peer and the last grant sent.
+ */
+typedef struct {
+    xsan_comm_credit_acct_t *acct;
+    uint32_t window_bytes;      ///< Windows granted to the peer, fixed when flow control starts
+    uint32_t window_msgs;
+    uint64_t granted_bytes;     ///< Limits of the last grant queued to the peer
+    uint64_t granted_msgs;
+} xsan_comm_credit_rx_t;
+
+/**
+ * @brief Send side of one connection: the peer's latest grant and what has been admitted against it.
+ */
+typedef struct {
+    uint64_t bytes_limit;
+    uint64_t msgs_limit;
+    uint64_t bytes;             ///< Admitted for sending so far
+    uint64_t msgs;
+} xsan_comm_credit_tx_t;
+
+/**
+ * @brief Allocates released totals holding one reference for the caller.
+ * @return The totals, or NULL on allocation failure.
+ */
+xsan_comm_credit_acct_t *xsan_comm_credit_acct_create(void);
+
+/**
+ * @brief Drops one reference, freeing the totals with the last. NULL is ignored.
+ */
+void xsan_comm_credit_acct_put(xsan_comm_credit_acct_t *acct);
+
+/**
+ * @brief Counts a received message of payload_length bytes. If credit is not NULL it holds the
+ * charge (and a reference on acct) until xsan_comm_credit_rx_release; otherwise the message is
+ * released at once.
+ */
+void xsan_comm_credit_rx_charge(xsan_comm_credit_acct_t *acct, uint32_t payload_length,
+                                xsan_comm_rx_credit_t *credit);
+
+/**
+ * @brief Gives back the credit held by a payload. Safe on any thread and to call twice.
+ */
+void xsan_comm_credit_rx_release(xsan_comm_rx_credit_t *credit);
+
+/**
+ * @brief Whether enough credit has been released since the last grant to send a new one: a
+ * quarter of either window, so grants stay infrequent while the peer never runs dry.
+ *
+ * @param rx The receive side.
+ * @param bytes_limit Receives the byte limit to grant.
+ * @param msgs_limit Receives the message limit to grant.
+ * @return true if a grant is due. The caller records it with xsan_comm_credit_rx_granted once queued.
+ */
+bool xsan_comm_credit_rx_grant_due(const xsan_comm_credit_rx_t *rx, uint64_t *bytes_limit, uint64_t *msgs_limit);
+
+/**
+ * @brief Records the limits of a grant queued to the peer.
+ */
+void xsan_comm_credit_rx_granted(xsan_comm_credit_rx_t *rx, uint64_t bytes_limit, uint64_t msgs_limit);
+
+/**
+ * @brief Whether the peer's latest grant covers one more message of len payload bytes on top
+ * of everything admitted so far.
+ */
+bool xsan_comm_credit_tx_covers(const xsan_comm_credit_tx_t *tx, uint32_t len);
+
+/**
+ * @brief Admits one message of len payload bytes against the peer's grant.
+ */
+void xsan_comm_credit_tx_consume(xsan_comm_credit_tx_t *tx, uint32_t len);
+
+/**
+ * @brief Applies a grant from the peer. Limits are cumulative, so a stale grant never lowers them.
+ */
+void xsan_comm_credit_tx_apply_grant(xsan_comm_credit_tx_t *tx, uint64_t bytes_limit, uint64_t msgs_limit);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // XSAN_COMM_CREDIT_H
@@ -0,0 +1,65 @@
+#ifndef XSAN_COMPRESS_H
+#define XSAN_COMPRESS_H
+
+#include "xsan_types.h"
+#include "../../include/xsan_error.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Returns true if this build can compress and decompress payloads (built with LZ4).
+ * Without LZ4 every function below fails cleanly and node comm never offers compression.
+ */
+bool xsan_compress_available(void);
+
+/**
+ * @brief Estimates from a sample of the data whether compressing it is worthwhile.
+ * Looks at how many distinct byte values the sample uses and how evenly they are spread:
+ * data that uses nearly all 256 values uniformly (encrypted, random or already compressed)
+ * is rejected without running the compressor. Cost is independent of len beyond the sample.
+ *
+ * @param data The data.
+ * @param len Length of data in bytes.
+ * @return true if the data looks compressible.
+ */
+bool xsan_compress_worth_trying(const void *data, size_t len);
+
+/**
+ * @brief Returns the largest compressed size xsan_compress_lz4 can produce for len input bytes,
+ * or 0 if len is too large to compress.
+ */
+size_t xsan_compress_bound(size_t len);
+
+/**
+ * @brief Compresses src into dst as one LZ4 block.
+ *
+ * @param src Input data.
+ * @param len Input length in bytes.
+ * @param dst Output buffer.
+ * @param dst_cap Capacity of dst; compression fails if the result does not fit.
+ * @return The compressed size, or 0 if compression failed or the result did not fit.
+ */
+size_t xsan_compress_lz4(const void *src, size_t len, void *dst, size_t dst_cap);
+
+/**
+ * @brief Decompresses one LZ4 block that must expand to exactly dst_len bytes.
+ *
+ * @param src Compressed data.
+ * @param len Compressed length in bytes.
+ * @param dst Output buffer of dst_len bytes.
+ * @param dst_len Expected decompressed length.
+ * @return XSAN_OK, XSAN_ERROR_UNSUPPORTED if built without LZ4, or XSAN_ERROR_INVALID_PARAM
+ *         if the input is malformed or does not expand to dst_len bytes.
+ */
+xsan_error_t xsan_decompress_lz4(const void *src, size_t len, void *dst, size_t dst_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // XSAN_COMPRESS_H
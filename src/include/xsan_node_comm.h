@@ -10,6 +10,7 @@
 // Forward declaration for SPDK socket types
 struct spdk_sock;
 struct spdk_sock_group; // May not be needed in public header if managed internally
+struct xsan_connection_ctx; // Opaque; see xsan_node_comm_conn_get_sock
 
 #ifdef __cplusplus
 extern "C" {
@@ -56,9 +57,11 @@ typedef void (*xsan_node_connect_cb_t)(struct spdk_sock *sock, int status, void
 
 /**
  * @brief Callback invoked after a send operation (initiated by xsan_node_comm_send_msg) completes.
- * This indicates that the data has been passed to the socket's send buffer or an error occurred.
+ * This indicates that the last byte of the message has been passed to the socket's send buffer,
+ * or that the message was dropped because the connection failed or was closed.
  *
- * @param status 0 on success (all data written to socket send buffer), or a negative errno on failure.
+ * @param status 0 on success (all data written to socket send buffer), or a negative errno on failure
+ *               (-ECONNRESET if the connection was closed with the message still queued).
  * @param send_cb_arg User-provided context argument originally passed to xsan_node_comm_send_msg.
  */
 typedef void (*xsan_node_send_cb_t)(int status, void *send_cb_arg);
@@ -70,9 +73,12 @@ typedef void (*xsan_node_send_cb_t)(int status, void *send_cb_arg);
  * @brief Initializes the XSAN Node Communication module.
  * This function must be called from an SPDK reactor thread after SPDK has been initialized
  * (e.g., after xsan_spdk_manager_start_app calls its main callback).
- * It sets up the necessary SPDK socket infrastructure, including creating a socket group
- * and a poller for processing socket events on the current SPDK reactor.
- * If listen_ip and listen_port are provided, it also creates a listening socket.
+ * Every SPDK thread that owns connections gets its own socket group and poller: the calling
+ * thread's is created here, one per core for the other existing threads is created
+ * asynchronously, and any other thread gets one the first time it connects. A connection is
+ * owned by one reactor and is only polled, sent on and closed there, so sends need no locking.
+ * If listen_ip and listen_port are provided, it also creates a listening socket, polled on the
+ * calling reactor; accepted connections are handed to the reactors round-robin.
  *
  * @param listen_ip IP address (e.g., "0.0.0.0") to listen on for incoming connections.
  *                  If NULL, the node will not listen for incoming connections (client-only mode).
@@ -103,7 +109,8 @@ xsan_error_t xsan_node_comm_register_message_handler(xsan_message_type_t type,
 /**
  * @brief Finalizes and cleans up the XSAN Node Communication module.
  * Closes all active connections, the listening socket (if any), and frees associated SPDK resources.
- * Must be called from an SPDK reactor thread during application shutdown.
+ * Must be called from the SPDK thread that called xsan_node_comm_init, during application shutdown.
+ * Connections owned by other reactors are closed asynchronously on their own threads.
  */
 void xsan_node_comm_fini(void);
 
@@ -112,47 +119,318 @@ void xsan_node_comm_fini(void);
 
 /**
  * @brief Asynchronously connects to a remote XSAN node.
- * The result of the connection attempt (success or failure) is reported via the `connect_cb`.
- * This function must be called from an SPDK reactor thread.
+ * The result of the connection attempt (success or failure) is reported via the `connect_cb`,
+ * which runs on the calling thread after this function has returned.
+ * This function must be called from an SPDK reactor thread. The new connection is owned by
+ * that thread's reactor, so each reactor that talks to a peer ends up with its own connection.
+ * Connects are coalesced per reactor and peer: if the reactor already has a connection to the
+ * peer, no new one is opened, and every caller waiting on the same connection gets its callback
+ * from one completion. After a failed attempt, further connects to that peer fail immediately
+ * for a short hold-off period instead of each blocking in connect.
  *
  * @param target_ip IP address string of the remote node to connect to.
  * @param target_port Port number of the remote node.
  * @param connect_cb Callback function to be invoked upon connection completion or failure. Must not be NULL.
  * @param cb_arg User context argument for the `connect_cb`.
  * @return XSAN_OK if the connection attempt was successfully initiated.
- *         An xsan_error_t code on immediate failure (e.g., invalid parameters, SPDK socket creation error).
+ *         An xsan_error_t code on immediate failure (e.g., invalid parameters, SPDK socket creation error),
+ *         in which case `connect_cb` is not invoked.
  */
 xsan_error_t xsan_node_comm_connect(const char *target_ip, uint16_t target_port,
                                     xsan_node_connect_cb_t connect_cb, void *cb_arg);
 
+/**
+ * @brief Returns the calling reactor's connection to a peer, if it has one.
+ * Only connections this reactor opened with xsan_node_comm_connect are considered; a
+ * connection owned by another reactor is never returned, since it cannot be sent on here.
+ * The lookup is a hash of (ip, port) in the reactor's peer table and takes no locks.
+ *
+ * @param target_ip IP address string of the peer, as given to xsan_node_comm_connect.
+ * @param target_port Port number of the peer.
+ * @return The connected socket, or NULL if this reactor has no connection to the peer
+ *         (the caller should then connect).
+ */
+struct spdk_sock *xsan_node_comm_get_active_connection(const char *target_ip, uint16_t target_port);
+
+/**
+ * @brief Returns the socket of the connection a message was received on, for replying to it
+ * from a xsan_specific_message_handler_cb_t. Replies must be sent on the thread the handler ran on.
+ *
+ * @param conn_ctx Connection context passed to the handler.
+ * @return The connection's socket, or NULL if conn_ctx is NULL.
+ */
+struct spdk_sock *xsan_node_comm_conn_get_sock(struct xsan_connection_ctx *conn_ctx);
+
+/**
+ * @brief Returns the "ip:port" string of the peer of a connection, for logging.
+ *
+ * @param conn_ctx Connection context passed to a message handler.
+ * @return The peer address, or "unknown" if conn_ctx is NULL.
+ */
+const char *xsan_node_comm_conn_get_peer(const struct xsan_connection_ctx *conn_ctx);
+
+/**
+ * @brief Opens connections to a peer ahead of the first I/O.
+ * Every reactor that does not yet have a connection to the peer connects to it on its own
+ * thread. Completes asynchronously; failures are only logged, and I/O still connects on demand.
+ * Must be called from an SPDK thread.
+ *
+ * @param target_ip IP address string of the peer.
+ * @param target_port Port number of the peer.
+ * @return XSAN_OK if the warm-up was started, or an error code on bad parameters,
+ *         when the module is not initialized, or on allocation failure.
+ */
+xsan_error_t xsan_node_comm_warm_up(const char *target_ip, uint16_t target_port);
+
 
 // --- Data Transfer Operations ---
 
 /**
  * @brief Asynchronously sends an xsan_message_t to a connected peer.
- * The message (header and payload) will be serialized and sent over the socket.
+ * The header is copied and the message is appended to the connection's send queue. Messages on
+ * one connection are written in the order they were queued; all messages queued during the same
+ * reactor event are flushed together with a single writev, and a partial write resumes where it
+ * stopped on the next poll. On connections that negotiated protocol v2 the flush also packs the
+ * queued messages into shared frames. `send_cb` fires once the message's last byte has been written.
  * The `xsan_message_t` structure itself (passed as `msg`) is NOT freed by this function;
- * the caller retains ownership and should decide when to free it, typically after the `send_cb`
- * indicates completion or based on the `send_cb` status.
- * This function must be called from an SPDK reactor thread.
+ * the caller retains ownership, and `msg` and its payload must stay valid until `send_cb` is invoked
+ * (the payload is sent in place, not copied).
+ * This function must be called from the SPDK reactor thread that owns the connection.
  *
  * @param sock The SPDK socket representing the connection to the peer. Must be a valid, connected socket.
  * @param msg Pointer to the `xsan_message_t` to send. The header should be correctly populated
- *            (e.g., with type, payload_length, transaction_id). The checksum will be calculated
- *            by this function before sending if not already set.
+ *            (e.g., with type, payload_length, transaction_id). The checksum field is overwritten:
+ *            with the CRC32C of header and payload if the connection negotiated it and still
+ *            speaks v1, otherwise 0 (v2 checksums cover whole frames).
  * @param send_cb Callback to notify upon send completion or failure. Can be NULL if a "fire-and-forget"
  *                approach is acceptable (not generally recommended for reliable messaging).
  * @param cb_arg User context argument for the `send_cb`.
- * @return XSAN_OK if the message was successfully queued for sending by SPDK.
- *         An xsan_error_t code on immediate failure (e.g., invalid parameters, socket error, serialization error).
+ * @return XSAN_OK if the message was queued for sending.
+ *         XSAN_ERROR_BUSY if the connection's send queue is full.
+ *         XSAN_ERROR_THREAD_CONTEXT if called off the connection's owning reactor.
+ *         Another xsan_error_t code on immediate failure (e.g., invalid parameters, serialization error).
+ *         In both error cases `send_cb` is not invoked.
  */
 xsan_error_t xsan_node_comm_send_msg(struct spdk_sock *sock, xsan_message_t *msg,
                                      xsan_node_send_cb_t send_cb, void *cb_arg);
 
+/**
+ * @brief Sets whether this node offers CRC32C message integrity on new connections.
+ * Each side advertises its features (XSAN_MSG_TYPE_COMM_FEATURES) when a connection is
+ * established; CRC32C is computed on a connection's outgoing messages once both sides
+ * have offered it (per message on v1 connections, per frame on v2). Received messages and
+ * frames carrying a non-zero checksum are always verified,
+ * and a mismatch closes the connection. Offered by default.
+ *
+ * @param enable true to offer CRC32C, false to stop offering it.
+ */
+void xsan_node_comm_set_crc32c(bool enable);
+
+/**
+ * @brief Sets whether this node offers multi-message frames on new connections.
+ * When both sides of a v2 connection offer it, messages queued together are sent in one
+ * frame with a single frame header (and checksum); otherwise each v2 frame carries one
+ * message. Received frames may always carry several messages. Offered by default.
+ *
+ * @param enable true to offer frame batching, false to stop offering it.
+ */
+void xsan_node_comm_set_frame_batching(bool enable);
+
+/**
+ * @brief Sets the highest protocol version this node advertises on new connections.
+ * A connection starts out in v1 and each side switches its sends to the lower of the two
+ * advertised versions once it has the peer's handshake, so nodes of different versions
+ * interoperate during a rolling upgrade. Received frames are accepted in any supported
+ * format regardless of this setting. Defaults to XSAN_PROTOCOL_VERSION.
+ *
+ * @param version XSAN_PROTOCOL_VERSION_1 .. XSAN_PROTOCOL_VERSION.
+ * @return XSAN_OK, or XSAN_ERROR_INVALID_PARAM for an unsupported version.
+ */
+xsan_error_t xsan_node_comm_set_max_protocol_version(uint16_t version);
+
+// --- Flow control ---
+
+/** Default receive window per connection, in payload bytes (two maximum-size messages). */
+#define XSAN_NODE_COMM_FLOW_DEFAULT_WINDOW_BYTES (2u * XSAN_PROTOCOL_MAX_PAYLOAD_SIZE)
+
+/** Default receive window per connection, in messages. */
+#define XSAN_NODE_COMM_FLOW_DEFAULT_WINDOW_MSGS 1024
+
+/**
+ * @brief Configures credit-based flow control for new connections.
+ * When both sides offer XSAN_COMM_FEATURE_FLOW_CONTROL, each receiver grants its peer credit
+ * for window_bytes payload bytes and window_msgs messages beyond what it has already released.
+ * A received message holds its credit until its payload is freed (xsan_protocol_message_destroy,
+ * typically once the local write has completed); freed credit is granted back to the peer in
+ * XSAN_MSG_TYPE_COMM_CREDIT messages. A sender without credit keeps further messages queued
+ * (xsan_node_comm_send_msg still accepts them up to the send queue depth), so the payload
+ * memory a peer can pin on this node is bounded by the window. Offered by default with the
+ * XSAN_NODE_COMM_FLOW_DEFAULT_* windows.
+ *
+ * @param enable true to offer flow control, false to stop offering it (the windows are then ignored).
+ * @param window_bytes Receive window in payload bytes; at least XSAN_PROTOCOL_MAX_PAYLOAD_SIZE
+ *                     so that any single message can be admitted.
+ * @param window_msgs Receive window in messages; must be non-zero.
+ * @return XSAN_OK, or XSAN_ERROR_INVALID_PARAM if enable is set and a window is too small.
+ */
+xsan_error_t xsan_node_comm_set_flow_control(bool enable, uint32_t window_bytes, uint32_t window_msgs);
+
+// --- Polling ---
+
+/** Default time a reactor keeps busy-polling after its last network activity. */
+#define XSAN_NODE_COMM_POLL_DEFAULT_BUSY_WINDOW_US 2000
+
+/** Default first poll interval once a reactor goes idle; doubled on every empty poll. */
+#define XSAN_NODE_COMM_POLL_DEFAULT_BACKOFF_MIN_US 8
+
+/** Default longest poll interval of an idle reactor. */
+#define XSAN_NODE_COMM_POLL_DEFAULT_BACKOFF_MAX_US 1000
+
+/**
+ * @brief State of a reactor's node-comm poller.
+ */
+typedef enum {
+    XSAN_NODE_COMM_POLL_BUSY = 0,   ///< Polling on every reactor iteration
+    XSAN_NODE_COMM_POLL_BACKOFF,    ///< Idle; polling at an exponentially growing interval
+    XSAN_NODE_COMM_POLL_PARKED,     ///< Idle for long; on a timed poller with period backoff_max_us
+} xsan_node_comm_poll_mode_t;
+
+/**
+ * @brief Tuning for the adaptive node-comm pollers.
+ * A reactor busy-polls its sock group while it has traffic, outstanding requests (see
+ * xsan_node_comm_set_poll_busy_hint) or traffic within busy_window_us. After that it backs
+ * off, doubling the poll interval from backoff_min_us up to backoff_max_us. Any activity
+ * returns it to busy polling. Setting backoff_max_us to 0 busy-polls all the time.
+ */
+typedef struct xsan_node_comm_poll_opts {
+    uint32_t busy_window_us;            ///< Busy-poll this long after the last activity
+    uint32_t backoff_min_us;            ///< First idle poll interval
+    uint32_t backoff_max_us;            ///< Longest idle poll interval; 0 disables backoff
+    uint32_t park_after_us;             ///< Idle time before parking the poller; 0 never parks
+} xsan_node_comm_poll_opts_t;
+
+/**
+ * @brief Polling counters of one reactor. Read without synchronization, so values taken
+ * while the reactor is running are approximate. The busy ratio of a poller is
+ * busy_polls / (busy_polls + idle_polls).
+ */
+typedef struct xsan_node_comm_poll_stats {
+    uint32_t core;                      ///< Core the reactor was registered on
+    xsan_node_comm_poll_mode_t mode;    ///< Current poller state
+    uint64_t busy_polls;                ///< Polls that found socket events or unsent data
+    uint64_t idle_polls;                ///< Polls that found nothing to do
+    uint64_t skipped_polls;             ///< Poller runs skipped while backing off
+    uint64_t busy_us;                   ///< Time spent in XSAN_NODE_COMM_POLL_BUSY
+    uint64_t idle_us;                   ///< Time spent backing off or parked
+    uint64_t parks;                     ///< Times the poller was parked
+} xsan_node_comm_poll_stats_t;
+
+/**
+ * @brief Returns true while the calling reactor expects network traffic (e.g. it has
+ * requests awaiting responses). Called on the reactor's own thread.
+ */
+typedef bool (*xsan_node_comm_poll_busy_fn_t)(void *arg);
+
+/**
+ * @brief Fills opts with the default polling parameters.
+ * @param opts Options to initialize. If NULL, the function does nothing.
+ */
+void xsan_node_comm_poll_opts_init(xsan_node_comm_poll_opts_t *opts);
+
+/**
+ * @brief Sets the polling parameters of every reactor. Takes effect on each reactor's next
+ * poll. Call after xsan_node_comm_init (which resets them to the defaults).
+ *
+ * Parking re-registers an idle reactor's poller as a timed poller with period
+ * backoff_max_us, so the reactor runs other pollers or sleeps between polls instead of
+ * checking its sockets on every iteration. Parking is timer-driven only: socket readiness
+ * does not wake a parked reactor. Sending from it, or traffic seen by its timed poll,
+ * returns it to busy polling. Received data therefore waits up to the current backoff
+ * interval (at most backoff_max_us) on a backed-off reactor, and up to backoff_max_us on
+ * a parked one, before it is read.
+ *
+ * @param opts The parameters. Must not be NULL.
+ * @return XSAN_OK, XSAN_ERROR_NOT_INITIALIZED if the module is not initialized, or
+ *         XSAN_ERROR_INVALID_PARAM if backoff_min_us exceeds a non-zero backoff_max_us.
+ */
+xsan_error_t xsan_node_comm_set_poll_opts(const xsan_node_comm_poll_opts_t *opts);
+
+/**
+ * @brief Registers a function that keeps reactors busy-polling while it returns true.
+ * Each reactor calls it on its own thread before backing off. Pass NULL to clear it.
+ * xsan_node_comm_fini clears it as well.
+ *
+ * @param fn The hint function, or NULL.
+ * @param arg Argument for fn.
+ */
+void xsan_node_comm_set_poll_busy_hint(xsan_node_comm_poll_busy_fn_t fn, void *arg);
+
+/**
+ * @brief Returns the number of reactors that own node-comm connections.
+ */
+uint32_t xsan_node_comm_get_num_reactors(void);
+
+/**
+ * @brief Gets the polling counters of one reactor.
+ *
+ * @param index Reactor index, below xsan_node_comm_get_num_reactors().
+ * @param stats_out Output structure. Must not be NULL.
+ * @return XSAN_OK, XSAN_ERROR_INVALID_PARAM if stats_out is NULL, or XSAN_ERROR_NOT_FOUND
+ *         if index is out of range.
+ */
+xsan_error_t xsan_node_comm_get_poll_stats(uint32_t index, xsan_node_comm_poll_stats_t *stats_out);
+
+// --- Compression ---
+
+/** Default smallest payload node comm tries to compress. */
+#define XSAN_NODE_COMM_COMPRESS_DEFAULT_MIN_BYTES 4096
+
+/**
+ * @brief Compression counters of one reactor, covering the connections it owns. The achieved
+ * ratio is tx_wire_bytes / tx_raw_bytes (and rx_wire_bytes / rx_raw_bytes for the peers' sends).
+ */
+typedef struct {
+    uint64_t tx_compressed_msgs;        ///< Payloads sent compressed
+    uint64_t tx_raw_bytes;              ///< Original size of the payloads sent compressed
+    uint64_t tx_wire_bytes;             ///< Their size on the wire
+    uint64_t tx_skipped_entropy;        ///< Payloads sent raw because their sample looked incompressible
+    uint64_t tx_skipped_no_gain;        ///< Payloads compressed but sent raw because they did not shrink enough
+    uint64_t tx_compress_us;            ///< CPU time spent sampling and compressing, including attempts that did not pay off
+    uint64_t rx_decompressed_msgs;      ///< Compressed payloads received
+    uint64_t rx_wire_bytes;             ///< Their size on the wire
+    uint64_t rx_raw_bytes;              ///< Their size after decompression
+    uint64_t rx_decompress_us;          ///< CPU time spent decompressing
+} xsan_node_comm_compress_stats_t;
+
+/**
+ * @brief Sets whether this node offers LZ4 payload compression on new connections.
+ * On v2 connections where both sides offer it, payloads of at least min_bytes (except node
+ * comm's own messages) are LZ4-compressed before sending. Payloads whose sample looks
+ * incompressible are sent raw without running the compressor, and so are payloads that do
+ * not shrink by at least an eighth. Received compressed payloads are always decompressed,
+ * into the same kind of buffer an uncompressed payload would have used, so handlers never see
+ * the difference. Not offered by default.
+ *
+ * @param enable true to offer compression, false to stop offering it.
+ * @param min_bytes Smallest payload to compress (ignored when disabling).
+ * @return XSAN_OK, or XSAN_ERROR_UNSUPPORTED if enable is set and this build has no LZ4.
+ */
+xsan_error_t xsan_node_comm_set_compression(bool enable, uint32_t min_bytes);
+
+/**
+ * @brief Gets the compression counters of one reactor.
+ *
+ * @param index Reactor index, below xsan_node_comm_get_num_reactors().
+ * @param stats_out Output structure. Must not be NULL.
+ * @return XSAN_OK, XSAN_ERROR_INVALID_PARAM if stats_out is NULL, or XSAN_ERROR_NOT_FOUND
+ *         if index is out of range.
+ */
+xsan_error_t xsan_node_comm_get_compress_stats(uint32_t index, xsan_node_comm_compress_stats_t *stats_out);
+
 /**
  * @brief Closes a specific connection represented by an SPDK socket.
  * This should be called when a connection is no longer needed or if an error occurs
- * that requires closing the connection.
+ * that requires closing the connection. Must be called on the reactor that owns the connection.
  *
  * @param sock The SPDK socket to close. The socket will be set to NULL after closing.
  *             If sock or *sock is NULL, the function does nothing.
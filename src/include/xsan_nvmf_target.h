@@ -10,13 +10,58 @@
 extern "C" {
 #endif
 
+struct xsan_volume_manager;
+
+/// Namespaces the default subsystem can hold when xsan_nvmf_target_opts_t::max_namespaces is 0.
+#define XSAN_NVMF_TARGET_DEFAULT_MAX_NAMESPACES 1024
+/// Exported volumes are backed by an XSAN vbdev named this prefix followed by the volume UUID.
+#define XSAN_NVMF_VOLUME_BDEV_PREFIX "xsan_vol_"
+
+/**
+ * @brief Transport and placement tuning for the NVMe-oF target.
+ * Numeric fields left at 0 keep SPDK's TCP transport default. The target runs one poll group
+ * per core in poll_group_mask, and SPDK hands each new qpair to the groups round-robin, so
+ * connections (and the I/O queues of one host) spread over those reactors.
+ */
+typedef struct xsan_nvmf_target_opts {
+    char poll_group_mask[64];           ///< Hex core mask for poll groups, e.g. "0xF"; empty uses every reactor
+    uint32_t max_queue_depth;           ///< Entries per I/O queue
+    uint32_t max_qpairs_per_ctrlr;      ///< Admin queue plus I/O queues a host may create
+    uint32_t in_capsule_data_size;      ///< Write data carried in the command capsule; multiple of 16
+    uint32_t io_unit_size;              ///< Size of the transport's data buffers
+    uint32_t max_io_size;               ///< Largest I/O; must be a multiple of io_unit_size
+    uint32_t num_shared_buffers;        ///< Data buffers shared by all poll groups
+    uint32_t buf_cache_size;            ///< Buffers each poll group keeps for itself
+    bool zcopy_send;                    ///< Turn on MSG_ZEROCOPY for accepted posix sockets (process-wide);
+                                        ///< false keeps the sock layer's setting
+    uint32_t max_namespaces;            ///< Namespaces in the default subsystem; 0 uses
+                                        ///< XSAN_NVMF_TARGET_DEFAULT_MAX_NAMESPACES
+} xsan_nvmf_target_opts_t;
+
+/**
+ * @brief Fills opts with the defaults: every reactor, SPDK's transport defaults, no zero-copy.
+ * @param opts Options to initialize. If NULL, the function does nothing.
+ */
+void xsan_nvmf_target_opts_init(xsan_nvmf_target_opts_t *opts);
+
+/**
+ * @brief Sets the options used by the next xsan_nvmf_target_init.
+ * @param opts The options. Must not be NULL.
+ * @return XSAN_OK, XSAN_ERROR_INVALID_PARAM if a field is out of range, or XSAN_ERROR_BUSY
+ *         if the target is already running.
+ */
+xsan_error_t xsan_nvmf_target_set_opts(const xsan_nvmf_target_opts_t *opts);
+
 /**
  * @brief Initializes the XSAN NVMe-oF Target subsystem.
  * This function should be called once from an SPDK reactor thread after
  * SPDK has fully started and core XSAN modules (like volume manager for bdev access)
  * are ready.
  *
- * It will create default NVMe-oF transports (e.g., TCP) and a default target.
+ * It creates the TCP transport with the options from xsan_nvmf_target_set_opts, one poll
+ * group per configured core, and a default subsystem. The poll group on the calling core
+ * runs on the calling thread; the others get their own SPDK threads. Returns once all poll
+ * groups exist and the transport is attached to them.
  *
  * @param target_nqn The NQN for the default XSAN NVMe-oF Target Subsystem.
  *                   If NULL, a default NQN might be generated or an error returned.
@@ -31,10 +76,16 @@ xsan_error_t xsan_nvmf_target_init(const char *target_nqn,
 /**
  * @brief Finalizes and cleans up the XSAN NVMe-oF Target subsystem.
  * Stops all subsystems, listeners, and destroys transports and the target.
- * Must be called from an SPDK reactor thread during application shutdown.
+ * Must be called from an SPDK reactor thread during application shutdown, on the thread
+ * that called xsan_nvmf_target_init. Waits for the poll groups to be destroyed.
  */
 void xsan_nvmf_target_fini(void);
 
+/**
+ * @brief Returns the number of poll groups of the running target, 0 if it is not running.
+ */
+uint32_t xsan_nvmf_target_get_poll_group_count(void);
+
 /**
  * @brief Makes an XSAN volume (represented by its backing SPDK bdev) available
  *        as a namespace under the default NVMe-oF subsystem.
@@ -57,6 +108,54 @@ xsan_error_t xsan_nvmf_target_add_namespace(const char *bdev_name, uint32_t nsid
  */
 xsan_error_t xsan_nvmf_target_remove_namespace(uint32_t nsid);
 
+/**
+ * @brief Exports an XSAN volume as a namespace of the default subsystem.
+ * Creates the volume's XSAN vbdev (XSAN_NVMF_VOLUME_BDEV_PREFIX + UUID) and adds it with the
+ * volume UUID as both NGUID and namespace UUID, so hosts can match namespaces to volumes
+ * whatever NSID they get. The NSID is the lowest free one. Only that namespace is paused
+ * while it is added; I/O to the other namespaces keeps flowing.
+ *
+ * The work is queued and done asynchronously on the thread that called xsan_nvmf_target_init,
+ * one namespace change at a time. Safe to call from any SPDK thread.
+ *
+ * @param volume_id The volume to export.
+ * @return XSAN_OK if the export was queued (or done), XSAN_ERROR_NOT_INITIALIZED if the target
+ *         is not running, XSAN_ERROR_ALREADY_EXISTS if the volume is already exported, or
+ *         XSAN_ERROR_INSUFFICIENT_SPACE if the subsystem has no free NSID.
+ *         When queued from another thread, these errors are only logged.
+ */
+xsan_error_t xsan_nvmf_target_export_volume(xsan_volume_id_t volume_id);
+
+/**
+ * @brief Removes a volume's namespace from the default subsystem and destroys its vbdev.
+ * Asynchronous and thread-safe like xsan_nvmf_target_export_volume; an export still in
+ * progress finishes first and is then removed.
+ *
+ * @param volume_id The volume to stop exporting.
+ * @return XSAN_OK if the removal was queued (or done), XSAN_ERROR_NOT_INITIALIZED, or
+ *         XSAN_ERROR_NOT_FOUND if the volume is not exported.
+ */
+xsan_error_t xsan_nvmf_target_unexport_volume(xsan_volume_id_t volume_id);
+
+/**
+ * @brief Exports every volume of vm and keeps the namespaces in step with it from then on:
+ * created volumes are exported, and volumes being deleted have their vbdevs detached (new I/O
+ * fails) and their namespaces removed. Takes the volume manager's event callback.
+ * Must be called on the thread that called xsan_nvmf_target_init, after
+ * xsan_vhost_subsystem_init. xsan_nvmf_target_fini releases the callback.
+ *
+ * @param vm The volume manager. Must not be NULL.
+ * @return XSAN_OK, XSAN_ERROR_NOT_INITIALIZED, XSAN_ERROR_THREAD_CONTEXT, or the error of
+ *         xsan_volume_manager_set_event_cb / xsan_volume_list_all.
+ */
+xsan_error_t xsan_nvmf_target_enable_auto_export(struct xsan_volume_manager *vm);
+
+/**
+ * @brief Returns the NSID a volume is exported under, or 0 if it is not (yet) exported.
+ * Call on the thread that called xsan_nvmf_target_init.
+ */
+uint32_t xsan_nvmf_target_get_volume_nsid(xsan_volume_id_t volume_id);
+
 // TODO: Add functions to create/delete/manage multiple NVMf subsystems if needed,
 //       rather than just a single default one.
 
@@ -16,8 +16,13 @@ extern "C" {
 // Magic number to identify XSAN messages
 #define XSAN_PROTOCOL_MAGIC ((uint32_t)0x5853414E) // "XSAN" (ASCII: X S A N)
 
-// Current protocol version
-#define XSAN_PROTOCOL_VERSION ((uint16_t)1)
+// Wire format versions. Every connection starts out speaking v1; a peer switches its sends to
+// v2 once both sides have advertised it (see xsan_comm_features_payload_t).
+#define XSAN_PROTOCOL_VERSION_1 ((uint16_t)1) // One message per frame, 24-byte big-endian header
+#define XSAN_PROTOCOL_VERSION_2 ((uint16_t)2) // Multi-message frames, little-endian fixed-offset headers
+
+// Highest protocol version this build speaks
+#define XSAN_PROTOCOL_VERSION XSAN_PROTOCOL_VERSION_2
 
 // Maximum payload size for a single message (e.g., 16MB)
 // This is a protocol-level limit, not necessarily a TCP segment limit.
@@ -32,6 +37,8 @@ typedef enum {
     // Control Plane Messages
     XSAN_MSG_TYPE_HEARTBEAT = 1,          ///< Node heartbeat signal
     XSAN_MSG_TYPE_HEARTBEAT_ACK = 2,      ///< Acknowledgement for heartbeat
+    XSAN_MSG_TYPE_COMM_FEATURES = 3,      ///< Per-connection handshake: protocol version and features (handled inside node comm)
+    XSAN_MSG_TYPE_COMM_CREDIT = 4,        ///< Flow-control credit grant (handled inside node comm)
 
     XSAN_MSG_TYPE_NODE_REGISTER_REQ = 10, ///< Request for a node to register with cluster
     XSAN_MSG_TYPE_NODE_REGISTER_RESP = 11,///< Response to node registration
@@ -59,16 +66,83 @@ typedef enum {
     XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_RESP = 601, ///< Response to a replica write request
     XSAN_MSG_TYPE_REPLICA_READ_BLOCK_REQ = 602,  ///< Request to read a block from a replica
     XSAN_MSG_TYPE_REPLICA_READ_BLOCK_RESP = 603, ///< Response to a replica read request
+    XSAN_MSG_TYPE_REPLICA_WRITE_BATCH_REQ = 604,  ///< Several replica writes packed into one message
+    XSAN_MSG_TYPE_REPLICA_WRITE_BATCH_RESP = 605, ///< Per-write statuses for a batched replica write
+    XSAN_MSG_TYPE_REPLICA_CHAIN_WRITE_REQ = 606,  ///< Replica write to be applied and forwarded down a chain
+    XSAN_MSG_TYPE_REPLICA_CHAIN_WRITE_RESP = 607, ///< Chain ack carrying the status of every hop below the sender
     // XSAN_MSG_TYPE_REPLICA_SYNC_REQ = 610,      // Future: Request to sync a range of blocks
     // XSAN_MSG_TYPE_REPLICA_SYNC_RESP = 611,     // Future: Response to sync request
 
+    // Metadata Snapshot Transfer (node bootstrap)
+    XSAN_MSG_TYPE_METADATA_SNAPSHOT_REQ = 700,   ///< Ask a peer to stream a checkpoint of its node metadata store
+    XSAN_MSG_TYPE_METADATA_SNAPSHOT_CHUNK = 701, ///< One piece of a snapshot file, or the end-of-snapshot marker
+
     // Add more message types as the protocol evolves
     XSAN_MSG_TYPE_MAX // Sentinel, keep last
 } xsan_message_type_t;
 
 
+// --- Connection Feature Negotiation ---
+
+/// Sender computes and receiver verifies a CRC32C over header and payload (v1) or the whole frame (v2).
+#define XSAN_COMM_FEATURE_CRC32C (1u << 0)
+
+/// Sender packs several queued messages into one v2 frame; without it every v2 frame carries one message.
+#define XSAN_COMM_FEATURE_FRAME_BATCHING (1u << 1)
+
+/// Receiver grants byte and message credits (XSAN_MSG_TYPE_COMM_CREDIT); sender queues messages it has no credit for.
+#define XSAN_COMM_FEATURE_FLOW_CONTROL (1u << 2)
+
+/// Sender may LZ4-compress v2 message payloads (XSAN_PROTOCOL_V2_MSG_FLAG_LZ4).
+#define XSAN_COMM_FEATURE_LZ4 (1u << 3)
+
+/**
+ * @brief Payload for XSAN_MSG_TYPE_COMM_FEATURES, the connection handshake. Each side sends one,
+ * always as a v1 message, when a connection is established; a feature is used on the connection
+ * once both sides have advertised it, and each side sends with the lower of the two versions.
+ * Peers that predate protocol v2 send only the features field (4 bytes), meaning version 1.
+ * Fields are in network byte order.
+ */
+typedef struct {
+    uint32_t features;              ///< XSAN_COMM_FEATURE_* bits supported and enabled by the sender
+    uint16_t max_version;           ///< Highest XSAN_PROTOCOL_VERSION_* the sender accepts
+    uint16_t reserved;
+} __attribute__((packed)) xsan_comm_features_payload_t;
+
+/// Length of the handshake payload sent by peers that only speak protocol v1.
+#define XSAN_COMM_FEATURES_V1_PAYLOAD_SIZE sizeof(uint32_t)
+
+/**
+ * @brief Payload for XSAN_MSG_TYPE_COMM_CREDIT. The limits are cumulative since the connection
+ * was established: the receiver of this grant may send messages as long as the payload bytes and
+ * the number of messages it has sent in total stay within them. COMM_FEATURES and COMM_CREDIT
+ * messages are never counted. Because the limits are absolute, a later grant simply replaces an
+ * earlier one. Fields are in network byte order.
+ */
+typedef struct {
+    uint64_t bytes_limit;           ///< Total payload bytes the peer may have sent
+    uint64_t msgs_limit;            ///< Total messages the peer may have sent
+} __attribute__((packed)) xsan_comm_credit_payload_t;
+
 // --- Payload Structures for Replication Messages ---
 
+/// Maximum number of remote hops a chain-replicated write can traverse.
+#define XSAN_REPLICA_CHAIN_MAX_HOPS (XSAN_MAX_REPLICAS - 1)
+
+/// Size of the textual address carried for each chain hop (matches INET6_ADDRSTRLEN).
+#define XSAN_REPLICA_CHAIN_ADDR_LEN 46
+
+/**
+ * @brief Identifies a node on the path of a chain-replicated write.
+ * The receiver of a chain write forwards the data to the first entry of its downstream list
+ * and acks the upstream hop.
+ */
+typedef struct {
+    xsan_node_id_t node_id;                     ///< Node ID of the hop
+    char node_ip_addr[XSAN_REPLICA_CHAIN_ADDR_LEN]; ///< Communication address of the hop
+    uint16_t node_comm_port;                    ///< Communication port of the hop
+} __attribute__((packed)) xsan_replica_chain_hop_t;
+
 /**
  * @brief Payload for XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_REQ.
  * The actual block data follows this structured payload within the xsan_message_t's payload field.
@@ -90,6 +164,7 @@ typedef struct {
 
 /**
  * @brief Payload for XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_RESP.
+ * May be followed by an xsan_replica_write_resp_trailer_t.
  */
 typedef struct {
     xsan_error_t status;                ///< XSAN_OK on success, or an error code.
@@ -97,10 +172,84 @@ typedef struct {
     uint32_t num_blocks_processed;      ///< Number of blocks successfully/attempted to process
 } __attribute__((packed)) xsan_replica_write_resp_payload_t;
 
+/**
+ * @brief Optional trailer of a XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_RESP, after the fixed payload.
+ * Receivers detect it by the payload length; responses without it leave the responder unknown.
+ */
+typedef struct {
+    xsan_node_id_t responder_node_id;   ///< Node that produced this response
+} __attribute__((packed)) xsan_replica_write_resp_trailer_t;
+
 // Size of the structured part of the replica write request payload.
 // The actual data blocks will follow this.
 #define XSAN_REPLICA_WRITE_REQ_PAYLOAD_SIZE sizeof(xsan_replica_write_req_payload_t)
 
+/**
+ * @brief Payload for XSAN_MSG_TYPE_REPLICA_CHAIN_WRITE_REQ.
+ * The receiver writes the extent locally, forwards the data to chain_downstream[0] with the
+ * remaining hops, and acks upstream only once its own write and the downstream ack have
+ * completed. The block data follows, as for XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_REQ.
+ */
+typedef struct {
+    xsan_replica_write_req_payload_t write; ///< The extent, laid out as in a fan-out write
+    xsan_replica_chain_hop_t upstream;      ///< Sender of this request, which the receiver acks
+    uint8_t chain_num_downstream;           ///< Number of valid entries in chain_downstream (0 = chain tail)
+    uint8_t reserved[3];
+    xsan_replica_chain_hop_t chain_downstream[XSAN_REPLICA_CHAIN_MAX_HOPS]; ///< Hops after the receiver, in order
+} __attribute__((packed)) xsan_replica_chain_write_req_payload_t;
+
+/**
+ * @brief Payload for XSAN_MSG_TYPE_REPLICA_CHAIN_WRITE_RESP.
+ */
+typedef struct {
+    xsan_replica_write_resp_payload_t write; ///< write.status is the responder's own local write result
+    xsan_node_id_t responder_node_id;        ///< Node that produced this response
+    uint8_t chain_num_statuses;              ///< Valid entries in chain_statuses (1 for the chain tail)
+    xsan_error_t chain_statuses[XSAN_REPLICA_CHAIN_MAX_HOPS]; ///< [0] = responder, [i] = i-th downstream hop
+} __attribute__((packed)) xsan_replica_chain_write_resp_payload_t;
+
+
+/** Upper bound on the number of writes packed into one XSAN_MSG_TYPE_REPLICA_WRITE_BATCH_REQ. */
+#define XSAN_REPLICA_WRITE_BATCH_MAX_EXTENTS 64
+
+/**
+ * @brief Descriptor of one write inside a XSAN_MSG_TYPE_REPLICA_WRITE_BATCH_REQ.
+ * Each write keeps the transaction ID of its own replicated write, so the primary can
+ * complete it individually when the batch response arrives.
+ */
+typedef struct {
+    uint64_t transaction_id;            ///< TID of the replicated write this extent belongs to
+    xsan_volume_id_t volume_id;         ///< Volume the extent is written to
+    uint64_t block_lba_on_volume;       ///< Starting LBA within the volume
+    uint32_t num_blocks;                ///< Number of blocks in the extent
+    uint32_t data_len;                  ///< Bytes of data for this extent in the data area
+} __attribute__((packed)) xsan_replica_write_extent_t;
+
+/**
+ * @brief Payload for XSAN_MSG_TYPE_REPLICA_WRITE_BATCH_REQ.
+ * Followed by num_extents xsan_replica_write_extent_t descriptors, then the data of
+ * every extent, concatenated in descriptor order.
+ */
+typedef struct {
+    uint32_t num_extents;               ///< Number of extent descriptors that follow
+} __attribute__((packed)) xsan_replica_write_batch_req_payload_t;
+
+/**
+ * @brief Status of one write in a XSAN_MSG_TYPE_REPLICA_WRITE_BATCH_RESP.
+ */
+typedef struct {
+    uint64_t transaction_id;            ///< TID copied from the corresponding extent
+    xsan_error_t status;                ///< Result of the local write on the replica
+} __attribute__((packed)) xsan_replica_write_extent_status_t;
+
+/**
+ * @brief Payload for XSAN_MSG_TYPE_REPLICA_WRITE_BATCH_RESP.
+ * Followed by num_extents xsan_replica_write_extent_status_t entries, in request order.
+ */
+typedef struct {
+    xsan_node_id_t responder_node_id;   ///< Node that applied the batch
+    uint32_t num_extents;               ///< Number of status entries that follow
+} __attribute__((packed)) xsan_replica_write_batch_resp_payload_t;
 
 /**
  * @brief Payload for XSAN_MSG_TYPE_REPLICA_READ_BLOCK_REQ.
@@ -127,6 +276,39 @@ typedef struct {
 #define XSAN_REPLICA_READ_REQ_PAYLOAD_SIZE sizeof(xsan_replica_read_req_payload_t)
 #define XSAN_REPLICA_READ_RESP_PAYLOAD_SIZE sizeof(xsan_replica_read_resp_payload_t)
 
+// --- Metadata Snapshot Transfer ---
+
+/** Longest file name (including the NUL) carried in a metadata snapshot chunk. */
+#define XSAN_METADATA_SNAPSHOT_NAME_MAX 128
+
+/** Set on the last XSAN_MSG_TYPE_METADATA_SNAPSHOT_CHUNK of a snapshot, which carries no file data. */
+#define XSAN_METADATA_SNAPSHOT_FLAG_END (1u << 0)
+
+/**
+ * @brief Payload for XSAN_MSG_TYPE_METADATA_SNAPSHOT_REQ.
+ * The sender answers on the same connection with CHUNK messages carrying the request's transaction_id.
+ */
+typedef struct {
+    char backend[16];                   ///< Metadata backend of the requester ("rocksdb", "memlog"); must match the sender's
+    uint32_t max_chunk_bytes;           ///< Largest file data per chunk the requester accepts; 0 lets the sender choose
+    uint32_t reserved;
+} __attribute__((packed)) xsan_metadata_snapshot_req_payload_t;
+
+/**
+ * @brief Payload for XSAN_MSG_TYPE_METADATA_SNAPSHOT_CHUNK.
+ * data_len bytes of file data follow this structure. Files are sent one after another, each
+ * in increasing offset order; a file of size 0 is sent as one chunk with no data.
+ */
+typedef struct {
+    xsan_error_t status;                ///< XSAN_OK, or why the sender gave up (only with XSAN_METADATA_SNAPSHOT_FLAG_END)
+    uint32_t flags;                     ///< XSAN_METADATA_SNAPSHOT_FLAG_*
+    char file_name[XSAN_METADATA_SNAPSHOT_NAME_MAX]; ///< NUL-terminated, relative to the snapshot directory; empty with FLAG_END
+    uint64_t file_size;                 ///< Size of the whole file; with FLAG_END the total bytes of all files
+    uint64_t offset;                    ///< Offset of the data within the file; with FLAG_END the number of files
+    uint32_t data_len;                  ///< Bytes of file data following this structure
+    uint32_t data_crc32c;               ///< CRC32C of those bytes
+} __attribute__((packed)) xsan_metadata_snapshot_chunk_payload_t;
+
 /**
  * @brief Message header structure for all XSAN protocol messages.
  *
@@ -137,22 +319,83 @@ typedef struct {
 typedef struct {
     uint32_t magic;           ///< Magic number (XSAN_PROTOCOL_MAGIC)
     uint16_t type;            ///< Message type (xsan_message_type_t)
-    uint16_t version;         ///< Protocol version (XSAN_PROTOCOL_VERSION)
+    uint16_t version;         ///< Wire format the message was received with (XSAN_PROTOCOL_VERSION_*)
     uint32_t payload_length;  ///< Length of the data payload following this header, in bytes.
     uint64_t transaction_id;  ///< Unique ID for matching requests and responses.
-    uint32_t checksum;        ///< Checksum of (header fields excluding checksum + payload). 0 if not used.
+    uint32_t checksum;        ///< CRC32C of (serialized header with checksum 0 + payload). 0 if not used.
 } __attribute__((packed)) xsan_message_header_t;
 
 /// Size of the protocol header in bytes.
 #define XSAN_MESSAGE_HEADER_SIZE (sizeof(xsan_message_header_t))
 
+// --- Protocol v2 Framing ---
+//
+// A v2 frame is a frame header followed by num_msgs messages, each a message header and its
+// payload. All fields are little-endian at fixed offsets, so on little-endian hosts headers
+// are read and written with a plain copy. The first four bytes of a v1 header (the magic in
+// big-endian order) never equal the v2 frame magic, which lets a receiver accept both formats
+// on the same stream.
+
+/// Magic number at the start of every v2 frame ("XSF2" in memory order).
+#define XSAN_PROTOCOL_V2_FRAME_MAGIC ((uint32_t)0x32465358)
+
+/// Maximum number of messages in one v2 frame.
+#define XSAN_PROTOCOL_V2_MAX_FRAME_MSGS 64
+
+/// Maximum size of the body of one v2 frame (message headers and payloads).
+#define XSAN_PROTOCOL_V2_MAX_FRAME_SIZE (2 * XSAN_PROTOCOL_MAX_PAYLOAD_SIZE)
+
+/**
+ * @brief Header of a v2 frame (little-endian on the wire).
+ */
+typedef struct {
+    uint32_t magic;           ///< XSAN_PROTOCOL_V2_FRAME_MAGIC
+    uint16_t num_msgs;        ///< Messages in the frame, 1..XSAN_PROTOCOL_V2_MAX_FRAME_MSGS
+    uint16_t flags;           ///< Reserved, 0
+    uint32_t frame_length;    ///< Bytes following this header: every message header and payload
+    uint32_t checksum;        ///< CRC32C of the frame with this field 0, or 0 if not checksummed
+} __attribute__((packed)) xsan_protocol_v2_frame_header_t;
+
+/**
+ * @brief Header of one message inside a v2 frame (little-endian on the wire).
+ */
+typedef struct {
+    uint16_t type;            ///< Message type (xsan_message_type_t)
+    uint16_t flags;           ///< XSAN_PROTOCOL_V2_MSG_FLAG_* bits, 0 if none
+    uint32_t payload_length;  ///< Length of the payload following this header, in bytes
+    uint64_t transaction_id;  ///< Unique ID for matching requests and responses
+} __attribute__((packed)) xsan_protocol_v2_msg_header_t;
+
+#define XSAN_PROTOCOL_V2_FRAME_HEADER_SIZE (sizeof(xsan_protocol_v2_frame_header_t))
+#define XSAN_PROTOCOL_V2_MSG_HEADER_SIZE (sizeof(xsan_protocol_v2_msg_header_t))
+
+/// The payload on the wire is a little-endian uint32 with the original payload length, followed
+/// by one LZ4 block of the original payload. payload_length in the header is the wire length.
+/// Only sent to peers that advertised XSAN_COMM_FEATURE_LZ4.
+#define XSAN_PROTOCOL_V2_MSG_FLAG_LZ4 ((uint16_t)(1u << 0))
+
+/// Bytes in front of the LZ4 block of a compressed payload.
+#define XSAN_PROTOCOL_V2_LZ4_PREFIX_SIZE sizeof(uint32_t)
+
+/**
+ * @brief Releases a payload buffer that was not allocated with XSAN_MALLOC.
+ * @param payload The payload pointer stored in the message.
+ * @param arg The message's payload_free_arg.
+ */
+typedef void (*xsan_message_payload_free_fn_t)(void *payload, void *arg);
+
 /**
  * @brief Represents a full XSAN message, including header and payload.
  * The payload buffer is managed externally or by helper create/destroy functions.
+ * Messages assembled by the receive path carry their payload in a pooled DMA-capable
+ * buffer (payload_is_dma), released through payload_free instead of XSAN_FREE.
  */
 struct xsan_message {
     xsan_message_header_t header; ///< The message header.
     unsigned char *payload;       ///< Pointer to the payload data. NULL if payload_length is 0.
+    xsan_message_payload_free_fn_t payload_free; ///< Releases payload; NULL means XSAN_FREE.
+    void *payload_free_arg;       ///< Argument for payload_free.
+    bool payload_is_dma;          ///< Payload lives in DMA-capable memory and may be handed to a bdev as is.
 };
 
 /**
@@ -194,18 +437,78 @@ xsan_error_t xsan_protocol_header_serialize(const xsan_message_header_t *header,
 xsan_error_t xsan_protocol_header_deserialize(const unsigned char *buffer, xsan_message_header_t *header);
 
 /**
- * @brief Calculates a simple checksum (e.g., CRC32 or Fletcher-16/32) for a data buffer.
- * This function needs to be implemented with a chosen checksum algorithm.
- * For now, a placeholder.
+ * @brief Writes a v2 frame header into buffer (XSAN_PROTOCOL_V2_FRAME_HEADER_SIZE bytes).
+ */
+void xsan_protocol_v2_frame_header_encode(const xsan_protocol_v2_frame_header_t *frame, unsigned char *buffer);
+
+/**
+ * @brief Reads a v2 frame header and validates its magic, message count and length.
+ *
+ * @param buffer At least XSAN_PROTOCOL_V2_FRAME_HEADER_SIZE bytes.
+ * @param frame The header to fill in.
+ * @return XSAN_OK, or XSAN_ERROR_INVALID_PARAM on NULL arguments or a malformed header.
+ */
+xsan_error_t xsan_protocol_v2_frame_header_decode(const unsigned char *buffer, xsan_protocol_v2_frame_header_t *frame);
+
+/**
+ * @brief Writes the v2 message header for header (type, payload_length, transaction_id) and
+ * flags (XSAN_PROTOCOL_V2_MSG_FLAG_*) into buffer (XSAN_PROTOCOL_V2_MSG_HEADER_SIZE bytes).
+ */
+void xsan_protocol_v2_msg_header_encode(const xsan_message_header_t *header, uint16_t flags, unsigned char *buffer);
+
+/**
+ * @brief Reads a v2 message header into a message header with version XSAN_PROTOCOL_VERSION_2
+ * and a checksum of 0 (v2 checksums cover the whole frame).
+ *
+ * @param buffer At least XSAN_PROTOCOL_V2_MSG_HEADER_SIZE bytes.
+ * @param header The header to fill in.
+ * @param flags_out If not NULL, receives the XSAN_PROTOCOL_V2_MSG_FLAG_* bits.
+ * @return XSAN_OK, or XSAN_ERROR_INVALID_PARAM on NULL arguments or if the payload length
+ *         exceeds XSAN_PROTOCOL_MAX_PAYLOAD_SIZE.
+ */
+xsan_error_t xsan_protocol_v2_msg_header_decode(const unsigned char *buffer, xsan_message_header_t *header,
+                                                uint16_t *flags_out);
+
+/// Initial value for xsan_protocol_crc32c_update.
+#define XSAN_PROTOCOL_CRC32C_INIT (~0u)
+
+/**
+ * @brief Extends a running CRC32C over data, for checksums over several discontiguous buffers.
+ * Start from XSAN_PROTOCOL_CRC32C_INIT and finish with xsan_protocol_crc32c_final.
+ */
+uint32_t xsan_protocol_crc32c_update(uint32_t crc, const void *data, size_t length);
+
+/**
+ * @brief Finishes a running CRC32C into the value stored in a header. Because 0 in a header
+ * means "no checksum", a CRC of 0 is returned as 0xFFFFFFFF.
+ */
+uint32_t xsan_protocol_crc32c_final(uint32_t crc);
+
+/**
+ * @brief Calculates the CRC32C (Castagnoli) of a data buffer.
+ * Uses spdk_crc32c_update, which runs on the CPU's CRC32 instructions (SSE4.2 on x86,
+ * CRC extension on ARMv8) where available.
  *
  * @param data The data buffer.
  * @param length The length of the data in bytes.
- * @return The calculated checksum. A value of 0 might indicate an error or an actual checksum of 0.
+ * @return The CRC32C (standard initial value and final inversion).
  */
 uint32_t xsan_protocol_calculate_checksum(const unsigned char *data, size_t length);
 
 /**
- * @brief Verifies the checksum of a received message (header + payload).
+ * @brief Calculates the checksum to store in a message header.
+ * Streams the CRC32C over the serialized header (with its checksum field zeroed) and then
+ * the payload in place; nothing is copied. Because 0 in the header means "no checksum",
+ * a CRC of 0 is stored as 0xFFFFFFFF.
+ *
+ * @param header The message header; its checksum field is ignored.
+ * @param payload The payload. Can be NULL if header->payload_length is 0.
+ * @return The non-zero value for header->checksum.
+ */
+uint32_t xsan_protocol_message_checksum(const xsan_message_header_t *header, const unsigned char *payload);
+
+/**
+ * @brief Verifies the checksum of a received message (header + payload) without copying either.
  * The header's checksum field should contain the expected checksum.
  *
  * @param header Pointer to the received message header.
@@ -217,7 +520,8 @@ bool xsan_protocol_verify_checksum(const xsan_message_header_t *header, const un
 
 /**
  * @brief Creates a complete xsan_message_t, including allocating and copying payload data.
- * Initializes the header and sets its checksum field *after* copying the payload.
+ * Initializes the header with a checksum of 0; xsan_node_comm_send_msg fills it in on
+ * connections that negotiated XSAN_COMM_FEATURE_CRC32C.
  *
  * @param type The message type.
  * @param transaction_id The transaction ID.
@@ -238,10 +542,22 @@ xsan_message_t *xsan_protocol_message_create(xsan_message_type_t type,
  */
 void xsan_protocol_message_destroy(xsan_message_t *msg);
 
+/**
+ * @brief Returns the offset within a payload at which bulk block data starts, for
+ * message types that carry block data after a fixed structured part.
+ * The receive path uses it to place incoming payloads so that the block data lands on
+ * an aligned address and can be submitted to a bdev without a bounce copy.
+ *
+ * @param type The message type.
+ * @return The size of the structured part for block-carrying types, or 0 if the type
+ *         carries no block data at a fixed offset.
+ */
+uint32_t xsan_protocol_payload_data_offset(xsan_message_type_t type);
+
 /**
  * @brief Creates a complete xsan_message_t, including a structured payload
  *        and an optional additional raw data block.
- * Initializes the header and sets its checksum field. The header's payload_length
+ * Initializes the header with a checksum of 0 (see xsan_protocol_message_create). The header's payload_length
  * will be the sum of structured_payload_len and additional_data_len.
  *
  * @param type The message type.
@@ -0,0 +1,152 @@
+#ifndef XSAN_RANGE_LOCK_H
+#define XSAN_RANGE_LOCK_H
+
+#include "xsan_types.h"
+#include "../../include/xsan_error.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Number of slot links embedded directly in a lock request. Requests whose LBA range
+ * spans more hash slots than this fall back to a heap-allocated link array.
+ */
+#define XSAN_RANGE_LOCK_INLINE_LINKS 4
+
+/** Default number of hash slots in a per-volume range-lock table (must be a power of two). */
+#define XSAN_RANGE_LOCK_DEFAULT_SLOTS 64
+
+/** Default log2 of the region size (in blocks) that maps onto one hash slot. */
+#define XSAN_RANGE_LOCK_DEFAULT_REGION_SHIFT 8
+
+typedef struct xsan_range_lock_table xsan_range_lock_table_t;
+struct xsan_range_lock_req;
+
+/**
+ * @brief Callback invoked when a queued range-lock request is granted.
+ * Not invoked for requests that are granted immediately by xsan_range_lock_acquire.
+ * Called without any table lock held, from the thread that released the conflicting range.
+ *
+ * @param req The request that now holds its range.
+ * @param cb_arg User argument passed to xsan_range_lock_acquire.
+ */
+typedef void (*xsan_range_lock_granted_cb_t)(struct xsan_range_lock_req *req, void *cb_arg);
+
+/**
+ * @brief Membership of a lock request in one hash slot's FIFO.
+ * Internal to the range-lock table; exposed only so requests can be embedded without allocation.
+ */
+typedef struct xsan_range_lock_link {
+    struct xsan_range_lock_req *req;
+    struct xsan_range_lock_link *prev;
+    struct xsan_range_lock_link *next;
+    uint32_t slot_idx;
+} xsan_range_lock_link_t;
+
+/**
+ * @brief A single range-lock request over [start_block, end_block).
+ * The caller owns the storage (typically embedded in a per-I/O context) and must keep it
+ * alive until xsan_range_lock_release has been called for it.
+ */
+typedef struct xsan_range_lock_req {
+    uint64_t start_block;               ///< First block covered by the lock (inclusive)
+    uint64_t end_block;                 ///< End of the locked range (exclusive)
+    uint64_t seq;                       ///< Arrival order within the table; earlier requests win conflicts
+    bool granted;                       ///< True once the request holds its range
+    bool contended;                     ///< True if the request had to wait for an overlapping holder
+    uint64_t enqueue_time_us;           ///< Monotonic time at acquire, used for wait-time statistics
+
+    xsan_range_lock_granted_cb_t granted_cb; ///< Invoked when a queued request is granted
+    void *granted_cb_arg;               ///< Argument for granted_cb
+
+    uint32_t num_links;                 ///< Number of hash slots this request is linked into
+    xsan_range_lock_link_t *links;      ///< Points at inline_links or a heap array for wide ranges
+    xsan_range_lock_link_t inline_links[XSAN_RANGE_LOCK_INLINE_LINKS];
+
+    struct xsan_range_lock_req *next_granted; ///< Internal: chains requests granted by one release
+} xsan_range_lock_req_t;
+
+/**
+ * @brief Contention statistics for a range-lock table.
+ */
+typedef struct xsan_range_lock_stats {
+    uint64_t acquisitions;              ///< Total number of acquire calls that succeeded
+    uint64_t contended_acquisitions;    ///< Acquisitions that had to wait behind an overlapping range
+    uint64_t total_wait_us;             ///< Cumulative wait time of contended acquisitions
+    uint64_t max_wait_us;               ///< Longest observed wait
+    uint32_t current_holders;           ///< Requests currently holding a range
+    uint32_t current_waiters;           ///< Requests currently queued behind an overlapping range
+    uint32_t max_waiters;               ///< High-water mark of current_waiters
+} xsan_range_lock_stats_t;
+
+/**
+ * @brief Creates a range-lock table.
+ * The LBA space is divided into regions of (1 << region_shift) blocks which hash onto
+ * num_slots FIFO slots. Only requests whose block ranges overlap serialise against each other;
+ * everything else proceeds without waiting.
+ *
+ * @param num_slots Number of hash slots; rounded up to a power of two. 0 selects the default.
+ * @param region_shift log2 of the region size in blocks. 0 selects the default.
+ * @return A new table, or NULL on allocation failure.
+ */
+xsan_range_lock_table_t *xsan_range_lock_table_create(uint32_t num_slots, uint32_t region_shift);
+
+/**
+ * @brief Destroys a range-lock table.
+ * Any requests still linked into the table are dropped without their callbacks being invoked.
+ *
+ * @param table The table to destroy. If NULL, the function does nothing.
+ */
+void xsan_range_lock_table_destroy(xsan_range_lock_table_t *table);
+
+/**
+ * @brief Requests exclusive access to blocks [start_block, start_block + num_blocks).
+ * If no earlier request overlaps the range, the lock is granted immediately and *granted_now
+ * is set to true; granted_cb is NOT invoked in that case. Otherwise the request is queued and
+ * granted_cb fires once every earlier overlapping request has been released.
+ *
+ * @param table The range-lock table. Must not be NULL.
+ * @param req Caller-owned request storage. Must not be NULL and must not already be in use.
+ * @param start_block First block of the range.
+ * @param num_blocks Number of blocks in the range. Must be > 0.
+ * @param granted_cb Callback for deferred grants. Must not be NULL.
+ * @param cb_arg Argument for granted_cb.
+ * @param granted_now Output: true if the lock was granted synchronously. Must not be NULL.
+ * @return XSAN_OK on success, XSAN_ERROR_INVALID_PARAM on bad arguments,
+ *         XSAN_ERROR_NO_MEMORY if a wide range needed a link array that could not be allocated.
+ */
+xsan_error_t xsan_range_lock_acquire(xsan_range_lock_table_t *table,
+                                     xsan_range_lock_req_t *req,
+                                     uint64_t start_block,
+                                     uint64_t num_blocks,
+                                     xsan_range_lock_granted_cb_t granted_cb,
+                                     void *cb_arg,
+                                     bool *granted_now);
+
+/**
+ * @brief Releases a range previously granted by xsan_range_lock_acquire.
+ * Queued requests that become unblocked have their granted_cb invoked before this returns.
+ *
+ * @param table The range-lock table. Must not be NULL.
+ * @param req The granted request to release.
+ */
+void xsan_range_lock_release(xsan_range_lock_table_t *table, xsan_range_lock_req_t *req);
+
+/**
+ * @brief Copies the table's contention statistics.
+ *
+ * @param table The range-lock table.
+ * @param stats_out Output structure. Must not be NULL.
+ * @return XSAN_OK on success, XSAN_ERROR_INVALID_PARAM if either argument is NULL.
+ */
+xsan_error_t xsan_range_lock_get_stats(xsan_range_lock_table_t *table, xsan_range_lock_stats_t *stats_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // XSAN_RANGE_LOCK_H
@@ -0,0 +1,92 @@
+#ifndef XSAN_REPLICA_CHAIN_H
+#define XSAN_REPLICA_CHAIN_H
+
+#include "xsan_types.h"
+#include "xsan_storage.h"  // For xsan_replica_location_t
+#include "xsan_protocol.h" // For the chain write payloads
+#include "../../include/xsan_error.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Wire-level helpers for chain replication (XSAN_MSG_TYPE_REPLICA_CHAIN_WRITE_REQ/RESP).
+ * They only build and check payloads; sending, forwarding and deadlines are up to the caller.
+ */
+
+/**
+ * @brief Fills a chain hop from a replica location.
+ * @param hop Hop to fill. If NULL, the function does nothing.
+ * @param loc Replica location. If NULL, the function does nothing.
+ */
+void xsan_replica_chain_hop_from_location(xsan_replica_chain_hop_t *hop, const xsan_replica_location_t *loc);
+
+/**
+ * @brief Checks the hops of a chain request received from the network.
+ * The downstream count must leave room for the receiver's own status in its ack, and the
+ * upstream hop and every downstream hop need a NUL-terminated address and a non-zero port.
+ *
+ * @param req The received request payload.
+ * @return true if the request can be forwarded and acked, false otherwise (or if req is NULL).
+ */
+bool xsan_replica_chain_req_hops_valid(const xsan_replica_chain_write_req_payload_t *req);
+
+/**
+ * @brief Builds the request the primary sends to the chain head hops[head].
+ * The downstream list is hops[head + 1 .. num_hops - 1], so calling this again with a larger
+ * head reforms the chain around failed hops.
+ *
+ * @param req Request to fill.
+ * @param write Extent being written.
+ * @param self The sender, which the head will ack.
+ * @param hops Remote replicas in forwarding order.
+ * @param num_hops Number of entries in hops.
+ * @param head Index in hops of the hop the request is sent to. Must be < num_hops.
+ * @return XSAN_OK, or XSAN_ERROR_INVALID_PARAM on NULL arguments, an out-of-range head or
+ *         more downstream hops than a request can carry.
+ */
+xsan_error_t xsan_replica_chain_req_init(xsan_replica_chain_write_req_payload_t *req,
+                                         const xsan_replica_write_req_payload_t *write,
+                                         const xsan_replica_chain_hop_t *self,
+                                         const xsan_replica_location_t *hops, uint32_t num_hops, uint32_t head);
+
+/**
+ * @brief Builds the request a mid-chain replica forwards to req->chain_downstream[0].
+ * The extent is unchanged, the downstream list drops its first hop and the forwarder
+ * becomes the upstream hop.
+ *
+ * @param req Request received by the forwarder. Must have at least one downstream hop.
+ * @param self The forwarder.
+ * @param fwd_out Request to send downstream.
+ */
+void xsan_replica_chain_req_shift(const xsan_replica_chain_write_req_payload_t *req,
+                                  const xsan_replica_chain_hop_t *self,
+                                  xsan_replica_chain_write_req_payload_t *fwd_out);
+
+/**
+ * @brief Extracts per-hop statuses from a chain ack.
+ * statuses_out[k] reports on the k-th hop starting at the responder. Statuses beyond
+ * num_expected (or XSAN_REPLICA_CHAIN_MAX_HOPS) are ignored; hops the ack does not cover,
+ * because the chain broke below its last reporter, are set to XSAN_ERROR_REPLICATION_GENERIC.
+ *
+ * @param resp The received ack.
+ * @param expected_responder Node the ack must come from: the hop the request was sent to.
+ * @param num_expected Number of hops the ack should report on, responder included.
+ * @param statuses_out Receives num_expected statuses. Untouched on error.
+ * @return XSAN_OK, XSAN_ERROR_REPLICA_NOT_FOUND if the ack comes from another node (e.g. a
+ *         chain head that was already reformed away), XSAN_ERROR_INVALID_PARAM if the ack
+ *         reports no status at all, on NULL arguments or if num_expected is 0 or larger
+ *         than XSAN_REPLICA_CHAIN_MAX_HOPS.
+ */
+xsan_error_t xsan_replica_chain_ack_statuses(const xsan_replica_chain_write_resp_payload_t *resp,
+                                             const xsan_node_id_t *expected_responder,
+                                             uint32_t num_expected, xsan_error_t *statuses_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // XSAN_REPLICA_CHAIN_H
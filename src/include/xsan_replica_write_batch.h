@@ -0,0 +1,132 @@
+#ifndef XSAN_REPLICA_WRITE_BATCH_H
+#define XSAN_REPLICA_WRITE_BATCH_H
+
+#include "xsan_types.h"
+#include "xsan_node_comm.h" // For xsan_node_send_cb_t
+#include "../../include/xsan_error.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Default time a partially filled batch may wait for more writes before it is sent. */
+#define XSAN_REPLICA_WRITE_BATCH_DEFAULT_WINDOW_US 20
+
+/** Default maximum number of writes per batch (capped at XSAN_REPLICA_WRITE_BATCH_MAX_EXTENTS). */
+#define XSAN_REPLICA_WRITE_BATCH_DEFAULT_MAX_EXTENTS 32
+
+/** Default maximum data bytes per batch; reaching it sends the batch immediately. */
+#define XSAN_REPLICA_WRITE_BATCH_DEFAULT_MAX_BYTES (256 * 1024)
+
+/** Default size above which a write is not worth batching and is sent on its own. */
+#define XSAN_REPLICA_WRITE_BATCH_DEFAULT_MAX_EXTENT_BYTES (32 * 1024)
+
+/**
+ * @brief Tuning for a replica write batcher.
+ */
+typedef struct xsan_replica_write_batcher_opts {
+    uint32_t window_us;                 ///< Max time a batch waits for more writes. 0 sends on every submit.
+    uint32_t max_extents;               ///< Writes per batch before it is sent
+    uint32_t max_bytes;                 ///< Data bytes per batch before it is sent
+    uint32_t max_extent_bytes;          ///< Larger writes are rejected by submit and should be sent unbatched
+} xsan_replica_write_batcher_opts_t;
+
+/**
+ * @brief Counters describing how well writes are being coalesced.
+ */
+typedef struct xsan_replica_write_batcher_stats {
+    uint64_t batches_sent;              ///< Batch messages handed to the network
+    uint64_t extents_sent;              ///< Writes carried by those batches
+    uint64_t bytes_sent;                ///< Data bytes carried by those batches
+    uint64_t flushes_full;              ///< Batches sent because they reached max_extents or max_bytes
+    uint64_t flushes_window;            ///< Batches sent because their window expired
+    uint64_t send_failures;             ///< Batches whose connect or send failed
+} xsan_replica_write_batcher_stats_t;
+
+typedef struct xsan_replica_write_batcher xsan_replica_write_batcher_t;
+
+/**
+ * @brief Fills opts with the default batching parameters.
+ * @param opts Options to initialize. If NULL, the function does nothing.
+ */
+void xsan_replica_write_batcher_opts_init(xsan_replica_write_batcher_opts_t *opts);
+
+/**
+ * @brief Creates a replica write batcher.
+ * Each reactor that submits gets its own batching state on first use: an open batch per
+ * destination node, sent on that reactor's connection, and a window poller running on that
+ * reactor. Reactors never share batches, so submit takes no lock.
+ *
+ * @param opts Batching parameters, or NULL for the defaults.
+ * @return A new batcher, or NULL on failure.
+ */
+xsan_replica_write_batcher_t *xsan_replica_write_batcher_create(const xsan_replica_write_batcher_opts_t *opts);
+
+/**
+ * @brief Destroys a batcher. Each reactor's state is stopped on that reactor, where writes
+ * that were queued but not yet sent have their send callback invoked with -ECANCELED; for
+ * other reactors this happens after destroy returns. Must not race with submit or flush.
+ *
+ * @param batcher The batcher to destroy. If NULL, the function does nothing.
+ */
+void xsan_replica_write_batcher_destroy(xsan_replica_write_batcher_t *batcher);
+
+/**
+ * @brief Queues one replica write for the node at ip:port in the calling reactor's batch.
+ * The data is copied once, into the buffer the batch is sent from, so the caller's buffer may
+ * be reused once this returns. The write is sent when its batch fills up or its window
+ * expires. sent_cb is invoked once the batch
+ * carrying the write has been handed to the socket (status 0) or could not be sent
+ * (negative errno); the replica's per-write status arrives later in a
+ * XSAN_MSG_TYPE_REPLICA_WRITE_BATCH_RESP under the write's own transaction_id.
+ *
+ * @param batcher The batcher.
+ * @param ip Destination node address.
+ * @param port Destination node port.
+ * @param transaction_id TID of the replicated write.
+ * @param volume_id Volume the write targets.
+ * @param block_lba_on_volume Starting LBA within the volume.
+ * @param num_blocks Number of blocks written.
+ * @param data Data to write.
+ * @param data_len Length of data in bytes.
+ * @param sent_cb Send completion callback for this write. Must not be NULL.
+ * @param cb_arg Argument for sent_cb.
+ * @return XSAN_OK if the write was queued (sent_cb will fire exactly once, on the calling reactor),
+ *         XSAN_ERROR_INVALID_PARAM on bad arguments, if data_len exceeds max_extent_bytes or if
+ *         the caller does not own a transaction shard (see xsan_txn_local_shard),
+ *         XSAN_ERROR_OUT_OF_MEMORY on allocation failure. sent_cb is not invoked on error.
+ */
+xsan_error_t xsan_replica_write_batcher_submit(xsan_replica_write_batcher_t *batcher,
+                                               const char *ip, uint16_t port,
+                                               uint64_t transaction_id,
+                                               const xsan_volume_id_t *volume_id,
+                                               uint64_t block_lba_on_volume,
+                                               uint32_t num_blocks,
+                                               const void *data, uint32_t data_len,
+                                               xsan_node_send_cb_t sent_cb, void *cb_arg);
+
+/**
+ * @brief Returns true if a write of data_len bytes from the calling thread would be accepted by submit.
+ */
+bool xsan_replica_write_batcher_accepts(const xsan_replica_write_batcher_t *batcher, uint32_t data_len);
+
+/**
+ * @brief Sends every open batch of the calling reactor immediately, regardless of its window.
+ * @param batcher The batcher. If NULL, the function does nothing.
+ */
+void xsan_replica_write_batcher_flush(xsan_replica_write_batcher_t *batcher);
+
+/**
+ * @brief Sums the counters of every reactor. Counters of other reactors may lag slightly.
+ * @return XSAN_OK, or XSAN_ERROR_INVALID_PARAM if either argument is NULL.
+ */
+xsan_error_t xsan_replica_write_batcher_get_stats(xsan_replica_write_batcher_t *batcher,
+                                                  xsan_replica_write_batcher_stats_t *stats_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // XSAN_REPLICA_WRITE_BATCH_H
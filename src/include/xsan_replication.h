@@ -6,6 +6,8 @@
 #include "xsan_types.h"    // For xsan_error_t
 #include "xsan_io.h"       // For xsan_io_request_t, xsan_user_io_completion_cb_t
 #include "xsan_storage.h"  // For XSAN_MAX_REPLICAS, xsan_volume_id_t
+#include "xsan_range_lock.h" // For xsan_range_lock_req_t
+#include "xsan_timer_wheel.h" // For xsan_timer_t
 #include "../../include/xsan_error.h"
 #include <pthread.h>       // For pthread_mutex_t (if needed for future concurrent access)
 
@@ -56,6 +58,28 @@ typedef struct xsan_replicated_io_ctx {
     // Internal IO request for the local part of the replicated write
     xsan_io_request_t *local_io_req;
 
+    // Chain replication state (replication_mode == XSAN_REPLICATION_MODE_CHAIN).
+    xsan_replication_mode_t replication_mode;   ///< Topology used for the remote legs of this write
+    uint32_t chain_num_hops;                    ///< Remote replicas on the chain, in forwarding order
+    uint32_t chain_first_hop;                   ///< Index into chain_hops of the current chain head (advances on reform)
+    xsan_replica_location_t chain_hops[XSAN_MAX_REPLICAS];
+
+    // Range lock serialising this write against overlapping writes to the same volume.
+    // Held from before the replica fan-out until the final completion is reported.
+    struct xsan_range_lock_table *range_lock_table; ///< Table the lock was taken on (NULL if none)
+    xsan_range_lock_req_t range_lock;               ///< Embedded request, avoids a per-I/O allocation
+
+    // Set by whichever callback observes the last replica result first; completion runs exactly once,
+    // on the thread that owns transaction_id (see xsan_txn.h).
+    uint32_t completion_claimed;
+
+    // Lifetime and deadline. refs counts the table entry, each in-flight remote send
+    // context and an armed deadline; the context is freed when the last one is dropped.
+    uint32_t refs;
+    uint32_t local_leg_done;            ///< Set once the local replica write has completed
+    uint64_t dispatch_time_us;          ///< When the legs were sent, for spotting unresponsive replicas
+    xsan_timer_t deadline;              ///< Fails outstanding remote legs when it fires
+
     // Add fields to track remote replica send operations if needed, e.g.,
     // struct xsan_pending_replica_send {
     //    xsan_node_id_t node_id;
@@ -77,6 +101,7 @@ typedef struct xsan_per_replica_op_ctx {
     xsan_replica_location_t replica_location_info; ///< Information about the target replica node
     struct xsan_message *request_msg_to_send;  ///< The protocol message to send to the replica
     struct spdk_sock *connected_sock;          ///< Socket, if connection is established and reused
+    uint32_t attempt_seq;                      ///< Read attempt this op belongs to (reads only)
     // Add any other state needed for this specific per-replica operation,
     // e.g., retry count for this specific replica, timeout timer.
     // uint32_t current_attempt_retries;
@@ -113,6 +138,13 @@ typedef struct xsan_replica_read_coordinator_ctx {
     // This reuses the per-replica op context structure, but only one is active at a time for reads.
     xsan_per_replica_op_ctx_t *current_remote_op_ctx;
 
+    // Lifetime and per-attempt deadline. refs counts the table entry, the in-flight remote
+    // op context and an armed deadline. attempt_seq identifies the current attempt so that
+    // callbacks from an attempt that already timed out are ignored.
+    uint32_t refs;
+    uint32_t attempt_seq;
+    xsan_timer_t deadline;              ///< Fails the current remote attempt when it fires
+
     // Could also store a list of already tried replica indices to avoid retrying the same failed one immediately.
 } xsan_replica_read_coordinator_ctx_t;
 
@@ -44,6 +44,21 @@ xsan_error_t xsan_spdk_manager_opts_init(const char *app_name,
  */
 typedef void (*xsan_spdk_app_start_fn_t)(void *arg, int rc);
 
+/**
+ * @brief Callback invoked on the SPDK application thread when the application receives
+ *        SIGINT or SIGTERM. It replaces SPDK's default handling (an immediate
+ *        spdk_app_stop), so it must eventually call xsan_spdk_manager_request_app_stop.
+ */
+typedef void (*xsan_spdk_app_shutdown_fn_t)(void);
+
+/**
+ * @brief Sets the shutdown callback used by the next xsan_spdk_manager_start_app.
+ * Call after xsan_spdk_manager_opts_init, which resets it.
+ *
+ * @param shutdown_fn The callback, or NULL for SPDK's default handling.
+ */
+void xsan_spdk_manager_set_shutdown_cb(xsan_spdk_app_shutdown_fn_t shutdown_fn);
+
 
 /**
  * @brief Starts the SPDK application framework.
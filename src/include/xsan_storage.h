@@ -203,6 +203,15 @@ typedef struct xsan_disk_group {
 } xsan_disk_group_t;
 
 
+/**
+ * @brief Topology used to propagate a volume's writes to its remote replicas.
+ */
+typedef enum {
+    XSAN_REPLICATION_MODE_FANOUT = 0,   ///< Primary sends the payload to every remote replica directly
+    XSAN_REPLICATION_MODE_CHAIN = 1,    ///< Primary -> replica 1 -> replica 2 ...; acks travel back along the chain.
+                                        ///< Halves primary egress for FTT=2 at the cost of one extra hop of latency.
+} xsan_replication_mode_t;
+
 /**
  * @brief Represents a logical volume presented to the user/VM.
  * Built on top of one or more disk groups.
@@ -238,6 +247,11 @@ typedef struct xsan_volume {
                                                 ///< This might be less than FTT+1 if not enough resources.
     xsan_replica_location_t replica_nodes[XSAN_MAX_REPLICAS]; ///< Information about nodes holding replicas.
                                                               ///< replica_nodes[0] is often the primary/local.
+    xsan_replication_mode_t replication_mode;   ///< Policy: how writes reach the remote replicas.
+
+    // Runtime-only state (not persisted)
+    struct xsan_range_lock_table *write_range_locks; ///< Serialises overlapping writes; created and destroyed with the volume.
+    struct xsan_volume_allocation_meta *alloc_meta;  ///< Resident copy of the allocation record; LBA mapping reads it instead of the DB.
 
     // next/prev pointers are not part of the data structure if xsan_list stores void*
 } xsan_volume_t;
@@ -269,7 +283,7 @@ typedef struct {
  * This structure would typically be serialized (e.g., to JSON) and stored in a K/V store
  * with a key like "volmap:<volume_uuid>".
  */
-typedef struct {
+typedef struct xsan_volume_allocation_meta {
     xsan_volume_id_t volume_id;     ///< The ID of the volume this allocation map belongs to.
     xsan_group_id_t disk_group_id;  ///< The ID of the disk group from which space was allocated.
     uint32_t num_extents;           ///< Number of actual extents used by this volume.
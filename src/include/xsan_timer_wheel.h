@@ -0,0 +1,128 @@
+#ifndef XSAN_TIMER_WHEEL_H
+#define XSAN_TIMER_WHEEL_H
+
+#include "xsan_types.h"
+#include "../../include/xsan_error.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Number of cascading levels in a timer wheel. */
+#define XSAN_TIMER_WHEEL_LEVELS 4
+
+/** log2 of the number of slots per level. */
+#define XSAN_TIMER_WHEEL_SLOT_BITS 6
+
+/** Slots per level. */
+#define XSAN_TIMER_WHEEL_SLOTS (1u << XSAN_TIMER_WHEEL_SLOT_BITS)
+
+/**
+ * Longest timeout a wheel can represent, in ticks. Longer timeouts are clamped to it
+ * (with a 1 ms tick this is about 4.6 hours).
+ */
+#define XSAN_TIMER_WHEEL_MAX_TICKS ((1ull << (XSAN_TIMER_WHEEL_SLOT_BITS * XSAN_TIMER_WHEEL_LEVELS)) - 1)
+
+typedef struct xsan_timer_wheel xsan_timer_wheel_t;
+struct xsan_timer;
+
+/**
+ * @brief Callback invoked when a timer expires.
+ * Called from xsan_timer_wheel_advance with the timer already disarmed, so the callback
+ * may re-arm it, cancel other timers, or free the memory holding it.
+ *
+ * @param timer The expired timer.
+ * @param cb_arg User argument given to xsan_timer_init.
+ */
+typedef void (*xsan_timer_cb_t)(struct xsan_timer *timer, void *cb_arg);
+
+/**
+ * @brief A single timer. The caller owns the storage (typically embedded in a
+ * per-operation context) and must keep it alive while it is armed.
+ */
+typedef struct xsan_timer {
+    struct xsan_timer *prev;            ///< Slot list links; internal to the wheel
+    struct xsan_timer *next;
+    struct xsan_timer **slot_head;      ///< Slot the timer is linked into, NULL when disarmed
+    uint64_t expires_tick;              ///< Absolute tick at which the timer fires
+    xsan_timer_cb_t cb;                 ///< Expiry callback
+    void *cb_arg;                       ///< Argument for cb
+} xsan_timer_t;
+
+/**
+ * @brief Initializes a timer in the disarmed state.
+ * @param timer The timer. Must not be NULL.
+ * @param cb Expiry callback. Must not be NULL.
+ * @param cb_arg Argument for cb.
+ */
+void xsan_timer_init(xsan_timer_t *timer, xsan_timer_cb_t cb, void *cb_arg);
+
+/**
+ * @brief Returns true if the timer is currently armed on a wheel.
+ */
+static inline bool xsan_timer_is_armed(const xsan_timer_t *timer) {
+    return timer && timer->slot_head != NULL;
+}
+
+/**
+ * @brief Creates a hierarchical timer wheel.
+ * A wheel is not thread-safe; all calls for one wheel (and its timers) must come from
+ * the same thread, typically the reactor whose poller drives xsan_timer_wheel_advance.
+ *
+ * @param tick_us Resolution of the wheel in microseconds. Must be non-zero.
+ * @param now_us Current time in microseconds; defines tick 0.
+ * @return A new wheel, or NULL on bad arguments or allocation failure.
+ */
+xsan_timer_wheel_t *xsan_timer_wheel_create(uint32_t tick_us, uint64_t now_us);
+
+/**
+ * @brief Destroys a wheel. Timers still armed on it are neither fired nor touched;
+ * their owners must not use them with this wheel again.
+ *
+ * @param wheel The wheel. If NULL, the function does nothing.
+ */
+void xsan_timer_wheel_destroy(xsan_timer_wheel_t *wheel);
+
+/**
+ * @brief Arms a timer to fire timeout_us from the wheel's current time.
+ * The timeout is rounded up to whole ticks (at least one). A timer that is already
+ * armed is re-armed with the new timeout. O(1).
+ *
+ * @param wheel The wheel.
+ * @param timer An initialized timer.
+ * @param timeout_us Timeout in microseconds.
+ * @return XSAN_OK, or XSAN_ERROR_INVALID_PARAM if wheel or timer is NULL or timer has no callback.
+ */
+xsan_error_t xsan_timer_wheel_arm(xsan_timer_wheel_t *wheel, xsan_timer_t *timer, uint64_t timeout_us);
+
+/**
+ * @brief Disarms a timer without firing it. O(1).
+ *
+ * @param wheel The wheel the timer was armed on.
+ * @param timer The timer.
+ * @return true if the timer was armed, false if it was not (already fired or never armed).
+ */
+bool xsan_timer_wheel_cancel(xsan_timer_wheel_t *wheel, xsan_timer_t *timer);
+
+/**
+ * @brief Advances the wheel to now_us and fires every timer that has expired.
+ *
+ * @param wheel The wheel.
+ * @param now_us Current time in microseconds. Times earlier than the wheel's are ignored.
+ * @return The number of timers fired.
+ */
+uint32_t xsan_timer_wheel_advance(xsan_timer_wheel_t *wheel, uint64_t now_us);
+
+/**
+ * @brief Returns the number of timers currently armed on the wheel.
+ */
+uint32_t xsan_timer_wheel_count(const xsan_timer_wheel_t *wheel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // XSAN_TIMER_WHEEL_H
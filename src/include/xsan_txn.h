@@ -0,0 +1,163 @@
+#ifndef XSAN_TXN_H
+#define XSAN_TXN_H
+
+#include "xsan_types.h"
+#include "xsan_hashtable.h" // For xsan_value_destroy_func_t
+#include "../../include/xsan_error.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Transaction IDs are 64-bit values laid out as
+ *   [63..48] node epoch | [47..40] owning shard | [39..0] per-shard sequence.
+ * A shard corresponds to one SPDK thread (reactor). The epoch changes on every node
+ * start, so responses addressed to a previous incarnation never match a live transaction.
+ * TID 0 is never issued.
+ */
+#define XSAN_TXN_EPOCH_SHIFT 48
+#define XSAN_TXN_SHARD_SHIFT 40
+#define XSAN_TXN_SEQ_MASK ((1ULL << XSAN_TXN_SHARD_SHIFT) - 1)
+
+/** Number of shards; TIDs carry the shard in 8 bits. */
+#define XSAN_TXN_MAX_SHARDS 256
+
+/**
+ * Shard without an owner thread, used by callers that are not SPDK threads and by SPDK
+ * threads registered after every owned shard (0..XSAN_TXN_SHARED_SHARD-1) is taken.
+ * Its sub-table is mutex-protected and its transactions are processed inline by any thread.
+ */
+#define XSAN_TXN_SHARED_SHARD (XSAN_TXN_MAX_SHARDS - 1)
+
+/** @brief Returns the node epoch encoded in a TID. */
+static inline uint16_t xsan_txn_tid_epoch(uint64_t tid) {
+    return (uint16_t)(tid >> XSAN_TXN_EPOCH_SHIFT);
+}
+
+/** @brief Returns the owning shard encoded in a TID. */
+static inline uint32_t xsan_txn_tid_shard(uint64_t tid) {
+    return (uint32_t)((tid >> XSAN_TXN_SHARD_SHIFT) & (XSAN_TXN_MAX_SHARDS - 1));
+}
+
+/** @brief Returns the per-shard sequence number encoded in a TID. */
+static inline uint64_t xsan_txn_tid_seq(uint64_t tid) {
+    return tid & XSAN_TXN_SEQ_MASK;
+}
+
+/**
+ * @brief Function run on the owning thread of a transaction.
+ * @param arg User argument passed to xsan_txn_run_on_owner.
+ */
+typedef void (*xsan_txn_fn_t)(void *arg);
+
+/** Opaque transaction table sharded by owning thread. */
+typedef struct xsan_txn_table xsan_txn_table_t;
+
+/**
+ * @brief Sets the node epoch stamped into every TID issued from now on.
+ * Should be called once at startup with a value that differs between node restarts.
+ * If never called, an epoch derived from the wall clock is used.
+ *
+ * @param node_epoch The epoch value.
+ */
+void xsan_txn_init(uint16_t node_epoch);
+
+/**
+ * @brief Issues a new TID owned by the calling thread.
+ * The first call on an SPDK thread registers it as a shard owner. Calls from threads
+ * that are not SPDK threads, and from SPDK threads that could not be registered because
+ * every owned shard is taken, get XSAN_TXN_SHARED_SHARD.
+ *
+ * @return A new non-zero TID.
+ */
+uint64_t xsan_txn_next_tid(void);
+
+/**
+ * @brief Looks up the shard owned by the calling SPDK thread without registering one.
+ *
+ * @param shard_out Receives the shard index on success. Must not be NULL.
+ * @return true if the calling thread owns a shard, false otherwise (including for
+ *         threads that are not SPDK threads and for threads using the shared shard).
+ */
+bool xsan_txn_local_shard(uint32_t *shard_out);
+
+/**
+ * @brief Returns true if the calling thread owns tid, or if tid is in XSAN_TXN_SHARED_SHARD.
+ * Returns false for shards that were never registered.
+ */
+bool xsan_txn_is_owner(uint64_t tid);
+
+/**
+ * @brief Runs fn(arg) on the thread that owns tid.
+ * Runs it inline if the caller is the owner or tid is in XSAN_TXN_SHARED_SHARD; otherwise
+ * posts it with spdk_thread_send_msg. Messages to one owner are processed in posting order.
+ *
+ * @param tid The transaction whose owner should run fn.
+ * @param fn The function to run. Must not be NULL.
+ * @param arg Argument for fn.
+ * @return XSAN_OK if fn ran or was posted, XSAN_ERROR_INVALID_PARAM if fn is NULL,
+ *         XSAN_ERROR_NOT_FOUND if tid's shard was never registered,
+ *         XSAN_ERROR_NO_MEMORY if the message could not be posted.
+ */
+xsan_error_t xsan_txn_run_on_owner(uint64_t tid, xsan_txn_fn_t fn, void *arg);
+
+/**
+ * @brief Creates a transaction table with one sub-table per shard.
+ * Each owned sub-table is only ever touched by the thread that owns its shard, without
+ * locking; the XSAN_TXN_SHARED_SHARD sub-table is guarded by a mutex.
+ *
+ * @param leftover_destroy Called for entries still present when the table is destroyed. Can be NULL.
+ * @return A new table, or NULL on allocation failure.
+ */
+xsan_txn_table_t *xsan_txn_table_create(xsan_value_destroy_func_t leftover_destroy);
+
+/**
+ * @brief Destroys a transaction table. Must only be called once no thread can still
+ * touch it (e.g. at shutdown, after all reactors have stopped submitting I/O).
+ *
+ * @param table The table. If NULL, the function does nothing.
+ */
+void xsan_txn_table_destroy(xsan_txn_table_t *table);
+
+/**
+ * @brief Inserts a transaction. Must be called on the thread that owns *tid_key.
+ *
+ * @param table The table.
+ * @param tid_key Pointer to the TID, which must stay valid while the entry is in the table
+ *                (typically a field inside value).
+ * @param value The transaction context.
+ * @return XSAN_OK on success, XSAN_ERROR_INVALID_PARAM on bad arguments or when called
+ *         off the owning thread, XSAN_ERROR_NO_MEMORY on allocation failure.
+ */
+xsan_error_t xsan_txn_table_insert(xsan_txn_table_t *table, uint64_t *tid_key, void *value);
+
+/**
+ * @brief Looks up a transaction. Must be called on the thread that owns tid.
+ *
+ * @return The transaction context, or NULL if not present or called off the owning thread.
+ */
+void *xsan_txn_table_lookup(xsan_txn_table_t *table, uint64_t tid);
+
+/**
+ * @brief Removes a transaction and then passes its context to release_fn.
+ * May be called from any thread: off the owning thread the removal (and release_fn)
+ * is posted to the owner.
+ *
+ * @param table The table.
+ * @param tid The transaction to remove.
+ * @param release_fn Called with the removed context on the owning thread. Can be NULL.
+ * @return XSAN_OK if the entry was removed or the removal was posted,
+ *         XSAN_ERROR_NOT_FOUND if the caller owns tid and it was not in the table
+ *         (release_fn is not called), or another error if posting failed.
+ */
+xsan_error_t xsan_txn_table_remove(xsan_txn_table_t *table, uint64_t tid, xsan_value_destroy_func_t release_fn);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // XSAN_TXN_H
@@ -63,6 +63,47 @@ xsan_error_t xsan_vhost_expose_volume_as_vbdev(xsan_volume_id_t volume_id, const
  */
 xsan_error_t xsan_vhost_unexpose_volume_vbdev(const char *vbdev_name);
 
+/**
+ * @brief Cuts every XSAN vbdev of a volume off from the volume, for a volume that is being
+ * deleted. The vbdevs stay registered (so hosts see I/O errors, not a vanished device) and
+ * fail all new I/O until they are unexposed. Safe to call from any thread.
+ *
+ * @param volume_id The ID of the volume being deleted.
+ * @return The number of vbdevs detached.
+ */
+uint32_t xsan_vhost_detach_volume(xsan_volume_id_t volume_id);
+
+/**
+ * @brief I/O counters of one XSAN vbdev, summed over its I/O channels (one per SPDK thread).
+ */
+typedef struct xsan_vhost_vbdev_stats {
+    uint64_t read_ops;          ///< Reads completed successfully
+    uint64_t write_ops;         ///< Writes completed successfully
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+    uint64_t failed_ops;        ///< Reads and writes completed with an error
+    uint64_t buf_cache_misses;  ///< Bounce buffers allocated because the channel's cache was empty
+                                ///< or the I/O was larger than the cached buffers
+} xsan_vhost_vbdev_stats_t;
+
+/**
+ * @brief Completion of xsan_vhost_get_vbdev_stats.
+ * @param stats The summed counters; only valid during the callback. NULL if status is not XSAN_OK.
+ */
+typedef void (*xsan_vhost_vbdev_stats_cb_t)(void *cb_arg, xsan_error_t status, const xsan_vhost_vbdev_stats_t *stats);
+
+/**
+ * @brief Collects the I/O counters of an XSAN vbdev from all of its channels.
+ * The counters are kept per channel without atomics, so the sum is gathered by visiting each
+ * channel's thread. Must be called from an SPDK thread; cb runs on that thread.
+ *
+ * @param vbdev_name Name of the XSAN vbdev.
+ * @param cb Called with the result. Must not be NULL.
+ * @param cb_arg Passed to cb.
+ * @return XSAN_OK if cb will be called, XSAN_ERROR_NOT_FOUND if no such vbdev exists, or
+ *         XSAN_ERROR_NO_MEMORY.
+ */
+xsan_error_t xsan_vhost_get_vbdev_stats(const char *vbdev_name, xsan_vhost_vbdev_stats_cb_t cb, void *cb_arg);
 
 /**
  * @brief (Optional Helper for SPDK JSON Config or RPC)
@@ -77,12 +118,101 @@ xsan_error_t xsan_vhost_unexpose_volume_vbdev(const char *vbdev_name);
 // xsan_error_t xsan_vhost_get_suggested_vbdev_name(xsan_volume_id_t volume_id, char *buffer, size_t buffer_len);
 
 
-// Note: The actual creation of vhost-user SCSI controllers and attaching LUNs (which point to these
-// XSAN vbdevs) is typically handled by SPDK's configuration mechanisms (JSON file at startup or JSON-RPC).
-// This module focuses on providing the XSAN vbdevs that SPDK's vhost layer can then use.
-// If direct programmatic control over vhost controller/LUN creation is needed from XSAN,
-// further functions would be added here to wrap SPDK RPC calls or equivalent C APIs if available
-// for that purpose.
+// --- vhost-user-blk controllers ---
+// A controller gives a local KVM guest a virtio-blk disk over a vhost-user socket: the guest's
+// virtqueues live in shared memory and are polled by an SPDK thread of the controller, so I/O
+// skips the kernel and the network. Each controller serves one XSAN volume through its own vbdev.
+
+/// Default name of a volume's controller (and of its socket): this prefix followed by the volume UUID.
+#define XSAN_VHOST_BLK_CTRLR_PREFIX "xsan_blk_"
+/// A controller's vbdev is named this prefix followed by the controller name. It is separate from
+/// the volume's NVMe-oF vbdev, which the target claims.
+#define XSAN_VHOST_BLK_BDEV_PREFIX "xsan_vblk_"
+/// Longest controller name, including the terminating NUL.
+#define XSAN_VHOST_BLK_NAME_MAX 64
+
+/**
+ * @brief Placement of vhost-blk controllers.
+ * SPDK polls every virtqueue of a controller on the controller's one thread, so a guest's
+ * queues all land on one reactor. With spread_controllers, each new controller is pinned to
+ * the core of cpumask that runs the fewest controllers, so several volumes (or guests) use
+ * several reactors instead of whichever one SPDK picks first.
+ */
+typedef struct xsan_vhost_blk_opts {
+    char cpumask[64];           ///< Hex core mask controllers may run on, e.g. "0xC"; empty allows every reactor
+    char socket_dir[256];       ///< Directory of the vhost-user sockets; empty keeps SPDK's (the working directory)
+    bool spread_controllers;    ///< Pin each controller to one core of cpumask; false hands SPDK the whole mask
+} xsan_vhost_blk_opts_t;
+
+/**
+ * @brief Runtime details of one vhost-blk controller.
+ */
+typedef struct xsan_vhost_blk_controller_info {
+    char name[XSAN_VHOST_BLK_NAME_MAX];
+    char bdev_name[XSAN_VHOST_BLK_NAME_MAX + sizeof(XSAN_VHOST_BLK_BDEV_PREFIX)]; ///< vbdev serving the controller
+    xsan_volume_id_t volume_id;
+    char cpumask[64];           ///< Mask the controller's thread was created with
+    char socket_path[256 + XSAN_VHOST_BLK_NAME_MAX + 1]; ///< vhost-user socket to hand to QEMU
+} xsan_vhost_blk_controller_info_t;
+
+/**
+ * @brief Fills opts with the defaults: every reactor, SPDK's socket directory, controllers spread.
+ * @param opts Options to initialize. If NULL, the function does nothing.
+ */
+void xsan_vhost_blk_opts_init(xsan_vhost_blk_opts_t *opts);
+
+/**
+ * @brief Sets the options used by controllers created from now on.
+ * @param opts The options. Must not be NULL.
+ * @return XSAN_OK, XSAN_ERROR_INVALID_PARAM if cpumask cannot be parsed or socket_dir is not a
+ *         directory, or XSAN_ERROR_BUSY if controllers exist already (their sockets would move).
+ */
+xsan_error_t xsan_vhost_blk_set_opts(const xsan_vhost_blk_opts_t *opts);
+
+/**
+ * @brief Creates a vhost-user-blk controller for an XSAN volume: exposes the volume as a
+ * vbdev named XSAN_VHOST_BLK_BDEV_PREFIX + ctrlr_name and starts a controller on it, listening
+ * on socket_dir/ctrlr_name. A guest attaches with e.g.
+ *   -chardev socket,id=c0,path=<socket> -device vhost-user-blk-pci,chardev=c0,num-queues=4
+ * (guest memory must be shared, e.g. a memory-backend-file with share=on on hugepages).
+ *
+ * Must be called from the SPDK app thread, like SPDK's vhost RPCs.
+ *
+ * @param volume_id The volume to serve.
+ * @param ctrlr_name Controller name; NULL uses XSAN_VHOST_BLK_CTRLR_PREFIX + the volume UUID.
+ * @return XSAN_OK on success.
+ *         XSAN_ERROR_NOT_FOUND if the volume does not exist.
+ *         XSAN_ERROR_ALREADY_EXISTS if a controller or vbdev of that name exists.
+ *         XSAN_ERROR_INVALID_PARAM if the name is too long for the socket path.
+ *         XSAN_ERROR_THREAD_CONTEXT, XSAN_ERROR_NOT_INITIALIZED or XSAN_ERROR_NO_MEMORY.
+ *         XSAN_ERROR_SYSTEM if SPDK could not start the controller; nothing is left behind.
+ */
+xsan_error_t xsan_vhost_blk_controller_create(xsan_volume_id_t volume_id, const char *ctrlr_name);
+
+/**
+ * @brief Stops a controller created by xsan_vhost_blk_controller_create, removes its socket
+ * and unexposes its vbdev. Must be called from the SPDK app thread.
+ *
+ * @param ctrlr_name Name of the controller.
+ * @return XSAN_OK, XSAN_ERROR_NOT_FOUND, or XSAN_ERROR_BUSY while a guest is still connected
+ *         (the controller keeps running).
+ */
+xsan_error_t xsan_vhost_blk_controller_destroy(const char *ctrlr_name);
+
+/**
+ * @brief Destroys every controller, as xsan_vhost_blk_controller_destroy. Called by
+ * xsan_vhost_subsystem_fini. Must be called from the SPDK app thread.
+ * @return The number of controllers left running because a guest was still connected.
+ */
+uint32_t xsan_vhost_blk_controller_destroy_all(void);
+
+/**
+ * @brief Looks up a controller.
+ * @param ctrlr_name Name of the controller.
+ * @param info Filled on success. Must not be NULL.
+ * @return XSAN_OK, XSAN_ERROR_INVALID_PARAM or XSAN_ERROR_NOT_FOUND.
+ */
+xsan_error_t xsan_vhost_blk_controller_get_info(const char *ctrlr_name, xsan_vhost_blk_controller_info_t *info);
 
 #ifdef __cplusplus
 }
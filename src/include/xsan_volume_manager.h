@@ -5,6 +5,7 @@
 #include "xsan_storage.h" // For xsan_volume_t, xsan_group_id_t, xsan_volume_id_t, xsan_disk_id_t
 #include "../../include/xsan_error.h"   // For xsan_error_t
 #include "xsan_disk_manager.h" // For xsan_disk_manager_t (as a dependency)
+#include "xsan_range_lock.h"   // For xsan_range_lock_stats_t
 
 #ifdef __cplusplus
 extern "C" {
@@ -16,6 +17,39 @@ extern "C" {
  */
 typedef struct xsan_volume_manager xsan_volume_manager_t;
 
+/** Default time a replicated write waits for its remote replicas before failing them. */
+#define XSAN_REPLICA_WRITE_DEFAULT_TIMEOUT_US (5ULL * 1000 * 1000)
+
+/** Default time a read waits for a remote replica before trying the next one. */
+#define XSAN_REPLICA_READ_DEFAULT_TIMEOUT_US (2ULL * 1000 * 1000)
+
+/**
+ * @brief Deadline settings and counters for remote replica operations.
+ */
+typedef struct xsan_replica_timeout_stats {
+    uint64_t write_timeout_us;          ///< Current write deadline (0 = disabled)
+    uint64_t read_timeout_us;           ///< Current read attempt deadline (0 = disabled)
+    uint64_t writes_timed_out;          ///< Replicated writes completed by their deadline
+    uint64_t write_legs_timed_out;      ///< Remote write legs failed by a deadline
+    uint64_t write_deadline_extensions; ///< Write deadlines extended while the local write was still running
+    uint64_t read_attempts_timed_out;   ///< Remote read attempts abandoned for the next replica
+    uint64_t chain_forwards_timed_out;  ///< Mid-chain forwards acked upstream without a downstream answer
+} xsan_replica_timeout_stats_t;
+
+/**
+ * @brief Volume lifecycle events reported to the registered event callback.
+ */
+typedef enum {
+    XSAN_VOLUME_EVENT_CREATED = 0,  ///< The volume was created and is in the managed list
+    XSAN_VOLUME_EVENT_DELETING,     ///< The volume is about to be deleted; it is freed right after the callback
+} xsan_volume_event_t;
+
+/**
+ * @brief Receives volume lifecycle events, on the thread that created or deleted the volume.
+ * Called without the volume manager's lock held. The volume pointer is only valid during the call.
+ */
+typedef void (*xsan_volume_event_cb_t)(void *cb_arg, xsan_volume_event_t event, const xsan_volume_t *volume);
+
 /**
  * @brief Initializes the XSAN Volume Manager.
  * This function should be called once during application startup, after the
@@ -41,6 +75,7 @@ void xsan_volume_manager_fini(xsan_volume_manager_t **vm_ptr);
 
 /**
  * @brief Creates a new logical volume.
+ * Waits for the metadata store write; SPDK reactors should use xsan_volume_create_many_async.
  *
  * @param vm The volume manager instance. Must not be NULL.
  * @param name The desired name for the new volume. Must be unique. Must not be NULL.
@@ -65,6 +100,61 @@ xsan_error_t xsan_volume_create(xsan_volume_manager_t *vm,
                                 uint32_t ftt, // Failures To Tolerate
                                 xsan_volume_id_t *new_volume_id_out);
 
+/**
+ * @brief Parameters of one volume for xsan_volume_create_many (same meaning as the
+ *        arguments of xsan_volume_create).
+ */
+typedef struct {
+    const char *name;
+    uint64_t size_bytes;
+    xsan_group_id_t group_id;
+    uint32_t logical_block_size_bytes;
+    bool thin_provisioned;
+    uint32_t ftt;
+} xsan_volume_create_spec_t;
+
+/**
+ * @brief Creates several volumes at once. The metadata of all of them is committed in a single
+ *        atomic metadata-store write: either every volume is created or none is.
+ *
+ * @param vm The volume manager instance. Must not be NULL.
+ * @param specs Array of count volume specifications; names must be unique among themselves too.
+ * @param count Number of volumes to create. Must be > 0.
+ * @param new_volume_ids_out Optional array of count entries receiving the new volume IDs. Can be NULL.
+ * @return XSAN_OK if all volumes were created, otherwise the first error (see xsan_volume_create)
+ *         and no volume is created.
+ */
+xsan_error_t xsan_volume_create_many(xsan_volume_manager_t *vm,
+                                     const xsan_volume_create_spec_t *specs,
+                                     uint32_t count,
+                                     xsan_volume_id_t *new_volume_ids_out);
+
+/**
+ * @brief Completion of xsan_volume_create_many_async.
+ * @param volume_ids The count new volume IDs, in spec order, or NULL if status is not XSAN_OK.
+ *                   Only valid during the callback.
+ */
+typedef void (*xsan_volume_create_cb_t)(void *cb_arg, xsan_error_t status,
+                                        const xsan_volume_id_t *volume_ids, uint32_t count);
+
+/**
+ * @brief Like xsan_volume_create_many, but the metadata is committed by a metadata worker, so
+ *        the calling reactor never waits on the metadata store. xsan_volume_create and
+ *        xsan_volume_create_many block until the commit is done and are meant for callers that
+ *        are not SPDK reactors.
+ *
+ * The volumes' names count as taken from the call on. The volumes join the managed list (and
+ * XSAN_VOLUME_EVENT_CREATED is raised) right before cb runs, on the calling SPDK thread.
+ *
+ * @param cb Completion callback. Must not be NULL.
+ * @return XSAN_OK if the create was submitted (cb is then called exactly once, possibly before
+ *         this returns), otherwise an error as for xsan_volume_create_many and cb is not called.
+ */
+xsan_error_t xsan_volume_create_many_async(xsan_volume_manager_t *vm,
+                                           const xsan_volume_create_spec_t *specs,
+                                           uint32_t count,
+                                           xsan_volume_create_cb_t cb, void *cb_arg);
+
 /**
  * @brief Deletes an existing logical volume by its ID.
  *
@@ -77,6 +167,23 @@ xsan_error_t xsan_volume_create(xsan_volume_manager_t *vm,
  */
 xsan_error_t xsan_volume_delete(xsan_volume_manager_t *vm, xsan_volume_id_t volume_id);
 
+/**
+ * @brief Completion of xsan_volume_delete_async: status is the outcome of deleting the volume's
+ *        metadata records. The volume itself is already gone from the managed list.
+ */
+typedef void (*xsan_volume_delete_cb_t)(void *cb_arg, xsan_error_t status);
+
+/**
+ * @brief Like xsan_volume_delete, and cb (if not NULL) is called once the volume's records have
+ *        been deleted from the metadata store and its extents freed, on the calling SPDK thread.
+ *        Neither function waits on the metadata store.
+ *
+ * @return As for xsan_volume_delete. cb is called exactly once if XSAN_OK is returned, possibly
+ *         before this returns; otherwise it is not called.
+ */
+xsan_error_t xsan_volume_delete_async(xsan_volume_manager_t *vm, xsan_volume_id_t volume_id,
+                                      xsan_volume_delete_cb_t cb, void *cb_arg);
+
 /**
  * @brief Retrieves a managed volume by its XSAN Volume ID (UUID).
  *
@@ -187,13 +294,113 @@ xsan_error_t xsan_volume_write_async(xsan_volume_manager_t *vm,
                                      xsan_user_io_completion_cb_t user_cb,
                                      void *user_cb_arg);
 
+/**
+ * @brief Retrieves write range-lock contention statistics for a volume.
+ * Overlapping writes to a volume are serialised on a per-volume range-lock table;
+ * these counters show how often writes had to wait and for how long.
+ *
+ * @param vm The volume manager instance.
+ * @param volume_id The ID of the volume.
+ * @param stats_out Output structure for the statistics. Must not be NULL.
+ * @return XSAN_OK on success (all-zero stats if the volume has not been written yet),
+ *         XSAN_ERROR_INVALID_PARAM on bad arguments, XSAN_ERROR_NOT_FOUND if the volume does not exist.
+ */
+xsan_error_t xsan_volume_get_write_lock_stats(xsan_volume_manager_t *vm,
+                                              xsan_volume_id_t volume_id,
+                                              xsan_range_lock_stats_t *stats_out);
+
+/**
+ * @brief Selects how replicated writes to a volume are propagated to its remote replicas.
+ * In XSAN_REPLICATION_MODE_FANOUT the primary sends every write to each replica directly.
+ * In XSAN_REPLICATION_MODE_CHAIN the primary sends once to the first writable replica,
+ * which writes locally and forwards to the next; acknowledgements flow back up the chain.
+ * Chain writes use their own message types (XSAN_MSG_TYPE_REPLICA_CHAIN_WRITE_REQ/RESP), so
+ * every replica of a chain-mode volume must understand them.
+ * A mid-chain replica whose downstream hop does not answer within the write timeout acks
+ * upstream with XSAN_ERROR_TIMEOUT for the hops below it.
+ * The setting is persisted in the volume's metadata and takes effect for the next write.
+ *
+ * @param vm The volume manager instance.
+ * @param volume_id The ID of the volume.
+ * @param mode The replication mode to use.
+ * @return XSAN_OK on success, XSAN_ERROR_INVALID_PARAM on bad arguments,
+ *         XSAN_ERROR_NOT_FOUND if the volume does not exist, or an error from persisting metadata.
+ */
+xsan_error_t xsan_volume_set_replication_mode(xsan_volume_manager_t *vm,
+                                              xsan_volume_id_t volume_id,
+                                              xsan_replication_mode_t mode);
+
+/**
+ * @brief Sets the deadlines for remote replica operations.
+ * When a replicated write's deadline expires, remote legs that have not answered are failed
+ * with XSAN_ERROR_TIMEOUT, the unresponsive replicas are marked degraded, and the write
+ * completes. When a remote read attempt's deadline expires, the read moves on to the next
+ * replica. Takes effect for operations started after the call.
+ *
+ * @param vm The volume manager instance.
+ * @param write_timeout_us Deadline for replicated writes in microseconds, 0 to disable.
+ * @param read_timeout_us Deadline per remote read attempt in microseconds, 0 to disable.
+ * @return XSAN_OK on success, XSAN_ERROR_INVALID_PARAM if vm is NULL.
+ */
+xsan_error_t xsan_volume_manager_set_replica_timeouts(xsan_volume_manager_t *vm,
+                                                      uint64_t write_timeout_us,
+                                                      uint64_t read_timeout_us);
+
+/**
+ * @brief Retrieves the replica deadline settings and timeout counters.
+ *
+ * @param vm The volume manager instance.
+ * @param stats_out Output structure. Must not be NULL.
+ * @return XSAN_OK on success, XSAN_ERROR_INVALID_PARAM on bad arguments.
+ */
+xsan_error_t xsan_volume_manager_get_replica_timeout_stats(xsan_volume_manager_t *vm,
+                                                           xsan_replica_timeout_stats_t *stats_out);
+
+/**
+ * @brief Opens node-comm connections to every remote replica node of the managed volumes,
+ * so the first replicated I/O after a start does not pay for (or race on) the connect.
+ * Each distinct peer is passed once to xsan_node_comm_warm_up. Call from an SPDK thread
+ * after xsan_node_comm_init, once volumes have been loaded.
+ *
+ * @param vm The volume manager instance.
+ * @return XSAN_OK on success, XSAN_ERROR_INVALID_PARAM if vm is not initialized,
+ *         XSAN_ERROR_OUT_OF_MEMORY if not every peer could be collected.
+ */
+xsan_error_t xsan_volume_manager_warm_up_replica_connections(xsan_volume_manager_t *vm);
+
+/**
+ * @brief Registers the function told about volume creation and deletion (e.g. to export new
+ * volumes to hosts). Only one can be registered; pass NULL to clear it. Volumes that already
+ * exist are not reported; use xsan_volume_list_all for them.
+ *
+ * @param vm The volume manager instance.
+ * @param cb The callback, or NULL.
+ * @param cb_arg Argument for cb.
+ * @return XSAN_OK, or XSAN_ERROR_INVALID_PARAM if vm is not initialized.
+ */
+xsan_error_t xsan_volume_manager_set_event_cb(xsan_volume_manager_t *vm, xsan_volume_event_cb_t cb, void *cb_arg);
+
+/**
+ * @brief Returns true if the calling reactor has remote replica operations awaiting a
+ * response. Matches xsan_node_comm_poll_busy_fn_t, so it can keep the reactor's
+ * node-comm poller busy while responses are due.
+ *
+ * @param vm The volume manager instance (as void * for use as a callback argument).
+ * @return true if operations issued from this reactor are outstanding.
+ */
+bool xsan_volume_manager_remote_ops_pending(void *vm);
+
 
 // --- Replica Request Handlers (to be called by node_comm dispatcher) ---
 
 /**
- * @brief Handles an incoming XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_REQ message.
+ * @brief Handles an incoming XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_REQ or
+ * XSAN_MSG_TYPE_REPLICA_CHAIN_WRITE_REQ message.
  * This function is expected to be registered with the xsan_node_comm module.
  * It processes the write request, performs the local write, and sends a response.
+ * A chain request with downstream hops is also forwarded to the next hop; its ack is
+ * sent to the request's upstream hop once both the local write and the downstream ack
+ * (or the write timeout) have completed.
  *
  * @param conn_ctx The connection context from which the message was received.
  *                 Can be used to send a response via conn_ctx->sock.
@@ -204,6 +411,46 @@ void xsan_volume_manager_handle_replica_write_req(struct xsan_connection_ctx *co
                                                   xsan_message_t *msg,
                                                   void *cb_arg_vol_mgr);
 
+/**
+ * @brief Handles an incoming XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_RESP or
+ * XSAN_MSG_TYPE_REPLICA_CHAIN_WRITE_RESP message.
+ * Routes a fan-out response to its pending replicated write, and a chain ack to the
+ * pending chain write or, on a mid-chain replica, to the forward that is waiting for its
+ * downstream hop. Chain acks from any node other than the hop the request was sent to are dropped.
+ *
+ * @param conn_ctx The connection context from which the message was received.
+ * @param msg The received xsan_message_t. The handler is responsible for destroying it.
+ * @param cb_arg_vol_mgr The xsan_volume_manager_t instance.
+ */
+void xsan_volume_manager_handle_replica_write_resp(struct xsan_connection_ctx *conn_ctx,
+                                                   xsan_message_t *msg,
+                                                   void *cb_arg_vol_mgr);
+
+/**
+ * @brief Handles an incoming XSAN_MSG_TYPE_REPLICA_WRITE_BATCH_REQ message.
+ * Applies every write in the batch locally and replies with one
+ * XSAN_MSG_TYPE_REPLICA_WRITE_BATCH_RESP carrying a status per write, keyed by each write's TID.
+ *
+ * @param conn_ctx The connection context from which the message was received.
+ * @param msg The received xsan_message_t. The handler is responsible for destroying it.
+ * @param cb_arg_vol_mgr The xsan_volume_manager_t instance.
+ */
+void xsan_volume_manager_handle_replica_write_batch_req(struct xsan_connection_ctx *conn_ctx,
+                                                        xsan_message_t *msg,
+                                                        void *cb_arg_vol_mgr);
+
+/**
+ * @brief Handles an incoming XSAN_MSG_TYPE_REPLICA_WRITE_BATCH_RESP message.
+ * Completes the replica leg of each write in the batch individually.
+ *
+ * @param conn_ctx The connection context from which the message was received.
+ * @param msg The received xsan_message_t. The handler is responsible for destroying it.
+ * @param cb_arg_vol_mgr The xsan_volume_manager_t instance.
+ */
+void xsan_volume_manager_handle_replica_write_batch_resp(struct xsan_connection_ctx *conn_ctx,
+                                                         xsan_message_t *msg,
+                                                         void *cb_arg_vol_mgr);
+
 /**
  * @brief Handles an incoming XSAN_MSG_TYPE_REPLICA_READ_BLOCK_REQ message.
  * This function is expected to be registered with the xsan_node_comm module.
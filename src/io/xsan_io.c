@@ -199,10 +199,18 @@ xsan_error_t xsan_io_submit_request_to_bdev(xsan_io_request_t *io_req) {
     // If io_req->dma_buffer is already set and dma_buffer_is_internal is false, use it.
     // Otherwise, allocate.
 
+    size_t bdev_align = spdk_bdev_get_buf_align(bdev);
+    if (io_req->dma_buffer && !io_req->dma_buffer_is_internal &&
+        bdev_align > 1 && ((uintptr_t)io_req->dma_buffer & (bdev_align - 1)) != 0) {
+        // Caller's DMA buffer does not meet this bdev's alignment; bounce through an internal one.
+        XSAN_LOG_DEBUG("Caller DMA buffer %p not aligned to %zu for bdev '%s'; using bounce buffer.",
+                       io_req->dma_buffer, bdev_align, io_req->target_bdev_name);
+        io_req->dma_buffer = NULL;
+    }
+
     if (io_req->dma_buffer && !io_req->dma_buffer_is_internal) { // User provided DMA buffer
         payload_buffer_for_spdk = io_req->dma_buffer;
     } else { // Need to allocate internal DMA buffer
-        size_t bdev_align = spdk_bdev_get_buf_align(bdev);
         io_req->dma_buffer = xsan_bdev_dma_malloc(physical_io_size, bdev_align);
         if (!io_req->dma_buffer) {
             XSAN_LOG_ERROR("Failed to allocate DMA buffer (size %zu) for IO on bdev '%s'", physical_io_size, io_req->target_bdev_name);
@@ -6,12 +6,13 @@
 #include "xsan_volume_manager.h"
 #include "xsan_io.h"
 #include "xsan_node_comm.h"
-#include "xsan_vhost.h" // Included, though not actively used in current E2E test
+#include "xsan_vhost.h"
 #include "../../include/xsan_error.h"
 #include "xsan_string_utils.h"
 #include "xsan_cluster.h"
 #include "xsan_nvmf_target.h"
 #include "xsan_metadata_store.h" // For md_store access in e2e test
+#include "xsan_metadata_snapshot.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -32,6 +33,13 @@ xsan_node_config_t g_local_node_config;
 xsan_cluster_config_t g_cluster_config;
 static char *g_xsan_config_file = NULL;
 
+// Command line overrides, so several nodes can share one host (see tools/xsan_local_cluster.sh)
+static const char *g_spdk_json_config_file = NULL;
+static const char *g_reactor_mask = NULL;
+static const char *g_rpc_addr = "/var/tmp/xsan.sock";
+static bool g_serve_mode = false;               // Skip the E2E tests and run until SIGINT/SIGTERM
+static volatile bool g_shutdown_requested = false;
+
 // Test-related globals (from previous state, might be refactored/removed later)
 static bool g_simulate_replica_local_write_failure = false;
 typedef enum {
@@ -184,6 +192,19 @@ static void _e2e_io_completion_cb(void *cb_arg, xsan_error_t status) {
     }
 }
 
+typedef struct {
+    bool done;
+    xsan_error_t status;
+    xsan_volume_id_t vol_id;
+} xsan_e2e_volume_create_t;
+
+static void _e2e_volume_created_cb(void *cb_arg, xsan_error_t status, const xsan_volume_id_t *volume_ids, uint32_t count) {
+    xsan_e2e_volume_create_t *vc = (xsan_e2e_volume_create_t *)cb_arg;
+    if (status == XSAN_OK && count == 1) memcpy(&vc->vol_id, &volume_ids[0], sizeof(xsan_volume_id_t));
+    vc->status = status;
+    vc->done = true;
+}
+
 static void _run_e2e_core_logic_tests(xsan_disk_manager_t *dm, xsan_volume_manager_t *vm) {
     XSAN_LOG_INFO("===== Starting E2E Core Logic Tests =====");
     xsan_error_t err;
@@ -195,7 +216,8 @@ static void _run_e2e_core_logic_tests(xsan_disk_manager_t *dm, xsan_volume_manag
     uint64_t test_vol_size_mb = 20;
     uint64_t test_vol_size_bytes = test_vol_size_mb * 1024 * 1024;
     uint32_t test_vol_block_size = 4096;
-    uint32_t test_vol_ftt = 0;
+    // Non-zero places replicas on the seed nodes (e.g. a tools/xsan_local_cluster.sh cluster)
+    uint32_t test_vol_ftt = (uint32_t)xsan_config_get_long(g_xsan_config, "e2e_volume_ftt", 0);
     xsan_volume_id_t vol_id = {0}; // Initialize
     xsan_volume_t *vol = NULL;
     uint32_t test_nsid = 1;
@@ -207,7 +229,14 @@ static void _run_e2e_core_logic_tests(xsan_disk_manager_t *dm, xsan_volume_manag
     XSAN_LOG_INFO("[E2E Test] Disk group '%s' (ID: %s) created.", test_dg_name, spdk_uuid_get_string((struct spdk_uuid*)&dg_id.data[0]));
 
     XSAN_LOG_INFO("[E2E Test] Creating volume '%s' (Size: %lu MB, FTT: %u)...", test_vol_name, test_vol_size_mb, test_vol_ftt);
-    err = xsan_volume_create(vm, test_vol_name, test_vol_size_bytes, dg_id, test_vol_block_size, false, test_vol_ftt, &vol_id);
+    xsan_volume_create_spec_t vol_spec = { .name = test_vol_name, .size_bytes = test_vol_size_bytes, .group_id = dg_id,
+                                           .logical_block_size_bytes = test_vol_block_size, .thin_provisioned = false, .ftt = test_vol_ftt };
+    xsan_e2e_volume_create_t vol_create = { .done = false, .status = XSAN_OK };
+    err = xsan_volume_create_many_async(vm, &vol_spec, 1, _e2e_volume_created_cb, &vol_create);
+    // The metadata commit completes on this thread: poll it until the volume is in.
+    while (err == XSAN_OK && !vol_create.done) { spdk_thread_poll(spdk_get_thread(), 0, 0); usleep(500); }
+    if (err == XSAN_OK) err = vol_create.status;
+    if (err == XSAN_OK) memcpy(&vol_id, &vol_create.vol_id, sizeof(xsan_volume_id_t));
     if (err != XSAN_OK) { XSAN_LOG_ERROR("[E2E Test] Failed to create volume '%s': %s", test_vol_name, xsan_error_string(err)); goto cleanup_dg_e2e; }
     vol = xsan_volume_get_by_id(vm, vol_id);
     if (!vol) { XSAN_LOG_ERROR("[E2E Test] Volume '%s' created but get_by_id failed!", test_vol_name); goto cleanup_dg_e2e;}
@@ -218,7 +247,20 @@ static void _run_e2e_core_logic_tests(xsan_disk_manager_t *dm, xsan_volume_manag
     char e2e_alloc_meta_key[XSAN_MAX_NAME_LEN + SPDK_UUID_STRING_LEN];
     snprintf(e2e_alloc_meta_key, sizeof(e2e_alloc_meta_key), "%s%s", XSAN_VOL_ALLOC_META_PREFIX, spdk_uuid_get_string((struct spdk_uuid*)&vol_id.data[0]));
     char *e2e_alloc_meta_json = NULL; size_t e2e_alloc_meta_json_len = 0;
-    if (g_xsan_volume_manager_instance && g_xsan_volume_manager_instance->md_store && // Check vm and md_store
+    if (xsan_config_get_bool(g_xsan_config, "nvmf.auto_export", true)) {
+        // The export is queued on this thread: poll it until the namespace is in.
+        for (int i = 0; i < 1000 && xsan_nvmf_target_get_volume_nsid(vol_id) == 0; ++i) {
+            spdk_thread_poll(spdk_get_thread(), 0, 0);
+            usleep(1000);
+        }
+        uint32_t auto_nsid = xsan_nvmf_target_get_volume_nsid(vol_id);
+        if (auto_nsid != 0) {
+            char vol_uuid_str[SPDK_UUID_STRING_LEN];
+            spdk_uuid_fmt_lower(vol_uuid_str, sizeof(vol_uuid_str), (struct spdk_uuid*)&vol_id.data[0]);
+            XSAN_LOG_INFO("[E2E Test] Volume '%s' exported as NSID %u, NGUID %s (bdev %s%s).", test_vol_name, auto_nsid,
+                          vol_uuid_str, XSAN_NVMF_VOLUME_BDEV_PREFIX, vol_uuid_str);
+        } else { XSAN_LOG_WARN("[E2E Test] Volume '%s' has not been exported yet.", test_vol_name); }
+    } else if (g_xsan_volume_manager_instance && g_xsan_volume_manager_instance->md_store && // Check vm and md_store
         xsan_metadata_store_get(g_xsan_volume_manager_instance->md_store, e2e_alloc_meta_key, strlen(e2e_alloc_meta_key), &e2e_alloc_meta_json, &e2e_alloc_meta_json_len) == XSAN_OK && e2e_alloc_meta_json) {
         if (_xsan_json_string_to_volume_allocation_meta(e2e_alloc_meta_json, &e2e_alloc_meta) == XSAN_OK && e2e_alloc_meta && e2e_alloc_meta->num_extents > 0) {
             xsan_disk_t *first_disk_for_vol = xsan_disk_manager_find_disk_by_id(dm, e2e_alloc_meta->extents[0].disk_id);
@@ -308,6 +350,55 @@ test_end_e2e:
 }
 
 
+typedef struct {
+    bool done;
+    xsan_error_t status;
+} xsan_node_md_bootstrap_t;
+
+static void _xsan_node_md_bootstrap_done(void *cb_arg, xsan_error_t status) {
+    xsan_node_md_bootstrap_t *bs = (xsan_node_md_bootstrap_t *)cb_arg;
+    bs->status = status;
+    bs->done = true;
+}
+
+// A node without a metadata DB (new, or replacing a failed one) copies a peer's instead of starting
+// empty: the peer streams a checkpoint, which is installed as the node DB as is.
+static xsan_error_t _xsan_node_bootstrap_metadata(void) {
+    const char *peer = xsan_config_get_string(g_xsan_config, "metadata.bootstrap_peer", "");
+    if (peer[0] == '\0' || xsan_metadata_store_node_exists()) {
+        return XSAN_OK;
+    }
+    const char *incoming = XSAN_METADATA_NODE_DB_PATH ".bootstrap";
+    if (access(incoming, F_OK) == 0) {
+        // Fetched and verified by an earlier start that stopped before installing it
+        return xsan_metadata_store_node_install(incoming);
+    }
+    uint16_t port = (uint16_t)xsan_config_get_int(g_xsan_config, "metadata.bootstrap_port", g_local_node_config.port);
+    uint32_t chunk_bytes = (uint32_t)xsan_config_get_long(g_xsan_config, "metadata.snapshot_chunk_kb",
+                                                          XSAN_METADATA_SNAPSHOT_DEFAULT_CHUNK_BYTES >> 10) << 10;
+    uint32_t timeout_ms = (uint32_t)xsan_config_get_long(g_xsan_config, "metadata.bootstrap_timeout_ms",
+                                                         XSAN_METADATA_SNAPSHOT_DEFAULT_IDLE_TIMEOUT_MS);
+    xsan_node_md_bootstrap_t bs = { false, XSAN_OK };
+    xsan_error_t err = xsan_metadata_snapshot_fetch(peer, port, incoming, chunk_bytes, timeout_ms,
+                                                    _xsan_node_md_bootstrap_done, &bs);
+    if (err != XSAN_OK) {
+        return err;
+    }
+    while (!bs.done) {
+        if (g_shutdown_requested) {
+            xsan_metadata_snapshot_fetch_abort();
+            break;
+        }
+        if (spdk_thread_poll(spdk_get_thread(), 0, 0) == 0) {
+            usleep(100);
+        }
+    }
+    if (bs.status != XSAN_OK) {
+        return bs.status;
+    }
+    return xsan_metadata_store_node_install(incoming);
+}
+
 static void xsan_node_main_spdk_thread_start(void *arg1, int spdk_startup_rc) {
     XSAN_LOG_INFO("XSAN Node main SPDK thread started. SPDK Startup RC: %d", spdk_startup_rc);
     if (spdk_startup_rc != 0) {
@@ -339,31 +430,133 @@ static void xsan_node_main_spdk_thread_start(void *arg1, int spdk_startup_rc) {
         XSAN_LOG_WARN("Failed to parse cluster-specific config.");
     }
 
+    xsan_metadata_store_opts_t md_opts;
+    xsan_metadata_store_opts_init(&md_opts);
+    const char *md_backend = xsan_config_get_string(g_xsan_config, "metadata.backend", "rocksdb");
+    if (strcmp(md_backend, "memlog") == 0) {
+        md_opts.backend = XSAN_METADATA_BACKEND_MEMLOG;
+    } else if (strcmp(md_backend, "rocksdb") != 0) {
+        XSAN_LOG_WARN("Unknown metadata.backend '%s'; using rocksdb.", md_backend);
+    }
+    md_opts.memlog_compact_min_bytes = (uint64_t)xsan_config_get_long(g_xsan_config, "metadata.memlog_compact_min_mb",
+                                                                      (long)(md_opts.memlog_compact_min_bytes >> 20)) << 20;
+    md_opts.memlog_compact_ratio = (uint32_t)xsan_config_get_int(g_xsan_config, "metadata.memlog_compact_ratio",
+                                                                 (int)md_opts.memlog_compact_ratio);
+    md_opts.memlog_sync = xsan_config_get_bool(g_xsan_config, "metadata.memlog_sync", md_opts.memlog_sync);
+    md_opts.block_cache_bytes = (size_t)xsan_config_get_long(g_xsan_config, "metadata.block_cache_mb",
+                                                             (long)(md_opts.block_cache_bytes >> 20)) << 20;
+    md_opts.bloom_bits_per_key = xsan_config_get_int(g_xsan_config, "metadata.bloom_bits_per_key", md_opts.bloom_bits_per_key);
+    md_opts.whole_key_filtering = xsan_config_get_bool(g_xsan_config, "metadata.whole_key_filtering", md_opts.whole_key_filtering);
+    md_opts.prefix_bloom = xsan_config_get_bool(g_xsan_config, "metadata.prefix_bloom", md_opts.prefix_bloom);
+    md_opts.max_background_jobs = xsan_config_get_int(g_xsan_config, "metadata.max_background_jobs", md_opts.max_background_jobs);
+    md_opts.parallelism = xsan_config_get_int(g_xsan_config, "metadata.parallelism", md_opts.parallelism);
+    md_opts.memtable_budget_bytes = (uint64_t)xsan_config_get_long(g_xsan_config, "metadata.memtable_budget_mb", 0) << 20;
+    md_opts.enable_statistics = xsan_config_get_bool(g_xsan_config, "metadata.statistics", md_opts.enable_statistics);
+    md_opts.stats_dump_period_sec = (unsigned int)xsan_config_get_int(g_xsan_config, "metadata.stats_dump_period_sec", 0);
+    if (xsan_metadata_store_set_default_opts(&md_opts) != XSAN_OK) {
+        XSAN_LOG_WARN("Ignoring invalid metadata.* settings; using the default metadata store profile.");
+    }
+    // Metadata writes on the I/O and state-change paths run on these threads instead of the reactors.
+    uint32_t md_async_workers = (uint32_t)xsan_config_get_int(g_xsan_config, "metadata.async_workers", 1);
+    if (xsan_metadata_async_init(md_async_workers) != XSAN_OK) {
+        XSAN_LOG_WARN("Metadata worker threads unavailable (metadata.async_workers=%u); metadata operations will run inline.",
+                      md_async_workers);
+    }
+
     xsan_disk_manager_t *disk_manager = NULL;
     xsan_volume_manager_t *volume_manager = NULL;
 
     if (xsan_cluster_init(config_file_to_load) != XSAN_OK) {
         XSAN_LOG_FATAL("Failed to init XSAN Cluster Manager. Shutting down."); goto app_cleanup_stop;
     }
+    if (xsan_node_comm_init(g_local_node_config.bind_address, g_local_node_config.port, NULL, NULL) != XSAN_OK) {
+         XSAN_LOG_FATAL("Failed to init XSAN node comm server on %s:%u. Shutting down.",
+                       g_local_node_config.bind_address, g_local_node_config.port);
+        goto cluster_cleanup_stop;
+    }
+    xsan_node_comm_set_crc32c(xsan_config_get_bool(g_xsan_config, "comm_crc32c", true));
+    xsan_node_comm_set_frame_batching(xsan_config_get_bool(g_xsan_config, "comm_frame_batching", true));
+    if (xsan_node_comm_set_max_protocol_version((uint16_t)xsan_config_get_long(g_xsan_config, "comm_protocol_version",
+                                                                               XSAN_PROTOCOL_VERSION)) != XSAN_OK) {
+        XSAN_LOG_WARN("Ignoring comm_protocol_version; advertising v%u.", XSAN_PROTOCOL_VERSION);
+    }
+    if (xsan_node_comm_set_flow_control(xsan_config_get_bool(g_xsan_config, "comm_flow_control", true),
+                                        (uint32_t)xsan_config_get_long(g_xsan_config, "comm_flow_window_bytes",
+                                                                       XSAN_NODE_COMM_FLOW_DEFAULT_WINDOW_BYTES),
+                                        (uint32_t)xsan_config_get_long(g_xsan_config, "comm_flow_window_msgs",
+                                                                       XSAN_NODE_COMM_FLOW_DEFAULT_WINDOW_MSGS)) != XSAN_OK) {
+        XSAN_LOG_WARN("Ignoring invalid comm_flow_window_* settings; using the default windows.");
+    }
+    if (xsan_config_get_bool(g_xsan_config, "comm_compression", false) &&
+        xsan_node_comm_set_compression(true, (uint32_t)xsan_config_get_long(g_xsan_config, "comm_compress_min_bytes",
+                                                                            XSAN_NODE_COMM_COMPRESS_DEFAULT_MIN_BYTES)) != XSAN_OK) {
+        XSAN_LOG_WARN("comm_compression is set but LZ4 compression is not available; sending payloads uncompressed.");
+    }
+    xsan_node_comm_poll_opts_t poll_opts;
+    xsan_node_comm_poll_opts_init(&poll_opts);
+    poll_opts.busy_window_us = (uint32_t)xsan_config_get_long(g_xsan_config, "comm_poll_busy_window_us", poll_opts.busy_window_us);
+    poll_opts.backoff_min_us = (uint32_t)xsan_config_get_long(g_xsan_config, "comm_poll_backoff_min_us", poll_opts.backoff_min_us);
+    poll_opts.backoff_max_us = (uint32_t)xsan_config_get_long(g_xsan_config, "comm_poll_backoff_max_us", poll_opts.backoff_max_us);
+    poll_opts.park_after_us = (uint32_t)xsan_config_get_long(g_xsan_config, "comm_poll_park_after_ms", 0) * 1000;
+    if (xsan_node_comm_set_poll_opts(&poll_opts) != XSAN_OK) {
+        XSAN_LOG_WARN("Ignoring invalid comm_poll_* settings; using the polling defaults.");
+    }
+    if (xsan_metadata_snapshot_register_handlers() != XSAN_OK) {
+        XSAN_LOG_FATAL("Failed to register metadata snapshot handlers. Shutting down.");
+        goto comm_cleanup_stop;
+    }
+    // Before the managers open the node metadata store, so a new node starts with the cluster's records.
+    if (_xsan_node_bootstrap_metadata() != XSAN_OK) {
+        XSAN_LOG_FATAL("Failed to bootstrap node metadata from metadata.bootstrap_peer. Shutting down.");
+        goto comm_cleanup_stop;
+    }
     if (xsan_disk_manager_init(&disk_manager) != XSAN_OK) {
-        XSAN_LOG_FATAL("Failed to init XSAN Disk Manager. Shutting down."); goto cluster_cleanup_stop;
+        XSAN_LOG_FATAL("Failed to init XSAN Disk Manager. Shutting down."); goto comm_cleanup_stop;
     }
     xsan_disk_manager_scan_and_register_bdevs(disk_manager);
     if (xsan_volume_manager_init(disk_manager, &volume_manager) != XSAN_OK) {
-        XSAN_LOG_FATAL("Failed to init XSAN Volume Manager. Shutting down."); goto dm_cleanup_stop;
-    }
-    if (xsan_node_comm_init(g_local_node_config.bind_address, g_local_node_config.port, NULL, NULL) != XSAN_OK) {
-         XSAN_LOG_FATAL("Failed to init XSAN node comm server on %s:%u. Shutting down.",
-                       g_local_node_config.bind_address, g_local_node_config.port);
-        goto vm_cleanup_stop;
+        XSAN_LOG_FATAL("Failed to init XSAN Volume Manager. Shutting down."); goto comm_cleanup_stop;
     }
+    xsan_volume_manager_set_replica_timeouts(volume_manager,
+        (uint64_t)xsan_config_get_long(g_xsan_config, "replica_write_timeout_ms", (long)(XSAN_REPLICA_WRITE_DEFAULT_TIMEOUT_US / 1000)) * 1000,
+        (uint64_t)xsan_config_get_long(g_xsan_config, "replica_read_timeout_ms", (long)(XSAN_REPLICA_READ_DEFAULT_TIMEOUT_US / 1000)) * 1000);
+    xsan_node_comm_set_poll_busy_hint(xsan_volume_manager_remote_ops_pending, volume_manager);
     if (xsan_node_comm_register_message_handler(XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_REQ,
                                                 xsan_volume_manager_handle_replica_write_req, volume_manager) != XSAN_OK ||
+        xsan_node_comm_register_message_handler(XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_RESP,
+                                                xsan_volume_manager_handle_replica_write_resp, volume_manager) != XSAN_OK ||
+        xsan_node_comm_register_message_handler(XSAN_MSG_TYPE_REPLICA_CHAIN_WRITE_REQ,
+                                                xsan_volume_manager_handle_replica_write_req, volume_manager) != XSAN_OK ||
+        xsan_node_comm_register_message_handler(XSAN_MSG_TYPE_REPLICA_CHAIN_WRITE_RESP,
+                                                xsan_volume_manager_handle_replica_write_resp, volume_manager) != XSAN_OK ||
+        xsan_node_comm_register_message_handler(XSAN_MSG_TYPE_REPLICA_WRITE_BATCH_REQ,
+                                                xsan_volume_manager_handle_replica_write_batch_req, volume_manager) != XSAN_OK ||
+        xsan_node_comm_register_message_handler(XSAN_MSG_TYPE_REPLICA_WRITE_BATCH_RESP,
+                                                xsan_volume_manager_handle_replica_write_batch_resp, volume_manager) != XSAN_OK ||
         xsan_node_comm_register_message_handler(XSAN_MSG_TYPE_REPLICA_READ_BLOCK_REQ,
                                                 xsan_volume_manager_handle_replica_read_req, volume_manager) != XSAN_OK) {
         XSAN_LOG_FATAL("Failed to register replica op handlers. Shutting down.");
         goto comm_cleanup_stop;
     }
+    if (xsan_config_get_bool(g_xsan_config, "comm_warm_up", true)) {
+        xsan_volume_manager_warm_up_replica_connections(volume_manager);
+    }
+    xsan_nvmf_target_opts_t nvmf_opts;
+    xsan_nvmf_target_opts_init(&nvmf_opts);
+    xsan_strcpy_safe(nvmf_opts.poll_group_mask, xsan_config_get_string(g_xsan_config, "nvmf.poll_group_mask", ""),
+                     sizeof(nvmf_opts.poll_group_mask));
+    nvmf_opts.max_queue_depth = (uint32_t)xsan_config_get_long(g_xsan_config, "nvmf.max_queue_depth", 0);
+    nvmf_opts.max_qpairs_per_ctrlr = (uint32_t)xsan_config_get_long(g_xsan_config, "nvmf.max_qpairs_per_ctrlr", 0);
+    nvmf_opts.in_capsule_data_size = (uint32_t)xsan_config_get_long(g_xsan_config, "nvmf.in_capsule_data_size", 0);
+    nvmf_opts.io_unit_size = (uint32_t)xsan_config_get_long(g_xsan_config, "nvmf.io_unit_size", 0);
+    nvmf_opts.max_io_size = (uint32_t)xsan_config_get_long(g_xsan_config, "nvmf.max_io_size", 0);
+    nvmf_opts.num_shared_buffers = (uint32_t)xsan_config_get_long(g_xsan_config, "nvmf.num_shared_buffers", 0);
+    nvmf_opts.buf_cache_size = (uint32_t)xsan_config_get_long(g_xsan_config, "nvmf.buf_cache_size", 0);
+    nvmf_opts.zcopy_send = xsan_config_get_bool(g_xsan_config, "nvmf.zcopy_send", false);
+    nvmf_opts.max_namespaces = (uint32_t)xsan_config_get_long(g_xsan_config, "nvmf.max_namespaces", 0);
+    if (xsan_nvmf_target_set_opts(&nvmf_opts) != XSAN_OK) {
+        XSAN_LOG_WARN("Ignoring invalid nvmf.* settings; using SPDK's TCP transport defaults on every reactor.");
+    }
     if (xsan_nvmf_target_init(g_local_node_config.nvmf_target_nqn,
                                g_local_node_config.bind_address,
                                g_local_node_config.nvmf_listen_port) != XSAN_OK) {
@@ -371,53 +564,110 @@ static void xsan_node_main_spdk_thread_start(void *arg1, int spdk_startup_rc) {
         goto comm_cleanup_stop;
     }
     XSAN_LOG_INFO("XSAN NVMe-oF Target initialized.");
+    if (xsan_vhost_subsystem_init(volume_manager) != XSAN_OK) {
+        XSAN_LOG_FATAL("Failed to initialize the XSAN vbdev module. Shutting down.");
+        xsan_nvmf_target_fini();
+        goto comm_cleanup_stop;
+    }
+    xsan_vhost_blk_opts_t vhost_blk_opts;
+    xsan_vhost_blk_opts_init(&vhost_blk_opts);
+    xsan_strcpy_safe(vhost_blk_opts.cpumask, xsan_config_get_string(g_xsan_config, "vhost_blk.cpumask", ""),
+                     sizeof(vhost_blk_opts.cpumask));
+    xsan_strcpy_safe(vhost_blk_opts.socket_dir, xsan_config_get_string(g_xsan_config, "vhost_blk.socket_dir", ""),
+                     sizeof(vhost_blk_opts.socket_dir));
+    vhost_blk_opts.spread_controllers = xsan_config_get_bool(g_xsan_config, "vhost_blk.spread", true);
+    if (xsan_vhost_blk_set_opts(&vhost_blk_opts) != XSAN_OK) {
+        XSAN_LOG_WARN("Ignoring invalid vhost_blk.* settings; controllers use every reactor and SPDK's socket directory.");
+    }
+    if (xsan_config_get_bool(g_xsan_config, "nvmf.auto_export", true) &&
+        xsan_nvmf_target_enable_auto_export(volume_manager) != XSAN_OK) {
+        XSAN_LOG_WARN("Volumes will not be exported as NVMe-oF namespaces automatically.");
+    }
 
-    XSAN_LOG_INFO("XSAN Node subsystems initialized. Running E2E tests or waiting for events...");
     g_async_io_test_controller.test_finished_signal = false;
-    _run_e2e_core_logic_tests(disk_manager, volume_manager);
+    if (g_serve_mode) {
+        XSAN_LOG_INFO("XSAN Node subsystems initialized. Serving until SIGINT/SIGTERM...");
+    } else {
+        XSAN_LOG_INFO("XSAN Node subsystems initialized. Running E2E tests or waiting for events...");
+        _run_e2e_core_logic_tests(disk_manager, volume_manager);
+    }
 
-    while (!g_async_io_test_controller.test_finished_signal) {
+    while (!g_async_io_test_controller.test_finished_signal && !g_shutdown_requested) {
         spdk_thread_poll(spdk_get_thread(), 0, 0);
         usleep(10000);
     }
 
     XSAN_LOG_INFO("XSAN Node main SPDK thread tasks complete. Cleaning up XSAN subsystems...");
     xsan_nvmf_target_fini();
+    xsan_vhost_subsystem_fini();
 comm_cleanup_stop:
     xsan_node_comm_fini();
-vm_cleanup_stop:
+    xsan_metadata_async_fini(); // Drain queued metadata writes while the stores are still open
     xsan_volume_manager_fini(&volume_manager);
-dm_cleanup_stop:
     xsan_disk_manager_fini(&disk_manager);
 cluster_cleanup_stop:
     xsan_cluster_shutdown();
 app_cleanup_stop:
+    xsan_metadata_async_fini(); // No-op if already stopped above
     if (g_xsan_config) { xsan_config_destroy(g_xsan_config); g_xsan_config = NULL; }
     XSAN_LOG_INFO("XSAN subsystems cleaned up. Requesting SPDK application stop.");
     xsan_spdk_manager_request_app_stop();
 }
 
+// Runs on the SPDK app thread (polled by the main loop above) when a stop signal arrives.
+static void xsan_node_shutdown_cb(void) {
+    XSAN_LOG_INFO("Shutdown signal received.");
+    g_shutdown_requested = true;
+}
+
 static void print_usage(const char *program_name) {
     printf("Usage: %s [options]\n", program_name);
     printf("Options:\n");
     printf("  -c, --config FILE      Path to XSAN node configuration file (default: xsan_node.conf)\n");
+    printf("  -j, --spdk-config FILE SPDK JSON configuration (e.g. bdevs to create at startup)\n");
+    printf("  -m, --cpumask MASK     SPDK reactor core mask (default: SPDK default)\n");
+    printf("  -r, --rpc-socket PATH  SPDK RPC listen address (default: /var/tmp/xsan.sock)\n");
+    printf("  -d, --work-dir DIR     Change to DIR before starting; metadata DBs are created under it\n");
+    printf("                         and relative paths in the other options are resolved against it\n");
+    printf("  -s, --serve            Skip the built-in E2E tests and run until SIGINT/SIGTERM\n");
     printf("  -h, --help             Show this help message\n");
 }
 
 int main(int argc, char **argv) {
     struct option long_options[] = {
         {"config", required_argument, 0, 'c'},
+        {"spdk-config", required_argument, 0, 'j'},
+        {"cpumask", required_argument, 0, 'm'},
+        {"rpc-socket", required_argument, 0, 'r'},
+        {"work-dir", required_argument, 0, 'd'},
+        {"serve",  no_argument,       0, 's'},
         {"help",   no_argument,       0, 'h'},
         {0, 0, 0, 0}
     };
     int opt;
+    const char *work_dir = NULL;
     g_xsan_config_file = "xsan_node.conf";
 
-    while ((opt = getopt_long(argc, argv, "c:h", long_options, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "c:j:m:r:d:sh", long_options, NULL)) != -1) {
         switch (opt) {
             case 'c':
                 g_xsan_config_file = optarg;
                 break;
+            case 'j':
+                g_spdk_json_config_file = optarg;
+                break;
+            case 'm':
+                g_reactor_mask = optarg;
+                break;
+            case 'r':
+                g_rpc_addr = optarg;
+                break;
+            case 'd':
+                work_dir = optarg;
+                break;
+            case 's':
+                g_serve_mode = true;
+                break;
             case 'h':
                 print_usage(argv[0]);
                 return 0;
@@ -427,8 +677,14 @@ int main(int argc, char **argv) {
         }
     }
 
+    if (work_dir && chdir(work_dir) != 0) {
+        fprintf(stderr, "Cannot change to work dir '%s': %s\n", work_dir, strerror(errno));
+        return 1;
+    }
+
     XSAN_LOG_INFO("XSAN Node application starting...");
-    xsan_spdk_manager_opts_init("xsan_node_spdk_app", NULL, NULL, true, "/var/tmp/xsan.sock");
+    xsan_spdk_manager_opts_init("xsan_node_spdk_app", g_spdk_json_config_file, g_reactor_mask, true, g_rpc_addr);
+    xsan_spdk_manager_set_shutdown_cb(xsan_node_shutdown_cb);
     if (xsan_spdk_manager_start_app(xsan_node_main_spdk_thread_start, NULL) != XSAN_OK) {
         XSAN_LOG_FATAL("Failed to start SPDK application framework.");
         if (g_xsan_config) xsan_config_destroy(g_xsan_config); // Ensure config is freed on early exit
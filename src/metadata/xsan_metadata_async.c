@@ -0,0 +1,454 @@
+// 元数据异步接口: 操作在专用的元数据工作线程上执行, 完成回调通过 spdk_thread_send_msg 投递回调用者线程
+#include "xsan_metadata_store.h"
+#include "xsan_memory.h"
+#include "../../include/xsan_error.h"
+#include "xsan_log.h"
+
+#include "spdk/thread.h"
+#include <pthread.h>
+#include <string.h>
+#include <stdint.h>
+
+#define XSAN_METADATA_ASYNC_MAX_WORKERS 16
+
+typedef enum {
+    XSAN_MD_OP_PUT,
+    XSAN_MD_OP_GET,
+    XSAN_MD_OP_DELETE,
+    XSAN_MD_OP_BATCH,
+    XSAN_MD_OP_SCAN_PREFIX,
+} xsan_md_op_type_t;
+
+typedef struct xsan_md_op {
+    struct xsan_md_op *next;
+    xsan_md_op_type_t type;
+    xsan_metadata_store_t *store;
+    char *key;                      // Key, or prefix for scans
+    size_t key_len;
+    char *value;                    // Put input, get output
+    size_t value_len;
+    xsan_metadata_batch_t *batch;   // Owned; destroyed after the commit
+    xsan_metadata_kv_t *kvs;        // Scan output
+    size_t num_kvs;
+    xsan_error_t status;
+    xsan_metadata_done_cb_t done_cb;
+    xsan_metadata_get_cb_t get_cb;
+    xsan_metadata_scan_cb_t scan_cb;
+    void *cb_arg;
+    struct spdk_thread *origin;     // Completion goes back here; NULL for non-SPDK callers
+    // Multi-record batches are queued on every worker as tickets; the last worker to reach its
+    // ticket runs the batch while the others wait for it (see _xsan_md_barrier_arrive).
+    struct xsan_md_op *barrier_op;  // Ticket: the batch it stands for
+    uint64_t barrier_seq;           // Ticket: position of the batch among all barriers
+    uint32_t barrier_pending;       // Batch: workers that have not reached their ticket yet
+} xsan_md_op_t;
+
+typedef struct {
+    pthread_t tid;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    xsan_md_op_t *head;
+    xsan_md_op_t *tail;
+    bool stop;
+    uint32_t index;
+} xsan_md_worker_t;
+
+static struct {
+    xsan_md_worker_t *workers;
+    uint32_t num_workers;
+    bool running;
+    // Barriers are queued on all workers under barrier_lock, so every worker sees them in the
+    // same order and two of them can never wait on each other.
+    pthread_mutex_t barrier_lock;
+    pthread_cond_t barrier_cond;
+    uint64_t barriers_queued;
+    uint64_t barriers_done;
+} g_xsan_md_async = {
+    .barrier_lock = PTHREAD_MUTEX_INITIALIZER,
+    .barrier_cond = PTHREAD_COND_INITIALIZER,
+};
+
+void xsan_metadata_kv_array_free(xsan_metadata_kv_t *kvs, size_t count) {
+    if (!kvs) {
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        XSAN_FREE(kvs[i].key);
+        XSAN_FREE(kvs[i].value);
+    }
+    XSAN_FREE(kvs);
+}
+
+static void _xsan_md_op_free(xsan_md_op_t *op) {
+    if (op->key) XSAN_FREE(op->key);
+    if (op->value) XSAN_FREE(op->value);
+    xsan_metadata_store_batch_destroy(op->batch);
+    xsan_metadata_kv_array_free(op->kvs, op->num_kvs);
+    XSAN_FREE(op);
+}
+
+// Runs on the caller's thread: hands results to the callback, which owns them from then on.
+static void _xsan_md_op_deliver(void *ctx) {
+    xsan_md_op_t *op = (xsan_md_op_t *)ctx;
+    switch (op->type) {
+    case XSAN_MD_OP_GET:
+        if (op->get_cb) {
+            op->get_cb(op->cb_arg, op->status, op->value, op->value_len);
+            op->value = NULL;
+        }
+        break;
+    case XSAN_MD_OP_SCAN_PREFIX:
+        if (op->scan_cb) {
+            op->scan_cb(op->cb_arg, op->status, op->kvs, op->num_kvs);
+            op->kvs = NULL;
+            op->num_kvs = 0;
+        }
+        break;
+    default:
+        if (op->done_cb) op->done_cb(op->cb_arg, op->status);
+        break;
+    }
+    _xsan_md_op_free(op);
+}
+
+static xsan_error_t _xsan_md_scan_prefix(xsan_md_op_t *op) {
+    xsan_metadata_iterator_t *iter = xsan_metadata_iterator_create_prefix(op->store, op->key, op->key_len);
+    if (!iter) {
+        return XSAN_ERROR_STORAGE_GENERIC;
+    }
+    size_t cap = 0;
+    xsan_error_t err = XSAN_OK;
+    for (; xsan_metadata_iterator_is_valid(iter); xsan_metadata_iterator_next(iter)) {
+        size_t key_len = 0, value_len = 0;
+        const char *key = xsan_metadata_iterator_key(iter, &key_len);
+        const char *value = xsan_metadata_iterator_value(iter, &value_len);
+        if (op->num_kvs == cap) {
+            size_t new_cap = cap ? cap * 2 : 16;
+            xsan_metadata_kv_t *grown = (xsan_metadata_kv_t *)XSAN_MALLOC(new_cap * sizeof(xsan_metadata_kv_t));
+            if (!grown) { err = XSAN_ERROR_NO_MEMORY; break; }
+            if (op->kvs) {
+                memcpy(grown, op->kvs, op->num_kvs * sizeof(xsan_metadata_kv_t));
+                XSAN_FREE(op->kvs);
+            }
+            op->kvs = grown;
+            cap = new_cap;
+        }
+        xsan_metadata_kv_t *kv = &op->kvs[op->num_kvs];
+        // NUL-terminated copies, like xsan_metadata_store_get values
+        kv->key = (char *)XSAN_MALLOC(key_len + 1);
+        kv->value = (char *)XSAN_MALLOC(value_len + 1);
+        if (!kv->key || !kv->value) {
+            if (kv->key) XSAN_FREE(kv->key);
+            if (kv->value) XSAN_FREE(kv->value);
+            err = XSAN_ERROR_NO_MEMORY;
+            break;
+        }
+        memcpy(kv->key, key, key_len);
+        kv->key[key_len] = '\0';
+        kv->key_len = key_len;
+        memcpy(kv->value, value, value_len);
+        kv->value[value_len] = '\0';
+        kv->value_len = value_len;
+        op->num_kvs++;
+    }
+    xsan_metadata_iterator_destroy(iter);
+    return err;
+}
+
+static void _xsan_md_op_execute(xsan_md_op_t *op) {
+    switch (op->type) {
+    case XSAN_MD_OP_PUT:
+        op->status = xsan_metadata_store_put(op->store, op->key, op->key_len, op->value, op->value_len);
+        break;
+    case XSAN_MD_OP_GET:
+        op->status = xsan_metadata_store_get(op->store, op->key, op->key_len, &op->value, &op->value_len);
+        break;
+    case XSAN_MD_OP_DELETE:
+        op->status = xsan_metadata_store_delete(op->store, op->key, op->key_len);
+        break;
+    case XSAN_MD_OP_BATCH:
+        op->status = xsan_metadata_store_batch_commit(op->store, op->batch);
+        break;
+    case XSAN_MD_OP_SCAN_PREFIX:
+        op->status = _xsan_md_scan_prefix(op);
+        break;
+    }
+}
+
+static void _xsan_md_op_complete(xsan_md_op_t *op) {
+    if (op->origin && spdk_thread_send_msg(op->origin, _xsan_md_op_deliver, op) == 0) {
+        return;
+    }
+    if (op->origin) {
+        XSAN_LOG_WARN("Cannot post metadata completion back to its SPDK thread; completing on the metadata worker.");
+    }
+    _xsan_md_op_deliver(op);
+}
+
+// Runs on a worker that reached its ticket for a multi-record batch. Every worker stops at its
+// ticket, so all operations queued before the batch are done when it runs, and none queued
+// after it starts before it is done.
+static void _xsan_md_barrier_arrive(xsan_md_op_t *ticket) {
+    xsan_md_op_t *op = ticket->barrier_op;
+    uint64_t seq = ticket->barrier_seq;
+    XSAN_FREE(ticket);
+    pthread_mutex_lock(&g_xsan_md_async.barrier_lock);
+    if (--op->barrier_pending > 0) {
+        // op may be freed by the worker that runs it; only seq is used from here on.
+        while (g_xsan_md_async.barriers_done < seq) {
+            pthread_cond_wait(&g_xsan_md_async.barrier_cond, &g_xsan_md_async.barrier_lock);
+        }
+        pthread_mutex_unlock(&g_xsan_md_async.barrier_lock);
+        return;
+    }
+    pthread_mutex_unlock(&g_xsan_md_async.barrier_lock);
+
+    _xsan_md_op_execute(op);
+    _xsan_md_op_complete(op);
+
+    pthread_mutex_lock(&g_xsan_md_async.barrier_lock);
+    g_xsan_md_async.barriers_done = seq;
+    pthread_cond_broadcast(&g_xsan_md_async.barrier_cond);
+    pthread_mutex_unlock(&g_xsan_md_async.barrier_lock);
+}
+
+static void *_xsan_md_worker_main(void *arg) {
+    xsan_md_worker_t *worker = (xsan_md_worker_t *)arg;
+    pthread_mutex_lock(&worker->lock);
+    for (;;) {
+        while (!worker->head && !worker->stop) {
+            pthread_cond_wait(&worker->cond, &worker->lock);
+        }
+        if (!worker->head) {
+            break; // Stopping and drained
+        }
+        xsan_md_op_t *op = worker->head;
+        worker->head = op->next;
+        if (!worker->head) worker->tail = NULL;
+        pthread_mutex_unlock(&worker->lock);
+
+        if (op->barrier_op) {
+            _xsan_md_barrier_arrive(op);
+        } else {
+            _xsan_md_op_execute(op);
+            _xsan_md_op_complete(op);
+        }
+
+        pthread_mutex_lock(&worker->lock);
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return NULL;
+}
+
+xsan_error_t xsan_metadata_async_init(uint32_t num_workers) {
+    if (g_xsan_md_async.running) {
+        return XSAN_OK;
+    }
+    if (num_workers == 0 || num_workers > XSAN_METADATA_ASYNC_MAX_WORKERS) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    g_xsan_md_async.workers = (xsan_md_worker_t *)XSAN_CALLOC(num_workers, sizeof(xsan_md_worker_t));
+    if (!g_xsan_md_async.workers) {
+        return XSAN_ERROR_NO_MEMORY;
+    }
+    uint32_t started = 0;
+    for (; started < num_workers; ++started) {
+        xsan_md_worker_t *worker = &g_xsan_md_async.workers[started];
+        worker->index = started;
+        pthread_mutex_init(&worker->lock, NULL);
+        pthread_cond_init(&worker->cond, NULL);
+        if (pthread_create(&worker->tid, NULL, _xsan_md_worker_main, worker) != 0) {
+            pthread_cond_destroy(&worker->cond);
+            pthread_mutex_destroy(&worker->lock);
+            break;
+        }
+    }
+    g_xsan_md_async.num_workers = started;
+    if (started < num_workers) {
+        XSAN_LOG_ERROR("Failed to start metadata worker %u of %u.", started + 1, num_workers);
+        xsan_metadata_async_fini();
+        return XSAN_ERROR_SYSTEM;
+    }
+    g_xsan_md_async.running = true;
+    XSAN_LOG_INFO("Metadata async API started with %u worker thread(s).", num_workers);
+    return XSAN_OK;
+}
+
+void xsan_metadata_async_fini(void) {
+    if (!g_xsan_md_async.workers) {
+        return;
+    }
+    g_xsan_md_async.running = false;
+    // Workers finish what is queued first, so every submitted operation still completes.
+    for (uint32_t i = 0; i < g_xsan_md_async.num_workers; ++i) {
+        xsan_md_worker_t *worker = &g_xsan_md_async.workers[i];
+        pthread_mutex_lock(&worker->lock);
+        worker->stop = true;
+        pthread_cond_signal(&worker->cond);
+        pthread_mutex_unlock(&worker->lock);
+    }
+    for (uint32_t i = 0; i < g_xsan_md_async.num_workers; ++i) {
+        xsan_md_worker_t *worker = &g_xsan_md_async.workers[i];
+        pthread_join(worker->tid, NULL);
+        pthread_cond_destroy(&worker->cond);
+        pthread_mutex_destroy(&worker->lock);
+    }
+    XSAN_FREE(g_xsan_md_async.workers);
+    g_xsan_md_async.workers = NULL;
+    g_xsan_md_async.num_workers = 0;
+    XSAN_LOG_INFO("Metadata async API stopped.");
+}
+
+static void _xsan_md_worker_enqueue(xsan_md_worker_t *worker, xsan_md_op_t *op) {
+    op->next = NULL;
+    pthread_mutex_lock(&worker->lock);
+    if (worker->tail) worker->tail->next = op;
+    else worker->head = op;
+    worker->tail = op;
+    pthread_cond_signal(&worker->cond);
+    pthread_mutex_unlock(&worker->lock);
+}
+
+// Queues a batch spanning several records as a barrier: one ticket on every worker.
+static xsan_error_t _xsan_md_op_submit_barrier(xsan_md_op_t *op) {
+    uint32_t n = g_xsan_md_async.num_workers;
+    xsan_md_op_t *tickets[XSAN_METADATA_ASYNC_MAX_WORKERS];
+    for (uint32_t i = 0; i < n; ++i) {
+        tickets[i] = (xsan_md_op_t *)XSAN_CALLOC(1, sizeof(xsan_md_op_t));
+        if (!tickets[i]) {
+            while (i > 0) XSAN_FREE(tickets[--i]);
+            return XSAN_ERROR_NO_MEMORY;
+        }
+        tickets[i]->barrier_op = op;
+    }
+    op->barrier_pending = n;
+    pthread_mutex_lock(&g_xsan_md_async.barrier_lock);
+    uint64_t seq = ++g_xsan_md_async.barriers_queued;
+    for (uint32_t i = 0; i < n; ++i) {
+        tickets[i]->barrier_seq = seq;
+        _xsan_md_worker_enqueue(&g_xsan_md_async.workers[i], tickets[i]);
+    }
+    pthread_mutex_unlock(&g_xsan_md_async.barrier_lock);
+    return XSAN_OK;
+}
+
+/**
+ * Queues op on the worker owning its record (see xsan_metadata_key_order_hash), so the operations
+ * on one record run in submission order while different records spread over the workers. A batch
+ * spanning records is queued as a barrier instead. Without running workers the operation runs
+ * inline and completes before this returns.
+ */
+static xsan_error_t _xsan_md_op_submit(xsan_md_op_t *op) {
+    op->origin = spdk_get_thread();
+    if (!g_xsan_md_async.running) {
+        _xsan_md_op_execute(op);
+        _xsan_md_op_deliver(op);
+        return XSAN_OK;
+    }
+    if (op->batch && op->batch->multi_record && g_xsan_md_async.num_workers > 1) {
+        return _xsan_md_op_submit_barrier(op);
+    }
+    uint32_t h = op->batch ? op->batch->order_hash : xsan_metadata_key_order_hash(op->key, op->key_len);
+    _xsan_md_worker_enqueue(&g_xsan_md_async.workers[h % g_xsan_md_async.num_workers], op);
+    return XSAN_OK;
+}
+
+static xsan_md_op_t *_xsan_md_op_create(xsan_md_op_type_t type, xsan_metadata_store_t *store,
+                                        const char *key, size_t key_len, void *cb_arg) {
+    xsan_md_op_t *op = (xsan_md_op_t *)XSAN_CALLOC(1, sizeof(xsan_md_op_t));
+    if (!op) {
+        return NULL;
+    }
+    op->type = type;
+    op->store = store;
+    op->cb_arg = cb_arg;
+    if (key) {
+        op->key = (char *)XSAN_MALLOC(key_len);
+        if (!op->key) {
+            XSAN_FREE(op);
+            return NULL;
+        }
+        memcpy(op->key, key, key_len);
+        op->key_len = key_len;
+    }
+    return op;
+}
+
+xsan_error_t xsan_metadata_store_put_async(xsan_metadata_store_t *store, const char *key, size_t key_len,
+                                           const char *value, size_t value_len,
+                                           xsan_metadata_done_cb_t cb, void *cb_arg) {
+    if (!store || !key || key_len == 0 || !value) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    xsan_md_op_t *op = _xsan_md_op_create(XSAN_MD_OP_PUT, store, key, key_len, cb_arg);
+    if (!op) {
+        return XSAN_ERROR_NO_MEMORY;
+    }
+    op->value = (char *)XSAN_MALLOC(value_len ? value_len : 1);
+    if (!op->value) {
+        _xsan_md_op_free(op);
+        return XSAN_ERROR_NO_MEMORY;
+    }
+    memcpy(op->value, value, value_len);
+    op->value_len = value_len;
+    op->done_cb = cb;
+    return _xsan_md_op_submit(op);
+}
+
+xsan_error_t xsan_metadata_store_get_async(xsan_metadata_store_t *store, const char *key, size_t key_len,
+                                           xsan_metadata_get_cb_t cb, void *cb_arg) {
+    if (!store || !key || key_len == 0 || !cb) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    xsan_md_op_t *op = _xsan_md_op_create(XSAN_MD_OP_GET, store, key, key_len, cb_arg);
+    if (!op) {
+        return XSAN_ERROR_NO_MEMORY;
+    }
+    op->get_cb = cb;
+    return _xsan_md_op_submit(op);
+}
+
+xsan_error_t xsan_metadata_store_delete_async(xsan_metadata_store_t *store, const char *key, size_t key_len,
+                                              xsan_metadata_done_cb_t cb, void *cb_arg) {
+    if (!store || !key || key_len == 0) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    xsan_md_op_t *op = _xsan_md_op_create(XSAN_MD_OP_DELETE, store, key, key_len, cb_arg);
+    if (!op) {
+        return XSAN_ERROR_NO_MEMORY;
+    }
+    op->done_cb = cb;
+    return _xsan_md_op_submit(op);
+}
+
+xsan_error_t xsan_metadata_store_batch_commit_async(xsan_metadata_store_t *store, xsan_metadata_batch_t *batch,
+                                                    xsan_metadata_done_cb_t cb, void *cb_arg) {
+    if (!store || !batch) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    xsan_md_op_t *op = _xsan_md_op_create(XSAN_MD_OP_BATCH, store, NULL, 0, cb_arg);
+    if (!op) {
+        return XSAN_ERROR_NO_MEMORY;
+    }
+    op->batch = batch;
+    op->done_cb = cb;
+    xsan_error_t err = _xsan_md_op_submit(op);
+    if (err != XSAN_OK) {
+        op->batch = NULL; // Still the caller's
+        _xsan_md_op_free(op);
+    }
+    return err;
+}
+
+xsan_error_t xsan_metadata_store_scan_prefix_async(xsan_metadata_store_t *store, const char *prefix, size_t prefix_len,
+                                                   xsan_metadata_scan_cb_t cb, void *cb_arg) {
+    if (!store || !prefix || prefix_len == 0 || !cb) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    xsan_md_op_t *op = _xsan_md_op_create(XSAN_MD_OP_SCAN_PREFIX, store, prefix, prefix_len, cb_arg);
+    if (!op) {
+        return XSAN_ERROR_NO_MEMORY;
+    }
+    op->scan_cb = cb;
+    return _xsan_md_op_submit(op);
+}
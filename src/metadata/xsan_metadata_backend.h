@@ -0,0 +1,59 @@
+// xsan_metadata_backend.h
+// 元数据存储后端接口 (仅 src/metadata 内部使用)。xsan_metadata_store.c 负责参数检查、按键前缀选择
+// 列族、节点库与迁移, 具体读写由后端实现。
+#pragma once
+#include "xsan_metadata_store.h"
+
+#define XSAN_METADATA_PATH_BUF_LEN 1024
+
+typedef struct xsan_metadata_backend_ops_t {
+    const char *name;
+
+    // 打开/关闭: open 设置 store->backend 与每个列族的 backend_cf
+    xsan_error_t (*open)(xsan_metadata_store_t *store, const char *path, bool create_if_missing,
+                         const xsan_metadata_store_opts_t *opts);
+    void (*close)(xsan_metadata_store_t *store);
+
+    // 点操作; get 返回的值以 XSAN_MALLOC 分配并以 '\0' 结尾, 键不存在返回 XSAN_ERROR_NOT_FOUND
+    xsan_error_t (*put)(xsan_metadata_cf_t *cf, const char *key, size_t key_len, const char *value, size_t value_len);
+    xsan_error_t (*get)(xsan_metadata_cf_t *cf, const char *key, size_t key_len, char **value_out, size_t *value_len_out);
+    xsan_error_t (*del)(xsan_metadata_cf_t *cf, const char *key, size_t key_len);
+
+    // 写批次: commit 原子生效
+    void *(*batch_create)(xsan_metadata_store_t *store);
+    void (*batch_destroy)(void *batch);
+    xsan_error_t (*batch_put)(void *batch, xsan_metadata_cf_t *cf, const char *key, size_t key_len,
+                              const char *value, size_t value_len);
+    xsan_error_t (*batch_delete)(void *batch, xsan_metadata_cf_t *cf, const char *key, size_t key_len);
+    size_t (*batch_count)(void *batch);
+    void (*batch_clear)(void *batch);
+    xsan_error_t (*batch_commit)(xsan_metadata_store_t *store, void *batch);
+
+    // 迭代器: prefix 为 NULL 时遍历整个列族 (未定位); 否则只遍历该前缀并已定位到第一个键。
+    // 迭代器看到的是创建时的数据。
+    void *(*iter_create)(xsan_metadata_cf_t *cf, const char *prefix, size_t prefix_len);
+    void (*iter_destroy)(void *iter);
+    void (*iter_seek_to_first)(void *iter);
+    void (*iter_seek)(void *iter, const char *key, size_t key_len);
+    void (*iter_next)(void *iter);
+    bool (*iter_valid)(void *iter);
+    const char *(*iter_key)(void *iter, size_t *key_len_out);
+    const char *(*iter_value)(void *iter, size_t *value_len_out);
+
+    // 一致性快照写到 dir (dir 不能已存在); 结果可用同一后端直接打开
+    xsan_error_t (*checkpoint)(xsan_metadata_store_t *store, const char *dir);
+    // 可选, 调用者用 XSAN_FREE 释放
+    char *(*get_statistics)(xsan_metadata_store_t *store);
+} xsan_metadata_backend_ops_t;
+
+extern const xsan_metadata_backend_ops_t xsan_metadata_backend_rocksdb;
+extern const xsan_metadata_backend_ops_t xsan_metadata_backend_memlog;
+
+// 每个列族的名字 (按 xsan_metadata_cf_id_t 索引), 后端共用
+extern const char *const xsan_metadata_cf_names[XSAN_METADATA_CF_COUNT];
+
+// 迁移旧版 (无列族) RocksDB 库: 对每条记录调用 cb, cb 返回非 XSAN_OK 时停止
+typedef xsan_error_t (*xsan_metadata_record_cb_t)(void *cb_arg, const char *key, size_t key_len,
+                                                 const char *value, size_t value_len);
+xsan_error_t xsan_metadata_rocksdb_scan_legacy(const char *path, xsan_metadata_record_cb_t cb, void *cb_arg,
+                                               size_t *count_out);
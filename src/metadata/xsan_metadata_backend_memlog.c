@@ -0,0 +1,961 @@
+// In-memory metadata backend: per column family a hash table for point lookups and a skiplist for
+// ordered/prefix iteration, persisted as an append-only log of checksummed batch records.
+//
+// Log file <db_path>/xsan.memlog, native byte order:
+//   record  = magic u32 | crc32c(payload) u32 | payload_len u32 | payload
+//   payload = op_count u32 | op*
+//   op      = type u8 | cf u8 | key_len u32 | value_len u32 | key | value
+// Every commit appends exactly one record, so a batch is replayed all-or-nothing. Replay stops at the
+// first record that is short or fails its checksum (a torn append) and truncates the log there.
+// When the log grows past memlog_compact_ratio times the live data it is rewritten from memory.
+#include "xsan_metadata_backend.h"
+#include "xsan_memory.h"
+#include "../../include/xsan_error.h"
+#include "xsan_log.h"
+
+#include "spdk/crc32.h"  // spdk_crc32c_update
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define XSAN_MEMLOG_FILE_NAME "xsan.memlog"
+#define XSAN_MEMLOG_TMP_SUFFIX ".tmp"
+#define XSAN_MEMLOG_RECORD_MAGIC 0x474c4d58u // "XMLG"
+#define XSAN_MEMLOG_RECORD_HEADER_LEN 12
+#define XSAN_MEMLOG_BATCH_HEADER_LEN (XSAN_MEMLOG_RECORD_HEADER_LEN + 4) // Record header + op count
+#define XSAN_MEMLOG_OP_HEADER_LEN 10
+#define XSAN_MEMLOG_OP_PUT 1
+#define XSAN_MEMLOG_OP_DELETE 2
+#define XSAN_MEMLOG_SKIPLIST_MAX_LEVEL 16
+#define XSAN_MEMLOG_MIN_BUCKETS 64
+#define XSAN_MEMLOG_SNAPSHOT_RECORD_BYTES (1024 * 1024) // Payload size of each record in a compacted log
+
+typedef struct xsan_memlog_entry {
+    struct xsan_memlog_entry *hash_next;
+    uint32_t hash;
+    uint32_t level;
+    size_t key_len;
+    size_t value_len;
+    char *key;      // Stored after forward[]
+    char *value;    // Own allocation, '\0'-terminated
+    struct xsan_memlog_entry *forward[];
+} xsan_memlog_entry_t;
+
+typedef struct {
+    xsan_memlog_entry_t *head;      // Skiplist sentinel with XSAN_MEMLOG_SKIPLIST_MAX_LEVEL levels
+    uint32_t level;
+    xsan_memlog_entry_t **buckets;
+    size_t bucket_count;
+    size_t count;
+} xsan_memlog_cf_t;
+
+typedef struct {
+    pthread_rwlock_t lock;          // Commits (and compaction) write, reads and iterator creation read
+    char *dir;
+    char *log_path;
+    char *tmp_path;
+    int fd;
+    uint64_t log_bytes;
+    uint64_t live_bytes;            // Encoded size of the live records, the size of a compacted log
+    uint64_t compact_min_bytes;
+    uint32_t compact_ratio;
+    bool sync;
+    bool replaying;                 // Only the hash tables are kept up to date; skiplists are built afterwards
+    uint32_t rng;
+    uint64_t commits;
+    uint64_t compactions;
+    uint64_t replayed_records;
+    xsan_memlog_cf_t cfs[XSAN_METADATA_CF_COUNT];
+} xsan_memlog_t;
+
+typedef struct {
+    char *buf;                      // Record header and op count reserved at the front
+    size_t len;
+    size_t cap;
+    uint32_t count;
+} xsan_memlog_batch_t;
+
+typedef struct {
+    const char *key;
+    size_t key_len;
+    const char *value;
+    size_t value_len;
+} xsan_memlog_iter_item_t;
+
+typedef struct {
+    xsan_memlog_iter_item_t *items; // Items followed by the copied keys and values, one allocation
+    size_t count;
+    size_t pos;
+} xsan_memlog_iter_t;
+
+static inline xsan_memlog_t *_ml(xsan_metadata_store_t *store) {
+    return (xsan_memlog_t *)store->backend;
+}
+
+static inline uint32_t _xsan_memlog_crc(const void *buf, size_t len) {
+    return spdk_crc32c_update(buf, len, ~0u) ^ ~0u;
+}
+
+static inline uint32_t _xsan_memlog_hash(const char *key, size_t key_len) {
+    uint32_t h = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < key_len; ++i) {
+        h = (h ^ (unsigned char)key[i]) * 16777619u;
+    }
+    return h;
+}
+
+static inline size_t _xsan_memlog_op_size(size_t key_len, size_t value_len) {
+    return XSAN_MEMLOG_OP_HEADER_LEN + key_len + value_len;
+}
+
+// Bytewise order, the same as RocksDB's default comparator.
+static int _xsan_memlog_key_cmp(const char *a, size_t a_len, const char *b, size_t b_len) {
+    int r = memcmp(a, b, a_len < b_len ? a_len : b_len);
+    if (r != 0) {
+        return r;
+    }
+    return a_len < b_len ? -1 : (a_len > b_len ? 1 : 0);
+}
+
+// --- Hash table + skiplist ---
+
+static xsan_memlog_entry_t *_xsan_memlog_lookup(xsan_memlog_cf_t *cf, const char *key, size_t key_len) {
+    uint32_t hash = _xsan_memlog_hash(key, key_len);
+    for (xsan_memlog_entry_t *e = cf->buckets[hash & (cf->bucket_count - 1)]; e; e = e->hash_next) {
+        if (e->hash == hash && e->key_len == key_len && memcmp(e->key, key, key_len) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+// First entry >= key; update[] (if given) receives the last entry < key on every level.
+static xsan_memlog_entry_t *_xsan_memlog_seek(xsan_memlog_cf_t *cf, const char *key, size_t key_len,
+                                              xsan_memlog_entry_t **update) {
+    xsan_memlog_entry_t *x = cf->head;
+    for (int lvl = (int)cf->level - 1; lvl >= 0; --lvl) {
+        while (x->forward[lvl] && _xsan_memlog_key_cmp(x->forward[lvl]->key, x->forward[lvl]->key_len, key, key_len) < 0) {
+            x = x->forward[lvl];
+        }
+        if (update) {
+            update[lvl] = x;
+        }
+    }
+    return x->forward[0];
+}
+
+static uint32_t _xsan_memlog_random_level(xsan_memlog_t *ml) {
+    uint32_t level = 1;
+    while (level < XSAN_MEMLOG_SKIPLIST_MAX_LEVEL) {
+        ml->rng ^= ml->rng << 13; // xorshift32
+        ml->rng ^= ml->rng >> 17;
+        ml->rng ^= ml->rng << 5;
+        if ((ml->rng & 3) != 0) { // p = 1/4
+            break;
+        }
+        level++;
+    }
+    return level;
+}
+
+static void _xsan_memlog_grow_buckets(xsan_memlog_cf_t *cf) {
+    size_t new_count = cf->bucket_count * 2;
+    xsan_memlog_entry_t **buckets = (xsan_memlog_entry_t **)XSAN_CALLOC(new_count, sizeof(*buckets));
+    if (!buckets) {
+        return; // Longer chains, still correct
+    }
+    for (size_t i = 0; i < cf->bucket_count; ++i) {
+        xsan_memlog_entry_t *e = cf->buckets[i];
+        while (e) {
+            xsan_memlog_entry_t *next = e->hash_next;
+            e->hash_next = buckets[e->hash & (new_count - 1)];
+            buckets[e->hash & (new_count - 1)] = e;
+            e = next;
+        }
+    }
+    XSAN_FREE(cf->buckets);
+    cf->buckets = buckets;
+    cf->bucket_count = new_count;
+}
+
+static char *_xsan_memlog_copy_value(const char *value, size_t value_len) {
+    char *copy = (char *)XSAN_MALLOC(value_len + 1);
+    if (copy) {
+        memcpy(copy, value, value_len);
+        copy[value_len] = '\0';
+    }
+    return copy;
+}
+
+static xsan_error_t _xsan_memlog_apply_put(xsan_memlog_t *ml, xsan_memlog_cf_t *cf, const char *key, size_t key_len,
+                                           const char *value, size_t value_len) {
+    xsan_memlog_entry_t *e = _xsan_memlog_lookup(cf, key, key_len);
+    char *value_copy = _xsan_memlog_copy_value(value, value_len);
+    if (!value_copy) {
+        return XSAN_ERROR_NO_MEMORY;
+    }
+    if (e) {
+        ml->live_bytes = ml->live_bytes - e->value_len + value_len;
+        XSAN_FREE(e->value);
+        e->value = value_copy;
+        e->value_len = value_len;
+        return XSAN_OK;
+    }
+
+    uint32_t level = _xsan_memlog_random_level(ml);
+    e = (xsan_memlog_entry_t *)XSAN_MALLOC(sizeof(*e) + level * sizeof(e->forward[0]) + key_len);
+    if (!e) {
+        XSAN_FREE(value_copy);
+        return XSAN_ERROR_NO_MEMORY;
+    }
+    e->hash = _xsan_memlog_hash(key, key_len);
+    e->level = level;
+    e->key_len = key_len;
+    e->key = (char *)&e->forward[level];
+    memcpy(e->key, key, key_len);
+    e->value = value_copy;
+    e->value_len = value_len;
+    if (!ml->replaying) {
+        xsan_memlog_entry_t *update[XSAN_MEMLOG_SKIPLIST_MAX_LEVEL];
+        _xsan_memlog_seek(cf, key, key_len, update);
+        for (uint32_t lvl = cf->level; lvl < level; ++lvl) {
+            update[lvl] = cf->head;
+        }
+        if (level > cf->level) {
+            cf->level = level;
+        }
+        for (uint32_t lvl = 0; lvl < level; ++lvl) {
+            e->forward[lvl] = update[lvl]->forward[lvl];
+            update[lvl]->forward[lvl] = e;
+        }
+    }
+    size_t b = e->hash & (cf->bucket_count - 1);
+    e->hash_next = cf->buckets[b];
+    cf->buckets[b] = e;
+    cf->count++;
+    ml->live_bytes += _xsan_memlog_op_size(key_len, value_len);
+    if (cf->count > cf->bucket_count) {
+        _xsan_memlog_grow_buckets(cf);
+    }
+    return XSAN_OK;
+}
+
+static void _xsan_memlog_apply_delete(xsan_memlog_t *ml, xsan_memlog_cf_t *cf, const char *key, size_t key_len) {
+    xsan_memlog_entry_t *e = _xsan_memlog_lookup(cf, key, key_len);
+    if (!e) {
+        return;
+    }
+    if (!ml->replaying) {
+        xsan_memlog_entry_t *update[XSAN_MEMLOG_SKIPLIST_MAX_LEVEL];
+        _xsan_memlog_seek(cf, key, key_len, update);
+        for (uint32_t lvl = 0; lvl < e->level; ++lvl) {
+            update[lvl]->forward[lvl] = e->forward[lvl];
+        }
+        while (cf->level > 1 && !cf->head->forward[cf->level - 1]) {
+            cf->level--;
+        }
+    }
+    xsan_memlog_entry_t **pp = &cf->buckets[e->hash & (cf->bucket_count - 1)];
+    while (*pp != e) {
+        pp = &(*pp)->hash_next;
+    }
+    *pp = e->hash_next;
+    cf->count--;
+    ml->live_bytes -= _xsan_memlog_op_size(e->key_len, e->value_len);
+    XSAN_FREE(e->value);
+    XSAN_FREE(e);
+}
+
+static xsan_error_t _xsan_memlog_cf_init(xsan_memlog_cf_t *cf) {
+    cf->head = (xsan_memlog_entry_t *)XSAN_CALLOC(1, sizeof(xsan_memlog_entry_t) +
+                                                     XSAN_MEMLOG_SKIPLIST_MAX_LEVEL * sizeof(cf->head->forward[0]));
+    cf->buckets = (xsan_memlog_entry_t **)XSAN_CALLOC(XSAN_MEMLOG_MIN_BUCKETS, sizeof(*cf->buckets));
+    if (!cf->head || !cf->buckets) {
+        return XSAN_ERROR_NO_MEMORY;
+    }
+    cf->level = 1;
+    cf->bucket_count = XSAN_MEMLOG_MIN_BUCKETS;
+    return XSAN_OK;
+}
+
+static void _xsan_memlog_cf_fini(xsan_memlog_cf_t *cf) {
+    // The hash table is complete even while the skiplist is not (during replay)
+    for (size_t i = 0; cf->buckets && i < cf->bucket_count; ++i) {
+        xsan_memlog_entry_t *e = cf->buckets[i];
+        while (e) {
+            xsan_memlog_entry_t *next = e->hash_next;
+            XSAN_FREE(e->value);
+            XSAN_FREE(e);
+            e = next;
+        }
+    }
+    if (cf->head) {
+        XSAN_FREE(cf->head);
+    }
+    if (cf->buckets) {
+        XSAN_FREE(cf->buckets);
+    }
+    memset(cf, 0, sizeof(*cf));
+}
+
+static int _xsan_memlog_entry_cmp(const void *a, const void *b) {
+    const xsan_memlog_entry_t *x = *(xsan_memlog_entry_t *const *)a;
+    const xsan_memlog_entry_t *y = *(xsan_memlog_entry_t *const *)b;
+    return _xsan_memlog_key_cmp(x->key, x->key_len, y->key, y->key_len);
+}
+
+// Links the skiplist from the hash table in one pass over the sorted entries. Inserting replayed
+// records one by one costs a random walk per key; sorting once is several times faster at startup.
+static xsan_error_t _xsan_memlog_cf_build_index(xsan_memlog_cf_t *cf) {
+    if (cf->count == 0) {
+        return XSAN_OK;
+    }
+    xsan_memlog_entry_t **sorted = (xsan_memlog_entry_t **)XSAN_MALLOC(cf->count * sizeof(*sorted));
+    if (!sorted) {
+        return XSAN_ERROR_NO_MEMORY;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < cf->bucket_count; ++i) {
+        for (xsan_memlog_entry_t *e = cf->buckets[i]; e; e = e->hash_next) {
+            sorted[n++] = e;
+        }
+    }
+    qsort(sorted, n, sizeof(*sorted), _xsan_memlog_entry_cmp);
+    xsan_memlog_entry_t *tails[XSAN_MEMLOG_SKIPLIST_MAX_LEVEL];
+    for (uint32_t lvl = 0; lvl < XSAN_MEMLOG_SKIPLIST_MAX_LEVEL; ++lvl) {
+        tails[lvl] = cf->head;
+    }
+    cf->level = 1;
+    for (size_t i = 0; i < n; ++i) {
+        xsan_memlog_entry_t *e = sorted[i];
+        for (uint32_t lvl = 0; lvl < e->level; ++lvl) {
+            tails[lvl]->forward[lvl] = e;
+            tails[lvl] = e;
+        }
+        if (e->level > cf->level) {
+            cf->level = e->level;
+        }
+    }
+    for (uint32_t lvl = 0; lvl < XSAN_MEMLOG_SKIPLIST_MAX_LEVEL; ++lvl) {
+        tails[lvl]->forward[lvl] = NULL;
+    }
+    XSAN_FREE(sorted);
+    return XSAN_OK;
+}
+
+// --- Batch encoding ---
+
+static xsan_error_t _xsan_memlog_batch_reserve(xsan_memlog_batch_t *b, size_t extra) {
+    if (b->len + extra <= b->cap) {
+        return XSAN_OK;
+    }
+    size_t cap = b->cap ? b->cap : 256;
+    while (cap < b->len + extra) {
+        cap *= 2;
+    }
+    char *buf = (char *)XSAN_REALLOC(b->buf, cap);
+    if (!buf) {
+        return XSAN_ERROR_NO_MEMORY;
+    }
+    b->buf = buf;
+    b->cap = cap;
+    return XSAN_OK;
+}
+
+static xsan_error_t _xsan_memlog_batch_init(xsan_memlog_batch_t *b) {
+    memset(b, 0, sizeof(*b));
+    xsan_error_t err = _xsan_memlog_batch_reserve(b, XSAN_MEMLOG_BATCH_HEADER_LEN);
+    b->len = XSAN_MEMLOG_BATCH_HEADER_LEN;
+    return err;
+}
+
+static xsan_error_t _xsan_memlog_batch_append(xsan_memlog_batch_t *b, uint8_t op, uint8_t cf_id,
+                                              const char *key, size_t key_len, const char *value, size_t value_len) {
+    if (key_len > UINT32_MAX || value_len > UINT32_MAX) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    xsan_error_t err = _xsan_memlog_batch_reserve(b, _xsan_memlog_op_size(key_len, value_len));
+    if (err != XSAN_OK) {
+        return err;
+    }
+    char *p = b->buf + b->len;
+    uint32_t klen = (uint32_t)key_len, vlen = (uint32_t)value_len;
+    p[0] = (char)op;
+    p[1] = (char)cf_id;
+    memcpy(p + 2, &klen, 4);
+    memcpy(p + 6, &vlen, 4);
+    memcpy(p + XSAN_MEMLOG_OP_HEADER_LEN, key, key_len);
+    if (value_len) {
+        memcpy(p + XSAN_MEMLOG_OP_HEADER_LEN + key_len, value, value_len);
+    }
+    b->len += _xsan_memlog_op_size(key_len, value_len);
+    b->count++;
+    return XSAN_OK;
+}
+
+// Fills in the record header; the whole buffer is then one log record.
+static void _xsan_memlog_batch_seal(xsan_memlog_batch_t *b) {
+    uint32_t magic = XSAN_MEMLOG_RECORD_MAGIC;
+    uint32_t payload_len = (uint32_t)(b->len - XSAN_MEMLOG_RECORD_HEADER_LEN);
+    memcpy(b->buf + XSAN_MEMLOG_RECORD_HEADER_LEN, &b->count, 4);
+    uint32_t crc = _xsan_memlog_crc(b->buf + XSAN_MEMLOG_RECORD_HEADER_LEN, payload_len);
+    memcpy(b->buf, &magic, 4);
+    memcpy(b->buf + 4, &crc, 4);
+    memcpy(b->buf + 8, &payload_len, 4);
+}
+
+// Validates a record payload and, if apply is set, applies it. Returns false for a malformed payload.
+static bool _xsan_memlog_apply_payload(xsan_memlog_t *ml, const char *payload, size_t len, bool apply) {
+    if (len < 4) {
+        return false;
+    }
+    uint32_t count;
+    memcpy(&count, payload, 4);
+    size_t off = 4;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (len - off < XSAN_MEMLOG_OP_HEADER_LEN) {
+            return false;
+        }
+        uint8_t op = (uint8_t)payload[off];
+        uint8_t cf_id = (uint8_t)payload[off + 1];
+        uint32_t klen, vlen;
+        memcpy(&klen, payload + off + 2, 4);
+        memcpy(&vlen, payload + off + 6, 4);
+        off += XSAN_MEMLOG_OP_HEADER_LEN;
+        if ((op != XSAN_MEMLOG_OP_PUT && op != XSAN_MEMLOG_OP_DELETE) || cf_id >= XSAN_METADATA_CF_COUNT ||
+            klen == 0 || (uint64_t)klen + vlen > len - off) {
+            return false;
+        }
+        if (apply) {
+            if (op == XSAN_MEMLOG_OP_PUT) {
+                if (_xsan_memlog_apply_put(ml, &ml->cfs[cf_id], payload + off, klen, payload + off + klen, vlen) != XSAN_OK) {
+                    XSAN_LOG_ERROR("Memlog: out of memory applying a put to '%s'; the in-memory state is incomplete.",
+                                   xsan_metadata_cf_names[cf_id]);
+                }
+            } else {
+                _xsan_memlog_apply_delete(ml, &ml->cfs[cf_id], payload + off, klen);
+            }
+        }
+        off += (size_t)klen + vlen;
+    }
+    return off == len;
+}
+
+// --- Log file ---
+
+static xsan_error_t _xsan_memlog_write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return XSAN_ERROR_IO;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return XSAN_OK;
+}
+
+static void _xsan_memlog_fsync_dir(const char *dir) {
+    int dfd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (dfd >= 0) {
+        (void)fsync(dfd);
+        close(dfd);
+    }
+}
+
+// Writes the current contents as a fresh log at path (replacing it) and syncs it. Caller holds the lock.
+static xsan_error_t _xsan_memlog_write_snapshot(xsan_memlog_t *ml, const char *path, uint64_t *bytes_out) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        XSAN_LOG_ERROR("Memlog: cannot create '%s': %s", path, strerror(errno));
+        return XSAN_ERROR_IO;
+    }
+    xsan_memlog_batch_t b;
+    xsan_error_t err = _xsan_memlog_batch_init(&b);
+    uint64_t written = 0;
+    for (int i = 0; err == XSAN_OK && i < XSAN_METADATA_CF_COUNT; ++i) {
+        for (xsan_memlog_entry_t *e = ml->cfs[i].head->forward[0]; err == XSAN_OK && e; e = e->forward[0]) {
+            err = _xsan_memlog_batch_append(&b, XSAN_MEMLOG_OP_PUT, (uint8_t)i, e->key, e->key_len, e->value, e->value_len);
+            if (err == XSAN_OK && b.len >= XSAN_MEMLOG_SNAPSHOT_RECORD_BYTES) {
+                _xsan_memlog_batch_seal(&b);
+                err = _xsan_memlog_write_all(fd, b.buf, b.len);
+                written += b.len;
+                b.len = XSAN_MEMLOG_BATCH_HEADER_LEN;
+                b.count = 0;
+            }
+        }
+    }
+    if (err == XSAN_OK && b.count > 0) {
+        _xsan_memlog_batch_seal(&b);
+        err = _xsan_memlog_write_all(fd, b.buf, b.len);
+        written += b.len;
+    }
+    if (err == XSAN_OK && fdatasync(fd) != 0) {
+        err = XSAN_ERROR_IO;
+    }
+    close(fd);
+    XSAN_FREE(b.buf);
+    if (err != XSAN_OK) {
+        unlink(path);
+        return err;
+    }
+    if (bytes_out) *bytes_out = written;
+    return XSAN_OK;
+}
+
+// Rewrites the log from memory once it holds mostly superseded records. The new log is written
+// beside the old one and renamed over it, so a crash at any point leaves one complete log.
+static void _xsan_memlog_maybe_compact(xsan_memlog_t *ml) {
+    if (ml->compact_ratio == 0 || ml->log_bytes < ml->compact_min_bytes ||
+        ml->log_bytes <= ml->live_bytes * ml->compact_ratio) {
+        return;
+    }
+    uint64_t old_bytes = ml->log_bytes;
+    uint64_t new_bytes = 0;
+    if (_xsan_memlog_write_snapshot(ml, ml->tmp_path, &new_bytes) != XSAN_OK) {
+        XSAN_LOG_WARN("Memlog: compaction of '%s' failed; keeping the current log.", ml->log_path);
+        return;
+    }
+    int fd = open(ml->tmp_path, O_RDWR | O_APPEND);
+    if (fd < 0 || rename(ml->tmp_path, ml->log_path) != 0) {
+        XSAN_LOG_WARN("Memlog: cannot install compacted log for '%s': %s", ml->log_path, strerror(errno));
+        if (fd >= 0) close(fd);
+        unlink(ml->tmp_path);
+        return;
+    }
+    _xsan_memlog_fsync_dir(ml->dir);
+    close(ml->fd);
+    ml->fd = fd;
+    ml->log_bytes = new_bytes;
+    ml->compactions++;
+    XSAN_LOG_DEBUG("Memlog: compacted '%s' from %llu to %llu bytes.", ml->log_path,
+                   (unsigned long long)old_bytes, (unsigned long long)new_bytes);
+}
+
+// Appends one sealed batch and applies it. Caller holds the write lock.
+static xsan_error_t _xsan_memlog_commit_locked(xsan_memlog_t *ml, xsan_memlog_batch_t *b) {
+    _xsan_memlog_batch_seal(b);
+    xsan_error_t err = _xsan_memlog_write_all(ml->fd, b->buf, b->len);
+    if (err == XSAN_OK && ml->sync && fdatasync(ml->fd) != 0) {
+        err = XSAN_ERROR_IO;
+    }
+    if (err != XSAN_OK) {
+        XSAN_LOG_ERROR("Memlog: append to '%s' failed: %s", ml->log_path, strerror(errno));
+        // Drop a partial record so that later appends are not hidden behind it at replay.
+        if (ftruncate(ml->fd, (off_t)ml->log_bytes) != 0) {
+            XSAN_LOG_ERROR("Memlog: cannot truncate '%s' after a failed append.", ml->log_path);
+        }
+        return err;
+    }
+    ml->log_bytes += b->len;
+    ml->commits++;
+    _xsan_memlog_apply_payload(ml, b->buf + XSAN_MEMLOG_RECORD_HEADER_LEN, b->len - XSAN_MEMLOG_RECORD_HEADER_LEN, true);
+    _xsan_memlog_maybe_compact(ml);
+    return XSAN_OK;
+}
+
+static xsan_error_t _xsan_memlog_replay(xsan_memlog_t *ml) {
+    struct stat st;
+    if (fstat(ml->fd, &st) != 0) {
+        return XSAN_ERROR_IO;
+    }
+    size_t size = (size_t)st.st_size;
+    if (size == 0) {
+        return XSAN_OK;
+    }
+    // Records are applied straight from the page cache; nothing is copied but the live values
+    const char *buf = (const char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, ml->fd, 0);
+    if (buf == MAP_FAILED) {
+        XSAN_LOG_ERROR("Memlog: cannot map '%s': %s", ml->log_path, strerror(errno));
+        return XSAN_ERROR_IO;
+    }
+    (void)madvise((void *)buf, size, MADV_SEQUENTIAL);
+
+    size_t off = 0;
+    while (size - off >= XSAN_MEMLOG_RECORD_HEADER_LEN) {
+        uint32_t magic, crc, payload_len;
+        memcpy(&magic, buf + off, 4);
+        memcpy(&crc, buf + off + 4, 4);
+        memcpy(&payload_len, buf + off + 8, 4);
+        const char *payload = buf + off + XSAN_MEMLOG_RECORD_HEADER_LEN;
+        if (magic != XSAN_MEMLOG_RECORD_MAGIC || payload_len > size - off - XSAN_MEMLOG_RECORD_HEADER_LEN ||
+            _xsan_memlog_crc(payload, payload_len) != crc || !_xsan_memlog_apply_payload(ml, payload, payload_len, false)) {
+            break;
+        }
+        _xsan_memlog_apply_payload(ml, payload, payload_len, true);
+        off += XSAN_MEMLOG_RECORD_HEADER_LEN + payload_len;
+        ml->replayed_records++;
+    }
+    munmap((void *)buf, size);
+    if (off < size) {
+        XSAN_LOG_WARN("Memlog: discarding %zu byte(s) of torn or corrupt log at offset %zu of '%s'.",
+                      size - off, off, ml->log_path);
+        if (ftruncate(ml->fd, (off_t)off) != 0) {
+            return XSAN_ERROR_IO;
+        }
+    }
+    ml->log_bytes = off;
+    return XSAN_OK;
+}
+
+static xsan_error_t _xsan_memlog_mkdirs(const char *path) {
+    char buf[XSAN_METADATA_PATH_BUF_LEN];
+    if (snprintf(buf, sizeof(buf), "%s", path) >= (int)sizeof(buf)) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    for (char *p = buf + 1; ; ++p) {
+        if (*p == '/' || *p == '\0') {
+            char c = *p;
+            *p = '\0';
+            if (mkdir(buf, 0755) != 0 && errno != EEXIST) {
+                XSAN_LOG_ERROR("Memlog: cannot create directory '%s': %s", buf, strerror(errno));
+                return XSAN_ERROR_IO;
+            }
+            *p = c;
+            if (c == '\0') {
+                break;
+            }
+        }
+    }
+    return XSAN_OK;
+}
+
+// --- Backend ops ---
+
+static void _xsan_memlog_close(xsan_metadata_store_t *store) {
+    xsan_memlog_t *ml = _ml(store);
+    if (!ml) {
+        return;
+    }
+    if (ml->fd >= 0) {
+        close(ml->fd);
+    }
+    for (int i = 0; i < XSAN_METADATA_CF_COUNT; ++i) {
+        _xsan_memlog_cf_fini(&ml->cfs[i]);
+        store->cfs[i].backend_cf = NULL;
+    }
+    pthread_rwlock_destroy(&ml->lock);
+    if (ml->dir) XSAN_FREE(ml->dir);
+    if (ml->log_path) XSAN_FREE(ml->log_path);
+    if (ml->tmp_path) XSAN_FREE(ml->tmp_path);
+    XSAN_FREE(ml);
+    store->backend = NULL;
+}
+
+static xsan_error_t _xsan_memlog_open(xsan_metadata_store_t *store, const char *path, bool create_if_missing,
+                                      const xsan_metadata_store_opts_t *opts) {
+    xsan_memlog_t *ml = (xsan_memlog_t *)XSAN_CALLOC(1, sizeof(xsan_memlog_t));
+    if (!ml) {
+        return XSAN_ERROR_NO_MEMORY;
+    }
+    ml->fd = -1;
+    pthread_rwlock_init(&ml->lock, NULL);
+    store->backend = ml;
+    ml->compact_min_bytes = opts->memlog_compact_min_bytes;
+    ml->compact_ratio = opts->memlog_compact_ratio;
+    ml->sync = opts->memlog_sync;
+    ml->rng = 0x9e3779b9u;
+
+    char path_buf[XSAN_METADATA_PATH_BUF_LEN];
+    xsan_error_t err = XSAN_OK;
+    for (int i = 0; err == XSAN_OK && i < XSAN_METADATA_CF_COUNT; ++i) {
+        err = _xsan_memlog_cf_init(&ml->cfs[i]);
+    }
+    if (err == XSAN_OK && create_if_missing) {
+        err = _xsan_memlog_mkdirs(path);
+    }
+    if (err != XSAN_OK) {
+        goto fail;
+    }
+    ml->dir = xsan_strdup(path);
+    snprintf(path_buf, sizeof(path_buf), "%s/%s", path, XSAN_MEMLOG_FILE_NAME);
+    ml->log_path = xsan_strdup(path_buf);
+    snprintf(path_buf, sizeof(path_buf), "%s/%s%s", path, XSAN_MEMLOG_FILE_NAME, XSAN_MEMLOG_TMP_SUFFIX);
+    ml->tmp_path = xsan_strdup(path_buf);
+    if (!ml->dir || !ml->log_path || !ml->tmp_path) {
+        err = XSAN_ERROR_NO_MEMORY;
+        goto fail;
+    }
+    ml->fd = open(ml->log_path, O_RDWR | O_APPEND | (create_if_missing ? O_CREAT : 0), 0644);
+    if (ml->fd < 0) {
+        XSAN_LOG_ERROR("Memlog: cannot open '%s': %s", ml->log_path, strerror(errno));
+        err = (errno == ENOENT) ? XSAN_ERROR_NOT_FOUND : XSAN_ERROR_IO;
+        goto fail;
+    }
+    unlink(ml->tmp_path); // Left behind by a compaction that did not finish
+    ml->replaying = true;
+    err = _xsan_memlog_replay(ml);
+    ml->replaying = false;
+    for (int i = 0; err == XSAN_OK && i < XSAN_METADATA_CF_COUNT; ++i) {
+        err = _xsan_memlog_cf_build_index(&ml->cfs[i]);
+    }
+    if (err != XSAN_OK) {
+        XSAN_LOG_ERROR("Memlog: replay of '%s' failed (error %d).", ml->log_path, err);
+        goto fail;
+    }
+    for (int i = 0; i < XSAN_METADATA_CF_COUNT; ++i) {
+        store->cfs[i].backend_cf = &ml->cfs[i];
+    }
+    XSAN_LOG_INFO("Memlog: replayed %llu record(s) (%llu bytes) from '%s'.",
+                  (unsigned long long)ml->replayed_records, (unsigned long long)ml->log_bytes, ml->log_path);
+    return XSAN_OK;
+
+fail:
+    _xsan_memlog_close(store);
+    return err;
+}
+
+static xsan_error_t _xsan_memlog_get(xsan_metadata_cf_t *cf, const char *key, size_t key_len,
+                                     char **value_out, size_t *value_len_out) {
+    xsan_memlog_t *ml = _ml(cf->store);
+    xsan_error_t err = XSAN_ERROR_NOT_FOUND;
+    *value_out = NULL;
+    *value_len_out = 0;
+    pthread_rwlock_rdlock(&ml->lock);
+    xsan_memlog_entry_t *e = _xsan_memlog_lookup((xsan_memlog_cf_t *)cf->backend_cf, key, key_len);
+    if (e) {
+        *value_out = _xsan_memlog_copy_value(e->value, e->value_len);
+        if (*value_out) {
+            *value_len_out = e->value_len;
+            err = XSAN_OK;
+        } else {
+            err = XSAN_ERROR_NO_MEMORY;
+        }
+    }
+    pthread_rwlock_unlock(&ml->lock);
+    return err;
+}
+
+static void *_xsan_memlog_batch_create(xsan_metadata_store_t *store) {
+    (void)store;
+    xsan_memlog_batch_t *b = (xsan_memlog_batch_t *)XSAN_MALLOC(sizeof(xsan_memlog_batch_t));
+    if (b && _xsan_memlog_batch_init(b) != XSAN_OK) {
+        XSAN_FREE(b);
+        b = NULL;
+    }
+    return b;
+}
+
+static void _xsan_memlog_batch_destroy(void *batch) {
+    xsan_memlog_batch_t *b = (xsan_memlog_batch_t *)batch;
+    XSAN_FREE(b->buf);
+    XSAN_FREE(b);
+}
+
+static xsan_error_t _xsan_memlog_batch_put(void *batch, xsan_metadata_cf_t *cf, const char *key, size_t key_len,
+                                           const char *value, size_t value_len) {
+    return _xsan_memlog_batch_append((xsan_memlog_batch_t *)batch, XSAN_MEMLOG_OP_PUT, (uint8_t)cf->id,
+                                     key, key_len, value, value_len);
+}
+
+static xsan_error_t _xsan_memlog_batch_delete(void *batch, xsan_metadata_cf_t *cf, const char *key, size_t key_len) {
+    return _xsan_memlog_batch_append((xsan_memlog_batch_t *)batch, XSAN_MEMLOG_OP_DELETE, (uint8_t)cf->id,
+                                     key, key_len, NULL, 0);
+}
+
+static size_t _xsan_memlog_batch_count(void *batch) {
+    return ((xsan_memlog_batch_t *)batch)->count;
+}
+
+static void _xsan_memlog_batch_clear(void *batch) {
+    xsan_memlog_batch_t *b = (xsan_memlog_batch_t *)batch;
+    b->len = XSAN_MEMLOG_BATCH_HEADER_LEN;
+    b->count = 0;
+}
+
+static xsan_error_t _xsan_memlog_batch_commit(xsan_metadata_store_t *store, void *batch) {
+    xsan_memlog_t *ml = _ml(store);
+    pthread_rwlock_wrlock(&ml->lock);
+    xsan_error_t err = _xsan_memlog_commit_locked(ml, (xsan_memlog_batch_t *)batch);
+    pthread_rwlock_unlock(&ml->lock);
+    return err;
+}
+
+// Single updates are one-op batches.
+static xsan_error_t _xsan_memlog_write_one(xsan_metadata_cf_t *cf, uint8_t op, const char *key, size_t key_len,
+                                           const char *value, size_t value_len) {
+    xsan_memlog_batch_t b;
+    xsan_error_t err = _xsan_memlog_batch_init(&b);
+    if (err == XSAN_OK) {
+        err = _xsan_memlog_batch_append(&b, op, (uint8_t)cf->id, key, key_len, value, value_len);
+    }
+    if (err == XSAN_OK) {
+        err = _xsan_memlog_batch_commit(cf->store, &b);
+    }
+    XSAN_FREE(b.buf);
+    return err;
+}
+
+static xsan_error_t _xsan_memlog_put(xsan_metadata_cf_t *cf, const char *key, size_t key_len,
+                                     const char *value, size_t value_len) {
+    return _xsan_memlog_write_one(cf, XSAN_MEMLOG_OP_PUT, key, key_len, value, value_len);
+}
+
+static xsan_error_t _xsan_memlog_delete(xsan_metadata_cf_t *cf, const char *key, size_t key_len) {
+    return _xsan_memlog_write_one(cf, XSAN_MEMLOG_OP_DELETE, key, key_len, NULL, 0);
+}
+
+// Iterators copy their range under the read lock: callers may commit while iterating (the migration
+// and the volume loaders do), and metadata ranges are small.
+static void *_xsan_memlog_iter_create(xsan_metadata_cf_t *cf, const char *prefix, size_t prefix_len) {
+    xsan_memlog_t *ml = _ml(cf->store);
+    xsan_memlog_cf_t *mcf = (xsan_memlog_cf_t *)cf->backend_cf;
+    xsan_memlog_iter_t *iter = (xsan_memlog_iter_t *)XSAN_CALLOC(1, sizeof(xsan_memlog_iter_t));
+    if (!iter) {
+        return NULL;
+    }
+    pthread_rwlock_rdlock(&ml->lock);
+    xsan_memlog_entry_t *first = prefix ? _xsan_memlog_seek(mcf, prefix, prefix_len, NULL) : mcf->head->forward[0];
+    size_t count = 0, bytes = 0;
+    for (xsan_memlog_entry_t *e = first; e; e = e->forward[0]) {
+        if (prefix && (e->key_len < prefix_len || memcmp(e->key, prefix, prefix_len) != 0)) {
+            break;
+        }
+        count++;
+        bytes += e->key_len + e->value_len;
+    }
+    if (count > 0) {
+        iter->items = (xsan_memlog_iter_item_t *)XSAN_MALLOC(count * sizeof(xsan_memlog_iter_item_t) + bytes);
+        if (!iter->items) {
+            pthread_rwlock_unlock(&ml->lock);
+            XSAN_FREE(iter);
+            return NULL;
+        }
+        char *p = (char *)(iter->items + count);
+        xsan_memlog_entry_t *e = first;
+        for (size_t i = 0; i < count; ++i, e = e->forward[0]) {
+            memcpy(p, e->key, e->key_len);
+            iter->items[i].key = p;
+            iter->items[i].key_len = e->key_len;
+            p += e->key_len;
+            memcpy(p, e->value, e->value_len);
+            iter->items[i].value = p;
+            iter->items[i].value_len = e->value_len;
+            p += e->value_len;
+        }
+    }
+    pthread_rwlock_unlock(&ml->lock);
+    iter->count = count;
+    iter->pos = prefix ? 0 : count; // A full iterator starts unpositioned, as with RocksDB
+    return iter;
+}
+
+static void _xsan_memlog_iter_destroy(void *it) {
+    xsan_memlog_iter_t *iter = (xsan_memlog_iter_t *)it;
+    if (iter->items) {
+        XSAN_FREE(iter->items);
+    }
+    XSAN_FREE(iter);
+}
+
+static void _xsan_memlog_iter_seek_to_first(void *it) {
+    ((xsan_memlog_iter_t *)it)->pos = 0;
+}
+
+static void _xsan_memlog_iter_seek(void *it, const char *key, size_t key_len) {
+    xsan_memlog_iter_t *iter = (xsan_memlog_iter_t *)it;
+    size_t lo = 0, hi = iter->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (_xsan_memlog_key_cmp(iter->items[mid].key, iter->items[mid].key_len, key, key_len) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    iter->pos = lo;
+}
+
+static void _xsan_memlog_iter_next(void *it) {
+    xsan_memlog_iter_t *iter = (xsan_memlog_iter_t *)it;
+    if (iter->pos < iter->count) {
+        iter->pos++;
+    }
+}
+
+static bool _xsan_memlog_iter_valid(void *it) {
+    xsan_memlog_iter_t *iter = (xsan_memlog_iter_t *)it;
+    return iter->pos < iter->count;
+}
+
+static const char *_xsan_memlog_iter_key(void *it, size_t *key_len_out) {
+    xsan_memlog_iter_t *iter = (xsan_memlog_iter_t *)it;
+    if (key_len_out) *key_len_out = iter->items[iter->pos].key_len;
+    return iter->items[iter->pos].key;
+}
+
+static const char *_xsan_memlog_iter_value(void *it, size_t *value_len_out) {
+    xsan_memlog_iter_t *iter = (xsan_memlog_iter_t *)it;
+    if (value_len_out) *value_len_out = iter->items[iter->pos].value_len;
+    return iter->items[iter->pos].value;
+}
+
+static xsan_error_t _xsan_memlog_checkpoint(xsan_metadata_store_t *store, const char *dir) {
+    xsan_memlog_t *ml = _ml(store);
+    if (mkdir(dir, 0755) != 0) {
+        XSAN_LOG_ERROR("Memlog: cannot create checkpoint directory '%s': %s", dir, strerror(errno));
+        return errno == EEXIST ? XSAN_ERROR_ALREADY_EXISTS : XSAN_ERROR_IO;
+    }
+    char path_buf[XSAN_METADATA_PATH_BUF_LEN];
+    snprintf(path_buf, sizeof(path_buf), "%s/%s", dir, XSAN_MEMLOG_FILE_NAME);
+    pthread_rwlock_rdlock(&ml->lock);
+    xsan_error_t err = _xsan_memlog_write_snapshot(ml, path_buf, NULL);
+    pthread_rwlock_unlock(&ml->lock);
+    if (err == XSAN_OK) {
+        _xsan_memlog_fsync_dir(dir);
+    }
+    return err;
+}
+
+static char *_xsan_memlog_get_statistics(xsan_metadata_store_t *store) {
+    xsan_memlog_t *ml = _ml(store);
+    char buf[512];
+    size_t keys = 0;
+    pthread_rwlock_rdlock(&ml->lock);
+    for (int i = 0; i < XSAN_METADATA_CF_COUNT; ++i) {
+        keys += ml->cfs[i].count;
+    }
+    snprintf(buf, sizeof(buf),
+             "memlog.keys: %zu\nmemlog.log.bytes: %llu\nmemlog.live.bytes: %llu\nmemlog.commits: %llu\n"
+             "memlog.compactions: %llu\nmemlog.replayed.records: %llu\n",
+             keys, (unsigned long long)ml->log_bytes, (unsigned long long)ml->live_bytes,
+             (unsigned long long)ml->commits, (unsigned long long)ml->compactions,
+             (unsigned long long)ml->replayed_records);
+    pthread_rwlock_unlock(&ml->lock);
+    return xsan_strdup(buf);
+}
+
+const xsan_metadata_backend_ops_t xsan_metadata_backend_memlog = {
+    .name = "memlog",
+    .open = _xsan_memlog_open,
+    .close = _xsan_memlog_close,
+    .put = _xsan_memlog_put,
+    .get = _xsan_memlog_get,
+    .del = _xsan_memlog_delete,
+    .batch_create = _xsan_memlog_batch_create,
+    .batch_destroy = _xsan_memlog_batch_destroy,
+    .batch_put = _xsan_memlog_batch_put,
+    .batch_delete = _xsan_memlog_batch_delete,
+    .batch_count = _xsan_memlog_batch_count,
+    .batch_clear = _xsan_memlog_batch_clear,
+    .batch_commit = _xsan_memlog_batch_commit,
+    .iter_create = _xsan_memlog_iter_create,
+    .iter_destroy = _xsan_memlog_iter_destroy,
+    .iter_seek_to_first = _xsan_memlog_iter_seek_to_first,
+    .iter_seek = _xsan_memlog_iter_seek,
+    .iter_next = _xsan_memlog_iter_next,
+    .iter_valid = _xsan_memlog_iter_valid,
+    .iter_key = _xsan_memlog_iter_key,
+    .iter_value = _xsan_memlog_iter_value,
+    .checkpoint = _xsan_memlog_checkpoint,
+    .get_statistics = _xsan_memlog_get_statistics,
+};
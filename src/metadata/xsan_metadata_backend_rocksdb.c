@@ -0,0 +1,539 @@
+#include "xsan_metadata_backend.h"
+#include "xsan_memory.h" // For XSAN_MALLOC, XSAN_FREE, xsan_strdup
+#include "../../include/xsan_error.h"
+#include "xsan_log.h"
+
+#include "rocksdb/c.h"   // RocksDB C API
+#include <string.h>      // For memcpy, memchr
+#include <pthread.h>     // For the shared block cache
+
+#define XSAN_METADATA_KEY_PREFIX_DELIM ':' // Every XSAN key starts with a "<type>:" prefix ("v:", "volalloc:", ...)
+#define XSAN_METADATA_MEMTABLE_PREFIX_BLOOM_RATIO 0.1
+
+typedef struct {
+    rocksdb_t *db;
+    rocksdb_options_t *db_options;
+    rocksdb_writeoptions_t *write_options;
+    rocksdb_readoptions_t *read_options;
+    rocksdb_readoptions_t *iter_read_options; // General iterators (total order when a prefix extractor is set)
+    bool has_prefix_extractor;
+    bool shares_block_cache;
+    bool statistics_enabled;
+} xsan_rocksdb_backend_t;
+
+typedef struct {
+    rocksdb_iterator_t *handle;
+    rocksdb_readoptions_t *read_options; // Prefix iterators only, otherwise NULL
+    char *upper_bound;
+    size_t upper_bound_len;
+} xsan_rocksdb_iter_t;
+
+// Block cache shared by every store in the process, created by the first open and
+// released with the last close.
+static pthread_mutex_t g_xsan_metadata_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static rocksdb_cache_t *g_xsan_metadata_block_cache = NULL;
+static uint32_t g_xsan_metadata_block_cache_refs = 0;
+
+static inline xsan_rocksdb_backend_t *_rdb(xsan_metadata_store_t *store) {
+    return (xsan_rocksdb_backend_t *)store->backend;
+}
+
+// --- Prefix extractor: the key up to and including the first ':' ---
+
+static char *_xsan_metadata_prefix_transform(void *state, const char *key, size_t length, size_t *dst_length) {
+    (void)state;
+    const char *delim = memchr(key, XSAN_METADATA_KEY_PREFIX_DELIM, length);
+    *dst_length = delim ? (size_t)(delim - key) + 1 : length;
+    return (char *)key;
+}
+
+static unsigned char _xsan_metadata_prefix_in_domain(void *state, const char *key, size_t length) {
+    (void)state;
+    return memchr(key, XSAN_METADATA_KEY_PREFIX_DELIM, length) != NULL;
+}
+
+static unsigned char _xsan_metadata_prefix_in_range(void *state, const char *key, size_t length) {
+    (void)state; (void)key; (void)length;
+    return 0;
+}
+
+static const char *_xsan_metadata_prefix_name(void *state) {
+    (void)state;
+    return "xsan.KeyTypePrefix";
+}
+
+static rocksdb_cache_t *_xsan_metadata_block_cache_get(size_t capacity) {
+    pthread_mutex_lock(&g_xsan_metadata_cache_lock);
+    if (!g_xsan_metadata_block_cache) {
+        g_xsan_metadata_block_cache = rocksdb_cache_create_lru(capacity);
+    }
+    rocksdb_cache_t *cache = g_xsan_metadata_block_cache;
+    if (cache) {
+        g_xsan_metadata_block_cache_refs++;
+    }
+    pthread_mutex_unlock(&g_xsan_metadata_cache_lock);
+    return cache;
+}
+
+static void _xsan_metadata_block_cache_put(void) {
+    pthread_mutex_lock(&g_xsan_metadata_cache_lock);
+    if (g_xsan_metadata_block_cache_refs > 0 && --g_xsan_metadata_block_cache_refs == 0) {
+        rocksdb_cache_destroy(g_xsan_metadata_block_cache);
+        g_xsan_metadata_block_cache = NULL;
+    }
+    pthread_mutex_unlock(&g_xsan_metadata_cache_lock);
+}
+
+// Applies the process-wide profile to a new store's options.
+static xsan_error_t _xsan_rocksdb_apply_opts(xsan_rocksdb_backend_t *rdb, const xsan_metadata_store_opts_t *opts) {
+    rocksdb_options_t *db_options = rdb->db_options;
+
+    if (opts->parallelism > 0) {
+        rocksdb_options_increase_parallelism(db_options, opts->parallelism);
+    }
+    if (opts->memtable_budget_bytes > 0) {
+        rocksdb_options_optimize_level_style_compaction(db_options, opts->memtable_budget_bytes);
+    }
+    if (opts->max_background_jobs > 0) {
+        rocksdb_options_set_max_background_jobs(db_options, opts->max_background_jobs);
+    }
+
+    rocksdb_block_based_table_options_t *table_options = rocksdb_block_based_options_create();
+    if (!table_options) {
+        return XSAN_ERROR_NO_MEMORY;
+    }
+    if (opts->block_cache_bytes > 0) {
+        rocksdb_cache_t *cache = _xsan_metadata_block_cache_get(opts->block_cache_bytes);
+        if (!cache) {
+            rocksdb_block_based_options_destroy(table_options);
+            return XSAN_ERROR_NO_MEMORY;
+        }
+        rdb->shares_block_cache = true;
+        rocksdb_block_based_options_set_block_cache(table_options, cache);
+        // Filters and indexes compete for the same budget instead of living outside it.
+        rocksdb_block_based_options_set_cache_index_and_filter_blocks(table_options, 1);
+        rocksdb_block_based_options_set_pin_l0_filter_and_index_blocks_in_cache(table_options, 1);
+    }
+    if (opts->bloom_bits_per_key > 0) {
+        rocksdb_block_based_options_set_filter_policy(table_options,
+                                                      rocksdb_filterpolicy_create_bloom_full(opts->bloom_bits_per_key));
+        rocksdb_block_based_options_set_whole_key_filtering(table_options, opts->whole_key_filtering ? 1 : 0);
+    }
+    rocksdb_options_set_block_based_table_factory(db_options, table_options);
+    rocksdb_block_based_options_destroy(table_options);
+
+    if (opts->prefix_bloom) {
+        rocksdb_slicetransform_t *prefix_extractor = rocksdb_slicetransform_create(
+            NULL, NULL, _xsan_metadata_prefix_transform, _xsan_metadata_prefix_in_domain,
+            _xsan_metadata_prefix_in_range, _xsan_metadata_prefix_name);
+        if (!prefix_extractor) {
+            return XSAN_ERROR_NO_MEMORY;
+        }
+        rocksdb_options_set_prefix_extractor(db_options, prefix_extractor); // Options take ownership
+        rocksdb_options_set_memtable_prefix_bloom_size_ratio(db_options, XSAN_METADATA_MEMTABLE_PREFIX_BLOOM_RATIO);
+        rdb->has_prefix_extractor = true;
+    }
+
+    if (opts->enable_statistics) {
+        rocksdb_options_enable_statistics(db_options);
+        if (opts->stats_dump_period_sec > 0) {
+            rocksdb_options_set_stats_dump_period_sec(db_options, opts->stats_dump_period_sec);
+        }
+    }
+    return XSAN_OK;
+}
+
+// Frees everything the backend holds; safe on partially opened stores.
+static void _xsan_rocksdb_close(xsan_metadata_store_t *store) {
+    xsan_rocksdb_backend_t *rdb = _rdb(store);
+    if (!rdb) {
+        return;
+    }
+    for (int i = 0; i < XSAN_METADATA_CF_COUNT; ++i) {
+        if (store->cfs[i].backend_cf) {
+            rocksdb_column_family_handle_destroy(store->cfs[i].backend_cf);
+            store->cfs[i].backend_cf = NULL;
+        }
+    }
+    if (rdb->db) {
+        rocksdb_close(rdb->db);
+    }
+    if (rdb->iter_read_options) {
+        rocksdb_readoptions_destroy(rdb->iter_read_options);
+    }
+    if (rdb->read_options) {
+        rocksdb_readoptions_destroy(rdb->read_options);
+    }
+    if (rdb->write_options) {
+        rocksdb_writeoptions_destroy(rdb->write_options);
+    }
+    if (rdb->db_options) {
+        rocksdb_options_destroy(rdb->db_options);
+    }
+    if (rdb->shares_block_cache) {
+        _xsan_metadata_block_cache_put();
+    }
+    XSAN_FREE(rdb);
+    store->backend = NULL;
+}
+
+static xsan_error_t _xsan_rocksdb_open(xsan_metadata_store_t *store, const char *db_path, bool create_if_missing,
+                                       const xsan_metadata_store_opts_t *opts) {
+    xsan_rocksdb_backend_t *rdb = (xsan_rocksdb_backend_t *)XSAN_CALLOC(1, sizeof(xsan_rocksdb_backend_t));
+    if (!rdb) {
+        XSAN_LOG_ERROR("Failed to allocate RocksDB backend state.");
+        return XSAN_ERROR_NO_MEMORY;
+    }
+    store->backend = rdb;
+
+    rdb->db_options = rocksdb_options_create();
+    if (!rdb->db_options) {
+        XSAN_LOG_ERROR("Failed to create RocksDB options.");
+        _xsan_rocksdb_close(store);
+        return XSAN_ERROR_NO_MEMORY;
+    }
+    rocksdb_options_set_create_if_missing(rdb->db_options, create_if_missing ? 1 : 0);
+    rocksdb_options_set_create_missing_column_families(rdb->db_options, 1);
+    if (_xsan_rocksdb_apply_opts(rdb, opts) != XSAN_OK) {
+        XSAN_LOG_ERROR("Failed to apply metadata store profile for '%s'.", db_path);
+        _xsan_rocksdb_close(store);
+        return XSAN_ERROR_NO_MEMORY;
+    }
+
+    rdb->write_options = rocksdb_writeoptions_create();
+    rdb->read_options = rocksdb_readoptions_create();
+    rdb->iter_read_options = rocksdb_readoptions_create();
+    if (!rdb->write_options || !rdb->read_options || !rdb->iter_read_options) {
+        XSAN_LOG_ERROR("Failed to create RocksDB read/write options.");
+        _xsan_rocksdb_close(store);
+        return XSAN_ERROR_NO_MEMORY;
+    }
+    if (rdb->has_prefix_extractor) {
+        // General iterators may walk across prefixes (seek_to_first); prefix iterators have their own options.
+        rocksdb_readoptions_set_total_order_seek(rdb->iter_read_options, 1);
+    }
+
+    // Every column family shares the store's tuned options (and therefore the block cache).
+    const rocksdb_options_t *cf_options[XSAN_METADATA_CF_COUNT];
+    rocksdb_column_family_handle_t *cf_handles[XSAN_METADATA_CF_COUNT] = { NULL };
+    for (int i = 0; i < XSAN_METADATA_CF_COUNT; ++i) {
+        cf_options[i] = rdb->db_options;
+    }
+    char *err_ptr = NULL;
+    rdb->db = rocksdb_open_column_families(rdb->db_options, db_path, XSAN_METADATA_CF_COUNT,
+                                           xsan_metadata_cf_names, cf_options, cf_handles, &err_ptr);
+    if (err_ptr) {
+        XSAN_LOG_ERROR("Failed to open RocksDB database at '%s': %s", db_path, err_ptr);
+        rocksdb_free(err_ptr); // Important to free error string from RocksDB
+        rdb->db = NULL;
+        _xsan_rocksdb_close(store);
+        return XSAN_ERROR_IO;
+    }
+    if (!rdb->db) { // Should be redundant if err_ptr is checked, but good practice
+        XSAN_LOG_ERROR("RocksDB open returned NULL handle without error string (path: %s).", db_path);
+        _xsan_rocksdb_close(store);
+        return XSAN_ERROR_IO;
+    }
+    for (int i = 0; i < XSAN_METADATA_CF_COUNT; ++i) {
+        store->cfs[i].backend_cf = cf_handles[i];
+    }
+    rdb->statistics_enabled = opts->enable_statistics;
+    return XSAN_OK;
+}
+
+static xsan_error_t _xsan_rocksdb_put(xsan_metadata_cf_t *cf, const char *key, size_t key_len,
+                                      const char *value, size_t value_len) {
+    xsan_rocksdb_backend_t *rdb = _rdb(cf->store);
+    char *err_ptr = NULL;
+    rocksdb_put_cf(rdb->db, rdb->write_options, cf->backend_cf, key, key_len, value, value_len, &err_ptr);
+    if (err_ptr) {
+        XSAN_LOG_ERROR("RocksDB put failed for key '%.*s' (cf %s): %s", (int)key_len, key, cf->name, err_ptr);
+        rocksdb_free(err_ptr);
+        return XSAN_ERROR_IO; // Or a more specific metadata store error
+    }
+    return XSAN_OK;
+}
+
+static xsan_error_t _xsan_rocksdb_get(xsan_metadata_cf_t *cf, const char *key, size_t key_len,
+                                      char **value_out, size_t *value_len_out) {
+    xsan_rocksdb_backend_t *rdb = _rdb(cf->store);
+    char *err_ptr = NULL;
+    size_t value_len = 0;
+    char *value = rocksdb_get_cf(rdb->db, rdb->read_options, cf->backend_cf, key, key_len, &value_len, &err_ptr);
+    *value_out = NULL;
+    *value_len_out = 0;
+
+    if (err_ptr) {
+        XSAN_LOG_ERROR("RocksDB get failed for key '%.*s' (cf %s): %s", (int)key_len, key, cf->name, err_ptr);
+        rocksdb_free(err_ptr);
+        if (value) { // Should not happen if err_ptr is set, but defensive
+            rocksdb_free(value);
+        }
+        return XSAN_ERROR_IO;
+    }
+    if (value == NULL) { // Key not found
+        return XSAN_ERROR_NOT_FOUND;
+    }
+
+    // RocksDB's value from rocksdb_get needs to be freed by rocksdb_free.
+    // Our API contract says caller frees with XSAN_FREE. So we must copy.
+    char *copied_value = (char *)XSAN_MALLOC(value_len + 1); // +1 for null terminator if string
+    if (!copied_value) {
+        rocksdb_free(value);
+        return XSAN_ERROR_NO_MEMORY;
+    }
+    memcpy(copied_value, value, value_len);
+    copied_value[value_len] = '\0'; // Ensure null termination if it's a string
+    rocksdb_free(value);
+
+    *value_out = copied_value;
+    *value_len_out = value_len;
+    return XSAN_OK;
+}
+
+static xsan_error_t _xsan_rocksdb_delete(xsan_metadata_cf_t *cf, const char *key, size_t key_len) {
+    xsan_rocksdb_backend_t *rdb = _rdb(cf->store);
+    char *err_ptr = NULL;
+    rocksdb_delete_cf(rdb->db, rdb->write_options, cf->backend_cf, key, key_len, &err_ptr);
+    if (err_ptr) {
+        XSAN_LOG_ERROR("RocksDB delete failed for key '%.*s' (cf %s): %s", (int)key_len, key, cf->name, err_ptr);
+        rocksdb_free(err_ptr);
+        return XSAN_ERROR_IO;
+    }
+    return XSAN_OK;
+}
+
+// --- Write batches ---
+
+static void *_xsan_rocksdb_batch_create(xsan_metadata_store_t *store) {
+    (void)store;
+    return rocksdb_writebatch_create();
+}
+
+static void _xsan_rocksdb_batch_destroy(void *batch) {
+    rocksdb_writebatch_destroy((rocksdb_writebatch_t *)batch);
+}
+
+static xsan_error_t _xsan_rocksdb_batch_put(void *batch, xsan_metadata_cf_t *cf, const char *key, size_t key_len,
+                                            const char *value, size_t value_len) {
+    rocksdb_writebatch_put_cf((rocksdb_writebatch_t *)batch, cf->backend_cf, key, key_len, value, value_len);
+    return XSAN_OK;
+}
+
+static xsan_error_t _xsan_rocksdb_batch_delete(void *batch, xsan_metadata_cf_t *cf, const char *key, size_t key_len) {
+    rocksdb_writebatch_delete_cf((rocksdb_writebatch_t *)batch, cf->backend_cf, key, key_len);
+    return XSAN_OK;
+}
+
+static size_t _xsan_rocksdb_batch_count(void *batch) {
+    return (size_t)rocksdb_writebatch_count((rocksdb_writebatch_t *)batch);
+}
+
+static void _xsan_rocksdb_batch_clear(void *batch) {
+    rocksdb_writebatch_clear((rocksdb_writebatch_t *)batch);
+}
+
+static xsan_error_t _xsan_rocksdb_batch_commit(xsan_metadata_store_t *store, void *batch) {
+    xsan_rocksdb_backend_t *rdb = _rdb(store);
+    char *err_ptr = NULL;
+    // One rocksdb_write: all updates land in a single WAL record and become visible together.
+    rocksdb_write(rdb->db, rdb->write_options, (rocksdb_writebatch_t *)batch, &err_ptr);
+    if (err_ptr) {
+        XSAN_LOG_ERROR("RocksDB write of %d-update batch failed: %s",
+                       rocksdb_writebatch_count((rocksdb_writebatch_t *)batch), err_ptr);
+        rocksdb_free(err_ptr);
+        return XSAN_ERROR_IO;
+    }
+    return XSAN_OK;
+}
+
+// --- Iterators ---
+
+static void *_xsan_rocksdb_iter_create(xsan_metadata_cf_t *cf, const char *prefix, size_t prefix_len) {
+    xsan_rocksdb_backend_t *rdb = _rdb(cf->store);
+    xsan_rocksdb_iter_t *iter = (xsan_rocksdb_iter_t *)XSAN_CALLOC(1, sizeof(xsan_rocksdb_iter_t));
+    if (!iter) {
+        XSAN_LOG_ERROR("Failed to allocate memory for RocksDB iterator.");
+        return NULL;
+    }
+    if (!prefix) {
+        // Total-order read options: a general iterator may cross key-type prefixes
+        iter->handle = rocksdb_create_iterator_cf(rdb->db, rdb->iter_read_options, cf->backend_cf);
+        if (!iter->handle) {
+            XSAN_LOG_ERROR("Failed to create RocksDB iterator.");
+            XSAN_FREE(iter);
+            return NULL;
+        }
+        return iter;
+    }
+
+    iter->read_options = rocksdb_readoptions_create();
+    iter->upper_bound = (char *)XSAN_MALLOC(prefix_len);
+    if (!iter->read_options || !iter->upper_bound) {
+        goto fail;
+    }
+    // With the key-type prefix extractor this lets RocksDB skip SST files via the prefix bloom filter
+    // and stop at the end of the prefix; the explicit upper bound keeps it exact for any prefix.
+    rocksdb_readoptions_set_prefix_same_as_start(iter->read_options, rdb->has_prefix_extractor ? 1 : 0);
+    memcpy(iter->upper_bound, prefix, prefix_len);
+    iter->upper_bound_len = prefix_len;
+    // Smallest key greater than every key with this prefix: bump the last byte below 0xff, drop 0xff tails.
+    while (iter->upper_bound_len > 0 && (unsigned char)iter->upper_bound[iter->upper_bound_len - 1] == 0xff) {
+        iter->upper_bound_len--;
+    }
+    if (iter->upper_bound_len > 0) {
+        iter->upper_bound[iter->upper_bound_len - 1]++;
+        rocksdb_readoptions_set_iterate_upper_bound(iter->read_options, iter->upper_bound, iter->upper_bound_len);
+    }
+    iter->handle = rocksdb_create_iterator_cf(rdb->db, iter->read_options, cf->backend_cf);
+    if (!iter->handle) {
+        XSAN_LOG_ERROR("Failed to create RocksDB prefix iterator.");
+        goto fail;
+    }
+    rocksdb_iter_seek(iter->handle, prefix, prefix_len);
+    return iter;
+
+fail:
+    if (iter->read_options) rocksdb_readoptions_destroy(iter->read_options);
+    if (iter->upper_bound) XSAN_FREE(iter->upper_bound);
+    XSAN_FREE(iter);
+    return NULL;
+}
+
+static void _xsan_rocksdb_iter_destroy(void *it) {
+    xsan_rocksdb_iter_t *iter = (xsan_rocksdb_iter_t *)it;
+    rocksdb_iter_destroy(iter->handle);
+    // The iterator references its read options and bound until destroyed
+    if (iter->read_options) {
+        rocksdb_readoptions_destroy(iter->read_options);
+    }
+    if (iter->upper_bound) {
+        XSAN_FREE(iter->upper_bound);
+    }
+    XSAN_FREE(iter);
+}
+
+static void _xsan_rocksdb_iter_seek_to_first(void *it) {
+    rocksdb_iter_seek_to_first(((xsan_rocksdb_iter_t *)it)->handle);
+}
+
+static void _xsan_rocksdb_iter_seek(void *it, const char *key, size_t key_len) {
+    rocksdb_iter_seek(((xsan_rocksdb_iter_t *)it)->handle, key, key_len);
+}
+
+static void _xsan_rocksdb_iter_next(void *it) {
+    rocksdb_iter_next(((xsan_rocksdb_iter_t *)it)->handle);
+}
+
+static bool _xsan_rocksdb_iter_valid(void *it) {
+    return rocksdb_iter_valid(((xsan_rocksdb_iter_t *)it)->handle);
+}
+
+static const char *_xsan_rocksdb_iter_key(void *it, size_t *key_len_out) {
+    return rocksdb_iter_key(((xsan_rocksdb_iter_t *)it)->handle, key_len_out);
+}
+
+static const char *_xsan_rocksdb_iter_value(void *it, size_t *value_len_out) {
+    return rocksdb_iter_value(((xsan_rocksdb_iter_t *)it)->handle, value_len_out);
+}
+
+// --- Checkpoint and statistics ---
+
+static xsan_error_t _xsan_rocksdb_checkpoint(xsan_metadata_store_t *store, const char *dir) {
+    xsan_rocksdb_backend_t *rdb = _rdb(store);
+    char *err_ptr = NULL;
+    rocksdb_checkpoint_t *checkpoint = rocksdb_checkpoint_object_create(rdb->db, &err_ptr);
+    if (!err_ptr && checkpoint) {
+        // Flush the memtables first so the checkpoint needs no WAL replay; SST files are hard-linked.
+        rocksdb_checkpoint_create(checkpoint, dir, 0, &err_ptr);
+    }
+    if (checkpoint) {
+        rocksdb_checkpoint_object_destroy(checkpoint);
+    }
+    if (err_ptr || !checkpoint) {
+        XSAN_LOG_ERROR("RocksDB checkpoint to '%s' failed: %s", dir, err_ptr ? err_ptr : "unknown error");
+        if (err_ptr) rocksdb_free(err_ptr);
+        return XSAN_ERROR_IO;
+    }
+    return XSAN_OK;
+}
+
+static char *_xsan_rocksdb_get_statistics(xsan_metadata_store_t *store) {
+    xsan_rocksdb_backend_t *rdb = _rdb(store);
+    if (!rdb->statistics_enabled) {
+        return NULL;
+    }
+    char *stats = rocksdb_options_statistics_get_string(rdb->db_options);
+    if (!stats) {
+        return NULL;
+    }
+    char *copy = xsan_strdup(stats);
+    rocksdb_free(stats);
+    return copy;
+}
+
+xsan_error_t xsan_metadata_rocksdb_scan_legacy(const char *path, xsan_metadata_record_cb_t cb, void *cb_arg,
+                                               size_t *count_out) {
+    xsan_error_t err = XSAN_OK;
+    size_t count = 0;
+    rocksdb_options_t *legacy_options = rocksdb_options_create();
+    rocksdb_readoptions_t *legacy_read_options = rocksdb_readoptions_create();
+    if (!legacy_options || !legacy_read_options) {
+        err = XSAN_ERROR_NO_MEMORY;
+        goto out;
+    }
+    char *err_ptr = NULL;
+    rocksdb_t *legacy_db = rocksdb_open_for_read_only(legacy_options, path, 0, &err_ptr);
+    if (err_ptr || !legacy_db) {
+        XSAN_LOG_ERROR("Failed to open legacy metadata DB '%s' read-only: %s", path, err_ptr ? err_ptr : "unknown error");
+        if (err_ptr) rocksdb_free(err_ptr);
+        err = XSAN_ERROR_IO;
+        goto out;
+    }
+    rocksdb_iterator_t *it = rocksdb_create_iterator(legacy_db, legacy_read_options);
+    if (!it) {
+        err = XSAN_ERROR_NO_MEMORY;
+    } else {
+        for (rocksdb_iter_seek_to_first(it); err == XSAN_OK && rocksdb_iter_valid(it); rocksdb_iter_next(it)) {
+            size_t key_len = 0, value_len = 0;
+            const char *key = rocksdb_iter_key(it, &key_len);
+            const char *value = rocksdb_iter_value(it, &value_len);
+            err = cb(cb_arg, key, key_len, value, value_len);
+            count++;
+        }
+        rocksdb_iter_destroy(it);
+    }
+    rocksdb_close(legacy_db);
+
+out:
+    if (legacy_read_options) rocksdb_readoptions_destroy(legacy_read_options);
+    if (legacy_options) rocksdb_options_destroy(legacy_options);
+    if (count_out) *count_out = count;
+    return err;
+}
+
+const xsan_metadata_backend_ops_t xsan_metadata_backend_rocksdb = {
+    .name = "rocksdb",
+    .open = _xsan_rocksdb_open,
+    .close = _xsan_rocksdb_close,
+    .put = _xsan_rocksdb_put,
+    .get = _xsan_rocksdb_get,
+    .del = _xsan_rocksdb_delete,
+    .batch_create = _xsan_rocksdb_batch_create,
+    .batch_destroy = _xsan_rocksdb_batch_destroy,
+    .batch_put = _xsan_rocksdb_batch_put,
+    .batch_delete = _xsan_rocksdb_batch_delete,
+    .batch_count = _xsan_rocksdb_batch_count,
+    .batch_clear = _xsan_rocksdb_batch_clear,
+    .batch_commit = _xsan_rocksdb_batch_commit,
+    .iter_create = _xsan_rocksdb_iter_create,
+    .iter_destroy = _xsan_rocksdb_iter_destroy,
+    .iter_seek_to_first = _xsan_rocksdb_iter_seek_to_first,
+    .iter_seek = _xsan_rocksdb_iter_seek,
+    .iter_next = _xsan_rocksdb_iter_next,
+    .iter_valid = _xsan_rocksdb_iter_valid,
+    .iter_key = _xsan_rocksdb_iter_key,
+    .iter_value = _xsan_rocksdb_iter_value,
+    .checkpoint = _xsan_rocksdb_checkpoint,
+    .get_statistics = _xsan_rocksdb_get_statistics,
+};
@@ -0,0 +1,644 @@
+#include "xsan_metadata_snapshot.h"
+#include "xsan_metadata_store.h"
+#include "xsan_node_comm.h"
+#include "xsan_protocol.h"
+#include "xsan_memory.h" // For XSAN_MALLOC, XSAN_FREE
+#include "../../include/xsan_error.h"
+#include "xsan_log.h"
+
+#include "spdk/crc32.h"
+#include "spdk/env.h"    // For spdk_get_ticks
+#include "spdk/thread.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define XSAN_MD_SNAPSHOT_PATH_LEN 1024
+#define XSAN_MD_SNAPSHOT_IDLE_POLL_US (100 * 1000)
+#define XSAN_MD_SNAPSHOT_CHUNK_HDR_SIZE ((uint32_t)sizeof(xsan_metadata_snapshot_chunk_payload_t))
+
+// --- Sending side: one session per request, on the reactor that owns the requester's connection ---
+
+typedef struct {
+    struct spdk_sock *sock;
+    uint64_t tid;
+    char peer[64];
+    char dir[XSAN_MD_SNAPSHOT_PATH_LEN];  // Checkpoint being sent, removed when the session ends
+    char **files;
+    uint32_t num_files;
+    uint32_t file_idx;                    // File being read
+    int fd;
+    uint64_t file_size;
+    uint64_t offset;
+    uint32_t chunk_bytes;
+    uint32_t in_flight;
+    uint64_t bytes_sent;
+    xsan_error_t status;                  // Reported in the end marker
+    bool end_queued;
+    bool failed;                          // Connection gone; stop sending
+    uint64_t start_ticks;
+} xsan_md_snapshot_send_t;
+
+typedef struct {
+    xsan_md_snapshot_send_t *session;
+    xsan_message_t *msg;
+} xsan_md_snapshot_send_req_t;
+
+static uint32_t g_xsan_md_snapshot_seq = 0;
+
+static uint32_t _xsan_md_snapshot_crc(const void *data, size_t len) {
+    return spdk_crc32c_update(data, len, ~0u) ^ ~0u;
+}
+
+static double _xsan_md_snapshot_elapsed_ms(uint64_t start_ticks) {
+    return (double)(spdk_get_ticks() - start_ticks) * 1000.0 / (double)spdk_get_ticks_hz();
+}
+
+// Snapshot directories are flat (RocksDB checkpoints and memlog logs have no subdirectories).
+static void _xsan_md_snapshot_remove_dir(const char *dir) {
+    DIR *d = opendir(dir);
+    if (!d) {
+        return;
+    }
+    char path[XSAN_MD_SNAPSHOT_PATH_LEN];
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) {
+            continue;
+        }
+        if (snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name) < (int)sizeof(path)) {
+            unlink(path);
+        }
+    }
+    closedir(d);
+    rmdir(dir);
+}
+
+static void _xsan_md_snapshot_fsync_path(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        (void)fsync(fd);
+        close(fd);
+    }
+}
+
+static void _xsan_md_snapshot_fsync_parent(const char *path) {
+    char dir[XSAN_MD_SNAPSHOT_PATH_LEN];
+    snprintf(dir, sizeof(dir), "%s", path);
+    char *slash = strrchr(dir, '/');
+    if (!slash) {
+        snprintf(dir, sizeof(dir), ".");
+    } else if (slash != dir) {
+        *slash = '\0';
+    } else {
+        dir[1] = '\0';
+    }
+    _xsan_md_snapshot_fsync_path(dir);
+}
+
+static xsan_error_t _xsan_md_snapshot_list_files(xsan_md_snapshot_send_t *s) {
+    DIR *d = opendir(s->dir);
+    if (!d) {
+        return XSAN_ERROR_IO;
+    }
+    xsan_error_t err = XSAN_OK;
+    uint32_t cap = 0;
+    char path[XSAN_MD_SNAPSHOT_PATH_LEN];
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        struct stat st;
+        if (snprintf(path, sizeof(path), "%s/%s", s->dir, ent->d_name) >= (int)sizeof(path) ||
+            stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+        if (strlen(ent->d_name) >= XSAN_METADATA_SNAPSHOT_NAME_MAX) {
+            XSAN_LOG_ERROR("Metadata snapshot file name '%s' is too long to send.", ent->d_name);
+            err = XSAN_ERROR_UNSUPPORTED;
+            break;
+        }
+        if (s->num_files == cap) {
+            uint32_t new_cap = cap ? cap * 2 : 16;
+            char **files = (char **)XSAN_REALLOC(s->files, sizeof(char *) * new_cap);
+            if (!files) {
+                err = XSAN_ERROR_NO_MEMORY;
+                break;
+            }
+            s->files = files;
+            cap = new_cap;
+        }
+        s->files[s->num_files] = xsan_strdup(ent->d_name);
+        if (!s->files[s->num_files]) {
+            err = XSAN_ERROR_NO_MEMORY;
+            break;
+        }
+        s->num_files++;
+    }
+    closedir(d);
+    return err;
+}
+
+// Checkpoints the node store next to it; the checkpoint shares SST files with the store (hard links).
+static xsan_error_t _xsan_md_snapshot_prepare(xsan_md_snapshot_send_t *s, const char *requester_backend) {
+    xsan_metadata_store_t *store = xsan_metadata_store_node_acquire();
+    if (!store) {
+        return XSAN_ERROR_NOT_INITIALIZED;
+    }
+    xsan_error_t err = XSAN_OK;
+    if (strcmp(xsan_metadata_store_backend_name(store), requester_backend) != 0) {
+        XSAN_LOG_ERROR("Metadata snapshot requested by %s for backend '%s', but this node uses '%s'.",
+                       s->peer, requester_backend, xsan_metadata_store_backend_name(store));
+        err = XSAN_ERROR_UNSUPPORTED;
+    } else {
+        snprintf(s->dir, sizeof(s->dir), "%s.snapshot-out.%u", XSAN_METADATA_NODE_DB_PATH, ++g_xsan_md_snapshot_seq);
+        _xsan_md_snapshot_remove_dir(s->dir); // Left over from a crashed run
+        err = xsan_metadata_store_checkpoint(store, s->dir);
+    }
+    xsan_metadata_store_node_release(store);
+    if (err == XSAN_OK) {
+        err = _xsan_md_snapshot_list_files(s);
+    }
+    return err;
+}
+
+static xsan_message_t *_xsan_md_snapshot_chunk_msg(uint64_t tid, uint32_t data_len,
+                                                   xsan_metadata_snapshot_chunk_payload_t **hdr_out) {
+    xsan_message_t *msg = xsan_protocol_message_create(XSAN_MSG_TYPE_METADATA_SNAPSHOT_CHUNK, tid, NULL, 0);
+    if (!msg) {
+        return NULL;
+    }
+    // File data is read straight into the payload, after the structured part.
+    msg->payload = (unsigned char *)XSAN_MALLOC(XSAN_MD_SNAPSHOT_CHUNK_HDR_SIZE + data_len);
+    if (!msg->payload) {
+        xsan_protocol_message_destroy(msg);
+        return NULL;
+    }
+    msg->header.payload_length = XSAN_MD_SNAPSHOT_CHUNK_HDR_SIZE + data_len;
+    *hdr_out = (xsan_metadata_snapshot_chunk_payload_t *)msg->payload;
+    memset(*hdr_out, 0, XSAN_MD_SNAPSHOT_CHUNK_HDR_SIZE);
+    return msg;
+}
+
+static xsan_message_t *_xsan_md_snapshot_end_msg(xsan_md_snapshot_send_t *s) {
+    xsan_metadata_snapshot_chunk_payload_t *hdr = NULL;
+    xsan_message_t *msg = _xsan_md_snapshot_chunk_msg(s->tid, 0, &hdr);
+    if (msg) {
+        hdr->status = s->status;
+        hdr->flags = XSAN_METADATA_SNAPSHOT_FLAG_END;
+        hdr->file_size = s->bytes_sent;
+        hdr->offset = s->num_files;
+    }
+    s->end_queued = true;
+    return msg;
+}
+
+// Reads the next chunk of the current file; after the last file (or a read error) builds the end marker.
+static xsan_message_t *_xsan_md_snapshot_next_msg(xsan_md_snapshot_send_t *s) {
+    if (s->status != XSAN_OK || s->file_idx == s->num_files) {
+        return _xsan_md_snapshot_end_msg(s);
+    }
+    char path[XSAN_MD_SNAPSHOT_PATH_LEN];
+    if (s->fd < 0) {
+        struct stat st;
+        if (snprintf(path, sizeof(path), "%s/%s", s->dir, s->files[s->file_idx]) < (int)sizeof(path)) {
+            s->fd = open(path, O_RDONLY);
+        }
+        if (s->fd < 0 || fstat(s->fd, &st) != 0) {
+            XSAN_LOG_ERROR("Failed to open metadata snapshot file '%s': %s", path, strerror(errno));
+            s->status = XSAN_ERROR_IO;
+            return _xsan_md_snapshot_end_msg(s);
+        }
+        s->file_size = (uint64_t)st.st_size;
+        s->offset = 0;
+    }
+    uint64_t remaining = s->file_size - s->offset;
+    uint32_t len = remaining < s->chunk_bytes ? (uint32_t)remaining : s->chunk_bytes;
+    xsan_metadata_snapshot_chunk_payload_t *hdr = NULL;
+    xsan_message_t *msg = _xsan_md_snapshot_chunk_msg(s->tid, len, &hdr);
+    if (!msg) {
+        return NULL;
+    }
+    unsigned char *data = msg->payload + XSAN_MD_SNAPSHOT_CHUNK_HDR_SIZE;
+    for (uint32_t done = 0; done < len;) {
+        ssize_t n = pread(s->fd, data + done, len - done, (off_t)(s->offset + done));
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            XSAN_LOG_ERROR("Failed to read metadata snapshot file '%s' at %lu.", s->files[s->file_idx],
+                           (unsigned long)(s->offset + done));
+            xsan_protocol_message_destroy(msg);
+            s->status = XSAN_ERROR_IO;
+            return _xsan_md_snapshot_end_msg(s);
+        }
+        done += (uint32_t)n;
+    }
+    snprintf(hdr->file_name, sizeof(hdr->file_name), "%s", s->files[s->file_idx]);
+    hdr->status = XSAN_OK;
+    hdr->file_size = s->file_size;
+    hdr->offset = s->offset;
+    hdr->data_len = len;
+    hdr->data_crc32c = _xsan_md_snapshot_crc(data, len);
+
+    s->offset += len;
+    s->bytes_sent += len;
+    if (s->offset >= s->file_size) {
+        close(s->fd);
+        s->fd = -1;
+        s->file_idx++;
+    }
+    return msg;
+}
+
+static void _xsan_md_snapshot_send_finish(xsan_md_snapshot_send_t *s) {
+    if (s->fd >= 0) {
+        close(s->fd);
+    }
+    if (s->failed || s->status != XSAN_OK) {
+        XSAN_LOG_ERROR("Metadata snapshot to %s failed after %lu bytes (status %d).", s->peer,
+                       (unsigned long)s->bytes_sent, s->failed ? XSAN_ERROR_CONNECTION_LOST : s->status);
+    } else {
+        XSAN_LOG_INFO("Metadata snapshot sent to %s: %u file(s), %lu bytes in %.1f ms.", s->peer, s->num_files,
+                      (unsigned long)s->bytes_sent, _xsan_md_snapshot_elapsed_ms(s->start_ticks));
+    }
+    if (s->dir[0] != '\0') {
+        _xsan_md_snapshot_remove_dir(s->dir);
+    }
+    for (uint32_t i = 0; i < s->num_files; ++i) {
+        XSAN_FREE(s->files[i]);
+    }
+    XSAN_FREE(s->files);
+    XSAN_FREE(s);
+}
+
+static void _xsan_md_snapshot_chunk_sent_cb(int status, void *cb_arg);
+
+// Keeps up to XSAN_METADATA_SNAPSHOT_SEND_DEPTH chunks queued; node comm flow control paces the rest.
+static void _xsan_md_snapshot_pump(xsan_md_snapshot_send_t *s) {
+    while (!s->end_queued && !s->failed && s->in_flight < XSAN_METADATA_SNAPSHOT_SEND_DEPTH) {
+        xsan_md_snapshot_send_req_t *req = (xsan_md_snapshot_send_req_t *)XSAN_MALLOC(sizeof(*req));
+        xsan_message_t *msg = req ? _xsan_md_snapshot_next_msg(s) : NULL;
+        if (!msg) {
+            XSAN_FREE(req);
+            s->failed = true;
+            break;
+        }
+        req->session = s;
+        req->msg = msg;
+        xsan_error_t err = xsan_node_comm_send_msg(s->sock, msg, _xsan_md_snapshot_chunk_sent_cb, req);
+        if (err != XSAN_OK) {
+            XSAN_LOG_ERROR("Failed to queue metadata snapshot chunk to %s (error %d).", s->peer, err);
+            xsan_protocol_message_destroy(msg);
+            XSAN_FREE(req);
+            s->failed = true;
+            break;
+        }
+        s->in_flight++;
+    }
+    if (s->in_flight == 0) {
+        _xsan_md_snapshot_send_finish(s);
+    }
+}
+
+static void _xsan_md_snapshot_chunk_sent_cb(int status, void *cb_arg) {
+    xsan_md_snapshot_send_req_t *req = (xsan_md_snapshot_send_req_t *)cb_arg;
+    xsan_md_snapshot_send_t *s = req->session;
+    xsan_protocol_message_destroy(req->msg);
+    XSAN_FREE(req);
+    s->in_flight--;
+    if (status != 0) {
+        s->failed = true;
+    }
+    _xsan_md_snapshot_pump(s);
+}
+
+static void _xsan_md_snapshot_handle_req(struct xsan_connection_ctx *conn_ctx, xsan_message_t *msg, void *cb_arg) {
+    (void)cb_arg;
+    xsan_md_snapshot_send_t *s = (xsan_md_snapshot_send_t *)XSAN_CALLOC(1, sizeof(*s));
+    if (!s) {
+        xsan_protocol_message_destroy(msg);
+        return;
+    }
+    s->sock = xsan_node_comm_conn_get_sock(conn_ctx);
+    s->tid = msg->header.transaction_id;
+    snprintf(s->peer, sizeof(s->peer), "%s", xsan_node_comm_conn_get_peer(conn_ctx));
+    s->fd = -1;
+    s->chunk_bytes = XSAN_METADATA_SNAPSHOT_DEFAULT_CHUNK_BYTES;
+    s->start_ticks = spdk_get_ticks();
+
+    xsan_metadata_snapshot_req_payload_t req;
+    if (msg->header.payload_length != sizeof(req)) {
+        s->status = XSAN_ERROR_INVALID_PARAM;
+    } else {
+        memcpy(&req, msg->payload, sizeof(req));
+        req.backend[sizeof(req.backend) - 1] = '\0';
+        if (req.max_chunk_bytes != 0 && req.max_chunk_bytes < s->chunk_bytes) {
+            s->chunk_bytes = req.max_chunk_bytes;
+        }
+        XSAN_LOG_INFO("Metadata snapshot requested by %s (%u-byte chunks).", s->peer, s->chunk_bytes);
+        s->status = _xsan_md_snapshot_prepare(s, req.backend);
+    }
+    xsan_protocol_message_destroy(msg);
+    _xsan_md_snapshot_pump(s); // Sends the end marker with the error if preparing failed
+}
+
+// --- Receiving side: a single fetch, driven on the thread that started it ---
+
+typedef struct {
+    bool active;
+    char peer_ip[64];
+    uint16_t peer_port;
+    char dest_dir[XSAN_MD_SNAPSHOT_PATH_LEN];
+    char partial_dir[XSAN_MD_SNAPSHOT_PATH_LEN];
+    uint64_t tid;
+    uint32_t chunk_bytes;
+    struct spdk_poller *idle_poller;
+    uint64_t idle_timeout_ticks;
+    uint64_t last_progress_ticks;
+    uint64_t start_ticks;
+    // File being written; chunks of one file arrive in offset order, files one after another.
+    char cur_name[XSAN_METADATA_SNAPSHOT_NAME_MAX];
+    int fd;
+    uint64_t cur_size;
+    uint64_t cur_written;
+    uint64_t files;
+    uint64_t bytes;
+    xsan_metadata_snapshot_done_cb_t cb;
+    void *cb_arg;
+} xsan_md_snapshot_fetch_t;
+
+static xsan_md_snapshot_fetch_t g_xsan_md_snapshot_fetch = { .fd = -1 };
+
+static void _xsan_md_snapshot_fetch_finish(xsan_error_t status) {
+    xsan_md_snapshot_fetch_t *f = &g_xsan_md_snapshot_fetch;
+    if (f->fd >= 0) {
+        close(f->fd);
+        f->fd = -1;
+    }
+    if (f->idle_poller) {
+        spdk_poller_unregister(&f->idle_poller);
+    }
+    if (status != XSAN_OK) {
+        _xsan_md_snapshot_remove_dir(f->partial_dir);
+        XSAN_LOG_ERROR("Metadata snapshot fetch from %s:%u failed (error %d).", f->peer_ip, f->peer_port, status);
+    } else {
+        double ms = _xsan_md_snapshot_elapsed_ms(f->start_ticks);
+        XSAN_LOG_INFO("Metadata snapshot fetched from %s:%u into '%s': %lu file(s), %lu bytes in %.1f ms (%.1f MB/s).",
+                      f->peer_ip, f->peer_port, f->dest_dir, (unsigned long)f->files, (unsigned long)f->bytes, ms,
+                      ms > 0 ? (double)f->bytes / (1024.0 * 1024.0) / (ms / 1000.0) : 0.0);
+    }
+    xsan_metadata_snapshot_done_cb_t cb = f->cb;
+    void *cb_arg = f->cb_arg;
+    f->active = false;
+    if (cb) {
+        cb(cb_arg, status);
+    }
+}
+
+static int _xsan_md_snapshot_idle_poll(void *arg) {
+    (void)arg;
+    xsan_md_snapshot_fetch_t *f = &g_xsan_md_snapshot_fetch;
+    if (f->active && spdk_get_ticks() - f->last_progress_ticks > f->idle_timeout_ticks) {
+        _xsan_md_snapshot_fetch_finish(XSAN_ERROR_TIMEOUT);
+        return SPDK_POLLER_BUSY;
+    }
+    return SPDK_POLLER_IDLE;
+}
+
+static bool _xsan_md_snapshot_name_ok(const char *name) {
+    size_t len = strnlen(name, XSAN_METADATA_SNAPSHOT_NAME_MAX);
+    return len > 0 && len < XSAN_METADATA_SNAPSHOT_NAME_MAX && !strchr(name, '/') &&
+           strcmp(name, ".") != 0 && strcmp(name, "..") != 0;
+}
+
+static xsan_error_t _xsan_md_snapshot_write_chunk(xsan_md_snapshot_fetch_t *f,
+                                                  const xsan_metadata_snapshot_chunk_payload_t *hdr,
+                                                  const unsigned char *data) {
+    if (!_xsan_md_snapshot_name_ok(hdr->file_name)) {
+        return XSAN_ERROR_METADATA_CORRUPTED;
+    }
+    if (_xsan_md_snapshot_crc(data, hdr->data_len) != hdr->data_crc32c) {
+        XSAN_LOG_ERROR("Metadata snapshot chunk of '%s' at %lu failed its CRC check.", hdr->file_name,
+                       (unsigned long)hdr->offset);
+        return XSAN_ERROR_METADATA_CORRUPTED;
+    }
+    if (f->fd < 0) {
+        if (hdr->offset != 0) {
+            return XSAN_ERROR_METADATA_CORRUPTED;
+        }
+        char path[XSAN_MD_SNAPSHOT_PATH_LEN];
+        if (snprintf(path, sizeof(path), "%s/%s", f->partial_dir, hdr->file_name) >= (int)sizeof(path)) {
+            return XSAN_ERROR_INVALID_PARAM;
+        }
+        f->fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (f->fd < 0) {
+            XSAN_LOG_ERROR("Failed to create '%s': %s", path, strerror(errno));
+            return XSAN_ERROR_IO;
+        }
+        snprintf(f->cur_name, sizeof(f->cur_name), "%s", hdr->file_name);
+        f->cur_size = hdr->file_size;
+        f->cur_written = 0;
+        f->files++;
+    } else if (strcmp(f->cur_name, hdr->file_name) != 0 || hdr->offset != f->cur_written) {
+        return XSAN_ERROR_METADATA_CORRUPTED;
+    }
+    if (f->cur_written + hdr->data_len > f->cur_size) {
+        return XSAN_ERROR_METADATA_CORRUPTED;
+    }
+    for (uint32_t done = 0; done < hdr->data_len;) {
+        ssize_t n = pwrite(f->fd, data + done, hdr->data_len - done, (off_t)(hdr->offset + done));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            XSAN_LOG_ERROR("Failed to write metadata snapshot file '%s': %s", f->cur_name, strerror(errno));
+            return XSAN_ERROR_IO;
+        }
+        done += (uint32_t)n;
+    }
+    f->cur_written += hdr->data_len;
+    f->bytes += hdr->data_len;
+    if (f->cur_written == f->cur_size) {
+        if (fsync(f->fd) != 0) {
+            return XSAN_ERROR_IO;
+        }
+        close(f->fd);
+        f->fd = -1;
+    }
+    return XSAN_OK;
+}
+
+// Checks the totals against the end marker, then publishes the snapshot under its final name.
+static xsan_error_t _xsan_md_snapshot_complete(xsan_md_snapshot_fetch_t *f, const xsan_metadata_snapshot_chunk_payload_t *hdr) {
+    if (hdr->status != XSAN_OK) {
+        return hdr->status;
+    }
+    if (f->fd >= 0 || hdr->offset != f->files || hdr->file_size != f->bytes) {
+        XSAN_LOG_ERROR("Metadata snapshot incomplete: got %lu file(s) / %lu bytes, sender reported %lu / %lu.",
+                       (unsigned long)f->files, (unsigned long)f->bytes, (unsigned long)hdr->offset,
+                       (unsigned long)hdr->file_size);
+        return XSAN_ERROR_METADATA_CORRUPTED;
+    }
+    _xsan_md_snapshot_fsync_path(f->partial_dir);
+    if (rename(f->partial_dir, f->dest_dir) != 0) {
+        XSAN_LOG_ERROR("Failed to rename '%s' to '%s': %s", f->partial_dir, f->dest_dir, strerror(errno));
+        return XSAN_ERROR_IO;
+    }
+    _xsan_md_snapshot_fsync_parent(f->dest_dir);
+    return XSAN_OK;
+}
+
+static void _xsan_md_snapshot_handle_chunk(struct xsan_connection_ctx *conn_ctx, xsan_message_t *msg, void *cb_arg) {
+    (void)conn_ctx;
+    (void)cb_arg;
+    xsan_md_snapshot_fetch_t *f = &g_xsan_md_snapshot_fetch;
+    if (!f->active || msg->header.transaction_id != f->tid) {
+        XSAN_LOG_DEBUG("Dropping metadata snapshot chunk for TID %lu (no such fetch).", msg->header.transaction_id);
+        xsan_protocol_message_destroy(msg);
+        return;
+    }
+    f->last_progress_ticks = spdk_get_ticks();
+    xsan_metadata_snapshot_chunk_payload_t hdr;
+    xsan_error_t err = XSAN_OK;
+    if (msg->header.payload_length < XSAN_MD_SNAPSHOT_CHUNK_HDR_SIZE) {
+        err = XSAN_ERROR_METADATA_CORRUPTED;
+    } else {
+        memcpy(&hdr, msg->payload, sizeof(hdr));
+        if (hdr.data_len != msg->header.payload_length - XSAN_MD_SNAPSHOT_CHUNK_HDR_SIZE) {
+            err = XSAN_ERROR_METADATA_CORRUPTED;
+        } else if (hdr.flags & XSAN_METADATA_SNAPSHOT_FLAG_END) {
+            err = _xsan_md_snapshot_complete(f, &hdr);
+            xsan_protocol_message_destroy(msg);
+            _xsan_md_snapshot_fetch_finish(err);
+            return;
+        } else {
+            hdr.file_name[sizeof(hdr.file_name) - 1] = '\0';
+            err = _xsan_md_snapshot_write_chunk(f, &hdr, msg->payload + XSAN_MD_SNAPSHOT_CHUNK_HDR_SIZE);
+        }
+    }
+    xsan_protocol_message_destroy(msg);
+    if (err != XSAN_OK) {
+        _xsan_md_snapshot_fetch_finish(err);
+    }
+}
+
+static void _xsan_md_snapshot_req_sent_cb(int status, void *cb_arg) {
+    xsan_message_t *msg = (xsan_message_t *)cb_arg;
+    uint64_t tid = msg->header.transaction_id;
+    xsan_protocol_message_destroy(msg);
+    if (status != 0 && g_xsan_md_snapshot_fetch.active && g_xsan_md_snapshot_fetch.tid == tid) {
+        _xsan_md_snapshot_fetch_finish(XSAN_ERROR_CONNECTION_LOST);
+    }
+}
+
+static void _xsan_md_snapshot_connect_cb(struct spdk_sock *sock, int status, void *cb_arg) {
+    uint64_t tid = (uint64_t)(uintptr_t)cb_arg;
+    xsan_md_snapshot_fetch_t *f = &g_xsan_md_snapshot_fetch;
+    if (!f->active || f->tid != tid) {
+        return; // Aborted or timed out while connecting
+    }
+    if (status != 0 || !sock) {
+        _xsan_md_snapshot_fetch_finish(XSAN_ERROR_NODE_UNREACHABLE);
+        return;
+    }
+    xsan_metadata_snapshot_req_payload_t req;
+    memset(&req, 0, sizeof(req));
+    snprintf(req.backend, sizeof(req.backend), "%s", xsan_metadata_store_default_backend_name());
+    req.max_chunk_bytes = f->chunk_bytes;
+    xsan_message_t *msg = xsan_protocol_message_create(XSAN_MSG_TYPE_METADATA_SNAPSHOT_REQ, f->tid, &req, sizeof(req));
+    if (!msg) {
+        _xsan_md_snapshot_fetch_finish(XSAN_ERROR_NO_MEMORY);
+        return;
+    }
+    xsan_error_t err = xsan_node_comm_send_msg(sock, msg, _xsan_md_snapshot_req_sent_cb, msg);
+    if (err != XSAN_OK) {
+        xsan_protocol_message_destroy(msg);
+        _xsan_md_snapshot_fetch_finish(err);
+        return;
+    }
+    f->last_progress_ticks = spdk_get_ticks();
+}
+
+xsan_error_t xsan_metadata_snapshot_fetch(const char *peer_ip, uint16_t peer_port, const char *dest_dir,
+                                          uint32_t chunk_bytes, uint32_t idle_timeout_ms,
+                                          xsan_metadata_snapshot_done_cb_t cb, void *cb_arg) {
+    xsan_md_snapshot_fetch_t *f = &g_xsan_md_snapshot_fetch;
+    if (!peer_ip || !dest_dir || !cb || strlen(dest_dir) + sizeof(".partial") > sizeof(f->partial_dir) ||
+        chunk_bytes > XSAN_PROTOCOL_MAX_PAYLOAD_SIZE - XSAN_MD_SNAPSHOT_CHUNK_HDR_SIZE) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    if (spdk_get_thread() == NULL) {
+        return XSAN_ERROR_THREAD_CONTEXT;
+    }
+    if (f->active) {
+        return XSAN_ERROR_BUSY;
+    }
+    if (access(dest_dir, F_OK) == 0) {
+        return XSAN_ERROR_ALREADY_EXISTS;
+    }
+    memset(f, 0, sizeof(*f));
+    f->fd = -1;
+    snprintf(f->peer_ip, sizeof(f->peer_ip), "%s", peer_ip);
+    f->peer_port = peer_port;
+    snprintf(f->dest_dir, sizeof(f->dest_dir), "%s", dest_dir);
+    snprintf(f->partial_dir, sizeof(f->partial_dir), "%s.partial", dest_dir);
+    f->chunk_bytes = chunk_bytes ? chunk_bytes : XSAN_METADATA_SNAPSHOT_DEFAULT_CHUNK_BYTES;
+    f->idle_timeout_ticks = (uint64_t)(idle_timeout_ms ? idle_timeout_ms : XSAN_METADATA_SNAPSHOT_DEFAULT_IDLE_TIMEOUT_MS) *
+                            spdk_get_ticks_hz() / 1000;
+    f->tid = ((uint64_t)getpid() << 32) | ++g_xsan_md_snapshot_seq;
+    f->cb = cb;
+    f->cb_arg = cb_arg;
+
+    // A fresh node has no metadata directory yet.
+    char parent[XSAN_MD_SNAPSHOT_PATH_LEN];
+    snprintf(parent, sizeof(parent), "%s", dest_dir);
+    char *slash = strrchr(parent, '/');
+    if (slash && slash != parent) {
+        *slash = '\0';
+        if (mkdir(parent, 0755) != 0 && errno != EEXIST) {
+            XSAN_LOG_ERROR("Failed to create '%s': %s", parent, strerror(errno));
+            return XSAN_ERROR_IO;
+        }
+    }
+    _xsan_md_snapshot_remove_dir(f->partial_dir); // Left over from an interrupted fetch
+    if (mkdir(f->partial_dir, 0755) != 0) {
+        XSAN_LOG_ERROR("Failed to create '%s': %s", f->partial_dir, strerror(errno));
+        return XSAN_ERROR_IO;
+    }
+    f->idle_poller = SPDK_POLLER_REGISTER(_xsan_md_snapshot_idle_poll, NULL, XSAN_MD_SNAPSHOT_IDLE_POLL_US);
+    if (!f->idle_poller) {
+        rmdir(f->partial_dir);
+        return XSAN_ERROR_NO_MEMORY;
+    }
+    f->start_ticks = spdk_get_ticks();
+    f->last_progress_ticks = f->start_ticks;
+    f->active = true;
+    XSAN_LOG_INFO("Fetching metadata snapshot from %s:%u into '%s'.", peer_ip, peer_port, dest_dir);
+    xsan_error_t err = xsan_node_comm_connect(peer_ip, peer_port, _xsan_md_snapshot_connect_cb, (void *)(uintptr_t)f->tid);
+    if (err != XSAN_OK) {
+        f->cb = NULL; // Failing synchronously: report through the return value only
+        _xsan_md_snapshot_fetch_finish(err);
+        return err;
+    }
+    return XSAN_OK;
+}
+
+void xsan_metadata_snapshot_fetch_abort(void) {
+    if (g_xsan_md_snapshot_fetch.active) {
+        _xsan_md_snapshot_fetch_finish(XSAN_ERROR_INTERRUPTED);
+    }
+}
+
+xsan_error_t xsan_metadata_snapshot_register_handlers(void) {
+    xsan_error_t err = xsan_node_comm_register_message_handler(XSAN_MSG_TYPE_METADATA_SNAPSHOT_REQ,
+                                                               _xsan_md_snapshot_handle_req, NULL);
+    if (err == XSAN_OK) {
+        err = xsan_node_comm_register_message_handler(XSAN_MSG_TYPE_METADATA_SNAPSHOT_CHUNK,
+                                                      _xsan_md_snapshot_handle_chunk, NULL);
+    }
+    return err;
+}
@@ -0,0 +1,27 @@
+// xsan_metadata_snapshot.h
+// 节点元数据库快照的网络传输: 对端按请求生成 checkpoint 并通过 node comm 分块推送全部文件,
+// 新节点 (或替换节点) 收齐、校验后用 xsan_metadata_store_node_install 直接装为节点库, 无需逐条重放记录
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "../../include/xsan_error.h"
+
+#define XSAN_METADATA_SNAPSHOT_DEFAULT_CHUNK_BYTES (4u * 1024 * 1024)
+#define XSAN_METADATA_SNAPSHOT_DEFAULT_IDLE_TIMEOUT_MS 30000
+// 发送端同时在途的数据块数
+#define XSAN_METADATA_SNAPSHOT_SEND_DEPTH 4
+
+typedef void (*xsan_metadata_snapshot_done_cb_t)(void *cb_arg, xsan_error_t status);
+
+// 注册 XSAN_MSG_TYPE_METADATA_SNAPSHOT_REQ / _CHUNK 的处理函数; 在 xsan_node_comm_init 之后调用。
+// 收到请求时对节点库做 checkpoint (临时目录位于节点库旁, 发送完删除) 并在同一连接上推送
+xsan_error_t xsan_metadata_snapshot_register_handlers(void);
+
+// 从 peer 拉取其节点库快照到 dest_dir (不能已存在; 接收中写在 <dest_dir>.partial)。必须在 SPDK 线程调用,
+// cb 在同一线程回调。chunk_bytes 为 0 时用默认值; 超过 idle_timeout_ms (0 为默认) 没有收到数据则失败。
+// 对端后端必须与本节点配置的后端相同。同一时刻只能有一个拉取
+xsan_error_t xsan_metadata_snapshot_fetch(const char *peer_ip, uint16_t peer_port, const char *dest_dir,
+                                          uint32_t chunk_bytes, uint32_t idle_timeout_ms,
+                                          xsan_metadata_snapshot_done_cb_t cb, void *cb_arg);
+// 取消进行中的拉取 (cb 以 XSAN_ERROR_INTERRUPTED 回调); 没有拉取时什么也不做
+void xsan_metadata_snapshot_fetch_abort(void);
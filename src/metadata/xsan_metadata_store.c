@@ -1,10 +1,141 @@
 #include "xsan_metadata_store.h"
+#include "xsan_metadata_backend.h"
 #include "xsan_memory.h" // For XSAN_MALLOC, XSAN_FREE, xsan_strdup
 #include "../../include/xsan_error.h"
 #include "xsan_log.h"
 
-#include "rocksdb/c.h"   // RocksDB C API
 #include <string.h>      // For memcpy, strlen
+#include <pthread.h>     // For the node store
+#include <stdio.h>       // For snprintf, rename
+#include <unistd.h>      // For access
+#include <fcntl.h>       // For open (directory fsync)
+
+#define XSAN_METADATA_KEY_PREFIX_DELIM ':' // Every XSAN key starts with a "<type>:" prefix ("v:", "volalloc:", ...)
+#define XSAN_METADATA_MIGRATED_MARKER_PREFIX "migrated:" // DEFAULT column family, one per legacy DB
+
+// Indexed by xsan_metadata_cf_id_t
+const char *const xsan_metadata_cf_names[XSAN_METADATA_CF_COUNT] = {
+    "default", "disks", "groups", "volumes", "volume_alloc", "bitmaps",
+};
+
+// Column family of each record type, by key-type prefix (including the delimiter)
+static const struct {
+    const char *prefix;
+    xsan_metadata_cf_id_t cf_id;
+} g_xsan_metadata_cf_routes[] = {
+    { "d:", XSAN_METADATA_CF_DISKS },
+    { "g:", XSAN_METADATA_CF_GROUPS },
+    { "v:", XSAN_METADATA_CF_VOLUMES },
+    { "volalloc:", XSAN_METADATA_CF_VOLUME_ALLOC },
+    { "bm:", XSAN_METADATA_CF_BITMAPS },
+};
+
+// Per-manager databases used before the node store; migrated by the first xsan_metadata_store_node_acquire.
+static const char *const g_xsan_metadata_legacy_db_paths[] = {
+    "./xsan_meta_db/disk_manager",
+    "./xsan_meta_db/volume_manager",
+};
+
+static xsan_metadata_store_opts_t g_xsan_metadata_store_opts;
+static bool g_xsan_metadata_store_opts_set = false;
+
+static pthread_mutex_t g_xsan_metadata_node_lock = PTHREAD_MUTEX_INITIALIZER;
+static xsan_metadata_store_t *g_xsan_metadata_node_store = NULL;
+static uint32_t g_xsan_metadata_node_refs = 0;
+
+static const xsan_metadata_backend_ops_t *_xsan_metadata_backend_ops(xsan_metadata_backend_type_t type) {
+    switch (type) {
+        case XSAN_METADATA_BACKEND_ROCKSDB:
+            return &xsan_metadata_backend_rocksdb;
+        case XSAN_METADATA_BACKEND_MEMLOG:
+            return &xsan_metadata_backend_memlog;
+        default:
+            return NULL;
+    }
+}
+
+void xsan_metadata_store_opts_init(xsan_metadata_store_opts_t *opts) {
+    if (!opts) {
+        return;
+    }
+    memset(opts, 0, sizeof(*opts));
+    opts->backend = XSAN_METADATA_BACKEND_ROCKSDB;
+    opts->block_cache_bytes = XSAN_METADATA_DEFAULT_BLOCK_CACHE_BYTES;
+    opts->bloom_bits_per_key = XSAN_METADATA_DEFAULT_BLOOM_BITS_PER_KEY;
+    opts->whole_key_filtering = true;
+    opts->prefix_bloom = true;
+    opts->max_background_jobs = XSAN_METADATA_DEFAULT_BACKGROUND_JOBS;
+    opts->parallelism = 0;
+    opts->memtable_budget_bytes = 0;
+    opts->enable_statistics = false;
+    opts->stats_dump_period_sec = 0;
+    opts->memlog_compact_min_bytes = XSAN_METADATA_DEFAULT_MEMLOG_COMPACT_MIN_BYTES;
+    opts->memlog_compact_ratio = XSAN_METADATA_DEFAULT_MEMLOG_COMPACT_RATIO;
+    opts->memlog_sync = false;
+}
+
+xsan_error_t xsan_metadata_store_set_default_opts(const xsan_metadata_store_opts_t *opts) {
+    if (!opts || !_xsan_metadata_backend_ops(opts->backend) || opts->bloom_bits_per_key < 0 ||
+        opts->bloom_bits_per_key > 64 || opts->max_background_jobs < 0 || opts->parallelism < 0) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    g_xsan_metadata_store_opts = *opts;
+    g_xsan_metadata_store_opts_set = true;
+    if (opts->backend == XSAN_METADATA_BACKEND_MEMLOG) {
+        XSAN_LOG_INFO("Metadata store profile: memlog backend, compaction at %llu bytes / %ux live data, sync %s.",
+                      (unsigned long long)opts->memlog_compact_min_bytes, opts->memlog_compact_ratio,
+                      opts->memlog_sync ? "on" : "off");
+        return XSAN_OK;
+    }
+    XSAN_LOG_INFO("Metadata store profile: block cache %zu bytes, bloom %d bits/key (whole key %s, prefix %s), "
+                  "background jobs %d, parallelism %d, statistics %s.",
+                  opts->block_cache_bytes, opts->bloom_bits_per_key, opts->whole_key_filtering ? "on" : "off",
+                  opts->prefix_bloom ? "on" : "off", opts->max_background_jobs, opts->parallelism,
+                  opts->enable_statistics ? "on" : "off");
+    return XSAN_OK;
+}
+
+static xsan_metadata_cf_id_t _xsan_metadata_cf_for_key(const char *key, size_t key_len) {
+    const char *delim = memchr(key, XSAN_METADATA_KEY_PREFIX_DELIM, key_len);
+    if (!delim) {
+        return XSAN_METADATA_CF_DEFAULT;
+    }
+    size_t prefix_len = (size_t)(delim - key) + 1;
+    for (size_t i = 0; i < sizeof(g_xsan_metadata_cf_routes) / sizeof(g_xsan_metadata_cf_routes[0]); ++i) {
+        if (strlen(g_xsan_metadata_cf_routes[i].prefix) == prefix_len &&
+            memcmp(g_xsan_metadata_cf_routes[i].prefix, key, prefix_len) == 0) {
+            return g_xsan_metadata_cf_routes[i].cf_id;
+        }
+    }
+    return XSAN_METADATA_CF_DEFAULT;
+}
+
+static xsan_metadata_cf_t *_xsan_metadata_store_route(xsan_metadata_store_t *store, const char *key, size_t key_len) {
+    if (!store || !key) {
+        return NULL;
+    }
+    return &store->cfs[_xsan_metadata_cf_for_key(key, key_len)];
+}
+
+uint32_t xsan_metadata_key_order_hash(const char *key, size_t key_len) {
+    if (!key) {
+        return 0;
+    }
+    const char *colon = (const char *)memchr(key, ':', key_len);
+    if (colon) {
+        key_len -= (size_t)(colon + 1 - key);
+        key = colon + 1;
+    }
+    uint32_t h = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < key_len; ++i) {
+        h = (h ^ (unsigned char)key[i]) * 16777619u;
+    }
+    return h;
+}
+
+static inline bool _xsan_metadata_cf_usable(const xsan_metadata_cf_t *cf) {
+    return cf && cf->store && cf->store->backend && cf->backend_cf;
+}
 
 xsan_metadata_store_t *xsan_metadata_store_open(const char *db_path, bool create_if_missing) {
     if (!db_path) {
@@ -19,58 +150,31 @@ xsan_metadata_store_t *xsan_metadata_store_open(const char *db_path, bool create
     }
     memset(store, 0, sizeof(xsan_metadata_store_t));
 
-    store->db_options = rocksdb_options_create();
-    if (!store->db_options) {
-        XSAN_LOG_ERROR("Failed to create RocksDB options.");
-        XSAN_FREE(store);
-        return NULL;
+    if (!g_xsan_metadata_store_opts_set) {
+        xsan_metadata_store_opts_init(&g_xsan_metadata_store_opts);
+        g_xsan_metadata_store_opts_set = true;
     }
-    rocksdb_options_set_create_if_missing(store->db_options, create_if_missing ? 1 : 0);
-    // rocksdb_options_increase_parallelism(store->db_options, spdk_env_get_core_count()); // Example advanced option
-    // rocksdb_options_optimize_level_style_compaction(store->db_options, 0); // Example
-
-    store->write_options = rocksdb_writeoptions_create();
-    if (!store->write_options) {
-        XSAN_LOG_ERROR("Failed to create RocksDB write options.");
-        rocksdb_options_destroy(store->db_options);
-        XSAN_FREE(store);
-        return NULL;
+    store->ops = _xsan_metadata_backend_ops(g_xsan_metadata_store_opts.backend);
+    for (int i = 0; i < XSAN_METADATA_CF_COUNT; ++i) {
+        store->cfs[i].store = store;
+        store->cfs[i].id = (xsan_metadata_cf_id_t)i;
+        store->cfs[i].name = xsan_metadata_cf_names[i];
     }
-    // rocksdb_writeoptions_disable_WAL(store->write_options, 1); // Example: if WAL not desired for some use cases
-
-    store->read_options = rocksdb_readoptions_create();
-    if (!store->read_options) {
-        XSAN_LOG_ERROR("Failed to create RocksDB read options.");
-        rocksdb_writeoptions_destroy(store->write_options);
-        rocksdb_options_destroy(store->db_options);
+    store->db_path_copy = xsan_strdup(db_path); // Store a copy of the path for reference
+    if (!store->db_path_copy) {
         XSAN_FREE(store);
         return NULL;
     }
-    // rocksdb_readoptions_set_fill_cache(store->read_options, 0); // Example: Don't fill block cache for this read
-
-    char *err_ptr = NULL;
-    store->db_handle = rocksdb_open(store->db_options, db_path, &err_ptr);
 
-    if (err_ptr) {
-        XSAN_LOG_ERROR("Failed to open RocksDB database at '%s': %s", db_path, err_ptr);
-        rocksdb_free(err_ptr); // Important to free error string from RocksDB
-        rocksdb_readoptions_destroy(store->read_options);
-        rocksdb_writeoptions_destroy(store->write_options);
-        rocksdb_options_destroy(store->db_options);
-        XSAN_FREE(store);
-        return NULL;
-    }
-    if (!store->db_handle) { // Should be redundant if err_ptr is checked, but good practice
-        XSAN_LOG_ERROR("RocksDB open returned NULL handle without error string (path: %s).", db_path);
-        rocksdb_readoptions_destroy(store->read_options);
-        rocksdb_writeoptions_destroy(store->write_options);
-        rocksdb_options_destroy(store->db_options);
+    // The backend frees everything it allocated when open fails
+    xsan_error_t err = store->ops->open(store, db_path, create_if_missing, &g_xsan_metadata_store_opts);
+    if (err != XSAN_OK) {
+        XSAN_LOG_ERROR("Failed to open %s metadata store at '%s' (error %d).", store->ops->name, db_path, err);
+        XSAN_FREE(store->db_path_copy);
         XSAN_FREE(store);
         return NULL;
     }
-
-    store->db_path_copy = xsan_strdup(db_path); // Store a copy of the path for reference
-    XSAN_LOG_INFO("RocksDB metadata store opened successfully at '%s'.", db_path);
+    XSAN_LOG_INFO("Metadata store opened successfully at '%s' (%s backend).", db_path, store->ops->name);
     return store;
 }
 
@@ -78,167 +182,462 @@ void xsan_metadata_store_close(xsan_metadata_store_t *store) {
     if (!store) {
         return;
     }
-    XSAN_LOG_INFO("Closing RocksDB metadata store at '%s'.", store->db_path_copy ? store->db_path_copy : "unknown_path");
-    if (store->db_handle) {
-        rocksdb_close(store->db_handle);
-    }
-    if (store->read_options) {
-        rocksdb_readoptions_destroy(store->read_options);
-    }
-    if (store->write_options) {
-        rocksdb_writeoptions_destroy(store->write_options);
-    }
-    if (store->db_options) {
-        rocksdb_options_destroy(store->db_options);
+    const char *path = store->db_path_copy ? store->db_path_copy : "unknown_path";
+    XSAN_LOG_INFO("Closing metadata store at '%s' (%s backend).", path, store->ops->name);
+    char *stats = xsan_metadata_store_get_statistics(store);
+    if (stats) {
+        XSAN_LOG_DEBUG("Metadata store statistics for '%s':\n%s", path, stats);
+        XSAN_FREE(stats);
     }
+    store->ops->close(store);
     if (store->db_path_copy) {
         XSAN_FREE(store->db_path_copy);
     }
     XSAN_FREE(store);
 }
 
-xsan_error_t xsan_metadata_store_put(xsan_metadata_store_t *store,
-                                     const char *key, size_t key_len,
-                                     const char *value, size_t value_len) {
-    if (!store || !store->db_handle || !key || key_len == 0 || !value) { // value_len can be 0 for empty value
-        return XSAN_ERROR_INVALID_PARAM;
-    }
-    char *err_ptr = NULL;
-    rocksdb_put(store->db_handle, store->write_options, key, key_len, value, value_len, &err_ptr);
-    if (err_ptr) {
-        XSAN_LOG_ERROR("RocksDB put failed for key '%.*s': %s", (int)key_len, key, err_ptr);
-        rocksdb_free(err_ptr);
-        return XSAN_ERROR_IO; // Or a more specific metadata store error
+char *xsan_metadata_store_get_statistics(xsan_metadata_store_t *store) {
+    if (!store || !store->backend || !store->ops->get_statistics) {
+        return NULL;
     }
-    return XSAN_OK;
+    return store->ops->get_statistics(store);
 }
 
-xsan_error_t xsan_metadata_store_get(xsan_metadata_store_t *store,
-                                     const char *key, size_t key_len,
-                                     char **value_out, size_t *value_len_out) {
-    if (!store || !store->db_handle || !key || key_len == 0 || !value_out || !value_len_out) {
+const char *xsan_metadata_store_backend_name(const xsan_metadata_store_t *store) {
+    return (store && store->ops) ? store->ops->name : "none";
+}
+
+const char *xsan_metadata_store_default_backend_name(void) {
+    const xsan_metadata_backend_ops_t *ops = _xsan_metadata_backend_ops(g_xsan_metadata_store_opts.backend);
+    return ops ? ops->name : "none";
+}
+
+xsan_error_t xsan_metadata_store_checkpoint(xsan_metadata_store_t *store, const char *dir) {
+    if (!store || !store->backend || !dir) {
         return XSAN_ERROR_INVALID_PARAM;
     }
-    char *err_ptr = NULL;
-    *value_out = rocksdb_get(store->db_handle, store->read_options, key, key_len, value_len_out, &err_ptr);
-
-    if (err_ptr) {
-        XSAN_LOG_ERROR("RocksDB get failed for key '%.*s': %s", (int)key_len, key, err_ptr);
-        rocksdb_free(err_ptr);
-        if (*value_out) { // Should not happen if err_ptr is set, but defensive
-            rocksdb_free(*value_out);
-            *value_out = NULL;
-        }
-        *value_len_out = 0;
-        return XSAN_ERROR_IO;
+    if (access(dir, F_OK) == 0) {
+        XSAN_LOG_ERROR("Metadata checkpoint directory '%s' already exists.", dir);
+        return XSAN_ERROR_ALREADY_EXISTS;
     }
-
-    if (*value_out == NULL) { // Key not found
-        *value_len_out = 0;
-        return XSAN_ERROR_NOT_FOUND;
+    xsan_error_t err = store->ops->checkpoint(store, dir);
+    if (err == XSAN_OK) {
+        XSAN_LOG_INFO("Metadata store '%s' checkpointed to '%s'.", store->db_path_copy, dir);
     }
+    return err;
+}
 
-    // RocksDB's value from rocksdb_get needs to be freed by rocksdb_free.
-    // Our API contract says caller frees with XSAN_FREE. So we must copy.
-    char *copied_value = (char *)XSAN_MALLOC(*value_len_out + 1); // +1 for null terminator if string
-    if (!copied_value) {
-        rocksdb_free(*value_out); // Free the rocksdb allocated buffer
-        *value_out = NULL;
-        *value_len_out = 0;
-        return XSAN_ERROR_NO_MEMORY;
+xsan_metadata_cf_t *xsan_metadata_store_get_cf(xsan_metadata_store_t *store, xsan_metadata_cf_id_t cf_id) {
+    if (!store || (int)cf_id < 0 || cf_id >= XSAN_METADATA_CF_COUNT || !_xsan_metadata_cf_usable(&store->cfs[cf_id])) {
+        return NULL;
     }
-    memcpy(copied_value, *value_out, *value_len_out);
-    copied_value[*value_len_out] = '\0'; // Ensure null termination if it's a string
+    return &store->cfs[cf_id];
+}
 
-    rocksdb_free(*value_out); // Free original RocksDB buffer
-    *value_out = copied_value; // Return the copy
+xsan_error_t xsan_metadata_store_put(xsan_metadata_store_t *store,
+                                     const char *key, size_t key_len,
+                                     const char *value, size_t value_len) {
+    return xsan_metadata_cf_put(_xsan_metadata_store_route(store, key, key_len), key, key_len, value, value_len);
+}
 
-    return XSAN_OK;
+xsan_error_t xsan_metadata_store_get(xsan_metadata_store_t *store,
+                                     const char *key, size_t key_len,
+                                     char **value_out, size_t *value_len_out) {
+    return xsan_metadata_cf_get(_xsan_metadata_store_route(store, key, key_len), key, key_len, value_out, value_len_out);
 }
 
 xsan_error_t xsan_metadata_store_delete(xsan_metadata_store_t *store,
                                         const char *key, size_t key_len) {
-    if (!store || !store->db_handle || !key || key_len == 0) {
+    return xsan_metadata_cf_delete(_xsan_metadata_store_route(store, key, key_len), key, key_len);
+}
+
+xsan_error_t xsan_metadata_cf_put(xsan_metadata_cf_t *cf, const char *key, size_t key_len,
+                                  const char *value, size_t value_len) {
+    if (!_xsan_metadata_cf_usable(cf) || !key || key_len == 0 || !value) { // value_len can be 0 for empty value
         return XSAN_ERROR_INVALID_PARAM;
     }
-    char *err_ptr = NULL;
-    rocksdb_delete(store->db_handle, store->write_options, key, key_len, &err_ptr);
-    if (err_ptr) {
-        XSAN_LOG_ERROR("RocksDB delete failed for key '%.*s': %s", (int)key_len, key, err_ptr);
-        rocksdb_free(err_ptr);
-        return XSAN_ERROR_IO;
+    return cf->store->ops->put(cf, key, key_len, value, value_len);
+}
+
+xsan_error_t xsan_metadata_cf_get(xsan_metadata_cf_t *cf, const char *key, size_t key_len,
+                                  char **value_out, size_t *value_len_out) {
+    if (!_xsan_metadata_cf_usable(cf) || !key || key_len == 0 || !value_out || !value_len_out) {
+        return XSAN_ERROR_INVALID_PARAM;
     }
-    return XSAN_OK;
+    return cf->store->ops->get(cf, key, key_len, value_out, value_len_out);
+}
+
+xsan_error_t xsan_metadata_cf_delete(xsan_metadata_cf_t *cf, const char *key, size_t key_len) {
+    if (!_xsan_metadata_cf_usable(cf) || !key || key_len == 0) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    return cf->store->ops->del(cf, key, key_len);
 }
 
 // --- Iterator Functions ---
 
-xsan_metadata_iterator_t *xsan_metadata_iterator_create(xsan_metadata_store_t *store) {
-    if (!store || !store->db_handle) {
-        return NULL;
-    }
+static xsan_metadata_iterator_t *_xsan_metadata_iterator_wrap(xsan_metadata_cf_t *cf, const char *prefix,
+                                                              size_t prefix_len) {
     xsan_metadata_iterator_t *iter = (xsan_metadata_iterator_t *)XSAN_MALLOC(sizeof(xsan_metadata_iterator_t));
     if (!iter) {
         XSAN_LOG_ERROR("Failed to allocate memory for xsan_metadata_iterator_t.");
         return NULL;
     }
-    // Use the store's default read options for the iterator
-    iter->rocksdb_iter_handle = rocksdb_create_iterator(store->db_handle, store->read_options);
-    if (!iter->rocksdb_iter_handle) {
-        XSAN_LOG_ERROR("Failed to create RocksDB iterator.");
+    iter->store = cf->store;
+    iter->backend_iter = cf->store->ops->iter_create(cf, prefix, prefix_len);
+    if (!iter->backend_iter) {
+        XSAN_LOG_ERROR("Failed to create %s iterator on cf %s.", cf->store->ops->name, cf->name);
         XSAN_FREE(iter);
         return NULL;
     }
     return iter;
 }
 
+xsan_metadata_iterator_t *xsan_metadata_iterator_create(xsan_metadata_store_t *store) {
+    return store ? xsan_metadata_cf_iterator_create(&store->cfs[XSAN_METADATA_CF_DEFAULT]) : NULL;
+}
+
+xsan_metadata_iterator_t *xsan_metadata_iterator_create_prefix(xsan_metadata_store_t *store,
+                                                                const char *prefix, size_t prefix_len) {
+    return xsan_metadata_cf_iterator_create_prefix(_xsan_metadata_store_route(store, prefix, prefix_len), prefix, prefix_len);
+}
+
+xsan_metadata_iterator_t *xsan_metadata_cf_iterator_create(xsan_metadata_cf_t *cf) {
+    if (!_xsan_metadata_cf_usable(cf)) {
+        return NULL;
+    }
+    return _xsan_metadata_iterator_wrap(cf, NULL, 0);
+}
+
+xsan_metadata_iterator_t *xsan_metadata_cf_iterator_create_prefix(xsan_metadata_cf_t *cf,
+                                                                   const char *prefix, size_t prefix_len) {
+    if (!_xsan_metadata_cf_usable(cf) || !prefix || prefix_len == 0) {
+        return NULL;
+    }
+    return _xsan_metadata_iterator_wrap(cf, prefix, prefix_len);
+}
+
 void xsan_metadata_iterator_destroy(xsan_metadata_iterator_t *iter) {
     if (!iter) {
         return;
     }
-    if (iter->rocksdb_iter_handle) {
-        rocksdb_iter_destroy(iter->rocksdb_iter_handle);
+    if (iter->backend_iter) {
+        iter->store->ops->iter_destroy(iter->backend_iter);
     }
     XSAN_FREE(iter);
 }
 
 void xsan_metadata_iterator_seek_to_first(xsan_metadata_iterator_t *iter) {
-    if (iter && iter->rocksdb_iter_handle) {
-        rocksdb_iter_seek_to_first(iter->rocksdb_iter_handle);
+    if (iter && iter->backend_iter) {
+        iter->store->ops->iter_seek_to_first(iter->backend_iter);
     }
 }
 
 void xsan_metadata_iterator_seek(xsan_metadata_iterator_t *iter, const char *seek_key, size_t seek_key_len) {
-    if (iter && iter->rocksdb_iter_handle && seek_key) {
-        rocksdb_iter_seek(iter->rocksdb_iter_handle, seek_key, seek_key_len);
+    if (iter && iter->backend_iter && seek_key) {
+        iter->store->ops->iter_seek(iter->backend_iter, seek_key, seek_key_len);
     }
 }
 
 void xsan_metadata_iterator_next(xsan_metadata_iterator_t *iter) {
-    if (iter && iter->rocksdb_iter_handle && rocksdb_iter_valid(iter->rocksdb_iter_handle)) {
-        rocksdb_iter_next(iter->rocksdb_iter_handle);
+    if (iter && iter->backend_iter && iter->store->ops->iter_valid(iter->backend_iter)) {
+        iter->store->ops->iter_next(iter->backend_iter);
     }
 }
 
 bool xsan_metadata_iterator_is_valid(xsan_metadata_iterator_t *iter) {
-    if (iter && iter->rocksdb_iter_handle) {
-        return rocksdb_iter_valid(iter->rocksdb_iter_handle);
+    if (iter && iter->backend_iter) {
+        return iter->store->ops->iter_valid(iter->backend_iter);
     }
     return false;
 }
 
 const char *xsan_metadata_iterator_key(xsan_metadata_iterator_t *iter, size_t *key_len_out) {
-    if (iter && iter->rocksdb_iter_handle && rocksdb_iter_valid(iter->rocksdb_iter_handle)) {
-        return rocksdb_iter_key(iter->rocksdb_iter_handle, key_len_out);
+    if (iter && iter->backend_iter && iter->store->ops->iter_valid(iter->backend_iter)) {
+        return iter->store->ops->iter_key(iter->backend_iter, key_len_out);
     }
     if (key_len_out) *key_len_out = 0;
     return NULL;
 }
 
 const char *xsan_metadata_iterator_value(xsan_metadata_iterator_t *iter, size_t *value_len_out) {
-    if (iter && iter->rocksdb_iter_handle && rocksdb_iter_valid(iter->rocksdb_iter_handle)) {
-        return rocksdb_iter_value(iter->rocksdb_iter_handle, value_len_out);
+    if (iter && iter->backend_iter && iter->store->ops->iter_valid(iter->backend_iter)) {
+        return iter->store->ops->iter_value(iter->backend_iter, value_len_out);
     }
     if (value_len_out) *value_len_out = 0;
     return NULL;
 }
+
+// --- Write Batch Functions ---
+
+xsan_metadata_batch_t *xsan_metadata_store_batch_create(xsan_metadata_store_t *store) {
+    if (!store || !store->backend) {
+        return NULL;
+    }
+    xsan_metadata_batch_t *batch = (xsan_metadata_batch_t *)XSAN_MALLOC(sizeof(xsan_metadata_batch_t));
+    if (!batch) {
+        XSAN_LOG_ERROR("Failed to allocate memory for xsan_metadata_batch_t.");
+        return NULL;
+    }
+    batch->backend_batch = store->ops->batch_create(store);
+    if (!batch->backend_batch) {
+        XSAN_LOG_ERROR("Failed to create %s write batch.", store->ops->name);
+        XSAN_FREE(batch);
+        return NULL;
+    }
+    batch->store = store;
+    batch->order_hash = 0;
+    batch->has_order_hash = false;
+    batch->multi_record = false;
+    return batch;
+}
+
+void xsan_metadata_store_batch_destroy(xsan_metadata_batch_t *batch) {
+    if (!batch) {
+        return;
+    }
+    if (batch->backend_batch) {
+        batch->store->ops->batch_destroy(batch->backend_batch);
+    }
+    XSAN_FREE(batch);
+}
+
+xsan_error_t xsan_metadata_store_batch_put(xsan_metadata_batch_t *batch,
+                                           const char *key, size_t key_len,
+                                           const char *value, size_t value_len) {
+    if (!batch) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    return xsan_metadata_store_batch_put_cf(batch, _xsan_metadata_store_route(batch->store, key, key_len),
+                                            key, key_len, value, value_len);
+}
+
+xsan_error_t xsan_metadata_store_batch_delete(xsan_metadata_batch_t *batch,
+                                              const char *key, size_t key_len) {
+    if (!batch) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    return xsan_metadata_store_batch_delete_cf(batch, _xsan_metadata_store_route(batch->store, key, key_len), key, key_len);
+}
+
+// A batch on one record is committed asynchronously by that record's metadata worker; one that
+// spans records is committed as a barrier across all of them (see xsan_metadata_async.c).
+static void _xsan_metadata_batch_note_key(xsan_metadata_batch_t *batch, const char *key, size_t key_len) {
+    uint32_t h = xsan_metadata_key_order_hash(key, key_len);
+    if (!batch->has_order_hash) {
+        batch->order_hash = h;
+        batch->has_order_hash = true;
+    } else if (h != batch->order_hash) {
+        batch->multi_record = true;
+    }
+}
+
+xsan_error_t xsan_metadata_store_batch_put_cf(xsan_metadata_batch_t *batch, xsan_metadata_cf_t *cf,
+                                              const char *key, size_t key_len,
+                                              const char *value, size_t value_len) {
+    if (!batch || !batch->backend_batch || !cf || cf->store != batch->store || !key || key_len == 0 || !value) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    _xsan_metadata_batch_note_key(batch, key, key_len);
+    return batch->store->ops->batch_put(batch->backend_batch, cf, key, key_len, value, value_len);
+}
+
+xsan_error_t xsan_metadata_store_batch_delete_cf(xsan_metadata_batch_t *batch, xsan_metadata_cf_t *cf,
+                                                 const char *key, size_t key_len) {
+    if (!batch || !batch->backend_batch || !cf || cf->store != batch->store || !key || key_len == 0) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    _xsan_metadata_batch_note_key(batch, key, key_len);
+    return batch->store->ops->batch_delete(batch->backend_batch, cf, key, key_len);
+}
+
+size_t xsan_metadata_store_batch_count(const xsan_metadata_batch_t *batch) {
+    if (!batch || !batch->backend_batch) {
+        return 0;
+    }
+    return batch->store->ops->batch_count(batch->backend_batch);
+}
+
+void xsan_metadata_store_batch_clear(xsan_metadata_batch_t *batch) {
+    if (batch && batch->backend_batch) {
+        batch->store->ops->batch_clear(batch->backend_batch);
+        batch->has_order_hash = false;
+        batch->multi_record = false;
+    }
+}
+
+xsan_error_t xsan_metadata_store_batch_commit(xsan_metadata_store_t *store, xsan_metadata_batch_t *batch) {
+    if (!store || !store->backend || !batch || !batch->backend_batch || batch->store != store) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    if (store->ops->batch_count(batch->backend_batch) == 0) {
+        return XSAN_OK;
+    }
+    return store->ops->batch_commit(store, batch->backend_batch);
+}
+
+// --- Node store ---
+
+static xsan_error_t _xsan_metadata_migrate_record(void *cb_arg, const char *key, size_t key_len,
+                                                  const char *value, size_t value_len) {
+    return xsan_metadata_store_batch_put((xsan_metadata_batch_t *)cb_arg, key, key_len, value, value_len);
+}
+
+// Copies every record of a pre-column-family database into store (each into the column family of its
+// key type) with one batch, then renames the old directory. A marker committed with the records keeps
+// a migration that could not rename the directory from being replayed over newer data.
+// Legacy databases are always RocksDB, whichever backend the node store uses.
+static xsan_error_t _xsan_metadata_migrate_legacy_db(xsan_metadata_store_t *store, const char *legacy_path) {
+    char path_buf[XSAN_METADATA_PATH_BUF_LEN];
+    snprintf(path_buf, sizeof(path_buf), "%s/CURRENT", legacy_path);
+    if (access(path_buf, F_OK) != 0) {
+        return XSAN_OK; // Nothing to migrate
+    }
+    char marker_key[XSAN_METADATA_PATH_BUF_LEN];
+    snprintf(marker_key, sizeof(marker_key), "%s%s", XSAN_METADATA_MIGRATED_MARKER_PREFIX, legacy_path);
+    char migrated_path[XSAN_METADATA_PATH_BUF_LEN];
+    snprintf(migrated_path, sizeof(migrated_path), "%s.migrated", legacy_path);
+
+    char *marker = NULL;
+    size_t marker_len = 0;
+    xsan_error_t err = xsan_metadata_cf_get(&store->cfs[XSAN_METADATA_CF_DEFAULT], marker_key, strlen(marker_key),
+                                            &marker, &marker_len);
+    if (err == XSAN_OK) {
+        XSAN_FREE(marker);
+        XSAN_LOG_WARN("Legacy metadata DB '%s' was already migrated; moving it aside again.", legacy_path);
+        if (rename(legacy_path, migrated_path) != 0) {
+            XSAN_LOG_WARN("Failed to rename '%s' to '%s'.", legacy_path, migrated_path);
+        }
+        return XSAN_OK;
+    }
+    if (err != XSAN_ERROR_NOT_FOUND) {
+        return err;
+    }
+
+    xsan_metadata_batch_t *batch = xsan_metadata_store_batch_create(store);
+    if (!batch) {
+        return XSAN_ERROR_NO_MEMORY;
+    }
+    size_t migrated = 0;
+    err = xsan_metadata_rocksdb_scan_legacy(legacy_path, _xsan_metadata_migrate_record, batch, &migrated);
+    if (err == XSAN_OK) {
+        err = xsan_metadata_store_batch_put_cf(batch, &store->cfs[XSAN_METADATA_CF_DEFAULT], marker_key, strlen(marker_key), "1", 1);
+    }
+    if (err == XSAN_OK) {
+        err = xsan_metadata_store_batch_commit(store, batch);
+    }
+    xsan_metadata_store_batch_destroy(batch);
+    if (err != XSAN_OK) {
+        XSAN_LOG_ERROR("Failed to migrate legacy metadata DB '%s' (error %d).", legacy_path, err);
+        return err;
+    }
+    XSAN_LOG_INFO("Migrated %zu record(s) from legacy metadata DB '%s' into '%s'.", migrated, legacy_path,
+                  store->db_path_copy ? store->db_path_copy : XSAN_METADATA_NODE_DB_PATH);
+    if (rename(legacy_path, migrated_path) != 0) {
+        XSAN_LOG_WARN("Failed to rename migrated DB '%s' to '%s'; it will be ignored.", legacy_path, migrated_path);
+    }
+    return XSAN_OK;
+}
+
+xsan_metadata_store_t *xsan_metadata_store_node_acquire(void) {
+    pthread_mutex_lock(&g_xsan_metadata_node_lock);
+    if (g_xsan_metadata_node_store) {
+        g_xsan_metadata_node_refs++;
+        xsan_metadata_store_t *store = g_xsan_metadata_node_store;
+        pthread_mutex_unlock(&g_xsan_metadata_node_lock);
+        return store;
+    }
+    xsan_metadata_store_t *store = xsan_metadata_store_open(XSAN_METADATA_NODE_DB_PATH, true);
+    if (store) {
+        for (size_t i = 0; i < sizeof(g_xsan_metadata_legacy_db_paths) / sizeof(g_xsan_metadata_legacy_db_paths[0]); ++i) {
+            if (_xsan_metadata_migrate_legacy_db(store, g_xsan_metadata_legacy_db_paths[i]) != XSAN_OK) {
+                // Starting without the old records would look like an empty node.
+                xsan_metadata_store_close(store);
+                store = NULL;
+                break;
+            }
+        }
+    }
+    if (store) {
+        g_xsan_metadata_node_store = store;
+        g_xsan_metadata_node_refs = 1;
+    }
+    pthread_mutex_unlock(&g_xsan_metadata_node_lock);
+    return store;
+}
+
+bool xsan_metadata_store_node_exists(void) {
+    return access(XSAN_METADATA_NODE_DB_PATH, F_OK) == 0;
+}
+
+static void _xsan_metadata_fsync_parent_dir(const char *path) {
+    char dir[XSAN_METADATA_PATH_BUF_LEN];
+    snprintf(dir, sizeof(dir), "%s", path);
+    char *slash = strrchr(dir, '/');
+    if (!slash) {
+        snprintf(dir, sizeof(dir), ".");
+    } else if (slash == dir) {
+        dir[1] = '\0';
+    } else {
+        *slash = '\0';
+    }
+    int dfd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (dfd >= 0) {
+        (void)fsync(dfd);
+        close(dfd);
+    }
+}
+
+// The snapshot directory becomes the node database by rename, so nothing is replayed or copied:
+// RocksDB opens the checkpoint's SST files as they are, memlog replays its already compacted log.
+xsan_error_t xsan_metadata_store_node_install(const char *snapshot_dir) {
+    if (!snapshot_dir || access(snapshot_dir, F_OK) != 0) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    pthread_mutex_lock(&g_xsan_metadata_node_lock);
+    if (g_xsan_metadata_node_store) {
+        pthread_mutex_unlock(&g_xsan_metadata_node_lock);
+        XSAN_LOG_ERROR("Cannot install metadata snapshot '%s': the node store is open.", snapshot_dir);
+        return XSAN_ERROR_BUSY;
+    }
+    char replaced_path[XSAN_METADATA_PATH_BUF_LEN];
+    snprintf(replaced_path, sizeof(replaced_path), "%s.replaced", XSAN_METADATA_NODE_DB_PATH);
+    if (access(XSAN_METADATA_NODE_DB_PATH, F_OK) == 0) {
+        if (access(replaced_path, F_OK) == 0) {
+            pthread_mutex_unlock(&g_xsan_metadata_node_lock);
+            XSAN_LOG_ERROR("Cannot install metadata snapshot '%s': '%s' is in the way; remove it first.",
+                           snapshot_dir, replaced_path);
+            return XSAN_ERROR_ALREADY_EXISTS;
+        }
+        if (rename(XSAN_METADATA_NODE_DB_PATH, replaced_path) != 0) {
+            pthread_mutex_unlock(&g_xsan_metadata_node_lock);
+            XSAN_LOG_ERROR("Failed to move node metadata DB aside to '%s'.", replaced_path);
+            return XSAN_ERROR_IO;
+        }
+        XSAN_LOG_WARN("Previous node metadata DB kept as '%s'.", replaced_path);
+    }
+    xsan_error_t err = XSAN_OK;
+    if (rename(snapshot_dir, XSAN_METADATA_NODE_DB_PATH) != 0) {
+        XSAN_LOG_ERROR("Failed to install metadata snapshot '%s' as '%s'.", snapshot_dir, XSAN_METADATA_NODE_DB_PATH);
+        err = XSAN_ERROR_IO;
+    } else {
+        _xsan_metadata_fsync_parent_dir(XSAN_METADATA_NODE_DB_PATH);
+        XSAN_LOG_INFO("Installed metadata snapshot '%s' as the node metadata DB.", snapshot_dir);
+    }
+    pthread_mutex_unlock(&g_xsan_metadata_node_lock);
+    return err;
+}
+
+void xsan_metadata_store_node_release(xsan_metadata_store_t *store) {
+    if (!store) {
+        return;
+    }
+    pthread_mutex_lock(&g_xsan_metadata_node_lock);
+    if (store != g_xsan_metadata_node_store) {
+        XSAN_LOG_WARN("Releasing a metadata store that is not the node store; ignored.");
+    } else if (--g_xsan_metadata_node_refs == 0) {
+        xsan_metadata_store_close(store);
+        g_xsan_metadata_node_store = NULL;
+    }
+    pthread_mutex_unlock(&g_xsan_metadata_node_lock);
+}
@@ -1,25 +1,216 @@
 // xsan_metadata_store.h
-// 空头文件，后续补充接口声明
+// 元数据存储接口。后端可选: RocksDB (默认) 或内存 + 追加日志 (memlog), 见 xsan_metadata_store_opts_t.backend
 #pragma once
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include "../../include/xsan_error.h"
+
+#define XSAN_METADATA_DEFAULT_BLOCK_CACHE_BYTES (64ULL * 1024 * 1024)
+#define XSAN_METADATA_DEFAULT_BLOOM_BITS_PER_KEY 10
+#define XSAN_METADATA_DEFAULT_BACKGROUND_JOBS 4
+#define XSAN_METADATA_DEFAULT_MEMLOG_COMPACT_MIN_BYTES (4ULL * 1024 * 1024)
+#define XSAN_METADATA_DEFAULT_MEMLOG_COMPACT_RATIO 4
+
+// 节点唯一的元数据库 (磁盘/磁盘组/卷等记录各占一个列族)
+#define XSAN_METADATA_NODE_DB_PATH "./xsan_meta_db/node"
+
+// 列族: 每种记录类型一个。不带 _cf 的接口按键前缀 (截至第一个 ':') 自动选择列族,
+// 未登记的前缀落在 DEFAULT。
+typedef enum {
+    XSAN_METADATA_CF_DEFAULT = 0,   // "default": 未分类的键, 迁移标记等
+    XSAN_METADATA_CF_DISKS,         // "disks": "d:<disk_id>"
+    XSAN_METADATA_CF_GROUPS,        // "groups": "g:<group_id>"
+    XSAN_METADATA_CF_VOLUMES,       // "volumes": "v:<volume_id>"
+    XSAN_METADATA_CF_VOLUME_ALLOC,  // "volume_alloc": "volalloc:<volume_id>"
+    XSAN_METADATA_CF_BITMAPS,       // "bitmaps": "bm:..." (预留)
+    XSAN_METADATA_CF_COUNT
+} xsan_metadata_cf_id_t;
+
+typedef enum {
+    XSAN_METADATA_BACKEND_ROCKSDB = 0,
+    // 全部数据常驻内存 (哈希表点查 + 跳表有序遍历), 持久化为带校验的追加日志, 定期压缩。
+    // 启动快、无后台线程, 适合测试、e2e 与小型边缘节点; 数据量受内存限制
+    XSAN_METADATA_BACKEND_MEMLOG,
+} xsan_metadata_backend_type_t;
+
+// 元数据库参数 (进程内所有元数据库共用), 见 xsan_metadata_store_set_default_opts
+typedef struct xsan_metadata_store_opts_t {
+    xsan_metadata_backend_type_t backend;
+    // --- RocksDB ---
+    size_t block_cache_bytes;       // 所有库共享的 LRU 块缓存大小, 0 使用 RocksDB 默认 (每库独立)
+    int bloom_bits_per_key;         // 布隆过滤器每键位数, 0 关闭
+    bool whole_key_filtering;       // 整键布隆 (点查)
+    bool prefix_bloom;              // 按键类型前缀 ("v:", "volalloc:" 等, 截至第一个 ':') 提取前缀并建前缀布隆
+    int max_background_jobs;        // 后台 flush/compaction 线程数, 0 使用默认
+    int parallelism;                // rocksdb_options_increase_parallelism 的线程总数, 0 不调用
+    uint64_t memtable_budget_bytes; // optimize_level_style_compaction 的内存预算, 0 不调用
+    bool enable_statistics;         // 开启 RocksDB 统计 (有少量开销)
+    unsigned int stats_dump_period_sec; // 统计周期性写入 RocksDB LOG, 0 不写
+    // --- memlog ---
+    uint64_t memlog_compact_min_bytes; // 日志小于此值时不压缩
+    uint32_t memlog_compact_ratio;  // 日志超过有效数据的这个倍数时重写, 0 不压缩
+    bool memlog_sync;               // 每次提交后 fdatasync (默认关闭, 与 RocksDB 默认写选项一致)
+} xsan_metadata_store_opts_t;
+
+struct xsan_metadata_backend_ops_t;
+
+struct xsan_metadata_store_t;
+
+// 列族句柄, 由 xsan_metadata_store_get_cf 取得, 生命周期与 store 相同
+typedef struct xsan_metadata_cf_t {
+    void *backend_cf;
+    struct xsan_metadata_store_t *store;
+    xsan_metadata_cf_id_t id;
+    const char *name;
+} xsan_metadata_cf_t;
 
 // 元数据存储结构体
 typedef struct xsan_metadata_store_t {
-    void *db_handle;
-    void *db_options;
-    void *write_options;
-    void *read_options;
+    const struct xsan_metadata_backend_ops_t *ops;
+    void *backend;                  // 后端私有状态
     char *db_path_copy;
+    xsan_metadata_cf_t cfs[XSAN_METADATA_CF_COUNT];
 } xsan_metadata_store_t;
 
 // 元数据迭代器结构体
 typedef struct xsan_metadata_iterator_t {
-    void *rocksdb_iter_handle;
+    void *backend_iter;
     xsan_metadata_store_t *store;
 } xsan_metadata_iterator_t;
 
-// 接口声明（可根据实现补充）
+// 元数据写批次结构体: 多个 put/delete 在一次提交中原子生效 (一次 WAL/日志写入)
+typedef struct xsan_metadata_batch_t {
+    void *backend_batch;
+    xsan_metadata_store_t *store;   // 按键前缀选择列族用
+    uint32_t order_hash;            // 第一个键的 xsan_metadata_key_order_hash, 异步提交按它选择工作线程
+    bool has_order_hash;
+    bool multi_record;              // 含多条记录的键 (order_hash 不同), 异步提交时作为屏障执行
+} xsan_metadata_batch_t;
+
+// 接口声明
+void xsan_metadata_store_opts_init(xsan_metadata_store_opts_t *opts);
+// 设置之后打开的元数据库使用的调优参数; 未设置时使用 xsan_metadata_store_opts_init 的默认值
+xsan_error_t xsan_metadata_store_set_default_opts(const xsan_metadata_store_opts_t *opts);
+
+// 按当前参数选择后端, 打开 (并创建缺失的) 全部列族
 xsan_metadata_store_t *xsan_metadata_store_open(const char *db_path, bool create_if_missing);
 void xsan_metadata_store_close(xsan_metadata_store_t *store);
-// ... 其他接口 ...
+// 节点共享库 XSAN_METADATA_NODE_DB_PATH, 引用计数; 首次打开时把旧的 ./xsan_meta_db/disk_manager 与
+// ./xsan_meta_db/volume_manager 库中的记录迁移到对应列族 (原目录改名为 *.migrated)
+xsan_metadata_store_t *xsan_metadata_store_node_acquire(void);
+void xsan_metadata_store_node_release(xsan_metadata_store_t *store);
+// 节点库目录是否已存在 (新节点首次启动时为 false)
+bool xsan_metadata_store_node_exists(void);
+// 把快照目录 (xsan_metadata_store_checkpoint 或 xsan_metadata_snapshot_fetch 的产物) 改名为节点库,
+// 原节点库保留为 *.replaced。节点库已打开时返回 XSAN_ERROR_BUSY
+xsan_error_t xsan_metadata_store_node_install(const char *snapshot_dir);
+// 未知 id 返回 NULL
+xsan_metadata_cf_t *xsan_metadata_store_get_cf(xsan_metadata_store_t *store, xsan_metadata_cf_id_t cf_id);
+// 返回统计文本, 调用者用 XSAN_FREE 释放; RocksDB 未开启统计时返回 NULL
+char *xsan_metadata_store_get_statistics(xsan_metadata_store_t *store);
+// 后端名 ("rocksdb" / "memlog")
+const char *xsan_metadata_store_backend_name(const xsan_metadata_store_t *store);
+// 按当前参数新打开的库使用的后端名
+const char *xsan_metadata_store_default_backend_name(void);
+// 在 dir (不能已存在) 生成一致性快照, 可用相同后端直接打开。RocksDB 为 checkpoint (SST 硬链接),
+// memlog 为压缩后的日志
+xsan_error_t xsan_metadata_store_checkpoint(xsan_metadata_store_t *store, const char *dir);
+
+xsan_error_t xsan_metadata_store_put(xsan_metadata_store_t *store,
+                                     const char *key, size_t key_len,
+                                     const char *value, size_t value_len);
+// 成功时 *value_out 由调用者用 XSAN_FREE 释放; 键不存在返回 XSAN_ERROR_NOT_FOUND
+xsan_error_t xsan_metadata_store_get(xsan_metadata_store_t *store,
+                                     const char *key, size_t key_len,
+                                     char **value_out, size_t *value_len_out);
+xsan_error_t xsan_metadata_store_delete(xsan_metadata_store_t *store,
+                                        const char *key, size_t key_len);
+
+// --- 指定列族 ---
+xsan_error_t xsan_metadata_cf_put(xsan_metadata_cf_t *cf, const char *key, size_t key_len,
+                                  const char *value, size_t value_len);
+xsan_error_t xsan_metadata_cf_get(xsan_metadata_cf_t *cf, const char *key, size_t key_len,
+                                  char **value_out, size_t *value_len_out);
+xsan_error_t xsan_metadata_cf_delete(xsan_metadata_cf_t *cf, const char *key, size_t key_len);
+
+// --- 写批次 ---
+// 用法: create -> 若干 put/delete -> commit -> destroy。提交前对存储不可见;
+// commit 失败时批次中的修改全部不生效。提交后批次内容保留，可 clear 后复用。
+// 批次可以跨列族, 但只能提交到创建它的 store
+xsan_metadata_batch_t *xsan_metadata_store_batch_create(xsan_metadata_store_t *store);
+void xsan_metadata_store_batch_destroy(xsan_metadata_batch_t *batch);
+xsan_error_t xsan_metadata_store_batch_put(xsan_metadata_batch_t *batch,
+                                           const char *key, size_t key_len,
+                                           const char *value, size_t value_len);
+xsan_error_t xsan_metadata_store_batch_delete(xsan_metadata_batch_t *batch,
+                                              const char *key, size_t key_len);
+xsan_error_t xsan_metadata_store_batch_put_cf(xsan_metadata_batch_t *batch, xsan_metadata_cf_t *cf,
+                                              const char *key, size_t key_len,
+                                              const char *value, size_t value_len);
+xsan_error_t xsan_metadata_store_batch_delete_cf(xsan_metadata_batch_t *batch, xsan_metadata_cf_t *cf,
+                                                 const char *key, size_t key_len);
+size_t xsan_metadata_store_batch_count(const xsan_metadata_batch_t *batch);
+void xsan_metadata_store_batch_clear(xsan_metadata_batch_t *batch);
+xsan_error_t xsan_metadata_store_batch_commit(xsan_metadata_store_t *store, xsan_metadata_batch_t *batch);
+
+// --- 迭代器 ---
+// 遍历 DEFAULT 列族
+xsan_metadata_iterator_t *xsan_metadata_iterator_create(xsan_metadata_store_t *store);
+// 只遍历以 prefix 开头的键 (列族按前缀选择), 已定位到第一个这样的键; 可利用前缀布隆跳过无关 SST。
+// memlog 后端的迭代器在创建时复制所遍历的范围
+xsan_metadata_iterator_t *xsan_metadata_iterator_create_prefix(xsan_metadata_store_t *store,
+                                                                const char *prefix, size_t prefix_len);
+xsan_metadata_iterator_t *xsan_metadata_cf_iterator_create(xsan_metadata_cf_t *cf);
+xsan_metadata_iterator_t *xsan_metadata_cf_iterator_create_prefix(xsan_metadata_cf_t *cf,
+                                                                   const char *prefix, size_t prefix_len);
+void xsan_metadata_iterator_destroy(xsan_metadata_iterator_t *iter);
+void xsan_metadata_iterator_seek_to_first(xsan_metadata_iterator_t *iter);
+void xsan_metadata_iterator_seek(xsan_metadata_iterator_t *iter, const char *seek_key, size_t seek_key_len);
+void xsan_metadata_iterator_next(xsan_metadata_iterator_t *iter);
+bool xsan_metadata_iterator_is_valid(xsan_metadata_iterator_t *iter);
+const char *xsan_metadata_iterator_key(xsan_metadata_iterator_t *iter, size_t *key_len_out);
+const char *xsan_metadata_iterator_value(xsan_metadata_iterator_t *iter, size_t *value_len_out);
+
+// --- 异步接口 ---
+// 操作在元数据工作线程上执行, SPDK reactor 不会阻塞在 RocksDB 上。回调在提交操作的 SPDK 线程上
+// 执行 (经 spdk_thread_send_msg); 非 SPDK 线程提交时在工作线程上执行。工作线程未启动时操作同步执行,
+// 回调在函数返回前调用。
+// 操作按记录分配工作线程: 去掉列族前缀 (截至第一个 ':') 后键相同的操作 (如 "v:<id>" 与 "volalloc:<id>")
+// 在同一线程上按提交顺序执行, 不同记录的操作在各线程上并发执行。只涉及一条记录的批次按该记录分配; 涉及多条
+// 记录的批次是屏障: 在所有工作线程执行完之前提交的操作之后执行, 之后提交的操作都等它完成后才执行。前缀扫描
+// 按 prefix 分配, 与其他记录上未完成的写入没有先后保证。
+typedef struct xsan_metadata_kv_t {
+    char *key;
+    size_t key_len;
+    char *value;
+    size_t value_len;
+} xsan_metadata_kv_t;
+
+typedef void (*xsan_metadata_done_cb_t)(void *cb_arg, xsan_error_t status);
+// value 由回调负责用 XSAN_FREE 释放 (失败时为 NULL)
+typedef void (*xsan_metadata_get_cb_t)(void *cb_arg, xsan_error_t status, char *value, size_t value_len);
+// kvs 由回调负责用 xsan_metadata_kv_array_free 释放
+typedef void (*xsan_metadata_scan_cb_t)(void *cb_arg, xsan_error_t status, xsan_metadata_kv_t *kvs, size_t count);
+
+// 键所属记录的散列值 (忽略列族前缀), 异步操作按它选择工作线程
+uint32_t xsan_metadata_key_order_hash(const char *key, size_t key_len);
+// 启动 num_workers 个工作线程 (1..16); fini 先执行完队列中的操作再退出
+xsan_error_t xsan_metadata_async_init(uint32_t num_workers);
+void xsan_metadata_async_fini(void);
+
+// 返回 XSAN_OK 表示已提交, 之后回调一定会被调用一次; 出错时不调用回调。key/value 会被复制。
+xsan_error_t xsan_metadata_store_put_async(xsan_metadata_store_t *store, const char *key, size_t key_len,
+                                           const char *value, size_t value_len,
+                                           xsan_metadata_done_cb_t cb, void *cb_arg);
+xsan_error_t xsan_metadata_store_get_async(xsan_metadata_store_t *store, const char *key, size_t key_len,
+                                           xsan_metadata_get_cb_t cb, void *cb_arg);
+xsan_error_t xsan_metadata_store_delete_async(xsan_metadata_store_t *store, const char *key, size_t key_len,
+                                              xsan_metadata_done_cb_t cb, void *cb_arg);
+// 提交成功后批次归异步层所有 (执行后销毁)
+xsan_error_t xsan_metadata_store_batch_commit_async(xsan_metadata_store_t *store, xsan_metadata_batch_t *batch,
+                                                    xsan_metadata_done_cb_t cb, void *cb_arg);
+// 读取以 prefix 开头的全部键值
+xsan_error_t xsan_metadata_store_scan_prefix_async(xsan_metadata_store_t *store, const char *prefix, size_t prefix_len,
+                                                   xsan_metadata_scan_cb_t cb, void *cb_arg);
+void xsan_metadata_kv_array_free(xsan_metadata_kv_t *kvs, size_t count);
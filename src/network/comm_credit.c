@@ -0,0 +1,62 @@
+// 节点间流控信用计数
+#include "xsan_comm_credit.h"
+#include "../../include/xsan_error.h" // 统一错误码头文件
+#include "xsan_memory.h"
+
+xsan_comm_credit_acct_t *xsan_comm_credit_acct_create(void) {
+    xsan_comm_credit_acct_t *acct = (xsan_comm_credit_acct_t *)XSAN_CALLOC(1, sizeof(xsan_comm_credit_acct_t));
+    if (acct) acct->refs = 1;
+    return acct;
+}
+
+void xsan_comm_credit_acct_put(xsan_comm_credit_acct_t *acct) {
+    if (acct && __sync_sub_and_fetch(&acct->refs, 1) == 0) XSAN_FREE(acct);
+}
+
+void xsan_comm_credit_rx_charge(xsan_comm_credit_acct_t *acct, uint32_t payload_length,
+                                xsan_comm_rx_credit_t *credit) {
+    if (!credit) {
+        __sync_add_and_fetch(&acct->released_bytes, payload_length);
+        __sync_add_and_fetch(&acct->released_msgs, 1);
+        return;
+    }
+    __sync_add_and_fetch(&acct->refs, 1);
+    credit->acct = acct;
+    credit->bytes = payload_length;
+}
+
+void xsan_comm_credit_rx_release(xsan_comm_rx_credit_t *credit) {
+    xsan_comm_credit_acct_t *acct = credit->acct;
+    if (!acct) return;
+    credit->acct = NULL;
+    __sync_add_and_fetch(&acct->released_bytes, credit->bytes);
+    __sync_add_and_fetch(&acct->released_msgs, 1);
+    xsan_comm_credit_acct_put(acct);
+}
+
+bool xsan_comm_credit_rx_grant_due(const xsan_comm_credit_rx_t *rx, uint64_t *bytes_limit, uint64_t *msgs_limit) {
+    *bytes_limit = __sync_add_and_fetch(&rx->acct->released_bytes, 0) + rx->window_bytes;
+    *msgs_limit = __sync_add_and_fetch(&rx->acct->released_msgs, 0) + rx->window_msgs;
+    uint32_t bytes_step = rx->window_bytes / 4, msgs_step = rx->window_msgs / 4;
+    return *bytes_limit - rx->granted_bytes >= (bytes_step ? bytes_step : 1) ||
+           *msgs_limit - rx->granted_msgs >= (msgs_step ? msgs_step : 1);
+}
+
+void xsan_comm_credit_rx_granted(xsan_comm_credit_rx_t *rx, uint64_t bytes_limit, uint64_t msgs_limit) {
+    rx->granted_bytes = bytes_limit;
+    rx->granted_msgs = msgs_limit;
+}
+
+bool xsan_comm_credit_tx_covers(const xsan_comm_credit_tx_t *tx, uint32_t len) {
+    return tx->bytes + len <= tx->bytes_limit && tx->msgs + 1 <= tx->msgs_limit;
+}
+
+void xsan_comm_credit_tx_consume(xsan_comm_credit_tx_t *tx, uint32_t len) {
+    tx->bytes += len;
+    tx->msgs++;
+}
+
+void xsan_comm_credit_tx_apply_grant(xsan_comm_credit_tx_t *tx, uint64_t bytes_limit, uint64_t msgs_limit) {
+    if (bytes_limit > tx->bytes_limit) tx->bytes_limit = bytes_limit;
+    if (msgs_limit > tx->msgs_limit) tx->msgs_limit = msgs_limit;
+}
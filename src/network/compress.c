@@ -0,0 +1,88 @@
+// 负载压缩 (LZ4)
+#include "xsan_compress.h"
+#include "../../include/xsan_error.h" // 统一错误码头文件
+#include <string.h>
+#include <stdlib.h>   // For qsort
+#include <limits.h>   // For INT_MAX
+
+#ifdef XSAN_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#define XSAN_COMPRESS_SAMPLE_CHUNK 32       // Bytes taken from each sampled position
+#define XSAN_COMPRESS_SAMPLE_CHUNKS 64      // Positions sampled across the data
+#define XSAN_COMPRESS_SMALL_BYTE_SET 64     // Using at most this many byte values: compressible
+#define XSAN_COMPRESS_LARGE_CORE_SET 200    // 90% of the sample spread over this many values: not
+
+bool xsan_compress_available(void) {
+#ifdef XSAN_HAVE_LZ4
+    return true;
+#else
+    return false;
+#endif
+}
+
+static int _compress_count_cmp_desc(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x < y) - (x > y);
+}
+
+bool xsan_compress_worth_trying(const void *data, size_t len) {
+    if (!data || len == 0) return false;
+    const unsigned char *p = (const unsigned char *)data;
+    uint32_t counts[256];
+    memset(counts, 0, sizeof(counts));
+
+    // Evenly spaced chunks rather than a prefix: block images often start with a header.
+    size_t stride = len / XSAN_COMPRESS_SAMPLE_CHUNKS;
+    if (stride < XSAN_COMPRESS_SAMPLE_CHUNK) stride = XSAN_COMPRESS_SAMPLE_CHUNK;
+    uint32_t sampled = 0;
+    for (size_t off = 0; off < len; off += stride) {
+        size_t n = len - off < XSAN_COMPRESS_SAMPLE_CHUNK ? len - off : XSAN_COMPRESS_SAMPLE_CHUNK;
+        for (size_t i = 0; i < n; ++i) counts[p[off + i]]++;
+        sampled += (uint32_t)n;
+    }
+
+    uint32_t byte_set = 0;
+    for (int i = 0; i < 256; ++i) byte_set += (counts[i] != 0);
+    if (byte_set <= XSAN_COMPRESS_SMALL_BYTE_SET) return true;
+
+    // Core set: the fewest byte values that make up 90% of the sample.
+    qsort(counts, 256, sizeof(counts[0]), _compress_count_cmp_desc);
+    uint32_t covered = 0, core_set = 0;
+    while (core_set < 256 && (uint64_t)covered * 10 < (uint64_t)sampled * 9) covered += counts[core_set++];
+    return core_set < XSAN_COMPRESS_LARGE_CORE_SET;
+}
+
+size_t xsan_compress_bound(size_t len) {
+#ifdef XSAN_HAVE_LZ4
+    if (len > (size_t)LZ4_MAX_INPUT_SIZE) return 0;
+    return (size_t)LZ4_compressBound((int)len);
+#else
+    (void)len;
+    return 0;
+#endif
+}
+
+size_t xsan_compress_lz4(const void *src, size_t len, void *dst, size_t dst_cap) {
+#ifdef XSAN_HAVE_LZ4
+    if (!src || !dst || len == 0 || len > (size_t)LZ4_MAX_INPUT_SIZE) return 0;
+    int cap = dst_cap > (size_t)INT_MAX ? INT_MAX : (int)dst_cap;
+    int n = LZ4_compress_default((const char *)src, (char *)dst, (int)len, cap);
+    return n > 0 ? (size_t)n : 0;
+#else
+    (void)src; (void)len; (void)dst; (void)dst_cap;
+    return 0;
+#endif
+}
+
+xsan_error_t xsan_decompress_lz4(const void *src, size_t len, void *dst, size_t dst_len) {
+#ifdef XSAN_HAVE_LZ4
+    if (!src || !dst || len == 0 || len > (size_t)INT_MAX || dst_len > (size_t)INT_MAX) return XSAN_ERROR_INVALID_PARAM;
+    int n = LZ4_decompress_safe((const char *)src, (char *)dst, (int)len, (int)dst_len);
+    return (n >= 0 && (size_t)n == dst_len) ? XSAN_OK : XSAN_ERROR_INVALID_PARAM;
+#else
+    (void)src; (void)len; (void)dst; (void)dst_len;
+    return XSAN_ERROR_UNSUPPORTED;
+#endif
+}
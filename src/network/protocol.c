@@ -7,6 +7,9 @@
 // For error codes and XSAN_ERROR_PROTOCOL_MAGIC_MISMATCH etc.
 #include <string.h>      // For memcpy, memset
 #include <arpa/inet.h>   // For htons, htonl, ntohs, ntohl
+#include <endian.h>      // For htole16/le16toh etc. (v2 headers are little-endian)
+
+#include "spdk/crc32.h"  // For spdk_crc32c_update
 
 // htonll and ntohll are not standard, so implement them manually if needed.
 // Most modern systems might have them (e.g. from glibc if _BSD_SOURCE or _GNU_SOURCE is defined)
@@ -37,7 +40,7 @@ void xsan_protocol_header_init(xsan_message_header_t *header,
     if (!header) return;
 
     header->magic = XSAN_PROTOCOL_MAGIC;
-    header->version = XSAN_PROTOCOL_VERSION;
+    header->version = XSAN_PROTOCOL_VERSION_1; // Updated by the receive path for v2 frames
     header->type = (uint16_t)type;
     header->payload_length = payload_length;
     header->transaction_id = transaction_id;
@@ -125,87 +128,108 @@ xsan_error_t xsan_protocol_header_deserialize(const unsigned char *buffer, xsan_
     return XSAN_OK;
 }
 
-// Placeholder checksum: simple XOR sum. Replace with robust algorithm (e.g. CRC32).
-uint32_t xsan_protocol_calculate_checksum(const unsigned char *data, size_t length) {
-    if (!data || length == 0) {
-        return 0;
-    }
-    uint32_t checksum = 0;
-    // A common simple checksum is Fletcher-16 or Fletcher-32, or just sum of bytes.
-    // For this placeholder, a simple XOR sum of all bytes.
-    // This is NOT cryptographically secure or very robust against errors.
-    for (size_t i = 0; i < length; ++i) {
-        // A slightly better approach than pure XOR for illustration:
-        checksum = (checksum + data[i]) & 0xFFFFFFFF; // Accumulate sum
-    }
-     // Could also incorporate length or a more complex mixing
-    // For instance, a simple Internet Checksum like algorithm part:
-    // uint32_t sum = 0;
-    // const uint16_t *p = (const uint16_t *)data;
-    // size_t nleft = length;
-    // while (nleft > 1) {
-    //     sum += *p++;
-    //     nleft -= 2;
-    // }
-    // if (nleft == 1) {
-    //     sum += *(const uint8_t *)p;
-    // }
-    // sum = (sum >> 16) + (sum & 0xffff);
-    // sum += (sum >> 16);
-    // checksum = ~sum & 0xffff; // For 16-bit checksum
-    // For a 32-bit placeholder, the simple sum is okay for now.
-    return checksum;
+// v2 headers are copied as packed structs; the conversions compile to nothing on little-endian hosts.
+void xsan_protocol_v2_frame_header_encode(const xsan_protocol_v2_frame_header_t *frame, unsigned char *buffer) {
+    xsan_protocol_v2_frame_header_t le;
+    le.magic = htole32(frame->magic);
+    le.num_msgs = htole16(frame->num_msgs);
+    le.flags = htole16(frame->flags);
+    le.frame_length = htole32(frame->frame_length);
+    le.checksum = htole32(frame->checksum);
+    memcpy(buffer, &le, sizeof(le));
 }
 
-bool xsan_protocol_verify_checksum(const xsan_message_header_t *header, const unsigned char *payload) {
-    if (!header) {
-        return false; // Invalid parameter
+xsan_error_t xsan_protocol_v2_frame_header_decode(const unsigned char *buffer, xsan_protocol_v2_frame_header_t *frame) {
+    if (!buffer || !frame) {
+        return XSAN_ERROR_INVALID_PARAM;
     }
-    // If checksum field in header is 0, assume checksum is not used/validated
-    if (header->checksum == 0) {
-        return true;
+    memcpy(frame, buffer, sizeof(*frame));
+    frame->magic = le32toh(frame->magic);
+    frame->num_msgs = le16toh(frame->num_msgs);
+    frame->flags = le16toh(frame->flags);
+    frame->frame_length = le32toh(frame->frame_length);
+    frame->checksum = le32toh(frame->checksum);
+
+    if (frame->magic != XSAN_PROTOCOL_V2_FRAME_MAGIC ||
+        frame->num_msgs == 0 || frame->num_msgs > XSAN_PROTOCOL_V2_MAX_FRAME_MSGS ||
+        frame->frame_length < (uint32_t)frame->num_msgs * XSAN_PROTOCOL_V2_MSG_HEADER_SIZE ||
+        frame->frame_length > XSAN_PROTOCOL_V2_MAX_FRAME_SIZE) {
+        return XSAN_ERROR_INVALID_PARAM;
     }
+    return XSAN_OK;
+}
 
-    // To verify, we calculate checksum over the header (with its checksum field temporarily zeroed)
-    // and the payload, then compare with the header's checksum field.
-    xsan_message_header_t temp_header_for_calc = *header;
-    temp_header_for_calc.checksum = 0; // Zero out checksum for calculation
+void xsan_protocol_v2_msg_header_encode(const xsan_message_header_t *header, uint16_t flags, unsigned char *buffer) {
+    xsan_protocol_v2_msg_header_t le;
+    le.type = htole16(header->type);
+    le.flags = htole16(flags);
+    le.payload_length = htole32(header->payload_length);
+    le.transaction_id = htole64(header->transaction_id);
+    memcpy(buffer, &le, sizeof(le));
+}
 
-    unsigned char serialized_header_for_calc[XSAN_MESSAGE_HEADER_SIZE];
-    if (xsan_protocol_header_serialize(&temp_header_for_calc, serialized_header_for_calc) != XSAN_OK) {
-        return false; // Should not happen if header is valid
+xsan_error_t xsan_protocol_v2_msg_header_decode(const unsigned char *buffer, xsan_message_header_t *header,
+                                                uint16_t *flags_out) {
+    if (!buffer || !header) {
+        return XSAN_ERROR_INVALID_PARAM;
     }
+    xsan_protocol_v2_msg_header_t le;
+    memcpy(&le, buffer, sizeof(le));
+    header->magic = XSAN_PROTOCOL_MAGIC;
+    header->type = le16toh(le.type);
+    header->version = XSAN_PROTOCOL_VERSION_2;
+    header->payload_length = le32toh(le.payload_length);
+    header->transaction_id = le64toh(le.transaction_id);
+    header->checksum = 0;
+    if (flags_out) *flags_out = le16toh(le.flags);
 
-    // The checksum should cover all header fields (magic to transaction_id) and the payload.
-    // The serialized_header_for_calc already has checksum field as 0.
-    // We calculate checksum on the part of serialized_header_for_calc *before* the checksum field.
-    uint32_t calculated_checksum;
-
-    // Simpler: calculate checksum over (header_fields_before_checksum + payload)
-    // This requires a temporary buffer to combine these parts if checksum func takes one buffer.
-    // Or, update checksum iteratively.
-    // For this placeholder, let's assume checksum is over (all header fields with checksum=0) + payload.
-    // This means the checksum field in the header should be the last field.
-
-    // Create a temporary buffer for the data to be checksummed
-    size_t data_to_checksum_len = XSAN_MESSAGE_HEADER_SIZE + header->payload_length;
-    unsigned char *checksum_data_buf = (unsigned char *)XSAN_MALLOC(data_to_checksum_len);
-    if (!checksum_data_buf) {
-        return false; // Out of memory
+    if (header->payload_length > XSAN_PROTOCOL_MAX_PAYLOAD_SIZE) {
+        return XSAN_ERROR_INVALID_PARAM;
     }
+    return XSAN_OK;
+}
 
-    // Copy serialized header (with checksum field as 0) into the buffer
-    memcpy(checksum_data_buf, serialized_header_for_calc, XSAN_MESSAGE_HEADER_SIZE);
+uint32_t xsan_protocol_crc32c_update(uint32_t crc, const void *data, size_t length) {
+    return (data && length > 0) ? spdk_crc32c_update(data, length, crc) : crc;
+}
 
-    // Copy payload (if any) after the header data
-    if (payload && header->payload_length > 0) {
-        memcpy(checksum_data_buf + XSAN_MESSAGE_HEADER_SIZE, payload, header->payload_length);
+uint32_t xsan_protocol_crc32c_final(uint32_t crc) {
+    crc ^= ~0u;
+    return crc != 0 ? crc : 0xFFFFFFFFu; // 0 in a header means "not checksummed"
+}
+
+uint32_t xsan_protocol_calculate_checksum(const unsigned char *data, size_t length) {
+    if (!data || length == 0) {
+        return 0; // CRC32C of the empty string
     }
+    return spdk_crc32c_update(data, length, ~0u) ^ ~0u;
+}
 
-    calculated_checksum = xsan_protocol_calculate_checksum(checksum_data_buf, data_to_checksum_len);
-    XSAN_FREE(checksum_data_buf);
+uint32_t xsan_protocol_message_checksum(const xsan_message_header_t *header, const unsigned char *payload) {
+    // Only the fixed-size header is serialized on the stack; the payload is checksummed in place.
+    xsan_message_header_t hdr_for_calc;
+    memcpy(&hdr_for_calc, header, sizeof(hdr_for_calc));
+    hdr_for_calc.checksum = 0;
+    unsigned char serialized_header[XSAN_MESSAGE_HEADER_SIZE];
+    xsan_protocol_header_serialize(&hdr_for_calc, serialized_header);
+
+    uint32_t crc = xsan_protocol_crc32c_update(XSAN_PROTOCOL_CRC32C_INIT, serialized_header, XSAN_MESSAGE_HEADER_SIZE);
+    crc = xsan_protocol_crc32c_update(crc, payload, header->payload_length);
+    return xsan_protocol_crc32c_final(crc);
+}
 
-    return calculated_checksum == header->checksum;
+bool xsan_protocol_verify_checksum(const xsan_message_header_t *header, const unsigned char *payload) {
+    if (!header) {
+        return false;
+    }
+    // If checksum field in header is 0, assume checksum is not used/validated
+    if (header->checksum == 0) {
+        return true;
+    }
+    if (header->payload_length > 0 && !payload) {
+        return false;
+    }
+    return xsan_protocol_message_checksum(header, payload) == header->checksum;
 }
 
 
@@ -225,6 +249,9 @@ xsan_message_t *xsan_protocol_message_create(xsan_message_type_t type,
     // 初始化header和payload
     xsan_protocol_header_init(&msg->header, type, payload_length, transaction_id);
     msg->payload = NULL;
+    msg->payload_free = NULL;
+    msg->payload_free_arg = NULL;
+    msg->payload_is_dma = false;
 
     if (payload_length > 0) {
         msg->payload = (unsigned char *)XSAN_MALLOC(payload_length);
@@ -240,42 +267,36 @@ xsan_message_t *xsan_protocol_message_create(xsan_message_type_t type,
         }
     }
 
-    // Calculate checksum
-    unsigned char serialized_header_for_calc[XSAN_MESSAGE_HEADER_SIZE];
-    if (xsan_protocol_header_serialize(&msg->header, serialized_header_for_calc) != XSAN_OK) {
-        if (msg->payload) XSAN_FREE(msg->payload);
-        XSAN_FREE(msg);
-        return NULL;
-    }
-
-    size_t data_to_checksum_len = XSAN_MESSAGE_HEADER_SIZE + msg->header.payload_length;
-    unsigned char *checksum_data_buf = (unsigned char *)XSAN_MALLOC(data_to_checksum_len);
-    if (!checksum_data_buf) {
-        if (msg->payload) XSAN_FREE(msg->payload);
-        XSAN_FREE(msg);
-        return NULL; // OOM for checksum calculation buffer
-    }
-
-    memcpy(checksum_data_buf, serialized_header_for_calc, XSAN_MESSAGE_HEADER_SIZE);
-    if (msg->payload && msg->header.payload_length > 0) {
-        memcpy(checksum_data_buf + XSAN_MESSAGE_HEADER_SIZE, msg->payload, msg->header.payload_length);
-    }
-
-    msg->header.checksum = xsan_protocol_calculate_checksum(checksum_data_buf, data_to_checksum_len);
-    XSAN_FREE(checksum_data_buf);
-
+    // The checksum stays 0 here; the sender fills it in per connection (see xsan_node_comm_send_msg).
     return msg;
 }
 
 void xsan_protocol_message_destroy(xsan_message_t *msg) {
     if (msg) {
         if (msg->payload) {
-            XSAN_FREE(msg->payload);
+            if (msg->payload_free) {
+                msg->payload_free(msg->payload, msg->payload_free_arg);
+            } else {
+                XSAN_FREE(msg->payload);
+            }
         }
         XSAN_FREE(msg);
     }
 }
 
+uint32_t xsan_protocol_payload_data_offset(xsan_message_type_t type) {
+    switch (type) {
+        case XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_REQ:
+            return (uint32_t)XSAN_REPLICA_WRITE_REQ_PAYLOAD_SIZE;
+        case XSAN_MSG_TYPE_REPLICA_CHAIN_WRITE_REQ:
+            return (uint32_t)sizeof(xsan_replica_chain_write_req_payload_t);
+        case XSAN_MSG_TYPE_REPLICA_READ_BLOCK_RESP:
+            return (uint32_t)XSAN_REPLICA_READ_RESP_PAYLOAD_SIZE;
+        default:
+            return 0;
+    }
+}
+
 xsan_message_t *xsan_protocol_message_create_with_data(
     xsan_message_type_t type,
     uint64_t transaction_id,
@@ -298,6 +319,9 @@ xsan_message_t *xsan_protocol_message_create_with_data(
 
     xsan_protocol_header_init(&msg->header, type, total_payload_length, transaction_id);
     msg->payload = NULL;
+    msg->payload_free = NULL;
+    msg->payload_free_arg = NULL;
+    msg->payload_is_dma = false;
 
     if (total_payload_length > 0) {
         msg->payload = (unsigned char *)XSAN_MALLOC(total_payload_length);
@@ -316,29 +340,6 @@ xsan_message_t *xsan_protocol_message_create_with_data(
         }
     }
 
-    // Calculate checksum
-    unsigned char serialized_header_for_calc[XSAN_MESSAGE_HEADER_SIZE];
-    if (xsan_protocol_header_serialize(&msg->header, serialized_header_for_calc) != XSAN_OK) {
-        if (msg->payload) XSAN_FREE(msg->payload);
-        XSAN_FREE(msg);
-        return NULL;
-    }
-
-    size_t data_to_checksum_len = XSAN_MESSAGE_HEADER_SIZE + msg->header.payload_length;
-    unsigned char *checksum_data_buf = (unsigned char *)XSAN_MALLOC(data_to_checksum_len);
-    if (!checksum_data_buf) {
-        if (msg->payload) XSAN_FREE(msg->payload);
-        XSAN_FREE(msg);
-        return NULL;
-    }
-
-    memcpy(checksum_data_buf, serialized_header_for_calc, XSAN_MESSAGE_HEADER_SIZE);
-    if (msg->payload && msg->header.payload_length > 0) {
-        memcpy(checksum_data_buf + XSAN_MESSAGE_HEADER_SIZE, msg->payload, msg->header.payload_length);
-    }
-
-    msg->header.checksum = xsan_protocol_calculate_checksum(checksum_data_buf, data_to_checksum_len);
-    XSAN_FREE(checksum_data_buf);
-
+    // The checksum stays 0 here; the sender fills it in per connection (see xsan_node_comm_send_msg).
     return msg;
 }
@@ -5,6 +5,9 @@
 #include "../../include/xsan_error.h" // 统一错误码头文件
 #include "xsan_log.h"
 #include "xsan_string_utils.h"
+#include "xsan_hashtable.h"
+#include "xsan_compress.h"
+#include "xsan_comm_credit.h"
 
 #include "spdk/env.h"
 #include "spdk/event.h"
@@ -13,52 +16,209 @@
 #include "spdk/thread.h"
 
 #include <arpa/inet.h>
+#include <endian.h>
 #include <errno.h>
 #include <string.h>
+#include <sys/uio.h>
 
 // --- Module Globals and Internal Structures ---
 
 #define XSAN_COMM_MAX_PEER_ADDR_LEN 64
 #define XSAN_COMM_DEFAULT_LISTEN_BACKLOG 128
-#define XSAN_COMM_SOCK_POLL_INTERVAL_US (1000) // Increased for less aggressive polling if not expecting high freq events
-#define XSAN_COMM_INITIAL_RECV_BUF_SIZE (XSAN_MESSAGE_HEADER_SIZE + 4096) // Initial buffer for header + some payload
-
-// Context for an active connection (either server-accepted or client-initiated and connected)
+#define XSAN_COMM_RX_RING_SIZE (64 * 1024)   // Per-connection receive ring; must be a power of two
+#define XSAN_COMM_RX_SMALL_PAYLOAD 4096      // Payloads up to this size without block data are copied out of the ring
+#define XSAN_COMM_RX_DATA_ALIGN 4096         // Alignment of block data inside received DMA payloads
+#define XSAN_COMM_RX_POOL_BUF_SIZE (128 * 1024 + XSAN_COMM_RX_DATA_ALIGN) // Pooled payload buffer size
+#define XSAN_COMM_RX_POOL_MAX_CACHED 256     // Free payload buffers kept for reuse
+#define XSAN_COMM_MAX_SEND_IOVS 64          // iovecs handed to one spdk_sock_writev (2-3 per message)
+#define XSAN_COMM_MAX_SEND_QUEUE_DEPTH 4096 // Messages queued per connection before send_msg returns BUSY
+#define XSAN_COMM_MAX_REACTORS 128          // SPDK threads that can own node-comm connections
+#define XSAN_COMM_PEER_TABLE_INITIAL_CAPACITY 64
+#define XSAN_COMM_CONNECT_RETRY_HOLDOFF_US (100 * 1000) // Connects to a peer that just failed fail fast this long
+#define XSAN_COMM_COMPRESS_MIN_SAVING_SHIFT 3 // Compressed payloads must be at least 1/8 smaller, else they go raw
+
+typedef enum {
+    XSAN_COMM_RX_HEADER = 0,    // Parsing the next header out of the ring
+    XSAN_COMM_RX_PAYLOAD,       // Receiving the rest of a payload straight into its buffer
+} xsan_comm_rx_state_t;
+
+// A DMA-capable receive payload buffer. Buffers of the pool size are recycled through a
+// free list; larger payloads get a buffer of their own that is freed on release.
+typedef struct xsan_comm_rx_buf {
+    struct xsan_comm_rx_buf *next;
+    unsigned char *base;
+    bool pooled;
+    xsan_comm_rx_credit_t credit;
+} xsan_comm_rx_buf_t;
+
+// Prefix of a small received payload allocated on the heap; the payload follows it.
+typedef struct {
+    xsan_comm_rx_credit_t credit;
+} xsan_comm_rx_heap_hdr_t;
+
+// One queued outgoing message. On v1 connections the header is serialized at enqueue time; on
+// v2 connections messages are encoded when a flush packs them into frames. The payload is
+// referenced in place from the caller's xsan_message_t, which must outlive the send.
+typedef struct xsan_comm_send_req {
+    struct xsan_comm_send_req *next;
+    xsan_message_header_t header;       // Copy taken at enqueue; v2 messages are encoded from it
+    uint16_t v2_flags;                  // XSAN_PROTOCOL_V2_MSG_FLAG_* of the encoded v2 header
+    uint32_t raw_len;                   // Payload length before compression; what flow control charges
+    unsigned char *payload;
+    unsigned char *zbuf;                // Compressed payload owned by the request, NULL if sent as is
+    bool encoded;                       // iov describes the final wire bytes
+    bool fc_exempt;                     // Queued before flow control applied: counted, never held back
+    unsigned char frame_buf[XSAN_PROTOCOL_V2_FRAME_HEADER_SIZE]; // Frame header if this message starts a v2 frame
+    unsigned char header_buf[XSAN_MESSAGE_HEADER_SIZE];          // v1 header or v2 message header
+    struct iovec iov[3];
+    int iovcnt;
+    size_t total_len;
+    size_t bytes_sent;      // Progress of this message across partial writes
+    xsan_node_send_cb_t send_cb;
+    void *send_cb_arg;
+} xsan_comm_send_req_t;
+
+struct xsan_connection_ctx;
+struct xsan_comm_peer;
+
+// Per-reactor node-comm state. Each SPDK thread that owns connections has its own sock group
+// and poller; everything here is only touched on that thread, so no locking is needed.
+typedef struct xsan_comm_reactor {
+    struct spdk_thread *thread;
+    uint32_t core;                          // Core the thread was on when registered
+    struct spdk_sock_group *sock_group;
+    struct spdk_poller *poller;
+    struct xsan_connection_ctx *connections; // Connections owned by this reactor
+    uint32_t num_connections;
+    xsan_hashtable_t *peers;                // xsan_comm_peer_t by (ip, port): this reactor's outbound connections
+
+    // Adaptive polling (see xsan_node_comm_poll_opts_t)
+    uint64_t last_activity_ticks;
+    uint64_t next_poll_ticks;               // While backing off: earliest time of the next real poll
+    uint64_t mode_since_ticks;
+    uint32_t backoff_us;
+    xsan_node_comm_poll_stats_t poll_stats; // Also holds the current mode
+
+    xsan_node_comm_compress_stats_t compress_stats; // Times are kept in the tick counters below
+    uint64_t compress_ticks;
+    uint64_t decompress_ticks;
+} xsan_comm_reactor_t;
+
+// Context for an active connection (either server-accepted or client-initiated and connected).
+// A connection belongs to one reactor: its socket is in that reactor's sock group, and it is
+// only received on, sent on and closed from that reactor's thread.
 typedef struct xsan_connection_ctx {
     struct spdk_sock *sock;
     char peer_addr_str[XSAN_COMM_MAX_PEER_ADDR_LEN];
-
-    unsigned char *recv_buf;
-    size_t recv_buf_capacity;
-    size_t recv_buf_len; // Current amount of data in recv_buf
-    xsan_message_header_t partial_recv_header;
-    bool header_fully_received;
+    xsan_comm_reactor_t *reactor;
+    bool in_sock_group;
+
+    // Peer-table entry of an outbound connection, NULL for accepted ones (whose peer port is
+    // ephemeral, so they are never looked up by address).
+    struct xsan_comm_peer *peer;
+
+    // Receive state machine. Headers (and small payloads) are parsed out of rx_ring; once a
+    // header announces a large payload, the remainder is received directly into rx_payload.
+    unsigned char *rx_ring;
+    uint32_t rx_ring_head;              // Next byte to parse (free-running, masked on access)
+    uint32_t rx_ring_tail;              // Next byte to fill (free-running, masked on access)
+    xsan_comm_rx_state_t rx_state;
+    xsan_message_header_t rx_header;    // Header of the message being received
+    uint16_t rx_msg_flags;              // XSAN_PROTOCOL_V2_MSG_FLAG_* of the message being received
+    unsigned char *rx_zbuf;             // Heap buffer receiving a compressed payload (then rx_payload)
+    xsan_comm_rx_buf_t *rx_buf;         // DMA buffer backing rx_payload, NULL for heap payloads
+    unsigned char *rx_payload;
+    uint32_t rx_payload_received;
 
     // Generic fallback message handler for this connection (usually the global one)
     xsan_node_message_handler_cb_t app_msg_handler_cb;
     void *app_msg_handler_cb_arg;
 
-    // For an ongoing send operation
-    xsan_node_send_cb_t current_send_cb;
-    void* current_send_cb_arg;
+    // v2 frame being received. Its messages are held until the whole frame has arrived and
+    // its checksum is verified, then dispatched in order.
+    uint16_t rx_frame_msgs_left;        // Messages of the current frame not yet complete; 0 outside a frame
+    uint16_t rx_frame_num_held;
+    uint32_t rx_frame_bytes_left;       // Frame body bytes not yet announced by a message header
+    uint32_t rx_frame_checksum;         // Checksum from the frame header, 0 if none
+    uint32_t rx_frame_crc;              // Running CRC32C over the frame received so far
+    xsan_message_t *rx_frame_msgs[XSAN_PROTOCOL_V2_MAX_FRAME_MSGS];
+
+    // Ordered send queue, drained by _xsan_comm_flush_msg_fn on the connection's thread
+    xsan_comm_send_req_t *send_queue_head;
+    xsan_comm_send_req_t *send_queue_tail;
+    xsan_comm_send_req_t *send_unframed;    // First queued v2 message not yet packed into a frame
+    xsan_comm_send_req_t *send_uncredited;  // First queued message not yet admitted against the peer's credit
+    xsan_comm_send_req_t *send_admitted_tail; // Last admitted message still queued, NULL if none
+    uint32_t send_queue_depth;
+    bool flush_scheduled;   // A flush message is in flight and holds a pointer to this context
+    bool rx_active;         // The receive path is running and holds a pointer to this context
+    bool closing;           // Socket closed; the flush message or receive path still holding it frees the context
+
+    uint32_t peer_features; // XSAN_COMM_FEATURE_* bits the peer advertised
+    bool crc32c_tx;         // Both sides advertised CRC32C: checksum every outgoing message
+    bool frame_batching_tx; // Both sides advertised frame batching: pack queued messages into shared frames
+    bool lz4_tx;            // Both sides advertised LZ4: compress v2 payloads that shrink
+    uint16_t tx_version;    // Wire format of our sends; v1 until the handshake agrees on more
+
+    // Credit-based flow control (XSAN_COMM_FEATURE_FLOW_CONTROL). Both directions count every
+    // message except node comm's own from the start of the connection, so the cumulative limits
+    // in a grant mean the same on both sides.
+    bool flow_control;          // Both sides offered it
+    xsan_comm_credit_tx_t tx_credit;    // Peer's latest grant and what we admitted against it
+    xsan_comm_credit_rx_t rx_credit;    // Window we grant the peer and the totals released from it
 
     struct xsan_connection_ctx *next;
     struct xsan_connection_ctx *prev;
 } xsan_connection_ctx_t;
 
-// Context for an outstanding client connect operation
-typedef struct xsan_pending_connect_op {
-    xsan_node_connect_cb_t user_cb;
-    void *user_cb_arg;
-    struct spdk_sock *sock_in_progress;
-    char target_addr_str_for_log[XSAN_COMM_MAX_PEER_ADDR_LEN];
-} xsan_pending_connect_op_t;
-
+typedef struct {
+    const char *ip;
+    uint16_t port;
+} xsan_comm_peer_key_t;
+
+// A caller of xsan_node_comm_connect waiting for its callback.
+typedef struct xsan_comm_connect_waiter {
+    struct xsan_comm_connect_waiter *next;
+    xsan_node_connect_cb_t cb;
+    void *cb_arg;
+} xsan_comm_connect_waiter_t;
+
+// One remote node in a reactor's peer table. Every connect to the peer from this reactor
+// shares its connection; callers that arrive while a completion is pending join its waiters.
+typedef struct xsan_comm_peer {
+    xsan_comm_peer_key_t key;               // Hashtable key; key.ip points at ip
+    char ip[INET6_ADDRSTRLEN];
+    uint16_t port;
+    xsan_connection_ctx_t *conn;            // Live outbound connection, NULL if none
+    xsan_comm_connect_waiter_t *waiters_head;
+    xsan_comm_connect_waiter_t *waiters_tail;
+    bool completion_scheduled;              // A message delivering waiters holds a pointer to this peer
+    bool orphaned;                          // Reactor stopped; the pending completion frees the peer
+    uint64_t retry_after_ticks;             // Earliest time to retry after a failed connect
+} xsan_comm_peer_t;
+
+typedef struct {
+    char ip[INET6_ADDRSTRLEN];
+    uint16_t port;
+} xsan_comm_warm_up_ctx_t;
+
+
+// Receive payload buffer pool. Separate from g_node_comm_ctx (which init clears) because
+// buffers are released by whoever destroys the message, possibly after fini.
+static struct {
+    pthread_mutex_t lock;
+    xsan_comm_rx_buf_t *free_list;
+    uint32_t num_cached;
+} g_rx_buf_pool = { PTHREAD_MUTEX_INITIALIZER, NULL, 0 };
 
 static struct {
-    struct spdk_sock_group *sock_group_on_reactor;
-    struct spdk_poller *sock_group_poller;
+    xsan_comm_reactor_t *reactors[XSAN_COMM_MAX_REACTORS];
+    uint32_t num_reactors;                  // Published after reactors[] is filled in; only grows until fini
+    pthread_mutex_t reactors_lock;          // Serializes reactor registration
+    uint32_t next_accept_reactor;           // Round-robin cursor for accepted connections
+
     struct spdk_sock *listener_sock;
+    xsan_comm_reactor_t *listener_reactor;  // Reactor whose sock group polls the listener
 
     char module_listen_ip[INET6_ADDRSTRLEN];
     uint16_t module_listen_port;
@@ -66,26 +226,56 @@ static struct {
     xsan_node_message_handler_cb_t global_app_msg_handler_cb; // Generic fallback if no specific handler
     void *global_app_msg_handler_cb_arg;
 
-    xsan_connection_ctx_t *active_connections_head;
-    pthread_mutex_t active_connections_lock; // Protects active_connections_head list
-
     bool module_initialized;
 
     xsan_specific_message_handler_cb_t specific_handlers[XSAN_MSG_TYPE_MAX];
     void *specific_handler_args[XSAN_MSG_TYPE_MAX];
+
+    uint32_t local_features;    // XSAN_COMM_FEATURE_* bits advertised on new connections
+    uint16_t local_max_version; // Highest protocol version advertised on new connections
+    uint32_t flow_window_bytes; // Receive windows granted on new flow-controlled connections
+    uint32_t flow_window_msgs;
+    uint32_t compress_min_bytes; // Smallest payload compressed on LZ4 connections
+
+    xsan_node_comm_poll_opts_t poll_opts;
+    uint64_t poll_busy_window_ticks;
+    uint64_t poll_park_after_ticks;
+    xsan_node_comm_poll_busy_fn_t poll_busy_fn;
+    void *poll_busy_arg;
 } g_node_comm_ctx;
 
 
+// Per-thread cache of the reactor index last resolved for the current SPDK thread.
+static __thread struct spdk_thread *t_comm_cached_thread;
+static __thread int t_comm_cached_reactor = -1;
+
 static int _xsan_comm_poller_fn(void *arg);
 static void _xsan_comm_sock_event_callback(void *cb_arg, struct spdk_sock_group *group, struct spdk_sock *sock);
 static void _process_received_data_for_connection(xsan_connection_ctx_t *conn_ctx);
 static void _add_connection_to_active_list(xsan_connection_ctx_t *conn_ctx);
 static void _remove_connection_from_active_list(xsan_connection_ctx_t *conn_ctx);
 static void _cleanup_and_free_connection_ctx(xsan_connection_ctx_t *conn_ctx, bool close_spdk_sock_if_needed);
-static xsan_connection_ctx_t* _create_connection_ctx(struct spdk_sock *sock,
+static xsan_connection_ctx_t* _create_connection_ctx(xsan_comm_reactor_t *reactor, struct spdk_sock *sock,
                                                      xsan_node_message_handler_cb_t handler_cb, // Generic handler
                                                      void *handler_cb_arg);
 static void _format_peer_addr(struct spdk_sock *sock, char *buf, size_t len);
+static void _xsan_comm_schedule_flush(xsan_connection_ctx_t *conn_ctx);
+static void _xsan_comm_flush_msg_fn(void *arg);
+static xsan_comm_send_req_t *_xsan_comm_detach_send_queue(xsan_connection_ctx_t *conn_ctx);
+static void _xsan_comm_complete_send_reqs(xsan_comm_send_req_t *reqs, int status);
+static void _xsan_comm_rx_buf_put(xsan_comm_rx_buf_t *buf);
+static void _xsan_comm_rx_pool_drain(void);
+static xsan_error_t _xsan_comm_enqueue_msg(xsan_connection_ctx_t *conn_ctx, xsan_message_t *msg,
+                                           xsan_node_send_cb_t send_cb, void *cb_arg);
+static xsan_comm_send_req_t *_xsan_comm_build_send_req(xsan_connection_ctx_t *conn_ctx, xsan_message_t *msg,
+                                                      xsan_node_send_cb_t send_cb, void *cb_arg);
+static bool _xsan_comm_flush_pending(const xsan_connection_ctx_t *conn_ctx);
+static xsan_error_t _xsan_comm_connection_established(xsan_connection_ctx_t *conn_ctx);
+static xsan_comm_reactor_t *_xsan_comm_get_local_reactor(void);
+static void _xsan_comm_reactor_stop(xsan_comm_reactor_t *reactor);
+static void _xsan_comm_reactor_stop_msg_fn(void *arg);
+static void _xsan_comm_poll_wake(xsan_comm_reactor_t *reactor);
+static void _xsan_comm_apply_poll_opts(const xsan_node_comm_poll_opts_t *opts);
 
 #ifndef XSAN_ERROR_SPDK_ENV
 #define XSAN_ERROR_SPDK_ENV XSAN_ERROR_SYSTEM
@@ -95,6 +285,23 @@ static void _format_peer_addr(struct spdk_sock *sock, char *buf, size_t len);
 #endif
 
 
+// Registers one reactor per core that has an SPDK thread, so accepted connections can be spread out.
+static void _xsan_comm_reactor_setup_msg_fn(void *ctx) {
+    (void)ctx;
+    if (!g_node_comm_ctx.module_initialized) return;
+    uint32_t core = spdk_env_get_current_core();
+    uint32_t n = __sync_add_and_fetch(&g_node_comm_ctx.num_reactors, 0);
+    for (uint32_t i = 0; i < n; ++i) {
+        if (g_node_comm_ctx.reactors[i]->core == core) return; // Further threads on this core join lazily
+    }
+    _xsan_comm_get_local_reactor();
+}
+
+static void _xsan_comm_reactor_setup_done_fn(void *ctx) {
+    (void)ctx;
+    XSAN_LOG_INFO("XSAN Node Comm polling on %u reactor(s).", __sync_add_and_fetch(&g_node_comm_ctx.num_reactors, 0));
+}
+
 xsan_error_t xsan_node_comm_init(const char *listen_ip, uint16_t listen_port,
                                  xsan_node_message_handler_cb_t msg_handler_cb, // Generic fallback handler
                                  void *handler_cb_arg) {
@@ -103,35 +310,50 @@ xsan_error_t xsan_node_comm_init(const char *listen_ip, uint16_t listen_port,
 
     XSAN_LOG_INFO("Initializing XSAN Node Comm module...");
     memset(&g_node_comm_ctx, 0, sizeof(g_node_comm_ctx));
-    if (pthread_mutex_init(&g_node_comm_ctx.active_connections_lock, NULL) != 0) { XSAN_LOG_FATAL("Mutex init failed."); return XSAN_ERROR_SYSTEM; }
-
-    uint32_t current_reactor = spdk_env_get_current_core();
-    g_node_comm_ctx.sock_group_on_reactor = spdk_net_framework_get_sock_group(current_reactor);
-    if (!g_node_comm_ctx.sock_group_on_reactor) { XSAN_LOG_FATAL("Failed to get SPDK sock group for reactor %u.", current_reactor); pthread_mutex_destroy(&g_node_comm_ctx.active_connections_lock); return XSAN_ERROR_SPDK_ENV; }
+    if (pthread_mutex_init(&g_node_comm_ctx.reactors_lock, NULL) != 0) { XSAN_LOG_FATAL("Mutex init failed."); return XSAN_ERROR_SYSTEM; }
 
     g_node_comm_ctx.global_app_msg_handler_cb = msg_handler_cb;
     g_node_comm_ctx.global_app_msg_handler_cb_arg = handler_cb_arg;
+    g_node_comm_ctx.local_features = XSAN_COMM_FEATURE_CRC32C | XSAN_COMM_FEATURE_FRAME_BATCHING | XSAN_COMM_FEATURE_FLOW_CONTROL;
+    g_node_comm_ctx.local_max_version = XSAN_PROTOCOL_VERSION;
+    g_node_comm_ctx.flow_window_bytes = XSAN_NODE_COMM_FLOW_DEFAULT_WINDOW_BYTES;
+    g_node_comm_ctx.flow_window_msgs = XSAN_NODE_COMM_FLOW_DEFAULT_WINDOW_MSGS;
+    g_node_comm_ctx.compress_min_bytes = XSAN_NODE_COMM_COMPRESS_DEFAULT_MIN_BYTES;
+    xsan_node_comm_poll_opts_t poll_opts;
+    xsan_node_comm_poll_opts_init(&poll_opts);
+    _xsan_comm_apply_poll_opts(&poll_opts);
+
+    xsan_comm_reactor_t *reactor = _xsan_comm_get_local_reactor();
+    if (!reactor) { XSAN_LOG_FATAL("Failed to set up node comm polling on core %u.", spdk_env_get_current_core()); pthread_mutex_destroy(&g_node_comm_ctx.reactors_lock); return XSAN_ERROR_SPDK_ENV; }
 
     if (listen_ip && listen_port > 0) {
         struct spdk_sock_opts opts; memset(&opts, 0, sizeof(opts));
         opts.opts_size = sizeof(struct spdk_sock_opts);
         g_node_comm_ctx.listener_sock = spdk_sock_listen_ext(listen_ip, (int)listen_port, NULL, &opts);
-        if (!g_node_comm_ctx.listener_sock) { XSAN_LOG_ERROR("Failed SPDK listen on %s:%u. Errno: %d (%s)", listen_ip, listen_port, errno, strerror(errno)); pthread_mutex_destroy(&g_node_comm_ctx.active_connections_lock); return XSAN_ERROR_NETWORK; }
+        if (!g_node_comm_ctx.listener_sock) { XSAN_LOG_ERROR("Failed SPDK listen on %s:%u. Errno: %d (%s)", listen_ip, listen_port, errno, strerror(errno)); goto err_reactor; }
+        if (spdk_sock_group_add_sock(reactor->sock_group, g_node_comm_ctx.listener_sock, _xsan_comm_sock_event_callback, NULL) != 0) {
+            XSAN_LOG_ERROR("Failed to add listener on %s:%u to sock group.", listen_ip, listen_port);
+            spdk_sock_close(&g_node_comm_ctx.listener_sock);
+            goto err_reactor;
+        }
+        g_node_comm_ctx.listener_reactor = reactor;
         xsan_strcpy_safe(g_node_comm_ctx.module_listen_ip, listen_ip, INET6_ADDRSTRLEN);
         g_node_comm_ctx.module_listen_port = listen_port;
         XSAN_LOG_INFO("SPDK Listening socket created on %s:%u", listen_ip, listen_port);
     }
 
-    g_node_comm_ctx.sock_group_poller = SPDK_POLLER_REGISTER(_xsan_comm_poller_fn, NULL, XSAN_COMM_SOCK_POLL_INTERVAL_US);
-    if (!g_node_comm_ctx.sock_group_poller) {
-        XSAN_LOG_FATAL("Failed to register SPDK sock group poller.");
-        if (g_node_comm_ctx.listener_sock) { struct spdk_sock *tmp = g_node_comm_ctx.listener_sock; spdk_sock_close(&tmp); g_node_comm_ctx.listener_sock = NULL; }
-        pthread_mutex_destroy(&g_node_comm_ctx.active_connections_lock);
-        return XSAN_ERROR_SPDK_ENV;
-    }
     g_node_comm_ctx.module_initialized = true;
+    // Other reactors are set up asynchronously; until they are, accepted connections stay on this one.
+    spdk_for_each_thread(_xsan_comm_reactor_setup_msg_fn, NULL, _xsan_comm_reactor_setup_done_fn);
     XSAN_LOG_INFO("XSAN Node Comm module initialized.");
     return XSAN_OK;
+
+err_reactor:
+    g_node_comm_ctx.reactors[0] = NULL;
+    g_node_comm_ctx.num_reactors = 0;
+    _xsan_comm_reactor_stop(reactor);
+    pthread_mutex_destroy(&g_node_comm_ctx.reactors_lock);
+    return XSAN_ERROR_NETWORK;
 }
 
 xsan_error_t xsan_node_comm_register_message_handler(xsan_message_type_t type,
@@ -158,33 +380,331 @@ xsan_error_t xsan_node_comm_register_message_handler(xsan_message_type_t type,
 void xsan_node_comm_fini(void) {
     if (!g_node_comm_ctx.module_initialized) return;
     XSAN_LOG_INFO("Finalizing XSAN Node Comm module...");
-    if (g_node_comm_ctx.sock_group_poller) { spdk_poller_unregister(&g_node_comm_ctx.sock_group_poller); g_node_comm_ctx.sock_group_poller = NULL; }
-    pthread_mutex_lock(&g_node_comm_ctx.active_connections_lock);
-    xsan_connection_ctx_t *conn_ctx = g_node_comm_ctx.active_connections_head;
-    xsan_connection_ctx_t *next_conn_ctx;
+    g_node_comm_ctx.module_initialized = false;
+    g_node_comm_ctx.poll_busy_fn = NULL; // Its owner may be torn down right after this
+    if (g_node_comm_ctx.listener_sock) {
+        if (g_node_comm_ctx.listener_reactor) spdk_sock_group_remove_sock(g_node_comm_ctx.listener_reactor->sock_group, g_node_comm_ctx.listener_sock);
+        spdk_sock_close(&g_node_comm_ctx.listener_sock);
+        g_node_comm_ctx.listener_reactor = NULL;
+    }
+    // Unpublish every reactor first: stopping one fails its queued sends, and those callbacks
+    // may call back into this module.
+    xsan_comm_reactor_t *reactors[XSAN_COMM_MAX_REACTORS];
+    pthread_mutex_lock(&g_node_comm_ctx.reactors_lock);
+    uint32_t n = g_node_comm_ctx.num_reactors;
+    memcpy(reactors, g_node_comm_ctx.reactors, sizeof(reactors[0]) * n);
+    memset(g_node_comm_ctx.reactors, 0, sizeof(g_node_comm_ctx.reactors));
+    g_node_comm_ctx.num_reactors = 0;
+    pthread_mutex_unlock(&g_node_comm_ctx.reactors_lock);
+
+    // Each reactor's sockets and poller are torn down on its own thread.
+    struct spdk_thread *self = spdk_get_thread();
+    for (uint32_t i = 0; i < n; ++i) {
+        if (reactors[i]->thread == self) {
+            _xsan_comm_reactor_stop(reactors[i]);
+        } else if (spdk_thread_send_msg(reactors[i]->thread, _xsan_comm_reactor_stop_msg_fn, reactors[i]) != 0) {
+            XSAN_LOG_ERROR("Failed to post node comm shutdown to reactor on core %u; its connections are leaked.", reactors[i]->core);
+        }
+    }
+    pthread_mutex_destroy(&g_node_comm_ctx.reactors_lock);
+    _xsan_comm_rx_pool_drain();
+    XSAN_LOG_INFO("XSAN Node Comm module finalized.");
+}
+
+// --- Reactors ---
+
+// Returns the calling thread's reactor, or NULL if it has none.
+static xsan_comm_reactor_t *_xsan_comm_find_local_reactor(void) {
+    struct spdk_thread *thread = spdk_get_thread();
+    if (!thread) return NULL;
+    uint32_t n = __sync_add_and_fetch(&g_node_comm_ctx.num_reactors, 0);
+    int idx = t_comm_cached_reactor;
+    if (t_comm_cached_thread == thread && idx >= 0 && (uint32_t)idx < n &&
+        g_node_comm_ctx.reactors[idx]->thread == thread) {
+        return g_node_comm_ctx.reactors[idx];
+    }
+    for (uint32_t i = 0; i < n; ++i) {
+        if (g_node_comm_ctx.reactors[i]->thread == thread) {
+            t_comm_cached_thread = thread;
+            t_comm_cached_reactor = (int)i;
+            return g_node_comm_ctx.reactors[i];
+        }
+    }
+    return NULL;
+}
+
+static uint32_t _xsan_comm_peer_hash(const void *key) {
+    const xsan_comm_peer_key_t *k = (const xsan_comm_peer_key_t *)key;
+    uint32_t h = 2166136261u; // FNV-1a
+    for (const unsigned char *c = (const unsigned char *)k->ip; *c; ++c) { h ^= *c; h *= 16777619u; }
+    h ^= k->port;
+    h *= 16777619u;
+    return h;
+}
+
+static int _xsan_comm_peer_compare(const void *key1, const void *key2) {
+    const xsan_comm_peer_key_t *k1 = (const xsan_comm_peer_key_t *)key1;
+    const xsan_comm_peer_key_t *k2 = (const xsan_comm_peer_key_t *)key2;
+    if (k1->port != k2->port) return (k1->port < k2->port) ? -1 : 1;
+    return strcmp(k1->ip, k2->ip);
+}
+
+// Returns the calling thread's reactor, creating its sock group and poller on first use.
+static xsan_comm_reactor_t *_xsan_comm_get_local_reactor(void) {
+    xsan_comm_reactor_t *reactor = _xsan_comm_find_local_reactor();
+    if (reactor || !spdk_get_thread()) return reactor;
+
+    reactor = (xsan_comm_reactor_t *)XSAN_CALLOC(1, sizeof(xsan_comm_reactor_t));
+    if (!reactor) return NULL;
+    reactor->thread = spdk_get_thread();
+    reactor->core = spdk_env_get_current_core();
+    reactor->peers = xsan_hashtable_create(XSAN_COMM_PEER_TABLE_INITIAL_CAPACITY, _xsan_comm_peer_hash,
+                                           _xsan_comm_peer_compare, NULL, NULL);
+    if (!reactor->peers) {
+        XSAN_FREE(reactor);
+        return NULL;
+    }
+    reactor->sock_group = spdk_sock_group_create(reactor);
+    if (!reactor->sock_group) {
+        XSAN_LOG_ERROR("Failed to create sock group on core %u.", reactor->core);
+        xsan_hashtable_destroy(reactor->peers);
+        XSAN_FREE(reactor);
+        return NULL;
+    }
+    reactor->poller = SPDK_POLLER_REGISTER(_xsan_comm_poller_fn, reactor, 0);
+    reactor->last_activity_ticks = reactor->mode_since_ticks = spdk_get_ticks();
+    reactor->poll_stats.core = reactor->core;
+    reactor->poll_stats.mode = XSAN_NODE_COMM_POLL_BUSY;
+    if (!reactor->poller) {
+        XSAN_LOG_ERROR("Failed to register sock group poller on core %u.", reactor->core);
+        spdk_sock_group_close(&reactor->sock_group);
+        xsan_hashtable_destroy(reactor->peers);
+        XSAN_FREE(reactor);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&g_node_comm_ctx.reactors_lock);
+    uint32_t idx = g_node_comm_ctx.num_reactors;
+    if (idx < XSAN_COMM_MAX_REACTORS) {
+        g_node_comm_ctx.reactors[idx] = reactor;
+        __sync_synchronize(); // Publish the entry before the count that makes it visible
+        g_node_comm_ctx.num_reactors = idx + 1;
+    }
+    pthread_mutex_unlock(&g_node_comm_ctx.reactors_lock);
+    if (idx >= XSAN_COMM_MAX_REACTORS) {
+        XSAN_LOG_ERROR("More than %d node comm reactors; thread on core %u cannot own connections.", XSAN_COMM_MAX_REACTORS, reactor->core);
+        _xsan_comm_reactor_stop(reactor);
+        return NULL;
+    }
+    XSAN_LOG_DEBUG("Node comm reactor %u registered on core %u.", idx, reactor->core);
+    return reactor;
+}
+
+// Closes every connection of an unpublished reactor and frees it. Runs on the reactor's thread.
+static void _xsan_comm_reactor_stop(xsan_comm_reactor_t *reactor) {
+    if (reactor->poller) spdk_poller_unregister(&reactor->poller);
+    xsan_connection_ctx_t *conn_ctx = reactor->connections;
+    reactor->connections = NULL;
+    reactor->num_connections = 0;
     while (conn_ctx) {
-        next_conn_ctx = conn_ctx->next;
+        xsan_connection_ctx_t *next_conn_ctx = conn_ctx->next;
         _cleanup_and_free_connection_ctx(conn_ctx, true);
         conn_ctx = next_conn_ctx;
     }
-    g_node_comm_ctx.active_connections_head = NULL;
-    pthread_mutex_unlock(&g_node_comm_ctx.active_connections_lock);
-    if (g_node_comm_ctx.listener_sock) { struct spdk_sock *tmp = g_node_comm_ctx.listener_sock; spdk_sock_close(&tmp); g_node_comm_ctx.listener_sock = NULL; }
-    g_node_comm_ctx.sock_group_on_reactor = NULL;
-    pthread_mutex_destroy(&g_node_comm_ctx.active_connections_lock);
-    g_node_comm_ctx.module_initialized = false;
-    XSAN_LOG_INFO("XSAN Node Comm module finalized.");
+    if (reactor->sock_group && spdk_sock_group_close(&reactor->sock_group) != 0) {
+        XSAN_LOG_WARN("Sock group on core %u did not close cleanly.", reactor->core);
+    }
+    size_t num_peers = reactor->peers ? xsan_hashtable_size(reactor->peers) : 0;
+    // Collect first: the keys point into the peers being freed.
+    xsan_comm_peer_t **peers = num_peers ? (xsan_comm_peer_t **)XSAN_MALLOC(sizeof(xsan_comm_peer_t *) * num_peers) : NULL;
+    size_t n = 0;
+    if (peers) {
+        xsan_hashtable_iter_t iter;
+        void *value = NULL;
+        xsan_hashtable_iter_init(reactor->peers, &iter);
+        while (n < num_peers && xsan_hashtable_iter_next(&iter, NULL, &value)) peers[n++] = (xsan_comm_peer_t *)value;
+    } else if (num_peers) {
+        XSAN_LOG_ERROR("OOM freeing %zu peers on core %u; they are leaked.", num_peers, reactor->core);
+    }
+    if (reactor->peers) xsan_hashtable_destroy(reactor->peers);
+    for (size_t i = 0; i < n; ++i) {
+        if (peers[i]->completion_scheduled) peers[i]->orphaned = true; // Its waiters still get -ECONNRESET
+        else XSAN_FREE(peers[i]);
+    }
+    if (peers) XSAN_FREE(peers);
+    XSAN_FREE(reactor);
+}
+
+static void _xsan_comm_reactor_stop_msg_fn(void *arg) {
+    _xsan_comm_reactor_stop((xsan_comm_reactor_t *)arg);
+}
+
+// Picks the reactor for the next accepted connection, round-robin over all registered reactors.
+static xsan_comm_reactor_t *_xsan_comm_pick_accept_reactor(void) {
+    uint32_t n = __sync_add_and_fetch(&g_node_comm_ctx.num_reactors, 0);
+    if (n == 0) return NULL;
+    return g_node_comm_ctx.reactors[g_node_comm_ctx.next_accept_reactor++ % n];
+}
+
+// --- Adaptive Polling ---
+
+static void _xsan_comm_apply_poll_opts(const xsan_node_comm_poll_opts_t *opts) {
+    uint64_t hz = spdk_get_ticks_hz();
+    g_node_comm_ctx.poll_opts = *opts;
+    g_node_comm_ctx.poll_busy_window_ticks = (uint64_t)opts->busy_window_us * hz / 1000000;
+    g_node_comm_ctx.poll_park_after_ticks = (uint64_t)opts->park_after_us * hz / 1000000;
+}
+
+// Split to avoid overflow: a parked reactor can stay in one mode for hours.
+static uint64_t _xsan_comm_ticks_to_us(uint64_t ticks) {
+    uint64_t hz = spdk_get_ticks_hz();
+    return ticks / hz * 1000000 + ticks % hz * 1000000 / hz;
+}
+
+static void _xsan_comm_poll_set_mode(xsan_comm_reactor_t *reactor, xsan_node_comm_poll_mode_t mode, uint64_t now) {
+    uint64_t us = _xsan_comm_ticks_to_us(now - reactor->mode_since_ticks);
+    if (reactor->poll_stats.mode == XSAN_NODE_COMM_POLL_BUSY) reactor->poll_stats.busy_us += us;
+    else reactor->poll_stats.idle_us += us;
+    reactor->mode_since_ticks = now;
+
+    // Only parking changes the poller itself. The timed poller is woken by its timer alone,
+    // never by socket readiness, so a parked reactor reads new data up to backoff_max_us late.
+    bool was_parked = (reactor->poll_stats.mode == XSAN_NODE_COMM_POLL_PARKED);
+    bool parked = (mode == XSAN_NODE_COMM_POLL_PARKED);
+    reactor->poll_stats.mode = mode;
+    if (was_parked == parked || !reactor->poller) return;
+    uint64_t period_us = parked ? g_node_comm_ctx.poll_opts.backoff_max_us : 0;
+    spdk_poller_unregister(&reactor->poller);
+    reactor->poller = SPDK_POLLER_REGISTER(_xsan_comm_poller_fn, reactor, period_us);
+    if (!reactor->poller) {
+        // Connections on this reactor would never be polled again; keep busy-polling instead.
+        XSAN_LOG_ERROR("Failed to re-register node comm poller on core %u.", reactor->core);
+        reactor->poller = SPDK_POLLER_REGISTER(_xsan_comm_poller_fn, reactor, 0);
+        reactor->poll_stats.mode = XSAN_NODE_COMM_POLL_BUSY;
+        return;
+    }
+    if (parked) {
+        reactor->poll_stats.parks++;
+        XSAN_LOG_DEBUG("Node comm poller on core %u parked (%lu us period).", reactor->core, (unsigned long)period_us);
+    }
+}
+
+// Local activity (a send, a connect, a new connection): a response is likely, so poll busily.
+static void _xsan_comm_poll_wake(xsan_comm_reactor_t *reactor) {
+    uint64_t now = spdk_get_ticks();
+    reactor->last_activity_ticks = now;
+    if (reactor->poll_stats.mode != XSAN_NODE_COMM_POLL_BUSY) {
+        _xsan_comm_poll_set_mode(reactor, XSAN_NODE_COMM_POLL_BUSY, now);
+    }
+}
+
+// Called after a poll found nothing: stay busy within the busy window or while the hint asks
+// for it, otherwise back off (doubling the interval) and eventually park.
+static void _xsan_comm_poll_idle(xsan_comm_reactor_t *reactor, uint64_t now) {
+    const xsan_node_comm_poll_opts_t *opts = &g_node_comm_ctx.poll_opts;
+    if (opts->backoff_max_us == 0) return;
+    xsan_node_comm_poll_busy_fn_t busy_fn = g_node_comm_ctx.poll_busy_fn;
+    if (busy_fn && busy_fn(g_node_comm_ctx.poll_busy_arg)) {
+        reactor->last_activity_ticks = now;
+    }
+    uint64_t idle_ticks = now - reactor->last_activity_ticks;
+    if (idle_ticks < g_node_comm_ctx.poll_busy_window_ticks) {
+        if (reactor->poll_stats.mode != XSAN_NODE_COMM_POLL_BUSY) {
+            _xsan_comm_poll_set_mode(reactor, XSAN_NODE_COMM_POLL_BUSY, now);
+        }
+        return;
+    }
+
+    if (g_node_comm_ctx.poll_park_after_ticks > 0 && idle_ticks >= g_node_comm_ctx.poll_park_after_ticks) {
+        if (reactor->poll_stats.mode != XSAN_NODE_COMM_POLL_PARKED) {
+            _xsan_comm_poll_set_mode(reactor, XSAN_NODE_COMM_POLL_PARKED, now);
+        }
+        return;
+    }
+    if (reactor->poll_stats.mode == XSAN_NODE_COMM_POLL_BUSY) {
+        _xsan_comm_poll_set_mode(reactor, XSAN_NODE_COMM_POLL_BACKOFF, now);
+        reactor->backoff_us = opts->backoff_min_us;
+    } else {
+        reactor->backoff_us = reactor->backoff_us * 2 > opts->backoff_max_us ? opts->backoff_max_us : reactor->backoff_us * 2;
+    }
+    if (reactor->backoff_us == 0) reactor->backoff_us = 1;
+    reactor->next_poll_ticks = now + (uint64_t)reactor->backoff_us * spdk_get_ticks_hz() / 1000000;
 }
 
 static int _xsan_comm_poller_fn(void *arg) {
-    (void)arg;
-    if (g_node_comm_ctx.sock_group_on_reactor) {
-        int events = spdk_sock_group_poll(g_node_comm_ctx.sock_group_on_reactor);
-        return events > 0 ? SPDK_POLLER_BUSY : SPDK_POLLER_IDLE;
+    xsan_comm_reactor_t *reactor = (xsan_comm_reactor_t *)arg;
+    uint64_t now = spdk_get_ticks();
+    if (reactor->poll_stats.mode == XSAN_NODE_COMM_POLL_BACKOFF && now < reactor->next_poll_ticks) {
+        reactor->poll_stats.skipped_polls++;
+        return SPDK_POLLER_IDLE;
+    }
+
+    int events = 0;
+    int rc = spdk_sock_group_poll(reactor->sock_group);
+    if (rc > 0) events += rc;
+    // Resume connections whose last flush stopped on a full socket send buffer, and grant back
+    // credit freed since the last flush (payloads may be released on any thread).
+    for (xsan_connection_ctx_t *conn_ctx = reactor->connections; conn_ctx; conn_ctx = conn_ctx->next) {
+        if (!conn_ctx->flush_scheduled && _xsan_comm_flush_pending(conn_ctx)) {
+            _xsan_comm_schedule_flush(conn_ctx);
+            events++;
+        }
+    }
+
+    if (events > 0) {
+        reactor->poll_stats.busy_polls++;
+        reactor->last_activity_ticks = now;
+        if (reactor->poll_stats.mode != XSAN_NODE_COMM_POLL_BUSY) {
+            _xsan_comm_poll_set_mode(reactor, XSAN_NODE_COMM_POLL_BUSY, now);
+        }
+        return SPDK_POLLER_BUSY;
     }
+    reactor->poll_stats.idle_polls++;
+    _xsan_comm_poll_idle(reactor, now);
     return SPDK_POLLER_IDLE;
 }
 
+void xsan_node_comm_poll_opts_init(xsan_node_comm_poll_opts_t *opts) {
+    if (!opts) return;
+    opts->busy_window_us = XSAN_NODE_COMM_POLL_DEFAULT_BUSY_WINDOW_US;
+    opts->backoff_min_us = XSAN_NODE_COMM_POLL_DEFAULT_BACKOFF_MIN_US;
+    opts->backoff_max_us = XSAN_NODE_COMM_POLL_DEFAULT_BACKOFF_MAX_US;
+    opts->park_after_us = 0;
+}
+
+xsan_error_t xsan_node_comm_set_poll_opts(const xsan_node_comm_poll_opts_t *opts) {
+    if (!g_node_comm_ctx.module_initialized) return XSAN_ERROR_NOT_INITIALIZED;
+    if (!opts || (opts->backoff_max_us > 0 && opts->backoff_min_us > opts->backoff_max_us)) return XSAN_ERROR_INVALID_PARAM;
+    _xsan_comm_apply_poll_opts(opts);
+    XSAN_LOG_INFO("Node comm polling: busy window %u us, backoff %u..%u us, park after %u us.",
+                  opts->busy_window_us, opts->backoff_min_us, opts->backoff_max_us, opts->park_after_us);
+    return XSAN_OK;
+}
+
+void xsan_node_comm_set_poll_busy_hint(xsan_node_comm_poll_busy_fn_t fn, void *arg) {
+    g_node_comm_ctx.poll_busy_arg = arg;
+    __sync_synchronize(); // Pollers read fn first, then arg
+    g_node_comm_ctx.poll_busy_fn = fn;
+}
+
+uint32_t xsan_node_comm_get_num_reactors(void) {
+    return __sync_add_and_fetch(&g_node_comm_ctx.num_reactors, 0);
+}
+
+xsan_error_t xsan_node_comm_get_poll_stats(uint32_t index, xsan_node_comm_poll_stats_t *stats_out) {
+    if (!stats_out) return XSAN_ERROR_INVALID_PARAM;
+    if (index >= xsan_node_comm_get_num_reactors()) return XSAN_ERROR_NOT_FOUND;
+    xsan_comm_reactor_t *reactor = g_node_comm_ctx.reactors[index];
+    if (!reactor) return XSAN_ERROR_NOT_FOUND;
+    *stats_out = reactor->poll_stats;
+    // Include the time spent in the current mode so far.
+    uint64_t now = spdk_get_ticks(), since = reactor->mode_since_ticks;
+    uint64_t us = _xsan_comm_ticks_to_us(now > since ? now - since : 0);
+    if (stats_out->mode == XSAN_NODE_COMM_POLL_BUSY) stats_out->busy_us += us;
+    else stats_out->idle_us += us;
+    return XSAN_OK;
+}
+
 static void _format_peer_addr(struct spdk_sock *sock, char *buf, size_t len) {
     if (!sock || !buf || len == 0) { if (buf && len > 0) buf[0] = '\0'; return; }
     char host[INET6_ADDRSTRLEN]; uint16_t port;
@@ -194,181 +714,1038 @@ static void _format_peer_addr(struct spdk_sock *sock, char *buf, size_t len) {
     } else xsan_snprintf_safe(buf, len, "unknown_peer");
 }
 
-static xsan_connection_ctx_t* _create_connection_ctx(struct spdk_sock *sock,
+static xsan_connection_ctx_t* _create_connection_ctx(xsan_comm_reactor_t *reactor, struct spdk_sock *sock,
                                                      xsan_node_message_handler_cb_t handler_cb,
                                                      void *handler_cb_arg) {
-    if (!sock) return NULL;
+    if (!reactor || !sock) return NULL;
     xsan_connection_ctx_t *conn_ctx = (xsan_connection_ctx_t *)XSAN_MALLOC(sizeof(xsan_connection_ctx_t));
     if (!conn_ctx) { XSAN_LOG_ERROR("Failed to MALLOC conn_ctx."); return NULL; }
     memset(conn_ctx, 0, sizeof(xsan_connection_ctx_t));
     conn_ctx->sock = sock;
+    conn_ctx->reactor = reactor;
     _format_peer_addr(sock, conn_ctx->peer_addr_str, XSAN_COMM_MAX_PEER_ADDR_LEN);
-    conn_ctx->recv_buf_capacity = XSAN_COMM_INITIAL_RECV_BUF_SIZE;
-    conn_ctx->recv_buf = (unsigned char *)XSAN_MALLOC(conn_ctx->recv_buf_capacity);
-    if (!conn_ctx->recv_buf) { XSAN_LOG_ERROR("Failed to MALLOC recv_buf for %s.", conn_ctx->peer_addr_str); XSAN_FREE(conn_ctx); return NULL; }
+    conn_ctx->rx_ring = (unsigned char *)XSAN_MALLOC(XSAN_COMM_RX_RING_SIZE);
+    if (!conn_ctx->rx_ring) { XSAN_LOG_ERROR("Failed to MALLOC rx_ring for %s.", conn_ctx->peer_addr_str); XSAN_FREE(conn_ctx); return NULL; }
+    conn_ctx->rx_credit.acct = xsan_comm_credit_acct_create();
+    if (!conn_ctx->rx_credit.acct) { XSAN_LOG_ERROR("Failed to allocate credit accounting for %s.", conn_ctx->peer_addr_str); XSAN_FREE(conn_ctx->rx_ring); XSAN_FREE(conn_ctx); return NULL; }
+    conn_ctx->rx_state = XSAN_COMM_RX_HEADER;
+    conn_ctx->tx_version = XSAN_PROTOCOL_VERSION_1;
     conn_ctx->app_msg_handler_cb = handler_cb;
     conn_ctx->app_msg_handler_cb_arg = handler_cb_arg;
-    // DO NOT call spdk_sock_set_cb_arg here. It's done by the caller (_xsan_comm_sock_event_callback for server,
-    // or _xsan_client_sock_event_callback after successful connect for client)
+    // The socket joins the reactor's sock group in _xsan_comm_connection_established.
     XSAN_LOG_INFO("Created connection context for peer: %s (sock %p)", conn_ctx->peer_addr_str, sock);
     return conn_ctx;
 }
 
+// Links a connection into its reactor's list. Owner thread only, so no lock.
 static void _add_connection_to_active_list(xsan_connection_ctx_t *conn_ctx) {
     if (!conn_ctx) return;
-    pthread_mutex_lock(&g_node_comm_ctx.active_connections_lock);
-    conn_ctx->prev = NULL; conn_ctx->next = g_node_comm_ctx.active_connections_head;
-    if (g_node_comm_ctx.active_connections_head) g_node_comm_ctx.active_connections_head->prev = conn_ctx;
-    g_node_comm_ctx.active_connections_head = conn_ctx;
-    pthread_mutex_unlock(&g_node_comm_ctx.active_connections_lock);
-    XSAN_LOG_DEBUG("Added connection %s to active list.", conn_ctx->peer_addr_str);
+    xsan_comm_reactor_t *reactor = conn_ctx->reactor;
+    conn_ctx->prev = NULL; conn_ctx->next = reactor->connections;
+    if (reactor->connections) reactor->connections->prev = conn_ctx;
+    reactor->connections = conn_ctx;
+    reactor->num_connections++;
+    XSAN_LOG_DEBUG("Added connection %s to reactor on core %u (%u connections).", conn_ctx->peer_addr_str, reactor->core, reactor->num_connections);
 }
 
 static void _remove_connection_from_active_list(xsan_connection_ctx_t *conn_ctx_to_remove) {
     if (!conn_ctx_to_remove) return;
-    pthread_mutex_lock(&g_node_comm_ctx.active_connections_lock);
+    xsan_comm_reactor_t *reactor = conn_ctx_to_remove->reactor;
     if (conn_ctx_to_remove->prev) conn_ctx_to_remove->prev->next = conn_ctx_to_remove->next;
-    else g_node_comm_ctx.active_connections_head = conn_ctx_to_remove->next;
+    else reactor->connections = conn_ctx_to_remove->next;
     if (conn_ctx_to_remove->next) conn_ctx_to_remove->next->prev = conn_ctx_to_remove->prev;
-    pthread_mutex_unlock(&g_node_comm_ctx.active_connections_lock);
-    XSAN_LOG_DEBUG("Removed connection %s from active list.", conn_ctx_to_remove->peer_addr_str);
+    conn_ctx_to_remove->prev = conn_ctx_to_remove->next = NULL;
+    reactor->num_connections--;
+    XSAN_LOG_DEBUG("Removed connection %s from reactor on core %u.", conn_ctx_to_remove->peer_addr_str, reactor->core);
+}
+
+static void _free_connection_ctx(xsan_connection_ctx_t *conn_ctx) {
+    if (conn_ctx->rx_buf) _xsan_comm_rx_buf_put(conn_ctx->rx_buf);
+    else if (conn_ctx->rx_zbuf) XSAN_FREE(conn_ctx->rx_zbuf);
+    else if (conn_ctx->rx_payload) XSAN_FREE((xsan_comm_rx_heap_hdr_t *)conn_ctx->rx_payload - 1);
+    for (uint16_t i = 0; i < conn_ctx->rx_frame_num_held; ++i) {
+        xsan_protocol_message_destroy(conn_ctx->rx_frame_msgs[i]);
+    }
+    if (conn_ctx->rx_ring) { XSAN_FREE(conn_ctx->rx_ring); conn_ctx->rx_ring = NULL; }
+    xsan_comm_credit_acct_put(conn_ctx->rx_credit.acct); // Payloads still held by handlers keep it alive
+    XSAN_FREE(conn_ctx);
 }
 
 static void _cleanup_and_free_connection_ctx(xsan_connection_ctx_t *conn_ctx, bool close_spdk_sock_if_needed) {
     if (!conn_ctx) return;
     XSAN_LOG_INFO("Cleaning up conn_ctx for peer %s (sock %p).", conn_ctx->peer_addr_str, conn_ctx->sock);
+    if (conn_ctx->in_sock_group && conn_ctx->sock) {
+        spdk_sock_group_remove_sock(conn_ctx->reactor->sock_group, conn_ctx->sock);
+        conn_ctx->in_sock_group = false;
+    }
+    if (conn_ctx->peer && conn_ctx->peer->conn == conn_ctx) {
+        conn_ctx->peer->conn = NULL; // The next connect to this peer opens a new connection
+    }
+    conn_ctx->peer = NULL;
     if (close_spdk_sock_if_needed && conn_ctx->sock) {
         struct spdk_sock *tmp_sock_ptr = conn_ctx->sock;
         XSAN_LOG_DEBUG("Calling spdk_sock_close for %s.", conn_ctx->peer_addr_str);
         spdk_sock_close(&tmp_sock_ptr); // tmp_sock_ptr will be NULLed by spdk_sock_close
-        conn_ctx->sock = NULL;
     }
-    if (conn_ctx->recv_buf) { XSAN_FREE(conn_ctx->recv_buf); conn_ctx->recv_buf = NULL; }
-    XSAN_FREE(conn_ctx);
+    conn_ctx->sock = NULL;
+    xsan_comm_send_req_t *unsent = _xsan_comm_detach_send_queue(conn_ctx);
+    if (conn_ctx->flush_scheduled || conn_ctx->rx_active) {
+        conn_ctx->closing = true; // The pending flush message or the receive path frees the context
+    } else {
+        _free_connection_ctx(conn_ctx);
+    }
+    // Callbacks last: they may send or disconnect, and must not see this context.
+    _xsan_comm_complete_send_reqs(unsent, -ECONNRESET);
+}
+
+// --- Send Queue ---
+
+static xsan_comm_send_req_t *_xsan_comm_detach_send_queue(xsan_connection_ctx_t *conn_ctx) {
+    xsan_comm_send_req_t *reqs = conn_ctx->send_queue_head;
+    conn_ctx->send_queue_head = NULL;
+    conn_ctx->send_queue_tail = NULL;
+    conn_ctx->send_unframed = NULL;
+    conn_ctx->send_uncredited = NULL;
+    conn_ctx->send_admitted_tail = NULL;
+    conn_ctx->send_queue_depth = 0;
+    return reqs;
+}
+
+static void _xsan_comm_complete_send_reqs(xsan_comm_send_req_t *reqs, int status) {
+    while (reqs) {
+        xsan_comm_send_req_t *req = reqs;
+        reqs = req->next;
+        xsan_node_send_cb_t cb = req->send_cb;
+        void *cb_arg = req->send_cb_arg;
+        if (req->zbuf) XSAN_FREE(req->zbuf);
+        XSAN_FREE(req);
+        if (cb) cb(status, cb_arg);
+    }
+}
+
+static void _xsan_comm_schedule_flush(xsan_connection_ctx_t *conn_ctx) {
+    if (conn_ctx->flush_scheduled || conn_ctx->closing) return;
+    // Deferring to a message corks every send issued in the current event into one writev.
+    if (spdk_thread_send_msg(spdk_get_thread(), _xsan_comm_flush_msg_fn, conn_ctx) != 0) {
+        XSAN_LOG_DEBUG("Could not schedule send flush for %s; the poller will retry.", conn_ctx->peer_addr_str);
+        return;
+    }
+    conn_ctx->flush_scheduled = true;
+}
+
+// xsan_node_send_cb_t for messages node comm creates itself (handshakes, credit grants).
+static void _xsan_comm_control_msg_sent_cb(int status, void *cb_arg) {
+    (void)status;
+    xsan_protocol_message_destroy((xsan_message_t *)cb_arg);
+}
+
+// Node comm's own messages are never counted against credit, so grants can always be sent.
+static inline bool _xsan_comm_is_control_msg(uint32_t type) {
+    return type == XSAN_MSG_TYPE_COMM_FEATURES || type == XSAN_MSG_TYPE_COMM_CREDIT;
+}
+
+// --- Flow Control ---
+
+/**
+ * Counts a received message against the credit granted to the peer. With flow control the
+ * credit travels with the payload (credit, NULL for an empty payload) until the payload is
+ * freed; messages received before flow control started, and empty ones, release it at once.
+ */
+static void _xsan_comm_rx_charge(xsan_connection_ctx_t *conn_ctx, const xsan_message_header_t *header,
+                                 xsan_comm_rx_credit_t *credit) {
+    if (_xsan_comm_is_control_msg(header->type)) return;
+    xsan_comm_credit_rx_charge(conn_ctx->rx_credit.acct, header->payload_length,
+                               conn_ctx->flow_control ? credit : NULL);
+}
+
+// Whether a credit grant to the peer is due (see xsan_comm_credit_rx_grant_due).
+static bool _xsan_comm_credit_grant_due(const xsan_connection_ctx_t *conn_ctx, uint64_t *bytes_limit, uint64_t *msgs_limit) {
+    return conn_ctx->flow_control && xsan_comm_credit_rx_grant_due(&conn_ctx->rx_credit, bytes_limit, msgs_limit);
+}
+
+// Whether the peer's latest grant covers req on top of everything admitted so far.
+static bool _xsan_comm_credit_covers(const xsan_connection_ctx_t *conn_ctx, const xsan_comm_send_req_t *req) {
+    if (!conn_ctx->flow_control || req->fc_exempt || _xsan_comm_is_control_msg(req->header.type)) return true;
+    return xsan_comm_credit_tx_covers(&conn_ctx->tx_credit, req->raw_len);
+}
+
+// Admits queued messages in order while the peer's credit covers them. Only admitted messages
+// are framed and written; the rest wait for the next grant.
+static void _xsan_comm_admit_send_queue(xsan_connection_ctx_t *conn_ctx) {
+    while (conn_ctx->send_uncredited && _xsan_comm_credit_covers(conn_ctx, conn_ctx->send_uncredited)) {
+        xsan_comm_send_req_t *req = conn_ctx->send_uncredited;
+        if (!_xsan_comm_is_control_msg(req->header.type)) {
+            xsan_comm_credit_tx_consume(&conn_ctx->tx_credit, req->raw_len);
+        }
+        conn_ctx->send_admitted_tail = req;
+        conn_ctx->send_uncredited = req->next;
+    }
+    if (conn_ctx->send_uncredited) {
+        XSAN_LOG_TRACE("Sends to %s wait for credit (%lu/%lu bytes, %lu/%lu messages used).", conn_ctx->peer_addr_str,
+                       (unsigned long)conn_ctx->tx_credit.bytes, (unsigned long)conn_ctx->tx_credit.bytes_limit,
+                       (unsigned long)conn_ctx->tx_credit.msgs, (unsigned long)conn_ctx->tx_credit.msgs_limit);
+    }
+}
+
+/**
+ * Queues a credit grant if one is due. It goes right behind the admitted messages, ahead of any
+ * waiting for the peer's credit: the peer may need this grant before it can send the grant we
+ * are waiting for. Called once the admitted messages are framed. Returns true if a grant was queued.
+ */
+static bool _xsan_comm_queue_credit_grant(xsan_connection_ctx_t *conn_ctx) {
+    uint64_t bytes_limit, msgs_limit;
+    if (!_xsan_comm_credit_grant_due(conn_ctx, &bytes_limit, &msgs_limit)) return false;
+    xsan_comm_credit_payload_t pl;
+    pl.bytes_limit = htobe64(bytes_limit);
+    pl.msgs_limit = htobe64(msgs_limit);
+    xsan_message_t *msg = xsan_protocol_message_create(XSAN_MSG_TYPE_COMM_CREDIT, 0, &pl, sizeof(pl));
+    xsan_comm_send_req_t *req = msg ? _xsan_comm_build_send_req(conn_ctx, msg, _xsan_comm_control_msg_sent_cb, msg) : NULL;
+    if (!req) {
+        XSAN_LOG_WARN("Failed to queue credit grant to %s; the poller will retry.", conn_ctx->peer_addr_str);
+        if (msg) xsan_protocol_message_destroy(msg);
+        return false;
+    }
+    xsan_comm_send_req_t *prev = conn_ctx->send_admitted_tail;
+    req->next = prev ? prev->next : conn_ctx->send_queue_head;
+    if (prev) prev->next = req;
+    else conn_ctx->send_queue_head = req;
+    if (!req->next) conn_ctx->send_queue_tail = req;
+    conn_ctx->send_admitted_tail = req;
+    // Everything ahead of the grant is framed already, everything behind it is not yet admitted.
+    if (!req->encoded) conn_ctx->send_unframed = req;
+    conn_ctx->send_queue_depth++;
+    xsan_comm_credit_rx_granted(&conn_ctx->rx_credit, bytes_limit, msgs_limit);
+    XSAN_LOG_TRACE("Granted %s credit up to %lu bytes, %lu messages.", conn_ctx->peer_addr_str,
+                   (unsigned long)bytes_limit, (unsigned long)msgs_limit);
+    return true;
+}
+
+// Applies a grant from the peer. Limits are cumulative, so a stale grant never lowers them.
+static void _xsan_comm_handle_credit(xsan_connection_ctx_t *conn_ctx, const xsan_message_t *msg) {
+    if (msg->header.payload_length < sizeof(xsan_comm_credit_payload_t) || !msg->payload) {
+        XSAN_LOG_WARN("Short credit grant (%u bytes) from %s ignored.", msg->header.payload_length, conn_ctx->peer_addr_str);
+        return;
+    }
+    xsan_comm_credit_payload_t pl;
+    memcpy(&pl, msg->payload, sizeof(pl));
+    uint64_t bytes_limit = be64toh(pl.bytes_limit), msgs_limit = be64toh(pl.msgs_limit);
+    xsan_comm_credit_tx_apply_grant(&conn_ctx->tx_credit, bytes_limit, msgs_limit);
+    if (conn_ctx->send_uncredited) _xsan_comm_schedule_flush(conn_ctx);
+}
+
+// Whether a flush has anything to do: admitted messages to write, waiting messages the credit
+// now covers, or a grant to send.
+static bool _xsan_comm_flush_pending(const xsan_connection_ctx_t *conn_ctx) {
+    if (conn_ctx->send_queue_head && conn_ctx->send_queue_head != conn_ctx->send_uncredited) return true;
+    if (conn_ctx->send_uncredited && _xsan_comm_credit_covers(conn_ctx, conn_ctx->send_uncredited)) return true;
+    uint64_t bytes_limit, msgs_limit;
+    return _xsan_comm_credit_grant_due(conn_ctx, &bytes_limit, &msgs_limit);
+}
+
+/**
+ * Packs queued v2 messages into frames of up to XSAN_PROTOCOL_V2_MAX_FRAME_MSGS consecutive
+ * admitted messages (one per frame without frame batching). The frame header goes into the first
+ * message's iovecs; with CRC32C the checksum covers the whole frame.
+ */
+static void _xsan_comm_frame_send_queue(xsan_connection_ctx_t *conn_ctx) {
+    uint16_t max_msgs = conn_ctx->frame_batching_tx ? XSAN_PROTOCOL_V2_MAX_FRAME_MSGS : 1;
+    while (conn_ctx->send_unframed && conn_ctx->send_unframed != conn_ctx->send_uncredited) {
+        xsan_comm_send_req_t *first = conn_ctx->send_unframed;
+        if (first->encoded) {
+            // A v1 message queued before the upgrade, left behind a credit grant that overtook it
+            conn_ctx->send_unframed = first->next;
+            continue;
+        }
+        xsan_comm_send_req_t *end = first;
+        xsan_protocol_v2_frame_header_t frame;
+        memset(&frame, 0, sizeof(frame));
+        frame.magic = XSAN_PROTOCOL_V2_FRAME_MAGIC;
+        do {
+            uint32_t msg_len = (uint32_t)XSAN_PROTOCOL_V2_MSG_HEADER_SIZE + end->header.payload_length;
+            if (frame.num_msgs > 0 &&
+                (frame.num_msgs == max_msgs || frame.frame_length + msg_len > XSAN_PROTOCOL_V2_MAX_FRAME_SIZE)) {
+                break;
+            }
+            frame.num_msgs++;
+            frame.frame_length += msg_len;
+            end = end->next;
+        } while (end && end != conn_ctx->send_uncredited && !end->encoded);
+
+        for (xsan_comm_send_req_t *req = first; req != end; req = req->next) {
+            int n = 0;
+            if (req == first) {
+                req->iov[n].iov_base = req->frame_buf;
+                req->iov[n++].iov_len = XSAN_PROTOCOL_V2_FRAME_HEADER_SIZE;
+            }
+            xsan_protocol_v2_msg_header_encode(&req->header, req->v2_flags, req->header_buf);
+            req->iov[n].iov_base = req->header_buf;
+            req->iov[n++].iov_len = XSAN_PROTOCOL_V2_MSG_HEADER_SIZE;
+            if (req->header.payload_length > 0) {
+                req->iov[n].iov_base = req->payload;
+                req->iov[n++].iov_len = req->header.payload_length;
+            }
+            req->iovcnt = n;
+            req->total_len = 0;
+            for (int i = 0; i < n; ++i) req->total_len += req->iov[i].iov_len;
+            req->encoded = true;
+        }
+
+        xsan_protocol_v2_frame_header_encode(&frame, first->frame_buf);
+        if (conn_ctx->crc32c_tx) {
+            // The frame header was just encoded with a zero checksum, which is what the CRC covers.
+            uint32_t crc = XSAN_PROTOCOL_CRC32C_INIT;
+            for (xsan_comm_send_req_t *req = first; req != end; req = req->next) {
+                for (int i = 0; i < req->iovcnt; ++i) {
+                    crc = xsan_protocol_crc32c_update(crc, req->iov[i].iov_base, req->iov[i].iov_len);
+                }
+            }
+            frame.checksum = xsan_protocol_crc32c_final(crc);
+            xsan_protocol_v2_frame_header_encode(&frame, first->frame_buf);
+        }
+        XSAN_LOG_TRACE("Framed %u messages (%u bytes) to %s.", frame.num_msgs, frame.frame_length, conn_ctx->peer_addr_str);
+        conn_ctx->send_unframed = end;
+    }
 }
 
-// Generic socket event callback for established connections (server-side accepted, or client-side after connect)
+/**
+ * Writes as much of the admitted part of the send queue as the socket accepts, one writev per
+ * batch of up to XSAN_COMM_MAX_SEND_IOVS iovecs. Fully written requests are unlinked in order and
+ * returned through done_out for the caller to complete. Returns 0, or a negative errno on a socket error.
+ */
+static int _xsan_comm_flush_send_queue(xsan_connection_ctx_t *conn_ctx, xsan_comm_send_req_t **done_out) {
+    xsan_comm_send_req_t *done_head = NULL;
+    xsan_comm_send_req_t **done_tail = &done_head;
+    int rc = 0;
+
+    _xsan_comm_admit_send_queue(conn_ctx);
+    _xsan_comm_frame_send_queue(conn_ctx);
+    if (_xsan_comm_queue_credit_grant(conn_ctx)) _xsan_comm_frame_send_queue(conn_ctx);
+    while (conn_ctx->send_queue_head && conn_ctx->send_queue_head != conn_ctx->send_uncredited) {
+        struct iovec iov[XSAN_COMM_MAX_SEND_IOVS];
+        int iovcnt = 0;
+        size_t batch_len = 0;
+        for (xsan_comm_send_req_t *req = conn_ctx->send_queue_head;
+             req && req != conn_ctx->send_uncredited && iovcnt < XSAN_COMM_MAX_SEND_IOVS; req = req->next) {
+            size_t skip = req->bytes_sent; // Resume a partially written message mid-iovec
+            for (int i = 0; i < req->iovcnt && iovcnt < XSAN_COMM_MAX_SEND_IOVS; ++i) {
+                if (skip >= req->iov[i].iov_len) { skip -= req->iov[i].iov_len; continue; }
+                iov[iovcnt].iov_base = (unsigned char *)req->iov[i].iov_base + skip;
+                iov[iovcnt].iov_len = req->iov[i].iov_len - skip;
+                batch_len += iov[iovcnt].iov_len;
+                iovcnt++;
+                skip = 0;
+            }
+        }
+
+        ssize_t written = spdk_sock_writev(conn_ctx->sock, iov, iovcnt);
+        if (written < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) rc = -errno;
+            break;
+        }
+
+        size_t left = (size_t)written;
+        while (left > 0 && conn_ctx->send_queue_head) {
+            xsan_comm_send_req_t *req = conn_ctx->send_queue_head;
+            size_t remaining = req->total_len - req->bytes_sent;
+            if (left < remaining) {
+                req->bytes_sent += left;
+                break;
+            }
+            left -= remaining;
+            req->bytes_sent = req->total_len;
+            conn_ctx->send_queue_head = req->next;
+            if (!conn_ctx->send_queue_head) conn_ctx->send_queue_tail = NULL;
+            if (conn_ctx->send_admitted_tail == req) conn_ctx->send_admitted_tail = NULL;
+            conn_ctx->send_queue_depth--;
+            req->next = NULL;
+            *done_tail = req;
+            done_tail = &req->next;
+        }
+        XSAN_LOG_TRACE("writev of %d iovecs to %s: %zd of %zu bytes.", iovcnt, conn_ctx->peer_addr_str, written, batch_len);
+        if ((size_t)written < batch_len) break; // Send buffer full; the poller resumes from bytes_sent
+    }
+
+    *done_out = done_head;
+    return rc;
+}
+
+static void _xsan_comm_flush_msg_fn(void *arg) {
+    xsan_connection_ctx_t *conn_ctx = (xsan_connection_ctx_t *)arg;
+    conn_ctx->flush_scheduled = false;
+    if (conn_ctx->closing) {
+        if (!conn_ctx->rx_active) _free_connection_ctx(conn_ctx);
+        return;
+    }
+
+    xsan_comm_send_req_t *sent = NULL;
+    xsan_comm_send_req_t *failed = NULL;
+    int rc = _xsan_comm_flush_send_queue(conn_ctx, &sent);
+    if (rc != 0) {
+        // A partially written message leaves the stream unframeable; drop the connection.
+        XSAN_LOG_ERROR("spdk_sock_writev failed for %s: %d (%s). Closing.", conn_ctx->peer_addr_str, -rc, strerror(-rc));
+        failed = _xsan_comm_detach_send_queue(conn_ctx);
+        _remove_connection_from_active_list(conn_ctx);
+        _cleanup_and_free_connection_ctx(conn_ctx, true);
+    }
+    // Callbacks last: they may queue more sends or disconnect this connection.
+    _xsan_comm_complete_send_reqs(sent, 0);
+    _xsan_comm_complete_send_reqs(failed, rc);
+}
+
+// Creates the context for an accepted socket on the given (local) reactor and starts polling it.
+static void _xsan_comm_adopt_sock(xsan_comm_reactor_t *reactor, struct spdk_sock *sock) {
+    xsan_connection_ctx_t *conn_ctx = _create_connection_ctx(reactor, sock,
+                                                             g_node_comm_ctx.global_app_msg_handler_cb,
+                                                             g_node_comm_ctx.global_app_msg_handler_cb_arg);
+    if (!conn_ctx) {
+        XSAN_LOG_ERROR("Failed to create conn_ctx for accepted socket. Closing.");
+        spdk_sock_close(&sock);
+        return;
+    }
+    if (_xsan_comm_connection_established(conn_ctx) != XSAN_OK) {
+        _cleanup_and_free_connection_ctx(conn_ctx, true);
+        return;
+    }
+    _xsan_comm_poll_wake(reactor);
+}
+
+// Runs on the reactor chosen for an accepted socket.
+static void _xsan_comm_adopt_sock_msg_fn(void *arg) {
+    struct spdk_sock *sock = (struct spdk_sock *)arg;
+    xsan_comm_reactor_t *reactor = g_node_comm_ctx.module_initialized ? _xsan_comm_find_local_reactor() : NULL;
+    if (!reactor) {
+        XSAN_LOG_WARN("Accepted socket %p arrived at a stopped reactor. Closing.", sock);
+        spdk_sock_close(&sock);
+        return;
+    }
+    _xsan_comm_adopt_sock(reactor, sock);
+}
+
+// Accepts every pending connection and hands each to the next reactor in turn.
+static void _xsan_comm_accept_connections(void) {
+    struct spdk_sock *new_data_sock;
+    while ((new_data_sock = spdk_sock_accept(g_node_comm_ctx.listener_sock)) != NULL) {
+        xsan_comm_reactor_t *target = _xsan_comm_pick_accept_reactor();
+        XSAN_LOG_INFO("Incoming connection on listener socket, assigned to core %u.", target ? target->core : 0);
+        if (target && target != g_node_comm_ctx.listener_reactor &&
+            spdk_thread_send_msg(target->thread, _xsan_comm_adopt_sock_msg_fn, new_data_sock) == 0) {
+            continue;
+        }
+        _xsan_comm_adopt_sock(g_node_comm_ctx.listener_reactor, new_data_sock);
+    }
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        XSAN_LOG_ERROR("spdk_sock_accept failed. Errno: %d (%s)", errno, strerror(errno));
+    }
+}
+
+// Sock group callback: the listener has connections to accept, or a connection has data to read.
 static void _xsan_comm_sock_event_callback(void *cb_arg, struct spdk_sock_group *group, struct spdk_sock *sock) {
     (void)group;
-    xsan_connection_ctx_t *conn_ctx = (xsan_connection_ctx_t *)cb_arg; // This is now always xsan_connection_ctx_t
-
     if (sock == g_node_comm_ctx.listener_sock) {
-        XSAN_LOG_INFO("Incoming connection on listener socket.");
-        struct spdk_sock *new_data_sock = spdk_sock_accept(g_node_comm_ctx.listener_sock);
-        if (new_data_sock) {
-            xsan_connection_ctx_t *new_conn_ctx = _create_connection_ctx(new_data_sock,
-                                                                       g_node_comm_ctx.global_app_msg_handler_cb,
-                                                                       g_node_comm_ctx.global_app_msg_handler_cb_arg);
-            if (new_conn_ctx) {
-                _add_connection_to_active_list(new_conn_ctx);
-            } else {
-                XSAN_LOG_ERROR("Failed to create conn_ctx for accepted socket. Closing.");
-                spdk_sock_close(&new_data_sock);
-            }
-        } else { XSAN_LOG_ERROR("spdk_sock_accept failed. Errno: %d (%s)", errno, strerror(errno)); }
+        _xsan_comm_accept_connections();
         return;
     }
 
+    xsan_connection_ctx_t *conn_ctx = (xsan_connection_ctx_t *)cb_arg;
     if (!conn_ctx) {
         XSAN_LOG_ERROR("Socket event for non-listener sock %p with NULL conn_ctx! This is a bug.", sock);
         return;
     }
+    _process_received_data_for_connection(conn_ctx);
+}
 
-    XSAN_LOG_DEBUG("Socket event on %s (sock %p)", conn_ctx->peer_addr_str, sock);
-    // 事件处理逻辑改为在 poller中处理 socket 状态
+// --- Receive Path ---
+
+static xsan_comm_rx_buf_t *_xsan_comm_rx_buf_get(size_t size) {
+    xsan_comm_rx_buf_t *buf = NULL;
+    if (size <= XSAN_COMM_RX_POOL_BUF_SIZE) {
+        pthread_mutex_lock(&g_rx_buf_pool.lock);
+        buf = g_rx_buf_pool.free_list;
+        if (buf) {
+            g_rx_buf_pool.free_list = buf->next;
+            g_rx_buf_pool.num_cached--;
+        }
+        pthread_mutex_unlock(&g_rx_buf_pool.lock);
+        if (buf) return buf;
+    }
+    buf = (xsan_comm_rx_buf_t *)XSAN_MALLOC(sizeof(xsan_comm_rx_buf_t));
+    if (!buf) return NULL;
+    buf->next = NULL;
+    buf->credit.acct = NULL;
+    buf->pooled = (size <= XSAN_COMM_RX_POOL_BUF_SIZE);
+    buf->base = (unsigned char *)spdk_dma_malloc(buf->pooled ? XSAN_COMM_RX_POOL_BUF_SIZE : size, XSAN_COMM_RX_DATA_ALIGN, NULL);
+    if (!buf->base) {
+        XSAN_FREE(buf);
+        return NULL;
+    }
+    return buf;
 }
 
-static void _process_received_data_for_connection(xsan_connection_ctx_t *conn_ctx) {
-    if (!conn_ctx || !conn_ctx->sock) return;
-    XSAN_LOG_DEBUG("Processing received data for %s (sock %p)", conn_ctx->peer_addr_str, conn_ctx->sock);
+static void _xsan_comm_rx_buf_put(xsan_comm_rx_buf_t *buf) {
+    if (!buf) return;
+    xsan_comm_credit_rx_release(&buf->credit);
+    if (buf->pooled) {
+        pthread_mutex_lock(&g_rx_buf_pool.lock);
+        if (g_rx_buf_pool.num_cached < XSAN_COMM_RX_POOL_MAX_CACHED) {
+            buf->next = g_rx_buf_pool.free_list;
+            g_rx_buf_pool.free_list = buf;
+            g_rx_buf_pool.num_cached++;
+            buf = NULL;
+        }
+        pthread_mutex_unlock(&g_rx_buf_pool.lock);
+        if (!buf) return;
+    }
+    spdk_dma_free(buf->base);
+    XSAN_FREE(buf);
+}
 
-    ssize_t nbytes;
-    do {
-        if (conn_ctx->recv_buf_len == conn_ctx->recv_buf_capacity) {
-            size_t new_capacity = conn_ctx->recv_buf_capacity > 0 ? conn_ctx->recv_buf_capacity * 2 : XSAN_COMM_INITIAL_RECV_BUF_SIZE;
-            if (new_capacity > (XSAN_PROTOCOL_MAX_PAYLOAD_SIZE + XSAN_MESSAGE_HEADER_SIZE + 4096)) {
-                 XSAN_LOG_ERROR("Receive buffer for %s reached excessive size %zu. Closing.", conn_ctx->peer_addr_str, new_capacity);
-                 goto close_conn_error_proc_recv;
-            }
-            unsigned char *new_buf = (unsigned char *)XSAN_REALLOC(conn_ctx->recv_buf, new_capacity);
-            if (!new_buf) { XSAN_LOG_ERROR("Failed to realloc recv_buf for %s. Closing.", conn_ctx->peer_addr_str); goto close_conn_error_proc_recv; }
-            conn_ctx->recv_buf = new_buf; conn_ctx->recv_buf_capacity = new_capacity;
+static void _xsan_comm_rx_pool_drain(void) {
+    pthread_mutex_lock(&g_rx_buf_pool.lock);
+    xsan_comm_rx_buf_t *list = g_rx_buf_pool.free_list;
+    g_rx_buf_pool.free_list = NULL;
+    g_rx_buf_pool.num_cached = 0;
+    pthread_mutex_unlock(&g_rx_buf_pool.lock);
+    while (list) {
+        xsan_comm_rx_buf_t *buf = list;
+        list = buf->next;
+        spdk_dma_free(buf->base);
+        XSAN_FREE(buf);
+    }
+}
+
+// xsan_message_payload_free_fn_t for payloads received into pool buffers.
+static void _xsan_comm_rx_payload_free(void *payload, void *arg) {
+    (void)payload;
+    _xsan_comm_rx_buf_put((xsan_comm_rx_buf_t *)arg);
+}
+
+// xsan_message_payload_free_fn_t for small payloads received on the heap.
+static void _xsan_comm_rx_heap_payload_free(void *payload, void *arg) {
+    (void)payload;
+    xsan_comm_rx_heap_hdr_t *hdr = (xsan_comm_rx_heap_hdr_t *)arg;
+    xsan_comm_credit_rx_release(&hdr->credit);
+    XSAN_FREE(hdr);
+}
+
+static inline uint32_t _xsan_comm_rx_ring_used(const xsan_connection_ctx_t *conn_ctx) {
+    return conn_ctx->rx_ring_tail - conn_ctx->rx_ring_head;
+}
+
+// Copies len bytes (which must be available) out of the ring without consuming them.
+static void _xsan_comm_rx_ring_peek(const xsan_connection_ctx_t *conn_ctx, unsigned char *dst, uint32_t len) {
+    uint32_t off = conn_ctx->rx_ring_head & (XSAN_COMM_RX_RING_SIZE - 1);
+    uint32_t first = XSAN_COMM_RX_RING_SIZE - off;
+    if (first > len) first = len;
+    memcpy(dst, conn_ctx->rx_ring + off, first);
+    if (len > first) memcpy(dst + first, conn_ctx->rx_ring, len - first);
+}
+
+// Copies len bytes (which must be available) out of the ring and consumes them.
+static void _xsan_comm_rx_ring_read(xsan_connection_ctx_t *conn_ctx, unsigned char *dst, uint32_t len) {
+    _xsan_comm_rx_ring_peek(conn_ctx, dst, len);
+    conn_ctx->rx_ring_head += len;
+}
+
+// Fills the free part of the ring with one readv (two iovecs when the free space wraps).
+static ssize_t _xsan_comm_rx_ring_fill(xsan_connection_ctx_t *conn_ctx) {
+    if (_xsan_comm_rx_ring_used(conn_ctx) == 0) {
+        conn_ctx->rx_ring_head = conn_ctx->rx_ring_tail = 0; // Keep the next header contiguous
+    }
+    uint32_t free_bytes = XSAN_COMM_RX_RING_SIZE - _xsan_comm_rx_ring_used(conn_ctx);
+    uint32_t off = conn_ctx->rx_ring_tail & (XSAN_COMM_RX_RING_SIZE - 1);
+    uint32_t first = XSAN_COMM_RX_RING_SIZE - off;
+    if (first > free_bytes) first = free_bytes;
+    struct iovec iov[2];
+    int iovcnt = 1;
+    iov[0].iov_base = conn_ctx->rx_ring + off;
+    iov[0].iov_len = first;
+    if (free_bytes > first) {
+        iov[1].iov_base = conn_ctx->rx_ring;
+        iov[1].iov_len = free_bytes - first;
+        iovcnt = 2;
+    }
+    ssize_t nbytes = spdk_sock_readv(conn_ctx->sock, iov, iovcnt);
+    if (nbytes > 0) conn_ctx->rx_ring_tail += (uint32_t)nbytes;
+    return nbytes;
+}
+
+/**
+ * Allocates the destination for the payload announced by rx_header. Payloads carrying block
+ * data, and any payload too large to copy cheaply, go into a DMA buffer placed so that the
+ * block data starts on an XSAN_COMM_RX_DATA_ALIGN boundary. Small payloads use the heap, behind
+ * a header that carries their flow-control credit.
+ */
+static xsan_error_t _xsan_comm_rx_alloc_payload(xsan_connection_ctx_t *conn_ctx) {
+    uint32_t len = conn_ctx->rx_header.payload_length;
+    uint32_t data_off = xsan_protocol_payload_data_offset((xsan_message_type_t)conn_ctx->rx_header.type);
+    if (data_off == 0 && len <= XSAN_COMM_RX_SMALL_PAYLOAD) {
+        xsan_comm_rx_heap_hdr_t *hdr = (xsan_comm_rx_heap_hdr_t *)XSAN_MALLOC(sizeof(xsan_comm_rx_heap_hdr_t) + len);
+        if (!hdr) return XSAN_ERROR_NO_MEMORY;
+        hdr->credit.acct = NULL;
+        conn_ctx->rx_buf = NULL;
+        conn_ctx->rx_payload = (unsigned char *)(hdr + 1);
+        return XSAN_OK;
+    }
+    uint32_t lead = data_off ? (XSAN_COMM_RX_DATA_ALIGN - data_off % XSAN_COMM_RX_DATA_ALIGN) % XSAN_COMM_RX_DATA_ALIGN : 0;
+    conn_ctx->rx_buf = _xsan_comm_rx_buf_get((size_t)lead + len);
+    if (!conn_ctx->rx_buf) return XSAN_ERROR_NO_MEMORY;
+    conn_ctx->rx_payload = conn_ctx->rx_buf->base + lead;
+    return XSAN_OK;
+}
+
+/**
+ * Replaces a received LZ4 payload (in rx_zbuf) with its decompressed contents, in a buffer
+ * allocated as if the payload had arrived uncompressed.
+ */
+static xsan_error_t _xsan_comm_rx_inflate(xsan_connection_ctx_t *conn_ctx) {
+    unsigned char *zbuf = conn_ctx->rx_zbuf;
+    uint32_t zlen = conn_ctx->rx_header.payload_length, raw_len = 0;
+    conn_ctx->rx_zbuf = NULL;
+    conn_ctx->rx_payload = NULL;
+    conn_ctx->rx_msg_flags = 0;
+
+    xsan_error_t err = XSAN_ERROR_NETWORK;
+    if (zlen > XSAN_PROTOCOL_V2_LZ4_PREFIX_SIZE) {
+        memcpy(&raw_len, zbuf, XSAN_PROTOCOL_V2_LZ4_PREFIX_SIZE);
+        raw_len = le32toh(raw_len);
+    }
+    if (raw_len == 0 || raw_len > XSAN_PROTOCOL_MAX_PAYLOAD_SIZE) {
+        XSAN_LOG_ERROR("Compressed payload of %u bytes from %s claims %u bytes uncompressed. Closing.", zlen, conn_ctx->peer_addr_str, raw_len);
+        goto out;
+    }
+    conn_ctx->rx_header.payload_length = raw_len;
+    err = _xsan_comm_rx_alloc_payload(conn_ctx);
+    if (err != XSAN_OK) {
+        XSAN_LOG_ERROR("OOM for %u-byte decompressed payload from %s. Closing.", raw_len, conn_ctx->peer_addr_str);
+        goto out;
+    }
+    uint64_t start = spdk_get_ticks();
+    err = xsan_decompress_lz4(zbuf + XSAN_PROTOCOL_V2_LZ4_PREFIX_SIZE, zlen - XSAN_PROTOCOL_V2_LZ4_PREFIX_SIZE,
+                              conn_ctx->rx_payload, raw_len);
+    xsan_comm_reactor_t *reactor = conn_ctx->reactor;
+    reactor->decompress_ticks += spdk_get_ticks() - start;
+    if (err != XSAN_OK) {
+        XSAN_LOG_ERROR("Failed to decompress %u-byte payload from %s: %s. Closing.", zlen, conn_ctx->peer_addr_str, xsan_error_string(err));
+        goto out;
+    }
+    reactor->compress_stats.rx_decompressed_msgs++;
+    reactor->compress_stats.rx_wire_bytes += zlen;
+    reactor->compress_stats.rx_raw_bytes += raw_len;
+out:
+    XSAN_FREE(zbuf);
+    return err;
+}
+
+// Applies a peer's handshake to the connection: the common features and protocol version.
+static void _xsan_comm_handle_features(xsan_connection_ctx_t *conn_ctx, const xsan_message_t *msg) {
+    uint32_t len = msg->header.payload_length;
+    if (len < XSAN_COMM_FEATURES_V1_PAYLOAD_SIZE || !msg->payload) {
+        XSAN_LOG_WARN("Short feature advertisement (%u bytes) from %s ignored.", len, conn_ctx->peer_addr_str);
+        return;
+    }
+    xsan_comm_features_payload_t pl;
+    memset(&pl, 0, sizeof(pl));
+    memcpy(&pl, msg->payload, len < sizeof(pl) ? len : sizeof(pl));
+    uint16_t peer_version = (len >= sizeof(pl)) ? ntohs(pl.max_version) : XSAN_PROTOCOL_VERSION_1;
+    conn_ctx->peer_features = ntohl(pl.features);
+    uint32_t common = g_node_comm_ctx.local_features & conn_ctx->peer_features;
+    conn_ctx->crc32c_tx = (common & XSAN_COMM_FEATURE_CRC32C) != 0;
+    conn_ctx->frame_batching_tx = (common & XSAN_COMM_FEATURE_FRAME_BATCHING) != 0;
+    conn_ctx->lz4_tx = (common & XSAN_COMM_FEATURE_LZ4) != 0;
+    if ((common & XSAN_COMM_FEATURE_FLOW_CONTROL) && !conn_ctx->flow_control) {
+        // Messages already queued or received were sent without credit; they are counted but
+        // never held back. The first grant goes out with the next flush.
+        conn_ctx->flow_control = true;
+        conn_ctx->rx_credit.window_bytes = g_node_comm_ctx.flow_window_bytes;
+        conn_ctx->rx_credit.window_msgs = g_node_comm_ctx.flow_window_msgs;
+        _xsan_comm_schedule_flush(conn_ctx);
+    }
+    // Only ever upgrade: messages already queued in the current format must stay in it.
+    uint16_t version = peer_version < g_node_comm_ctx.local_max_version ? peer_version : g_node_comm_ctx.local_max_version;
+    if (version > conn_ctx->tx_version) conn_ctx->tx_version = version;
+    XSAN_LOG_INFO("Peer %s speaks protocol v%u, features 0x%x; sending v%u, CRC32C %s, frame batching %s, flow control %s, LZ4 %s.",
+                  conn_ctx->peer_addr_str, peer_version, conn_ctx->peer_features, conn_ctx->tx_version,
+                  conn_ctx->crc32c_tx ? "enabled" : "disabled", conn_ctx->frame_batching_tx ? "enabled" : "disabled",
+                  conn_ctx->flow_control ? "enabled" : "disabled",
+                  (conn_ctx->lz4_tx && conn_ctx->tx_version >= XSAN_PROTOCOL_VERSION_2) ? "enabled" : "disabled");
+}
+
+// Starts polling a new connection on its reactor and sends this node's handshake on it (as v1,
+// which every peer understands).
+static xsan_error_t _xsan_comm_connection_established(xsan_connection_ctx_t *conn_ctx) {
+    if (spdk_sock_group_add_sock(conn_ctx->reactor->sock_group, conn_ctx->sock, _xsan_comm_sock_event_callback, conn_ctx) != 0) {
+        XSAN_LOG_ERROR("Failed to add %s to the sock group on core %u: %d (%s).", conn_ctx->peer_addr_str,
+                       conn_ctx->reactor->core, errno, strerror(errno));
+        return XSAN_ERROR_NETWORK;
+    }
+    conn_ctx->in_sock_group = true;
+    _add_connection_to_active_list(conn_ctx);
+    xsan_comm_features_payload_t pl;
+    pl.features = htonl(g_node_comm_ctx.local_features);
+    pl.max_version = htons(g_node_comm_ctx.local_max_version);
+    pl.reserved = 0;
+    xsan_message_t *msg = xsan_protocol_message_create(XSAN_MSG_TYPE_COMM_FEATURES, 0, &pl, sizeof(pl));
+    if (!msg || _xsan_comm_enqueue_msg(conn_ctx, msg, _xsan_comm_control_msg_sent_cb, msg) != XSAN_OK) {
+        // Without an advertisement the peer never enables optional features; the connection still works.
+        XSAN_LOG_WARN("Failed to advertise features to %s.", conn_ctx->peer_addr_str);
+        if (msg) xsan_protocol_message_destroy(msg);
+    }
+    return XSAN_OK;
+}
+
+// Moves the completed message out of the receive state; the payload buffer moves into the message.
+static xsan_message_t *_xsan_comm_rx_take_msg(xsan_connection_ctx_t *conn_ctx) {
+    xsan_message_t *full_msg = (xsan_message_t *)XSAN_MALLOC(sizeof(xsan_message_t));
+    if (!full_msg) { XSAN_LOG_ERROR("OOM for xsan_message_t from %s. Closing.", conn_ctx->peer_addr_str); return NULL; }
+    memcpy(&full_msg->header, &conn_ctx->rx_header, sizeof(xsan_message_header_t));
+    full_msg->payload = conn_ctx->rx_payload;
+    full_msg->payload_is_dma = (conn_ctx->rx_buf != NULL);
+    xsan_comm_rx_credit_t *credit = NULL;
+    if (conn_ctx->rx_buf) {
+        full_msg->payload_free = _xsan_comm_rx_payload_free;
+        full_msg->payload_free_arg = conn_ctx->rx_buf;
+        credit = &conn_ctx->rx_buf->credit;
+    } else if (conn_ctx->rx_payload) {
+        xsan_comm_rx_heap_hdr_t *hdr = (xsan_comm_rx_heap_hdr_t *)conn_ctx->rx_payload - 1;
+        full_msg->payload_free = _xsan_comm_rx_heap_payload_free;
+        full_msg->payload_free_arg = hdr;
+        credit = &hdr->credit;
+    } else {
+        full_msg->payload_free = NULL;
+        full_msg->payload_free_arg = NULL;
+    }
+    _xsan_comm_rx_charge(conn_ctx, &full_msg->header, credit);
+    conn_ctx->rx_buf = NULL;
+    conn_ctx->rx_payload = NULL;
+    conn_ctx->rx_payload_received = 0;
+    conn_ctx->rx_state = XSAN_COMM_RX_HEADER;
+    return full_msg;
+}
+
+// Hands a received message to its handler, which takes ownership of it.
+static void _xsan_comm_rx_deliver(xsan_connection_ctx_t *conn_ctx, xsan_message_t *full_msg) {
+    XSAN_LOG_DEBUG("Full msg (Type: %u, TID: %lu) from %s. Dispatching...",
+                   full_msg->header.type, full_msg->header.transaction_id, conn_ctx->peer_addr_str);
+
+    xsan_message_type_t msg_type = (xsan_message_type_t)full_msg->header.type;
+    if (msg_type == XSAN_MSG_TYPE_COMM_FEATURES) {
+        _xsan_comm_handle_features(conn_ctx, full_msg);
+        xsan_protocol_message_destroy(full_msg);
+    } else if (msg_type == XSAN_MSG_TYPE_COMM_CREDIT) {
+        _xsan_comm_handle_credit(conn_ctx, full_msg);
+        xsan_protocol_message_destroy(full_msg);
+    } else if (msg_type > XSAN_MSG_TYPE_UNDEFINED && msg_type < XSAN_MSG_TYPE_MAX &&
+        g_node_comm_ctx.specific_handlers[msg_type] != NULL) {
+        g_node_comm_ctx.specific_handlers[msg_type](conn_ctx, full_msg, g_node_comm_ctx.specific_handler_args[msg_type]);
+    } else if (conn_ctx->app_msg_handler_cb) {
+        XSAN_LOG_WARN("No specific handler for msg type %u from %s. Using generic handler.", msg_type, conn_ctx->peer_addr_str);
+        conn_ctx->app_msg_handler_cb(conn_ctx->sock, conn_ctx->peer_addr_str, full_msg, conn_ctx->app_msg_handler_cb_arg);
+    } else {
+        XSAN_LOG_ERROR("No specific or generic handler for msg type %u from %s. Discarding.", msg_type, conn_ctx->peer_addr_str);
+        xsan_protocol_message_destroy(full_msg);
+    }
+}
+
+// Verifies a fully received v2 frame and delivers its messages in order.
+static xsan_error_t _xsan_comm_rx_frame_complete(xsan_connection_ctx_t *conn_ctx) {
+    // Copied out: a handler may close the connection, which releases the held messages.
+    xsan_message_t *msgs[XSAN_PROTOCOL_V2_MAX_FRAME_MSGS];
+    uint16_t n = conn_ctx->rx_frame_num_held;
+    memcpy(msgs, conn_ctx->rx_frame_msgs, sizeof(msgs[0]) * n);
+    conn_ctx->rx_frame_num_held = 0;
+
+    xsan_error_t err = XSAN_OK;
+    if (conn_ctx->rx_frame_bytes_left != 0) {
+        XSAN_LOG_ERROR("Frame from %s has %u bytes beyond its messages. Closing.", conn_ctx->peer_addr_str, conn_ctx->rx_frame_bytes_left);
+        err = XSAN_ERROR_NETWORK;
+    } else if (conn_ctx->rx_frame_checksum != 0 &&
+               xsan_protocol_crc32c_final(conn_ctx->rx_frame_crc) != conn_ctx->rx_frame_checksum) {
+        XSAN_LOG_ERROR("CRC32C mismatch on %u-message frame from %s. Closing.", n, conn_ctx->peer_addr_str);
+        err = XSAN_ERROR_NETWORK;
+    }
+    if (err != XSAN_OK) {
+        for (uint16_t i = 0; i < n; ++i) xsan_protocol_message_destroy(msgs[i]);
+        return err;
+    }
+    uint16_t i = 0;
+    // rx_active keeps the context alive across handlers; once one closes it, drop the rest.
+    for (; i < n && !conn_ctx->closing; ++i) _xsan_comm_rx_deliver(conn_ctx, msgs[i]);
+    for (; i < n; ++i) xsan_protocol_message_destroy(msgs[i]);
+    return XSAN_OK;
+}
+
+// Completes the message whose payload has been received: v1 messages are verified and delivered
+// at once, messages of a v2 frame are held until the frame is complete.
+static xsan_error_t _xsan_comm_rx_dispatch(xsan_connection_ctx_t *conn_ctx) {
+    if (conn_ctx->rx_frame_msgs_left > 0) {
+        if (conn_ctx->rx_frame_checksum != 0) {
+            conn_ctx->rx_frame_crc = xsan_protocol_crc32c_update(conn_ctx->rx_frame_crc, conn_ctx->rx_payload,
+                                                                 conn_ctx->rx_header.payload_length);
+        }
+        if ((conn_ctx->rx_msg_flags & XSAN_PROTOCOL_V2_MSG_FLAG_LZ4) && _xsan_comm_rx_inflate(conn_ctx) != XSAN_OK) {
+            return XSAN_ERROR_NETWORK;
         }
+        xsan_message_t *full_msg = _xsan_comm_rx_take_msg(conn_ctx);
+        if (!full_msg) return XSAN_ERROR_NO_MEMORY;
+        conn_ctx->rx_frame_msgs[conn_ctx->rx_frame_num_held++] = full_msg;
+        if (--conn_ctx->rx_frame_msgs_left > 0) return XSAN_OK;
+        return _xsan_comm_rx_frame_complete(conn_ctx);
+    }
 
-        nbytes = spdk_sock_recv(conn_ctx->sock,
-                                conn_ctx->recv_buf + conn_ctx->recv_buf_len,
-                                conn_ctx->recv_buf_capacity - conn_ctx->recv_buf_len);
-
-        if (nbytes > 0) {
-            XSAN_LOG_TRACE("Read %zd bytes from %s", nbytes, conn_ctx->peer_addr_str);
-            conn_ctx->recv_buf_len += nbytes;
-
-            while(conn_ctx->recv_buf_len > 0) {
-                if (!conn_ctx->header_fully_received) {
-                    if (conn_ctx->recv_buf_len >= XSAN_MESSAGE_HEADER_SIZE) {
-                        xsan_error_t err_hdr = xsan_protocol_header_deserialize(conn_ctx->recv_buf, &conn_ctx->partial_recv_header);
-                        if (err_hdr != XSAN_OK) { XSAN_LOG_ERROR("Header deserialize failed from %s: %s. Closing.", conn_ctx->peer_addr_str, xsan_error_string(err_hdr)); goto close_conn_error_proc_recv;}
-                        if (conn_ctx->partial_recv_header.magic != XSAN_PROTOCOL_MAGIC) { XSAN_LOG_ERROR("Bad magic 0x%x from %s. Closing.", conn_ctx->partial_recv_header.magic, conn_ctx->peer_addr_str); goto close_conn_error_proc_recv;}
-                        if (conn_ctx->partial_recv_header.payload_length > XSAN_PROTOCOL_MAX_PAYLOAD_SIZE) { XSAN_LOG_ERROR("Payload %u too large from %s. Closing.", conn_ctx->partial_recv_header.payload_length, conn_ctx->peer_addr_str); goto close_conn_error_proc_recv;}
-
-                        conn_ctx->header_fully_received = true;
-                        memmove(conn_ctx->recv_buf, conn_ctx->recv_buf + XSAN_MESSAGE_HEADER_SIZE, conn_ctx->recv_buf_len - XSAN_MESSAGE_HEADER_SIZE);
-                        conn_ctx->recv_buf_len -= XSAN_MESSAGE_HEADER_SIZE;
-                        XSAN_LOG_TRACE("Header from %s. Type: %u, PayloadLen: %u", conn_ctx->peer_addr_str, conn_ctx->partial_recv_header.type, conn_ctx->partial_recv_header.payload_length);
-                    } else break;
-                }
+    // Any checksummed message is verified, whether or not CRC32C was negotiated for our own sends.
+    if (conn_ctx->rx_header.checksum != 0 &&
+        !xsan_protocol_verify_checksum(&conn_ctx->rx_header, conn_ctx->rx_payload)) {
+        XSAN_LOG_ERROR("CRC32C mismatch on msg type %u (TID %lu, %u bytes) from %s. Closing.",
+                       conn_ctx->rx_header.type, conn_ctx->rx_header.transaction_id,
+                       conn_ctx->rx_header.payload_length, conn_ctx->peer_addr_str);
+        return XSAN_ERROR_NETWORK;
+    }
+    xsan_message_t *full_msg = _xsan_comm_rx_take_msg(conn_ctx);
+    if (!full_msg) return XSAN_ERROR_NO_MEMORY;
+    _xsan_comm_rx_deliver(conn_ctx, full_msg);
+    return XSAN_OK;
+}
+
+static bool _xsan_comm_rx_at_v2_frame(const xsan_connection_ctx_t *conn_ctx) {
+    uint32_t magic;
+    _xsan_comm_rx_ring_peek(conn_ctx, (unsigned char *)&magic, sizeof(magic));
+    return le32toh(magic) == XSAN_PROTOCOL_V2_FRAME_MAGIC;
+}
 
-                if (conn_ctx->header_fully_received) {
-                    if (conn_ctx->recv_buf_len >= conn_ctx->partial_recv_header.payload_length) {
-                        xsan_message_t *full_msg = (xsan_message_t*)XSAN_MALLOC(sizeof(xsan_message_t));
-                        if (!full_msg) { XSAN_LOG_ERROR("OOM for xsan_message_t from %s. Closing.", conn_ctx->peer_addr_str); goto close_conn_error_proc_recv; }
-
-                        memcpy(&full_msg->header, &conn_ctx->partial_recv_header, sizeof(xsan_message_header_t));
-                        if (full_msg->header.payload_length > 0) {
-                            full_msg->payload = (unsigned char *)XSAN_MALLOC(full_msg->header.payload_length);
-                            if (!full_msg->payload) { XSAN_LOG_ERROR("OOM for payload from %s. Closing.", conn_ctx->peer_addr_str); XSAN_FREE(full_msg); goto close_conn_error_proc_recv; }
-                            memcpy(full_msg->payload, conn_ctx->recv_buf, full_msg->header.payload_length);
-                        } else full_msg->payload = NULL;
-
-                        XSAN_LOG_DEBUG("Full msg (Type: %u, TID: %lu) from %s. Dispatching...",
-                                       full_msg->header.type, full_msg->header.transaction_id, conn_ctx->peer_addr_str);
-
-                        xsan_message_type_t msg_type = (xsan_message_type_t)full_msg->header.type;
-                        if (msg_type > XSAN_MSG_TYPE_UNDEFINED && msg_type < XSAN_MSG_TYPE_MAX &&
-                            g_node_comm_ctx.specific_handlers[msg_type] != NULL) {
-                            g_node_comm_ctx.specific_handlers[msg_type](conn_ctx, full_msg, g_node_comm_ctx.specific_handler_args[msg_type]);
-                        } else if (conn_ctx->app_msg_handler_cb) {
-                            XSAN_LOG_WARN("No specific handler for msg type %u from %s. Using generic handler.", msg_type, conn_ctx->peer_addr_str);
-                            conn_ctx->app_msg_handler_cb(conn_ctx->sock, conn_ctx->peer_addr_str, full_msg, conn_ctx->app_msg_handler_cb_arg);
-                        } else {
-                            XSAN_LOG_ERROR("No specific or generic handler for msg type %u from %s. Discarding.", msg_type, conn_ctx->peer_addr_str);
-                            xsan_protocol_message_destroy(full_msg);
-                        }
-
-                        memmove(conn_ctx->recv_buf, conn_ctx->recv_buf + full_msg->header.payload_length, conn_ctx->recv_buf_len - full_msg->header.payload_length);
-                        conn_ctx->recv_buf_len -= full_msg->header.payload_length;
-                        conn_ctx->header_fully_received = false;
-                    } else break;
+// Bytes needed at the front of the ring to parse the next header; the first four bytes tell a
+// v2 frame header from a v1 message header.
+static uint32_t _xsan_comm_rx_header_size(const xsan_connection_ctx_t *conn_ctx) {
+    if (conn_ctx->rx_frame_msgs_left > 0) return XSAN_PROTOCOL_V2_MSG_HEADER_SIZE;
+    if (_xsan_comm_rx_ring_used(conn_ctx) < sizeof(uint32_t)) return sizeof(uint32_t);
+    return _xsan_comm_rx_at_v2_frame(conn_ctx) ? XSAN_PROTOCOL_V2_FRAME_HEADER_SIZE : XSAN_MESSAGE_HEADER_SIZE;
+}
+
+static xsan_error_t _xsan_comm_rx_parse_frame_header(xsan_connection_ctx_t *conn_ctx) {
+    unsigned char hdr_buf[XSAN_PROTOCOL_V2_FRAME_HEADER_SIZE];
+    _xsan_comm_rx_ring_read(conn_ctx, hdr_buf, XSAN_PROTOCOL_V2_FRAME_HEADER_SIZE);
+    xsan_protocol_v2_frame_header_t frame;
+    if (xsan_protocol_v2_frame_header_decode(hdr_buf, &frame) != XSAN_OK) {
+        XSAN_LOG_ERROR("Malformed frame header from %s (%u messages, %u bytes). Closing.",
+                       conn_ctx->peer_addr_str, frame.num_msgs, frame.frame_length);
+        return XSAN_ERROR_NETWORK;
+    }
+    conn_ctx->rx_frame_msgs_left = frame.num_msgs;
+    conn_ctx->rx_frame_bytes_left = frame.frame_length;
+    conn_ctx->rx_frame_checksum = frame.checksum;
+    conn_ctx->rx_frame_num_held = 0;
+    if (frame.checksum != 0) {
+        frame.checksum = 0;
+        xsan_protocol_v2_frame_header_encode(&frame, hdr_buf);
+        conn_ctx->rx_frame_crc = xsan_protocol_crc32c_update(XSAN_PROTOCOL_CRC32C_INIT, hdr_buf, sizeof(hdr_buf));
+    }
+    XSAN_LOG_TRACE("Frame from %s: %u messages, %u bytes.", conn_ctx->peer_addr_str, frame.num_msgs, frame.frame_length);
+    return XSAN_OK;
+}
+
+static xsan_error_t _xsan_comm_rx_parse_v2_msg_header(xsan_connection_ctx_t *conn_ctx) {
+    unsigned char hdr_buf[XSAN_PROTOCOL_V2_MSG_HEADER_SIZE];
+    _xsan_comm_rx_ring_read(conn_ctx, hdr_buf, XSAN_PROTOCOL_V2_MSG_HEADER_SIZE);
+    if (conn_ctx->rx_frame_checksum != 0) {
+        conn_ctx->rx_frame_crc = xsan_protocol_crc32c_update(conn_ctx->rx_frame_crc, hdr_buf, sizeof(hdr_buf));
+    }
+    if (xsan_protocol_v2_msg_header_decode(hdr_buf, &conn_ctx->rx_header, &conn_ctx->rx_msg_flags) != XSAN_OK) {
+        XSAN_LOG_ERROR("Payload %u too large from %s. Closing.", conn_ctx->rx_header.payload_length, conn_ctx->peer_addr_str);
+        return XSAN_ERROR_NETWORK;
+    }
+    uint64_t msg_len = (uint64_t)XSAN_PROTOCOL_V2_MSG_HEADER_SIZE + conn_ctx->rx_header.payload_length;
+    if (msg_len > conn_ctx->rx_frame_bytes_left) {
+        XSAN_LOG_ERROR("Message of %lu bytes overruns its frame from %s. Closing.", (unsigned long)msg_len, conn_ctx->peer_addr_str);
+        return XSAN_ERROR_NETWORK;
+    }
+    conn_ctx->rx_frame_bytes_left -= (uint32_t)msg_len;
+    return XSAN_OK;
+}
+
+static xsan_error_t _xsan_comm_rx_parse_v1_header(xsan_connection_ctx_t *conn_ctx) {
+    unsigned char hdr_buf[XSAN_MESSAGE_HEADER_SIZE];
+    _xsan_comm_rx_ring_read(conn_ctx, hdr_buf, XSAN_MESSAGE_HEADER_SIZE);
+    conn_ctx->rx_msg_flags = 0;
+    xsan_error_t err = xsan_protocol_header_deserialize(hdr_buf, &conn_ctx->rx_header);
+    if (err != XSAN_OK) { XSAN_LOG_ERROR("Header deserialize failed from %s: %s. Closing.", conn_ctx->peer_addr_str, xsan_error_string(err)); return err; }
+    if (conn_ctx->rx_header.magic != XSAN_PROTOCOL_MAGIC) { XSAN_LOG_ERROR("Bad magic 0x%x from %s. Closing.", conn_ctx->rx_header.magic, conn_ctx->peer_addr_str); return XSAN_ERROR_GENERIC; }
+    if (conn_ctx->rx_header.payload_length > XSAN_PROTOCOL_MAX_PAYLOAD_SIZE) { XSAN_LOG_ERROR("Payload %u too large from %s. Closing.", conn_ctx->rx_header.payload_length, conn_ctx->peer_addr_str); return XSAN_ERROR_GENERIC; }
+    return XSAN_OK;
+}
+
+// Parses the header at the front of the ring (a v1 message header, a v2 frame header, or a
+// message header inside a v2 frame) and moves whatever payload bytes the ring already holds.
+static xsan_error_t _xsan_comm_rx_parse_header(xsan_connection_ctx_t *conn_ctx) {
+    xsan_error_t err;
+    if (conn_ctx->rx_frame_msgs_left > 0) {
+        err = _xsan_comm_rx_parse_v2_msg_header(conn_ctx);
+    } else if (_xsan_comm_rx_at_v2_frame(conn_ctx)) {
+        return _xsan_comm_rx_parse_frame_header(conn_ctx); // Its first message header follows
+    } else {
+        err = _xsan_comm_rx_parse_v1_header(conn_ctx);
+    }
+    if (err != XSAN_OK) return err;
+    XSAN_LOG_TRACE("Header from %s. Type: %u, PayloadLen: %u", conn_ctx->peer_addr_str, conn_ctx->rx_header.type, conn_ctx->rx_header.payload_length);
+
+    uint32_t len = conn_ctx->rx_header.payload_length;
+    conn_ctx->rx_payload = NULL;
+    conn_ctx->rx_buf = NULL;
+    conn_ctx->rx_payload_received = 0;
+    if (len == 0) return _xsan_comm_rx_dispatch(conn_ctx);
+
+    if (conn_ctx->rx_msg_flags & XSAN_PROTOCOL_V2_MSG_FLAG_LZ4) {
+        // Received as is, then decompressed into a properly placed buffer once complete
+        conn_ctx->rx_zbuf = (unsigned char *)XSAN_MALLOC(len);
+        conn_ctx->rx_payload = conn_ctx->rx_zbuf;
+        err = conn_ctx->rx_zbuf ? XSAN_OK : XSAN_ERROR_NO_MEMORY;
+    } else {
+        err = _xsan_comm_rx_alloc_payload(conn_ctx);
+    }
+    if (err != XSAN_OK) { XSAN_LOG_ERROR("OOM for %u-byte payload from %s. Closing.", len, conn_ctx->peer_addr_str); return err; }
+    uint32_t buffered = _xsan_comm_rx_ring_used(conn_ctx);
+    if (buffered > len) buffered = len;
+    _xsan_comm_rx_ring_read(conn_ctx, conn_ctx->rx_payload, buffered);
+    conn_ctx->rx_payload_received = buffered;
+    if (buffered == len) return _xsan_comm_rx_dispatch(conn_ctx);
+    conn_ctx->rx_state = XSAN_COMM_RX_PAYLOAD; // The ring is empty now; the rest arrives in place
+    return XSAN_OK;
+}
+
+// Receives and dispatches everything the socket has. Handlers may close the connection; the
+// context stays allocated (closing set) until this returns, and nothing is parsed after that.
+static void _xsan_comm_rx_process(xsan_connection_ctx_t *conn_ctx) {
+    for (;;) {
+        if (conn_ctx->closing) return;
+        ssize_t nbytes;
+        if (conn_ctx->rx_state == XSAN_COMM_RX_PAYLOAD) {
+            uint32_t want = conn_ctx->rx_header.payload_length - conn_ctx->rx_payload_received;
+            nbytes = spdk_sock_recv(conn_ctx->sock, conn_ctx->rx_payload + conn_ctx->rx_payload_received, want);
+            if (nbytes > 0) {
+                XSAN_LOG_TRACE("Read %zd payload bytes from %s", nbytes, conn_ctx->peer_addr_str);
+                conn_ctx->rx_payload_received += (uint32_t)nbytes;
+                if (conn_ctx->rx_payload_received == conn_ctx->rx_header.payload_length &&
+                    _xsan_comm_rx_dispatch(conn_ctx) != XSAN_OK) {
+                    goto close_conn_error_proc_recv;
                 }
+                continue;
+            }
+        } else {
+            if (_xsan_comm_rx_ring_used(conn_ctx) >= _xsan_comm_rx_header_size(conn_ctx)) {
+                if (_xsan_comm_rx_parse_header(conn_ctx) != XSAN_OK) goto close_conn_error_proc_recv;
+                continue;
+            }
+            nbytes = _xsan_comm_rx_ring_fill(conn_ctx);
+            if (nbytes > 0) {
+                XSAN_LOG_TRACE("Read %zd bytes from %s", nbytes, conn_ctx->peer_addr_str);
+                continue;
             }
-        } else if (nbytes == 0) {
+        }
+
+        if (nbytes == 0) {
             XSAN_LOG_INFO("Connection %s closed by peer (recv returned 0).", conn_ctx->peer_addr_str);
             _remove_connection_from_active_list(conn_ctx);
-            _cleanup_and_free_connection_ctx(conn_ctx, false);
-            return;
-        } else {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) { /* No more data now */ }
-            else { XSAN_LOG_ERROR("spdk_sock_recv error on %s: %d (%s). Closing.", conn_ctx->peer_addr_str, errno, strerror(errno)); goto close_conn_error_proc_recv; }
+            _cleanup_and_free_connection_ctx(conn_ctx, true);
             return;
         }
-    } while (nbytes > 0 && conn_ctx->sock);
-    return;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return; // No more data now
+        XSAN_LOG_ERROR("spdk_sock_recv error on %s: %d (%s). Closing.", conn_ctx->peer_addr_str, errno, strerror(errno));
+        goto close_conn_error_proc_recv;
+    }
 
 close_conn_error_proc_recv:
+    if (conn_ctx->closing) return; // A handler already closed it
     _remove_connection_from_active_list(conn_ctx);
     _cleanup_and_free_connection_ctx(conn_ctx, true);
 }
 
+static void _process_received_data_for_connection(xsan_connection_ctx_t *conn_ctx) {
+    if (!conn_ctx || !conn_ctx->sock || conn_ctx->rx_active) return;
+    XSAN_LOG_DEBUG("Processing received data for %s (sock %p)", conn_ctx->peer_addr_str, conn_ctx->sock);
+
+    conn_ctx->rx_active = true;
+    _xsan_comm_rx_process(conn_ctx);
+    conn_ctx->rx_active = false;
+    if (conn_ctx->closing && !conn_ctx->flush_scheduled) {
+        _free_connection_ctx(conn_ctx);
+    }
+}
+
+// --- Peers and Connect ---
+
+static xsan_comm_peer_t *_xsan_comm_peer_lookup(xsan_comm_reactor_t *reactor, const char *ip, uint16_t port) {
+    xsan_comm_peer_key_t key = { ip, port };
+    return (xsan_comm_peer_t *)xsan_hashtable_get(reactor->peers, &key);
+}
+
+static xsan_comm_peer_t *_xsan_comm_peer_get(xsan_comm_reactor_t *reactor, const char *ip, uint16_t port) {
+    xsan_comm_peer_t *peer = _xsan_comm_peer_lookup(reactor, ip, port);
+    if (peer) return peer;
+    peer = (xsan_comm_peer_t *)XSAN_CALLOC(1, sizeof(xsan_comm_peer_t));
+    if (!peer) return NULL;
+    xsan_strcpy_safe(peer->ip, ip, INET6_ADDRSTRLEN);
+    peer->port = port;
+    peer->key.ip = peer->ip;
+    peer->key.port = port;
+    if (xsan_hashtable_put(reactor->peers, &peer->key, peer) != XSAN_OK) {
+        XSAN_FREE(peer);
+        return NULL;
+    }
+    return peer;
+}
+
+// Delivers the connect result to every caller waiting on the peer, after their connect calls returned.
+static void _xsan_comm_peer_connect_done_msg_fn(void *arg) {
+    xsan_comm_peer_t *peer = (xsan_comm_peer_t *)arg;
+    xsan_comm_connect_waiter_t *waiters = peer->waiters_head;
+    peer->waiters_head = peer->waiters_tail = NULL;
+    peer->completion_scheduled = false;
+    // The connection may have failed in the meantime; only hand out a socket that is still live.
+    struct spdk_sock *sock = peer->conn ? peer->conn->sock : NULL;
+    int status = sock ? 0 : -ECONNRESET;
+    if (!sock) XSAN_LOG_WARN("Connection to %s:%u closed before its connect callbacks ran.", peer->ip, peer->port);
+    if (peer->orphaned) XSAN_FREE(peer);
+
+    // Detached first: a callback may connect again, and must start a fresh waiter list.
+    while (waiters) {
+        xsan_comm_connect_waiter_t *w = waiters;
+        waiters = w->next;
+        w->cb(sock, status, w->cb_arg);
+        XSAN_FREE(w);
+    }
+}
+
+// Opens the peer's outbound connection on the calling reactor.
+static xsan_error_t _xsan_comm_peer_open(xsan_comm_reactor_t *reactor, xsan_comm_peer_t *peer) {
+    XSAN_LOG_INFO("Attempting to connect to %s:%u from core %u", peer->ip, peer->port, reactor->core);
+    struct spdk_sock_opts opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.opts_size = sizeof(struct spdk_sock_opts); // 必须设置
+    // 其他参数可按需设置，如 opts.priority/opts.zcopy 等
+    struct spdk_sock *sock = spdk_sock_connect_ext(peer->ip, (int)peer->port, NULL, &opts);
+    if (!sock) {
+        int err_no = errno;
+        XSAN_LOG_ERROR("spdk_sock_connect call failed immediately for %s:%u. Errno: %d (%s)",
+                       peer->ip, peer->port, err_no, strerror(err_no));
+        return xsan_error_from_errno(err_no);
+    }
+
+    xsan_connection_ctx_t *conn_ctx = _create_connection_ctx(reactor, sock,
+                                                             g_node_comm_ctx.global_app_msg_handler_cb,
+                                                             g_node_comm_ctx.global_app_msg_handler_cb_arg);
+    if (!conn_ctx) {
+        spdk_sock_close(&sock);
+        return XSAN_ERROR_NO_MEMORY;
+    }
+    if (_xsan_comm_connection_established(conn_ctx) != XSAN_OK) {
+        _cleanup_and_free_connection_ctx(conn_ctx, true);
+        return XSAN_ERROR_NETWORK;
+    }
+    conn_ctx->peer = peer;
+    peer->conn = conn_ctx;
+    _xsan_comm_poll_wake(reactor);
+    XSAN_LOG_DEBUG("Connected to %s on core %u, sock %p", conn_ctx->peer_addr_str, reactor->core, conn_ctx->sock);
+    return XSAN_OK;
+}
+
 xsan_error_t xsan_node_comm_connect(const char *target_ip, uint16_t target_port,
                                     xsan_node_connect_cb_t connect_cb, void *cb_arg) {
     if (!g_node_comm_ctx.module_initialized) {
@@ -382,35 +1759,103 @@ xsan_error_t xsan_node_comm_connect(const char *target_ip, uint16_t target_port,
         XSAN_LOG_ERROR("xsan_node_comm_connect must be called from an SPDK thread.");
         return XSAN_ERROR_THREAD_CONTEXT;
     }
+    // The new connection is owned by the calling reactor.
+    xsan_comm_reactor_t *reactor = _xsan_comm_get_local_reactor();
+    if (!reactor) {
+        XSAN_LOG_ERROR("No node comm reactor available on core %u for connect.", spdk_env_get_current_core());
+        return XSAN_ERROR_SPDK_ENV;
+    }
+    xsan_comm_peer_t *peer = _xsan_comm_peer_get(reactor, target_ip, target_port);
+    if (!peer) return XSAN_ERROR_NO_MEMORY;
+
+    if (!peer->conn) {
+        uint64_t now = spdk_get_ticks();
+        if (now < peer->retry_after_ticks) {
+            // Callers racing in right after a failure would otherwise each block in connect again.
+            XSAN_LOG_DEBUG("Connect to %s:%u suppressed; last attempt failed recently.", target_ip, target_port);
+            return XSAN_ERROR_NETWORK;
+        }
+        xsan_error_t err = _xsan_comm_peer_open(reactor, peer);
+        if (err != XSAN_OK) {
+            peer->retry_after_ticks = now + XSAN_COMM_CONNECT_RETRY_HOLDOFF_US * spdk_get_ticks_hz() / 1000000;
+            // Synchronous failure is reported by the return value only; connect_cb is not invoked.
+            return err;
+        }
+    }
 
-    XSAN_LOG_INFO("Attempting to connect to %s:%u", target_ip, target_port);
-
-    xsan_pending_connect_op_t *pending_op =
-        (xsan_pending_connect_op_t *)XSAN_MALLOC(sizeof(xsan_pending_connect_op_t));
-    if (!pending_op) {
-        XSAN_LOG_ERROR("Failed to allocate context for pending connect operation.");
-        return XSAN_ERROR_NO_MEMORY;
+    xsan_comm_connect_waiter_t *w = (xsan_comm_connect_waiter_t *)XSAN_MALLOC(sizeof(xsan_comm_connect_waiter_t));
+    if (!w) return XSAN_ERROR_NO_MEMORY; // The connection stays up for the next lookup
+    w->next = NULL;
+    w->cb = connect_cb;
+    w->cb_arg = cb_arg;
+    if (peer->waiters_tail) peer->waiters_tail->next = w;
+    else peer->waiters_head = w;
+    peer->waiters_tail = w;
+    if (!peer->completion_scheduled) {
+        if (spdk_thread_send_msg(reactor->thread, _xsan_comm_peer_connect_done_msg_fn, peer) != 0) {
+            // No completion pending means w is the only waiter.
+            peer->waiters_head = peer->waiters_tail = NULL;
+            XSAN_FREE(w);
+            XSAN_LOG_ERROR("Failed to schedule connect completion for %s:%u.", target_ip, target_port);
+            return XSAN_ERROR_NO_MEMORY;
+        }
+        peer->completion_scheduled = true;
     }
-    pending_op->user_cb = connect_cb;
-    pending_op->user_cb_arg = cb_arg;
-    xsan_snprintf_safe(pending_op->target_addr_str_for_log, XSAN_COMM_MAX_PEER_ADDR_LEN, "%s:%u", target_ip, target_port);
+    return XSAN_OK;
+}
 
-    struct spdk_sock_opts opts;
-    memset(&opts, 0, sizeof(opts));
-    opts.opts_size = sizeof(struct spdk_sock_opts); // 必须设置
-    // 其他参数可按需设置，如 opts.priority/opts.zcopy 等
-    pending_op->sock_in_progress = spdk_sock_connect_ext(target_ip, (int)target_port, NULL, &opts);
-    if (!pending_op->sock_in_progress) {
-        int err_no = errno;
-        XSAN_LOG_ERROR("spdk_sock_connect call failed immediately for %s. Errno: %d (%s)",
-                       pending_op->target_addr_str_for_log, err_no, strerror(err_no));
-        XSAN_FREE(pending_op);
-        connect_cb(NULL, -err_no, cb_arg);
-        return xsan_error_from_errno(err_no);
+struct spdk_sock *xsan_node_comm_get_active_connection(const char *target_ip, uint16_t target_port) {
+    if (!g_node_comm_ctx.module_initialized || !target_ip) return NULL;
+    xsan_comm_reactor_t *reactor = _xsan_comm_find_local_reactor();
+    if (!reactor) return NULL;
+    xsan_comm_peer_t *peer = _xsan_comm_peer_lookup(reactor, target_ip, target_port);
+    return (peer && peer->conn) ? peer->conn->sock : NULL;
+}
+
+struct spdk_sock *xsan_node_comm_conn_get_sock(struct xsan_connection_ctx *conn_ctx) {
+    return conn_ctx ? conn_ctx->sock : NULL;
+}
+
+const char *xsan_node_comm_conn_get_peer(const struct xsan_connection_ctx *conn_ctx) {
+    return conn_ctx ? conn_ctx->peer_addr_str : "unknown";
+}
+
+static void _xsan_comm_warm_up_connect_cb(struct spdk_sock *sock, int status, void *cb_arg) {
+    (void)sock;
+    xsan_comm_warm_up_ctx_t *ctx = (xsan_comm_warm_up_ctx_t *)cb_arg;
+    if (status != 0) XSAN_LOG_WARN("Warm-up connection to %s:%u failed: %d", ctx->ip, ctx->port, status);
+    XSAN_FREE(ctx);
+}
+
+// Runs on every SPDK thread; only threads that own a reactor open a connection.
+static void _xsan_comm_warm_up_thread_fn(void *arg) {
+    xsan_comm_warm_up_ctx_t *ctx = (xsan_comm_warm_up_ctx_t *)arg;
+    if (!g_node_comm_ctx.module_initialized || !_xsan_comm_find_local_reactor()) return;
+    if (xsan_node_comm_get_active_connection(ctx->ip, ctx->port)) return;
+    xsan_comm_warm_up_ctx_t *cb_ctx = (xsan_comm_warm_up_ctx_t *)XSAN_MALLOC(sizeof(xsan_comm_warm_up_ctx_t));
+    if (!cb_ctx) return;
+    memcpy(cb_ctx, ctx, sizeof(*cb_ctx));
+    xsan_error_t err = xsan_node_comm_connect(ctx->ip, ctx->port, _xsan_comm_warm_up_connect_cb, cb_ctx);
+    if (err != XSAN_OK) {
+        XSAN_LOG_WARN("Warm-up connect to %s:%u on core %u failed: %s", ctx->ip, ctx->port,
+                      spdk_env_get_current_core(), xsan_error_string(err));
+        XSAN_FREE(cb_ctx);
     }
+}
+
+static void _xsan_comm_warm_up_done_fn(void *arg) {
+    XSAN_FREE(arg);
+}
 
-    XSAN_LOG_DEBUG("SPDK connect initiated for %s, client sock %p, cb_arg (pending_op) %p",
-                   pending_op->target_addr_str_for_log, pending_op->sock_in_progress, pending_op);
+xsan_error_t xsan_node_comm_warm_up(const char *target_ip, uint16_t target_port) {
+    if (!g_node_comm_ctx.module_initialized) return XSAN_ERROR_INVALID_STATE;
+    if (!target_ip || target_port == 0) return XSAN_ERROR_INVALID_PARAM;
+    if (spdk_get_thread() == NULL) return XSAN_ERROR_THREAD_CONTEXT;
+    xsan_comm_warm_up_ctx_t *ctx = (xsan_comm_warm_up_ctx_t *)XSAN_MALLOC(sizeof(xsan_comm_warm_up_ctx_t));
+    if (!ctx) return XSAN_ERROR_NO_MEMORY;
+    xsan_strcpy_safe(ctx->ip, target_ip, INET6_ADDRSTRLEN);
+    ctx->port = target_port;
+    spdk_for_each_thread(_xsan_comm_warm_up_thread_fn, ctx, _xsan_comm_warm_up_done_fn);
     return XSAN_OK;
 }
 
@@ -425,54 +1870,200 @@ xsan_error_t xsan_node_comm_send_msg(struct spdk_sock *sock, xsan_message_t *msg
         XSAN_LOG_ERROR("No valid XSAN connection context found for sock %p during send_msg.", sock);
         return XSAN_ERROR_INVALID_PARAM;
     }
+    if (conn_ctx->reactor->thread != spdk_get_thread()) {
+        // The send queue is owned by the connection's reactor and deliberately unlocked.
+        XSAN_LOG_ERROR("send_msg to %s called off its owning reactor (core %u).", conn_ctx->peer_addr_str, conn_ctx->reactor->core);
+        return XSAN_ERROR_THREAD_CONTEXT;
+    }
 
-    if (conn_ctx->current_send_cb) {
-        XSAN_LOG_WARN("Send already in progress for connection %s. Request rejected.", conn_ctx->peer_addr_str);
-        return XSAN_ERROR_BUSY;
+    return _xsan_comm_enqueue_msg(conn_ctx, msg, send_cb, cb_arg);
+}
+
+/**
+ * Replaces a v2 request's payload with its LZ4 compression when the peer accepts LZ4 and it pays
+ * off. The compressed copy is owned by the request; the caller's payload is no longer referenced.
+ */
+static void _xsan_comm_compress_req(xsan_connection_ctx_t *conn_ctx, xsan_comm_send_req_t *req) {
+    uint32_t len = req->header.payload_length;
+    uint32_t max_wire = len - (len >> XSAN_COMM_COMPRESS_MIN_SAVING_SHIFT);
+    if (!conn_ctx->lz4_tx || len < g_node_comm_ctx.compress_min_bytes || max_wire <= XSAN_PROTOCOL_V2_LZ4_PREFIX_SIZE ||
+        _xsan_comm_is_control_msg(req->header.type)) {
+        return;
     }
+    xsan_comm_reactor_t *reactor = conn_ctx->reactor;
+    uint64_t start = spdk_get_ticks();
+    if (!xsan_compress_worth_trying(req->payload, len)) {
+        reactor->compress_stats.tx_skipped_entropy++;
+        goto out;
+    }
+    // Sized for the smallest saving worth having: anything larger fails to fit and goes raw.
+    unsigned char *zbuf = (unsigned char *)XSAN_MALLOC(max_wire);
+    if (!zbuf) goto out;
+    size_t zlen = xsan_compress_lz4(req->payload, len, zbuf + XSAN_PROTOCOL_V2_LZ4_PREFIX_SIZE,
+                                    max_wire - XSAN_PROTOCOL_V2_LZ4_PREFIX_SIZE);
+    if (zlen == 0) {
+        XSAN_FREE(zbuf);
+        reactor->compress_stats.tx_skipped_no_gain++;
+        goto out;
+    }
+    uint32_t raw_len_le = htole32(len);
+    memcpy(zbuf, &raw_len_le, XSAN_PROTOCOL_V2_LZ4_PREFIX_SIZE);
+    req->zbuf = zbuf;
+    req->payload = zbuf;
+    req->header.payload_length = (uint32_t)(XSAN_PROTOCOL_V2_LZ4_PREFIX_SIZE + zlen);
+    req->v2_flags |= XSAN_PROTOCOL_V2_MSG_FLAG_LZ4;
+    reactor->compress_stats.tx_compressed_msgs++;
+    reactor->compress_stats.tx_raw_bytes += len;
+    reactor->compress_stats.tx_wire_bytes += req->header.payload_length;
+out:
+    reactor->compress_ticks += spdk_get_ticks() - start;
+}
 
-    unsigned char header_buf[XSAN_MESSAGE_HEADER_SIZE];
-    if (xsan_protocol_header_serialize(&msg->header, header_buf) != XSAN_OK) {
-        XSAN_LOG_ERROR("Failed to serialize msg header for sending to %s.", conn_ctx->peer_addr_str);
-        return XSAN_ERROR_GENERIC;
+// Builds the send request for msg in the connection's current wire format; the caller links it into the queue.
+static xsan_comm_send_req_t *_xsan_comm_build_send_req(xsan_connection_ctx_t *conn_ctx, xsan_message_t *msg,
+                                                      xsan_node_send_cb_t send_cb, void *cb_arg) {
+    xsan_comm_send_req_t *req = (xsan_comm_send_req_t *)XSAN_MALLOC(sizeof(xsan_comm_send_req_t));
+    if (!req) {
+        XSAN_LOG_ERROR("Failed to allocate send request for %s.", conn_ctx->peer_addr_str);
+        return NULL;
     }
+    req->next = NULL;
+    req->payload = msg->payload;
+    req->zbuf = NULL;
+    req->v2_flags = 0;
+    req->raw_len = msg->header.payload_length;
+    req->bytes_sent = 0;
+    req->fc_exempt = !conn_ctx->flow_control;
+
+    if (conn_ctx->tx_version >= XSAN_PROTOCOL_VERSION_2) {
+        // Encoded (and checksummed, per frame) when the flush packs it into a frame.
+        msg->header.checksum = 0;
+        memcpy(&req->header, &msg->header, sizeof(req->header));
+        req->encoded = false;
+        req->iovcnt = 0;
+        req->total_len = 0;
+        _xsan_comm_compress_req(conn_ctx, req);
+    } else {
+        // Checksummed at enqueue time: the payload must not change while the message is queued anyway.
+        msg->header.checksum = conn_ctx->crc32c_tx ? xsan_protocol_message_checksum(&msg->header, msg->payload) : 0;
+        memcpy(&req->header, &msg->header, sizeof(req->header));
+        if (xsan_protocol_header_serialize(&msg->header, req->header_buf) != XSAN_OK) {
+            XSAN_LOG_ERROR("Failed to serialize msg header for sending to %s.", conn_ctx->peer_addr_str);
+            XSAN_FREE(req);
+            return NULL;
+        }
+        req->iov[0].iov_base = req->header_buf;
+        req->iov[0].iov_len = XSAN_MESSAGE_HEADER_SIZE;
+        req->iovcnt = 1;
+        if (msg->header.payload_length > 0) {
+            req->iov[1].iov_base = msg->payload;
+            req->iov[1].iov_len = msg->header.payload_length;
+            req->iovcnt = 2;
+        }
+        req->total_len = req->iov[0].iov_len + (req->iovcnt > 1 ? req->iov[1].iov_len : 0);
+        req->encoded = true;
+    }
+    req->send_cb = send_cb;
+    req->send_cb_arg = cb_arg;
+    return req;
+}
 
-    struct iovec iov[2];
-    int iovcnt = 1;
-    iov[0].iov_base = header_buf;
-    iov[0].iov_len = XSAN_MESSAGE_HEADER_SIZE;
+static xsan_error_t _xsan_comm_enqueue_msg(xsan_connection_ctx_t *conn_ctx, xsan_message_t *msg,
+                                           xsan_node_send_cb_t send_cb, void *cb_arg) {
+    if (conn_ctx->send_queue_depth >= XSAN_COMM_MAX_SEND_QUEUE_DEPTH) {
+        XSAN_LOG_WARN("Send queue for %s is full (%u messages). Request rejected.", conn_ctx->peer_addr_str, conn_ctx->send_queue_depth);
+        return XSAN_ERROR_BUSY;
+    }
 
-    if (msg->header.payload_length > 0 && msg->payload) {
-        iov[1].iov_base = msg->payload;
-        iov[1].iov_len = msg->header.payload_length;
-        iovcnt = 2;
+    if (msg->header.payload_length > 0 && !msg->payload) {
+        XSAN_LOG_ERROR("Message type %u to %s announces %u payload bytes but has no payload.",
+                       msg->header.type, conn_ctx->peer_addr_str, msg->header.payload_length);
+        return XSAN_ERROR_INVALID_PARAM;
     }
 
-    size_t total_to_send = iov[0].iov_len + (iovcnt > 1 ? iov[1].iov_len : 0);
-    XSAN_LOG_DEBUG("Attempting to send msg type %u (total %zu bytes) to %s (sock %p)",
-                   msg->header.type, total_to_send, conn_ctx->peer_addr_str, sock);
+    xsan_comm_send_req_t *req = _xsan_comm_build_send_req(conn_ctx, msg, send_cb, cb_arg);
+    if (!req) return XSAN_ERROR_NO_MEMORY;
+
+    if (conn_ctx->send_queue_tail) conn_ctx->send_queue_tail->next = req;
+    else conn_ctx->send_queue_head = req;
+    conn_ctx->send_queue_tail = req;
+    conn_ctx->send_queue_depth++;
+    if (!req->encoded && !conn_ctx->send_unframed) conn_ctx->send_unframed = req;
+    if (!conn_ctx->send_uncredited) conn_ctx->send_uncredited = req; // Admitted by the flush
+
+    XSAN_LOG_DEBUG("Queued msg type %u (%u payload bytes, v%u) to %s (sock %p), queue depth %u",
+                   msg->header.type, msg->header.payload_length, conn_ctx->tx_version, conn_ctx->peer_addr_str,
+                   conn_ctx->sock, conn_ctx->send_queue_depth);
+    _xsan_comm_poll_wake(conn_ctx->reactor);
+    _xsan_comm_schedule_flush(conn_ctx);
+    return XSAN_OK;
+}
 
-    ssize_t bytes_written = spdk_sock_writev(sock, iov, iovcnt);
+void xsan_node_comm_set_crc32c(bool enable) {
+    if (enable) g_node_comm_ctx.local_features |= XSAN_COMM_FEATURE_CRC32C;
+    else g_node_comm_ctx.local_features &= ~XSAN_COMM_FEATURE_CRC32C;
+    XSAN_LOG_INFO("CRC32C message integrity %s for new connections.", enable ? "offered" : "not offered");
+}
 
-    if (bytes_written < 0) {
-        int err_no = errno;
-        XSAN_LOG_ERROR("spdk_sock_writev failed for %s: %d (%s)", conn_ctx->peer_addr_str, err_no, strerror(err_no));
-        if (send_cb) send_cb(-err_no, cb_arg);
-        return xsan_error_from_errno(err_no);
+void xsan_node_comm_set_frame_batching(bool enable) {
+    if (enable) g_node_comm_ctx.local_features |= XSAN_COMM_FEATURE_FRAME_BATCHING;
+    else g_node_comm_ctx.local_features &= ~XSAN_COMM_FEATURE_FRAME_BATCHING;
+    XSAN_LOG_INFO("Multi-message frames %s for new connections.", enable ? "offered" : "not offered");
+}
+
+xsan_error_t xsan_node_comm_set_flow_control(bool enable, uint32_t window_bytes, uint32_t window_msgs) {
+    if (!enable) {
+        g_node_comm_ctx.local_features &= ~XSAN_COMM_FEATURE_FLOW_CONTROL;
+        XSAN_LOG_INFO("Flow control not offered for new connections.");
+        return XSAN_OK;
+    }
+    if (window_bytes < XSAN_PROTOCOL_MAX_PAYLOAD_SIZE || window_msgs == 0) {
+        XSAN_LOG_ERROR("Flow-control window of %u bytes / %u messages cannot admit a %u-byte message.",
+                       window_bytes, window_msgs, XSAN_PROTOCOL_MAX_PAYLOAD_SIZE);
+        return XSAN_ERROR_INVALID_PARAM;
     }
+    g_node_comm_ctx.flow_window_bytes = window_bytes;
+    g_node_comm_ctx.flow_window_msgs = window_msgs;
+    g_node_comm_ctx.local_features |= XSAN_COMM_FEATURE_FLOW_CONTROL;
+    XSAN_LOG_INFO("Flow control offered for new connections: window %u bytes, %u messages.", window_bytes, window_msgs);
+    return XSAN_OK;
+}
 
-    if ((size_t)bytes_written < total_to_send) {
-        XSAN_LOG_WARN("Partial write to %s: %zd sent, %zu total. Full async send logic with queueing needed for this case.",
-                      conn_ctx->peer_addr_str, bytes_written, total_to_send);
-        conn_ctx->current_send_cb = send_cb;
-        conn_ctx->current_send_cb_arg = cb_arg;
+xsan_error_t xsan_node_comm_set_compression(bool enable, uint32_t min_bytes) {
+    if (!enable) {
+        g_node_comm_ctx.local_features &= ~XSAN_COMM_FEATURE_LZ4;
+        XSAN_LOG_INFO("LZ4 payload compression not offered for new connections.");
         return XSAN_OK;
     }
+    if (!xsan_compress_available()) {
+        XSAN_LOG_WARN("This build has no LZ4; payload compression is not available.");
+        return XSAN_ERROR_UNSUPPORTED;
+    }
+    g_node_comm_ctx.compress_min_bytes = min_bytes;
+    g_node_comm_ctx.local_features |= XSAN_COMM_FEATURE_LZ4;
+    XSAN_LOG_INFO("LZ4 payload compression offered for new connections (payloads of %u bytes and up).", min_bytes);
+    return XSAN_OK;
+}
+
+xsan_error_t xsan_node_comm_get_compress_stats(uint32_t index, xsan_node_comm_compress_stats_t *stats_out) {
+    if (!stats_out) return XSAN_ERROR_INVALID_PARAM;
+    if (index >= xsan_node_comm_get_num_reactors()) return XSAN_ERROR_NOT_FOUND;
+    xsan_comm_reactor_t *reactor = g_node_comm_ctx.reactors[index];
+    if (!reactor) return XSAN_ERROR_NOT_FOUND;
+    *stats_out = reactor->compress_stats;
+    stats_out->tx_compress_us = _xsan_comm_ticks_to_us(reactor->compress_ticks);
+    stats_out->rx_decompress_us = _xsan_comm_ticks_to_us(reactor->decompress_ticks);
+    return XSAN_OK;
+}
 
-    XSAN_LOG_DEBUG("Successfully wrote all %zd bytes to %s.", bytes_written, conn_ctx->peer_addr_str);
-    if (send_cb) {
-        send_cb(0, cb_arg);
+xsan_error_t xsan_node_comm_set_max_protocol_version(uint16_t version) {
+    if (version < XSAN_PROTOCOL_VERSION_1 || version > XSAN_PROTOCOL_VERSION) {
+        XSAN_LOG_ERROR("Protocol version %u not supported (this build speaks v%u..v%u).",
+                       version, XSAN_PROTOCOL_VERSION_1, XSAN_PROTOCOL_VERSION);
+        return XSAN_ERROR_INVALID_PARAM;
     }
+    g_node_comm_ctx.local_max_version = version;
+    XSAN_LOG_INFO("Advertising protocol v%u on new connections.", version);
     return XSAN_OK;
 }
 
@@ -480,24 +2071,24 @@ void xsan_node_comm_disconnect(struct spdk_sock **sock_ptr) {
     if (!sock_ptr || !*sock_ptr) return;
     XSAN_LOG_INFO("Disconnecting socket %p", *sock_ptr);
 
-    pthread_mutex_lock(&g_node_comm_ctx.active_connections_lock);
     xsan_connection_ctx_t *conn_ctx = NULL;
-    xsan_connection_ctx_t *iter = g_node_comm_ctx.active_connections_head;
-    while(iter) {
+    xsan_comm_reactor_t *reactor = _xsan_comm_find_local_reactor();
+    for (xsan_connection_ctx_t *iter = reactor ? reactor->connections : NULL; iter; iter = iter->next) {
         if (iter->sock == *sock_ptr) {
             conn_ctx = iter;
             break;
         }
-        iter = iter->next;
     }
-    if(conn_ctx) {
-        _remove_connection_from_active_list(conn_ctx);
-    }
-    pthread_mutex_unlock(&g_node_comm_ctx.active_connections_lock);
 
     if(conn_ctx) {
+        _remove_connection_from_active_list(conn_ctx);
         _cleanup_and_free_connection_ctx(conn_ctx, true);
     } else {
+        xsan_connection_ctx_t *owner = (xsan_connection_ctx_t *)spdk_sock_get_cb_arg(*sock_ptr);
+        if (owner && owner->sock == *sock_ptr) {
+            XSAN_LOG_ERROR("Disconnect of %s called off its owning reactor (core %u). Ignored.", owner->peer_addr_str, owner->reactor->core);
+            return;
+        }
         XSAN_LOG_WARN("Disconnecting socket %p that had no XSAN connection context. Closing directly.", *sock_ptr);
         spdk_sock_close(sock_ptr);
     }
@@ -2,6 +2,9 @@
 #include "xsan_log.h"
 #include "../../include/xsan_error.h"
 #include "xsan_memory.h" // For XSAN_STRDUP if needed for NQN copy
+#include "xsan_string_utils.h"
+#include "xsan_vhost.h"
+#include "xsan_volume_manager.h"
 
 #include "spdk/stdinc.h"
 #include "spdk/env.h"
@@ -9,6 +12,11 @@
 #include "spdk/nvmf.h"
 #include "spdk/nvmf_spec.h" // For spdk_nvmf_subsystem_set_allow_any_host
 #include "spdk/bdev.h"     // For spdk_bdev_get_by_name
+#include "spdk/cpuset.h"
+#include "spdk/event.h"    // For spdk_app_get_core_mask
+#include "spdk/sock.h"     // For the posix zero-copy send option
+#include "spdk/string.h"
+#include "spdk/uuid.h"
 
 // Define a default NQN if none is provided.
 // Format: nqn.2016-06.io.spdk:xsan-target
@@ -16,15 +24,549 @@
 #define XSAN_DEFAULT_NVMF_SUBSYSTEM_SERIAL "XSAN000000000001"
 #define XSAN_DEFAULT_NVMF_SUBSYSTEM_MODEL "XSAN Virtual Controller"
 
+// How long init/fini wait for the poll group threads and the async target steps.
+#define XSAN_NVMF_TARGET_STEP_TIMEOUT_MS 10000
+
+// Backoff before retrying a namespace pause the subsystem refused (e.g. still starting).
+#define XSAN_NVMF_EXPORT_RETRY_US 10000
+#define XSAN_NVMF_VOLUME_BDEV_NAME_LEN (sizeof(XSAN_NVMF_VOLUME_BDEV_PREFIX) + SPDK_UUID_STRING_LEN)
+
+// One poll group per configured core. The group on the init thread's core runs on the init
+// thread itself: that reactor is busy polling the init thread, so a second thread on it
+// would not get to run while init waits.
+typedef struct {
+    struct spdk_thread *thread;
+    struct spdk_nvmf_poll_group *group;
+    uint32_t core;
+    bool own_thread;    // Created here; exits once its group is destroyed
+} xsan_nvmf_poll_group_t;
+
 // Global context for this module (simplified for now)
 static struct spdk_nvmf_tgt *g_xsan_nvmf_tgt = NULL;
 static struct spdk_nvmf_subsystem *g_xsan_default_subsystem = NULL;
 // We might support multiple transports, but TCP is common for initial setup.
-// static struct spdk_nvmf_transport *g_xsan_tcp_transport = NULL;
+static struct spdk_nvmf_transport *g_xsan_tcp_transport = NULL;
+
+static xsan_nvmf_target_opts_t g_xsan_nvmf_opts;
+static bool g_xsan_nvmf_opts_set = false;
+static xsan_nvmf_poll_group_t *g_xsan_nvmf_poll_groups = NULL;
+static uint32_t g_xsan_nvmf_num_poll_groups = 0;
+
+// Async steps (group create/destroy, add_transport, ...) still outstanding; the init thread
+// polls itself until it drops to 0. g_xsan_nvmf_step_rc keeps the first failure.
+static uint32_t g_xsan_nvmf_pending = 0;
+static int g_xsan_nvmf_step_rc = 0;
+
+typedef enum {
+    XSAN_NVMF_EXPORT_ADD_PENDING = 0,
+    XSAN_NVMF_EXPORT_ADDING,
+    XSAN_NVMF_EXPORT_ACTIVE,
+    XSAN_NVMF_EXPORT_REMOVE_PENDING,
+    XSAN_NVMF_EXPORT_REMOVING,
+} xsan_nvmf_export_state_t;
+
+// A volume exported as a namespace of the default subsystem. Only the init thread touches
+// these; pending changes are applied in list order, one pause/resume at a time.
+typedef struct xsan_nvmf_export {
+    xsan_volume_id_t volume_id;
+    char bdev_name[XSAN_NVMF_VOLUME_BDEV_NAME_LEN];
+    uint32_t nsid;                  // 0 until the namespace has been added
+    xsan_nvmf_export_state_t state;
+    bool remove_requested;          // Unexport arrived while the add was in flight
+    bool has_vbdev;
+    struct xsan_nvmf_export *next;
+} xsan_nvmf_export_t;
+
+typedef struct {
+    xsan_volume_id_t volume_id;
+    bool add;
+} xsan_nvmf_export_req_t;
+
+static struct spdk_thread *g_xsan_nvmf_thread = NULL; // The init thread
+static xsan_nvmf_export_t *g_xsan_nvmf_exports = NULL;
+static uint32_t g_xsan_nvmf_export_count = 0;
+static xsan_nvmf_export_t *g_xsan_nvmf_export_busy = NULL; // Its namespace is being paused
+static struct spdk_poller *g_xsan_nvmf_export_retry = NULL;
+static bool g_xsan_nvmf_exports_stopping = false;
+static xsan_volume_manager_t *g_xsan_nvmf_auto_export_vm = NULL;
 
 // Store NQN to avoid issues with string lifetime if passed NQN is on stack
 static char g_target_nqn_storage[SPDK_NVMF_NQN_MAX_LEN + 1];
 
+void xsan_nvmf_target_opts_init(xsan_nvmf_target_opts_t *opts) {
+    if (!opts) return;
+    memset(opts, 0, sizeof(*opts));
+}
+
+xsan_error_t xsan_nvmf_target_set_opts(const xsan_nvmf_target_opts_t *opts) {
+    if (!opts) return XSAN_ERROR_INVALID_PARAM;
+    if (g_xsan_nvmf_tgt) {
+        XSAN_LOG_ERROR("NVMe-oF target options must be set before xsan_nvmf_target_init.");
+        return XSAN_ERROR_BUSY;
+    }
+    if (opts->max_queue_depth > UINT16_MAX || opts->max_qpairs_per_ctrlr > UINT16_MAX ||
+        (opts->max_queue_depth != 0 && opts->max_queue_depth < 2) ||
+        (opts->in_capsule_data_size % 16) != 0 ||
+        (opts->io_unit_size != 0 && opts->io_unit_size < 512) ||
+        (opts->max_io_size != 0 && opts->io_unit_size != 0 && (opts->max_io_size % opts->io_unit_size) != 0)) {
+        XSAN_LOG_ERROR("Invalid NVMe-oF transport options (queue depth %u, qpairs %u, in-capsule %u, io unit %u, max io %u).",
+                       opts->max_queue_depth, opts->max_qpairs_per_ctrlr, opts->in_capsule_data_size,
+                       opts->io_unit_size, opts->max_io_size);
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    if (memchr(opts->poll_group_mask, '\0', sizeof(opts->poll_group_mask)) == NULL) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    if (opts->poll_group_mask[0] != '\0') {
+        struct spdk_cpuset mask;
+        if (spdk_cpuset_parse(&mask, opts->poll_group_mask) != 0 || spdk_cpuset_count(&mask) == 0) {
+            XSAN_LOG_ERROR("Invalid NVMe-oF poll group mask '%s'.", opts->poll_group_mask);
+            return XSAN_ERROR_INVALID_PARAM;
+        }
+    }
+    g_xsan_nvmf_opts = *opts;
+    g_xsan_nvmf_opts_set = true;
+    return XSAN_OK;
+}
+
+static void _xsan_nvmf_step_done(int status) {
+    if (status != 0) __sync_bool_compare_and_swap(&g_xsan_nvmf_step_rc, 0, status);
+    __sync_sub_and_fetch(&g_xsan_nvmf_pending, 1);
+}
+
+// Polls the calling thread until every outstanding step has completed or timeout_ms passes.
+static bool _xsan_nvmf_wait_steps(uint32_t timeout_ms) {
+    struct spdk_thread *thread = spdk_get_thread();
+    uint64_t deadline = spdk_get_ticks() + spdk_get_ticks_hz() * timeout_ms / 1000;
+    while (__sync_add_and_fetch(&g_xsan_nvmf_pending, 0) != 0) {
+        if (spdk_get_ticks() > deadline) return false;
+        if (spdk_thread_poll(thread, 0, 0) == 0) usleep(10);
+    }
+    return true;
+}
+
+static void _xsan_nvmf_poll_group_create_msg(void *arg) {
+    xsan_nvmf_poll_group_t *pg = (xsan_nvmf_poll_group_t *)arg;
+    pg->group = spdk_nvmf_poll_group_create(g_xsan_nvmf_tgt);
+    if (!pg->group) {
+        XSAN_LOG_ERROR("spdk_nvmf_poll_group_create() failed on core %u.", pg->core);
+    }
+    _xsan_nvmf_step_done(pg->group ? 0 : -ENOMEM);
+}
+
+static void _xsan_nvmf_poll_group_destroyed(void *cb_arg, int status) {
+    xsan_nvmf_poll_group_t *pg = (xsan_nvmf_poll_group_t *)cb_arg;
+    if (status != 0) {
+        XSAN_LOG_WARN("NVMe-oF poll group on core %u destroyed with status %d.", pg->core, status);
+    }
+    pg->group = NULL;
+    if (pg->own_thread) {
+        spdk_thread_exit(spdk_get_thread());
+    }
+    _xsan_nvmf_step_done(0);
+}
+
+static void _xsan_nvmf_poll_group_destroy_msg(void *arg) {
+    xsan_nvmf_poll_group_t *pg = (xsan_nvmf_poll_group_t *)arg;
+    if (pg->group) {
+        spdk_nvmf_poll_group_destroy(pg->group, _xsan_nvmf_poll_group_destroyed, pg);
+    } else {
+        _xsan_nvmf_poll_group_destroyed(pg, 0);
+    }
+}
+
+static void _xsan_nvmf_destroy_poll_groups(void) {
+    if (!g_xsan_nvmf_poll_groups) return;
+    for (uint32_t i = 0; i < g_xsan_nvmf_num_poll_groups; ++i) {
+        xsan_nvmf_poll_group_t *pg = &g_xsan_nvmf_poll_groups[i];
+        if (!pg->thread) continue;
+        __sync_add_and_fetch(&g_xsan_nvmf_pending, 1);
+        if (pg->own_thread) {
+            spdk_thread_send_msg(pg->thread, _xsan_nvmf_poll_group_destroy_msg, pg);
+        } else {
+            _xsan_nvmf_poll_group_destroy_msg(pg);
+        }
+    }
+    if (!_xsan_nvmf_wait_steps(XSAN_NVMF_TARGET_STEP_TIMEOUT_MS)) {
+        // A thread still holds a pointer into the array; leave it allocated.
+        XSAN_LOG_ERROR("Timed out destroying NVMe-oF poll groups.");
+    } else {
+        XSAN_FREE(g_xsan_nvmf_poll_groups);
+    }
+    g_xsan_nvmf_poll_groups = NULL;
+    g_xsan_nvmf_num_poll_groups = 0;
+}
+
+static xsan_error_t _xsan_nvmf_create_poll_groups(void) {
+    struct spdk_cpuset mask;
+    spdk_cpuset_copy(&mask, spdk_app_get_core_mask());
+    if (g_xsan_nvmf_opts.poll_group_mask[0] != '\0') {
+        struct spdk_cpuset wanted;
+        spdk_cpuset_parse(&wanted, g_xsan_nvmf_opts.poll_group_mask); // Validated by set_opts
+        spdk_cpuset_and(&mask, &wanted);
+    }
+    uint32_t init_core = spdk_env_get_current_core();
+    if (spdk_cpuset_count(&mask) == 0) {
+        XSAN_LOG_WARN("NVMe-oF poll group mask '%s' has no reactor cores; using core %u only.",
+                      g_xsan_nvmf_opts.poll_group_mask, init_core);
+        spdk_cpuset_set_cpu(&mask, init_core, true);
+    }
+
+    g_xsan_nvmf_poll_groups = (xsan_nvmf_poll_group_t *)XSAN_CALLOC(spdk_cpuset_count(&mask),
+                                                                     sizeof(xsan_nvmf_poll_group_t));
+    if (!g_xsan_nvmf_poll_groups) return XSAN_ERROR_NO_MEMORY;
+
+    g_xsan_nvmf_step_rc = 0;
+    uint32_t core;
+    SPDK_ENV_FOREACH_CORE(core) {
+        if (!spdk_cpuset_get_cpu(&mask, core)) continue;
+        xsan_nvmf_poll_group_t *pg = &g_xsan_nvmf_poll_groups[g_xsan_nvmf_num_poll_groups];
+        pg->core = core;
+        if (core == init_core) {
+            pg->thread = spdk_get_thread();
+            g_xsan_nvmf_num_poll_groups++;
+            __sync_add_and_fetch(&g_xsan_nvmf_pending, 1);
+            _xsan_nvmf_poll_group_create_msg(pg);
+            continue;
+        }
+        struct spdk_cpuset thread_mask;
+        char name[32];
+        spdk_cpuset_zero(&thread_mask);
+        spdk_cpuset_set_cpu(&thread_mask, core, true);
+        snprintf(name, sizeof(name), "xsan_nvmf_pg_%u", core);
+        pg->thread = spdk_thread_create(name, &thread_mask);
+        if (!pg->thread) {
+            XSAN_LOG_ERROR("Failed to create NVMe-oF poll group thread on core %u.", core);
+            g_xsan_nvmf_step_rc = -ENOMEM;
+            break;
+        }
+        pg->own_thread = true;
+        g_xsan_nvmf_num_poll_groups++;
+        __sync_add_and_fetch(&g_xsan_nvmf_pending, 1);
+        spdk_thread_send_msg(pg->thread, _xsan_nvmf_poll_group_create_msg, pg);
+    }
+    if (!_xsan_nvmf_wait_steps(XSAN_NVMF_TARGET_STEP_TIMEOUT_MS)) {
+        XSAN_LOG_ERROR("Timed out creating NVMe-oF poll groups.");
+        g_xsan_nvmf_poll_groups = NULL; // Still referenced by the stuck thread; leaked
+        g_xsan_nvmf_num_poll_groups = 0;
+        return XSAN_ERROR_TIMEOUT;
+    }
+    if (g_xsan_nvmf_step_rc != 0) {
+        _xsan_nvmf_destroy_poll_groups();
+        return XSAN_ERROR_IO;
+    }
+    XSAN_LOG_INFO("NVMe-oF target running %u poll group(s); new qpairs are assigned round-robin.",
+                  g_xsan_nvmf_num_poll_groups);
+    return XSAN_OK;
+}
+
+static void _xsan_nvmf_step_cb(void *cb_arg, int status) {
+    (void)cb_arg;
+    _xsan_nvmf_step_done(status);
+}
+
+static void _xsan_nvmf_subsystem_step_cb(struct spdk_nvmf_subsystem *subsystem, void *cb_arg, int status) {
+    (void)subsystem;
+    (void)cb_arg;
+    _xsan_nvmf_step_done(status);
+}
+
+static void _xsan_nvmf_tgt_destroyed(void *cb_arg, int status) {
+    (void)cb_arg;
+    _xsan_nvmf_step_done(status);
+}
+
+static void _xsan_nvmf_apply_transport_opts(struct spdk_nvmf_transport_opts *transport_opts) {
+    const xsan_nvmf_target_opts_t *o = &g_xsan_nvmf_opts;
+    if (o->max_queue_depth) transport_opts->max_queue_depth = (uint16_t)o->max_queue_depth;
+    if (o->max_qpairs_per_ctrlr) transport_opts->max_qpairs_per_ctrlr = (uint16_t)o->max_qpairs_per_ctrlr;
+    if (o->in_capsule_data_size) transport_opts->in_capsule_data_size = o->in_capsule_data_size;
+    if (o->io_unit_size) transport_opts->io_unit_size = o->io_unit_size;
+    if (o->max_io_size) transport_opts->max_io_size = o->max_io_size;
+    if (o->num_shared_buffers) transport_opts->num_shared_buffers = o->num_shared_buffers;
+    if (o->buf_cache_size) transport_opts->buf_cache_size = o->buf_cache_size;
+    XSAN_LOG_INFO("NVMe-oF TCP transport: queue depth %u, qpairs/ctrlr %u, in-capsule %u, io unit %u, max io %u, "
+                  "shared buffers %u, buffer cache %u.",
+                  transport_opts->max_queue_depth, transport_opts->max_qpairs_per_ctrlr,
+                  transport_opts->in_capsule_data_size, transport_opts->io_unit_size, transport_opts->max_io_size,
+                  transport_opts->num_shared_buffers, transport_opts->buf_cache_size);
+}
+
+// Zero-copy send is a property of the sock implementation, not of the NVMe-oF transport.
+static void _xsan_nvmf_apply_sock_opts(void) {
+    if (!g_xsan_nvmf_opts.zcopy_send) return;
+    struct spdk_sock_impl_opts sock_opts;
+    size_t len = sizeof(sock_opts);
+    if (spdk_sock_impl_get_opts("posix", &sock_opts, &len) != 0) {
+        XSAN_LOG_WARN("Cannot read posix sock options; zero-copy send stays at its default.");
+        return;
+    }
+    sock_opts.enable_zerocopy_send_server = true;
+    if (spdk_sock_impl_set_opts("posix", &sock_opts, len) != 0) {
+        XSAN_LOG_WARN("Failed to enable zero-copy send on posix sockets.");
+        return;
+    }
+    XSAN_LOG_INFO("Zero-copy send enabled for accepted posix sockets.");
+}
+
+static xsan_nvmf_export_t *_xsan_nvmf_export_find(const xsan_volume_id_t *volume_id) {
+    for (xsan_nvmf_export_t *e = g_xsan_nvmf_exports; e; e = e->next) {
+        if (memcmp(&e->volume_id, volume_id, sizeof(*volume_id)) == 0) return e;
+    }
+    return NULL;
+}
+
+static void _xsan_nvmf_export_free(xsan_nvmf_export_t *e) {
+    xsan_nvmf_export_t **pp = &g_xsan_nvmf_exports;
+    while (*pp && *pp != e) pp = &(*pp)->next;
+    if (*pp) *pp = e->next;
+    if (e->has_vbdev) {
+        xsan_error_t err = xsan_vhost_unexpose_volume_vbdev(e->bdev_name);
+        if (err != XSAN_OK) {
+            XSAN_LOG_WARN("Failed to destroy vbdev %s of an unexported volume (error %d).", e->bdev_name, err);
+        }
+    }
+    g_xsan_nvmf_export_count--;
+    XSAN_FREE(e);
+}
+
+// Lowest NSID with no namespace behind it; namespaces added by hand are skipped too.
+static uint32_t _xsan_nvmf_export_alloc_nsid(void) {
+    uint32_t max_nsid = spdk_nvmf_subsystem_get_max_nsid(g_xsan_default_subsystem);
+    for (uint32_t nsid = 1; nsid <= max_nsid; ++nsid) {
+        if (!spdk_nvmf_subsystem_get_ns(g_xsan_default_subsystem, nsid)) return nsid;
+    }
+    return 0;
+}
+
+static void _xsan_nvmf_export_kick(void);
+
+// Last step of every namespace change, whether or not the subsystem was actually paused.
+static void _xsan_nvmf_export_resumed(struct spdk_nvmf_subsystem *subsystem, void *cb_arg, int status) {
+    xsan_nvmf_export_t *e = (xsan_nvmf_export_t *)cb_arg;
+    (void)subsystem;
+    if (status != 0) {
+        XSAN_LOG_ERROR("Resuming subsystem after a change to volume bdev %s failed (error %d).",
+                       e->bdev_name, status);
+    }
+    if (e->state == XSAN_NVMF_EXPORT_ADDING) {
+        if (e->nsid == 0) {
+            _xsan_nvmf_export_free(e);
+        } else {
+            XSAN_LOG_INFO("Exported %s as NSID %u (NGUID = volume UUID).", e->bdev_name, e->nsid);
+            e->state = e->remove_requested ? XSAN_NVMF_EXPORT_REMOVE_PENDING : XSAN_NVMF_EXPORT_ACTIVE;
+            e->remove_requested = false;
+        }
+    } else if (e->nsid == 0) { // Removed
+        XSAN_LOG_INFO("Volume bdev %s is no longer exported.", e->bdev_name);
+        _xsan_nvmf_export_free(e);
+    } else {
+        e->state = XSAN_NVMF_EXPORT_ACTIVE;
+    }
+    g_xsan_nvmf_export_busy = NULL;
+    _xsan_nvmf_export_kick();
+}
+
+// Only e->nsid is paused: I/O to every other namespace of the subsystem keeps running.
+static void _xsan_nvmf_export_paused(struct spdk_nvmf_subsystem *subsystem, void *cb_arg, int status) {
+    xsan_nvmf_export_t *e = (xsan_nvmf_export_t *)cb_arg;
+    if (status != 0) {
+        XSAN_LOG_ERROR("Pausing NSID %u for volume bdev %s failed (error %d).", e->nsid, e->bdev_name, status);
+        if (e->state == XSAN_NVMF_EXPORT_ADDING) e->nsid = 0;
+        _xsan_nvmf_export_resumed(subsystem, e, 0);
+        return;
+    }
+
+    if (e->state == XSAN_NVMF_EXPORT_ADDING) {
+        struct spdk_nvmf_ns_opts ns_opts;
+        spdk_nvmf_ns_opts_get_defaults(&ns_opts, sizeof(ns_opts));
+        ns_opts.nsid = e->nsid;
+        memcpy(ns_opts.nguid, e->volume_id.data, sizeof(ns_opts.nguid));
+        memcpy(&ns_opts.uuid, e->volume_id.data, sizeof(ns_opts.uuid));
+        e->nsid = spdk_nvmf_subsystem_add_ns_ext(subsystem, e->bdev_name, &ns_opts, sizeof(ns_opts), NULL);
+        if (e->nsid == 0) {
+            XSAN_LOG_ERROR("spdk_nvmf_subsystem_add_ns_ext() failed for bdev %s (NSID %u).",
+                           e->bdev_name, ns_opts.nsid);
+        }
+    } else {
+        int rc = spdk_nvmf_subsystem_remove_ns(subsystem, e->nsid);
+        if (rc != 0) {
+            XSAN_LOG_ERROR("spdk_nvmf_subsystem_remove_ns() failed for NSID %u: %s", e->nsid, spdk_strerror(-rc));
+        } else {
+            e->nsid = 0;
+        }
+    }
+
+    int rc = spdk_nvmf_subsystem_resume(subsystem, _xsan_nvmf_export_resumed, e);
+    if (rc != 0) {
+        _xsan_nvmf_export_resumed(subsystem, e, rc);
+    }
+}
+
+static int _xsan_nvmf_export_retry_poll(void *arg) {
+    (void)arg;
+    spdk_poller_unregister(&g_xsan_nvmf_export_retry);
+    _xsan_nvmf_export_kick();
+    return SPDK_POLLER_BUSY;
+}
+
+// Creates the vbdev and picks the NSID. Drops the record and returns false on failure.
+static bool _xsan_nvmf_export_prepare_add(xsan_nvmf_export_t *e) {
+    if (!e->has_vbdev) {
+        xsan_error_t err = xsan_vhost_expose_volume_as_vbdev(e->volume_id, e->bdev_name);
+        if (err != XSAN_OK && err != XSAN_ERROR_ALREADY_EXISTS) {
+            XSAN_LOG_ERROR("Cannot create vbdev %s to export its volume (error %d).", e->bdev_name, err);
+            _xsan_nvmf_export_free(e);
+            return false;
+        }
+        e->has_vbdev = true;
+    }
+    e->nsid = _xsan_nvmf_export_alloc_nsid();
+    if (e->nsid == 0) {
+        XSAN_LOG_ERROR("No free NSID in %s for %s (max %u).", spdk_nvmf_subsystem_get_nqn(g_xsan_default_subsystem),
+                       e->bdev_name, spdk_nvmf_subsystem_get_max_nsid(g_xsan_default_subsystem));
+        _xsan_nvmf_export_free(e);
+        return false;
+    }
+    return true;
+}
+
+// Starts the next pending namespace change unless one is already in flight.
+static void _xsan_nvmf_export_kick(void) {
+    while (!g_xsan_nvmf_export_busy && !g_xsan_nvmf_export_retry && !g_xsan_nvmf_exports_stopping &&
+           g_xsan_default_subsystem) {
+        xsan_nvmf_export_t *e = g_xsan_nvmf_exports;
+        while (e && e->state != XSAN_NVMF_EXPORT_ADD_PENDING && e->state != XSAN_NVMF_EXPORT_REMOVE_PENDING) {
+            e = e->next;
+        }
+        if (!e) return;
+
+        if (e->state == XSAN_NVMF_EXPORT_ADD_PENDING) {
+            if (!_xsan_nvmf_export_prepare_add(e)) continue;
+            e->state = XSAN_NVMF_EXPORT_ADDING;
+        } else {
+            e->state = XSAN_NVMF_EXPORT_REMOVING;
+        }
+        g_xsan_nvmf_export_busy = e;
+        int rc = spdk_nvmf_subsystem_pause(g_xsan_default_subsystem, e->nsid, _xsan_nvmf_export_paused, e);
+        if (rc == 0) return;
+
+        g_xsan_nvmf_export_busy = NULL;
+        if (rc == -EBUSY) {
+            // Another state change of the subsystem (start, a manual namespace op) is running.
+            if (e->state == XSAN_NVMF_EXPORT_ADDING) {
+                e->state = XSAN_NVMF_EXPORT_ADD_PENDING;
+                e->nsid = 0;
+            } else {
+                e->state = XSAN_NVMF_EXPORT_REMOVE_PENDING;
+            }
+            g_xsan_nvmf_export_retry = SPDK_POLLER_REGISTER(_xsan_nvmf_export_retry_poll, NULL,
+                                                            XSAN_NVMF_EXPORT_RETRY_US);
+            return;
+        }
+        g_xsan_nvmf_export_busy = e;
+        _xsan_nvmf_export_paused(g_xsan_default_subsystem, e, rc); // Fails the change, then kicks again
+        return;
+    }
+}
+
+// Runs on the init thread.
+static xsan_error_t _xsan_nvmf_export_request(const xsan_volume_id_t *volume_id, bool add) {
+    if (!g_xsan_default_subsystem || g_xsan_nvmf_exports_stopping) return XSAN_ERROR_NOT_INITIALIZED;
+    xsan_nvmf_export_t *e = _xsan_nvmf_export_find(volume_id);
+
+    if (add) {
+        if (e) {
+            if (e->state == XSAN_NVMF_EXPORT_REMOVE_PENDING) {
+                e->state = XSAN_NVMF_EXPORT_ACTIVE; // Removal not started yet; keep the namespace
+                return XSAN_OK;
+            }
+            if (e->state == XSAN_NVMF_EXPORT_ADDING && e->remove_requested) {
+                e->remove_requested = false;
+                return XSAN_OK;
+            }
+            return XSAN_ERROR_ALREADY_EXISTS;
+        }
+        if (g_xsan_nvmf_export_count >= spdk_nvmf_subsystem_get_max_nsid(g_xsan_default_subsystem)) {
+            return XSAN_ERROR_INSUFFICIENT_SPACE;
+        }
+        e = (xsan_nvmf_export_t *)XSAN_CALLOC(1, sizeof(xsan_nvmf_export_t));
+        if (!e) return XSAN_ERROR_NO_MEMORY;
+        char uuid_str[SPDK_UUID_STRING_LEN];
+        e->volume_id = *volume_id;
+        spdk_uuid_fmt_lower(uuid_str, sizeof(uuid_str), (const struct spdk_uuid *)&volume_id->data[0]);
+        snprintf(e->bdev_name, sizeof(e->bdev_name), "%s%s", XSAN_NVMF_VOLUME_BDEV_PREFIX, uuid_str);
+        e->state = XSAN_NVMF_EXPORT_ADD_PENDING;
+        xsan_nvmf_export_t **pp = &g_xsan_nvmf_exports;
+        while (*pp) pp = &(*pp)->next;
+        *pp = e;
+        g_xsan_nvmf_export_count++;
+    } else {
+        if (!e) return XSAN_ERROR_NOT_FOUND;
+        switch (e->state) {
+        case XSAN_NVMF_EXPORT_ADD_PENDING:
+            _xsan_nvmf_export_free(e);
+            return XSAN_OK;
+        case XSAN_NVMF_EXPORT_ADDING:
+            e->remove_requested = true;
+            return XSAN_OK;
+        case XSAN_NVMF_EXPORT_ACTIVE:
+            e->state = XSAN_NVMF_EXPORT_REMOVE_PENDING;
+            break;
+        default:
+            return XSAN_OK; // Already on its way out
+        }
+    }
+    _xsan_nvmf_export_kick();
+    return XSAN_OK;
+}
+
+static void _xsan_nvmf_export_request_msg(void *arg) {
+    xsan_nvmf_export_req_t *req = (xsan_nvmf_export_req_t *)arg;
+    xsan_error_t err = _xsan_nvmf_export_request(&req->volume_id, req->add);
+    if (err != XSAN_OK && err != XSAN_ERROR_ALREADY_EXISTS && err != XSAN_ERROR_NOT_FOUND &&
+        err != XSAN_ERROR_NOT_INITIALIZED) {
+        char uuid_str[SPDK_UUID_STRING_LEN];
+        spdk_uuid_fmt_lower(uuid_str, sizeof(uuid_str), (const struct spdk_uuid *)&req->volume_id.data[0]);
+        XSAN_LOG_ERROR("Failed to %s volume %s (error %d).", req->add ? "export" : "unexport", uuid_str, err);
+    }
+    XSAN_FREE(req);
+}
+
+static xsan_error_t _xsan_nvmf_export_post(const xsan_volume_id_t *volume_id, bool add) {
+    struct spdk_thread *thread = g_xsan_nvmf_thread;
+    if (!thread) return XSAN_ERROR_NOT_INITIALIZED;
+    if (spdk_get_thread() == thread) {
+        return _xsan_nvmf_export_request(volume_id, add);
+    }
+    xsan_nvmf_export_req_t *req = (xsan_nvmf_export_req_t *)XSAN_MALLOC(sizeof(xsan_nvmf_export_req_t));
+    if (!req) return XSAN_ERROR_NO_MEMORY;
+    req->volume_id = *volume_id;
+    req->add = add;
+    if (spdk_thread_send_msg(thread, _xsan_nvmf_export_request_msg, req) != 0) {
+        XSAN_FREE(req);
+        return XSAN_ERROR_SYSTEM;
+    }
+    return XSAN_OK;
+}
+
+// Volume manager event callback; runs on whatever thread created or deleted the volume.
+static void _xsan_nvmf_volume_event_cb(void *cb_arg, xsan_volume_event_t event, const xsan_volume_t *volume) {
+    (void)cb_arg;
+    xsan_error_t err;
+    if (event == XSAN_VOLUME_EVENT_CREATED) {
+        err = _xsan_nvmf_export_post(&volume->id, true);
+    } else {
+        // The volume is freed once this returns: cut the vbdev off now, drop the namespace later.
+        xsan_vhost_detach_volume(volume->id);
+        err = _xsan_nvmf_export_post(&volume->id, false);
+    }
+    if (err != XSAN_OK && err != XSAN_ERROR_ALREADY_EXISTS && err != XSAN_ERROR_NOT_FOUND) {
+        XSAN_LOG_WARN("Volume '%s' event %d not applied to the NVMe-oF target (error %d).",
+                      volume->name, (int)event, err);
+    }
+}
+
 
 xsan_error_t xsan_nvmf_target_init(const char *target_nqn_param,
                                    const char *listen_addr,
@@ -67,38 +609,52 @@ xsan_error_t xsan_nvmf_target_init(const char *target_nqn_param,
         XSAN_LOG_ERROR("spdk_nvmf_tgt_create() failed.");
         return XSAN_ERROR_IO; // SPDK API 错误统一用 XSAN_ERROR_IO
     }
+    g_xsan_nvmf_thread = spdk_get_thread();
 
-    // 2. Create and configure the TCP transport (common default)
-    // Transport specific opts can be set in struct spdk_nvmf_transport_opts
+    // 2. Create and configure the TCP transport from the XSAN config (0 keeps the SPDK default)
+    if (!g_xsan_nvmf_opts_set) {
+        xsan_nvmf_target_opts_init(&g_xsan_nvmf_opts);
+    }
+    _xsan_nvmf_apply_sock_opts();
     struct spdk_nvmf_transport_opts transport_opts;
     spdk_nvmf_transport_opts_init("TCP", &transport_opts, sizeof(transport_opts));
-    // transport_opts.io_unit_size = 8192; // Example: Set IO unit size for this transport
-    // transport_opts.max_queue_depth = 128; // Example
+    _xsan_nvmf_apply_transport_opts(&transport_opts);
 
-    struct spdk_nvmf_transport *tcp_transport = spdk_nvmf_transport_create("TCP", &transport_opts);
-    if (!tcp_transport) {
+    g_xsan_tcp_transport = spdk_nvmf_transport_create("TCP", &transport_opts);
+    if (!g_xsan_tcp_transport) {
         XSAN_LOG_ERROR("spdk_nvmf_transport_create('TCP') failed.");
         spdk_nvmf_tgt_destroy(g_xsan_nvmf_tgt, NULL, NULL);
         g_xsan_nvmf_tgt = NULL;
         return XSAN_ERROR_IO;
     }
-    // g_xsan_tcp_transport = tcp_transport; // Store if needed for specific operations later
+    // The target owns the transport from here on and destroys it in spdk_nvmf_tgt_destroy.
+    g_xsan_nvmf_step_rc = 0;
+    __sync_add_and_fetch(&g_xsan_nvmf_pending, 1);
+    spdk_nvmf_tgt_add_transport(g_xsan_nvmf_tgt, g_xsan_tcp_transport, _xsan_nvmf_step_cb, NULL);
+    if (!_xsan_nvmf_wait_steps(XSAN_NVMF_TARGET_STEP_TIMEOUT_MS) || g_xsan_nvmf_step_rc != 0) {
+        XSAN_LOG_ERROR("spdk_nvmf_tgt_add_transport('TCP') failed (%d).", g_xsan_nvmf_step_rc);
+        xsan_nvmf_target_fini();
+        return XSAN_ERROR_IO;
+    }
+
+    // 3. One poll group per configured core; the transport is attached to each as it is created.
+    xsan_error_t err = _xsan_nvmf_create_poll_groups();
+    if (err != XSAN_OK) {
+        xsan_nvmf_target_fini();
+        return err;
+    }
 
-    // 3. Create a default NVMf Subsystem
-    // A subsystem is what an initiator discovers and connects to.
+    // 4. Create a default NVMf Subsystem
+    // A subsystem is what an initiator discovers and connects to. Every exported volume is a
+    // namespace of it, so it is sized for all of them up front.
+    uint32_t max_namespaces = g_xsan_nvmf_opts.max_namespaces ? g_xsan_nvmf_opts.max_namespaces
+                                                              : XSAN_NVMF_TARGET_DEFAULT_MAX_NAMESPACES;
     g_xsan_default_subsystem = spdk_nvmf_subsystem_create(g_xsan_nvmf_tgt, used_nqn,
                                                           SPDK_NVMF_SUBTYPE_NVME, // or SPDK_NVMF_SUBTYPE_DISCOVERY
-                                                          1); // Number of NS, can be increased dynamically
+                                                          max_namespaces);
     if (!g_xsan_default_subsystem) {
         XSAN_LOG_ERROR("spdk_nvmf_subsystem_create() failed for NQN %s.", used_nqn);
-        // spdk_nvmf_transport_destroy(tcp_transport); // How to get this handle back if not stored globally?
-        // Need a way to iterate and destroy transports if tgt_destroy doesn't do it.
-        // For now, assume tgt_destroy cleans up transports created for it if not explicitly destroyed.
-        // Better: SPDK examples show transports are usually created and then passed to tgt_listen.
-        // The target doesn't "own" transports created this way directly.
-        // Let's defer transport destruction to fini.
-        spdk_nvmf_tgt_destroy(g_xsan_nvmf_tgt, NULL, NULL);
-        g_xsan_nvmf_tgt = NULL;
+        xsan_nvmf_target_fini(); // Also destroys the transport, which the target owns now
         return XSAN_ERROR_TASK_FAILED;
     }
 
@@ -116,25 +672,31 @@ xsan_error_t xsan_nvmf_target_init(const char *target_nqn_param,
     }
 
 
-    // 4. Add a listener for the subsystem on the TCP transport
+    // 5. Listen on the TCP transport and add the listener to the subsystem
     struct spdk_nvme_transport_id trid = {};
     trid.trtype = SPDK_NVME_TRANSPORT_TCP;
     trid.adrfam = SPDK_NVMF_ADRFAM_IPV4;
     xsan_strcpy_safe(trid.traddr, listen_addr, sizeof(trid.traddr));
     snprintf(trid.trsvcid, sizeof(trid.trsvcid), "%s", listen_port_str);
+    struct spdk_nvmf_listen_opts listen_opts;
+    spdk_nvmf_listen_opts_init(&listen_opts, sizeof(listen_opts));
+    rc = spdk_nvmf_tgt_listen_ext(g_xsan_nvmf_tgt, &trid, &listen_opts);
+    if (rc != 0) {
+        XSAN_LOG_ERROR("Failed to listen on %s:%s: %s", listen_addr, listen_port_str, spdk_strerror(-rc));
+        xsan_nvmf_target_fini();
+        return XSAN_ERROR_NETWORK;
+    }
     spdk_nvmf_subsystem_add_listener(g_xsan_default_subsystem, &trid, NULL, NULL);
     // 错误处理需在回调中完成，这里不再判断 rc。
     XSAN_LOG_INFO("NVMe-oF Target listening on %s (IP: %s, Port: %s) for NQN: %s",
                   "TCP", listen_addr, listen_port_str, used_nqn);
 
-    // 5. Start the subsystem (makes it available for discovery and connection)
+    // 6. Start the subsystem (makes it available for discovery and connection)
     // Subsystems are started asynchronously. The callback is optional.
     rc = spdk_nvmf_subsystem_start(g_xsan_default_subsystem, NULL, NULL);
     if (rc != 0) {
          XSAN_LOG_ERROR("spdk_nvmf_subsystem_start() failed for NQN %s: %s", used_nqn, spdk_strerror(-rc));
-        // Complex cleanup needed here as listener might be active
-        // For simplicity, we might leak some resources on this specific error path
-        // or rely on higher level fini to clean up.
+        xsan_nvmf_target_fini();
         return XSAN_ERROR_TASK_FAILED;
     }
 
@@ -149,47 +711,114 @@ void xsan_nvmf_target_fini(void) {
     }
     XSAN_LOG_INFO("Finalizing XSAN NVMe-oF Target...");
 
-    // Subsystems (and their namespaces, listeners) should be destroyed before the target.
-    // SPDK's spdk_nvmf_tgt_destroy is supposed to clean up its subsystems.
-    // If we created subsystems separately and need specific cleanup for them:
+    // No new namespace changes; let the one in flight finish, its callbacks hold the record.
+    if (g_xsan_nvmf_auto_export_vm) {
+        xsan_volume_manager_set_event_cb(g_xsan_nvmf_auto_export_vm, NULL, NULL);
+        g_xsan_nvmf_auto_export_vm = NULL;
+    }
+    g_xsan_nvmf_exports_stopping = true;
+    spdk_poller_unregister(&g_xsan_nvmf_export_retry);
+    uint64_t deadline = spdk_get_ticks() + spdk_get_ticks_hz() * XSAN_NVMF_TARGET_STEP_TIMEOUT_MS / 1000;
+    while (g_xsan_nvmf_export_busy && spdk_get_ticks() <= deadline) {
+        if (spdk_thread_poll(spdk_get_thread(), 0, 0) == 0) usleep(10);
+    }
+    if (g_xsan_nvmf_export_busy) {
+        XSAN_LOG_WARN("Timed out waiting for the namespace change of %s.", g_xsan_nvmf_export_busy->bdev_name);
+    }
+
+    // The subsystem is stopped first so its qpairs leave the poll groups; the groups go next,
+    // and spdk_nvmf_tgt_destroy then frees the subsystem, listeners and the transport.
     if (g_xsan_default_subsystem) {
-        // To stop it if subsystem_destroy doesn't imply stop:
-        // spdk_nvmf_subsystem_stop(g_xsan_default_subsystem, NULL, NULL); // Async, wait if needed
-        // spdk_nvmf_subsystem_set_state(g_xsan_default_subsystem, SPDK_NVMF_SUBSYSTEM_STATE_INACTIVE);
-        // spdk_nvmf_subsystem_pause(g_xsan_default_subsystem, NULL, NULL);
-
-        // Destroying the subsystem should also remove its listeners and namespaces.
-        // The spdk_nvmf_subsystem_destroy is asynchronous.
-        // For a synchronous-like fini, one might need to use the callback or poll.
-        // For simplicity in this example, we call destroy.
-        // Proper shutdown might involve spdk_nvmf_subsystem_stop() first.
-        // Let's assume tgt_destroy handles subsystems correctly.
-        XSAN_LOG_DEBUG("Default subsystem NQN %s will be destroyed by tgt_destroy.", spdk_nvmf_subsystem_get_nqn(g_xsan_default_subsystem));
-        g_xsan_default_subsystem = NULL; // tgt_destroy should handle it.
-    }
-
-    spdk_nvmf_tgt_destroy(g_xsan_nvmf_tgt, NULL, NULL); // Also async.
+        __sync_add_and_fetch(&g_xsan_nvmf_pending, 1);
+        int rc = spdk_nvmf_subsystem_stop(g_xsan_default_subsystem, _xsan_nvmf_subsystem_step_cb, NULL);
+        if (rc != 0) {
+            XSAN_LOG_DEBUG("spdk_nvmf_subsystem_stop() returned %s; subsystem was not active.", spdk_strerror(-rc));
+            __sync_sub_and_fetch(&g_xsan_nvmf_pending, 1);
+        } else if (!_xsan_nvmf_wait_steps(XSAN_NVMF_TARGET_STEP_TIMEOUT_MS)) {
+            XSAN_LOG_WARN("Timed out stopping subsystem %s.", spdk_nvmf_subsystem_get_nqn(g_xsan_default_subsystem));
+        }
+        g_xsan_default_subsystem = NULL; // tgt_destroy frees it.
+    }
+
+    _xsan_nvmf_destroy_poll_groups();
+
+    __sync_add_and_fetch(&g_xsan_nvmf_pending, 1);
+    spdk_nvmf_tgt_destroy(g_xsan_nvmf_tgt, _xsan_nvmf_tgt_destroyed, NULL);
+    if (!_xsan_nvmf_wait_steps(XSAN_NVMF_TARGET_STEP_TIMEOUT_MS)) {
+        XSAN_LOG_WARN("Timed out waiting for the NVMe-oF target to be destroyed.");
+    }
     g_xsan_nvmf_tgt = NULL;
+    g_xsan_tcp_transport = NULL;
 
-    // Transports are typically managed globally by SPDK after creation
-    // and might be destroyed via spdk_nvmf_transport_destroy if we have the handle
-    // or during spdk_app_fini. For transports created with opts and passed to tgt_listen,
-    // they are often managed by the target.
-    // If we called spdk_nvmf_transport_create, we should call spdk_nvmf_transport_destroy.
-    // Let's assume for now that spdk_app_fini or tgt_destroy handles transports if not explicitly.
-    // This needs verification against SPDK examples for the specific transport creation method.
-    // If spdk_nvmf_transport_create was used, we need to destroy it:
-    // struct spdk_nvmf_transport *tcp_transport = spdk_nvmf_get_transport("TCP");
-    // if (tcp_transport) {
-    //     spdk_nvmf_transport_destroy(tcp_transport, NULL, NULL);
-    // }
-    // However, getting it by name might not be safe if multiple exist or if it was already cleaned.
-    // Better to store g_xsan_tcp_transport if we create it.
-    // For now, relying on SPDK's higher-level cleanup (spdk_app_fini).
+    // The namespaces went with the subsystem; now their vbdevs can go.
+    if (!g_xsan_nvmf_export_busy) {
+        while (g_xsan_nvmf_exports) {
+            _xsan_nvmf_export_free(g_xsan_nvmf_exports);
+        }
+    }
+    g_xsan_nvmf_export_busy = NULL;
+    g_xsan_nvmf_exports = NULL; // Leaked if a change never completed
+    g_xsan_nvmf_export_count = 0;
+    g_xsan_nvmf_exports_stopping = false;
+    g_xsan_nvmf_thread = NULL;
 
     XSAN_LOG_INFO("XSAN NVMe-oF Target finalized.");
 }
 
+uint32_t xsan_nvmf_target_get_poll_group_count(void) {
+    return g_xsan_nvmf_tgt ? g_xsan_nvmf_num_poll_groups : 0;
+}
+
+xsan_error_t xsan_nvmf_target_export_volume(xsan_volume_id_t volume_id) {
+    return _xsan_nvmf_export_post(&volume_id, true);
+}
+
+xsan_error_t xsan_nvmf_target_unexport_volume(xsan_volume_id_t volume_id) {
+    return _xsan_nvmf_export_post(&volume_id, false);
+}
+
+xsan_error_t xsan_nvmf_target_enable_auto_export(xsan_volume_manager_t *vm) {
+    if (!vm) return XSAN_ERROR_INVALID_PARAM;
+    if (!g_xsan_default_subsystem) return XSAN_ERROR_NOT_INITIALIZED;
+    if (spdk_get_thread() != g_xsan_nvmf_thread) {
+        XSAN_LOG_ERROR("Auto export must be enabled on the NVMe-oF target's init thread.");
+        return XSAN_ERROR_THREAD_CONTEXT;
+    }
+
+    // Register first so no volume created meanwhile is missed; one listed twice is ignored.
+    xsan_error_t err = xsan_volume_manager_set_event_cb(vm, _xsan_nvmf_volume_event_cb, NULL);
+    if (err != XSAN_OK) return err;
+    g_xsan_nvmf_auto_export_vm = vm;
+
+    xsan_volume_t **volumes = NULL;
+    int count = 0;
+    err = xsan_volume_list_all(vm, &volumes, &count);
+    if (err != XSAN_OK) {
+        xsan_volume_manager_set_event_cb(vm, NULL, NULL);
+        g_xsan_nvmf_auto_export_vm = NULL;
+        return err;
+    }
+    for (int i = 0; i < count; ++i) {
+        err = _xsan_nvmf_export_request(&volumes[i]->id, true);
+        if (err == XSAN_ERROR_INSUFFICIENT_SPACE) {
+            XSAN_LOG_ERROR("Default subsystem is full; %d volume(s) not exported. Raise nvmf.max_namespaces.",
+                           count - i);
+            break;
+        }
+        if (err != XSAN_OK && err != XSAN_ERROR_ALREADY_EXISTS) {
+            XSAN_LOG_WARN("Failed to export volume '%s' (error %d).", volumes[i]->name, err);
+        }
+    }
+    xsan_volume_manager_free_volume_pointer_list(volumes);
+    XSAN_LOG_INFO("Auto export enabled; %d existing volume(s) queued as NVMe-oF namespaces.", count);
+    return XSAN_OK;
+}
+
+uint32_t xsan_nvmf_target_get_volume_nsid(xsan_volume_id_t volume_id) {
+    xsan_nvmf_export_t *e = _xsan_nvmf_export_find(&volume_id);
+    return (e && e->state >= XSAN_NVMF_EXPORT_ACTIVE) ? e->nsid : 0;
+}
+
 xsan_error_t xsan_nvmf_target_add_namespace(const char *bdev_name, uint32_t nsid, const char *volume_uuid_str) {
     // STUB
     XSAN_LOG_WARN("xsan_nvmf_target_add_namespace for bdev '%s' (NSID %u) - STUB", bdev_name, nsid);
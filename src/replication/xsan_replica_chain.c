@@ -0,0 +1,79 @@
+#include "xsan_replica_chain.h"
+#include "xsan_string_utils.h"
+
+#include <string.h>
+
+void xsan_replica_chain_hop_from_location(xsan_replica_chain_hop_t *hop, const xsan_replica_location_t *loc) {
+    if (!hop || !loc) return;
+    memset(hop, 0, sizeof(*hop));
+    memcpy(&hop->node_id, &loc->node_id, sizeof(xsan_node_id_t));
+    xsan_strcpy_safe(hop->node_ip_addr, loc->node_ip_addr, sizeof(hop->node_ip_addr));
+    hop->node_comm_port = loc->node_comm_port;
+}
+
+static bool _hop_addr_valid(const xsan_replica_chain_hop_t *hop) {
+    return memchr(hop->node_ip_addr, '\0', sizeof(hop->node_ip_addr)) != NULL &&
+           hop->node_ip_addr[0] != '\0' && hop->node_comm_port != 0;
+}
+
+bool xsan_replica_chain_req_hops_valid(const xsan_replica_chain_write_req_payload_t *req) {
+    if (!req) return false;
+    // The receiver's ack carries its own status plus one per downstream hop.
+    if (req->chain_num_downstream > XSAN_REPLICA_CHAIN_MAX_HOPS - 1) return false;
+    if (!_hop_addr_valid(&req->upstream)) return false;
+    for (uint32_t i = 0; i < req->chain_num_downstream; ++i) {
+        if (!_hop_addr_valid(&req->chain_downstream[i])) return false;
+    }
+    return true;
+}
+
+xsan_error_t xsan_replica_chain_req_init(xsan_replica_chain_write_req_payload_t *req,
+                                         const xsan_replica_write_req_payload_t *write,
+                                         const xsan_replica_chain_hop_t *self,
+                                         const xsan_replica_location_t *hops, uint32_t num_hops, uint32_t head) {
+    if (!req || !write || !self || !hops || head >= num_hops) return XSAN_ERROR_INVALID_PARAM;
+    uint32_t num_downstream = num_hops - head - 1;
+    if (num_downstream > XSAN_REPLICA_CHAIN_MAX_HOPS - 1) return XSAN_ERROR_INVALID_PARAM;
+
+    memset(req, 0, sizeof(*req));
+    memcpy(&req->write, write, sizeof(req->write));
+    memcpy(&req->upstream, self, sizeof(req->upstream));
+    req->chain_num_downstream = (uint8_t)num_downstream;
+    for (uint32_t j = 0; j < num_downstream; ++j) {
+        xsan_replica_chain_hop_from_location(&req->chain_downstream[j], &hops[head + 1 + j]);
+    }
+    return XSAN_OK;
+}
+
+void xsan_replica_chain_req_shift(const xsan_replica_chain_write_req_payload_t *req,
+                                  const xsan_replica_chain_hop_t *self,
+                                  xsan_replica_chain_write_req_payload_t *fwd_out) {
+    memset(fwd_out, 0, sizeof(*fwd_out));
+    memcpy(&fwd_out->write, &req->write, sizeof(fwd_out->write));
+    memcpy(&fwd_out->upstream, self, sizeof(fwd_out->upstream));
+    fwd_out->chain_num_downstream = (uint8_t)(req->chain_num_downstream - 1);
+    for (uint32_t j = 0; j < fwd_out->chain_num_downstream; ++j) {
+        memcpy(&fwd_out->chain_downstream[j], &req->chain_downstream[j + 1], sizeof(xsan_replica_chain_hop_t));
+    }
+}
+
+xsan_error_t xsan_replica_chain_ack_statuses(const xsan_replica_chain_write_resp_payload_t *resp,
+                                             const xsan_node_id_t *expected_responder,
+                                             uint32_t num_expected, xsan_error_t *statuses_out) {
+    if (!resp || !expected_responder || !statuses_out || num_expected == 0 ||
+        num_expected > XSAN_REPLICA_CHAIN_MAX_HOPS) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    if (memcmp(&resp->responder_node_id, expected_responder, sizeof(xsan_node_id_t)) != 0) {
+        return XSAN_ERROR_REPLICA_NOT_FOUND;
+    }
+    if (resp->chain_num_statuses == 0) return XSAN_ERROR_INVALID_PARAM;
+
+    uint32_t reported = resp->chain_num_statuses;
+    if (reported > XSAN_REPLICA_CHAIN_MAX_HOPS) reported = XSAN_REPLICA_CHAIN_MAX_HOPS;
+    if (reported > num_expected) reported = num_expected;
+    for (uint32_t k = 0; k < num_expected; ++k) {
+        statuses_out[k] = (k < reported) ? resp->chain_statuses[k] : XSAN_ERROR_REPLICATION_GENERIC;
+    }
+    return XSAN_OK;
+}
@@ -0,0 +1,501 @@
+#include "xsan_replica_write_batch.h"
+#include "xsan_protocol.h"
+#include "xsan_node_comm.h"
+#include "xsan_txn.h"
+#include "xsan_memory.h"
+#include "xsan_log.h"
+#include "xsan_string_utils.h"
+
+#include "spdk/env.h"
+#include "spdk/thread.h"
+
+#include <arpa/inet.h> // For INET6_ADDRSTRLEN
+#include <errno.h>
+#include <string.h>
+
+/** Payload buffers each reactor keeps for reuse instead of returning them to the allocator. */
+#define XSAN_REPLICA_WRITE_BATCH_POOL_BUFS 4
+
+/**
+ * A batch under construction (open) or waiting to be sent (sealed).
+ * Write data is copied once, into buf past the shard's hdr_reserve bytes. Sealing writes the
+ * batch header and extent table immediately in front of the data, so msg->payload points into
+ * buf and is sent without another copy.
+ */
+typedef struct xsan_write_batch {
+    uint32_t num_extents;
+    uint32_t data_len;
+    uint64_t opened_at_ticks;
+    xsan_replica_write_extent_t extents[XSAN_REPLICA_WRITE_BATCH_MAX_EXTENTS];
+    xsan_node_send_cb_t sent_cbs[XSAN_REPLICA_WRITE_BATCH_MAX_EXTENTS];
+    void *sent_cb_args[XSAN_REPLICA_WRITE_BATCH_MAX_EXTENTS];
+    unsigned char *buf;
+    xsan_message_t *msg;
+    struct xsan_batch_peer *peer;
+    struct xsan_write_batch *next;
+} xsan_write_batch_t;
+
+/**
+ * Per-destination state of one reactor: the open batch and the sealed queue. Batches are
+ * sent on that reactor's own connection to the peer (see xsan_node_comm_get_active_connection).
+ */
+typedef struct xsan_batch_peer {
+    char ip[INET6_ADDRSTRLEN];
+    uint16_t port;
+    bool connecting;
+    xsan_write_batch_t *open;
+    xsan_write_batch_t *sealed_head;
+    xsan_write_batch_t *sealed_tail;
+    struct xsan_batch_shard *shard;
+    struct xsan_batch_peer *next;
+} xsan_batch_peer_t;
+
+/**
+ * Everything one reactor batches. Only the owning thread touches it, so nothing is locked;
+ * the counters are stored with relaxed atomics so get_stats can read them from any thread.
+ */
+typedef struct xsan_batch_shard {
+    struct spdk_thread *thread;
+    xsan_replica_write_batcher_opts_t opts;
+    uint64_t window_ticks;
+    uint32_t hdr_reserve;       // Bytes in front of the data for the batch header and a full extent table
+    xsan_batch_peer_t *peers;
+    struct spdk_poller *window_poller;
+    unsigned char *free_bufs;   // Pooled payload buffers, linked through their first bytes
+    uint32_t num_free_bufs;
+    uint32_t inflight;          // Sends and connects handed to node comm that have not called back
+    bool stopping;
+    xsan_replica_write_batcher_stats_t stats;
+} xsan_batch_shard_t;
+
+struct xsan_replica_write_batcher {
+    xsan_replica_write_batcher_opts_t opts;
+    xsan_batch_shard_t *shards[XSAN_TXN_MAX_SHARDS]; // Indexed by xsan_txn_local_shard; created on first submit
+};
+
+static void _batch_peer_pump(xsan_batch_peer_t *peer);
+
+void xsan_replica_write_batcher_opts_init(xsan_replica_write_batcher_opts_t *opts) {
+    if (!opts) return;
+    opts->window_us = XSAN_REPLICA_WRITE_BATCH_DEFAULT_WINDOW_US;
+    opts->max_extents = XSAN_REPLICA_WRITE_BATCH_DEFAULT_MAX_EXTENTS;
+    opts->max_bytes = XSAN_REPLICA_WRITE_BATCH_DEFAULT_MAX_BYTES;
+    opts->max_extent_bytes = XSAN_REPLICA_WRITE_BATCH_DEFAULT_MAX_EXTENT_BYTES;
+}
+
+// Single writer per counter; the atomic store only keeps concurrent get_stats readers well defined.
+static inline void _shard_stat_add(uint64_t *counter, uint64_t n) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+static unsigned char *_shard_buf_get(xsan_batch_shard_t *shard) {
+    unsigned char *buf = shard->free_bufs;
+    if (buf) {
+        memcpy(&shard->free_bufs, buf, sizeof(shard->free_bufs));
+        shard->num_free_bufs--;
+        return buf;
+    }
+    return (unsigned char *)XSAN_MALLOC(shard->hdr_reserve + shard->opts.max_bytes);
+}
+
+static void _shard_buf_put(xsan_batch_shard_t *shard, unsigned char *buf) {
+    if (shard->stopping || shard->num_free_bufs >= XSAN_REPLICA_WRITE_BATCH_POOL_BUFS) {
+        XSAN_FREE(buf);
+        return;
+    }
+    memcpy(buf, &shard->free_bufs, sizeof(shard->free_bufs));
+    shard->free_bufs = buf;
+    shard->num_free_bufs++;
+}
+
+// xsan_message_payload_free_fn_t for batch payloads, which live inside the batch's pooled buffer.
+static void _write_batch_payload_free(void *payload, void *arg) {
+    xsan_write_batch_t *batch = (xsan_write_batch_t *)arg;
+    (void)payload;
+    _shard_buf_put(batch->peer->shard, batch->buf);
+    batch->buf = NULL;
+}
+
+static void _write_batch_free(xsan_write_batch_t *batch) {
+    if (!batch) return;
+    if (batch->msg) xsan_protocol_message_destroy(batch->msg);
+    if (batch->buf) _shard_buf_put(batch->peer->shard, batch->buf);
+    XSAN_FREE(batch);
+}
+
+// Completes every write carried by the batch with the given send status, then frees it.
+static void _write_batch_complete(xsan_write_batch_t *batch, int status) {
+    for (uint32_t i = 0; i < batch->num_extents; ++i) {
+        batch->sent_cbs[i](status, batch->sent_cb_args[i]);
+    }
+    _write_batch_free(batch);
+}
+
+static void _write_batch_fail_list(xsan_write_batch_t *head, int status) {
+    while (head) {
+        xsan_write_batch_t *next = head->next;
+        _write_batch_complete(head, status);
+        head = next;
+    }
+}
+
+static void _batch_shard_free(xsan_batch_shard_t *shard) {
+    xsan_batch_peer_t *p = shard->peers;
+    while (p) {
+        xsan_batch_peer_t *next = p->next;
+        XSAN_FREE(p);
+        p = next;
+    }
+    while (shard->free_bufs) {
+        unsigned char *buf = shard->free_bufs;
+        memcpy(&shard->free_bufs, buf, sizeof(shard->free_bufs));
+        XSAN_FREE(buf);
+    }
+    XSAN_FREE(shard);
+}
+
+// Drops one outstanding node comm callback; the last one frees a stopped shard.
+static void _batch_shard_put_inflight(xsan_batch_shard_t *shard) {
+    if (--shard->inflight == 0 && shard->stopping) {
+        _batch_shard_free(shard);
+    }
+}
+
+static xsan_batch_peer_t *_shard_get_peer(xsan_batch_shard_t *shard, const char *ip, uint16_t port) {
+    for (xsan_batch_peer_t *p = shard->peers; p; p = p->next) {
+        if (p->port == port && strcmp(p->ip, ip) == 0) {
+            return p;
+        }
+    }
+    xsan_batch_peer_t *p = (xsan_batch_peer_t *)XSAN_CALLOC(1, sizeof(*p));
+    if (!p) return NULL;
+    xsan_strcpy_safe(p->ip, ip, sizeof(p->ip));
+    p->port = port;
+    p->shard = shard;
+    p->next = shard->peers;
+    shard->peers = p;
+    return p;
+}
+
+/**
+ * Turns the peer's open batch into one message and appends it to the sealed queue.
+ * A batch whose message cannot be built is moved to *failed_out.
+ */
+static void _batch_peer_seal_open(xsan_batch_peer_t *peer, xsan_write_batch_t **failed_out) {
+    xsan_write_batch_t *batch = peer->open;
+    if (!batch || batch->num_extents == 0) return;
+    peer->open = NULL;
+    batch->next = NULL;
+
+    // The first write's TID labels the batch; replies are matched per extent, not by this TID.
+    batch->msg = xsan_protocol_message_create(XSAN_MSG_TYPE_REPLICA_WRITE_BATCH_REQ,
+                                              batch->extents[0].transaction_id, NULL, 0);
+    if (!batch->msg) {
+        XSAN_LOG_ERROR("Failed to build replica write batch (%u writes) for %s:%u.", batch->num_extents, peer->ip, peer->port);
+        batch->next = *failed_out;
+        *failed_out = batch;
+        return;
+    }
+
+    xsan_replica_write_batch_req_payload_t req_hdr = { .num_extents = batch->num_extents };
+    uint32_t hdr_len = sizeof(req_hdr) + sizeof(xsan_replica_write_extent_t) * batch->num_extents;
+    unsigned char *payload = batch->buf + peer->shard->hdr_reserve - hdr_len;
+    memcpy(payload, &req_hdr, sizeof(req_hdr));
+    memcpy(payload + sizeof(req_hdr), batch->extents, sizeof(xsan_replica_write_extent_t) * batch->num_extents);
+    batch->msg->header.payload_length = hdr_len + batch->data_len;
+    batch->msg->payload = payload;
+    batch->msg->payload_free = _write_batch_payload_free;
+    batch->msg->payload_free_arg = batch;
+
+    if (peer->sealed_tail) {
+        peer->sealed_tail->next = batch;
+    } else {
+        peer->sealed_head = batch;
+    }
+    peer->sealed_tail = batch;
+}
+
+static void _batch_sent_cb(int status, void *cb_arg) {
+    xsan_write_batch_t *batch = (xsan_write_batch_t *)cb_arg;
+    xsan_batch_peer_t *peer = batch->peer;
+    xsan_batch_shard_t *shard = peer->shard;
+
+    if (status == 0) {
+        _shard_stat_add(&shard->stats.batches_sent, 1);
+        _shard_stat_add(&shard->stats.extents_sent, batch->num_extents);
+        _shard_stat_add(&shard->stats.bytes_sent, batch->data_len);
+    } else {
+        _shard_stat_add(&shard->stats.send_failures, 1);
+        XSAN_LOG_WARN("Replica write batch (%u writes) to %s:%u failed to send: %d",
+                      batch->num_extents, peer->ip, peer->port, status);
+    }
+    _write_batch_complete(batch, status);
+    _batch_shard_put_inflight(shard);
+}
+
+static void _batch_peer_connect_cb(struct spdk_sock *sock, int status, void *cb_arg) {
+    xsan_batch_peer_t *peer = (xsan_batch_peer_t *)cb_arg;
+    xsan_batch_shard_t *shard = peer->shard;
+
+    peer->connecting = false;
+    if (shard->stopping) {
+        // The shard cancelled its queues when it stopped; only the connect was still outstanding.
+    } else if (status != 0 || !sock) {
+        // Everything sealed so far was waiting on this connection.
+        xsan_write_batch_t *failed = peer->sealed_head;
+        peer->sealed_head = peer->sealed_tail = NULL;
+        _shard_stat_add(&shard->stats.send_failures, 1);
+        XSAN_LOG_WARN("Connect to %s:%u for batched replica writes failed: %d", peer->ip, peer->port, status);
+        _write_batch_fail_list(failed, status ? status : -ENOTCONN);
+    } else {
+        _batch_peer_pump(peer);
+    }
+    _batch_shard_put_inflight(shard);
+}
+
+/**
+ * Sends sealed batches in order until the queue is empty or the connection is busy.
+ * Connects first if this reactor has no connection to the peer yet.
+ */
+static void _batch_peer_pump(xsan_batch_peer_t *peer) {
+    xsan_batch_shard_t *shard = peer->shard;
+
+    while (peer->sealed_head && !peer->connecting && !shard->stopping) {
+        struct spdk_sock *sock = xsan_node_comm_get_active_connection(peer->ip, peer->port);
+        if (!sock) {
+            peer->connecting = true;
+            shard->inflight++;
+            xsan_error_t c_err = xsan_node_comm_connect(peer->ip, peer->port, _batch_peer_connect_cb, peer);
+            if (c_err != XSAN_OK) {
+                _batch_peer_connect_cb(NULL, -ENOTCONN, peer);
+            }
+            return;
+        }
+        xsan_write_batch_t *batch = peer->sealed_head;
+        peer->sealed_head = batch->next;
+        if (!peer->sealed_head) peer->sealed_tail = NULL;
+        batch->next = NULL;
+
+        shard->inflight++;
+        xsan_error_t s_err = xsan_node_comm_send_msg(sock, batch->msg, _batch_sent_cb, batch);
+        if (s_err == XSAN_ERROR_BUSY) {
+            // The connection's send queue is full; the window poller retries.
+            shard->inflight--;
+            batch->next = peer->sealed_head;
+            peer->sealed_head = batch;
+            if (!peer->sealed_tail) peer->sealed_tail = batch;
+            return;
+        }
+        if (s_err != XSAN_OK) {
+            _batch_sent_cb(-EIO, batch);
+        }
+    }
+}
+
+static int _batch_shard_window_poller(void *arg) {
+    xsan_batch_shard_t *shard = (xsan_batch_shard_t *)arg;
+    uint64_t now = spdk_get_ticks();
+    xsan_write_batch_t *failed = NULL;
+    bool did_work = false;
+
+    for (xsan_batch_peer_t *p = shard->peers; p; p = p->next) {
+        if (p->open && p->open->num_extents > 0 && now - p->open->opened_at_ticks >= shard->window_ticks) {
+            _batch_peer_seal_open(p, &failed);
+            _shard_stat_add(&shard->stats.flushes_window, 1);
+        }
+    }
+    _write_batch_fail_list(failed, -ENOMEM);
+    for (xsan_batch_peer_t *p = shard->peers; p; p = p->next) {
+        if (p->sealed_head) {
+            _batch_peer_pump(p);
+            did_work = true;
+        }
+    }
+    return did_work ? SPDK_POLLER_BUSY : SPDK_POLLER_IDLE;
+}
+
+// Returns the calling reactor's shard, creating it and its window poller on first use if asked.
+// Threads that do not own a transaction shard get NULL and send their writes unbatched.
+static xsan_batch_shard_t *_batcher_local_shard(xsan_replica_write_batcher_t *b, bool create) {
+    uint32_t idx;
+    if (!xsan_txn_local_shard(&idx)) return NULL;
+    xsan_batch_shard_t *shard = __atomic_load_n(&b->shards[idx], __ATOMIC_ACQUIRE);
+    if (shard || !create) return shard;
+
+    shard = (xsan_batch_shard_t *)XSAN_CALLOC(1, sizeof(*shard));
+    if (!shard) return NULL;
+    shard->thread = spdk_get_thread();
+    shard->opts = b->opts;
+    shard->window_ticks = (uint64_t)b->opts.window_us * spdk_get_ticks_hz() / SPDK_SEC_TO_USEC;
+    shard->hdr_reserve = sizeof(xsan_replica_write_batch_req_payload_t) +
+                         sizeof(xsan_replica_write_extent_t) * b->opts.max_extents;
+    // With no window every submit seals, and the poller only retries sends that found the connection busy.
+    uint64_t period_us = b->opts.window_us ? b->opts.window_us : XSAN_REPLICA_WRITE_BATCH_DEFAULT_WINDOW_US;
+    shard->window_poller = SPDK_POLLER_REGISTER(_batch_shard_window_poller, shard, period_us);
+    if (!shard->window_poller) {
+        XSAN_LOG_ERROR("Failed to register replica write batch poller on shard %u.", idx);
+        XSAN_FREE(shard);
+        return NULL;
+    }
+    __atomic_store_n(&b->shards[idx], shard, __ATOMIC_RELEASE);
+    return shard;
+}
+
+xsan_replica_write_batcher_t *xsan_replica_write_batcher_create(const xsan_replica_write_batcher_opts_t *opts) {
+    xsan_replica_write_batcher_t *b = (xsan_replica_write_batcher_t *)XSAN_CALLOC(1, sizeof(*b));
+    if (!b) return NULL;
+
+    if (opts) {
+        b->opts = *opts;
+    } else {
+        xsan_replica_write_batcher_opts_init(&b->opts);
+    }
+    if (b->opts.max_extents == 0 || b->opts.max_extents > XSAN_REPLICA_WRITE_BATCH_MAX_EXTENTS) {
+        b->opts.max_extents = XSAN_REPLICA_WRITE_BATCH_MAX_EXTENTS;
+    }
+    if (b->opts.max_bytes == 0) b->opts.max_bytes = XSAN_REPLICA_WRITE_BATCH_DEFAULT_MAX_BYTES;
+    if (b->opts.max_extent_bytes == 0 || b->opts.max_extent_bytes > b->opts.max_bytes) {
+        b->opts.max_extent_bytes = b->opts.max_bytes;
+    }
+    XSAN_LOG_INFO("Replica write batching enabled: window %u us, up to %u writes / %u bytes per batch, writes <= %u bytes.",
+                  b->opts.window_us, b->opts.max_extents, b->opts.max_bytes, b->opts.max_extent_bytes);
+    return b;
+}
+
+// Runs on the shard's own thread: stops its poller and cancels what was not yet handed to node comm.
+// Batches already on a connection finish through _batch_sent_cb, and the last callback frees the shard.
+static void _batch_shard_stop(void *arg) {
+    xsan_batch_shard_t *shard = (xsan_batch_shard_t *)arg;
+    spdk_poller_unregister(&shard->window_poller);
+    shard->stopping = true;
+    for (xsan_batch_peer_t *p = shard->peers; p; p = p->next) {
+        xsan_write_batch_t *queued = p->sealed_head;
+        p->sealed_head = p->sealed_tail = NULL;
+        if (p->open) {
+            p->open->next = queued;
+            queued = p->open;
+            p->open = NULL;
+        }
+        _write_batch_fail_list(queued, -ECANCELED);
+    }
+    if (shard->inflight == 0) {
+        _batch_shard_free(shard);
+    }
+}
+
+void xsan_replica_write_batcher_destroy(xsan_replica_write_batcher_t *batcher) {
+    if (!batcher) return;
+    for (uint32_t i = 0; i < XSAN_TXN_MAX_SHARDS; ++i) {
+        xsan_batch_shard_t *shard = batcher->shards[i];
+        if (!shard) continue;
+        batcher->shards[i] = NULL;
+        // Pollers can only be unregistered from their own thread.
+        if (shard->thread == spdk_get_thread()) {
+            _batch_shard_stop(shard);
+        } else if (spdk_thread_send_msg(shard->thread, _batch_shard_stop, shard) != 0) {
+            XSAN_LOG_WARN("Could not stop replica write batching on shard %u; leaking it.", i);
+        }
+    }
+    XSAN_FREE(batcher);
+}
+
+bool xsan_replica_write_batcher_accepts(const xsan_replica_write_batcher_t *batcher, uint32_t data_len) {
+    uint32_t idx;
+    return batcher && data_len > 0 && data_len <= batcher->opts.max_extent_bytes && xsan_txn_local_shard(&idx);
+}
+
+xsan_error_t xsan_replica_write_batcher_submit(xsan_replica_write_batcher_t *batcher,
+                                               const char *ip, uint16_t port,
+                                               uint64_t transaction_id,
+                                               const xsan_volume_id_t *volume_id,
+                                               uint64_t block_lba_on_volume,
+                                               uint32_t num_blocks,
+                                               const void *data, uint32_t data_len,
+                                               xsan_node_send_cb_t sent_cb, void *cb_arg) {
+    if (!ip || port == 0 || !volume_id || !data || !sent_cb || !xsan_replica_write_batcher_accepts(batcher, data_len)) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+
+    xsan_batch_shard_t *shard = _batcher_local_shard(batcher, true);
+    xsan_batch_peer_t *peer = shard ? _shard_get_peer(shard, ip, port) : NULL;
+    if (!peer) return XSAN_ERROR_OUT_OF_MEMORY;
+
+    xsan_write_batch_t *failed = NULL;
+    bool sealed = false;
+    if (peer->open && peer->open->data_len + data_len > shard->opts.max_bytes) {
+        _batch_peer_seal_open(peer, &failed);
+        _shard_stat_add(&shard->stats.flushes_full, 1);
+        sealed = true;
+    }
+    if (!peer->open) {
+        xsan_write_batch_t *batch = (xsan_write_batch_t *)XSAN_MALLOC(sizeof(*batch));
+        unsigned char *buf = batch ? _shard_buf_get(shard) : NULL;
+        if (!batch || !buf) {
+            if (batch) XSAN_FREE(batch);
+            _write_batch_fail_list(failed, -ENOMEM);
+            if (sealed) _batch_peer_pump(peer);
+            return XSAN_ERROR_OUT_OF_MEMORY;
+        }
+        memset(batch, 0, sizeof(*batch));
+        batch->buf = buf;
+        batch->peer = peer;
+        batch->opened_at_ticks = spdk_get_ticks();
+        peer->open = batch;
+    }
+
+    xsan_write_batch_t *batch = peer->open;
+    uint32_t idx = batch->num_extents++;
+    xsan_replica_write_extent_t *ext = &batch->extents[idx];
+    ext->transaction_id = transaction_id;
+    memcpy(&ext->volume_id, volume_id, sizeof(xsan_volume_id_t));
+    ext->block_lba_on_volume = block_lba_on_volume;
+    ext->num_blocks = num_blocks;
+    ext->data_len = data_len;
+    batch->sent_cbs[idx] = sent_cb;
+    batch->sent_cb_args[idx] = cb_arg;
+    memcpy(batch->buf + shard->hdr_reserve + batch->data_len, data, data_len);
+    batch->data_len += data_len;
+
+    if (batch->num_extents >= shard->opts.max_extents || batch->data_len >= shard->opts.max_bytes || shard->opts.window_us == 0) {
+        _batch_peer_seal_open(peer, &failed);
+        _shard_stat_add(&shard->stats.flushes_full, 1);
+        sealed = true;
+    }
+
+    _write_batch_fail_list(failed, -ENOMEM);
+    if (sealed) {
+        _batch_peer_pump(peer);
+    }
+    return XSAN_OK;
+}
+
+void xsan_replica_write_batcher_flush(xsan_replica_write_batcher_t *batcher) {
+    xsan_batch_shard_t *shard = batcher ? _batcher_local_shard(batcher, false) : NULL;
+    if (!shard) return;
+    xsan_write_batch_t *failed = NULL;
+
+    for (xsan_batch_peer_t *p = shard->peers; p; p = p->next) {
+        _batch_peer_seal_open(p, &failed);
+    }
+    _write_batch_fail_list(failed, -ENOMEM);
+    for (xsan_batch_peer_t *p = shard->peers; p; p = p->next) {
+        _batch_peer_pump(p);
+    }
+}
+
+xsan_error_t xsan_replica_write_batcher_get_stats(xsan_replica_write_batcher_t *batcher,
+                                                  xsan_replica_write_batcher_stats_t *stats_out) {
+    if (!batcher || !stats_out) return XSAN_ERROR_INVALID_PARAM;
+    memset(stats_out, 0, sizeof(*stats_out));
+    for (uint32_t i = 0; i < XSAN_TXN_MAX_SHARDS; ++i) {
+        xsan_batch_shard_t *shard = __atomic_load_n(&batcher->shards[i], __ATOMIC_ACQUIRE);
+        if (!shard) continue;
+        stats_out->batches_sent += __atomic_load_n(&shard->stats.batches_sent, __ATOMIC_RELAXED);
+        stats_out->extents_sent += __atomic_load_n(&shard->stats.extents_sent, __ATOMIC_RELAXED);
+        stats_out->bytes_sent += __atomic_load_n(&shard->stats.bytes_sent, __ATOMIC_RELAXED);
+        stats_out->flushes_full += __atomic_load_n(&shard->stats.flushes_full, __ATOMIC_RELAXED);
+        stats_out->flushes_window += __atomic_load_n(&shard->stats.flushes_window, __ATOMIC_RELAXED);
+        stats_out->send_failures += __atomic_load_n(&shard->stats.send_failures, __ATOMIC_RELAXED);
+    }
+    return XSAN_OK;
+}
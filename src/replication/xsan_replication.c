@@ -52,6 +52,7 @@ xsan_replicated_io_ctx_t *xsan_replicated_io_ctx_create(
     rep_ctx->failed_writes = 0;
     rep_ctx->final_status = XSAN_OK; // Assume OK until a failure occurs
     rep_ctx->local_io_req = NULL; // Will be set by volume_manager if local IO is submitted
+    rep_ctx->refs = 1; // Held by the creator until it hands the context to the pending table
 
     return rep_ctx;
 }
@@ -112,6 +113,7 @@ xsan_replica_read_coordinator_ctx_t *xsan_replica_read_coordinator_ctx_create(
     coord_ctx->internal_dma_buffer_size = 0;
     coord_ctx->internal_dma_buffer_allocated = false;
     coord_ctx->current_remote_op_ctx = NULL;
+    coord_ctx->refs = 1;
 
     return coord_ctx;
 }
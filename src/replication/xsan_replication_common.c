@@ -77,6 +77,7 @@ xsan_replicated_io_ctx_t *xsan_replicated_io_ctx_create(
     rep_ctx->transaction_id = transaction_id;
 
     rep_ctx->local_io_req = NULL;
+    rep_ctx->refs = 1; // Held by the creator until it hands the context to the pending table
 
     char vol_id_str[SPDK_UUID_STRING_LEN];
     spdk_uuid_fmt_lower(vol_id_str, sizeof(vol_id_str), (struct spdk_uuid*)&rep_ctx->volume_id.data[0]);
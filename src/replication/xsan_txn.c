@@ -0,0 +1,289 @@
+#include "xsan_txn.h"
+#include "xsan_memory.h"
+#include "xsan_log.h"
+
+#include "spdk/thread.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#define XSAN_TXN_SHARD_TABLE_INITIAL_CAPACITY 256
+
+static struct {
+    uint16_t epoch;
+    bool epoch_set;
+    pthread_mutex_t register_lock;                      // Serializes shard registration
+    uint32_t num_shards;                                // Published owned shards; only grows
+    struct spdk_thread *owners[XSAN_TXN_MAX_SHARDS];    // Filled before num_shards covers the slot
+    uint64_t next_seq[XSAN_TXN_MAX_SHARDS];
+} g_xsan_txn = { .register_lock = PTHREAD_MUTEX_INITIALIZER };
+
+// Per-thread cache of the shard last resolved for the current SPDK thread.
+static __thread struct spdk_thread *t_cached_thread;
+static __thread int t_cached_shard = -1;
+
+struct xsan_txn_table {
+    xsan_hashtable_t *shards[XSAN_TXN_MAX_SHARDS];      // Owned shards are created lazily by their owner
+    pthread_mutex_t shared_lock;                        // Guards shards[XSAN_TXN_SHARED_SHARD]
+    xsan_value_destroy_func_t leftover_destroy;
+};
+typedef struct {
+    xsan_txn_table_t *table;
+    uint64_t tid;
+    xsan_value_destroy_func_t release_fn;
+} xsan_txn_remove_msg_t;
+
+typedef struct {
+    xsan_txn_fn_t fn;
+    void *arg;
+} xsan_txn_run_msg_t;
+
+static uint32_t _txn_tid_hash(const void *key) {
+    uint64_t v = *(const uint64_t *)key;
+    v = (~v) + (v << 21); v = v ^ (v >> 24); v = (v + (v << 3)) + (v << 8);
+    v = v ^ (v >> 14); v = (v + (v << 2)) + (v << 4); v = v ^ (v >> 28); v = v + (v << 31);
+    return (uint32_t)v;
+}
+
+static int _txn_tid_compare(const void *k1, const void *k2) {
+    uint64_t v1 = *(const uint64_t *)k1;
+    uint64_t v2 = *(const uint64_t *)k2;
+    return (v1 < v2) ? -1 : (v1 > v2) ? 1 : 0;
+}
+
+void xsan_txn_init(uint16_t node_epoch) {
+    g_xsan_txn.epoch = node_epoch;
+    g_xsan_txn.epoch_set = true;
+    XSAN_LOG_INFO("Transaction IDs use node epoch 0x%04x.", node_epoch);
+}
+
+static uint32_t _txn_published_shards(void) {
+    return __atomic_load_n(&g_xsan_txn.num_shards, __ATOMIC_ACQUIRE);
+}
+
+static int _txn_find_owned_shard(struct spdk_thread *thread, uint32_t n) {
+    for (uint32_t i = 0; i < n; ++i) {
+        if (g_xsan_txn.owners[i] == thread) return (int)i;
+    }
+    return -1;
+}
+
+// Claims an owned shard for thread, or falls back to the shared shard once they run out.
+static uint32_t _txn_register_shard(struct spdk_thread *owner) {
+    pthread_mutex_lock(&g_xsan_txn.register_lock);
+    uint32_t n = g_xsan_txn.num_shards;
+    int found = _txn_find_owned_shard(owner, n);
+    if (found >= 0) {
+        pthread_mutex_unlock(&g_xsan_txn.register_lock);
+        return (uint32_t)found;
+    }
+    if (n >= XSAN_TXN_SHARED_SHARD) {
+        pthread_mutex_unlock(&g_xsan_txn.register_lock);
+        XSAN_LOG_ERROR("Transaction shard registration failed for thread %p: all %d owned shards are taken; "
+                       "its transactions use the locked shared shard.", (void *)owner, XSAN_TXN_SHARED_SHARD);
+        return XSAN_TXN_SHARED_SHARD;
+    }
+    g_xsan_txn.owners[n] = owner;
+    // Readers that observe the new count must also observe the owner stored above.
+    __atomic_store_n(&g_xsan_txn.num_shards, n + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&g_xsan_txn.register_lock);
+    return n;
+}
+
+static uint32_t _txn_current_shard(void) {
+    struct spdk_thread *thread = spdk_get_thread();
+    if (t_cached_shard >= 0 && t_cached_thread == thread) {
+        return (uint32_t)t_cached_shard;
+    }
+    // SPDK threads may be rescheduled onto another reactor, so resolve by thread, not OS thread.
+    int found = XSAN_TXN_SHARED_SHARD;
+    if (thread) {
+        found = _txn_find_owned_shard(thread, _txn_published_shards());
+        if (found < 0) found = (int)_txn_register_shard(thread);
+    }
+    t_cached_thread = thread;
+    t_cached_shard = found;
+    return (uint32_t)found;
+}
+
+uint64_t xsan_txn_next_tid(void) {
+    if (!g_xsan_txn.epoch_set) {
+        xsan_txn_init((uint16_t)time(NULL));
+    }
+    uint32_t shard = _txn_current_shard();
+    // Only contended on the shared shard.
+    uint64_t seq = (__sync_add_and_fetch(&g_xsan_txn.next_seq[shard], 1)) & XSAN_TXN_SEQ_MASK;
+    if (seq == 0) {
+        seq = __sync_add_and_fetch(&g_xsan_txn.next_seq[shard], 1) & XSAN_TXN_SEQ_MASK;
+    }
+    return ((uint64_t)g_xsan_txn.epoch << XSAN_TXN_EPOCH_SHIFT) |
+           ((uint64_t)shard << XSAN_TXN_SHARD_SHIFT) | seq;
+}
+
+bool xsan_txn_local_shard(uint32_t *shard_out) {
+    struct spdk_thread *thread = spdk_get_thread();
+    if (!thread || !shard_out) return false;
+    if (t_cached_shard >= 0 && t_cached_thread == thread) {
+        if (t_cached_shard == XSAN_TXN_SHARED_SHARD) return false;
+        *shard_out = (uint32_t)t_cached_shard;
+        return true;
+    }
+    int found = _txn_find_owned_shard(thread, _txn_published_shards());
+    if (found < 0) return false;
+    t_cached_thread = thread;
+    t_cached_shard = found;
+    *shard_out = (uint32_t)found;
+    return true;
+}
+
+bool xsan_txn_is_owner(uint64_t tid) {
+    uint32_t shard = xsan_txn_tid_shard(tid);
+    if (shard == XSAN_TXN_SHARED_SHARD) return true;
+    if (shard >= _txn_published_shards()) return false;
+    struct spdk_thread *thread = spdk_get_thread();
+    return thread != NULL && g_xsan_txn.owners[shard] == thread;
+}
+
+static void _txn_run_msg_fn(void *arg) {
+    xsan_txn_run_msg_t *m = (xsan_txn_run_msg_t *)arg;
+    m->fn(m->arg);
+    XSAN_FREE(m);
+}
+
+xsan_error_t xsan_txn_run_on_owner(uint64_t tid, xsan_txn_fn_t fn, void *arg) {
+    if (!fn) return XSAN_ERROR_INVALID_PARAM;
+    uint32_t shard = xsan_txn_tid_shard(tid);
+    if (shard != XSAN_TXN_SHARED_SHARD && shard >= _txn_published_shards()) {
+        return XSAN_ERROR_NOT_FOUND;
+    }
+    struct spdk_thread *owner = shard == XSAN_TXN_SHARED_SHARD ? NULL : g_xsan_txn.owners[shard];
+    if (owner == NULL || owner == spdk_get_thread()) {
+        fn(arg);
+        return XSAN_OK;
+    }
+    xsan_txn_run_msg_t *m = (xsan_txn_run_msg_t *)XSAN_MALLOC(sizeof(*m));
+    if (!m) return XSAN_ERROR_NO_MEMORY;
+    m->fn = fn;
+    m->arg = arg;
+    if (spdk_thread_send_msg(owner, _txn_run_msg_fn, m) != 0) {
+        XSAN_FREE(m);
+        return XSAN_ERROR_NO_MEMORY;
+    }
+    return XSAN_OK;
+}
+
+xsan_txn_table_t *xsan_txn_table_create(xsan_value_destroy_func_t leftover_destroy) {
+    xsan_txn_table_t *table = (xsan_txn_table_t *)XSAN_CALLOC(1, sizeof(*table));
+    if (!table) return NULL;
+    if (pthread_mutex_init(&table->shared_lock, NULL) != 0) {
+        XSAN_FREE(table);
+        return NULL;
+    }
+    table->leftover_destroy = leftover_destroy;
+    return table;
+}
+
+void xsan_txn_table_destroy(xsan_txn_table_t *table) {
+    if (!table) return;
+    for (uint32_t i = 0; i < XSAN_TXN_MAX_SHARDS; ++i) {
+        if (!table->shards[i]) continue;
+        size_t left = xsan_hashtable_size(table->shards[i]);
+        if (left > 0) {
+            XSAN_LOG_WARN("Transaction shard %u still holds %zu entries at destroy.", i, left);
+        }
+        if (table->leftover_destroy && left > 0) {
+            // Collect first: the keys point into the values being destroyed.
+            void **values = (void **)XSAN_MALLOC(sizeof(void *) * left);
+            size_t n = 0;
+            if (values) {
+                xsan_hashtable_iter_t iter;
+                void *value = NULL;
+                xsan_hashtable_iter_init(table->shards[i], &iter);
+                while (n < left && xsan_hashtable_iter_next(&iter, NULL, &value)) {
+                    values[n++] = value;
+                }
+            }
+            xsan_hashtable_destroy(table->shards[i]);
+            for (size_t k = 0; k < n; ++k) {
+                table->leftover_destroy(values[k]);
+            }
+            if (values) XSAN_FREE(values);
+            continue;
+        }
+        xsan_hashtable_destroy(table->shards[i]);
+    }
+    pthread_mutex_destroy(&table->shared_lock);
+    XSAN_FREE(table);
+}
+
+static void _txn_shard_lock(xsan_txn_table_t *table, uint32_t shard) {
+    if (shard == XSAN_TXN_SHARED_SHARD) pthread_mutex_lock(&table->shared_lock);
+}
+
+static void _txn_shard_unlock(xsan_txn_table_t *table, uint32_t shard) {
+    if (shard == XSAN_TXN_SHARED_SHARD) pthread_mutex_unlock(&table->shared_lock);
+}
+
+xsan_error_t xsan_txn_table_insert(xsan_txn_table_t *table, uint64_t *tid_key, void *value) {
+    if (!table || !tid_key || !value) return XSAN_ERROR_INVALID_PARAM;
+    if (!xsan_txn_is_owner(*tid_key)) {
+        XSAN_LOG_ERROR("TID %lu inserted off its owning thread.", *tid_key);
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    uint32_t shard = xsan_txn_tid_shard(*tid_key);
+    xsan_error_t err = XSAN_ERROR_NO_MEMORY;
+    _txn_shard_lock(table, shard);
+    if (!table->shards[shard]) {
+        table->shards[shard] = xsan_hashtable_create(XSAN_TXN_SHARD_TABLE_INITIAL_CAPACITY, _txn_tid_hash,
+                                                     _txn_tid_compare, NULL, NULL);
+    }
+    if (table->shards[shard]) err = xsan_hashtable_put(table->shards[shard], tid_key, value);
+    _txn_shard_unlock(table, shard);
+    return err;
+}
+
+void *xsan_txn_table_lookup(xsan_txn_table_t *table, uint64_t tid) {
+    if (!table || !xsan_txn_is_owner(tid)) return NULL;
+    uint32_t shard = xsan_txn_tid_shard(tid);
+    _txn_shard_lock(table, shard);
+    xsan_hashtable_t *ht = table->shards[shard];
+    void *value = ht ? xsan_hashtable_get(ht, &tid) : NULL;
+    _txn_shard_unlock(table, shard);
+    return value;
+}
+
+// Unlinks the entry first (its key lives inside the value), then hands the value to release_fn.
+static xsan_error_t _txn_table_remove_local(xsan_txn_table_t *table, uint64_t tid, xsan_value_destroy_func_t release_fn) {
+    uint32_t shard = xsan_txn_tid_shard(tid);
+    _txn_shard_lock(table, shard);
+    xsan_hashtable_t *ht = table->shards[shard];
+    void *value = ht ? xsan_hashtable_get(ht, &tid) : NULL;
+    if (value) xsan_hashtable_remove(ht, &tid);
+    _txn_shard_unlock(table, shard);
+    if (!value) return XSAN_ERROR_NOT_FOUND;
+    if (release_fn) release_fn(value);
+    return XSAN_OK;
+}
+static void _txn_remove_msg_fn(void *arg) {
+    xsan_txn_remove_msg_t *m = (xsan_txn_remove_msg_t *)arg;
+    if (_txn_table_remove_local(m->table, m->tid, m->release_fn) != XSAN_OK) {
+        XSAN_LOG_WARN("Posted removal of TID %lu found no entry.", m->tid);
+    }
+    XSAN_FREE(m);
+}
+
+xsan_error_t xsan_txn_table_remove(xsan_txn_table_t *table, uint64_t tid, xsan_value_destroy_func_t release_fn) {
+    if (!table) return XSAN_ERROR_INVALID_PARAM;
+    if (xsan_txn_is_owner(tid)) {
+        return _txn_table_remove_local(table, tid, release_fn);
+    }
+    xsan_txn_remove_msg_t *m = (xsan_txn_remove_msg_t *)XSAN_MALLOC(sizeof(*m));
+    if (!m) return XSAN_ERROR_NO_MEMORY;
+    m->table = table;
+    m->tid = tid;
+    m->release_fn = release_fn;
+    xsan_error_t err = xsan_txn_run_on_owner(tid, _txn_remove_msg_fn, m);
+    if (err != XSAN_OK) XSAN_FREE(m);
+    return err;
+}
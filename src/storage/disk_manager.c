@@ -23,8 +23,8 @@ struct xsan_disk_manager {
     xsan_list_t *managed_disk_groups; // List of xsan_disk_group_t structures
     pthread_mutex_t lock;             // Mutex to protect access to the lists
     bool initialized;                 // Flag to indicate if the manager is initialized
-    xsan_metadata_store_t *md_store;  // Handle to the metadata store (RocksDB)
-    char metadata_db_path[XSAN_MAX_PATH_LEN]; // Path to the DB for this manager
+    xsan_metadata_store_t *md_store;  // Node metadata store, shared with the volume manager
+    char metadata_db_path[XSAN_MAX_PATH_LEN]; // Path of the node store (for logs)
 };
 
 static xsan_disk_manager_t *g_xsan_disk_manager_instance = NULL;
@@ -67,15 +67,9 @@ static void _xsan_internal_disk_group_destroy_cb(void *group_data) {
 }
 
 xsan_error_t xsan_disk_manager_init(xsan_disk_manager_t **dm_instance_out) {
-    // Path should ideally come from a global config. Using a default for now.
-    // Example: data_dir from xsan_config + "/disk_manager_db"
-    const char *default_db_path_suffix = "xsan_meta_db/disk_manager";
-    char actual_db_path[XSAN_MAX_PATH_LEN];
-
+    // Disk ("d:") and group ("g:") records live in their own column families of the node store.
     // TODO: Integrate with a proper config system to get base data path
-    // For now, using a relative path. Ensure "./xsan_meta_db" directory exists.
-    // In a real setup: snprintf(actual_db_path, sizeof(actual_db_path), "%s/%s", xsan_get_data_dir(), default_db_path_suffix);
-    snprintf(actual_db_path, sizeof(actual_db_path), "./%s", default_db_path_suffix);
+    const char *actual_db_path = XSAN_METADATA_NODE_DB_PATH;
 
 
     if (g_xsan_disk_manager_instance != NULL) {
@@ -114,7 +108,7 @@ xsan_error_t xsan_disk_manager_init(xsan_disk_manager_t **dm_instance_out) {
         return XSAN_ERROR_SYSTEM;
     }
 
-    dm->md_store = xsan_metadata_store_open(dm->metadata_db_path, true);
+    dm->md_store = xsan_metadata_store_node_acquire();
     if (!dm->md_store) {
         XSAN_LOG_ERROR("Failed to open/create metadata store at '%s' for Disk Manager.", dm->metadata_db_path);
         pthread_mutex_destroy(&dm->lock);
@@ -137,7 +131,31 @@ xsan_error_t xsan_disk_manager_init(xsan_disk_manager_t **dm_instance_out) {
 }
 
 void xsan_disk_manager_fini(xsan_disk_manager_t **dm_ptr) {
-    // ... (fini implementation as before, ensure md_store is closed) ...
     xsan_disk_manager_t *dm_to_fini = NULL;
     if (dm_ptr && *dm_ptr) dm_to_fini = *dm_ptr;
-    else if (g_xsan_disk_manager_instance) dm_to_fini = g_xsan_disk_manager_t
+    else if (g_xsan_disk_manager_instance) dm_to_fini = g_xsan_disk_manager_instance;
+    if (!dm_to_fini || !dm_to_fini->initialized) {
+        if (dm_ptr) *dm_ptr = NULL;
+        if (dm_to_fini == g_xsan_disk_manager_instance) g_xsan_disk_manager_instance = NULL;
+        return;
+    }
+    XSAN_LOG_INFO("Finalizing XSAN Disk Manager...");
+
+    pthread_mutex_lock(&dm_to_fini->lock);
+    // Groups first: they only reference disks, which the disk list's destructor closes.
+    xsan_list_destroy(dm_to_fini->managed_disk_groups);
+    dm_to_fini->managed_disk_groups = NULL;
+    xsan_list_destroy(dm_to_fini->managed_disks);
+    dm_to_fini->managed_disks = NULL;
+    // Drops this manager's reference; the store closes once the volume manager has released its own.
+    xsan_metadata_store_node_release(dm_to_fini->md_store);
+    dm_to_fini->md_store = NULL;
+    dm_to_fini->initialized = false;
+    pthread_mutex_unlock(&dm_to_fini->lock);
+    pthread_mutex_destroy(&dm_to_fini->lock);
+
+    if (dm_to_fini == g_xsan_disk_manager_instance) g_xsan_disk_manager_instance = NULL;
+    XSAN_FREE(dm_to_fini);
+    if (dm_ptr) *dm_ptr = NULL;
+    XSAN_LOG_INFO("XSAN Disk Manager finalized.");
+}
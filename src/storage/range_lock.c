@@ -0,0 +1,241 @@
+#include "xsan_range_lock.h"
+#include "xsan_memory.h"
+#include "xsan_log.h"
+#include "../../include/xsan_error.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+// One FIFO per hash slot. Entries are appended in arrival (seq) order, so every request
+// that precedes a given link in its slot arrived earlier.
+typedef struct {
+    xsan_range_lock_link_t *head;
+    xsan_range_lock_link_t *tail;
+} xsan_range_lock_slot_t;
+
+struct xsan_range_lock_table {
+    pthread_mutex_t lock;
+    xsan_range_lock_slot_t *slots;
+    uint32_t num_slots;         // Power of two
+    uint32_t slot_mask;
+    uint32_t region_shift;
+    uint64_t next_seq;
+    xsan_range_lock_stats_t stats;
+};
+
+static uint64_t _range_lock_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+static uint32_t _round_up_pow2(uint32_t v) {
+    uint32_t p = 1;
+    while (p < v && p < (1U << 30)) {
+        p <<= 1;
+    }
+    return p;
+}
+
+static inline bool _ranges_overlap(const xsan_range_lock_req_t *a, const xsan_range_lock_req_t *b) {
+    return a->start_block < b->end_block && b->start_block < a->end_block;
+}
+
+// Returns true if an earlier request in any of req's slots overlaps req. Caller holds table->lock.
+static bool _range_lock_is_blocked(const xsan_range_lock_req_t *req) {
+    for (uint32_t i = 0; i < req->num_links; ++i) {
+        for (const xsan_range_lock_link_t *l = req->links[i].prev; l; l = l->prev) {
+            if (_ranges_overlap(l->req, req)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static void _range_lock_slot_append(xsan_range_lock_slot_t *slot, xsan_range_lock_link_t *link) {
+    link->next = NULL;
+    link->prev = slot->tail;
+    if (slot->tail) {
+        slot->tail->next = link;
+    } else {
+        slot->head = link;
+    }
+    slot->tail = link;
+}
+
+static void _range_lock_slot_unlink(xsan_range_lock_slot_t *slot, xsan_range_lock_link_t *link) {
+    if (link->prev) link->prev->next = link->next; else slot->head = link->next;
+    if (link->next) link->next->prev = link->prev; else slot->tail = link->prev;
+    link->prev = link->next = NULL;
+}
+
+static void _range_lock_note_granted(xsan_range_lock_table_t *table, xsan_range_lock_req_t *req) {
+    req->granted = true;
+    table->stats.acquisitions++;
+    table->stats.current_holders++;
+    if (req->contended) {
+        uint64_t waited = _range_lock_now_us() - req->enqueue_time_us;
+        table->stats.current_waiters--;
+        table->stats.total_wait_us += waited;
+        if (waited > table->stats.max_wait_us) {
+            table->stats.max_wait_us = waited;
+        }
+    }
+}
+
+xsan_range_lock_table_t *xsan_range_lock_table_create(uint32_t num_slots, uint32_t region_shift) {
+    xsan_range_lock_table_t *table = (xsan_range_lock_table_t *)XSAN_CALLOC(1, sizeof(*table));
+    if (!table) {
+        return NULL;
+    }
+    table->num_slots = _round_up_pow2(num_slots ? num_slots : XSAN_RANGE_LOCK_DEFAULT_SLOTS);
+    table->slot_mask = table->num_slots - 1;
+    table->region_shift = region_shift ? region_shift : XSAN_RANGE_LOCK_DEFAULT_REGION_SHIFT;
+    if (table->region_shift > 63) {
+        table->region_shift = 63;
+    }
+    table->slots = (xsan_range_lock_slot_t *)XSAN_CALLOC(table->num_slots, sizeof(xsan_range_lock_slot_t));
+    if (!table->slots) {
+        XSAN_FREE(table);
+        return NULL;
+    }
+    if (pthread_mutex_init(&table->lock, NULL) != 0) {
+        XSAN_FREE(table->slots);
+        XSAN_FREE(table);
+        return NULL;
+    }
+    return table;
+}
+
+void xsan_range_lock_table_destroy(xsan_range_lock_table_t *table) {
+    if (!table) {
+        return;
+    }
+    if (table->stats.current_holders || table->stats.current_waiters) {
+        XSAN_LOG_WARN("Destroying range-lock table with %u holders and %u waiters outstanding.",
+                      table->stats.current_holders, table->stats.current_waiters);
+    }
+    pthread_mutex_destroy(&table->lock);
+    XSAN_FREE(table->slots);
+    XSAN_FREE(table);
+}
+
+xsan_error_t xsan_range_lock_acquire(xsan_range_lock_table_t *table,
+                                     xsan_range_lock_req_t *req,
+                                     uint64_t start_block,
+                                     uint64_t num_blocks,
+                                     xsan_range_lock_granted_cb_t granted_cb,
+                                     void *cb_arg,
+                                     bool *granted_now) {
+    if (!table || !req || num_blocks == 0 || !granted_cb || !granted_now ||
+        start_block + num_blocks < start_block) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+
+    uint64_t first_region = start_block >> table->region_shift;
+    uint64_t last_region = (start_block + num_blocks - 1) >> table->region_shift;
+    uint64_t span = last_region - first_region + 1;
+    uint32_t num_links = (span >= table->num_slots) ? table->num_slots : (uint32_t)span;
+
+    memset(req, 0, sizeof(*req));
+    req->start_block = start_block;
+    req->end_block = start_block + num_blocks;
+    req->granted_cb = granted_cb;
+    req->granted_cb_arg = cb_arg;
+    req->num_links = num_links;
+    if (num_links <= XSAN_RANGE_LOCK_INLINE_LINKS) {
+        req->links = req->inline_links;
+    } else {
+        req->links = (xsan_range_lock_link_t *)XSAN_MALLOC(sizeof(xsan_range_lock_link_t) * num_links);
+        if (!req->links) {
+            return XSAN_ERROR_NO_MEMORY;
+        }
+    }
+    // Consecutive regions land in consecutive slots, so a request touches a contiguous
+    // (wrapping) run of slots starting at its first region.
+    for (uint32_t i = 0; i < num_links; ++i) {
+        req->links[i].req = req;
+        req->links[i].slot_idx = (uint32_t)((first_region + i) & table->slot_mask);
+    }
+
+    pthread_mutex_lock(&table->lock);
+    req->seq = table->next_seq++;
+    for (uint32_t i = 0; i < num_links; ++i) {
+        _range_lock_slot_append(&table->slots[req->links[i].slot_idx], &req->links[i]);
+    }
+    if (_range_lock_is_blocked(req)) {
+        req->contended = true;
+        req->enqueue_time_us = _range_lock_now_us();
+        table->stats.contended_acquisitions++;
+        table->stats.current_waiters++;
+        if (table->stats.current_waiters > table->stats.max_waiters) {
+            table->stats.max_waiters = table->stats.current_waiters;
+        }
+        *granted_now = false;
+    } else {
+        _range_lock_note_granted(table, req);
+        *granted_now = true;
+    }
+    pthread_mutex_unlock(&table->lock);
+    return XSAN_OK;
+}
+
+void xsan_range_lock_release(xsan_range_lock_table_t *table, xsan_range_lock_req_t *req) {
+    if (!table || !req || !req->links) {
+        return;
+    }
+    if (!req->granted) {
+        XSAN_LOG_ERROR("Releasing range-lock [%lu, %lu) that was never granted.", req->start_block, req->end_block);
+        return;
+    }
+
+    xsan_range_lock_req_t *granted_head = NULL;
+    xsan_range_lock_req_t **granted_tail = &granted_head;
+
+    pthread_mutex_lock(&table->lock);
+    for (uint32_t i = 0; i < req->num_links; ++i) {
+        _range_lock_slot_unlink(&table->slots[req->links[i].slot_idx], &req->links[i]);
+    }
+    table->stats.current_holders--;
+
+    // Only waiters sharing a slot with the released range can have been blocked by it.
+    for (uint32_t i = 0; i < req->num_links; ++i) {
+        xsan_range_lock_link_t *l = table->slots[req->links[i].slot_idx].head;
+        for (; l; l = l->next) {
+            xsan_range_lock_req_t *w = l->req;
+            if (w->granted || !_ranges_overlap(w, req) || _range_lock_is_blocked(w)) {
+                continue;
+            }
+            _range_lock_note_granted(table, w);
+            w->next_granted = NULL;
+            *granted_tail = w;
+            granted_tail = &w->next_granted;
+        }
+    }
+    pthread_mutex_unlock(&table->lock);
+
+    if (req->links != req->inline_links) {
+        XSAN_FREE(req->links);
+    }
+    req->links = NULL;
+    req->num_links = 0;
+    req->granted = false;
+
+    while (granted_head) {
+        xsan_range_lock_req_t *w = granted_head;
+        granted_head = w->next_granted;
+        w->granted_cb(w, w->granted_cb_arg);
+    }
+}
+
+xsan_error_t xsan_range_lock_get_stats(xsan_range_lock_table_t *table, xsan_range_lock_stats_t *stats_out) {
+    if (!table || !stats_out) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    pthread_mutex_lock(&table->lock);
+    memcpy(stats_out, &table->stats, sizeof(*stats_out));
+    pthread_mutex_unlock(&table->lock);
+    return XSAN_OK;
+}
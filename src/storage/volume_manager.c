@@ -11,6 +11,11 @@
 #include "xsan_node_comm.h"
 #include "xsan_protocol.h"
 #include "xsan_metadata_store.h"
+#include "xsan_range_lock.h"
+#include "xsan_replica_write_batch.h"
+#include "xsan_replica_chain.h"
+#include "xsan_txn.h"
+#include "xsan_timer_wheel.h"
 #include "xsan_bdev.h"
 #include "xsan_cluster.h"
 #include "json-c/json.h"
@@ -22,21 +27,39 @@
 #include <pthread.h>
 #include <errno.h>
 #include <limits.h>
+#include <time.h>
 
 #define XSAN_VOLUME_META_PREFIX "v:"
 #define XSAN_VOL_ALLOC_META_PREFIX "volalloc:"
 #define XSAN_DEFAULT_COMM_PORT 8080
+#define XSAN_REPLICA_DEADLINE_TICK_US 1000
+
+struct xsan_deadline_shard;
 
 struct xsan_volume_manager {
     xsan_list_t *managed_volumes;
     xsan_disk_manager_t *disk_manager;
     pthread_mutex_t lock;
     bool initialized;
-    xsan_metadata_store_t *md_store;
+    xsan_metadata_store_t *md_store;            // Node store shared with the disk manager
+    xsan_metadata_cf_t *volumes_cf;             // "v:" records
+    xsan_metadata_cf_t *alloc_cf;               // "volalloc:" records
     char metadata_db_path[XSAN_MAX_PATH_LEN];
-    xsan_hashtable_t *pending_replicated_ios;
-    xsan_hashtable_t *pending_replica_reads;
-    pthread_mutex_t pending_ios_lock;
+    // In-flight transactions, sharded by owning reactor (see xsan_txn.h); no lock needed.
+    xsan_txn_table_t *pending_replicated_ios;
+    xsan_txn_table_t *pending_replica_reads;
+    xsan_txn_table_t *pending_chain_forwards;   // forward TID -> xsan_replica_chain_fwd_ctx_t (chain mid-hops)
+    // Per-reactor deadline wheels for remote replica operations, indexed by TID shard.
+    struct xsan_deadline_shard *deadline_shards[XSAN_TXN_MAX_SHARDS];
+    uint64_t replica_write_timeout_us;          // 0 disables write deadlines
+    uint64_t replica_read_timeout_us;           // 0 disables read attempt deadlines
+    xsan_replica_timeout_stats_t timeout_stats; // Counters updated atomically
+    xsan_node_id_t local_node_id;               // Reported as responder_node_id in replica write responses
+    xsan_replica_chain_hop_t local_hop;         // Upstream hop advertised in the chain requests we send
+    xsan_replica_write_batcher_t *write_batcher; // Coalesces small fan-out replica writes per node; NULL if disabled
+    xsan_volume_event_cb_t event_cb;            // Told about created/deleted volumes; NULL if none
+    void *event_cb_arg;
+    struct xsan_volume_create_ctx *pending_creates; // Creates whose metadata is still being committed
 };
 
 static xsan_volume_manager_t *g_xsan_volume_manager_instance = NULL;
@@ -62,12 +85,62 @@ typedef struct {
     void *dma_buffer;
     uint64_t data_len_bytes;
     bool is_read_op_on_replica;
+    xsan_message_t *req_msg;    // Request whose DMA payload is being written in place; destroyed on completion
+    xsan_replica_chain_hop_t chain_upstream; // Acked by address when the request was a chain write
 } xsan_replica_op_handler_ctx_t;
 
+typedef struct {
+    struct xsan_connection_ctx *conn_ctx;
+    xsan_message_t *response_msg;
+} xsan_replica_response_cb_ctx_t;
+
+struct xsan_replica_batch_apply_ctx;
+
+typedef struct {
+    struct xsan_replica_batch_apply_ctx *batch;
+    uint32_t idx;
+} xsan_replica_batch_extent_ctx_t;
+
+/**
+ * Replica-side state for one XSAN_MSG_TYPE_REPLICA_WRITE_BATCH_REQ. The request message is
+ * kept until every extent's local write has completed, since extents point into its payload.
+ */
+typedef struct xsan_replica_batch_apply_ctx {
+    xsan_volume_manager_t *vm;
+    struct xsan_connection_ctx *conn_ctx;
+    xsan_message_t *req_msg;
+    uint64_t batch_tid;
+    uint32_t num_extents;
+    uint32_t pending;
+    xsan_replica_write_extent_status_t statuses[XSAN_REPLICA_WRITE_BATCH_MAX_EXTENTS];
+    xsan_replica_batch_extent_ctx_t parts[XSAN_REPLICA_WRITE_BATCH_MAX_EXTENTS];
+} xsan_replica_batch_apply_ctx_t;
+
+/**
+ * State held by a mid-chain replica: it acks upstream only after both its own local write
+ * and the downstream result for the forwarded copy (ack, send failure or deadline) are in.
+ * Everything but the local write completion runs on the reactor owning forward_tid.
+ */
+typedef struct {
+    xsan_volume_manager_t *vm;
+    xsan_replica_chain_write_req_payload_t req; // As received; req.upstream is acked by address
+    uint64_t upstream_tid;
+    uint64_t forward_tid;
+    xsan_message_t *fwd_msg;    // Request sent to req.chain_downstream[0]; freed once sent
+    xsan_error_t local_status;
+    xsan_error_t downstream_statuses[XSAN_REPLICA_CHAIN_MAX_HOPS];
+    bool local_done;
+    bool downstream_done;
+    bool acked;
+    uint32_t refs;              // Local write, downstream result, forward send leg and an armed deadline
+    xsan_timer_t deadline;
+} xsan_replica_chain_fwd_ctx_t;
+
 // Forward declarations
 static xsan_error_t xsan_volume_manager_load_metadata(xsan_volume_manager_t *vm);
 static xsan_error_t xsan_volume_manager_save_volume_meta(xsan_volume_manager_t *vm, xsan_volume_t *vol);
-static xsan_error_t xsan_volume_manager_delete_volume_meta(xsan_volume_manager_t *vm, xsan_volume_id_t volume_id);
+static xsan_error_t xsan_volume_manager_stage_volume_meta(xsan_volume_manager_t *vm, xsan_metadata_batch_t *batch, xsan_volume_t *vol);
+static xsan_error_t xsan_volume_manager_stage_volume_delete(xsan_volume_manager_t *vm, xsan_metadata_batch_t *batch, xsan_volume_id_t volume_id);
 static xsan_error_t _xsan_volume_to_json_string(const xsan_volume_t *vol, char **json_string_out);
 static xsan_error_t _xsan_json_string_to_volume(const char *json_string, xsan_volume_manager_t *vm, xsan_volume_t **vol_out);
 static xsan_error_t _xsan_volume_allocation_meta_to_json_string(const xsan_volume_allocation_meta_t *alloc_meta, char **json_string_out);
@@ -85,22 +158,30 @@ static void _xsan_volume_update_overall_state(xsan_volume_manager_t *vm, xsan_vo
 static void _xsan_physical_io_complete_cb(void *cb_arg_from_io_layer, xsan_error_t status);
 static void _handle_replica_local_io_complete_cb(void *cb_arg_from_local_io, xsan_error_t local_io_status);
 static void _replica_op_response_send_complete_cb(int status, void *cb_arg);
+static xsan_error_t _xsan_replicated_write_dispatch(xsan_volume_manager_t *vm, xsan_replicated_io_ctx_t *rep_ctx);
+static void _xsan_replicated_write_range_granted_cb(xsan_range_lock_req_t *req, void *cb_arg);
+static void _xsan_chain_write_send_from_head(xsan_replicated_io_ctx_t *rep_ctx);
+static void _xsan_chain_connect_then_send_cb(struct spdk_sock *sock, int status, void *cb_arg);
+static void _xsan_chain_send_complete_cb(int comm_status, void *cb_arg);
+static void _xsan_chain_fwd_connect_then_send_cb(struct spdk_sock *sock, int status, void *cb_arg);
+static void _xsan_chain_fwd_send_complete_cb(int comm_status, void *cb_arg);
+static void _xsan_volume_set_replica_state(xsan_volume_manager_t *vm, xsan_volume_id_t volume_id,
+                                           const xsan_node_id_t *node_id, xsan_storage_state_t state);
+static void _xsan_deadline_shards_stop(xsan_volume_manager_t *vm);
 
 
 static uint64_t _get_current_time_us() {
-    return spdk_get_ticks() * SPDK_SEC_TO_USEC / spdk_get_ticks_hz();
+    uint64_t ticks = spdk_get_ticks(), hz = spdk_get_ticks_hz();
+    // Split to avoid overflowing ticks * 10^6 after a few hours of uptime.
+    return (ticks / hz) * SPDK_SEC_TO_USEC + (ticks % hz) * SPDK_SEC_TO_USEC / hz;
 }
 
 static void _xsan_internal_volume_destroy_cb(void *volume_data) {
-    if (volume_data) { xsan_volume_t *v = (xsan_volume_t *)volume_data; XSAN_FREE(v); }
+    if (volume_data) { xsan_volume_t *v = (xsan_volume_t *)volume_data; xsan_range_lock_table_destroy(v->write_range_locks); if (v->alloc_meta) XSAN_FREE(v->alloc_meta); XSAN_FREE(v); }
 }
-static uint32_t uint64_tid_hash_func(const void *key) { if(!key)return 0;uint64_t v=*(const uint64_t*)key;v=(~v)+(v<<21);v=v^(v>>24);v=(v+(v<<3))+(v<<8);v=v^(v>>14);v=(v+(v<<2))+(v<<4);v=v^(v>>28);v=v+(v<<31);return (uint32_t)v;}
-static int uint64_tid_key_compare_func(const void *k1,const void *k2){ if(k1==k2)return 0;if(!k1)return-1;if(!k2)return 1;uint64_t v1=*(const uint64_t*)k1;uint64_t v2=*(const uint64_t*)k2;if(v1<v2)return-1;if(v1>v2)return 1;return 0;}
 
 xsan_error_t xsan_volume_manager_init(xsan_disk_manager_t *dm, xsan_volume_manager_t **vm_out){
-    const char *default_db_path_suffix = "xsan_meta_db/volume_manager";
-    char actual_db_path[XSAN_MAX_PATH_LEN];
-    snprintf(actual_db_path, sizeof(actual_db_path), "./%s", default_db_path_suffix);
+    const char *actual_db_path = XSAN_METADATA_NODE_DB_PATH;
     if (g_xsan_volume_manager_instance) { if(vm_out)*vm_out=g_xsan_volume_manager_instance; return XSAN_OK; }
     if (!dm) { if(vm_out)*vm_out=NULL; return XSAN_ERROR_INVALID_PARAM; }
     XSAN_LOG_INFO("Initializing Volume Manager (DB: %s)...", actual_db_path);
@@ -108,13 +189,24 @@ xsan_error_t xsan_volume_manager_init(xsan_disk_manager_t *dm, xsan_volume_manag
     if (!vm) { if(vm_out)*vm_out=NULL;return XSAN_ERROR_OUT_OF_MEMORY; }
     memset(vm,0,sizeof(*vm)); xsan_strcpy_safe(vm->metadata_db_path,actual_db_path,XSAN_MAX_PATH_LEN);
     vm->managed_volumes=xsan_list_create(_xsan_internal_volume_destroy_cb);
-    if(!vm->managed_volumes || pthread_mutex_init(&vm->lock,NULL)!=0 || pthread_mutex_init(&vm->pending_ios_lock,NULL)!=0){ XSAN_FREE(vm); return XSAN_ERROR_SYSTEM;}
-    vm->pending_replicated_ios=xsan_hashtable_create(256,uint64_tid_hash_func,uint64_tid_key_compare_func,NULL, (void(*)(void*))xsan_replicated_io_ctx_free);
-    if(!vm->pending_replicated_ios){ pthread_mutex_destroy(&vm->lock); pthread_mutex_destroy(&vm->pending_ios_lock); xsan_list_destroy(vm->managed_volumes); XSAN_FREE(vm); return XSAN_ERROR_OUT_OF_MEMORY;}
-    vm->pending_replica_reads = xsan_hashtable_create(256, uint64_tid_hash_func, uint64_tid_key_compare_func, NULL, (void(*)(void*))xsan_replica_read_coordinator_ctx_free);
-    if(!vm->pending_replica_reads){ xsan_hashtable_destroy(vm->pending_replicated_ios); pthread_mutex_destroy(&vm->lock); pthread_mutex_destroy(&vm->pending_ios_lock); xsan_list_destroy(vm->managed_volumes); XSAN_FREE(vm); return XSAN_ERROR_OUT_OF_MEMORY;}
-    vm->disk_manager=dm; vm->md_store=xsan_metadata_store_open(vm->metadata_db_path,true);
-    if(!vm->md_store){ xsan_hashtable_destroy(vm->pending_replica_reads); xsan_hashtable_destroy(vm->pending_replicated_ios); pthread_mutex_destroy(&vm->lock); pthread_mutex_destroy(&vm->pending_ios_lock); xsan_list_destroy(vm->managed_volumes); XSAN_FREE(vm); return XSAN_ERROR_STORAGE_GENERIC;}
+    if(!vm->managed_volumes || pthread_mutex_init(&vm->lock,NULL)!=0){ XSAN_FREE(vm); return XSAN_ERROR_SYSTEM;}
+    vm->pending_replicated_ios = xsan_txn_table_create((void(*)(void*))xsan_replicated_io_ctx_free);
+    vm->pending_replica_reads = xsan_txn_table_create((void(*)(void*))xsan_replica_read_coordinator_ctx_free);
+    vm->pending_chain_forwards = xsan_txn_table_create(xsan_free);
+    if(!vm->pending_replicated_ios || !vm->pending_replica_reads || !vm->pending_chain_forwards){ xsan_txn_table_destroy(vm->pending_chain_forwards); xsan_txn_table_destroy(vm->pending_replica_reads); xsan_txn_table_destroy(vm->pending_replicated_ios); pthread_mutex_destroy(&vm->lock); xsan_list_destroy(vm->managed_volumes); XSAN_FREE(vm); return XSAN_ERROR_OUT_OF_MEMORY;}
+    { xsan_replica_location_t self; memset(&self, 0, sizeof(self));
+      if (xsan_get_local_node_info(&self.node_id, self.node_ip_addr, sizeof(self.node_ip_addr), &self.node_comm_port) != XSAN_OK) XSAN_LOG_WARN("Local node info unavailable; replica responses will carry a null responder ID and chain writes cannot be acked.");
+      memcpy(&vm->local_node_id, &self.node_id, sizeof(xsan_node_id_t)); xsan_replica_chain_hop_from_location(&vm->local_hop, &self); }
+    vm->replica_write_timeout_us = XSAN_REPLICA_WRITE_DEFAULT_TIMEOUT_US;
+    vm->replica_read_timeout_us = XSAN_REPLICA_READ_DEFAULT_TIMEOUT_US;
+    // A fresh epoch per start keeps TIDs from a previous incarnation from matching live transactions.
+    xsan_txn_init((uint16_t)(spdk_get_ticks() ^ (uint64_t)time(NULL)));
+    vm->disk_manager=dm; vm->md_store=xsan_metadata_store_node_acquire();
+    vm->volumes_cf = xsan_metadata_store_get_cf(vm->md_store, XSAN_METADATA_CF_VOLUMES);
+    vm->alloc_cf = xsan_metadata_store_get_cf(vm->md_store, XSAN_METADATA_CF_VOLUME_ALLOC);
+    if(!vm->md_store || !vm->volumes_cf || !vm->alloc_cf){ xsan_metadata_store_node_release(vm->md_store); xsan_txn_table_destroy(vm->pending_chain_forwards); xsan_txn_table_destroy(vm->pending_replica_reads); xsan_txn_table_destroy(vm->pending_replicated_ios); pthread_mutex_destroy(&vm->lock); xsan_list_destroy(vm->managed_volumes); XSAN_FREE(vm); return XSAN_ERROR_STORAGE_GENERIC;}
+    vm->write_batcher = xsan_replica_write_batcher_create(NULL);
+    if (!vm->write_batcher) XSAN_LOG_WARN("Replica write batching unavailable; small replica writes will be sent individually.");
     vm->initialized=true; g_xsan_volume_manager_instance=vm; if(vm_out)*vm_out=vm;
     xsan_volume_manager_load_metadata(vm); XSAN_LOG_INFO("Volume Manager initialized."); return XSAN_OK;
 }
@@ -123,11 +215,12 @@ void xsan_volume_manager_fini(xsan_volume_manager_t **vm_ptr){
     xsan_volume_manager_t *vm = (vm_ptr && *vm_ptr) ? *vm_ptr : g_xsan_volume_manager_instance;
     if (!vm || !vm->initialized) { if(vm_ptr) *vm_ptr = NULL; if(vm==g_xsan_volume_manager_instance)g_xsan_volume_manager_instance=NULL; return; }
     XSAN_LOG_INFO("Finalizing Volume Manager...");
-    pthread_mutex_lock(&vm->pending_ios_lock);
-    if(vm->pending_replicated_ios){ xsan_hashtable_destroy(vm->pending_replicated_ios);vm->pending_replicated_ios=NULL;}
-    if(vm->pending_replica_reads){ xsan_hashtable_destroy(vm->pending_replica_reads);vm->pending_replica_reads=NULL;}
-    pthread_mutex_unlock(&vm->pending_ios_lock); pthread_mutex_destroy(&vm->pending_ios_lock);
-    pthread_mutex_lock(&vm->lock); xsan_list_destroy(vm->managed_volumes); vm->managed_volumes = NULL; if(vm->md_store)xsan_metadata_store_close(vm->md_store); vm->md_store = NULL; pthread_mutex_unlock(&vm->lock); pthread_mutex_destroy(&vm->lock);
+    if (vm->write_batcher) { xsan_replica_write_batcher_destroy(vm->write_batcher); vm->write_batcher = NULL; }
+    _xsan_deadline_shards_stop(vm);
+    xsan_txn_table_destroy(vm->pending_replicated_ios); vm->pending_replicated_ios = NULL;
+    xsan_txn_table_destroy(vm->pending_replica_reads); vm->pending_replica_reads = NULL;
+    xsan_txn_table_destroy(vm->pending_chain_forwards); vm->pending_chain_forwards = NULL;
+    pthread_mutex_lock(&vm->lock); xsan_list_destroy(vm->managed_volumes); vm->managed_volumes = NULL; xsan_metadata_store_node_release(vm->md_store); vm->md_store = NULL; vm->volumes_cf = NULL; vm->alloc_cf = NULL; pthread_mutex_unlock(&vm->lock); pthread_mutex_destroy(&vm->lock);
     XSAN_FREE(vm); if(vm_ptr)*vm_ptr=NULL; if(vm==g_xsan_volume_manager_instance)g_xsan_volume_manager_instance=NULL;
     XSAN_LOG_INFO("Volume Manager finalized.");
 }
@@ -244,6 +337,7 @@ static xsan_error_t _xsan_volume_to_json_string(const xsan_volume_t *vol, char *
         json_object_array_add(jarray_replicas, jreplica);
     }
     json_object_object_add(jobj, "replica_nodes", jarray_replicas);
+    json_object_object_add(jobj, "replication_mode", json_object_new_int(vol->replication_mode));
     const char *tmp_str = json_object_to_json_string_ext(jobj, JSON_C_TO_STRING_PLAIN);
     *json_s_out = xsan_strdup(tmp_str); json_object_put(jobj);
     return (*json_s_out) ? XSAN_OK : XSAN_ERROR_OUT_OF_MEMORY;
@@ -254,6 +348,8 @@ static xsan_error_t _xsan_json_string_to_volume(const char *js, xsan_volume_mana
     struct json_object *jobj = json_tokener_parse(js); if (!jobj || is_error(jobj)) { if(jobj&&!is_error(jobj))json_object_put(jobj);return XSAN_ERROR_CONFIG_PARSE; }
     xsan_volume_t *vol = (xsan_volume_t *)XSAN_MALLOC(sizeof(*vol)); if (!vol) { json_object_put(jobj); return XSAN_ERROR_OUT_OF_MEMORY; }
     memset(vol, 0, sizeof(*vol)); struct json_object *val;
+    vol->write_range_locks = xsan_range_lock_table_create(0, 0);
+    if (!vol->write_range_locks) { XSAN_FREE(vol); json_object_put(jobj); return XSAN_ERROR_OUT_OF_MEMORY; }
     if (json_object_object_get_ex(jobj, "id", &val)) spdk_uuid_parse((struct spdk_uuid*)&vol->id.data[0], json_object_get_string(val));
     if (json_object_object_get_ex(jobj, "name", &val)) xsan_strcpy_safe(vol->name, json_object_get_string(val), XSAN_MAX_NAME_LEN);
     if (json_object_object_get_ex(jobj, "size_bytes", &val)) vol->size_bytes = (uint64_t)json_object_get_int64(val);
@@ -265,6 +361,7 @@ static xsan_error_t _xsan_json_string_to_volume(const char *js, xsan_volume_mana
     if (json_object_object_get_ex(jobj, "allocated_bytes", &val)) vol->allocated_bytes = (uint64_t)json_object_get_int64(val);
     if (json_object_object_get_ex(jobj, "FTT", &val)) vol->FTT = (uint32_t)json_object_get_int(val);
     if (json_object_object_get_ex(jobj, "actual_replica_count", &val)) vol->actual_replica_count = (uint32_t)json_object_get_int(val);
+    if (json_object_object_get_ex(jobj, "replication_mode", &val)) vol->replication_mode = (xsan_replication_mode_t)json_object_get_int(val); else vol->replication_mode = XSAN_REPLICATION_MODE_FANOUT;
     struct json_object *j_repl_nodes;
     if (json_object_object_get_ex(jobj, "replica_nodes", &j_repl_nodes) && json_object_is_type(j_repl_nodes, json_type_array)) {
         int arr_len = json_object_array_length(j_repl_nodes); if((uint32_t)arr_len > XSAN_MAX_REPLICAS) arr_len = XSAN_MAX_REPLICAS;
@@ -315,10 +412,8 @@ static void _xsan_volume_update_overall_state(xsan_volume_manager_t *vm, xsan_vo
     }
 }
 
-static xsan_error_t xsan_volume_manager_save_volume_meta(xsan_volume_manager_t *vm, xsan_volume_t *vol) {
-    if (!vm || !vm->md_store || !vol) {
-        return XSAN_ERROR_INVALID_PARAM;
-    }
+// Serializes vol and adds its record to batch.
+static xsan_error_t xsan_volume_manager_stage_volume_meta(xsan_volume_manager_t *vm, xsan_metadata_batch_t *batch, xsan_volume_t *vol) {
     char *json_string = NULL;
     xsan_error_t err = _xsan_volume_to_json_string(vol, &json_string);
     if (err != XSAN_OK) {
@@ -328,34 +423,77 @@ static xsan_error_t xsan_volume_manager_save_volume_meta(xsan_volume_manager_t *
     }
     char key_buf[XSAN_MAX_NAME_LEN + SPDK_UUID_STRING_LEN];
     snprintf(key_buf, sizeof(key_buf), "%s%s", XSAN_VOLUME_META_PREFIX, spdk_uuid_get_string((struct spdk_uuid*)&vol->id.data[0]));
-    err = xsan_metadata_store_put(vm->md_store, key_buf, strlen(key_buf), json_string, strlen(json_string));
-    if (err != XSAN_OK) {
-        XSAN_LOG_ERROR("Failed to save volume '%s' (ID: %s) metadata to RocksDB: %s",
-                       vol->name, spdk_uuid_get_string((struct spdk_uuid*)&vol->id.data[0]), xsan_error_string(err));
-    } else {
-        XSAN_LOG_DEBUG("Successfully saved volume '%s' (ID: %s) metadata.",
-                       vol->name, spdk_uuid_get_string((struct spdk_uuid*)&vol->id.data[0]));
-    }
+    err = xsan_metadata_store_batch_put_cf(batch, vm->volumes_cf, key_buf, strlen(key_buf), json_string, strlen(json_string));
     XSAN_FREE(json_string);
     return err;
 }
 
-static xsan_error_t xsan_volume_manager_delete_volume_meta(xsan_volume_manager_t *vm, xsan_volume_id_t volume_id) {
-    if (!vm || !vm->md_store || spdk_uuid_is_null((struct spdk_uuid*)&volume_id.data[0])) {
+// cb_arg is the volume ID string (the volume may be gone by the time the write lands).
+static void _xsan_volume_meta_saved_cb(void *cb_arg, xsan_error_t status) {
+    char *vol_id_str = (char *)cb_arg;
+    if (status != XSAN_OK) {
+        XSAN_LOG_ERROR("Failed to save volume (ID: %s) metadata to RocksDB: %s", vol_id_str, xsan_error_string(status));
+    } else {
+        XSAN_LOG_DEBUG("Successfully saved volume (ID: %s) metadata.", vol_id_str);
+    }
+    XSAN_FREE(vol_id_str);
+}
+
+// The record is serialized now and written by a metadata worker, so this never blocks the calling reactor.
+static xsan_error_t xsan_volume_manager_save_volume_meta(xsan_volume_manager_t *vm, xsan_volume_t *vol) {
+    if (!vm || !vm->md_store || !vol) {
         return XSAN_ERROR_INVALID_PARAM;
     }
+    xsan_metadata_batch_t *batch = xsan_metadata_store_batch_create(vm->md_store);
+    char *vol_id_str = xsan_strdup(spdk_uuid_get_string((struct spdk_uuid*)&vol->id.data[0]));
+    if (!batch || !vol_id_str) {
+        xsan_metadata_store_batch_destroy(batch);
+        if (vol_id_str) XSAN_FREE(vol_id_str);
+        return XSAN_ERROR_OUT_OF_MEMORY;
+    }
+    xsan_error_t err = xsan_volume_manager_stage_volume_meta(vm, batch, vol);
+    if (err == XSAN_OK) {
+        err = xsan_metadata_store_batch_commit_async(vm->md_store, batch, _xsan_volume_meta_saved_cb, vol_id_str);
+    }
+    if (err != XSAN_OK) {
+        XSAN_LOG_ERROR("Failed to save volume '%s' (ID: %s) metadata to RocksDB: %s",
+                       vol->name, vol_id_str, xsan_error_string(err));
+        xsan_metadata_store_batch_destroy(batch);
+        XSAN_FREE(vol_id_str);
+    }
+    return err;
+}
+
+// Adds deletes of a volume's record and its allocation record to batch (absent keys are fine).
+static xsan_error_t xsan_volume_manager_stage_volume_delete(xsan_volume_manager_t *vm, xsan_metadata_batch_t *batch, xsan_volume_id_t volume_id) {
     char key_buf[XSAN_MAX_NAME_LEN + SPDK_UUID_STRING_LEN];
+    snprintf(key_buf, sizeof(key_buf), "%s%s", XSAN_VOL_ALLOC_META_PREFIX, spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]));
+    xsan_error_t err = xsan_metadata_store_batch_delete_cf(batch, vm->alloc_cf, key_buf, strlen(key_buf));
+    if (err != XSAN_OK) {
+        return err;
+    }
     snprintf(key_buf, sizeof(key_buf), "%s%s", XSAN_VOLUME_META_PREFIX, spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]));
-    xsan_error_t err = xsan_metadata_store_delete(vm->md_store, key_buf, strlen(key_buf));
-    if (err != XSAN_OK && err != XSAN_ERROR_NOT_FOUND) {
-        XSAN_LOG_ERROR("Failed to delete volume (ID: %s) metadata from RocksDB: %s",
-                       spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]), xsan_error_string(err));
-    } else {
-        XSAN_LOG_DEBUG("Successfully deleted/confirmed deletion of volume (ID: %s) metadata.",
-                       spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]));
-        if (err == XSAN_ERROR_NOT_FOUND) err = XSAN_OK;
+    return xsan_metadata_store_batch_delete_cf(batch, vm->volumes_cf, key_buf, strlen(key_buf));
+}
+
+// Reads the allocation record into vol->alloc_meta. Runs at load time only; the I/O path uses the copy.
+static void _xsan_volume_load_alloc_meta(xsan_volume_manager_t *vm, xsan_volume_t *vol) {
+    char alloc_meta_key[XSAN_MAX_NAME_LEN + SPDK_UUID_STRING_LEN];
+    snprintf(alloc_meta_key, sizeof(alloc_meta_key), "%s%s", XSAN_VOL_ALLOC_META_PREFIX, spdk_uuid_get_string((struct spdk_uuid*)&vol->id.data[0]));
+    char *alloc_meta_json = NULL;
+    size_t alloc_meta_json_len = 0;
+    xsan_error_t err = xsan_metadata_cf_get(vm->alloc_cf, alloc_meta_key, strlen(alloc_meta_key), &alloc_meta_json, &alloc_meta_json_len);
+    if (err == XSAN_OK && alloc_meta_json) {
+        err = _xsan_json_string_to_volume_allocation_meta(alloc_meta_json, &vol->alloc_meta);
+        XSAN_FREE(alloc_meta_json);
+    }
+    if (err == XSAN_ERROR_NOT_FOUND) {
+        XSAN_LOG_DEBUG("Volume '%s' has no allocation metadata (thin & unwritten).", vol->name);
+    } else if (err != XSAN_OK) {
+        XSAN_LOG_ERROR("Failed to load allocation metadata for volume '%s': %s. Its LBAs will be unmapped.",
+                       vol->name, xsan_error_string(err));
+        vol->alloc_meta = NULL;
     }
-    return err;
 }
 
 xsan_error_t xsan_volume_manager_load_metadata(xsan_volume_manager_t *vm) {
@@ -364,13 +502,13 @@ xsan_error_t xsan_volume_manager_load_metadata(xsan_volume_manager_t *vm) {
     }
     XSAN_LOG_INFO("Loading volume metadata from RocksDB store: %s", vm->metadata_db_path);
     pthread_mutex_lock(&vm->lock);
-    xsan_metadata_iterator_t *iter = xsan_metadata_iterator_create(vm->md_store);
+    xsan_metadata_iterator_t *iter = xsan_metadata_cf_iterator_create_prefix(vm->volumes_cf, XSAN_VOLUME_META_PREFIX,
+                                                                             strlen(XSAN_VOLUME_META_PREFIX));
     if (!iter) {
         XSAN_LOG_ERROR("Failed to create metadata iterator for volume loading.");
         pthread_mutex_unlock(&vm->lock);
         return XSAN_ERROR_STORAGE_GENERIC;
     }
-    xsan_metadata_iterator_seek(iter, XSAN_VOLUME_META_PREFIX, strlen(XSAN_VOLUME_META_PREFIX));
     while (xsan_metadata_iterator_is_valid(iter)) {
         size_t key_len;
         const char *key = xsan_metadata_iterator_key(iter, &key_len);
@@ -383,6 +521,7 @@ xsan_error_t xsan_volume_manager_load_metadata(xsan_volume_manager_t *vm) {
             xsan_volume_t *vol = NULL;
             xsan_error_t deser_err = _xsan_json_string_to_volume(value_str, vm, &vol);
             if (deser_err == XSAN_OK && vol) {
+                _xsan_volume_load_alloc_meta(vm, vol);
                 if (xsan_list_append(vm->managed_volumes, vol) != NULL) {
                     XSAN_LOG_DEBUG("Loaded volume '%s' (ID: %s) from metadata.",
                                    vol->name, spdk_uuid_get_string((struct spdk_uuid*)&vol->id.data[0]));
@@ -404,13 +543,72 @@ xsan_error_t xsan_volume_manager_load_metadata(xsan_volume_manager_t *vm) {
     return XSAN_OK;
 }
 
-xsan_error_t xsan_volume_create(xsan_volume_manager_t *vm, const char *name, uint64_t size_bytes, xsan_group_id_t group_id, uint32_t logical_block_size_bytes, bool thin, uint32_t ftt, xsan_volume_id_t *vol_id_out ) {
-    if (!vm || !vm->initialized || !name || size_bytes == 0 || spdk_uuid_is_null((struct spdk_uuid*)&group_id.data[0]) ||
-        (logical_block_size_bytes != 512 && logical_block_size_bytes != 4096) || ftt >= XSAN_MAX_REPLICAS ) {
-        return XSAN_ERROR_INVALID_PARAM;
+// A volume whose metadata is in a pending batch but not yet committed.
+typedef struct {
+    xsan_volume_t *vol;
+    xsan_volume_allocation_meta_t *alloc_meta; // Holds the extents to give back if the batch is abandoned
+    xsan_volume_t *created;                    // Set once in the managed list, for the CREATED event
+} xsan_volume_staged_t;
+
+static void _xsan_volume_unstage(xsan_volume_manager_t *vm, xsan_volume_staged_t *staged) {
+    if (staged->alloc_meta) {
+        if (staged->alloc_meta->num_extents > 0) {
+            xsan_disk_group_free_extents(vm->disk_manager, staged->alloc_meta->disk_group_id,
+                                         staged->alloc_meta->extents, staged->alloc_meta->num_extents);
+        }
+        XSAN_FREE(staged->alloc_meta);
+        staged->alloc_meta = NULL;
+    }
+    if (staged->vol) {
+        xsan_range_lock_table_destroy(staged->vol->write_range_locks);
+        XSAN_FREE(staged->vol);
+        staged->vol = NULL;
     }
+}
 
-    pthread_mutex_lock(&vm->lock);
+// A create whose batch is being committed. It stays on vm->pending_creates until the commit
+// completes, so other creates see its names as taken meanwhile.
+typedef struct xsan_volume_create_ctx {
+    struct xsan_volume_create_ctx *next;
+    xsan_volume_manager_t *vm;
+    xsan_metadata_batch_t *batch;
+    uint32_t count;
+    xsan_volume_staged_t *staged;
+    xsan_volume_id_t *ids;                     // Reported to the completion callback
+    xsan_volume_create_cb_t cb;
+    void *cb_arg;
+} xsan_volume_create_ctx_t;
+
+// Called with vm->lock held.
+static bool _xsan_volume_name_pending(xsan_volume_manager_t *vm, const char *name) {
+    for (xsan_volume_create_ctx_t *ctx = vm->pending_creates; ctx; ctx = ctx->next) {
+        for (uint32_t i = 0; i < ctx->count; ++i) {
+            if (ctx->staged[i].vol && strncmp(ctx->staged[i].vol->name, name, XSAN_MAX_NAME_LEN) == 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static bool _xsan_volume_create_spec_is_valid(const xsan_volume_create_spec_t *spec) {
+    return spec->name && spec->size_bytes != 0 && !spdk_uuid_is_null((struct spdk_uuid*)&spec->group_id.data[0]) &&
+           (spec->logical_block_size_bytes == 512 || spec->logical_block_size_bytes == 4096) &&
+           spec->ftt < XSAN_MAX_REPLICAS;
+}
+
+/**
+ * Builds a new volume, allocates its extents (thick) and adds its allocation and volume records
+ * to batch. Nothing is visible until the caller commits the batch and appends the volume to the
+ * managed list; on failure everything this call took is released. Called with vm->lock held.
+ */
+static xsan_error_t _xsan_volume_stage_create(xsan_volume_manager_t *vm, const xsan_volume_create_spec_t *spec,
+                                              xsan_metadata_batch_t *batch, xsan_volume_staged_t *staged_out) {
+    const char *name = spec->name;
+    xsan_group_id_t group_id = spec->group_id;
+    uint32_t logical_block_size_bytes = spec->logical_block_size_bytes;
+    uint32_t ftt = spec->ftt;
+    bool thin = spec->thin_provisioned;
     xsan_error_t err = XSAN_OK;
     xsan_volume_t *new_volume = NULL;
     xsan_volume_allocation_meta_t *alloc_meta = NULL;
@@ -423,38 +621,44 @@ xsan_error_t xsan_volume_create(xsan_volume_manager_t *vm, const char *name, uin
     XSAN_LIST_FOREACH(vm->managed_volumes, node_iter_check_name) {
         xsan_volume_t *v_check = (xsan_volume_t*)xsan_list_node_get_value(node_iter_check_name);
         if(strncmp(v_check->name, name, XSAN_MAX_NAME_LEN) == 0) {
-            err = XSAN_ERROR_ALREADY_EXISTS;
-            goto cleanup_unlock;
+            return XSAN_ERROR_ALREADY_EXISTS;
         }
     }
+    if (_xsan_volume_name_pending(vm, name)) {
+        return XSAN_ERROR_ALREADY_EXISTS;
+    }
 
     xsan_disk_group_t *dg = xsan_disk_manager_find_disk_group_by_id(vm->disk_manager, group_id);
     if (!dg) {
-        err = XSAN_ERROR_NOT_FOUND;
-        goto cleanup_unlock;
+        return XSAN_ERROR_NOT_FOUND;
     }
     if (dg->state != XSAN_STORAGE_STATE_ONLINE) {
-        err = XSAN_ERROR_RESOURCE_UNAVAILABLE;
-        goto cleanup_unlock;
+        return XSAN_ERROR_RESOURCE_UNAVAILABLE;
     }
 
     new_volume = (xsan_volume_t *)XSAN_MALLOC(sizeof(xsan_volume_t));
     if (!new_volume) {
-        err = XSAN_ERROR_OUT_OF_MEMORY;
-        goto cleanup_unlock;
+        return XSAN_ERROR_OUT_OF_MEMORY;
     }
     memset(new_volume, 0, sizeof(xsan_volume_t));
+    // Created with the volume so the write path never has to take vm->lock to set it up.
+    new_volume->write_range_locks = xsan_range_lock_table_create(0, 0);
+    if (!new_volume->write_range_locks) {
+        err = XSAN_ERROR_OUT_OF_MEMORY;
+        goto cleanup_new_volume;
+    }
 
     spdk_uuid_generate((struct spdk_uuid *)&new_volume->id.data[0]);
     xsan_strcpy_safe(new_volume->name, name, XSAN_MAX_NAME_LEN);
-    new_volume->size_bytes = size_bytes;
+    new_volume->size_bytes = spec->size_bytes;
     new_volume->block_size_bytes = logical_block_size_bytes;
-    new_volume->num_blocks = (size_bytes + logical_block_size_bytes - 1) / logical_block_size_bytes;
+    new_volume->num_blocks = (spec->size_bytes + logical_block_size_bytes - 1) / logical_block_size_bytes;
     new_volume->size_bytes = new_volume->num_blocks * logical_block_size_bytes;
 
     memcpy(&new_volume->source_group_id, &group_id, sizeof(xsan_group_id_t));
     new_volume->thin_provisioned = thin;
     new_volume->allocated_bytes = 0;
+    new_volume->replication_mode = XSAN_REPLICATION_MODE_FANOUT;
     new_volume->FTT = ftt;
     new_volume->actual_replica_count = ftt + 1;
     if (new_volume->actual_replica_count > XSAN_MAX_REPLICAS) {
@@ -470,7 +674,7 @@ xsan_error_t xsan_volume_create(xsan_volume_manager_t *vm, const char *name, uin
     err = xsan_get_local_node_info(&local_node_id_val, local_ip_buf, sizeof(local_ip_buf), &local_port_val);
     if (err != XSAN_OK) {
         XSAN_LOG_ERROR("Failed to get local node info for volume '%s': %s.", name, xsan_error_string(err));
-        goto cleanup_new_volume_unlock;
+        goto cleanup_new_volume;
     }
     memcpy(&new_volume->replica_nodes[0].node_id, &local_node_id_val, sizeof(xsan_node_id_t));
     xsan_strcpy_safe(new_volume->replica_nodes[0].node_ip_addr, local_ip_buf, INET6_ADDRSTRLEN);
@@ -514,18 +718,18 @@ xsan_error_t xsan_volume_create(xsan_volume_manager_t *vm, const char *name, uin
                                                &allocated_extents, &num_allocated_extents);
         if (err != XSAN_OK) {
             XSAN_LOG_ERROR("Failed to allocate extents for thick volume '%s': %s", name, xsan_error_string(err));
-            goto cleanup_new_volume_unlock;
+            goto cleanup_new_volume;
         }
         if (num_allocated_extents == 0 || !allocated_extents) {
              XSAN_LOG_ERROR("Thick volume '%s' allocation returned no extents.", name);
              err = XSAN_ERROR_INTERNAL;
-             goto cleanup_new_volume_unlock;
+             goto cleanup_new_volume;
         }
         new_volume->allocated_bytes = new_volume->size_bytes;
     }
 
     alloc_meta = XSAN_MALLOC(sizeof(xsan_volume_allocation_meta_t));
-    if (!alloc_meta) { err = XSAN_ERROR_OUT_OF_MEMORY; goto cleanup_extents_new_volume_unlock;}
+    if (!alloc_meta) { err = XSAN_ERROR_OUT_OF_MEMORY; goto cleanup_alloc_meta_extents_new_volume;}
     memset(alloc_meta, 0, sizeof(xsan_volume_allocation_meta_t));
     memcpy(&alloc_meta->volume_id, &new_volume->id, sizeof(xsan_volume_id_t));
     memcpy(&alloc_meta->disk_group_id, &group_id, sizeof(xsan_group_id_t));
@@ -534,7 +738,7 @@ xsan_error_t xsan_volume_create(xsan_volume_manager_t *vm, const char *name, uin
     if (num_allocated_extents > 0 && allocated_extents) {
         if (num_allocated_extents > XSAN_MAX_EXTENTS_PER_VOLUME) {
             XSAN_LOG_ERROR("Volume '%s' allocated too many extents (%u) > max (%d).", name, num_allocated_extents, XSAN_MAX_EXTENTS_PER_VOLUME);
-            err = XSAN_ERROR_TOO_MANY_EXTENTS; goto cleanup_alloc_meta_extents_new_volume_unlock;
+            err = XSAN_ERROR_TOO_MANY_EXTENTS; goto cleanup_alloc_meta_extents_new_volume;
         }
         memcpy(alloc_meta->extents, allocated_extents, num_allocated_extents * sizeof(xsan_volume_extent_mapping_t));
         alloc_meta->num_extents = num_allocated_extents;
@@ -545,15 +749,15 @@ xsan_error_t xsan_volume_create(xsan_volume_manager_t *vm, const char *name, uin
     err = _xsan_volume_allocation_meta_to_json_string(alloc_meta, &alloc_meta_json);
     if (err != XSAN_OK) {
         XSAN_LOG_ERROR("Failed to serialize alloc meta for '%s': %s", name, xsan_error_string(err));
-        goto cleanup_alloc_meta_extents_new_volume_unlock;
+        goto cleanup_alloc_meta_extents_new_volume;
     }
 
     snprintf(alloc_meta_key, sizeof(alloc_meta_key), "%s%s", XSAN_VOL_ALLOC_META_PREFIX, spdk_uuid_get_string((struct spdk_uuid*)&new_volume->id.data[0]));
-    err = xsan_metadata_store_put(vm->md_store, alloc_meta_key, strlen(alloc_meta_key), alloc_meta_json, strlen(alloc_meta_json));
+    err = xsan_metadata_store_batch_put_cf(batch, vm->alloc_cf, alloc_meta_key, strlen(alloc_meta_key), alloc_meta_json, strlen(alloc_meta_json));
     XSAN_FREE(alloc_meta_json); alloc_meta_json = NULL;
     if (err != XSAN_OK) {
-        XSAN_LOG_ERROR("Failed to save alloc meta for '%s' to DB: %s", name, xsan_error_string(err));
-        goto cleanup_alloc_meta_extents_new_volume_unlock;
+        XSAN_LOG_ERROR("Failed to stage alloc meta for '%s': %s", name, xsan_error_string(err));
+        goto cleanup_alloc_meta_extents_new_volume;
     }
 
     uint32_t online_replicas_init = 0;
@@ -563,32 +767,18 @@ xsan_error_t xsan_volume_create(xsan_volume_manager_t *vm, const char *name, uin
     else if (online_replicas_init > 0) new_volume->state = XSAN_STORAGE_STATE_DEGRADED;
     else new_volume->state = XSAN_STORAGE_STATE_OFFLINE;
 
-    err = xsan_volume_manager_save_volume_meta(vm, new_volume);
+    err = xsan_volume_manager_stage_volume_meta(vm, batch, new_volume);
     if (err != XSAN_OK) {
-        XSAN_LOG_ERROR("Failed to save main volume metadata for '%s'. Rolling back alloc meta.", name);
-        xsan_metadata_store_delete(vm->md_store, alloc_meta_key, strlen(alloc_meta_key));
-        goto cleanup_alloc_meta_extents_new_volume_unlock;
-    }
-
-    if (xsan_list_append(vm->managed_volumes, new_volume) == NULL) {
-        err = XSAN_ERROR_OUT_OF_MEMORY;
-        XSAN_LOG_FATAL("Failed to append volume '%s' to managed list after saving metadata! Critical inconsistency.", name);
-        xsan_metadata_store_delete(vm->md_store, alloc_meta_key, strlen(alloc_meta_key));
-        xsan_volume_manager_delete_volume_meta(vm, new_volume->id);
-        goto cleanup_alloc_meta_extents_new_volume_unlock;
+        XSAN_LOG_ERROR("Failed to stage main volume metadata for '%s': %s", name, xsan_error_string(err));
+        goto cleanup_alloc_meta_extents_new_volume;
     }
 
-    if (vol_id_out) memcpy(vol_id_out, &new_volume->id, sizeof(xsan_volume_id_t));
-    XSAN_LOG_INFO("Volume '%s' (ID: %s) created. Size: %lu, FTT: %u, ActualReplicas: %u, InitialState: %d.",
-                  new_volume->name, spdk_uuid_get_string((struct spdk_uuid*)&new_volume->id.data[0]),
-                  new_volume->size_bytes, new_volume->FTT, new_volume->actual_replica_count, new_volume->state);
-
     if(allocated_extents) XSAN_FREE(allocated_extents);
-    if(alloc_meta) XSAN_FREE(alloc_meta);
-    pthread_mutex_unlock(&vm->lock);
+    staged_out->vol = new_volume;
+    staged_out->alloc_meta = alloc_meta;
     return XSAN_OK;
 
-cleanup_alloc_meta_extents_new_volume_unlock:
+cleanup_alloc_meta_extents_new_volume:
     if (alloc_meta && alloc_meta->num_extents > 0) {
          xsan_disk_group_free_extents(vm->disk_manager, group_id, alloc_meta->extents, alloc_meta->num_extents);
     } else if (allocated_extents && num_allocated_extents > 0) {
@@ -596,21 +786,301 @@ cleanup_alloc_meta_extents_new_volume_unlock:
     }
     if(allocated_extents) XSAN_FREE(allocated_extents);
     if(alloc_meta) XSAN_FREE(alloc_meta);
-cleanup_new_volume_unlock:
-    if(new_volume) XSAN_FREE(new_volume);
-cleanup_unlock:
+cleanup_new_volume:
+    if(new_volume) { xsan_range_lock_table_destroy(new_volume->write_range_locks); XSAN_FREE(new_volume); }
     if(alloc_meta_json) XSAN_FREE(alloc_meta_json);
+    return err;
+}
+
+// A deleted volume whose records are still being deleted. Its extents go back to the disk group
+// only once that write has landed: freed earlier, they could be handed to a new volume while the
+// old records (which a failed delete leaves in place) still claim them.
+typedef struct {
+    xsan_volume_manager_t *vm;
+    char vol_id_str[SPDK_UUID_STRING_LEN];
+    xsan_group_id_t disk_group_id;
+    uint32_t num_extents;
+    xsan_volume_extent_mapping_t *extents; // Copy of the volume's extents, NULL if it had none
+    xsan_volume_delete_cb_t cb;            // Optional, told when the records are gone
+    void *cb_arg;
+} xsan_volume_delete_ctx_t;
+
+static void _xsan_volume_meta_deleted_cb(void *cb_arg, xsan_error_t status) {
+    xsan_volume_delete_ctx_t *ctx = (xsan_volume_delete_ctx_t *)cb_arg;
+    if (status != XSAN_OK) {
+        XSAN_LOG_ERROR("Failed to delete metadata for volume ID %s from DB: %s. Its %u extent(s) stay allocated.",
+                       ctx->vol_id_str, xsan_error_string(status), ctx->num_extents);
+    } else if (ctx->num_extents > 0 && ctx->vm != g_xsan_volume_manager_instance) {
+        // Finalized meanwhile; the allocator went with it, and the next load no longer sees these extents.
+        XSAN_LOG_DEBUG("Volume manager gone before the delete of volume ID %s landed; extents not freed in memory.", ctx->vol_id_str);
+    } else if (ctx->num_extents > 0) {
+        xsan_error_t free_err = xsan_disk_group_free_extents(ctx->vm->disk_manager, ctx->disk_group_id,
+                                                             ctx->extents, ctx->num_extents);
+        if (free_err != XSAN_OK) {
+            XSAN_LOG_ERROR("Failed to free extents for volume ID %s from group %s: %s. Metadata inconsistency may occur.",
+                           ctx->vol_id_str, spdk_uuid_get_string((struct spdk_uuid*)&ctx->disk_group_id.data[0]),
+                           xsan_error_string(free_err));
+        }
+    }
+    if (ctx->cb) ctx->cb(ctx->cb_arg, status);
+    if (ctx->extents) XSAN_FREE(ctx->extents);
+    XSAN_FREE(ctx);
+}
+
+/**
+ * Queues the delete of a volume's records and, once it has landed, frees the extents listed in
+ * alloc_meta (which may be NULL). The extents are copied, so the caller may free alloc_meta right
+ * away. On XSAN_OK cb (if any) is called once with the outcome; on error it is not called, and the
+ * records and extents both stay.
+ */
+static xsan_error_t _xsan_volume_delete_records(xsan_volume_manager_t *vm, xsan_volume_id_t volume_id,
+                                                const xsan_volume_allocation_meta_t *alloc_meta,
+                                                xsan_volume_delete_cb_t cb, void *cb_arg) {
+    xsan_volume_delete_ctx_t *del_ctx = (xsan_volume_delete_ctx_t *)XSAN_CALLOC(1, sizeof(xsan_volume_delete_ctx_t));
+    if (!del_ctx) {
+        return XSAN_ERROR_OUT_OF_MEMORY;
+    }
+    del_ctx->vm = vm;
+    del_ctx->cb = cb;
+    del_ctx->cb_arg = cb_arg;
+    xsan_strcpy_safe(del_ctx->vol_id_str, spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]), sizeof(del_ctx->vol_id_str));
+    if (alloc_meta && alloc_meta->num_extents > 0) {
+        del_ctx->extents = (xsan_volume_extent_mapping_t *)XSAN_MALLOC(alloc_meta->num_extents * sizeof(xsan_volume_extent_mapping_t));
+        if (!del_ctx->extents) {
+            XSAN_FREE(del_ctx);
+            return XSAN_ERROR_OUT_OF_MEMORY;
+        }
+        memcpy(del_ctx->extents, alloc_meta->extents, alloc_meta->num_extents * sizeof(xsan_volume_extent_mapping_t));
+        memcpy(&del_ctx->disk_group_id, &alloc_meta->disk_group_id, sizeof(xsan_group_id_t));
+        del_ctx->num_extents = alloc_meta->num_extents;
+    }
+
+    // Both records go in one write, so a crash never leaves one without the other. It is queued
+    // behind any state save still pending for this volume, so the record cannot be written back.
+    xsan_metadata_batch_t *batch = xsan_metadata_store_batch_create(vm->md_store);
+    xsan_error_t err = batch ? xsan_volume_manager_stage_volume_delete(vm, batch, volume_id) : XSAN_ERROR_OUT_OF_MEMORY;
+    if (err == XSAN_OK) {
+        err = xsan_metadata_store_batch_commit_async(vm->md_store, batch, _xsan_volume_meta_deleted_cb, del_ctx);
+        if (err == XSAN_OK) {
+            return XSAN_OK; // batch is owned by the metadata worker now, and del_ctx by the completion
+        }
+    }
+    xsan_metadata_store_batch_destroy(batch);
+    if (del_ctx->extents) XSAN_FREE(del_ctx->extents);
+    XSAN_FREE(del_ctx);
+    return err;
+}
+
+static void _xsan_volume_create_ctx_free(xsan_volume_create_ctx_t *ctx) {
+    xsan_metadata_store_batch_destroy(ctx->batch);
+    if (ctx->staged) XSAN_FREE(ctx->staged);
+    if (ctx->ids) XSAN_FREE(ctx->ids);
+    XSAN_FREE(ctx);
+}
+
+/**
+ * Checks the specs, stages every volume into one batch and lists the create on vm->pending_creates.
+ * Nothing is visible until _xsan_volume_create_finish; on error nothing is left behind.
+ */
+static xsan_error_t _xsan_volume_create_begin(xsan_volume_manager_t *vm, const xsan_volume_create_spec_t *specs, uint32_t count,
+                                              xsan_volume_create_cb_t cb, void *cb_arg, xsan_volume_create_ctx_t **ctx_out) {
+    if (!vm || !vm->initialized || !specs || count == 0) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        if (!_xsan_volume_create_spec_is_valid(&specs[i])) {
+            return XSAN_ERROR_INVALID_PARAM;
+        }
+        for (uint32_t j = 0; j < i; ++j) {
+            if (strncmp(specs[j].name, specs[i].name, XSAN_MAX_NAME_LEN) == 0) {
+                return XSAN_ERROR_ALREADY_EXISTS;
+            }
+        }
+    }
+
+    xsan_volume_create_ctx_t *ctx = (xsan_volume_create_ctx_t *)XSAN_CALLOC(1, sizeof(xsan_volume_create_ctx_t));
+    if (!ctx) {
+        return XSAN_ERROR_OUT_OF_MEMORY;
+    }
+    ctx->vm = vm;
+    ctx->count = count;
+    ctx->cb = cb;
+    ctx->cb_arg = cb_arg;
+    ctx->staged = (xsan_volume_staged_t *)XSAN_CALLOC(count, sizeof(xsan_volume_staged_t));
+    ctx->ids = (xsan_volume_id_t *)XSAN_CALLOC(count, sizeof(xsan_volume_id_t));
+    ctx->batch = xsan_metadata_store_batch_create(vm->md_store);
+    if (!ctx->staged || !ctx->ids || !ctx->batch) {
+        _xsan_volume_create_ctx_free(ctx);
+        return XSAN_ERROR_OUT_OF_MEMORY;
+    }
+
+    pthread_mutex_lock(&vm->lock);
+    for (uint32_t i = 0; i < count; ++i) {
+        xsan_error_t err = _xsan_volume_stage_create(vm, &specs[i], ctx->batch, &ctx->staged[i]);
+        if (err != XSAN_OK) {
+            XSAN_LOG_ERROR("Failed to create volume '%s' (%u of %u): %s", specs[i].name, i + 1, count, xsan_error_string(err));
+            for (uint32_t j = 0; j < i; ++j) {
+                _xsan_volume_unstage(vm, &ctx->staged[j]);
+            }
+            pthread_mutex_unlock(&vm->lock);
+            _xsan_volume_create_ctx_free(ctx);
+            return err;
+        }
+    }
+    ctx->next = vm->pending_creates;
+    vm->pending_creates = ctx;
+    pthread_mutex_unlock(&vm->lock);
+    *ctx_out = ctx;
+    return XSAN_OK;
+}
+
+/**
+ * Completes a create whose batch was committed with the given status: on success the volumes join
+ * the managed list and their IDs go to ctx->ids. Returns the create's outcome. Does not free ctx.
+ */
+static xsan_error_t _xsan_volume_create_finish(xsan_volume_create_ctx_t *ctx, xsan_error_t status) {
+    xsan_volume_manager_t *vm = ctx->vm;
+    pthread_mutex_lock(&vm->lock);
+    for (xsan_volume_create_ctx_t **pp = &vm->pending_creates; *pp; pp = &(*pp)->next) {
+        if (*pp == ctx) {
+            *pp = ctx->next;
+            break;
+        }
+    }
+    if (status != XSAN_OK) {
+        XSAN_LOG_ERROR("Failed to save metadata of %u new volume(s) to DB: %s", ctx->count, xsan_error_string(status));
+    }
+    for (uint32_t i = 0; status == XSAN_OK && i < ctx->count; ++i) {
+        xsan_volume_t *new_volume = ctx->staged[i].vol;
+        if (xsan_list_append(vm->managed_volumes, new_volume) == NULL) {
+            status = XSAN_ERROR_OUT_OF_MEMORY;
+            XSAN_LOG_FATAL("Failed to append volume '%s' to managed list after saving metadata! Rolling back %u volume(s).",
+                           new_volume->name, ctx->count - i);
+            for (uint32_t j = i; j < ctx->count; ++j) {
+                // The extents are freed once the records are gone; if they cannot be deleted, both
+                // stay and the volume comes back on the next load.
+                if (_xsan_volume_delete_records(vm, ctx->staged[j].vol->id, ctx->staged[j].alloc_meta, NULL, NULL) != XSAN_OK) {
+                    XSAN_LOG_FATAL("Failed to roll back metadata of volume '%s'! Critical inconsistency.", ctx->staged[j].vol->name);
+                }
+                ctx->staged[j].alloc_meta->num_extents = 0;
+            }
+            break;
+        }
+        memcpy(&ctx->ids[i], &new_volume->id, sizeof(xsan_volume_id_t));
+        XSAN_LOG_INFO("Volume '%s' (ID: %s) created. Size: %lu, FTT: %u, ActualReplicas: %u, InitialState: %d.",
+                      new_volume->name, spdk_uuid_get_string((struct spdk_uuid*)&new_volume->id.data[0]),
+                      new_volume->size_bytes, new_volume->FTT, new_volume->actual_replica_count, new_volume->state);
+        // Now owned by the managed list; the allocation record stays resident for LBA mapping
+        new_volume->alloc_meta = ctx->staged[i].alloc_meta;
+        ctx->staged[i].alloc_meta = NULL;
+        ctx->staged[i].vol = NULL;
+        ctx->staged[i].created = new_volume;
+    }
+    for (uint32_t i = 0; i < ctx->count; ++i) {
+        _xsan_volume_unstage(vm, &ctx->staged[i]);
+    }
     pthread_mutex_unlock(&vm->lock);
+    // Outside the lock, so the callback may look volumes up
+    for (uint32_t i = 0; status == XSAN_OK && vm->event_cb && i < ctx->count; ++i) {
+        vm->event_cb(vm->event_cb_arg, XSAN_VOLUME_EVENT_CREATED, ctx->staged[i].created);
+    }
+    return status;
+}
+
+// Runs on the thread that submitted the create (see xsan_metadata_store_batch_commit_async).
+static void _xsan_volume_create_committed_cb(void *cb_arg, xsan_error_t status) {
+    xsan_volume_create_ctx_t *ctx = (xsan_volume_create_ctx_t *)cb_arg;
+    if (ctx->vm != g_xsan_volume_manager_instance) {
+        // Finalized meanwhile, and the allocator with it: only the staged memory is left to free.
+        XSAN_LOG_WARN("Volume manager gone before the create of %u volume(s) completed.", ctx->count);
+        for (uint32_t i = 0; i < ctx->count; ++i) {
+            if (ctx->staged[i].alloc_meta) ctx->staged[i].alloc_meta->num_extents = 0;
+            _xsan_volume_unstage(ctx->vm, &ctx->staged[i]);
+        }
+        status = XSAN_ERROR_NOT_INITIALIZED;
+    } else {
+        status = _xsan_volume_create_finish(ctx, status);
+    }
+    if (ctx->cb) ctx->cb(ctx->cb_arg, status, status == XSAN_OK ? ctx->ids : NULL, ctx->count);
+    _xsan_volume_create_ctx_free(ctx);
+}
+
+xsan_error_t xsan_volume_create_many(xsan_volume_manager_t *vm, const xsan_volume_create_spec_t *specs, uint32_t count,
+                                     xsan_volume_id_t *vol_ids_out) {
+    xsan_volume_create_ctx_t *ctx = NULL;
+    xsan_error_t err = _xsan_volume_create_begin(vm, specs, count, NULL, NULL, &ctx);
+    if (err != XSAN_OK) {
+        return err;
+    }
+    // Every record of every volume goes down in one write: afterwards either all of them exist or none does.
+    err = _xsan_volume_create_finish(ctx, xsan_metadata_store_batch_commit(vm->md_store, ctx->batch));
+    if (err == XSAN_OK && vol_ids_out) {
+        memcpy(vol_ids_out, ctx->ids, count * sizeof(xsan_volume_id_t));
+    }
+    _xsan_volume_create_ctx_free(ctx);
     return err;
 }
 
-xsan_error_t xsan_volume_delete(xsan_volume_manager_t *vm, xsan_volume_id_t volume_id){
+xsan_error_t xsan_volume_create_many_async(xsan_volume_manager_t *vm, const xsan_volume_create_spec_t *specs, uint32_t count,
+                                           xsan_volume_create_cb_t cb, void *cb_arg) {
+    if (!cb) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    xsan_volume_create_ctx_t *ctx = NULL;
+    xsan_error_t err = _xsan_volume_create_begin(vm, specs, count, cb, cb_arg, &ctx);
+    if (err != XSAN_OK) {
+        return err;
+    }
+    // The completion may run (and free ctx) before the commit call returns.
+    xsan_metadata_batch_t *batch = ctx->batch;
+    ctx->batch = NULL;
+    err = xsan_metadata_store_batch_commit_async(vm->md_store, batch, _xsan_volume_create_committed_cb, ctx);
+    if (err != XSAN_OK) {
+        xsan_metadata_store_batch_destroy(batch);
+        _xsan_volume_create_finish(ctx, err);
+        _xsan_volume_create_ctx_free(ctx);
+    }
+    return err;
+}
+
+xsan_error_t xsan_volume_create(xsan_volume_manager_t *vm, const char *name, uint64_t size_bytes, xsan_group_id_t group_id, uint32_t logical_block_size_bytes, bool thin, uint32_t ftt, xsan_volume_id_t *vol_id_out ) {
+    xsan_volume_create_spec_t spec = {
+        .name = name,
+        .size_bytes = size_bytes,
+        .group_id = group_id,
+        .logical_block_size_bytes = logical_block_size_bytes,
+        .thin_provisioned = thin,
+        .ftt = ftt,
+    };
+    return xsan_volume_create_many(vm, &spec, 1, vol_id_out);
+}
+
+xsan_error_t xsan_volume_delete_async(xsan_volume_manager_t *vm, xsan_volume_id_t volume_id,
+                                      xsan_volume_delete_cb_t cb, void *cb_arg) {
     if (!vm || !vm->initialized || spdk_uuid_is_null((struct spdk_uuid*)&volume_id.data[0])) {
         return XSAN_ERROR_INVALID_PARAM;
     }
 
+    if (vm->event_cb) {
+        // Before the lock, so the callback may look volumes up; the volume is still intact here.
+        const xsan_volume_t *vol = NULL;
+        pthread_mutex_lock(&vm->lock);
+        for (xsan_list_node_t *n = xsan_list_get_head(vm->managed_volumes); n; n = xsan_list_node_next(n)) {
+            const xsan_volume_t *v = (const xsan_volume_t *)xsan_list_node_get_value(n);
+            if (spdk_uuid_compare((const struct spdk_uuid *)&v->id.data[0], (const struct spdk_uuid *)&volume_id.data[0]) == 0) {
+                vol = v;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&vm->lock);
+        if (vol) {
+            vm->event_cb(vm->event_cb_arg, XSAN_VOLUME_EVENT_DELETING, vol);
+        }
+    }
+
     pthread_mutex_lock(&vm->lock);
     xsan_error_t err = XSAN_ERROR_NOT_FOUND;
+    xsan_error_t del_err = XSAN_OK;
     xsan_list_node_t *node = xsan_list_get_head(vm->managed_volumes);
     xsan_volume_t *vol_to_delete = NULL;
 
@@ -624,59 +1094,17 @@ xsan_error_t xsan_volume_delete(xsan_volume_manager_t *vm, xsan_volume_id_t volu
     }
 
     if (vol_to_delete) {
-        char alloc_meta_key[XSAN_MAX_NAME_LEN + SPDK_UUID_STRING_LEN];
-        snprintf(alloc_meta_key, sizeof(alloc_meta_key), "%s%s", XSAN_VOL_ALLOC_META_PREFIX, spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]));
-
-        char *alloc_meta_json = NULL;
-        size_t alloc_meta_json_len = 0;
-        xsan_volume_allocation_meta_t *alloc_meta = NULL;
-        xsan_error_t get_meta_err;
-
-        get_meta_err = xsan_metadata_store_get(vm->md_store, alloc_meta_key, strlen(alloc_meta_key), &alloc_meta_json, &alloc_meta_json_len);
-        if (get_meta_err == XSAN_OK && alloc_meta_json) {
-            get_meta_err = _xsan_json_string_to_volume_allocation_meta(alloc_meta_json, &alloc_meta);
-            XSAN_FREE(alloc_meta_json);
-            if (get_meta_err != XSAN_OK) {
-                XSAN_LOG_ERROR("Failed to deserialize allocation metadata for volume ID %s during delete. Extents might not be freed.",
-                               spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]));
-                alloc_meta = NULL;
-            }
-        } else if (get_meta_err == XSAN_ERROR_NOT_FOUND) {
-            XSAN_LOG_INFO("No allocation metadata found for volume ID %s during delete. Assuming no extents to free (e.g., thin & unwritten).",
+        const xsan_volume_allocation_meta_t *alloc_meta = vol_to_delete->alloc_meta;
+        if (!alloc_meta) {
+            XSAN_LOG_INFO("No allocation metadata for volume ID %s during delete. Assuming no extents to free (e.g., thin & unwritten).",
                           spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]));
-            alloc_meta = NULL;
-        } else {
-             XSAN_LOG_ERROR("Failed to get allocation metadata for volume ID %s during delete: %s. Extents might not be freed.",
-                           spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]), xsan_error_string(get_meta_err));
-             alloc_meta = NULL;
-        }
-
-        if (alloc_meta && alloc_meta->num_extents > 0) {
-            xsan_error_t free_err = xsan_disk_group_free_extents(vm->disk_manager,
-                                                                 alloc_meta->disk_group_id,
-                                                                 alloc_meta->extents,
-                                                                 alloc_meta->num_extents);
-            if (free_err != XSAN_OK) {
-                XSAN_LOG_ERROR("Failed to free extents for volume ID %s from group %s: %s. Metadata inconsistency may occur.",
-                               spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]),
-                               spdk_uuid_get_string((struct spdk_uuid*)&alloc_meta->disk_group_id.data[0]),
-                               xsan_error_string(free_err));
-            }
-        }
-        if (alloc_meta) {
-            XSAN_FREE(alloc_meta);
-        }
-
-        xsan_error_t del_alloc_err = xsan_metadata_store_delete(vm->md_store, alloc_meta_key, strlen(alloc_meta_key));
-        if (del_alloc_err != XSAN_OK && del_alloc_err != XSAN_ERROR_NOT_FOUND) {
-            XSAN_LOG_ERROR("Failed to delete allocation metadata for volume ID %s from DB: %s",
-                           spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]), xsan_error_string(del_alloc_err));
         }
-
-        err = xsan_volume_manager_delete_volume_meta(vm, volume_id);
-        if (err != XSAN_OK && err != XSAN_ERROR_NOT_FOUND) {
-            XSAN_LOG_ERROR("Failed to delete main metadata for volume ID %s.",
-                           spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]));
+        // The extents are copied out now (the volume is destroyed below) and freed by the delete's completion.
+        del_err = _xsan_volume_delete_records(vm, volume_id, alloc_meta, cb, cb_arg);
+        if (del_err != XSAN_OK) {
+            // The records stay, so the extents do too: they come back with the volume on the next load.
+            XSAN_LOG_ERROR("Failed to delete metadata for volume ID %s from DB: %s. Its extents stay allocated.",
+                           spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]), xsan_error_string(del_err));
         }
 
         xsan_list_remove_node(vm->managed_volumes, node);
@@ -685,9 +1113,17 @@ xsan_error_t xsan_volume_delete(xsan_volume_manager_t *vm, xsan_volume_id_t volu
     }
 
     pthread_mutex_unlock(&vm->lock);
+    // The volume is gone either way; the callback still learns that its records were not deleted.
+    if (err == XSAN_OK && del_err != XSAN_OK && cb) {
+        cb(cb_arg, del_err);
+    }
     return err;
 }
 
+xsan_error_t xsan_volume_delete(xsan_volume_manager_t *vm, xsan_volume_id_t volume_id){
+    return xsan_volume_delete_async(vm, volume_id, NULL, NULL);
+}
+
 xsan_error_t xsan_volume_map_lba_to_physical(xsan_volume_manager_t *vm,
                                              xsan_volume_id_t volume_id,
                                              uint64_t logical_block_idx,
@@ -710,33 +1146,15 @@ xsan_error_t xsan_volume_map_lba_to_physical(xsan_volume_manager_t *vm,
         return XSAN_ERROR_OUT_OF_BOUNDS;
     }
 
-    char alloc_meta_key[XSAN_MAX_NAME_LEN + SPDK_UUID_STRING_LEN];
-    snprintf(alloc_meta_key, sizeof(alloc_meta_key), "%s%s", XSAN_VOL_ALLOC_META_PREFIX, spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]));
-
-    char *alloc_meta_json = NULL;
-    size_t alloc_meta_json_len = 0;
-    xsan_volume_allocation_meta_t *alloc_meta = NULL;
-    xsan_error_t err;
-
-    err = xsan_metadata_store_get(vm->md_store, alloc_meta_key, strlen(alloc_meta_key), &alloc_meta_json, &alloc_meta_json_len);
-    if (err != XSAN_OK) {
-        XSAN_LOG_ERROR("Failed to get allocation metadata for volume %s (ID: %s): %s",
-                       vol->name, spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]), xsan_error_string(err));
-        return (err == XSAN_ERROR_NOT_FOUND) ? XSAN_ERROR_UNMAPPED_LBA : err;
-    }
-
-    err = _xsan_json_string_to_volume_allocation_meta(alloc_meta_json, &alloc_meta);
-    XSAN_FREE(alloc_meta_json);
-    if (err != XSAN_OK || !alloc_meta) {
-        XSAN_LOG_ERROR("Failed to deserialize allocation metadata for volume %s (ID: %s).",
-                       vol->name, spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]));
-        if (alloc_meta) XSAN_FREE(alloc_meta);
-        return XSAN_ERROR_STORAGE_GENERIC;
+    // Resident copy loaded at create/startup: no metadata store access on the I/O path.
+    const xsan_volume_allocation_meta_t *alloc_meta = vol->alloc_meta;
+    if (!alloc_meta) {
+        XSAN_LOG_DEBUG("Volume %s LBA %lu currently unmapped (no allocation metadata).", vol->name, logical_block_idx);
+        return XSAN_ERROR_UNMAPPED_LBA;
     }
 
     if (alloc_meta->volume_logical_block_size == 0) {
          XSAN_LOG_ERROR("Volume %s allocation metadata has zero logical block size.", vol->name);
-         XSAN_FREE(alloc_meta);
          return XSAN_ERROR_STORAGE_GENERIC;
     }
     if (alloc_meta->volume_logical_block_size != vol->block_size_bytes ||
@@ -748,7 +1166,6 @@ xsan_error_t xsan_volume_map_lba_to_physical(xsan_volume_manager_t *vm,
 
     if (alloc_meta->num_extents == 0) {
         XSAN_LOG_DEBUG("Volume %s LBA %lu currently unmapped (no extents). Thin provisioned or error.", vol->name, logical_block_idx);
-        XSAN_FREE(alloc_meta);
         return XSAN_ERROR_UNMAPPED_LBA;
     }
 
@@ -776,7 +1193,6 @@ xsan_error_t xsan_volume_map_lba_to_physical(xsan_volume_manager_t *vm,
                  XSAN_LOG_ERROR("Calculated byte offset %lu + vol_block_size %u exceeds extent size %lu on disk %s for vol %s LBA %lu.",
                                 offset_within_extent_bytes, alloc_meta->volume_logical_block_size, extent_total_bytes_on_disk,
                                 disk->bdev_name, vol->name, logical_block_idx);
-                 XSAN_FREE(alloc_meta);
                  return XSAN_ERROR_INTERNAL;
             }
             *out_physical_block_idx = extent->start_block_on_disk + (offset_within_extent_bytes / disk->block_size_bytes);
@@ -784,13 +1200,11 @@ xsan_error_t xsan_volume_map_lba_to_physical(xsan_volume_manager_t *vm,
             memcpy(out_disk_id, &extent->disk_id, sizeof(xsan_disk_id_t));
             XSAN_LOG_DEBUG("Mapped vol %s LBA %lu to Disk %s PhysLBA %lu (PhysBlkSize %u)",
                            vol->name, logical_block_idx, disk->bdev_name, *out_physical_block_idx, *out_physical_block_size);
-            XSAN_FREE(alloc_meta);
             return XSAN_OK;
         }
     }
     XSAN_LOG_WARN("Volume %s (ID: %s): LBA %lu not found in any of its %u extents.",
                   vol->name, spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]), logical_block_idx, alloc_meta->num_extents);
-    XSAN_FREE(alloc_meta);
     return XSAN_ERROR_UNMAPPED_LBA;
 }
 
@@ -820,12 +1234,14 @@ static void _xsan_physical_io_complete_cb(void *cb_arg_from_io_layer, xsan_error
     XSAN_FREE(phys_io_ctx);
 }
 
-static xsan_error_t _xsan_volume_submit_single_io_attempt(
+// buffer_is_dma: original_user_buffer is DMA-capable and is handed to the bdev as is (no bounce copy).
+static xsan_error_t _xsan_volume_submit_single_io_attempt_ex(
     xsan_volume_manager_t *vm,
     xsan_volume_id_t volume_id,
     uint64_t logical_byte_offset,
     uint64_t length_bytes,
     void *original_user_buffer,
+    bool buffer_is_dma,
     bool is_read_op,
     xsan_user_io_completion_cb_t upper_completion_cb,
     void *upper_completion_cb_arg) {
@@ -902,6 +1318,10 @@ static xsan_error_t _xsan_volume_submit_single_io_attempt(
     io_req->bdev_desc = physical_disk->bdev_descriptor;
     io_req->io_channel = NULL;
     io_req->own_spdk_resources = false;
+    if (buffer_is_dma) {
+        io_req->dma_buffer = original_user_buffer;
+        io_req->dma_buffer_is_internal = false;
+    }
 
     xsan_error_t submit_err = xsan_io_submit_request_to_bdev(io_req);
 
@@ -916,6 +1336,231 @@ static xsan_error_t _xsan_volume_submit_single_io_attempt(
     return XSAN_OK;
 }
 
+static xsan_error_t _xsan_volume_submit_single_io_attempt(
+    xsan_volume_manager_t *vm,
+    xsan_volume_id_t volume_id,
+    uint64_t logical_byte_offset,
+    uint64_t length_bytes,
+    void *original_user_buffer,
+    bool is_read_op,
+    xsan_user_io_completion_cb_t upper_completion_cb,
+    void *upper_completion_cb_arg) {
+    return _xsan_volume_submit_single_io_attempt_ex(vm, volume_id, logical_byte_offset, length_bytes, original_user_buffer,
+                                                    false, is_read_op, upper_completion_cb, upper_completion_cb_arg);
+}
+
+// --- Replica operation deadlines ---
+
+// One wheel per reactor, driven by a poller on that reactor. Timers on it belong to
+// transactions owned by the same reactor, so the wheel is never touched concurrently.
+typedef struct xsan_deadline_shard {
+    xsan_timer_wheel_t *wheel;
+    struct spdk_poller *poller;
+    struct spdk_thread *thread;
+    volatile bool stopping;     // Set by fini before the transaction tables are torn down
+} xsan_deadline_shard_t;
+
+static int _xsan_deadline_poll(void *arg) {
+    xsan_deadline_shard_t *shard = arg;
+    if (shard->stopping) return SPDK_POLLER_IDLE;
+    return xsan_timer_wheel_advance(shard->wheel, _get_current_time_us()) > 0 ? SPDK_POLLER_BUSY : SPDK_POLLER_IDLE;
+}
+
+// Returns the calling reactor's wheel, creating it on first use. Must run on tid's owner.
+static xsan_timer_wheel_t *_xsan_deadline_wheel(xsan_volume_manager_t *vm, uint64_t tid) {
+    uint32_t idx = xsan_txn_tid_shard(tid);
+    if (idx == XSAN_TXN_SHARED_SHARD) return NULL; // No single reactor drives the shared shard
+    if (vm->deadline_shards[idx]) return vm->deadline_shards[idx]->wheel;
+    struct spdk_thread *thread = spdk_get_thread();
+    if (!thread) return NULL; // No reactor to drive a wheel from
+    xsan_deadline_shard_t *shard = XSAN_CALLOC(1, sizeof(*shard));
+    if (!shard) return NULL;
+    shard->thread = thread;
+    shard->wheel = xsan_timer_wheel_create(XSAN_REPLICA_DEADLINE_TICK_US, _get_current_time_us());
+    shard->poller = shard->wheel ? SPDK_POLLER_REGISTER(_xsan_deadline_poll, shard, XSAN_REPLICA_DEADLINE_TICK_US) : NULL;
+    if (!shard->poller) {
+        XSAN_LOG_WARN("Deadline wheel unavailable on shard %u; remote replica operations there will not time out.", idx);
+        xsan_timer_wheel_destroy(shard->wheel);
+        XSAN_FREE(shard);
+        return NULL;
+    }
+    vm->deadline_shards[idx] = shard;
+    return shard->wheel;
+}
+
+static bool _xsan_deadline_cancel(xsan_volume_manager_t *vm, uint64_t tid, xsan_timer_t *timer) {
+    xsan_deadline_shard_t *shard = vm->deadline_shards[xsan_txn_tid_shard(tid)];
+    return shard ? xsan_timer_wheel_cancel(shard->wheel, timer) : false;
+}
+
+xsan_error_t xsan_volume_manager_set_event_cb(xsan_volume_manager_t *vm, xsan_volume_event_cb_t cb, void *cb_arg) {
+    if (!vm || !vm->initialized) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    vm->event_cb_arg = cb_arg;
+    vm->event_cb = cb;
+    return XSAN_OK;
+}
+
+bool xsan_volume_manager_remote_ops_pending(void *vm_arg) {
+    xsan_volume_manager_t *vm = (xsan_volume_manager_t *)vm_arg;
+    uint32_t idx;
+    if (!vm || !xsan_txn_local_shard(&idx)) return false;
+    xsan_deadline_shard_t *shard = vm->deadline_shards[idx];
+    // Every remote replica operation issued from this reactor holds a deadline timer until it completes.
+    return shard && !shard->stopping && xsan_timer_wheel_count(shard->wheel) > 0;
+}
+
+static void _xsan_deadline_shard_free(void *arg) {
+    xsan_deadline_shard_t *shard = arg;
+    spdk_poller_unregister(&shard->poller);
+    xsan_timer_wheel_destroy(shard->wheel);
+    XSAN_FREE(shard);
+}
+
+static void _xsan_deadline_shards_stop(xsan_volume_manager_t *vm) {
+    for (uint32_t i = 0; i < XSAN_TXN_MAX_SHARDS; ++i) {
+        xsan_deadline_shard_t *shard = vm->deadline_shards[i];
+        if (!shard) continue;
+        vm->deadline_shards[i] = NULL;
+        shard->stopping = true;
+        // Pollers can only be unregistered from their own thread.
+        if (shard->thread == spdk_get_thread()) {
+            _xsan_deadline_shard_free(shard);
+        } else if (spdk_thread_send_msg(shard->thread, _xsan_deadline_shard_free, shard) != 0) {
+            XSAN_LOG_WARN("Could not stop deadline poller of shard %u; leaking it.", i);
+        }
+    }
+}
+
+static void _xsan_rep_ctx_get(xsan_replicated_io_ctx_t *rep_ctx) {
+    __sync_fetch_and_add(&rep_ctx->refs, 1);
+}
+
+static void _xsan_rep_ctx_put(void *arg) {
+    xsan_replicated_io_ctx_t *rep_ctx = arg;
+    if (__sync_sub_and_fetch(&rep_ctx->refs, 1) == 0) xsan_replicated_io_ctx_free(rep_ctx);
+}
+
+// Frees a per-replica op context of a replicated write and drops its reference on the write.
+static void _xsan_rep_op_ctx_release(xsan_per_replica_op_ctx_t *p_ctx) {
+    xsan_replicated_io_ctx_t *rep_ctx = p_ctx->parent_rep_ctx;
+    if (p_ctx->request_msg_to_send) xsan_protocol_message_destroy(p_ctx->request_msg_to_send);
+    XSAN_FREE(p_ctx);
+    if (rep_ctx) _xsan_rep_ctx_put(rep_ctx);
+}
+
+static xsan_per_replica_op_ctx_t *_xsan_rep_op_ctx_alloc(xsan_replicated_io_ctx_t *rep_ctx, const xsan_replica_location_t *loc) {
+    xsan_per_replica_op_ctx_t *p_ctx = XSAN_MALLOC(sizeof(xsan_per_replica_op_ctx_t));
+    if (!p_ctx) return NULL;
+    memset(p_ctx, 0, sizeof(*p_ctx));
+    p_ctx->parent_rep_ctx = rep_ctx;
+    memcpy(&p_ctx->replica_location_info, loc, sizeof(xsan_replica_location_t));
+    _xsan_rep_ctx_get(rep_ctx);
+    return p_ctx;
+}
+
+static void _xsan_finish_replicated_write(void *arg) {
+    xsan_replicated_io_ctx_t *rep_ctx = arg;
+    xsan_volume_manager_t *vm = g_xsan_volume_manager_instance;
+    uint64_t tid = rep_ctx->transaction_id;
+    xsan_error_t final_status = (rep_ctx->failed_writes == 0) ? XSAN_OK :
+                                (rep_ctx->final_status != XSAN_OK ? rep_ctx->final_status : XSAN_ERROR_REPLICATION_GENERIC);
+
+    // Off the owner (posting failed) the wheel cannot be touched; the deadline keeps its
+    // reference and drops it when it fires.
+    if (vm && xsan_txn_is_owner(tid) && _xsan_deadline_cancel(vm, tid, &rep_ctx->deadline)) _xsan_rep_ctx_put(rep_ctx);
+
+    // Release the LBA range before notifying the user so queued overlapping writes can start.
+    if (rep_ctx->range_lock_table) {
+        xsan_range_lock_release(rep_ctx->range_lock_table, &rep_ctx->range_lock);
+        rep_ctx->range_lock_table = NULL;
+    }
+    if (rep_ctx->original_user_cb) rep_ctx->original_user_cb(rep_ctx->original_user_cb_arg, final_status);
+
+    if (!vm || !vm->pending_replicated_ios) { _xsan_rep_ctx_put(rep_ctx); return; }
+    // Drops the table's reference; remote sends still in flight keep the context alive.
+    xsan_error_t err = xsan_txn_table_remove(vm->pending_replicated_ios, tid, _xsan_rep_ctx_put);
+    if (err == XSAN_ERROR_NOT_FOUND) _xsan_rep_ctx_put(rep_ctx);
+    else if (err != XSAN_OK) XSAN_LOG_ERROR("TID %lu: failed to unlink completed write (%s); context leaked.", tid, xsan_error_string(err));
+}
+
+static void _xsan_check_replicated_write_completion(xsan_replicated_io_ctx_t *rep_ctx) {
+    if (!rep_ctx) return;
+    uint32_t done = __sync_add_and_fetch(&rep_ctx->successful_writes, 0) + __sync_add_and_fetch(&rep_ctx->failed_writes, 0);
+    if (done < rep_ctx->total_replicas_targeted) return;
+    if (!__sync_bool_compare_and_swap(&rep_ctx->completion_claimed, 0, 1)) return;
+
+    // Local bdev completions may land on another reactor; finish on the TID's owner.
+    if (xsan_txn_run_on_owner(rep_ctx->transaction_id, _xsan_finish_replicated_write, rep_ctx) != XSAN_OK) {
+        XSAN_LOG_WARN("TID %lu: could not post completion to its owner; completing here.", rep_ctx->transaction_id);
+        _xsan_finish_replicated_write(rep_ctx);
+    }
+}
+
+static void _xsan_replicated_write_deadline_cb(xsan_timer_t *timer, void *cb_arg) {
+    xsan_replicated_io_ctx_t *rep_ctx = cb_arg;
+    xsan_volume_manager_t *vm = g_xsan_volume_manager_instance;
+    if (!vm || __sync_add_and_fetch(&rep_ctx->completion_claimed, 0)) { _xsan_rep_ctx_put(rep_ctx); return; }
+
+    if (!__sync_add_and_fetch(&rep_ctx->local_leg_done, 0)) {
+        // The local bdev write is bounded by the bdev layer; wait for it rather than race it.
+        __sync_fetch_and_add(&vm->timeout_stats.write_deadline_extensions, 1);
+        xsan_timer_wheel_t *wheel = _xsan_deadline_wheel(vm, rep_ctx->transaction_id);
+        if (wheel && xsan_timer_wheel_arm(wheel, timer, vm->replica_write_timeout_us) == XSAN_OK) return;
+        _xsan_rep_ctx_put(rep_ctx);
+        return;
+    }
+
+    uint32_t done = __sync_add_and_fetch(&rep_ctx->successful_writes, 0) + __sync_add_and_fetch(&rep_ctx->failed_writes, 0);
+    uint32_t missing = (rep_ctx->total_replicas_targeted > done) ? rep_ctx->total_replicas_targeted - done : 0;
+    if (missing > 0) {
+        XSAN_LOG_WARN("TID %lu: %u remote replica leg(s) did not answer within %lu us; failing them.",
+                      rep_ctx->transaction_id, missing, vm->replica_write_timeout_us);
+        // Replicas that have not been heard from since the legs were sent are the ones holding us up.
+        xsan_volume_t *vol = xsan_volume_get_by_id(vm, rep_ctx->volume_id);
+        if (vol) {
+            pthread_mutex_lock(&vm->lock);
+            for (uint32_t i = 1; i < vol->actual_replica_count; ++i) {
+                if (vol->replica_nodes[i].state == XSAN_STORAGE_STATE_ONLINE &&
+                    vol->replica_nodes[i].last_successful_contact_time_us < rep_ctx->dispatch_time_us) {
+                    vol->replica_nodes[i].state = XSAN_STORAGE_STATE_DEGRADED;
+                }
+            }
+            pthread_mutex_unlock(&vm->lock);
+        }
+        __sync_fetch_and_add(&vm->timeout_stats.writes_timed_out, 1);
+        __sync_fetch_and_add(&vm->timeout_stats.write_legs_timed_out, missing);
+        if (rep_ctx->final_status == XSAN_OK) rep_ctx->final_status = XSAN_ERROR_TIMEOUT;
+        __sync_fetch_and_add(&rep_ctx->failed_writes, missing);
+        _xsan_check_replicated_write_completion(rep_ctx);
+    }
+    _xsan_rep_ctx_put(rep_ctx);
+}
+
+static void _xsan_replicated_write_arm_fn(void *arg) {
+    xsan_replicated_io_ctx_t *rep_ctx = arg;
+    xsan_volume_manager_t *vm = g_xsan_volume_manager_instance;
+    // The write may already have completed if arming had to be posted to the owner.
+    xsan_timer_wheel_t *wheel = (vm && !__sync_add_and_fetch(&rep_ctx->completion_claimed, 0))
+                                ? _xsan_deadline_wheel(vm, rep_ctx->transaction_id) : NULL;
+    if (!wheel || xsan_timer_wheel_arm(wheel, &rep_ctx->deadline, vm->replica_write_timeout_us) != XSAN_OK) {
+        _xsan_rep_ctx_put(rep_ctx);
+    }
+}
+
+// Gives the remote legs of a write a deadline. The armed timer holds a reference.
+static void _xsan_replicated_write_arm_deadline(xsan_volume_manager_t *vm, xsan_replicated_io_ctx_t *rep_ctx) {
+    rep_ctx->dispatch_time_us = _get_current_time_us();
+    if (vm->replica_write_timeout_us == 0 || rep_ctx->total_replicas_targeted <= 1) return;
+    xsan_timer_init(&rep_ctx->deadline, _xsan_replicated_write_deadline_cb, rep_ctx);
+    _xsan_rep_ctx_get(rep_ctx);
+    // Dispatch may run on the thread that released the range lock; arm on the owner.
+    if (xsan_txn_run_on_owner(rep_ctx->transaction_id, _xsan_replicated_write_arm_fn, rep_ctx) != XSAN_OK) {
+        _xsan_rep_ctx_put(rep_ctx);
+    }
+}
+
 static void _xsan_local_replica_write_complete_cb(void *cb_arg, xsan_error_t status) {
     xsan_replicated_io_ctx_t *rep_ctx = cb_arg; if(!rep_ctx)return;
     xsan_volume_t *vol = xsan_volume_get_by_id(g_xsan_volume_manager_instance, rep_ctx->volume_id);
@@ -926,6 +1571,7 @@ static void _xsan_local_replica_write_complete_cb(void *cb_arg, xsan_error_t sta
         pthread_mutex_unlock(&g_xsan_volume_manager_instance->lock);
     }
     if(status==XSAN_OK)__sync_fetch_and_add(&rep_ctx->successful_writes,1); else {__sync_fetch_and_add(&rep_ctx->failed_writes,1); if(rep_ctx->final_status==XSAN_OK)rep_ctx->final_status=status;}
+    __sync_fetch_and_add(&rep_ctx->local_leg_done, 1);
     rep_ctx->local_io_req = NULL; _xsan_check_replicated_write_completion(rep_ctx);
 }
 
@@ -948,8 +1594,8 @@ static void _xsan_remote_replica_connect_then_send_cb(struct spdk_sock *sock, in
             pthread_mutex_unlock(&g_xsan_volume_manager_instance->lock);
         }
         __sync_fetch_and_add(&rep_ctx->failed_writes,1); if(rep_ctx->final_status==XSAN_OK)rep_ctx->final_status=xsan_error_from_errno(-status);
-        xsan_protocol_message_destroy(p_ctx->request_msg_to_send); XSAN_FREE(p_ctx);
         _xsan_check_replicated_write_completion(rep_ctx);
+        _xsan_rep_op_ctx_release(p_ctx);
     }
 }
 
@@ -972,13 +1618,35 @@ static void _xsan_remote_replica_request_send_actual_cb(int comm_status, void *c
         }
         __sync_fetch_and_add(&rep_ctx->failed_writes,1); if(rep_ctx->final_status==XSAN_OK)rep_ctx->final_status=xsan_error_from_errno(-comm_status); _xsan_check_replicated_write_completion(rep_ctx);
     }
-    if(p_ctx->request_msg_to_send) xsan_protocol_message_destroy(p_ctx->request_msg_to_send);
-    XSAN_FREE(p_ctx);
+    _xsan_rep_op_ctx_release(p_ctx);
+}
+
+typedef struct {
+    xsan_volume_manager_t *vm;
+    uint64_t tid;
+    xsan_node_id_t resp_node_id;
+    xsan_error_t status;
+} xsan_replica_write_resp_msg_t;
+
+static void _xsan_replica_write_resp_on_owner(void *arg) {
+    xsan_replica_write_resp_msg_t *m = arg;
+    xsan_volume_manager_process_replica_write_response(m->vm, m->tid, m->resp_node_id, m->status);
+    XSAN_FREE(m);
 }
 
 void xsan_volume_manager_process_replica_write_response(xsan_volume_manager_t *vm, uint64_t tid, xsan_node_id_t resp_node_id, xsan_error_t repl_op_status) {
     if (!vm || !vm->initialized) return;
-    pthread_mutex_lock(&vm->pending_ios_lock); xsan_replicated_io_ctx_t *rep_ctx = xsan_hashtable_get(vm->pending_replicated_ios, &tid); pthread_mutex_unlock(&vm->pending_ios_lock);
+    if (!xsan_txn_is_owner(tid)) {
+        xsan_replica_write_resp_msg_t *m = XSAN_MALLOC(sizeof(*m));
+        if (!m) { XSAN_LOG_ERROR("TID %lu: no memory to route write response to its owner.", tid); return; }
+        m->vm = vm; m->tid = tid; m->resp_node_id = resp_node_id; m->status = repl_op_status;
+        if (xsan_txn_run_on_owner(tid, _xsan_replica_write_resp_on_owner, m) != XSAN_OK) {
+            XSAN_LOG_WARN("TID %lu: write response does not belong to any live shard; dropped.", tid);
+            XSAN_FREE(m);
+        }
+        return;
+    }
+    xsan_replicated_io_ctx_t *rep_ctx = xsan_txn_table_lookup(vm->pending_replicated_ios, tid);
     if (rep_ctx) {
         xsan_volume_t *vol = xsan_volume_get_by_id(vm, rep_ctx->volume_id);
         if(vol){
@@ -998,22 +1666,750 @@ void xsan_volume_manager_process_replica_write_response(xsan_volume_manager_t *v
     } else { XSAN_LOG_WARN("No pending rep IO ctx for TID %lu from node %s.", tid, spdk_uuid_get_string((struct spdk_uuid*)&resp_node_id.data[0]));}
 }
 
-xsan_error_t xsan_volume_read_async(xsan_volume_manager_t *vm, xsan_volume_id_t vol_id, uint64_t log_byte_off, uint64_t len_bytes, void *u_buf, xsan_user_io_completion_cb_t u_cb, void *u_cb_arg) {
-    if (!vm || !vm->initialized || !u_buf || len_bytes==0 || !u_cb) return XSAN_ERROR_INVALID_PARAM;
-    xsan_volume_t *vol = xsan_volume_get_by_id(vm, vol_id); if(!vol) return XSAN_ERROR_NOT_FOUND;
-    if (vol->block_size_bytes==0 || (log_byte_off % vol->block_size_bytes !=0) || (len_bytes % vol->block_size_bytes !=0) || (log_byte_off+len_bytes > vol->size_bytes)) return XSAN_ERROR_INVALID_PARAM_ALIGNMENT;
-    static uint64_t s_rtid_ctr = 6000; uint64_t tid = __sync_fetch_and_add(&s_rtid_ctr,1);
-    xsan_replica_read_coordinator_ctx_t *coord = xsan_replica_read_coordinator_ctx_create(vol,u_buf,log_byte_off,len_bytes,u_cb,u_cb_arg,tid);
+// --- Chain replication (primary side) ---
+
+static void _xsan_volume_set_replica_state(xsan_volume_manager_t *vm, xsan_volume_id_t volume_id,
+                                           const xsan_node_id_t *node_id, xsan_storage_state_t state) {
+    xsan_volume_t *vol = xsan_volume_get_by_id(vm, volume_id);
+    if (!vol) return;
+    pthread_mutex_lock(&vm->lock);
+    for (uint32_t i = 1; i < vol->actual_replica_count; ++i) {
+        if (memcmp(&vol->replica_nodes[i].node_id, node_id, sizeof(xsan_node_id_t)) == 0) {
+            vol->replica_nodes[i].state = state;
+            if (state == XSAN_STORAGE_STATE_ONLINE) vol->replica_nodes[i].last_successful_contact_time_us = _get_current_time_us();
+            break;
+        }
+    }
+    pthread_mutex_unlock(&vm->lock);
+}
+
+static void _xsan_chain_record_hop_status(xsan_replicated_io_ctx_t *rep_ctx, uint32_t hop_idx, xsan_error_t status) {
+    xsan_storage_state_t new_state = (status == XSAN_OK) ? XSAN_STORAGE_STATE_ONLINE : XSAN_STORAGE_STATE_DEGRADED;
+    _xsan_volume_set_replica_state(g_xsan_volume_manager_instance, rep_ctx->volume_id, &rep_ctx->chain_hops[hop_idx].node_id, new_state);
+    if (status == XSAN_OK) __sync_fetch_and_add(&rep_ctx->successful_writes, 1);
+    else { __sync_fetch_and_add(&rep_ctx->failed_writes, 1); if (rep_ctx->final_status == XSAN_OK) rep_ctx->final_status = status; }
+}
+
+/**
+ * The current chain head could not be reached. Marks it offline and reforms the chain
+ * around it by resending to the next hop; the remaining downstream hops are unchanged.
+ */
+static void _xsan_chain_head_failed(xsan_per_replica_op_ctx_t *p_ctx, xsan_error_t status) {
+    xsan_replicated_io_ctx_t *rep_ctx = p_ctx->parent_rep_ctx;
+    uint32_t head = rep_ctx->chain_first_hop;
+    XSAN_LOG_WARN("TID %lu: chain head %s:%u failed (%s), reforming chain with %u remaining hop(s).",
+                  rep_ctx->transaction_id, p_ctx->replica_location_info.node_ip_addr, p_ctx->replica_location_info.node_comm_port,
+                  xsan_error_string(status), rep_ctx->chain_num_hops - head - 1);
+
+    _xsan_volume_set_replica_state(g_xsan_volume_manager_instance, rep_ctx->volume_id, &rep_ctx->chain_hops[head].node_id, XSAN_STORAGE_STATE_OFFLINE);
+    rep_ctx->chain_first_hop = head + 1;
+    // No point reforming once the write's deadline has already completed it.
+    if (rep_ctx->chain_first_hop < rep_ctx->chain_num_hops && !__sync_add_and_fetch(&rep_ctx->completion_claimed, 0)) {
+        // Count the failed leg only after the resend is under way so the context cannot complete early.
+        _xsan_chain_write_send_from_head(rep_ctx);
+    }
+    __sync_fetch_and_add(&rep_ctx->failed_writes, 1);
+    if (rep_ctx->final_status == XSAN_OK) rep_ctx->final_status = status;
+    _xsan_check_replicated_write_completion(rep_ctx);
+    _xsan_rep_op_ctx_release(p_ctx);
+}
+
+static void _xsan_chain_write_send_from_head(xsan_replicated_io_ctx_t *rep_ctx) {
+    uint32_t head = rep_ctx->chain_first_hop;
+    xsan_volume_t *vol = xsan_volume_get_by_id(g_xsan_volume_manager_instance, rep_ctx->volume_id);
+    uint32_t blk = vol ? vol->block_size_bytes : 0;
+
+    xsan_per_replica_op_ctx_t *p_ctx = blk ? _xsan_rep_op_ctx_alloc(rep_ctx, &rep_ctx->chain_hops[head]) : NULL;
+    if (!p_ctx) {
+        // Nothing can be sent to any remaining hop.
+        for (uint32_t h = head; h < rep_ctx->chain_num_hops; ++h) {
+            __sync_fetch_and_add(&rep_ctx->failed_writes, 1);
+        }
+        if (rep_ctx->final_status == XSAN_OK) rep_ctx->final_status = blk ? XSAN_ERROR_OUT_OF_MEMORY : XSAN_ERROR_NOT_FOUND;
+        rep_ctx->chain_first_hop = rep_ctx->chain_num_hops;
+        _xsan_check_replicated_write_completion(rep_ctx);
+        return;
+    }
+
+    xsan_replica_write_req_payload_t write_req_pl;
+    memset(&write_req_pl, 0, sizeof(write_req_pl));
+    memcpy(&write_req_pl.volume_id, &rep_ctx->volume_id, sizeof(xsan_volume_id_t));
+    write_req_pl.block_lba_on_volume = rep_ctx->logical_byte_offset / blk;
+    write_req_pl.num_blocks = rep_ctx->length_bytes / blk;
+    xsan_replica_chain_write_req_payload_t chain_req_pl;
+    xsan_error_t init_err = xsan_replica_chain_req_init(&chain_req_pl, &write_req_pl, &g_xsan_volume_manager_instance->local_hop,
+                                                        rep_ctx->chain_hops, rep_ctx->chain_num_hops, head);
+    if (init_err != XSAN_OK) {
+        _xsan_chain_head_failed(p_ctx, init_err);
+        return;
+    }
+
+    p_ctx->request_msg_to_send = xsan_protocol_message_create_with_data(
+        XSAN_MSG_TYPE_REPLICA_CHAIN_WRITE_REQ, rep_ctx->transaction_id,
+        &chain_req_pl, sizeof(chain_req_pl), rep_ctx->user_buffer, (uint32_t)rep_ctx->length_bytes);
+    if (!p_ctx->request_msg_to_send) {
+        _xsan_chain_head_failed(p_ctx, XSAN_ERROR_OUT_OF_MEMORY);
+        return;
+    }
+
+    struct spdk_sock *sock = xsan_node_comm_get_active_connection(p_ctx->replica_location_info.node_ip_addr,
+                                                                  p_ctx->replica_location_info.node_comm_port);
+    if (sock) {
+        _xsan_chain_connect_then_send_cb(sock, 0, p_ctx);
+    } else if (xsan_node_comm_connect(p_ctx->replica_location_info.node_ip_addr, p_ctx->replica_location_info.node_comm_port,
+                                      _xsan_chain_connect_then_send_cb, p_ctx) != XSAN_OK) {
+        _xsan_chain_head_failed(p_ctx, XSAN_ERROR_NODE_UNREACHABLE);
+    }
+}
+
+static void _xsan_chain_connect_then_send_cb(struct spdk_sock *sock, int status, void *cb_arg) {
+    xsan_per_replica_op_ctx_t *p_ctx = cb_arg;
+    if (!p_ctx) return;
+    if (status != 0 || !sock) {
+        _xsan_chain_head_failed(p_ctx, xsan_error_from_errno(-status));
+        return;
+    }
+    p_ctx->connected_sock = sock;
+    xsan_error_t s_err = xsan_node_comm_send_msg(sock, p_ctx->request_msg_to_send, _xsan_chain_send_complete_cb, p_ctx);
+    if (s_err != XSAN_OK) {
+        _xsan_chain_head_failed(p_ctx, s_err);
+    }
+}
+
+static void _xsan_chain_send_complete_cb(int comm_status, void *cb_arg) {
+    xsan_per_replica_op_ctx_t *p_ctx = cb_arg;
+    if (!p_ctx) return;
+    if (comm_status != 0) {
+        _xsan_chain_head_failed(p_ctx, xsan_error_from_errno(-comm_status));
+        return;
+    }
+    // The chain ack arrives later as a REPLICA_CHAIN_WRITE_RESP from the head.
+    _xsan_rep_op_ctx_release(p_ctx);
+}
+
+/**
+ * Applies a chain ack: statuses[k] reports on chain_hops[chain_first_hop + k].
+ * Hops the ack does not cover (the chain broke below the last reporter) count as failed.
+ * Acks from anyone but the current head, such as a head the chain was reformed around, are dropped.
+ */
+static void _xsan_chain_process_ack(xsan_replicated_io_ctx_t *rep_ctx, const xsan_replica_chain_write_resp_payload_t *resp) {
+    uint32_t head = rep_ctx->chain_first_hop;
+    if (head >= rep_ctx->chain_num_hops) {
+        XSAN_LOG_WARN("TID %lu: ignoring stale chain ack, no hops outstanding.", rep_ctx->transaction_id);
+        return;
+    }
+    uint32_t expected = rep_ctx->chain_num_hops - head;
+    xsan_error_t statuses[XSAN_REPLICA_CHAIN_MAX_HOPS];
+    if (xsan_replica_chain_ack_statuses(resp, &rep_ctx->chain_hops[head].node_id, expected, statuses) != XSAN_OK) {
+        XSAN_LOG_WARN("TID %lu: dropping chain ack from node %s; the chain head is %s:%u.", rep_ctx->transaction_id,
+                      spdk_uuid_get_string((struct spdk_uuid*)&resp->responder_node_id.data[0]),
+                      rep_ctx->chain_hops[head].node_ip_addr, rep_ctx->chain_hops[head].node_comm_port);
+        return;
+    }
+    for (uint32_t k = 0; k < expected; ++k) {
+        _xsan_chain_record_hop_status(rep_ctx, head + k, statuses[k]);
+    }
+    rep_ctx->chain_first_hop = rep_ctx->chain_num_hops;
+    _xsan_check_replicated_write_completion(rep_ctx);
+}
+
+xsan_error_t xsan_volume_set_replication_mode(xsan_volume_manager_t *vm, xsan_volume_id_t volume_id, xsan_replication_mode_t mode) {
+    if (!vm || !vm->initialized || (mode != XSAN_REPLICATION_MODE_FANOUT && mode != XSAN_REPLICATION_MODE_CHAIN)) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    xsan_volume_t *vol = xsan_volume_get_by_id(vm, volume_id);
+    if (!vol) return XSAN_ERROR_NOT_FOUND;
+    pthread_mutex_lock(&vm->lock);
+    xsan_replication_mode_t old_mode = vol->replication_mode;
+    vol->replication_mode = mode;
+    pthread_mutex_unlock(&vm->lock);
+    if (old_mode == mode) return XSAN_OK;
+    XSAN_LOG_INFO("Volume '%s' replication mode changed from %s to %s.", vol->name,
+                  old_mode == XSAN_REPLICATION_MODE_CHAIN ? "chain" : "fan-out",
+                  mode == XSAN_REPLICATION_MODE_CHAIN ? "chain" : "fan-out");
+    return xsan_volume_manager_save_volume_meta(vm, vol);
+}
+
+// --- Replica-side response helpers ---
+
+static void _replica_op_response_send_complete_cb(int status, void *cb_arg) {
+    xsan_replica_response_cb_ctx_t *resp_ctx = cb_arg;
+    if (!resp_ctx) return;
+    if (status != 0) {
+        XSAN_LOG_WARN("Failed to send replica response (TID %lu): %d",
+                      resp_ctx->response_msg ? resp_ctx->response_msg->header.transaction_id : 0, status);
+    }
+    if (resp_ctx->response_msg) xsan_protocol_message_destroy(resp_ctx->response_msg);
+    XSAN_FREE(resp_ctx);
+}
+
+static void _xsan_send_replica_response(struct xsan_connection_ctx *conn_ctx, xsan_message_t *resp_msg) {
+    if (!resp_msg) return;
+    xsan_replica_response_cb_ctx_t *resp_send_ctx = XSAN_MALLOC(sizeof(xsan_replica_response_cb_ctx_t));
+    if (!resp_send_ctx) {
+        xsan_protocol_message_destroy(resp_msg);
+        return;
+    }
+    resp_send_ctx->conn_ctx = conn_ctx;
+    resp_send_ctx->response_msg = resp_msg;
+    if (xsan_node_comm_send_msg(conn_ctx->sock, resp_msg, _replica_op_response_send_complete_cb, resp_send_ctx) != XSAN_OK) {
+        _replica_op_response_send_complete_cb(-EIO, resp_send_ctx);
+    }
+}
+
+static void _xsan_send_replica_write_resp(xsan_volume_manager_t *vm, struct xsan_connection_ctx *conn_ctx, uint64_t tid,
+                                          const xsan_replica_write_req_payload_t *req, xsan_error_t local_status) {
+    xsan_replica_write_resp_payload_t resp_pl;
+    xsan_replica_write_resp_trailer_t trailer;
+    unsigned char resp_buf[sizeof(resp_pl) + sizeof(trailer)];
+    memset(&resp_pl, 0, sizeof(resp_pl));
+    resp_pl.status = local_status;
+    resp_pl.block_lba_on_volume = req->block_lba_on_volume;
+    resp_pl.num_blocks_processed = (local_status == XSAN_OK) ? req->num_blocks : 0;
+    memcpy(&trailer.responder_node_id, &vm->local_node_id, sizeof(xsan_node_id_t));
+    memcpy(resp_buf, &resp_pl, sizeof(resp_pl));
+    memcpy(resp_buf + sizeof(resp_pl), &trailer, sizeof(trailer));
+    _xsan_send_replica_response(conn_ctx, xsan_protocol_message_create(XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_RESP, tid, resp_buf, sizeof(resp_buf)));
+}
+
+// Builds the chain ack for a hop: its own status, then one per downstream hop (NULL = all failed).
+static xsan_message_t *_xsan_chain_ack_create(xsan_volume_manager_t *vm, uint64_t tid, const xsan_replica_write_req_payload_t *req,
+                                              xsan_error_t local_status, const xsan_error_t *downstream_statuses,
+                                              uint32_t num_downstream) {
+    xsan_replica_chain_write_resp_payload_t resp_pl;
+    memset(&resp_pl, 0, sizeof(resp_pl));
+    resp_pl.write.status = local_status;
+    resp_pl.write.block_lba_on_volume = req->block_lba_on_volume;
+    resp_pl.write.num_blocks_processed = (local_status == XSAN_OK) ? req->num_blocks : 0;
+    memcpy(&resp_pl.responder_node_id, &vm->local_node_id, sizeof(xsan_node_id_t));
+    if (num_downstream > XSAN_REPLICA_CHAIN_MAX_HOPS - 1) num_downstream = XSAN_REPLICA_CHAIN_MAX_HOPS - 1;
+    resp_pl.chain_num_statuses = (uint8_t)(1 + num_downstream);
+    resp_pl.chain_statuses[0] = local_status;
+    for (uint32_t i = 0; i < num_downstream; ++i) {
+        resp_pl.chain_statuses[1 + i] = downstream_statuses ? downstream_statuses[i] : XSAN_ERROR_REPLICATION_GENERIC;
+    }
+    return xsan_protocol_message_create(XSAN_MSG_TYPE_REPLICA_CHAIN_WRITE_RESP, tid, &resp_pl, sizeof(resp_pl));
+}
+
+typedef struct {
+    xsan_message_t *msg;
+    char ip[XSAN_REPLICA_CHAIN_ADDR_LEN];
+    uint16_t port;
+} xsan_replica_chain_ack_ctx_t;
+
+static void _xsan_chain_ack_send_complete_cb(int status, void *cb_arg) {
+    xsan_replica_chain_ack_ctx_t *ack = cb_arg;
+    if (status != 0) {
+        XSAN_LOG_WARN("Failed to send chain ack (TID %lu) to %s:%u: %d", ack->msg->header.transaction_id, ack->ip, ack->port, status);
+    }
+    xsan_protocol_message_destroy(ack->msg);
+    XSAN_FREE(ack);
+}
+
+static void _xsan_chain_ack_connect_then_send_cb(struct spdk_sock *sock, int status, void *cb_arg) {
+    xsan_replica_chain_ack_ctx_t *ack = cb_arg;
+    if (status != 0 || !sock) {
+        _xsan_chain_ack_send_complete_cb(status != 0 ? status : -ENOTCONN, ack);
+        return;
+    }
+    if (xsan_node_comm_send_msg(sock, ack->msg, _xsan_chain_ack_send_complete_cb, ack) != XSAN_OK) {
+        _xsan_chain_ack_send_complete_cb(-EIO, ack);
+    }
+}
+
+/**
+ * Sends a chain ack to the upstream hop by address. The connection the request arrived on
+ * may have gone away during the local write or the downstream round trip, and the upstream
+ * routes the ack by TID whichever of its connections it arrives on. Consumes msg.
+ */
+static void _xsan_chain_ack_send(const xsan_replica_chain_hop_t *upstream, xsan_message_t *msg) {
+    if (!msg) return;
+    xsan_replica_chain_ack_ctx_t *ack = XSAN_MALLOC(sizeof(*ack));
+    if (!ack) {
+        XSAN_LOG_ERROR("No memory to send chain ack (TID %lu).", msg->header.transaction_id);
+        xsan_protocol_message_destroy(msg);
+        return;
+    }
+    ack->msg = msg;
+    xsan_strcpy_safe(ack->ip, upstream->node_ip_addr, sizeof(ack->ip));
+    ack->port = upstream->node_comm_port;
+    struct spdk_sock *sock = xsan_node_comm_get_active_connection(ack->ip, ack->port);
+    if (sock) {
+        _xsan_chain_ack_connect_then_send_cb(sock, 0, ack);
+    } else if (xsan_node_comm_connect(ack->ip, ack->port, _xsan_chain_ack_connect_then_send_cb, ack) != XSAN_OK) {
+        _xsan_chain_ack_send_complete_cb(-ENOTCONN, ack);
+    }
+}
+
+static void _handle_replica_local_io_complete_cb(void *cb_arg_from_local_io, xsan_error_t local_io_status) {
+    xsan_replica_op_handler_ctx_t *ctx = cb_arg_from_local_io;
+    if (!ctx) return;
+    if (ctx->is_read_op_on_replica) {
+        xsan_replica_read_resp_payload_t resp_pl;
+        memset(&resp_pl, 0, sizeof(resp_pl));
+        resp_pl.status = local_io_status;
+        memcpy(&resp_pl.volume_id, &ctx->req_payload_data.read_req_payload.volume_id, sizeof(xsan_volume_id_t));
+        resp_pl.block_lba_on_volume = ctx->req_payload_data.read_req_payload.block_lba_on_volume;
+        resp_pl.num_blocks = (local_io_status == XSAN_OK) ? ctx->req_payload_data.read_req_payload.num_blocks : 0;
+        _xsan_send_replica_response(ctx->originating_conn_ctx, xsan_protocol_message_create_with_data(
+            XSAN_MSG_TYPE_REPLICA_READ_BLOCK_RESP, ctx->original_req_header.transaction_id,
+            &resp_pl, sizeof(resp_pl),
+            (local_io_status == XSAN_OK) ? ctx->dma_buffer : NULL,
+            (local_io_status == XSAN_OK) ? (uint32_t)ctx->data_len_bytes : 0));
+        if (ctx->dma_buffer) xsan_bdev_dma_free(ctx->dma_buffer);
+    } else if (ctx->original_req_header.type == XSAN_MSG_TYPE_REPLICA_CHAIN_WRITE_REQ) {
+        // Chain tail: nothing below us to wait for.
+        _xsan_chain_ack_send(&ctx->chain_upstream, _xsan_chain_ack_create(ctx->vm, ctx->original_req_header.transaction_id,
+                                                                          &ctx->req_payload_data.write_req_payload,
+                                                                          local_io_status, NULL, 0));
+    } else {
+        _xsan_send_replica_write_resp(ctx->vm, ctx->originating_conn_ctx, ctx->original_req_header.transaction_id,
+                                      &ctx->req_payload_data.write_req_payload, local_io_status);
+    }
+    if (ctx->req_msg) xsan_protocol_message_destroy(ctx->req_msg);
+    XSAN_FREE(ctx);
+}
+
+// --- Chain replication (mid-chain replica side) ---
+
+static void _xsan_chain_fwd_put(xsan_replica_chain_fwd_ctx_t *fwd) {
+    if (--fwd->refs == 0) XSAN_FREE(fwd);
+}
+
+static void _xsan_chain_fwd_maybe_ack(xsan_replica_chain_fwd_ctx_t *fwd) {
+    if (!fwd->local_done || !fwd->downstream_done || fwd->acked) return;
+    fwd->acked = true;
+    _xsan_chain_ack_send(&fwd->req.upstream, _xsan_chain_ack_create(fwd->vm, fwd->upstream_tid, &fwd->req.write, fwd->local_status,
+                                                                    fwd->downstream_statuses, fwd->req.chain_num_downstream));
+}
+
+/**
+ * Records the result for the hops below us, once: their statuses from an ack, or status for
+ * all of them if the forward failed or timed out. Drops the downstream-result reference.
+ */
+static void _xsan_chain_fwd_downstream_done(xsan_replica_chain_fwd_ctx_t *fwd, const xsan_error_t *statuses, xsan_error_t status) {
+    if (fwd->downstream_done) return;
+    xsan_volume_manager_t *vm = fwd->vm;
+    fwd->downstream_done = true;
+    for (uint32_t i = 0; i < fwd->req.chain_num_downstream; ++i) {
+        fwd->downstream_statuses[i] = statuses ? statuses[i] : status;
+    }
+    // A late ack for this forward now finds nothing and is dropped.
+    xsan_txn_table_remove(vm->pending_chain_forwards, fwd->forward_tid, NULL);
+    if (_xsan_deadline_cancel(vm, fwd->forward_tid, &fwd->deadline)) _xsan_chain_fwd_put(fwd);
+    _xsan_chain_fwd_maybe_ack(fwd);
+    _xsan_chain_fwd_put(fwd);
+}
+
+static void _xsan_chain_fwd_process_ack(xsan_replica_chain_fwd_ctx_t *fwd, const xsan_replica_chain_write_resp_payload_t *resp) {
+    const xsan_replica_chain_hop_t *next = &fwd->req.chain_downstream[0];
+    xsan_error_t statuses[XSAN_REPLICA_CHAIN_MAX_HOPS];
+    if (xsan_replica_chain_ack_statuses(resp, &next->node_id, fwd->req.chain_num_downstream, statuses) != XSAN_OK) {
+        XSAN_LOG_WARN("Chain forward TID %lu: dropping ack from node %s; the next hop is %s:%u.", fwd->forward_tid,
+                      spdk_uuid_get_string((struct spdk_uuid*)&resp->responder_node_id.data[0]),
+                      next->node_ip_addr, next->node_comm_port);
+        return;
+    }
+    _xsan_chain_fwd_downstream_done(fwd, statuses, XSAN_OK);
+}
+
+static void _xsan_chain_fwd_deadline_cb(xsan_timer_t *timer, void *cb_arg) {
+    xsan_replica_chain_fwd_ctx_t *fwd = cb_arg;
+    (void)timer;
+    if (!fwd->downstream_done) {
+        XSAN_LOG_WARN("Chain forward (upstream TID %lu) to %s:%u not acked within %lu us; acking upstream without it.",
+                      fwd->upstream_tid, fwd->req.chain_downstream[0].node_ip_addr, fwd->req.chain_downstream[0].node_comm_port,
+                      fwd->vm->replica_write_timeout_us);
+        __sync_fetch_and_add(&fwd->vm->timeout_stats.chain_forwards_timed_out, 1);
+        _xsan_chain_fwd_downstream_done(fwd, NULL, XSAN_ERROR_TIMEOUT);
+    }
+    _xsan_chain_fwd_put(fwd);
+}
+
+static void _xsan_chain_fwd_local_done_fn(void *arg) {
+    xsan_replica_chain_fwd_ctx_t *fwd = arg;
+    fwd->local_done = true;
+    _xsan_chain_fwd_maybe_ack(fwd);
+    _xsan_chain_fwd_put(fwd);
+}
+
+static void _xsan_chain_fwd_local_io_complete_cb(void *cb_arg, xsan_error_t status) {
+    xsan_replica_chain_fwd_ctx_t *fwd = cb_arg;
+    fwd->local_status = status;
+    // Local bdev completions may land on another reactor; the forward's state lives on its owner.
+    if (xsan_txn_run_on_owner(fwd->forward_tid, _xsan_chain_fwd_local_done_fn, fwd) != XSAN_OK) {
+        XSAN_LOG_WARN("Chain forward TID %lu: could not post local completion to its owner; completing here.", fwd->forward_tid);
+        _xsan_chain_fwd_local_done_fn(fwd);
+    }
+}
+
+// The forwarded request could not be sent: every hop below us failed with status.
+static void _xsan_chain_fwd_send_failed(xsan_replica_chain_fwd_ctx_t *fwd, xsan_error_t status) {
+    XSAN_LOG_WARN("Chain forward (upstream TID %lu) to %s:%u failed: %s", fwd->upstream_tid,
+                  fwd->req.chain_downstream[0].node_ip_addr, fwd->req.chain_downstream[0].node_comm_port, xsan_error_string(status));
+    xsan_protocol_message_destroy(fwd->fwd_msg);
+    fwd->fwd_msg = NULL;
+    _xsan_chain_fwd_downstream_done(fwd, NULL, status);
+    _xsan_chain_fwd_put(fwd);
+}
+
+static void _xsan_chain_fwd_connect_then_send_cb(struct spdk_sock *sock, int status, void *cb_arg) {
+    xsan_replica_chain_fwd_ctx_t *fwd = cb_arg;
+    if (status != 0 || !sock) {
+        _xsan_chain_fwd_send_failed(fwd, status != 0 ? xsan_error_from_errno(-status) : XSAN_ERROR_NODE_UNREACHABLE);
+        return;
+    }
+    xsan_error_t s_err = xsan_node_comm_send_msg(sock, fwd->fwd_msg, _xsan_chain_fwd_send_complete_cb, fwd);
+    if (s_err != XSAN_OK) _xsan_chain_fwd_send_failed(fwd, s_err);
+}
+
+static void _xsan_chain_fwd_send_complete_cb(int comm_status, void *cb_arg) {
+    xsan_replica_chain_fwd_ctx_t *fwd = cb_arg;
+    if (comm_status != 0) {
+        _xsan_chain_fwd_send_failed(fwd, xsan_error_from_errno(-comm_status));
+        return;
+    }
+    xsan_protocol_message_destroy(fwd->fwd_msg);
+    fwd->fwd_msg = NULL;
+    _xsan_chain_fwd_put(fwd);
+}
+
+/**
+ * Mid-chain handling of a validated chain write: writes locally and forwards the same data to
+ * the next hop in parallel. Returns an error only if nothing was started (caller responds).
+ */
+static xsan_error_t _xsan_chain_fwd_start(xsan_volume_manager_t *vm, uint64_t upstream_tid,
+                                          const xsan_replica_chain_write_req_payload_t *req,
+                                          uint64_t logical_byte_offset, const unsigned char *data, uint32_t data_len) {
+    if (req->chain_num_downstream == 0) return XSAN_ERROR_PROTOCOL_GENERIC;
+    xsan_replica_chain_fwd_ctx_t *fwd = XSAN_CALLOC(1, sizeof(*fwd));
+    if (!fwd) return XSAN_ERROR_OUT_OF_MEMORY;
+    fwd->vm = vm;
+    memcpy(&fwd->req, req, sizeof(*req));
+    fwd->upstream_tid = upstream_tid;
+    fwd->forward_tid = xsan_txn_next_tid();
+    xsan_timer_init(&fwd->deadline, _xsan_chain_fwd_deadline_cb, fwd);
+
+    // Forwarded request: same extent, downstream list shifted by one hop, us as the upstream.
+    xsan_replica_chain_write_req_payload_t fwd_pl;
+    xsan_replica_chain_req_shift(req, &vm->local_hop, &fwd_pl);
+    fwd->fwd_msg = xsan_protocol_message_create_with_data(XSAN_MSG_TYPE_REPLICA_CHAIN_WRITE_REQ, fwd->forward_tid,
+                                                          &fwd_pl, sizeof(fwd_pl), data, data_len);
+    if (!fwd->fwd_msg || xsan_txn_table_insert(vm->pending_chain_forwards, &fwd->forward_tid, fwd) != XSAN_OK) {
+        if (fwd->fwd_msg) xsan_protocol_message_destroy(fwd->fwd_msg);
+        XSAN_FREE(fwd);
+        return XSAN_ERROR_OUT_OF_MEMORY;
+    }
+    fwd->refs = 3;
+
+    // Without a deadline a silent downstream hop would hold the upstream ack forever.
+    xsan_timer_wheel_t *wheel = vm->replica_write_timeout_us ? _xsan_deadline_wheel(vm, fwd->forward_tid) : NULL;
+    if (wheel && xsan_timer_wheel_arm(wheel, &fwd->deadline, vm->replica_write_timeout_us) == XSAN_OK) fwd->refs++;
+
+    // Local write first: the data buffer belongs to the received message and is copied on submit.
+    xsan_error_t err = _xsan_volume_submit_single_io_attempt(vm, req->write.volume_id, logical_byte_offset, data_len,
+                                                             (void *)data, false, _xsan_chain_fwd_local_io_complete_cb, fwd);
+    if (err != XSAN_OK) {
+        _xsan_chain_fwd_local_io_complete_cb(fwd, err);
+    }
+
+    const xsan_replica_chain_hop_t *next = &req->chain_downstream[0];
+    struct spdk_sock *sock = xsan_node_comm_get_active_connection(next->node_ip_addr, next->node_comm_port);
+    if (sock) {
+        _xsan_chain_fwd_connect_then_send_cb(sock, 0, fwd);
+    } else if (xsan_node_comm_connect(next->node_ip_addr, next->node_comm_port,
+                                      _xsan_chain_fwd_connect_then_send_cb, fwd) != XSAN_OK) {
+        _xsan_chain_fwd_send_failed(fwd, XSAN_ERROR_NODE_UNREACHABLE);
+    }
+    return XSAN_OK;
+}
+
+static void _xsan_replica_write_resp_route(xsan_volume_manager_t *vm, xsan_message_t *msg);
+
+void xsan_volume_manager_handle_replica_write_resp(struct xsan_connection_ctx *conn_ctx,
+                                                   xsan_message_t *msg,
+                                                   void *cb_arg_vol_mgr) {
+    xsan_volume_manager_t *vm = (xsan_volume_manager_t *)cb_arg_vol_mgr;
+    if (!conn_ctx || !msg || !vm) {
+        if (msg) xsan_protocol_message_destroy(msg);
+        return;
+    }
+    uint32_t min_len = (msg->header.type == XSAN_MSG_TYPE_REPLICA_CHAIN_WRITE_RESP) ? sizeof(xsan_replica_chain_write_resp_payload_t)
+                                                                                   : sizeof(xsan_replica_write_resp_payload_t);
+    if ((msg->header.type != XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_RESP && msg->header.type != XSAN_MSG_TYPE_REPLICA_CHAIN_WRITE_RESP) ||
+        msg->header.payload_length < min_len) {
+        XSAN_LOG_ERROR("Malformed replica write response (type %u, len %u) from %s.",
+                       msg->header.type, msg->header.payload_length, conn_ctx->peer_addr_str);
+        xsan_protocol_message_destroy(msg);
+        return;
+    }
+    _xsan_replica_write_resp_route(vm, msg);
+}
+
+typedef struct {
+    xsan_volume_manager_t *vm;
+    xsan_message_t *msg;
+} xsan_replica_write_resp_route_t;
+
+static void _xsan_replica_write_resp_route_fn(void *arg) {
+    xsan_replica_write_resp_route_t *r = arg;
+    _xsan_replica_write_resp_route(r->vm, r->msg);
+    XSAN_FREE(r);
+}
+
+// Hands a validated write response to the thread owning its TID, which holds both the
+// chain-forward and the replicated-write tables for it. Consumes msg.
+static void _xsan_replica_write_resp_route(xsan_volume_manager_t *vm, xsan_message_t *msg) {
+    uint64_t tid = msg->header.transaction_id;
+
+    if (!xsan_txn_is_owner(tid)) {
+        xsan_replica_write_resp_route_t *r = XSAN_MALLOC(sizeof(*r));
+        if (r) {
+            r->vm = vm;
+            r->msg = msg;
+            if (xsan_txn_run_on_owner(tid, _xsan_replica_write_resp_route_fn, r) == XSAN_OK) return;
+            XSAN_FREE(r);
+        }
+        XSAN_LOG_WARN("TID %lu: could not route replica write response to its owner; dropped.", tid);
+        xsan_protocol_message_destroy(msg);
+        return;
+    }
+
+    if (msg->header.type == XSAN_MSG_TYPE_REPLICA_CHAIN_WRITE_RESP) {
+        const xsan_replica_chain_write_resp_payload_t *ack = (const xsan_replica_chain_write_resp_payload_t *)msg->payload;
+        xsan_replica_chain_fwd_ctx_t *fwd = xsan_txn_table_lookup(vm->pending_chain_forwards, tid);
+        xsan_replicated_io_ctx_t *rep_ctx = fwd ? NULL : xsan_txn_table_lookup(vm->pending_replicated_ios, tid);
+        if (fwd) {
+            // Ack from our downstream hop; its statuses (its own and beyond) go up the chain.
+            _xsan_chain_fwd_process_ack(fwd, ack);
+        } else if (rep_ctx && rep_ctx->replication_mode == XSAN_REPLICATION_MODE_CHAIN) {
+            _xsan_chain_process_ack(rep_ctx, ack);
+        } else {
+            XSAN_LOG_WARN("TID %lu: no pending chain write or forward for chain ack; dropped.", tid);
+        }
+    } else {
+        const xsan_replica_write_resp_payload_t *resp = (const xsan_replica_write_resp_payload_t *)msg->payload;
+        xsan_node_id_t responder;
+        memset(&responder, 0, sizeof(responder));
+        if (msg->header.payload_length >= sizeof(*resp) + sizeof(xsan_replica_write_resp_trailer_t)) {
+            memcpy(&responder, msg->payload + sizeof(*resp), sizeof(responder));
+        }
+        xsan_replicated_io_ctx_t *rep_ctx = xsan_txn_table_lookup(vm->pending_replicated_ios, tid);
+        if (rep_ctx && rep_ctx->replication_mode == XSAN_REPLICATION_MODE_CHAIN) {
+            // Chain writes are only acked with chain acks, which say which hop answered.
+            XSAN_LOG_WARN("TID %lu: fan-out response for a chain write; dropped.", tid);
+        } else {
+            xsan_volume_manager_process_replica_write_response(vm, tid, responder, resp->status);
+        }
+    }
+    xsan_protocol_message_destroy(msg);
+}
+
+// --- Batched replica writes ---
+
+static void _xsan_replica_batch_finish(xsan_replica_batch_apply_ctx_t *batch) {
+    uint32_t resp_len = sizeof(xsan_replica_write_batch_resp_payload_t) +
+                        sizeof(xsan_replica_write_extent_status_t) * batch->num_extents;
+    unsigned char resp_buf[sizeof(xsan_replica_write_batch_resp_payload_t) +
+                           sizeof(xsan_replica_write_extent_status_t) * XSAN_REPLICA_WRITE_BATCH_MAX_EXTENTS];
+    xsan_replica_write_batch_resp_payload_t resp_hdr;
+    memset(&resp_hdr, 0, sizeof(resp_hdr));
+    memcpy(&resp_hdr.responder_node_id, &batch->vm->local_node_id, sizeof(xsan_node_id_t));
+    resp_hdr.num_extents = batch->num_extents;
+    memcpy(resp_buf, &resp_hdr, sizeof(resp_hdr));
+    memcpy(resp_buf + sizeof(resp_hdr), batch->statuses, sizeof(xsan_replica_write_extent_status_t) * batch->num_extents);
+    _xsan_send_replica_response(batch->conn_ctx, xsan_protocol_message_create(XSAN_MSG_TYPE_REPLICA_WRITE_BATCH_RESP,
+                                                                              batch->batch_tid, resp_buf, resp_len));
+    xsan_protocol_message_destroy(batch->req_msg);
+    XSAN_FREE(batch);
+}
+
+static void _xsan_replica_batch_extent_complete_cb(void *cb_arg, xsan_error_t status) {
+    xsan_replica_batch_extent_ctx_t *part = cb_arg;
+    xsan_replica_batch_apply_ctx_t *batch = part->batch;
+    batch->statuses[part->idx].status = status;
+    if (__sync_sub_and_fetch(&batch->pending, 1) == 0) {
+        _xsan_replica_batch_finish(batch);
+    }
+}
+
+void xsan_volume_manager_handle_replica_write_batch_req(struct xsan_connection_ctx *conn_ctx,
+                                                        xsan_message_t *msg,
+                                                        void *cb_arg_vol_mgr) {
+    xsan_volume_manager_t *vm = (xsan_volume_manager_t *)cb_arg_vol_mgr;
+    if (!conn_ctx || !msg || !vm) {
+        if (msg) xsan_protocol_message_destroy(msg);
+        XSAN_LOG_ERROR("Invalid params to handle_replica_write_batch_req.");
+        return;
+    }
+
+    const xsan_replica_write_batch_req_payload_t *req_hdr = (const xsan_replica_write_batch_req_payload_t *)msg->payload;
+    uint32_t num_extents = (msg->header.payload_length >= sizeof(*req_hdr)) ? req_hdr->num_extents : 0;
+    uint64_t desc_len = sizeof(*req_hdr) + (uint64_t)sizeof(xsan_replica_write_extent_t) * num_extents;
+    if (msg->header.type != XSAN_MSG_TYPE_REPLICA_WRITE_BATCH_REQ || num_extents == 0 ||
+        num_extents > XSAN_REPLICA_WRITE_BATCH_MAX_EXTENTS || msg->header.payload_length < desc_len) {
+        // Without a trustworthy extent table there are no per-write TIDs to answer; the primary times out.
+        XSAN_LOG_ERROR("Malformed replica write batch (type %u, len %u, extents %u) from %s, TID %lu.",
+                       msg->header.type, msg->header.payload_length, num_extents, conn_ctx->peer_addr_str,
+                       msg->header.transaction_id);
+        xsan_protocol_message_destroy(msg);
+        return;
+    }
+
+    xsan_replica_batch_apply_ctx_t *batch = XSAN_MALLOC(sizeof(*batch));
+    if (!batch) {
+        XSAN_LOG_ERROR("OOM for replica write batch context, TID %lu from %s.", msg->header.transaction_id, conn_ctx->peer_addr_str);
+        xsan_protocol_message_destroy(msg);
+        return;
+    }
+    memset(batch, 0, sizeof(*batch));
+    batch->vm = vm;
+    batch->conn_ctx = conn_ctx;
+    batch->req_msg = msg;
+    batch->batch_tid = msg->header.transaction_id;
+    batch->num_extents = num_extents;
+    // One extra reference keeps the batch alive until every extent has been submitted.
+    batch->pending = num_extents + 1;
+
+    const xsan_replica_write_extent_t *extents = (const xsan_replica_write_extent_t *)(msg->payload + sizeof(*req_hdr));
+    unsigned char *data = msg->payload + desc_len;
+    uint64_t data_left = msg->header.payload_length - desc_len;
+
+    for (uint32_t i = 0; i < num_extents; ++i) {
+        const xsan_replica_write_extent_t *ext = &extents[i];
+        xsan_error_t err = XSAN_OK;
+        batch->statuses[i].transaction_id = ext->transaction_id;
+        batch->parts[i].batch = batch;
+        batch->parts[i].idx = i;
+
+        if (ext->data_len > data_left) {
+            // Every following extent's data is out of bounds as well.
+            err = XSAN_ERROR_INVALID_PARAM;
+        } else {
+            xsan_volume_t *vol = xsan_volume_get_by_id(vm, ext->volume_id);
+            if (!vol) {
+                err = XSAN_ERROR_NOT_FOUND;
+            } else if (vol->block_size_bytes == 0 || ext->num_blocks == 0 ||
+                       (uint64_t)ext->num_blocks * vol->block_size_bytes != ext->data_len) {
+                err = XSAN_ERROR_INVALID_PARAM;
+            } else {
+                err = _xsan_volume_submit_single_io_attempt(vm, ext->volume_id,
+                                                            ext->block_lba_on_volume * vol->block_size_bytes,
+                                                            ext->data_len, data, false,
+                                                            _xsan_replica_batch_extent_complete_cb, &batch->parts[i]);
+            }
+            data += ext->data_len;
+            data_left -= ext->data_len;
+        }
+        if (err != XSAN_OK) {
+            XSAN_LOG_ERROR("Batched replica write TID %lu (batch TID %lu from %s) failed: %s",
+                           ext->transaction_id, batch->batch_tid, conn_ctx->peer_addr_str, xsan_error_string(err));
+            _xsan_replica_batch_extent_complete_cb(&batch->parts[i], err);
+        }
+    }
+    if (__sync_sub_and_fetch(&batch->pending, 1) == 0) {
+        _xsan_replica_batch_finish(batch);
+    }
+}
+
+void xsan_volume_manager_handle_replica_write_batch_resp(struct xsan_connection_ctx *conn_ctx,
+                                                         xsan_message_t *msg,
+                                                         void *cb_arg_vol_mgr) {
+    xsan_volume_manager_t *vm = (xsan_volume_manager_t *)cb_arg_vol_mgr;
+    if (!conn_ctx || !msg || !vm) {
+        if (msg) xsan_protocol_message_destroy(msg);
+        return;
+    }
+    const xsan_replica_write_batch_resp_payload_t *resp = (const xsan_replica_write_batch_resp_payload_t *)msg->payload;
+    if (msg->header.type != XSAN_MSG_TYPE_REPLICA_WRITE_BATCH_RESP || msg->header.payload_length < sizeof(*resp) ||
+        resp->num_extents > XSAN_REPLICA_WRITE_BATCH_MAX_EXTENTS ||
+        msg->header.payload_length < sizeof(*resp) + sizeof(xsan_replica_write_extent_status_t) * resp->num_extents) {
+        XSAN_LOG_ERROR("Malformed replica write batch response (type %u, len %u) from %s.",
+                       msg->header.type, msg->header.payload_length, conn_ctx->peer_addr_str);
+        xsan_protocol_message_destroy(msg);
+        return;
+    }
+    const xsan_replica_write_extent_status_t *statuses =
+        (const xsan_replica_write_extent_status_t *)(msg->payload + sizeof(*resp));
+    for (uint32_t i = 0; i < resp->num_extents; ++i) {
+        xsan_volume_manager_process_replica_write_response(vm, statuses[i].transaction_id, resp->responder_node_id, statuses[i].status);
+    }
+    xsan_protocol_message_destroy(msg);
+}
+
+static void _xsan_read_coord_get(xsan_replica_read_coordinator_ctx_t *coord) {
+    __sync_fetch_and_add(&coord->refs, 1);
+}
+
+static void _xsan_read_coord_put(void *arg) {
+    xsan_replica_read_coordinator_ctx_t *coord = arg;
+    if (__sync_sub_and_fetch(&coord->refs, 1) == 0) xsan_replica_read_coordinator_ctx_free(coord);
+}
+
+// Reports the read to the user and drops the table's reference. Runs on the coordinator's owner.
+static void _xsan_replica_read_finish(xsan_replica_read_coordinator_ctx_t *coord, xsan_error_t status) {
+    xsan_volume_manager_t *vm = g_xsan_volume_manager_instance;
+    if (vm && _xsan_deadline_cancel(vm, coord->transaction_id, &coord->deadline)) _xsan_read_coord_put(coord);
+    if (coord->original_user_cb) coord->original_user_cb(coord->original_user_cb_arg, status);
+    if (!vm || xsan_txn_table_remove(vm->pending_replica_reads, coord->transaction_id, _xsan_read_coord_put) == XSAN_ERROR_NOT_FOUND) {
+        _xsan_read_coord_put(coord);
+    }
+}
+
+static void _xsan_replica_read_deadline_cb(xsan_timer_t *timer, void *cb_arg) {
+    (void)timer;
+    xsan_replica_read_coordinator_ctx_t *coord = cb_arg;
+    xsan_volume_manager_t *vm = g_xsan_volume_manager_instance;
+    // Attempt completion disarms the deadline, so firing means the current remote attempt is still open.
+    if (vm && coord->vol) {
+        xsan_replica_location_t loc;
+        bool have_loc = false;
+        pthread_mutex_lock(&vm->lock);
+        if (coord->current_replica_idx_to_try < (int)coord->vol->actual_replica_count) {
+            memcpy(&loc, &coord->vol->replica_nodes[coord->current_replica_idx_to_try], sizeof(loc));
+            have_loc = true;
+        }
+        pthread_mutex_unlock(&vm->lock);
+        XSAN_LOG_WARN("TID %lu: replica read from %s:%u did not answer within %lu us; trying the next replica.",
+                      coord->transaction_id, have_loc ? loc.node_ip_addr : "?", have_loc ? loc.node_comm_port : 0,
+                      vm->replica_read_timeout_us);
+        __sync_fetch_and_add(&vm->timeout_stats.read_attempts_timed_out, 1);
+        if (have_loc) _xsan_volume_set_replica_state(vm, coord->vol->id, &loc.node_id, XSAN_STORAGE_STATE_DEGRADED);
+        // A send still in flight keeps its op context; its callback sees it is no longer current and only frees it.
+        _xsan_replica_read_attempt_complete_cb(coord, XSAN_ERROR_TIMEOUT);
+    }
+    _xsan_read_coord_put(coord);
+}
+
+// Gives the current remote read attempt a deadline. Runs on the coordinator's owner.
+static void _xsan_replica_read_arm_deadline(xsan_volume_manager_t *vm, xsan_replica_read_coordinator_ctx_t *coord) {
+    if (vm->replica_read_timeout_us == 0) return;
+    xsan_timer_wheel_t *wheel = _xsan_deadline_wheel(vm, coord->transaction_id);
+    if (!wheel) return;
+    if (!xsan_timer_is_armed(&coord->deadline)) {
+        xsan_timer_init(&coord->deadline, _xsan_replica_read_deadline_cb, coord);
+        _xsan_read_coord_get(coord);
+    }
+    if (xsan_timer_wheel_arm(wheel, &coord->deadline, vm->replica_read_timeout_us) != XSAN_OK) _xsan_read_coord_put(coord);
+}
+
+xsan_error_t xsan_volume_read_async(xsan_volume_manager_t *vm, xsan_volume_id_t vol_id, uint64_t log_byte_off, uint64_t len_bytes, void *u_buf, xsan_user_io_completion_cb_t u_cb, void *u_cb_arg) {
+    if (!vm || !vm->initialized || !u_buf || len_bytes==0 || !u_cb) return XSAN_ERROR_INVALID_PARAM;
+    xsan_volume_t *vol = xsan_volume_get_by_id(vm, vol_id); if(!vol) return XSAN_ERROR_NOT_FOUND;
+    if (vol->block_size_bytes==0 || (log_byte_off % vol->block_size_bytes !=0) || (len_bytes % vol->block_size_bytes !=0) || (log_byte_off+len_bytes > vol->size_bytes)) return XSAN_ERROR_INVALID_PARAM_ALIGNMENT;
+    uint64_t tid = xsan_txn_next_tid();
+    xsan_replica_read_coordinator_ctx_t *coord = xsan_replica_read_coordinator_ctx_create(vol,u_buf,log_byte_off,len_bytes,u_cb,u_cb_arg,tid);
     if(!coord) return XSAN_ERROR_OUT_OF_MEMORY;
+    // Registered once for the whole read; every attempt (local or remote) completes on this thread.
+    if(xsan_txn_table_insert(vm->pending_replica_reads, &coord->transaction_id, coord)!=XSAN_OK){ xsan_replica_read_coordinator_ctx_free(coord); return XSAN_ERROR_OUT_OF_MEMORY;}
     _xsan_try_read_from_next_replica(coord); return XSAN_OK;
 }
 
 static void _xsan_try_read_from_next_replica(xsan_replica_read_coordinator_ctx_t *coord_ctx) {
-    if(!coord_ctx || !coord_ctx->vol){ if(coord_ctx){if(coord_ctx->original_user_cb)coord_ctx->original_user_cb(coord_ctx->original_user_cb_arg, XSAN_ERROR_INVALID_PARAM); xsan_replica_read_coordinator_ctx_free(coord_ctx);} return;}
+    if(!coord_ctx) return;
+    if(!coord_ctx->vol){ _xsan_replica_read_finish(coord_ctx, XSAN_ERROR_INVALID_PARAM); return;}
     if(coord_ctx->current_replica_idx_to_try >= (int)coord_ctx->vol->actual_replica_count || coord_ctx->current_replica_idx_to_try >= XSAN_MAX_REPLICAS) {
-        if(coord_ctx->original_user_cb)coord_ctx->original_user_cb(coord_ctx->original_user_cb_arg, coord_ctx->last_attempt_status);
-        pthread_mutex_lock(&g_xsan_volume_manager_instance->pending_ios_lock); xsan_hashtable_remove(g_xsan_volume_manager_instance->pending_replica_reads, &coord_ctx->transaction_id); pthread_mutex_unlock(&g_xsan_volume_manager_instance->pending_ios_lock);
-        xsan_replica_read_coordinator_ctx_free(coord_ctx); return;
+        _xsan_replica_read_finish(coord_ctx, coord_ctx->last_attempt_status); return;
     }
     int cur_idx = coord_ctx->current_replica_idx_to_try;
     xsan_replica_location_t *loc = NULL;
@@ -1071,6 +2467,7 @@ static void _xsan_try_read_from_next_replica(xsan_replica_read_coordinator_ctx_t
         if(!rop_ctx){ coord_ctx->last_attempt_status=XSAN_ERROR_OUT_OF_MEMORY; coord_ctx->current_replica_idx_to_try++; _xsan_try_read_from_next_replica(coord_ctx); return;}
         memset(rop_ctx,0,sizeof(*rop_ctx));
         rop_ctx->parent_rep_ctx=(void*)coord_ctx;
+        rop_ctx->attempt_seq=++coord_ctx->attempt_seq;
         memcpy(&rop_ctx->replica_location_info,loc,sizeof(xsan_replica_location_t));
         xsan_replica_read_req_payload_t req_pl;
         memcpy(&req_pl.volume_id,&coord_ctx->vol->id,sizeof(req_pl.volume_id));
@@ -1085,65 +2482,133 @@ static void _xsan_try_read_from_next_replica(xsan_replica_read_coordinator_ctx_t
             return;
         }
         coord_ctx->current_remote_op_ctx = rop_ctx;
-        pthread_mutex_lock(&g_xsan_volume_manager_instance->pending_ios_lock);
-        xsan_hashtable_put(g_xsan_volume_manager_instance->pending_replica_reads, &coord_ctx->transaction_id, coord_ctx);
-        pthread_mutex_unlock(&g_xsan_volume_manager_instance->pending_ios_lock);
+        _xsan_read_coord_get(coord_ctx); // Held by rop_ctx until its callbacks are done with it
+        _xsan_replica_read_arm_deadline(g_xsan_volume_manager_instance, coord_ctx);
         struct spdk_sock *sock = xsan_node_comm_get_active_connection(loc->node_ip_addr,loc->node_comm_port);
         if(sock) _xsan_remote_replica_read_connect_then_send_cb(sock,0,rop_ctx);
-        else xsan_node_comm_connect(loc->node_ip_addr,loc->node_comm_port,_xsan_remote_replica_read_connect_then_send_cb,rop_ctx);
+        else if(xsan_node_comm_connect(loc->node_ip_addr,loc->node_comm_port,_xsan_remote_replica_read_connect_then_send_cb,rop_ctx)!=XSAN_OK)
+            _xsan_remote_replica_read_connect_then_send_cb(NULL,-ENOTCONN,rop_ctx);
     }
 }
 
+typedef struct {
+    xsan_replica_read_coordinator_ctx_t *ctx;
+    xsan_error_t status;
+} xsan_replica_read_attempt_msg_t;
+
+static void _xsan_replica_read_attempt_on_owner(void *arg) {
+    xsan_replica_read_attempt_msg_t *m = arg;
+    _xsan_replica_read_attempt_complete_cb(m->ctx, m->status);
+    XSAN_FREE(m);
+}
+
 static void _xsan_replica_read_attempt_complete_cb(void *cb_arg, xsan_error_t status) {
     xsan_replica_read_coordinator_ctx_t*ctx=cb_arg; if(!ctx)return;
+    if(!xsan_txn_is_owner(ctx->transaction_id)){
+        // Local bdev completions may arrive on another reactor; the coordinator lives on its TID's owner.
+        xsan_replica_read_attempt_msg_t *m = XSAN_MALLOC(sizeof(*m));
+        if(m){ m->ctx=ctx; m->status=status; if(xsan_txn_run_on_owner(ctx->transaction_id,_xsan_replica_read_attempt_on_owner,m)==XSAN_OK) return; XSAN_FREE(m);}
+        XSAN_LOG_WARN("TID %lu: could not route read completion to its owner; completing here.", ctx->transaction_id);
+    }
     XSAN_LOG_DEBUG("Replica read attempt for vol %s, TID %lu, replica_idx %d completed with status %d",
                    spdk_uuid_get_string((struct spdk_uuid*)&ctx->vol->id.data[0]), ctx->transaction_id, ctx->current_replica_idx_to_try, status);
+    if(g_xsan_volume_manager_instance && _xsan_deadline_cancel(g_xsan_volume_manager_instance, ctx->transaction_id, &ctx->deadline)) _xsan_read_coord_put(ctx);
+    // The remote op context, if any, is freed by its own send callbacks.
+    ctx->current_remote_op_ctx=NULL;
     if(status==XSAN_OK){
         bool was_remote_attempt = (ctx->current_replica_idx_to_try > 0);
         if (was_remote_attempt && ctx->internal_dma_buffer_allocated && ctx->internal_dma_buffer && ctx->user_buffer) {
              memcpy(ctx->user_buffer, ctx->internal_dma_buffer, ctx->length_bytes);
         }
-        ctx->original_user_cb(ctx->original_user_cb_arg,XSAN_OK);
-        pthread_mutex_lock(&g_xsan_volume_manager_instance->pending_ios_lock);xsan_hashtable_remove(g_xsan_volume_manager_instance->pending_replica_reads,&ctx->transaction_id);pthread_mutex_unlock(&g_xsan_volume_manager_instance->pending_ios_lock);
-        xsan_replica_read_coordinator_ctx_free(ctx);
+        _xsan_replica_read_finish(ctx,XSAN_OK);
     } else {
         ctx->last_attempt_status=status;
         ctx->current_replica_idx_to_try++;
-        if(ctx->current_remote_op_ctx){
-            if(ctx->current_remote_op_ctx->request_msg_to_send)xsan_protocol_message_destroy(ctx->current_remote_op_ctx->request_msg_to_send);
-            XSAN_FREE(ctx->current_remote_op_ctx);
-            ctx->current_remote_op_ctx=NULL;
-        }
         _xsan_try_read_from_next_replica(ctx);
     }
 }
 
-static void _xsan_remote_replica_read_req_send_complete_cb(int comm_status, void *cb_arg) {
-    xsan_per_replica_op_ctx_t*p_ctx=cb_arg;if(!p_ctx||!p_ctx->parent_rep_ctx){if(p_ctx)XSAN_FREE(p_ctx);return;}
-    xsan_replica_read_coordinator_ctx_t*coord_ctx=(xsan_replica_read_coordinator_ctx_t*)p_ctx->parent_rep_ctx;
-    if(comm_status!=0){
-        _xsan_replica_read_attempt_complete_cb(coord_ctx,xsan_error_from_errno(-comm_status));
+typedef struct {
+    xsan_per_replica_op_ctx_t *p_ctx;
+    xsan_error_t status;
+} xsan_replica_read_op_done_msg_t;
+
+static void _xsan_remote_replica_read_op_done(xsan_per_replica_op_ctx_t *p_ctx, xsan_error_t status);
+
+static void _xsan_remote_replica_read_op_done_on_owner(void *arg) {
+    xsan_replica_read_op_done_msg_t *m = arg;
+    _xsan_remote_replica_read_op_done(m->p_ctx, m->status);
+    XSAN_FREE(m);
+}
+
+// Called once the op's connect/send has finished. A failure fails the attempt, unless the
+// attempt has already been abandoned (timed out) and the coordinator moved on.
+static void _xsan_remote_replica_read_op_done(xsan_per_replica_op_ctx_t *p_ctx, xsan_error_t status) {
+    xsan_replica_read_coordinator_ctx_t *coord = p_ctx->parent_rep_ctx;
+    if (!xsan_txn_is_owner(coord->transaction_id)) {
+        xsan_replica_read_op_done_msg_t *m = XSAN_MALLOC(sizeof(*m));
+        if (m) {
+            m->p_ctx = p_ctx; m->status = status;
+            if (xsan_txn_run_on_owner(coord->transaction_id, _xsan_remote_replica_read_op_done_on_owner, m) == XSAN_OK) return;
+            XSAN_FREE(m);
+        }
+        XSAN_LOG_WARN("TID %lu: could not route read op completion to its owner; completing here.", coord->transaction_id);
     }
-    if(p_ctx->request_msg_to_send)xsan_protocol_message_destroy(p_ctx->request_msg_to_send);
+    bool current = (coord->current_remote_op_ctx == p_ctx && p_ctx->attempt_seq == coord->attempt_seq);
+    if (current) coord->current_remote_op_ctx = NULL;
+    if (current && status != XSAN_OK) _xsan_replica_read_attempt_complete_cb(coord, status);
+    if (p_ctx->request_msg_to_send) xsan_protocol_message_destroy(p_ctx->request_msg_to_send);
     XSAN_FREE(p_ctx);
-    coord_ctx->current_remote_op_ctx=NULL;
+    _xsan_read_coord_put(coord);
+}
+
+static void _xsan_remote_replica_read_req_send_complete_cb(int comm_status, void *cb_arg) {
+    xsan_per_replica_op_ctx_t*p_ctx=cb_arg;if(!p_ctx||!p_ctx->parent_rep_ctx){if(p_ctx)XSAN_FREE(p_ctx);return;}
+    _xsan_remote_replica_read_op_done(p_ctx, comm_status ? xsan_error_from_errno(-comm_status) : XSAN_OK);
 }
 
 static void _xsan_remote_replica_read_connect_then_send_cb(struct spdk_sock *sock, int status, void *cb_arg) {
     xsan_per_replica_op_ctx_t*p_ctx=cb_arg;if(!p_ctx||!p_ctx->parent_rep_ctx||!p_ctx->request_msg_to_send){if(p_ctx&&p_ctx->request_msg_to_send)xsan_protocol_message_destroy(p_ctx->request_msg_to_send);if(p_ctx)XSAN_FREE(p_ctx);return;}
-    xsan_replica_read_coordinator_ctx_t*coord_ctx=(xsan_replica_read_coordinator_ctx_t*)p_ctx->parent_rep_ctx;
     if(status==0&&sock){
         p_ctx->connected_sock=sock;
         xsan_error_t s_err=xsan_node_comm_send_msg(sock,p_ctx->request_msg_to_send,_xsan_remote_replica_read_req_send_complete_cb,p_ctx);
-        if(s_err!=XSAN_OK) _xsan_remote_replica_read_req_send_complete_cb(s_err,p_ctx);
+        if(s_err!=XSAN_OK) _xsan_remote_replica_read_op_done(p_ctx,s_err);
     } else {
-        _xsan_replica_read_attempt_complete_cb(coord_ctx,xsan_error_from_errno(-status));
+        _xsan_remote_replica_read_op_done(p_ctx,xsan_error_from_errno(-status));
     }
 }
 
+typedef struct {
+    xsan_volume_manager_t *vm;
+    uint64_t tid;
+    xsan_node_id_t r_nid;
+    xsan_error_t status;
+    uint32_t data_len;
+    unsigned char data[];   // Copied: the caller's message is gone by the time this runs
+} xsan_replica_read_resp_msg_t;
+
+static void _xsan_replica_read_resp_on_owner(void *arg) {
+    xsan_replica_read_resp_msg_t *m = arg;
+    xsan_volume_manager_process_replica_read_response(m->vm, m->tid, m->r_nid, m->status,
+                                                      m->data_len ? m->data : NULL, m->data_len);
+    XSAN_FREE(m);
+}
+
 void xsan_volume_manager_process_replica_read_response(xsan_volume_manager_t *vm, uint64_t tid, xsan_node_id_t r_nid, xsan_error_t r_op_status, const unsigned char *data, uint32_t data_len) {
     if(!vm||!vm->initialized)return;
-    pthread_mutex_lock(&vm->pending_ios_lock); xsan_replica_read_coordinator_ctx_t*ctx=xsan_hashtable_get(vm->pending_replica_reads,&tid); pthread_mutex_unlock(&vm->pending_ios_lock);
+    if(!xsan_txn_is_owner(tid)){
+        uint32_t copy_len = data ? data_len : 0;
+        xsan_replica_read_resp_msg_t *m = XSAN_MALLOC(sizeof(*m) + copy_len);
+        if(!m){ XSAN_LOG_ERROR("TID %lu: no memory to route read response to its owner.", tid); return;}
+        m->vm=vm; m->tid=tid; m->r_nid=r_nid; m->status=r_op_status; m->data_len=copy_len;
+        if(copy_len) memcpy(m->data, data, copy_len);
+        if(xsan_txn_run_on_owner(tid,_xsan_replica_read_resp_on_owner,m)!=XSAN_OK){
+            XSAN_LOG_WARN("TID %lu: read response does not belong to any live shard; dropped.", tid);
+            XSAN_FREE(m);
+        }
+        return;
+    }
+    xsan_replica_read_coordinator_ctx_t*ctx=xsan_txn_table_lookup(vm->pending_replica_reads,tid);
     if(ctx){
         if(r_op_status==XSAN_OK){
             if(data && data_len == ctx->length_bytes){
@@ -1223,8 +2688,7 @@ xsan_error_t xsan_volume_write_async(xsan_volume_manager_t *vm,
         return XSAN_ERROR_REPLICATION_UNAVAILABLE;
     }
 
-    static uint64_t s_wtid_ctr = 1000;
-    uint64_t transaction_id = __sync_fetch_and_add(&s_wtid_ctr, 1);
+    uint64_t transaction_id = xsan_txn_next_tid();
 
     xsan_replicated_io_ctx_t *rep_ctx = xsan_replicated_io_ctx_create(
         user_cb, user_cb_arg, vol, user_buf, logical_byte_offset, length_bytes, transaction_id);
@@ -1233,14 +2697,98 @@ xsan_error_t xsan_volume_write_async(xsan_volume_manager_t *vm,
         return XSAN_ERROR_OUT_OF_MEMORY;
     }
 
-    pthread_mutex_lock(&vm->pending_ios_lock);
-    if (xsan_hashtable_put(vm->pending_replicated_ios, &rep_ctx->transaction_id, rep_ctx) != XSAN_OK) {
-        pthread_mutex_unlock(&vm->pending_ios_lock);
-        XSAN_LOG_ERROR("Failed to add TID %lu to pending replicated IOs hashtable.", transaction_id);
+    // The TID was just issued on this thread, so this thread owns its entry.
+    if (xsan_txn_table_insert(vm->pending_replicated_ios, &rep_ctx->transaction_id, rep_ctx) != XSAN_OK) {
+        XSAN_LOG_ERROR("Failed to add TID %lu to pending replicated IOs table.", transaction_id);
         xsan_replicated_io_ctx_free(rep_ctx);
         return XSAN_ERROR_OUT_OF_MEMORY;
     }
-    pthread_mutex_unlock(&vm->pending_ios_lock);
+
+    // Overlapping writes to the same volume are serialised on the per-volume range-lock table;
+    // non-overlapping writes proceed in parallel without touching any global lock. The table
+    // lives as long as the volume, so it is read without vm->lock.
+    rep_ctx->range_lock_table = vol->write_range_locks;
+
+    if (rep_ctx->range_lock_table) {
+        bool granted_now = false;
+        xsan_error_t lock_err = xsan_range_lock_acquire(rep_ctx->range_lock_table, &rep_ctx->range_lock,
+                                                        logical_byte_offset / vol_block_size,
+                                                        length_bytes / vol_block_size,
+                                                        _xsan_replicated_write_range_granted_cb, rep_ctx,
+                                                        &granted_now);
+        if (lock_err != XSAN_OK) {
+            XSAN_LOG_ERROR("Failed to acquire write range lock for vol %s, TID %lu: %s",
+                           spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]), transaction_id, xsan_error_string(lock_err));
+            rep_ctx->range_lock_table = NULL;
+            xsan_txn_table_remove(vm->pending_replicated_ios, transaction_id, _xsan_rep_ctx_put);
+            return lock_err;
+        }
+        if (!granted_now) {
+            XSAN_LOG_DEBUG("Vol %s, TID %lu: write range [%lu, +%lu) queued behind an overlapping write.",
+                           spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]), transaction_id,
+                           logical_byte_offset, length_bytes);
+            return XSAN_OK;
+        }
+    } else {
+        XSAN_LOG_WARN("Vol %s: no range-lock table available, TID %lu proceeds unserialised.",
+                      spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]), transaction_id);
+    }
+
+    return _xsan_replicated_write_dispatch(vm, rep_ctx);
+}
+
+static void _xsan_replicated_write_range_granted_cb(xsan_range_lock_req_t *req, void *cb_arg) {
+    xsan_replicated_io_ctx_t *rep_ctx = (xsan_replicated_io_ctx_t *)cb_arg;
+    (void)req;
+    // Failures are reported through the replica completion path, which releases the range.
+    _xsan_replicated_write_dispatch(g_xsan_volume_manager_instance, rep_ctx);
+}
+
+/**
+ * Fans a replicated write out to all replicas. Called once the write holds its LBA range.
+ * From here on every failure is reported through the completion path, which owns rep_ctx and
+ * calls the user back, so this always returns XSAN_OK; the caller must not complete the I/O again.
+ */
+static xsan_error_t _xsan_replicated_write_dispatch(xsan_volume_manager_t *vm, xsan_replicated_io_ctx_t *rep_ctx) {
+    xsan_volume_id_t volume_id = rep_ctx->volume_id;
+    uint64_t transaction_id = rep_ctx->transaction_id;
+    uint64_t logical_byte_offset = rep_ctx->logical_byte_offset;
+    uint64_t length_bytes = rep_ctx->length_bytes;
+    const void *user_buf = rep_ctx->user_buffer;
+    uint32_t current_actual_replica_count = rep_ctx->total_replicas_targeted;
+    xsan_replica_location_t replica_locations_copy[XSAN_MAX_REPLICAS];
+    uint32_t vol_block_size = 0;
+
+    // Replica states may have changed while the write was queued on its range, so take a fresh copy.
+    xsan_volume_t *vol = xsan_volume_get_by_id(vm, volume_id);
+    pthread_mutex_lock(&vm->lock);
+    if (vol) {
+        if (vol->actual_replica_count < current_actual_replica_count) {
+            current_actual_replica_count = vol->actual_replica_count;
+        }
+        memcpy(replica_locations_copy, vol->replica_nodes, sizeof(xsan_replica_location_t) * current_actual_replica_count);
+        vol_block_size = vol->block_size_bytes;
+        rep_ctx->replication_mode = vol->replication_mode;
+    }
+    pthread_mutex_unlock(&vm->lock);
+
+    if (!vol || vol_block_size == 0) {
+        XSAN_LOG_ERROR("Vol %s disappeared before TID %lu could be dispatched.",
+                       spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]), transaction_id);
+        rep_ctx->final_status = XSAN_ERROR_NOT_FOUND;
+        rep_ctx->failed_writes = rep_ctx->total_replicas_targeted - rep_ctx->successful_writes;
+        _xsan_check_replicated_write_completion(rep_ctx);
+        return XSAN_OK;
+    }
+    // Legs may complete (and the completion drop the table's reference) while this loop still
+    // reads rep_ctx, so hold one of our own until the fan-out is done.
+    _xsan_rep_ctx_get(rep_ctx);
+    // Replicas dropped from the volume since the context was created count as failed legs.
+    for (uint32_t k = current_actual_replica_count; k < rep_ctx->total_replicas_targeted; ++k) {
+        __sync_fetch_and_add(&rep_ctx->failed_writes, 1);
+    }
+
+    _xsan_replicated_write_arm_deadline(vm, rep_ctx);
 
     XSAN_LOG_DEBUG("Starting replicated write for vol %s, TID %lu, offset %lu, len %lu, replicas %u",
                    spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]), transaction_id,
@@ -1265,11 +2813,8 @@ xsan_error_t xsan_volume_write_async(xsan_volume_manager_t *vm,
             if (i == 0) {
                  _xsan_local_replica_write_complete_cb(rep_ctx, XSAN_ERROR_RESOURCE_UNAVAILABLE);
             } else {
-                xsan_per_replica_op_ctx_t *dummy_remote_ctx = XSAN_MALLOC(sizeof(xsan_per_replica_op_ctx_t));
+                xsan_per_replica_op_ctx_t *dummy_remote_ctx = _xsan_rep_op_ctx_alloc(rep_ctx, current_replica_loc);
                 if (dummy_remote_ctx) {
-                    memset(dummy_remote_ctx, 0, sizeof(xsan_per_replica_op_ctx_t));
-                    dummy_remote_ctx->parent_rep_ctx = rep_ctx;
-                    memcpy(&dummy_remote_ctx->replica_location_info, current_replica_loc, sizeof(xsan_replica_location_t));
                     _xsan_remote_replica_request_send_actual_cb(XSAN_ERROR_RESOURCE_UNAVAILABLE, dummy_remote_ctx);
                 } else {
                     __sync_fetch_and_add(&rep_ctx->failed_writes, 1);
@@ -1281,6 +2826,12 @@ xsan_error_t xsan_volume_write_async(xsan_volume_manager_t *vm,
         }
         at_least_one_submission_attempted = true;
 
+        if (i > 0 && rep_ctx->replication_mode == XSAN_REPLICATION_MODE_CHAIN) {
+            // Remote legs are collected into a chain and sent once, to the chain head, below.
+            memcpy(&rep_ctx->chain_hops[rep_ctx->chain_num_hops++], current_replica_loc, sizeof(xsan_replica_location_t));
+            continue;
+        }
+
         if (i == 0) {
             submit_status = _xsan_volume_submit_single_io_attempt(
                 vm, volume_id, logical_byte_offset, length_bytes,
@@ -1295,7 +2846,7 @@ xsan_error_t xsan_volume_write_async(xsan_volume_manager_t *vm,
                 _xsan_local_replica_write_complete_cb(rep_ctx, submit_status);
             }
         } else {
-            xsan_per_replica_op_ctx_t *remote_op_ctx = XSAN_MALLOC(sizeof(xsan_per_replica_op_ctx_t));
+            xsan_per_replica_op_ctx_t *remote_op_ctx = _xsan_rep_op_ctx_alloc(rep_ctx, current_replica_loc);
             if (!remote_op_ctx) {
                  XSAN_LOG_ERROR("Failed to allocate per_replica_op_ctx for vol %s, TID %lu, replica %u",
                                spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]), transaction_id, i);
@@ -1304,11 +2855,20 @@ xsan_error_t xsan_volume_write_async(xsan_volume_manager_t *vm,
                 _xsan_check_replicated_write_completion(rep_ctx);
                 continue;
             }
-            memset(remote_op_ctx, 0, sizeof(xsan_per_replica_op_ctx_t));
-            remote_op_ctx->parent_rep_ctx = rep_ctx;
-            memcpy(&remote_op_ctx->replica_location_info, current_replica_loc, sizeof(xsan_replica_location_t));
+
+            // Small writes ride in a per-node batch; the replica answers with a status per TID.
+            if (xsan_replica_write_batcher_accepts(vm->write_batcher, (uint32_t)length_bytes) &&
+                xsan_replica_write_batcher_submit(vm->write_batcher, current_replica_loc->node_ip_addr,
+                                                  current_replica_loc->node_comm_port, transaction_id, &volume_id,
+                                                  logical_byte_offset / vol_block_size,
+                                                  (uint32_t)(length_bytes / vol_block_size),
+                                                  user_buf, (uint32_t)length_bytes,
+                                                  _xsan_remote_replica_request_send_actual_cb, remote_op_ctx) == XSAN_OK) {
+                continue;
+            }
 
             xsan_replica_write_req_payload_t write_req_pl;
+            memset(&write_req_pl, 0, sizeof(write_req_pl));
             memcpy(&write_req_pl.volume_id, &volume_id, sizeof(xsan_volume_id_t));
             write_req_pl.block_lba_on_volume = logical_byte_offset / vol_block_size;
             write_req_pl.num_blocks = length_bytes / vol_block_size;
@@ -1322,10 +2882,10 @@ xsan_error_t xsan_volume_write_async(xsan_volume_manager_t *vm,
             if (!remote_op_ctx->request_msg_to_send) {
                 XSAN_LOG_ERROR("Failed to create replica write message for vol %s, TID %lu, replica %u",
                                spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]), transaction_id, i);
-                XSAN_FREE(remote_op_ctx);
                 __sync_fetch_and_add(&rep_ctx->failed_writes, 1);
                 if (rep_ctx->final_status == XSAN_OK) rep_ctx->final_status = XSAN_ERROR_OUT_OF_MEMORY;
-                 _xsan_check_replicated_write_completion(rep_ctx);
+                _xsan_check_replicated_write_completion(rep_ctx);
+                _xsan_rep_op_ctx_release(remote_op_ctx);
                 continue;
             }
 
@@ -1334,32 +2894,103 @@ xsan_error_t xsan_volume_write_async(xsan_volume_manager_t *vm,
 
             if (sock) {
                 _xsan_remote_replica_connect_then_send_cb(sock, 0, remote_op_ctx);
-            } else {
-                xsan_node_comm_connect(current_replica_loc->node_ip_addr,
-                                       current_replica_loc->node_comm_port,
-                                       _xsan_remote_replica_connect_then_send_cb,
-                                       remote_op_ctx);
+            } else if (xsan_node_comm_connect(current_replica_loc->node_ip_addr,
+                                              current_replica_loc->node_comm_port,
+                                              _xsan_remote_replica_connect_then_send_cb,
+                                              remote_op_ctx) != XSAN_OK) {
+                _xsan_remote_replica_connect_then_send_cb(NULL, -ENOTCONN, remote_op_ctx);
             }
         }
     }
 
-    if (!at_least_one_submission_attempted && current_actual_replica_count > 0) {
+    if (rep_ctx->chain_num_hops > 0) {
+        XSAN_LOG_DEBUG("Vol %s, TID %lu: chain-replicating to %u remote replicas.",
+                       spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]), transaction_id, rep_ctx->chain_num_hops);
+        _xsan_chain_write_send_from_head(rep_ctx);
+    }
+
+    if (!at_least_one_submission_attempted) {
         XSAN_LOG_ERROR("Vol %s, TID %lu: No replicas were in a state to attempt writes.",
             spdk_uuid_get_string((struct spdk_uuid*)&volume_id.data[0]), transaction_id);
-        rep_ctx->final_status = XSAN_ERROR_REPLICATION_UNAVAILABLE;
-        for(uint32_t k=0; k < rep_ctx->total_replicas_targeted; ++k) {
-            __sync_fetch_and_add(&rep_ctx->failed_writes, 1);
-        }
-        _xsan_check_replicated_write_completion(rep_ctx);
-        return XSAN_ERROR_REPLICATION_UNAVAILABLE;
-    } else if (current_actual_replica_count == 0) {
-         xsan_replicated_io_ctx_free(rep_ctx);
-         return XSAN_ERROR_REPLICATION_UNAVAILABLE;
+        // Every leg has already been reported as failed above, which completes the write with an error.
     }
 
+    _xsan_rep_ctx_put(rep_ctx);
+    return XSAN_OK;
+}
+
+xsan_error_t xsan_volume_get_write_lock_stats(xsan_volume_manager_t *vm, xsan_volume_id_t volume_id, xsan_range_lock_stats_t *stats_out) {
+    if (!vm || !vm->initialized || !stats_out) return XSAN_ERROR_INVALID_PARAM;
+    xsan_volume_t *vol = xsan_volume_get_by_id(vm, volume_id);
+    if (!vol) return XSAN_ERROR_NOT_FOUND;
+    memset(stats_out, 0, sizeof(*stats_out));
+    return vol->write_range_locks ? xsan_range_lock_get_stats(vol->write_range_locks, stats_out) : XSAN_OK;
+}
+
+xsan_error_t xsan_volume_manager_set_replica_timeouts(xsan_volume_manager_t *vm, uint64_t write_timeout_us, uint64_t read_timeout_us) {
+    if (!vm) return XSAN_ERROR_INVALID_PARAM;
+    __sync_lock_test_and_set(&vm->replica_write_timeout_us, write_timeout_us);
+    __sync_lock_test_and_set(&vm->replica_read_timeout_us, read_timeout_us);
+    XSAN_LOG_INFO("Replica deadlines set: write %lu us, read %lu us (0 = disabled).", write_timeout_us, read_timeout_us);
+    return XSAN_OK;
+}
+
+xsan_error_t xsan_volume_manager_get_replica_timeout_stats(xsan_volume_manager_t *vm, xsan_replica_timeout_stats_t *stats_out) {
+    if (!vm || !stats_out) return XSAN_ERROR_INVALID_PARAM;
+    stats_out->write_timeout_us = __sync_add_and_fetch(&vm->replica_write_timeout_us, 0);
+    stats_out->read_timeout_us = __sync_add_and_fetch(&vm->replica_read_timeout_us, 0);
+    stats_out->writes_timed_out = __sync_add_and_fetch(&vm->timeout_stats.writes_timed_out, 0);
+    stats_out->write_legs_timed_out = __sync_add_and_fetch(&vm->timeout_stats.write_legs_timed_out, 0);
+    stats_out->write_deadline_extensions = __sync_add_and_fetch(&vm->timeout_stats.write_deadline_extensions, 0);
+    stats_out->read_attempts_timed_out = __sync_add_and_fetch(&vm->timeout_stats.read_attempts_timed_out, 0);
+    stats_out->chain_forwards_timed_out = __sync_add_and_fetch(&vm->timeout_stats.chain_forwards_timed_out, 0);
     return XSAN_OK;
 }
 
+xsan_error_t xsan_volume_manager_warm_up_replica_connections(xsan_volume_manager_t *vm) {
+    if (!vm || !vm->initialized) return XSAN_ERROR_INVALID_PARAM;
+    // Distinct remote peers first; the node-comm peer table would coalesce duplicates anyway,
+    // but each warm-up visits every SPDK thread.
+    xsan_replica_location_t **peers = NULL;
+    uint32_t num_peers = 0, cap_peers = 0;
+    xsan_error_t err = XSAN_OK;
+    pthread_mutex_lock(&vm->lock);
+    xsan_list_node_t *node;
+    XSAN_LIST_FOREACH(vm->managed_volumes, node) {
+        xsan_volume_t *vol = (xsan_volume_t *)xsan_list_node_get_value(node);
+        for (uint32_t i = 0; i < vol->actual_replica_count && i < XSAN_MAX_REPLICAS; ++i) {
+            xsan_replica_location_t *rn = &vol->replica_nodes[i];
+            if (memcmp(&rn->node_id, &vm->local_node_id, sizeof(xsan_node_id_t)) == 0 ||
+                rn->node_ip_addr[0] == '\0' || rn->node_comm_port == 0) {
+                continue;
+            }
+            bool seen = false;
+            for (uint32_t k = 0; k < num_peers && !seen; ++k) {
+                seen = peers[k]->node_comm_port == rn->node_comm_port && strcmp(peers[k]->node_ip_addr, rn->node_ip_addr) == 0;
+            }
+            if (seen) continue;
+            if (num_peers == cap_peers) {
+                uint32_t new_cap = cap_peers ? cap_peers * 2 : 16;
+                xsan_replica_location_t **grown = (xsan_replica_location_t **)XSAN_REALLOC(peers, sizeof(*peers) * new_cap);
+                if (!grown) { err = XSAN_ERROR_OUT_OF_MEMORY; break; }
+                peers = grown;
+                cap_peers = new_cap;
+            }
+            peers[num_peers++] = rn;
+        }
+    }
+    uint32_t started = 0;
+    for (uint32_t k = 0; k < num_peers; ++k) {
+        xsan_error_t w_err = xsan_node_comm_warm_up(peers[k]->node_ip_addr, peers[k]->node_comm_port);
+        if (w_err == XSAN_OK) started++;
+        else XSAN_LOG_WARN("Connection warm-up to %s:%u not started: %s", peers[k]->node_ip_addr, peers[k]->node_comm_port, xsan_error_string(w_err));
+    }
+    pthread_mutex_unlock(&vm->lock);
+    if (peers) XSAN_FREE(peers);
+    XSAN_LOG_INFO("Started connection warm-up to %u of %u replica peer(s).", started, num_peers);
+    return err;
+}
+
 void xsan_volume_manager_handle_replica_write_req(struct xsan_connection_ctx *conn_ctx,
                                                   xsan_message_t *msg,
                                                   void *cb_arg_vol_mgr) {
@@ -1371,22 +3002,36 @@ void xsan_volume_manager_handle_replica_write_req(struct xsan_connection_ctx *co
     xsan_volume_manager_t *vm = (xsan_volume_manager_t *)cb_arg_vol_mgr;
     xsan_error_t err = XSAN_OK;
     xsan_replica_write_req_payload_t *req_payload = NULL;
+    xsan_replica_chain_write_req_payload_t *chain_req = NULL;
+    bool is_chain = (msg->header.type == XSAN_MSG_TYPE_REPLICA_CHAIN_WRITE_REQ);
+    uint32_t data_offset_in_payload = is_chain ? sizeof(xsan_replica_chain_write_req_payload_t)
+                                               : sizeof(xsan_replica_write_req_payload_t);
 
 
-    if (msg->header.type != XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_REQ) {
+    if (msg->header.type != XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_REQ && !is_chain) {
         XSAN_LOG_ERROR("Handler received incorrect message type %u for replica write.", msg->header.type);
         err = XSAN_ERROR_INVALID_MSG_TYPE;
         goto send_error_response_write_handler;
     }
-    if (msg->header.payload_length < sizeof(xsan_replica_write_req_payload_t)) {
+    if (msg->header.payload_length < data_offset_in_payload) {
         XSAN_LOG_ERROR("Replica write request payload too short (%u) from %s for TID %lu.",
                        msg->header.payload_length, conn_ctx->peer_addr_str, msg->header.transaction_id);
         err = XSAN_ERROR_PROTOCOL_GENERIC;
         goto send_error_response_write_handler;
     }
 
-    req_payload = (xsan_replica_write_req_payload_t *)msg->payload;
-    uint32_t data_offset_in_payload = sizeof(xsan_replica_write_req_payload_t);
+    if (is_chain) {
+        chain_req = (xsan_replica_chain_write_req_payload_t *)msg->payload;
+        req_payload = &chain_req->write;
+        if (!xsan_replica_chain_req_hops_valid(chain_req)) {
+            XSAN_LOG_ERROR("Malformed chain hops (%u downstream) in replica write from %s, TID %lu.",
+                           chain_req->chain_num_downstream, conn_ctx->peer_addr_str, msg->header.transaction_id);
+            err = XSAN_ERROR_PROTOCOL_GENERIC;
+            goto send_error_response_write_handler;
+        }
+    } else {
+        req_payload = (xsan_replica_write_req_payload_t *)msg->payload;
+    }
     uint32_t actual_data_len = msg->header.payload_length - data_offset_in_payload;
     unsigned char *data_to_write = msg->payload + data_offset_in_payload;
 
@@ -1413,6 +3058,18 @@ void xsan_volume_manager_handle_replica_write_req(struct xsan_connection_ctx *co
 
     uint64_t logical_byte_offset = req_payload->block_lba_on_volume * vol->block_size_bytes;
 
+    if (chain_req && chain_req->chain_num_downstream > 0) {
+        XSAN_LOG_DEBUG("Chain write for vol %s, LBA %lu, TID %lu from %s: forwarding to %s:%u",
+                       vol->name, req_payload->block_lba_on_volume, msg->header.transaction_id, conn_ctx->peer_addr_str,
+                       chain_req->chain_downstream[0].node_ip_addr, chain_req->chain_downstream[0].node_comm_port);
+        err = _xsan_chain_fwd_start(vm, msg->header.transaction_id, chain_req, logical_byte_offset, data_to_write, actual_data_len);
+        if (err != XSAN_OK) {
+            goto send_error_response_write_handler;
+        }
+        xsan_protocol_message_destroy(msg);
+        return;
+    }
+
     xsan_replica_op_handler_ctx_t *local_io_handler_ctx = XSAN_MALLOC(sizeof(xsan_replica_op_handler_ctx_t));
     if (!local_io_handler_ctx) {
         XSAN_LOG_ERROR("OOM for replica write handler context, TID %lu", msg->header.transaction_id);
@@ -1424,6 +3081,7 @@ void xsan_volume_manager_handle_replica_write_req(struct xsan_connection_ctx *co
     local_io_handler_ctx->originating_conn_ctx = conn_ctx;
     memcpy(&local_io_handler_ctx->original_req_header, &msg->header, sizeof(xsan_message_header_t));
     memcpy(&local_io_handler_ctx->req_payload_data.write_req_payload, req_payload, sizeof(xsan_replica_write_req_payload_t));
+    if (chain_req) memcpy(&local_io_handler_ctx->chain_upstream, &chain_req->upstream, sizeof(xsan_replica_chain_hop_t));
     local_io_handler_ctx->is_read_op_on_replica = false;
     local_io_handler_ctx->data_len_bytes = actual_data_len;
 
@@ -1431,45 +3089,38 @@ void xsan_volume_manager_handle_replica_write_req(struct xsan_connection_ctx *co
                    vol->name, req_payload->block_lba_on_volume, req_payload->num_blocks,
                    msg->header.transaction_id, conn_ctx->peer_addr_str);
 
-    err = _xsan_volume_submit_single_io_attempt(vm, req_payload->volume_id,
-                                                logical_byte_offset,
-                                                actual_data_len,
-                                                data_to_write,
-                                                false,
-                                                _handle_replica_local_io_complete_cb,
-                                                local_io_handler_ctx);
+    // A payload received into a DMA buffer is written in place; the message lives until the write completes.
+    bool write_in_place = msg->payload_is_dma;
+    if (write_in_place) local_io_handler_ctx->req_msg = msg;
+    err = _xsan_volume_submit_single_io_attempt_ex(vm, req_payload->volume_id,
+                                                   logical_byte_offset,
+                                                   actual_data_len,
+                                                   data_to_write,
+                                                   write_in_place,
+                                                   false,
+                                                   _handle_replica_local_io_complete_cb,
+                                                   local_io_handler_ctx);
     if (err != XSAN_OK) {
         XSAN_LOG_ERROR("Failed to submit local IO for replica write (vol %s, TID %lu): %s",
                        vol->name, msg->header.transaction_id, xsan_error_string(err));
          _handle_replica_local_io_complete_cb(local_io_handler_ctx, err);
     }
 
-    xsan_protocol_message_destroy(msg);
+    if (!write_in_place) xsan_protocol_message_destroy(msg);
     return;
 
 send_error_response_write_handler:
     {
-        xsan_replica_write_resp_payload_t err_resp_payload;
-        memset(&err_resp_payload, 0, sizeof(err_resp_payload));
-        err_resp_payload.status = err;
-        if (req_payload) {
-            err_resp_payload.block_lba_on_volume = req_payload->block_lba_on_volume;
-            err_resp_payload.num_blocks_processed = 0;
-        }
-        xsan_message_t *err_resp_msg = xsan_protocol_message_create(
-            XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_RESP,
-            msg->header.transaction_id,
-            &err_resp_payload, sizeof(err_resp_payload));
-
-        if (err_resp_msg) {
-            xsan_replica_response_cb_ctx_t *resp_send_ctx = XSAN_MALLOC(sizeof(xsan_replica_response_cb_ctx_t));
-            if (resp_send_ctx) {
-                resp_send_ctx->conn_ctx = conn_ctx;
-                resp_send_ctx->response_msg = err_resp_msg;
-                xsan_node_comm_send_msg(conn_ctx->sock, err_resp_msg, _replica_op_response_send_complete_cb, resp_send_ctx);
-            } else {
-                xsan_protocol_message_destroy(err_resp_msg);
-            }
+        xsan_replica_write_req_payload_t empty_req;
+        memset(&empty_req, 0, sizeof(empty_req));
+        if (is_chain) {
+            // Nothing was started, so the connection the request came in on is still good.
+            // A failed chain hop also speaks for every hop below it, which never saw the data.
+            _xsan_send_replica_response(conn_ctx, _xsan_chain_ack_create(vm, msg->header.transaction_id,
+                                                                         req_payload ? req_payload : &empty_req, err, NULL,
+                                                                         chain_req ? chain_req->chain_num_downstream : 0));
+        } else {
+            _xsan_send_replica_write_resp(vm, conn_ctx, msg->header.transaction_id, req_payload ? req_payload : &empty_req, err);
         }
     }
     xsan_protocol_message_destroy(msg);
@@ -1579,7 +3230,9 @@ send_error_response_read_handler:
             if (resp_send_ctx) {
                 resp_send_ctx->conn_ctx = conn_ctx;
                 resp_send_ctx->response_msg = err_resp_msg;
-                xsan_node_comm_send_msg(conn_ctx->sock, err_resp_msg, _replica_op_response_send_complete_cb, resp_send_ctx);
+                if (xsan_node_comm_send_msg(conn_ctx->sock, err_resp_msg, _replica_op_response_send_complete_cb, resp_send_ctx) != XSAN_OK) {
+                    _replica_op_response_send_complete_cb(-EIO, resp_send_ctx);
+                }
             } else {
                 xsan_protocol_message_destroy(err_resp_msg);
             }
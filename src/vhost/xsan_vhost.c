@@ -23,41 +23,60 @@
 static xsan_volume_manager_t *g_volume_manager = NULL;
 static pthread_mutex_t g_xsan_vbdev_list_lock = PTHREAD_MUTEX_INITIALIZER;
 
+// Bounce buffers up to this size come from a per-channel cache; larger I/Os allocate their own.
+#define XSAN_VBDEV_CH_BUF_SIZE (128 * 1024)
+#define XSAN_VBDEV_CH_BUF_CACHE_MAX 32  // Free buffers a channel keeps
+#define XSAN_VBDEV_CH_BUF_PREFILL 4     // Allocated when the channel is created
+#define XSAN_VBDEV_DMA_ALIGN 4096
+
 // --- Internal Context Structures ---
 
 typedef struct xsan_vbdev {
     struct spdk_bdev bdev;
     xsan_volume_id_t xsan_volume_id;
     xsan_volume_t *xsan_volume_ptr;
+    uint32_t volume_gen;                    // Bumped when xsan_volume_ptr changes; channels re-read it then
+    xsan_vhost_vbdev_stats_t retired_stats; // Counters of channels already destroyed
     char *name;
     struct xsan_vbdev *next;
 } xsan_vbdev_t;
 
 static xsan_vbdev_t *g_xsan_vbdev_head = NULL;
 
+// Per-thread state of one vbdev (the vbdev is its io_device). Holds everything the submit
+// path needs, so a submission takes no locks and does no lookups or heap allocations.
 typedef struct xsan_vbdev_io_channel {
-    // No specific members needed for now for basic passthrough
+    xsan_vbdev_t *xvbdev;
+    struct spdk_thread *thread;
+    xsan_volume_t *vol;             // Cached xvbdev->xsan_volume_ptr, valid while volume_gen matches
+    uint32_t volume_gen;
+    uint32_t block_size;
+    size_t buf_align;
+    uint32_t buf_count;
+    void *bufs[XSAN_VBDEV_CH_BUF_CACHE_MAX]; // Free bounce buffers of XSAN_VBDEV_CH_BUF_SIZE bytes
+    xsan_vhost_vbdev_stats_t stats;
 } xsan_vbdev_io_channel_t;
 
+// Lives in spdk_bdev_io::driver_ctx; see _xsan_vbdev_get_ctx_size.
 typedef struct xsan_vhost_io_ctx {
     struct spdk_bdev_io *bdev_io;
-    xsan_volume_t *xsan_vol;
+    xsan_vbdev_io_channel_t *ch;
     void *dma_buf;
     uint64_t dma_buf_len;
-    bool dma_buf_is_internal;
+    bool dma_buf_cached;            // Returns to ch->bufs rather than being freed
+    xsan_error_t status;
 } xsan_vhost_io_ctx_t;
 
 
 // --- Forward declarations for SPDK bdev module callbacks ---
 static int _xsan_vbdev_init(void);
 static void _xsan_vbdev_fini(void);
-static void _xsan_vbdev_get_ctx_size(void);
+static int _xsan_vbdev_get_ctx_size(void);
 static int _xsan_vbdev_destruct(void *ctx);
 static void _xsan_vbdev_submit_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io);
 static bool _xsan_vbdev_io_type_supported(void *ctx, enum spdk_bdev_io_type io_type);
 static struct spdk_io_channel *_xsan_vbdev_get_io_channel(void *ctx);
 static void _xsan_vbdev_dump_info_json(void *ctx, struct spdk_json_write_ctx *w);
-static void _xsan_vbdev_destroy_io_channel(void *ctx, struct spdk_io_channel *ch);
 
 // --- XSAN Vhost Internal I/O Completion Callback ---
 static void _xsan_vbdev_io_complete_cb(void *cb_arg, xsan_error_t xsan_status);
@@ -76,7 +95,6 @@ static const struct spdk_bdev_fn_table xsan_vbdev_fn_table = {
     .io_type_supported = _xsan_vbdev_io_type_supported,
     .get_io_channel = _xsan_vbdev_get_io_channel,
     .dump_info_json = _xsan_vbdev_dump_info_json,
-    .destroy_io_channel = _xsan_vbdev_destroy_io_channel,
 };
 
 // --- SPDK Bdev Module Callbacks Implementation ---
@@ -88,7 +106,14 @@ static int _xsan_vbdev_init(void) {
     return 0;
 }
 static void _xsan_vbdev_fini(void) { XSAN_LOG_INFO("XSAN vbdev module fini.");}
-static void _xsan_vbdev_get_ctx_size(void) { /* Do nothing for now */ }
+// The per-I/O context is carved out of every spdk_bdev_io the bdev layer hands us.
+static int _xsan_vbdev_get_ctx_size(void) { return (int)sizeof(xsan_vhost_io_ctx_t); }
+
+static void _xsan_vbdev_unregister_done(void *io_device) {
+    xsan_vbdev_t *xvbdev = (xsan_vbdev_t *)io_device;
+    if (xvbdev->name) XSAN_FREE(xvbdev->name);
+    XSAN_FREE(xvbdev);
+}
 
 static int _xsan_vbdev_destruct(void *ctx) {
     xsan_vbdev_t *xvbdev = (xsan_vbdev_t *)ctx; if (!xvbdev) return -1;
@@ -96,102 +121,154 @@ static int _xsan_vbdev_destruct(void *ctx) {
     pthread_mutex_lock(&g_xsan_vbdev_list_lock);
     xsan_vbdev_t *p = NULL, *c = g_xsan_vbdev_head; while(c){if(c==xvbdev){if(p)p->next=c->next;else g_xsan_vbdev_head=c->next;break;}p=c;c=c->next;}
     pthread_mutex_unlock(&g_xsan_vbdev_list_lock);
-    if (xvbdev->name) XSAN_FREE(xvbdev->name); XSAN_FREE(xvbdev); return 0;
+    // Freed once the last channel is gone.
+    spdk_io_device_unregister(xvbdev, _xsan_vbdev_unregister_done);
+    return 0;
 }
 
-static void _xsan_vbdev_io_complete_cb(void *cb_arg, xsan_error_t xsan_status) {
-    xsan_vhost_io_ctx_t *vhost_io_ctx = (xsan_vhost_io_ctx_t *)cb_arg;
-    if (!vhost_io_ctx || !vhost_io_ctx->bdev_io) {
-        XSAN_LOG_ERROR("NULL context or bdev_io in _xsan_vbdev_io_complete_cb!");
-        if (vhost_io_ctx && vhost_io_ctx->dma_buf_is_internal && vhost_io_ctx->dma_buf) xsan_bdev_dma_free(vhost_io_ctx->dma_buf);
-        if (vhost_io_ctx) XSAN_FREE(vhost_io_ctx);
+static void *_xsan_vbdev_ch_get_buf(xsan_vbdev_io_channel_t *ch, uint64_t len, bool *cached) {
+    *cached = (len <= XSAN_VBDEV_CH_BUF_SIZE);
+    if (*cached && ch->buf_count > 0) return ch->bufs[--ch->buf_count];
+    ch->stats.buf_cache_misses++;
+    return xsan_bdev_dma_malloc(*cached ? XSAN_VBDEV_CH_BUF_SIZE : len, ch->buf_align);
+}
+
+static void _xsan_vbdev_ch_put_buf(xsan_vbdev_io_channel_t *ch, void *buf, bool cached) {
+    if (cached && ch->buf_count < XSAN_VBDEV_CH_BUF_CACHE_MAX) {
+        ch->bufs[ch->buf_count++] = buf;
         return;
     }
+    xsan_bdev_dma_free(buf);
+}
+
+// Runs on the channel's thread: the bounce buffer cache, the counters and spdk_bdev_io_complete
+// all belong to the thread that submitted the I/O.
+static void _xsan_vbdev_io_finish(void *arg) {
+    xsan_vhost_io_ctx_t *vhost_io_ctx = (xsan_vhost_io_ctx_t *)arg;
     struct spdk_bdev_io *bdev_io = vhost_io_ctx->bdev_io;
+    xsan_vbdev_io_channel_t *ch = vhost_io_ctx->ch;
+    xsan_error_t xsan_status = vhost_io_ctx->status;
     enum spdk_bdev_io_status spdk_status;
 
     if (xsan_status == XSAN_OK) {
         spdk_status = SPDK_BDEV_IO_STATUS_SUCCESS;
-        if (bdev_io->type == SPDK_BDEV_IO_TYPE_READ && vhost_io_ctx->dma_buf_is_internal && vhost_io_ctx->dma_buf) {
-            if (bdev_io->u.bdev.iovs && bdev_io->u.bdev.iovcnt > 0) {
-                size_t total_iov_len = 0; for(int i=0; i < bdev_io->u.bdev.iovcnt; ++i) total_iov_len += bdev_io->u.bdev.iovs[i].iov_len;
-                size_t actual_copy_len = spdk_min(vhost_io_ctx->dma_buf_len, total_iov_len);
-                size_t copied = spdk_iov_memcpy_to_iov(bdev_io->u.bdev.iovs, bdev_io->u.bdev.iovcnt, vhost_io_ctx->dma_buf, actual_copy_len);
-                if (copied != actual_copy_len) { XSAN_LOG_ERROR("XSAN vbdev READ: spdk_iov_memcpy_to_iov partial copy (%zu/%zu).", copied, actual_copy_len); spdk_status = SPDK_BDEV_IO_STATUS_FAILED; }
-                else { XSAN_LOG_TRACE("XSAN vbdev READ: Copied %zu bytes from DMA to iovs for bdev_io %p.", copied, (void*)bdev_io); }
-            } else { XSAN_LOG_ERROR("XSAN vbdev READ: No iovs in bdev_io %p!", (void*)bdev_io); spdk_status = SPDK_BDEV_IO_STATUS_FAILED; }
+        if (bdev_io->type == SPDK_BDEV_IO_TYPE_READ) {
+            size_t copied = spdk_iov_memcpy_to_iov(bdev_io->u.bdev.iovs, bdev_io->u.bdev.iovcnt, vhost_io_ctx->dma_buf, vhost_io_ctx->dma_buf_len);
+            if (copied != vhost_io_ctx->dma_buf_len) { XSAN_LOG_ERROR("XSAN vbdev READ: spdk_iov_memcpy_to_iov partial copy (%zu/%lu).", copied, vhost_io_ctx->dma_buf_len); spdk_status = SPDK_BDEV_IO_STATUS_FAILED; }
+            else { XSAN_LOG_TRACE("XSAN vbdev READ: Copied %zu bytes from DMA to iovs for bdev_io %p.", copied, (void*)bdev_io); }
         }
     } else {
-        XSAN_LOG_ERROR("XSAN vbdev I/O for vol '%s' (bdev_io %p) failed xsan_status %d (%s)", vhost_io_ctx->xsan_vol ? vhost_io_ctx->xsan_vol->name : "UNKNOWN", (void*)bdev_io, xsan_status, xsan_error_string(xsan_status));
+        // The volume may have been deleted while the I/O ran, so name the bdev rather than the volume
+        XSAN_LOG_ERROR("XSAN vbdev I/O on '%s' (bdev_io %p) failed xsan_status %d (%s)", bdev_io->bdev->name, (void*)bdev_io, xsan_status, xsan_error_string(xsan_status));
         spdk_status = SPDK_BDEV_IO_STATUS_FAILED;
     }
-    if (vhost_io_ctx->dma_buf_is_internal && vhost_io_ctx->dma_buf) xsan_bdev_dma_free(vhost_io_ctx->dma_buf);
-    XSAN_FREE(vhost_io_ctx);
+    if (spdk_status != SPDK_BDEV_IO_STATUS_SUCCESS) {
+        ch->stats.failed_ops++;
+    } else if (bdev_io->type == SPDK_BDEV_IO_TYPE_READ) {
+        ch->stats.read_ops++; ch->stats.bytes_read += vhost_io_ctx->dma_buf_len;
+    } else {
+        ch->stats.write_ops++; ch->stats.bytes_written += vhost_io_ctx->dma_buf_len;
+    }
+    _xsan_vbdev_ch_put_buf(ch, vhost_io_ctx->dma_buf, vhost_io_ctx->dma_buf_cached);
     spdk_bdev_io_complete(bdev_io, spdk_status);
 }
 
-static void _xsan_vbdev_submit_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io) {
-    xsan_vbdev_t *xvbdev = (xsan_vbdev_t *)bdev_io->bdev->ctxt;
+static void _xsan_vbdev_io_complete_cb(void *cb_arg, xsan_error_t xsan_status) {
+    xsan_vhost_io_ctx_t *vhost_io_ctx = (xsan_vhost_io_ctx_t *)cb_arg;
+    vhost_io_ctx->status = xsan_status;
+    if (spdk_get_thread() != vhost_io_ctx->ch->thread) {
+        if (spdk_thread_send_msg(vhost_io_ctx->ch->thread, _xsan_vbdev_io_finish, vhost_io_ctx) == 0) return;
+        XSAN_LOG_ERROR("XSAN vbdev: cannot return bdev_io %p to its channel thread; completing here.", (void*)vhost_io_ctx->bdev_io);
+    }
+    _xsan_vbdev_io_finish(vhost_io_ctx);
+}
+
+static void _xsan_vbdev_submit_request(struct spdk_io_channel *_ch, struct spdk_bdev_io *bdev_io) {
+    xsan_vbdev_io_channel_t *ch = (xsan_vbdev_io_channel_t *)spdk_io_channel_get_ctx(_ch);
+    xsan_vbdev_t *xvbdev = ch->xvbdev;
+    xsan_vhost_io_ctx_t *vhost_io_ctx = (xsan_vhost_io_ctx_t *)bdev_io->driver_ctx;
     xsan_error_t err;
 
-    xsan_vhost_io_ctx_t *vhost_io_ctx = XSAN_CALLOC(1, sizeof(xsan_vhost_io_ctx_t));
-    if (!vhost_io_ctx) { spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_NOMEM); return; }
-    vhost_io_ctx->bdev_io = bdev_io;
-    vhost_io_ctx->xsan_vol = xvbdev->xsan_volume_ptr;
+    switch (bdev_io->type) {
+        case SPDK_BDEV_IO_TYPE_READ:
+        case SPDK_BDEV_IO_TYPE_WRITE: break;
+        case SPDK_BDEV_IO_TYPE_UNMAP: spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_SUCCESS); return;
+        case SPDK_BDEV_IO_TYPE_FLUSH: spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_SUCCESS); return;
+        case SPDK_BDEV_IO_TYPE_RESET: spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_SUCCESS); return;
+        default: spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_NOT_SUPPORTED); return;
+    }
 
-    if (!vhost_io_ctx->xsan_vol) { XSAN_LOG_ERROR("vbdev %s no xsan_volume_ptr.", xvbdev->name); XSAN_FREE(vhost_io_ctx); spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED); return; }
+    uint32_t gen = __atomic_load_n(&xvbdev->volume_gen, __ATOMIC_ACQUIRE);
+    if (gen != ch->volume_gen) { ch->vol = __atomic_load_n(&xvbdev->xsan_volume_ptr, __ATOMIC_RELAXED); ch->volume_gen = gen; }
+    if (!ch->vol) { XSAN_LOG_ERROR("vbdev %s no xsan_volume_ptr.", xvbdev->name); ch->stats.failed_ops++; spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED); return; }
 
-    uint64_t offset_bytes = bdev_io->u.bdev.offset_blocks * xvbdev->bdev.blocklen;
-    uint64_t length_bytes = (uint64_t)bdev_io->u.bdev.num_blocks * xvbdev->bdev.blocklen;
+    uint64_t offset_bytes = bdev_io->u.bdev.offset_blocks * ch->block_size;
+    uint64_t length_bytes = (uint64_t)bdev_io->u.bdev.num_blocks * ch->block_size;
 
     XSAN_LOG_TRACE("vbdev '%s': submit type %d, off_bytes %lu, len_bytes %lu, iovcnt %d", xvbdev->name, bdev_io->type, offset_bytes, length_bytes, bdev_io->u.bdev.iovcnt);
 
-    switch (bdev_io->type) {
-        case SPDK_BDEV_IO_TYPE_READ:
-        case SPDK_BDEV_IO_TYPE_WRITE:
-            if (length_bytes == 0) { XSAN_FREE(vhost_io_ctx); spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_SUCCESS); return; }
-            if (!bdev_io->u.bdev.iovs || bdev_io->u.bdev.iovcnt == 0) { XSAN_FREE(vhost_io_ctx); spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED); return; }
-
-            size_t dma_align = xsan_bdev_get_buf_align(xvbdev->name); // Use vbdev name for alignment, assuming it's consistent or first disk
-            if(dma_align == 0) dma_align = 4096;
-
-            vhost_io_ctx->dma_buf = xsan_bdev_dma_malloc(length_bytes, dma_align);
-            if (!vhost_io_ctx->dma_buf) { XSAN_FREE(vhost_io_ctx); spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_NOMEM); return; }
-            vhost_io_ctx->dma_buf_is_internal = true; vhost_io_ctx->dma_buf_len = length_bytes;
-
-            if (bdev_io->type == SPDK_BDEV_IO_TYPE_WRITE) {
-                size_t copied = spdk_iov_memcpy_from_iov(vhost_io_ctx->dma_buf, length_bytes, bdev_io->u.bdev.iovs, bdev_io->u.bdev.iovcnt);
-                if (copied != length_bytes) { /* Error, free bufs, complete failed */ xsan_bdev_dma_free(vhost_io_ctx->dma_buf); XSAN_FREE(vhost_io_ctx); spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED); return; }
-            }
-            if (bdev_io->type == SPDK_BDEV_IO_TYPE_READ) {
-                err = xsan_volume_read_async(g_volume_manager, xvbdev->xsan_volume_id, offset_bytes, length_bytes, vhost_io_ctx->dma_buf, _xsan_vbdev_io_complete_cb, vhost_io_ctx);
-            } else {
-                err = xsan_volume_write_async(g_volume_manager, xvbdev->xsan_volume_id, offset_bytes, length_bytes, vhost_io_ctx->dma_buf, _xsan_vbdev_io_complete_cb, vhost_io_ctx);
-            }
-            if (err != XSAN_OK) { /* Error, free bufs, complete failed */
-                XSAN_LOG_ERROR("vbdev '%s': Failed submit to xsan_volume_async: %s", xvbdev->name, xsan_error_string(err));
-                if (vhost_io_ctx->dma_buf_is_internal && vhost_io_ctx->dma_buf) xsan_bdev_dma_free(vhost_io_ctx->dma_buf);
-                XSAN_FREE(vhost_io_ctx); spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED);
-            } // Else, _xsan_vbdev_io_complete_cb handles completion
-            break;
-        case SPDK_BDEV_IO_TYPE_UNMAP: XSAN_FREE(vhost_io_ctx); spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_SUCCESS); break;
-        case SPDK_BDEV_IO_TYPE_FLUSH: XSAN_FREE(vhost_io_ctx); spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_SUCCESS); break;
-        case SPDK_BDEV_IO_TYPE_RESET: XSAN_FREE(vhost_io_ctx); spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_SUCCESS); break;
-        default: XSAN_FREE(vhost_io_ctx); spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_NOT_SUPPORTED); break;
+    if (length_bytes == 0) { spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_SUCCESS); return; }
+    if (!bdev_io->u.bdev.iovs || bdev_io->u.bdev.iovcnt == 0) { ch->stats.failed_ops++; spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED); return; }
+
+    vhost_io_ctx->bdev_io = bdev_io;
+    vhost_io_ctx->ch = ch;
+    vhost_io_ctx->dma_buf_len = length_bytes;
+    vhost_io_ctx->dma_buf = _xsan_vbdev_ch_get_buf(ch, length_bytes, &vhost_io_ctx->dma_buf_cached);
+    if (!vhost_io_ctx->dma_buf) { spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_NOMEM); return; }
+
+    if (bdev_io->type == SPDK_BDEV_IO_TYPE_WRITE) {
+        size_t copied = spdk_iov_memcpy_from_iov(vhost_io_ctx->dma_buf, length_bytes, bdev_io->u.bdev.iovs, bdev_io->u.bdev.iovcnt);
+        if (copied != length_bytes) { _xsan_vbdev_ch_put_buf(ch, vhost_io_ctx->dma_buf, vhost_io_ctx->dma_buf_cached); ch->stats.failed_ops++; spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED); return; }
+        err = xsan_volume_write_async(g_volume_manager, xvbdev->xsan_volume_id, offset_bytes, length_bytes, vhost_io_ctx->dma_buf, _xsan_vbdev_io_complete_cb, vhost_io_ctx);
+    } else {
+        err = xsan_volume_read_async(g_volume_manager, xvbdev->xsan_volume_id, offset_bytes, length_bytes, vhost_io_ctx->dma_buf, _xsan_vbdev_io_complete_cb, vhost_io_ctx);
     }
+    if (err != XSAN_OK) {
+        XSAN_LOG_ERROR("vbdev '%s': Failed submit to xsan_volume_async: %s", xvbdev->name, xsan_error_string(err));
+        _xsan_vbdev_ch_put_buf(ch, vhost_io_ctx->dma_buf, vhost_io_ctx->dma_buf_cached);
+        ch->stats.failed_ops++;
+        spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED);
+    } // Else, _xsan_vbdev_io_complete_cb handles completion
 }
 
 static bool _xsan_vbdev_io_type_supported(void *ctx, enum spdk_bdev_io_type io_type) { /* ... as before ... */
     switch (io_type) { case SPDK_BDEV_IO_TYPE_READ: case SPDK_BDEV_IO_TYPE_WRITE: case SPDK_BDEV_IO_TYPE_UNMAP: case SPDK_BDEV_IO_TYPE_FLUSH: case SPDK_BDEV_IO_TYPE_RESET: return true; default: return false; }
 }
-static struct spdk_io_channel *_xsan_vbdev_get_io_channel(void *ctx) { /* ... as before ... */
-    xsan_vbdev_io_channel_t *ch_ctx = XSAN_CALLOC(1, sizeof(xsan_vbdev_io_channel_t)); if (!ch_ctx) return NULL;
-    return spdk_io_channel_from_ctx(ch_ctx);
+
+static int _xsan_vbdev_ch_create_cb(void *io_device, void *ctx_buf) {
+    xsan_vbdev_t *xvbdev = (xsan_vbdev_t *)io_device;
+    xsan_vbdev_io_channel_t *ch = (xsan_vbdev_io_channel_t *)ctx_buf;
+    ch->xvbdev = xvbdev;
+    ch->thread = spdk_get_thread();
+    ch->volume_gen = __atomic_load_n(&xvbdev->volume_gen, __ATOMIC_ACQUIRE);
+    ch->vol = __atomic_load_n(&xvbdev->xsan_volume_ptr, __ATOMIC_RELAXED);
+    ch->block_size = xvbdev->bdev.blocklen;
+    ch->buf_align = spdk_max(spdk_bdev_get_buf_align(&xvbdev->bdev), (size_t)XSAN_VBDEV_DMA_ALIGN);
+    while (ch->buf_count < XSAN_VBDEV_CH_BUF_PREFILL) {
+        void *buf = xsan_bdev_dma_malloc(XSAN_VBDEV_CH_BUF_SIZE, ch->buf_align);
+        if (!buf) break; // The cache refills on demand
+        ch->bufs[ch->buf_count++] = buf;
+    }
+    return 0;
 }
-static void _xsan_vbdev_destroy_io_channel(void *ctx, struct spdk_io_channel *ch) {
-    xsan_vbdev_io_channel_t *ch_ctx = (xsan_vbdev_io_channel_t *)spdk_io_channel_get_ctx(ch);
-    if (ch_ctx) XSAN_FREE(ch_ctx);
+
+static void _xsan_vbdev_ch_destroy_cb(void *io_device, void *ctx_buf) {
+    xsan_vbdev_t *xvbdev = (xsan_vbdev_t *)io_device;
+    xsan_vbdev_io_channel_t *ch = (xsan_vbdev_io_channel_t *)ctx_buf;
+    while (ch->buf_count > 0) xsan_bdev_dma_free(ch->bufs[--ch->buf_count]);
+    xsan_vhost_vbdev_stats_t *r = &xvbdev->retired_stats;
+    __sync_fetch_and_add(&r->read_ops, ch->stats.read_ops);
+    __sync_fetch_and_add(&r->write_ops, ch->stats.write_ops);
+    __sync_fetch_and_add(&r->bytes_read, ch->stats.bytes_read);
+    __sync_fetch_and_add(&r->bytes_written, ch->stats.bytes_written);
+    __sync_fetch_and_add(&r->failed_ops, ch->stats.failed_ops);
+    __sync_fetch_and_add(&r->buf_cache_misses, ch->stats.buf_cache_misses);
+}
+
+static struct spdk_io_channel *_xsan_vbdev_get_io_channel(void *ctx) {
+    return spdk_get_io_channel(ctx);
 }
+
 static void _xsan_vbdev_dump_info_json(void *ctx, struct spdk_json_write_ctx *w) { /* ... as before ... */
     xsan_vbdev_t *xvbdev = (xsan_vbdev_t *)ctx; char uuid_str[SPDK_UUID_STRING_LEN];
     spdk_json_write_name(w, "xsan_vbdev"); spdk_json_write_object_begin(w);
@@ -211,6 +288,9 @@ xsan_error_t xsan_vhost_subsystem_init(struct xsan_volume_manager *vm) { /* ...
 }
 void xsan_vhost_subsystem_fini(void) { /* ... as before ... */
     XSAN_LOG_INFO("XSAN vhost subsystem finalizing...");
+    // Controllers first: each holds its vbdev open. Any a guest keeps busy are removed by SPDK's vhost fini.
+    uint32_t busy_ctrlrs = xsan_vhost_blk_controller_destroy_all();
+    if (busy_ctrlrs) XSAN_LOG_WARN("%u vhost-blk controller(s) still have a guest connected.", busy_ctrlrs);
     pthread_mutex_lock(&g_xsan_vbdev_list_lock);
     xsan_vbdev_t *xvbdev = g_xsan_vbdev_head; xsan_vbdev_t *next;
     while(xvbdev != NULL) { next = xvbdev->next; XSAN_LOG_INFO("Unregistering XSAN vbdev '%s'", xvbdev->bdev.name); spdk_bdev_unregister(&xvbdev->bdev, NULL, NULL); xvbdev = next; }
@@ -235,8 +315,9 @@ xsan_error_t xsan_vhost_expose_volume_as_vbdev(xsan_volume_id_t volume_id, const
     xvbdev->bdev.write_cache = 0; xvbdev->bdev.blocklen = vol->block_size_bytes; xvbdev->bdev.blockcnt = vol->num_blocks;
     spdk_uuid_copy(&xvbdev->bdev.uuid, (struct spdk_uuid *)&vol->id.data[0]);
     xvbdev->bdev.ctxt = xvbdev; xvbdev->bdev.fn_table = &xsan_vbdev_fn_table; xvbdev->bdev.module = &xsan_vbdev_module;
+    spdk_io_device_register(xvbdev, _xsan_vbdev_ch_create_cb, _xsan_vbdev_ch_destroy_cb, sizeof(xsan_vbdev_io_channel_t), xvbdev->name);
     int rc = spdk_bdev_register(&xvbdev->bdev);
-    if (rc != 0) { XSAN_LOG_ERROR("Failed to register XSAN vbdev '%s': %s", vbdev_name, spdk_strerror(-rc)); if(xvbdev->name)XSAN_FREE(xvbdev->name); XSAN_FREE(xvbdev); return xsan_error_from_errno(-rc); }
+    if (rc != 0) { XSAN_LOG_ERROR("Failed to register XSAN vbdev '%s': %s", vbdev_name, spdk_strerror(-rc)); spdk_io_device_unregister(xvbdev, _xsan_vbdev_unregister_done); return xsan_error_from_errno(-rc); }
     pthread_mutex_lock(&g_xsan_vbdev_list_lock); xvbdev->next = g_xsan_vbdev_head; g_xsan_vbdev_head = xvbdev; pthread_mutex_unlock(&g_xsan_vbdev_list_lock);
     XSAN_LOG_INFO("Exposed XSAN Vol '%s' as vbdev '%s'", vol->name, vbdev_name); return XSAN_OK;
 }
@@ -252,3 +333,72 @@ xsan_error_t xsan_vhost_unexpose_volume_vbdev(const char *vbdev_name) { /* ... a
     spdk_bdev_unregister(&xvbdev->bdev, NULL, NULL); // This will call _xsan_vbdev_destruct
     XSAN_LOG_INFO("Unregistered XSAN vbdev '%s'.", vbdev_name); return XSAN_OK;
 }
+
+uint32_t xsan_vhost_detach_volume(xsan_volume_id_t volume_id) {
+    uint32_t detached = 0;
+    pthread_mutex_lock(&g_xsan_vbdev_list_lock);
+    for (xsan_vbdev_t *xvbdev = g_xsan_vbdev_head; xvbdev; xvbdev = xvbdev->next) {
+        if (xvbdev->xsan_volume_ptr && memcmp(&xvbdev->xsan_volume_id, &volume_id, sizeof(volume_id)) == 0) {
+            __atomic_store_n(&xvbdev->xsan_volume_ptr, NULL, __ATOMIC_RELAXED); // I/O fails from now on
+            __atomic_add_fetch(&xvbdev->volume_gen, 1, __ATOMIC_RELEASE);       // Channels drop their cached handle
+            detached++;
+        }
+    }
+    pthread_mutex_unlock(&g_xsan_vbdev_list_lock);
+    if (detached) {
+        char uuid_str[SPDK_UUID_STRING_LEN];
+        spdk_uuid_fmt_lower(uuid_str, sizeof(uuid_str), (struct spdk_uuid *)&volume_id.data[0]);
+        XSAN_LOG_INFO("Detached %u XSAN vbdev(s) from volume %s being deleted.", detached, uuid_str);
+    }
+    return detached;
+}
+
+typedef struct {
+    xsan_vhost_vbdev_stats_t stats;
+    xsan_vhost_vbdev_stats_cb_t cb;
+    void *cb_arg;
+} xsan_vbdev_stats_req_t;
+
+static void _xsan_vbdev_stats_ch_fn(struct spdk_io_channel_iter *i) {
+    xsan_vbdev_stats_req_t *req = (xsan_vbdev_stats_req_t *)spdk_io_channel_iter_get_ctx(i);
+    xsan_vbdev_io_channel_t *ch = (xsan_vbdev_io_channel_t *)spdk_io_channel_get_ctx(spdk_io_channel_iter_get_channel(i));
+    req->stats.read_ops += ch->stats.read_ops;
+    req->stats.write_ops += ch->stats.write_ops;
+    req->stats.bytes_read += ch->stats.bytes_read;
+    req->stats.bytes_written += ch->stats.bytes_written;
+    req->stats.failed_ops += ch->stats.failed_ops;
+    req->stats.buf_cache_misses += ch->stats.buf_cache_misses;
+    spdk_for_each_channel_continue(i, 0);
+}
+
+static void _xsan_vbdev_stats_done(struct spdk_io_channel_iter *i, int status) {
+    xsan_vbdev_stats_req_t *req = (xsan_vbdev_stats_req_t *)spdk_io_channel_iter_get_ctx(i);
+    req->cb(req->cb_arg, status == 0 ? XSAN_OK : XSAN_ERROR_IO, status == 0 ? &req->stats : NULL);
+    XSAN_FREE(req);
+}
+
+xsan_error_t xsan_vhost_get_vbdev_stats(const char *vbdev_name, xsan_vhost_vbdev_stats_cb_t cb, void *cb_arg) {
+    if (spdk_get_thread() == NULL) return XSAN_ERROR_THREAD_CONTEXT;
+    if (!vbdev_name || !cb) return XSAN_ERROR_INVALID_PARAM;
+    xsan_vbdev_stats_req_t *req = (xsan_vbdev_stats_req_t *)XSAN_CALLOC(1, sizeof(xsan_vbdev_stats_req_t));
+    if (!req) return XSAN_ERROR_NO_MEMORY;
+    req->cb = cb;
+    req->cb_arg = cb_arg;
+    pthread_mutex_lock(&g_xsan_vbdev_list_lock);
+    xsan_vbdev_t *xvbdev = g_xsan_vbdev_head;
+    while (xvbdev && strcmp(xvbdev->name, vbdev_name) != 0) xvbdev = xvbdev->next;
+    if (xvbdev) {
+        // Still listed, so not yet unregistered; the iteration keeps the io_device alive.
+        xsan_vhost_vbdev_stats_t *r = &xvbdev->retired_stats;
+        req->stats.read_ops = __sync_fetch_and_add(&r->read_ops, 0);
+        req->stats.write_ops = __sync_fetch_and_add(&r->write_ops, 0);
+        req->stats.bytes_read = __sync_fetch_and_add(&r->bytes_read, 0);
+        req->stats.bytes_written = __sync_fetch_and_add(&r->bytes_written, 0);
+        req->stats.failed_ops = __sync_fetch_and_add(&r->failed_ops, 0);
+        req->stats.buf_cache_misses = __sync_fetch_and_add(&r->buf_cache_misses, 0);
+        spdk_for_each_channel(xvbdev, _xsan_vbdev_stats_ch_fn, req, _xsan_vbdev_stats_done);
+    }
+    pthread_mutex_unlock(&g_xsan_vbdev_list_lock);
+    if (!xvbdev) { XSAN_FREE(req); return XSAN_ERROR_NOT_FOUND; }
+    return XSAN_OK;
+}
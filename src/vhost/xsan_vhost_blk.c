@@ -0,0 +1,244 @@
+#include "xsan_vhost.h"
+#include "xsan_memory.h"
+#include "xsan_log.h"
+#include "xsan_error.h"
+#include "xsan_string_utils.h"
+
+#include "spdk/env.h"
+#include "spdk/event.h"     // For spdk_app_get_core_mask
+#include "spdk/thread.h"
+#include "spdk/cpuset.h"
+#include "spdk/string.h"
+#include "spdk/uuid.h"
+#include "spdk/vhost.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+// One vhost-user-blk controller and the vbdev it serves.
+typedef struct xsan_vhost_blk_ctrlr {
+    xsan_vhost_blk_controller_info_t info;
+    uint32_t core;          // Core it was pinned to, or UINT32_MAX if it got the whole mask
+    struct xsan_vhost_blk_ctrlr *next;
+} xsan_vhost_blk_ctrlr_t;
+
+static pthread_mutex_t g_xsan_vhost_blk_lock = PTHREAD_MUTEX_INITIALIZER;
+static xsan_vhost_blk_ctrlr_t *g_xsan_vhost_blk_head = NULL;
+static xsan_vhost_blk_opts_t g_xsan_vhost_blk_opts = { .spread_controllers = true };
+
+void xsan_vhost_blk_opts_init(xsan_vhost_blk_opts_t *opts) {
+    if (!opts) return;
+    memset(opts, 0, sizeof(*opts));
+    opts->spread_controllers = true;
+}
+
+xsan_error_t xsan_vhost_blk_set_opts(const xsan_vhost_blk_opts_t *opts) {
+    if (!opts) return XSAN_ERROR_INVALID_PARAM;
+    if (memchr(opts->cpumask, '\0', sizeof(opts->cpumask)) == NULL ||
+        memchr(opts->socket_dir, '\0', sizeof(opts->socket_dir)) == NULL) {
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+    if (opts->cpumask[0] != '\0') {
+        struct spdk_cpuset mask;
+        if (spdk_cpuset_parse(&mask, opts->cpumask) != 0 || spdk_cpuset_count(&mask) == 0) {
+            XSAN_LOG_ERROR("Invalid vhost-blk cpumask '%s'.", opts->cpumask);
+            return XSAN_ERROR_INVALID_PARAM;
+        }
+    }
+    if (opts->socket_dir[0] != '\0') {
+        struct stat st;
+        if (stat(opts->socket_dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+            XSAN_LOG_ERROR("vhost-blk socket directory '%s' does not exist.", opts->socket_dir);
+            return XSAN_ERROR_INVALID_PARAM;
+        }
+    }
+    pthread_mutex_lock(&g_xsan_vhost_blk_lock);
+    bool busy = g_xsan_vhost_blk_head != NULL;
+    pthread_mutex_unlock(&g_xsan_vhost_blk_lock);
+    if (busy) {
+        XSAN_LOG_ERROR("vhost-blk options must be set before the first controller is created.");
+        return XSAN_ERROR_BUSY;
+    }
+    if (opts->socket_dir[0] != '\0') {
+        int rc = spdk_vhost_set_socket_path(opts->socket_dir);
+        if (rc != 0) {
+            XSAN_LOG_ERROR("Cannot use '%s' for vhost-user sockets: %s", opts->socket_dir, spdk_strerror(-rc));
+            return XSAN_ERROR_INVALID_PARAM;
+        }
+    }
+    g_xsan_vhost_blk_opts = *opts;
+    return XSAN_OK;
+}
+
+static xsan_vhost_blk_ctrlr_t *_xsan_vhost_blk_find_locked(const char *name) {
+    for (xsan_vhost_blk_ctrlr_t *c = g_xsan_vhost_blk_head; c; c = c->next) {
+        if (strcmp(c->info.name, name) == 0) return c;
+    }
+    return NULL;
+}
+
+// Picks the core for a new controller: the reactor in the configured mask running the fewest
+// controllers, lowest core first. Returns UINT32_MAX and the whole mask when not spreading.
+static uint32_t _xsan_vhost_blk_pick_core(struct spdk_cpuset *mask) {
+    spdk_cpuset_copy(mask, spdk_app_get_core_mask());
+    if (g_xsan_vhost_blk_opts.cpumask[0] != '\0') {
+        struct spdk_cpuset wanted;
+        spdk_cpuset_parse(&wanted, g_xsan_vhost_blk_opts.cpumask); // Validated by set_opts
+        spdk_cpuset_and(mask, &wanted);
+    }
+    if (spdk_cpuset_count(mask) == 0) {
+        XSAN_LOG_WARN("vhost-blk cpumask '%s' has no reactor cores; using core %u.",
+                      g_xsan_vhost_blk_opts.cpumask, spdk_env_get_current_core());
+        spdk_cpuset_set_cpu(mask, spdk_env_get_current_core(), true);
+    }
+    if (!g_xsan_vhost_blk_opts.spread_controllers) return UINT32_MAX;
+
+    uint32_t best = UINT32_MAX, best_load = UINT32_MAX, core;
+    SPDK_ENV_FOREACH_CORE(core) {
+        if (!spdk_cpuset_get_cpu(mask, core)) continue;
+        uint32_t load = 0;
+        for (xsan_vhost_blk_ctrlr_t *c = g_xsan_vhost_blk_head; c; c = c->next) {
+            if (c->core == core) load++;
+        }
+        if (load < best_load) {
+            best = core;
+            best_load = load;
+        }
+    }
+    if (best != UINT32_MAX) {
+        spdk_cpuset_zero(mask);
+        spdk_cpuset_set_cpu(mask, best, true);
+    }
+    return best;
+}
+
+xsan_error_t xsan_vhost_blk_controller_create(xsan_volume_id_t volume_id, const char *ctrlr_name) {
+    if (spdk_get_thread() == NULL) return XSAN_ERROR_THREAD_CONTEXT;
+    if (spdk_uuid_is_null((struct spdk_uuid *)&volume_id.data[0])) return XSAN_ERROR_INVALID_PARAM;
+
+    xsan_vhost_blk_ctrlr_t *ctrlr = (xsan_vhost_blk_ctrlr_t *)XSAN_CALLOC(1, sizeof(xsan_vhost_blk_ctrlr_t));
+    if (!ctrlr) return XSAN_ERROR_NO_MEMORY;
+    xsan_vhost_blk_controller_info_t *info = &ctrlr->info;
+    if (ctrlr_name) {
+        if (ctrlr_name[0] == '\0' || strlen(ctrlr_name) >= sizeof(info->name)) {
+            XSAN_FREE(ctrlr);
+            return XSAN_ERROR_INVALID_PARAM;
+        }
+        xsan_strcpy_safe(info->name, ctrlr_name, sizeof(info->name));
+    } else {
+        char uuid_str[SPDK_UUID_STRING_LEN];
+        spdk_uuid_fmt_lower(uuid_str, sizeof(uuid_str), (struct spdk_uuid *)&volume_id.data[0]);
+        snprintf(info->name, sizeof(info->name), "%s%s", XSAN_VHOST_BLK_CTRLR_PREFIX, uuid_str);
+    }
+    snprintf(info->bdev_name, sizeof(info->bdev_name), "%s%s", XSAN_VHOST_BLK_BDEV_PREFIX, info->name);
+    memcpy(&info->volume_id, &volume_id, sizeof(volume_id));
+    const char *dir = g_xsan_vhost_blk_opts.socket_dir[0] != '\0' ? g_xsan_vhost_blk_opts.socket_dir : ".";
+    int len = snprintf(info->socket_path, sizeof(info->socket_path), "%s/%s", dir, info->name);
+    if (len < 0 || (size_t)len >= sizeof(((struct sockaddr_un *)0)->sun_path)) {
+        XSAN_LOG_ERROR("vhost-user socket path '%s' is too long.", info->socket_path);
+        XSAN_FREE(ctrlr);
+        return XSAN_ERROR_INVALID_PARAM;
+    }
+
+    // The list lock is held across the SPDK calls so two creates cannot take the same name or core.
+    pthread_mutex_lock(&g_xsan_vhost_blk_lock);
+    if (_xsan_vhost_blk_find_locked(info->name)) {
+        pthread_mutex_unlock(&g_xsan_vhost_blk_lock);
+        XSAN_FREE(ctrlr);
+        return XSAN_ERROR_ALREADY_EXISTS;
+    }
+    xsan_error_t err = xsan_vhost_expose_volume_as_vbdev(volume_id, info->bdev_name);
+    if (err != XSAN_OK) {
+        pthread_mutex_unlock(&g_xsan_vhost_blk_lock);
+        XSAN_LOG_ERROR("Cannot expose the volume of vhost-blk controller '%s' (error %d).", info->name, err);
+        XSAN_FREE(ctrlr);
+        return err == XSAN_ERROR_INVALID_NODE_STATE ? XSAN_ERROR_NOT_INITIALIZED : err;
+    }
+    struct spdk_cpuset mask;
+    ctrlr->core = _xsan_vhost_blk_pick_core(&mask);
+    snprintf(info->cpumask, sizeof(info->cpumask), "0x%s", spdk_cpuset_fmt(&mask));
+    int rc = spdk_vhost_blk_construct(info->name, info->cpumask, info->bdev_name, VIRTIO_BLK_DEFAULT_TRANSPORT, NULL);
+    if (rc != 0) {
+        pthread_mutex_unlock(&g_xsan_vhost_blk_lock);
+        XSAN_LOG_ERROR("Failed to start vhost-blk controller '%s' on %s: %s", info->name, info->cpumask, spdk_strerror(-rc));
+        xsan_vhost_unexpose_volume_vbdev(info->bdev_name);
+        XSAN_FREE(ctrlr);
+        return rc == -EEXIST ? XSAN_ERROR_ALREADY_EXISTS : XSAN_ERROR_SYSTEM;
+    }
+    ctrlr->next = g_xsan_vhost_blk_head;
+    g_xsan_vhost_blk_head = ctrlr;
+    pthread_mutex_unlock(&g_xsan_vhost_blk_lock);
+    XSAN_LOG_INFO("vhost-blk controller '%s' serves vbdev '%s' on cores %s at %s.",
+                  info->name, info->bdev_name, info->cpumask, info->socket_path);
+    return XSAN_OK;
+}
+
+// Removes the SPDK controller; the caller drops the record and the vbdev on success.
+static xsan_error_t _xsan_vhost_blk_remove(xsan_vhost_blk_ctrlr_t *ctrlr) {
+    int rc = -ENODEV;
+    spdk_vhost_lock();
+    struct spdk_vhost_dev *vdev = spdk_vhost_dev_find(ctrlr->info.name);
+    if (vdev) {
+        rc = spdk_vhost_dev_remove(vdev);
+    }
+    spdk_vhost_unlock();
+    if (rc == -EBUSY) {
+        XSAN_LOG_WARN("vhost-blk controller '%s' still has a guest connected.", ctrlr->info.name);
+        return XSAN_ERROR_BUSY;
+    }
+    if (rc != 0 && rc != -ENODEV) {
+        XSAN_LOG_ERROR("Failed to remove vhost-blk controller '%s': %s", ctrlr->info.name, spdk_strerror(-rc));
+        return XSAN_ERROR_SYSTEM;
+    }
+    // -ENODEV: SPDK's vhost subsystem already removed it (e.g. during shutdown); the vbdev is still ours.
+    xsan_vhost_unexpose_volume_vbdev(ctrlr->info.bdev_name);
+    XSAN_LOG_INFO("vhost-blk controller '%s' destroyed.", ctrlr->info.name);
+    return XSAN_OK;
+}
+
+xsan_error_t xsan_vhost_blk_controller_destroy(const char *ctrlr_name) {
+    if (spdk_get_thread() == NULL) return XSAN_ERROR_THREAD_CONTEXT;
+    if (!ctrlr_name) return XSAN_ERROR_INVALID_PARAM;
+    pthread_mutex_lock(&g_xsan_vhost_blk_lock);
+    xsan_vhost_blk_ctrlr_t **link = &g_xsan_vhost_blk_head;
+    while (*link && strcmp((*link)->info.name, ctrlr_name) != 0) link = &(*link)->next;
+    xsan_vhost_blk_ctrlr_t *ctrlr = *link;
+    if (!ctrlr) {
+        pthread_mutex_unlock(&g_xsan_vhost_blk_lock);
+        return XSAN_ERROR_NOT_FOUND;
+    }
+    xsan_error_t err = _xsan_vhost_blk_remove(ctrlr);
+    if (err == XSAN_OK) *link = ctrlr->next;
+    pthread_mutex_unlock(&g_xsan_vhost_blk_lock);
+    if (err == XSAN_OK) XSAN_FREE(ctrlr);
+    return err;
+}
+
+uint32_t xsan_vhost_blk_controller_destroy_all(void) {
+    uint32_t busy = 0;
+    pthread_mutex_lock(&g_xsan_vhost_blk_lock);
+    xsan_vhost_blk_ctrlr_t **link = &g_xsan_vhost_blk_head;
+    while (*link) {
+        xsan_vhost_blk_ctrlr_t *ctrlr = *link;
+        if (_xsan_vhost_blk_remove(ctrlr) != XSAN_OK) {
+            busy++;
+            link = &ctrlr->next;
+            continue;
+        }
+        *link = ctrlr->next;
+        XSAN_FREE(ctrlr);
+    }
+    pthread_mutex_unlock(&g_xsan_vhost_blk_lock);
+    return busy;
+}
+
+xsan_error_t xsan_vhost_blk_controller_get_info(const char *ctrlr_name, xsan_vhost_blk_controller_info_t *info) {
+    if (!ctrlr_name || !info) return XSAN_ERROR_INVALID_PARAM;
+    pthread_mutex_lock(&g_xsan_vhost_blk_lock);
+    xsan_vhost_blk_ctrlr_t *ctrlr = _xsan_vhost_blk_find_locked(ctrlr_name);
+    if (ctrlr) *info = ctrlr->info;
+    pthread_mutex_unlock(&g_xsan_vhost_blk_lock);
+    return ctrlr ? XSAN_OK : XSAN_ERROR_NOT_FOUND;
+}
@@ -0,0 +1,126 @@
+/*
+ * Metadata backends compared: time to open (and, for memlog, replay) a store holding N volume-sized
+ * records, and point-get latency on it. Not registered with CTest; run by hand:
+ *   ./xsan_bench_metadata_store [num_keys] [num_gets]
+ */
+#define _XOPEN_SOURCE 700
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "xsan_metadata_store.h"
+#include "xsan_memory.h"
+
+#define BENCH_VALUE_LEN 512 // About the size of a serialized volume record
+
+static double _now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int _cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static int _rm_entry(const char *path, const struct stat *sb, int flag, struct FTW *ftw) {
+    (void)sb; (void)flag; (void)ftw;
+    return remove(path);
+}
+
+static int _key(char *buf, size_t len, uint32_t i) {
+    return snprintf(buf, len, "v:%08x-0000-4000-8000-%012x", i * 2654435761u, i);
+}
+
+static int _bench_backend(xsan_metadata_backend_type_t backend, uint32_t num_keys, uint32_t num_gets) {
+    xsan_metadata_store_opts_t opts;
+    xsan_metadata_store_opts_init(&opts);
+    opts.backend = backend;
+    if (xsan_metadata_store_set_default_opts(&opts) != XSAN_OK) {
+        return 1;
+    }
+    char dir[] = "/tmp/xsan_bench_md_XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    char db_path[64];
+    snprintf(db_path, sizeof(db_path), "%s/db", dir);
+
+    xsan_metadata_store_t *store = xsan_metadata_store_open(db_path, true);
+    if (!store) {
+        fprintf(stderr, "Failed to create store at %s.\n", db_path);
+        return 1;
+    }
+    char key[64], value[BENCH_VALUE_LEN];
+    memset(value, 'x', sizeof(value));
+    xsan_metadata_batch_t *batch = xsan_metadata_store_batch_create(store);
+    for (uint32_t i = 0; batch && i < num_keys; ++i) {
+        int key_len = _key(key, sizeof(key), i);
+        xsan_metadata_store_batch_put(batch, key, (size_t)key_len, value, sizeof(value));
+        if (xsan_metadata_store_batch_count(batch) == 1000 || i + 1 == num_keys) {
+            xsan_metadata_store_batch_commit(store, batch);
+            xsan_metadata_store_batch_clear(batch);
+        }
+    }
+    xsan_metadata_store_batch_destroy(batch);
+    const char *name = xsan_metadata_store_backend_name(store);
+    xsan_metadata_store_close(store);
+
+    double start = _now_sec();
+    store = xsan_metadata_store_open(db_path, false);
+    double open_ms = (_now_sec() - start) * 1e3;
+    if (!store) {
+        fprintf(stderr, "Failed to reopen store at %s.\n", db_path);
+        return 1;
+    }
+
+    double *samples = (double *)XSAN_MALLOC(sizeof(double) * num_gets);
+    if (!samples) {
+        xsan_metadata_store_close(store);
+        return 1;
+    }
+    uint32_t misses = 0;
+    uint32_t rng = 12345;
+    for (uint32_t i = 0; i < num_gets; ++i) {
+        rng = rng * 1103515245u + 12345u;
+        int key_len = _key(key, sizeof(key), (rng >> 8) % num_keys);
+        char *out = NULL;
+        size_t out_len = 0;
+        double t0 = _now_sec();
+        xsan_error_t err = xsan_metadata_store_get(store, key, (size_t)key_len, &out, &out_len);
+        samples[i] = (_now_sec() - t0) * 1e6;
+        if (err == XSAN_OK) {
+            XSAN_FREE(out);
+        } else {
+            misses++;
+        }
+    }
+    xsan_metadata_store_close(store);
+
+    double total = 0;
+    for (uint32_t i = 0; i < num_gets; ++i) total += samples[i];
+    qsort(samples, num_gets, sizeof(double), _cmp_double);
+    printf("%-8s %10u %10.2f %10.2f %10.2f %10.2f %8u\n", name, num_keys, open_ms, total / num_gets,
+           samples[num_gets / 2], samples[(size_t)((double)num_gets * 0.99)], misses);
+    XSAN_FREE(samples);
+    nftw(dir, _rm_entry, 16, FTW_DEPTH | FTW_PHYS);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    uint32_t num_keys = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 10) : 10000;
+    uint32_t num_gets = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 10) : 200000;
+    if (num_keys == 0) num_keys = 10000;
+    if (num_gets == 0) num_gets = 200000;
+
+    printf("%-8s %10s %10s %10s %10s %10s %8s\n", "backend", "keys", "open ms", "get avg us", "p50 us", "p99 us", "misses");
+    if (_bench_backend(XSAN_METADATA_BACKEND_ROCKSDB, num_keys, num_gets) != 0 ||
+        _bench_backend(XSAN_METADATA_BACKEND_MEMLOG, num_keys, num_gets) != 0) {
+        return 1;
+    }
+    return 0;
+}
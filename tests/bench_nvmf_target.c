@@ -0,0 +1,408 @@
+/*
+ * NVMe-oF target over loopback TCP: starts the XSAN target in-process on a null bdev, connects SPDK's
+ * NVMe initiator to it with one I/O qpair per worker thread, and reports IOPS per qpair and in total.
+ * The target spreads the qpairs over its poll groups (one per core in the poll-group mask), so
+ * running with more cores and qpairs shows how the target scales. Not registered with CTest; needs
+ * hugepages and root. Run by hand:
+ *   ./xsan_bench_nvmf_target [reactor_mask] [qpairs] [queue_depth] [io_size] [seconds] [read|write] [zcopy]
+ * e.g. ./xsan_bench_nvmf_target 0xF 4 128 4096 10 read 1
+ * To drive a running xsan_node from a separate initiator process instead, use SPDK's perf tool:
+ *   spdk_nvme_perf -r 'trtype:TCP adrfam:IPv4 traddr:127.0.0.1 trsvcid:4420' -q 128 -o 4096 -w randread -t 10
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "xsan_nvmf_target.h"
+#include "xsan_spdk_manager.h"
+
+#include "spdk/stdinc.h"
+#include "spdk/env.h"
+#include "spdk/thread.h"
+#include "spdk/nvme.h"
+
+#define BENCH_BDEV_NAME "XsanBenchNull0"
+#define BENCH_BDEV_BLOCKS (1u << 20) // 4 GiB of 4 KiB blocks; a null bdev allocates no memory for them
+#define BENCH_NQN "nqn.2024-01.org.xsan:bench"
+#define BENCH_PORT "4430"
+#define BENCH_CONNECT_RETRIES 50
+
+typedef struct bench_worker bench_worker_t;
+
+typedef struct {
+    bench_worker_t *worker;
+    void *buf;
+} bench_io_t;
+
+struct bench_worker {
+    uint32_t index;
+    uint32_t core;
+    struct spdk_thread *thread;
+    struct spdk_nvme_qpair *qpair;
+    struct spdk_poller *poller;
+    bench_io_t *ios;
+    uint32_t outstanding;
+    uint64_t completed;
+    uint64_t errors;
+    uint64_t start_ticks;
+    uint64_t end_ticks;
+    uint32_t rng;
+};
+
+static struct {
+    const char *reactor_mask;
+    uint32_t num_qpairs;
+    uint32_t queue_depth;
+    uint32_t io_size;
+    uint32_t seconds;
+    bool write;
+    bool zcopy;
+
+    struct spdk_thread *main_thread;
+    struct spdk_poller *connect_poller;
+    struct spdk_poller *admin_poller;
+    struct spdk_poller *stop_timer;
+    struct spdk_nvme_probe_ctx *probe;
+    struct spdk_nvme_detach_ctx *detach;
+    struct spdk_nvme_ctrlr *ctrlr;
+    struct spdk_nvme_ns *ns;
+    uint32_t connect_attempts;
+    uint32_t lba_count;
+    uint64_t num_lbas;
+    uint32_t num_poll_groups;
+    uint64_t ticks_hz;
+
+    bench_worker_t *workers;
+    uint32_t workers_done;
+    volatile bool stop;
+    int rc;
+} g_bench;
+
+static void _bench_finish(int rc);
+
+static void _bench_submit(bench_io_t *io);
+
+static void _bench_io_done(void *arg, const struct spdk_nvme_cpl *cpl) {
+    bench_io_t *io = (bench_io_t *)arg;
+    bench_worker_t *w = io->worker;
+    w->outstanding--;
+    if (spdk_nvme_cpl_is_error(cpl)) {
+        w->errors++;
+    } else {
+        w->completed++;
+    }
+    if (!g_bench.stop) {
+        _bench_submit(io);
+    }
+}
+
+static void _bench_submit(bench_io_t *io) {
+    bench_worker_t *w = io->worker;
+    w->rng = w->rng * 1103515245u + 12345u;
+    uint64_t slots = g_bench.num_lbas / g_bench.lba_count;
+    uint64_t lba = ((uint64_t)(w->rng >> 4) % slots) * g_bench.lba_count;
+    int rc = g_bench.write
+        ? spdk_nvme_ns_cmd_write(g_bench.ns, w->qpair, io->buf, lba, g_bench.lba_count, _bench_io_done, io, 0)
+        : spdk_nvme_ns_cmd_read(g_bench.ns, w->qpair, io->buf, lba, g_bench.lba_count, _bench_io_done, io, 0);
+    if (rc != 0) {
+        w->errors++; // This slot stays idle for the rest of the run
+        return;
+    }
+    w->outstanding++;
+}
+
+static void _bench_worker_done_msg(void *arg) {
+    (void)arg;
+    if (++g_bench.workers_done == g_bench.num_qpairs) {
+        _bench_finish(g_bench.rc);
+    }
+}
+
+static void _bench_worker_release(bench_worker_t *w) {
+    spdk_poller_unregister(&w->poller);
+    if (w->qpair) {
+        spdk_nvme_ctrlr_free_io_qpair(w->qpair);
+        w->qpair = NULL;
+    }
+    for (uint32_t i = 0; w->ios && i < g_bench.queue_depth; ++i) {
+        spdk_dma_free(w->ios[i].buf);
+    }
+    free(w->ios);
+    w->ios = NULL;
+    spdk_thread_send_msg(g_bench.main_thread, _bench_worker_done_msg, w);
+    spdk_thread_exit(spdk_get_thread());
+}
+
+static int _bench_worker_poll(void *arg) {
+    bench_worker_t *w = (bench_worker_t *)arg;
+    int32_t rc = spdk_nvme_qpair_process_completions(w->qpair, 0);
+    if (rc < 0) {
+        fprintf(stderr, "qpair %u failed (%d).\n", w->index, rc);
+        g_bench.rc = 1;
+        g_bench.stop = true;
+    }
+    if (g_bench.stop && (w->outstanding == 0 || rc < 0)) {
+        w->end_ticks = spdk_get_ticks();
+        _bench_worker_release(w);
+        return SPDK_POLLER_BUSY;
+    }
+    return rc > 0 ? SPDK_POLLER_BUSY : SPDK_POLLER_IDLE;
+}
+
+static void _bench_worker_start_msg(void *arg) {
+    bench_worker_t *w = (bench_worker_t *)arg;
+    struct spdk_nvme_io_qpair_opts qopts;
+    spdk_nvme_ctrlr_get_default_io_qpair_opts(g_bench.ctrlr, &qopts, sizeof(qopts));
+    qopts.io_queue_size = g_bench.queue_depth + 1;
+    qopts.io_queue_requests = g_bench.queue_depth * 2;
+    qopts.async_mode = true; // Do not block this reactor while the target accepts the connection
+    w->qpair = spdk_nvme_ctrlr_alloc_io_qpair(g_bench.ctrlr, &qopts, sizeof(qopts));
+    w->ios = (bench_io_t *)calloc(g_bench.queue_depth, sizeof(bench_io_t));
+    if (!w->qpair || !w->ios) {
+        fprintf(stderr, "Worker %u: failed to allocate a qpair.\n", w->index);
+        g_bench.rc = 1;
+        g_bench.stop = true;
+        _bench_worker_release(w);
+        return;
+    }
+    for (uint32_t i = 0; i < g_bench.queue_depth; ++i) {
+        w->ios[i].worker = w;
+        w->ios[i].buf = spdk_dma_zmalloc(g_bench.io_size, 4096, NULL);
+        if (!w->ios[i].buf) {
+            fprintf(stderr, "Worker %u: out of DMA memory.\n", w->index);
+            g_bench.rc = 1;
+            g_bench.stop = true;
+            _bench_worker_release(w);
+            return;
+        }
+    }
+    w->rng = 12345u + w->index * 7919u;
+    w->poller = SPDK_POLLER_REGISTER(_bench_worker_poll, w, 0);
+    w->start_ticks = spdk_get_ticks();
+    for (uint32_t i = 0; i < g_bench.queue_depth; ++i) {
+        _bench_submit(&w->ios[i]);
+    }
+}
+
+static int _bench_stop_timer(void *arg) {
+    (void)arg;
+    spdk_poller_unregister(&g_bench.stop_timer);
+    g_bench.stop = true;
+    return SPDK_POLLER_BUSY;
+}
+
+static int _bench_admin_poll(void *arg) {
+    (void)arg;
+    spdk_nvme_ctrlr_process_admin_completions(g_bench.ctrlr);
+    return SPDK_POLLER_BUSY;
+}
+
+static void _bench_start_workers(void) {
+    g_bench.ns = spdk_nvme_ctrlr_get_ns(g_bench.ctrlr, 1);
+    if (!g_bench.ns || !spdk_nvme_ns_is_active(g_bench.ns)) {
+        fprintf(stderr, "Namespace 1 is not active.\n");
+        _bench_finish(1);
+        return;
+    }
+    uint32_t sector = spdk_nvme_ns_get_sector_size(g_bench.ns);
+    if (g_bench.io_size < sector || g_bench.io_size % sector != 0) {
+        fprintf(stderr, "I/O size %u is not a multiple of the %u-byte sector.\n", g_bench.io_size, sector);
+        _bench_finish(1);
+        return;
+    }
+    g_bench.lba_count = g_bench.io_size / sector;
+    g_bench.num_lbas = spdk_nvme_ns_get_num_sectors(g_bench.ns);
+    g_bench.admin_poller = SPDK_POLLER_REGISTER(_bench_admin_poll, NULL, 100000);
+
+    g_bench.workers = (bench_worker_t *)calloc(g_bench.num_qpairs, sizeof(bench_worker_t));
+    if (!g_bench.workers) {
+        _bench_finish(1);
+        return;
+    }
+    // Workers go round-robin over the reactor cores, the same cores as the target's poll groups.
+    uint32_t core = spdk_env_get_first_core();
+    for (uint32_t i = 0; i < g_bench.num_qpairs; ++i) {
+        bench_worker_t *w = &g_bench.workers[i];
+        struct spdk_cpuset mask;
+        char name[32];
+        w->index = i;
+        w->core = core;
+        spdk_cpuset_zero(&mask);
+        spdk_cpuset_set_cpu(&mask, core, true);
+        snprintf(name, sizeof(name), "bench_qpair_%u", i);
+        w->thread = spdk_thread_create(name, &mask);
+        if (!w->thread) {
+            fprintf(stderr, "Failed to create worker thread %u.\n", i);
+            g_bench.rc = 1;
+            g_bench.stop = true;
+            g_bench.workers_done++; // Nothing to wait for on this one
+            continue;
+        }
+        spdk_thread_send_msg(w->thread, _bench_worker_start_msg, w);
+        core = spdk_env_get_next_core(core);
+        if (core == UINT32_MAX) core = spdk_env_get_first_core();
+    }
+    if (g_bench.workers_done == g_bench.num_qpairs) {
+        _bench_finish(1);
+        return;
+    }
+    g_bench.stop_timer = SPDK_POLLER_REGISTER(_bench_stop_timer, NULL, (uint64_t)g_bench.seconds * 1000000);
+}
+
+static void _bench_attach_cb(void *cb_ctx, const struct spdk_nvme_transport_id *trid,
+                             struct spdk_nvme_ctrlr *ctrlr, const struct spdk_nvme_ctrlr_opts *opts) {
+    (void)cb_ctx; (void)trid; (void)opts;
+    g_bench.ctrlr = ctrlr;
+}
+
+// Connects asynchronously: the target's poll group on this core runs on this very thread.
+static int _bench_connect_poll(void *arg) {
+    (void)arg;
+    if (!g_bench.probe) {
+        struct spdk_nvme_transport_id trid;
+        struct spdk_nvme_ctrlr_opts opts;
+        memset(&trid, 0, sizeof(trid));
+        if (spdk_nvme_transport_id_parse(&trid, "trtype:TCP adrfam:IPv4 traddr:127.0.0.1 trsvcid:" BENCH_PORT
+                                                " subnqn:" BENCH_NQN) != 0) {
+            spdk_poller_unregister(&g_bench.connect_poller);
+            _bench_finish(1);
+            return SPDK_POLLER_BUSY;
+        }
+        spdk_nvme_ctrlr_get_default_ctrlr_opts(&opts, sizeof(opts));
+        opts.num_io_queues = g_bench.num_qpairs;
+        g_bench.probe = spdk_nvme_connect_async(&trid, &opts, _bench_attach_cb);
+        return SPDK_POLLER_BUSY;
+    }
+    if (spdk_nvme_probe_poll_async(g_bench.probe) == -EAGAIN) {
+        return SPDK_POLLER_BUSY;
+    }
+    g_bench.probe = NULL;
+    if (g_bench.ctrlr) {
+        spdk_poller_unregister(&g_bench.connect_poller);
+        _bench_start_workers();
+    } else if (++g_bench.connect_attempts >= BENCH_CONNECT_RETRIES) {
+        // The subsystem starts asynchronously, so the first attempts may be refused.
+        fprintf(stderr, "Could not connect to %s on 127.0.0.1:%s.\n", BENCH_NQN, BENCH_PORT);
+        spdk_poller_unregister(&g_bench.connect_poller);
+        _bench_finish(1);
+    }
+    return SPDK_POLLER_BUSY;
+}
+
+static int _bench_detach_poll(void *arg) {
+    (void)arg;
+    if (g_bench.detach && spdk_nvme_detach_poll_async(g_bench.detach) == -EAGAIN) {
+        return SPDK_POLLER_BUSY;
+    }
+    spdk_poller_unregister(&g_bench.admin_poller);
+    xsan_nvmf_target_fini();
+    xsan_spdk_manager_request_app_stop();
+    return SPDK_POLLER_BUSY;
+}
+
+static void _bench_finish(int rc) {
+    if (rc != 0) g_bench.rc = rc;
+    spdk_poller_unregister(&g_bench.stop_timer);
+    spdk_poller_unregister(&g_bench.admin_poller);
+    g_bench.detach = NULL;
+    if (g_bench.ctrlr) {
+        spdk_nvme_detach_async(g_bench.ctrlr, &g_bench.detach);
+        g_bench.ctrlr = NULL;
+    }
+    // Reuses the admin poller slot; the detach handshake needs the target's poll groups running.
+    g_bench.admin_poller = SPDK_POLLER_REGISTER(_bench_detach_poll, NULL, 1000);
+}
+
+static void _bench_start(void *arg, int rc) {
+    (void)arg;
+    if (rc != 0) {
+        fprintf(stderr, "SPDK failed to start (%d).\n", rc);
+        g_bench.rc = 1;
+        xsan_spdk_manager_request_app_stop();
+        return;
+    }
+    g_bench.main_thread = spdk_get_thread();
+    g_bench.ticks_hz = spdk_get_ticks_hz();
+
+    xsan_nvmf_target_opts_t opts;
+    xsan_nvmf_target_opts_init(&opts);
+    opts.max_queue_depth = g_bench.queue_depth + 1;
+    opts.max_qpairs_per_ctrlr = g_bench.num_qpairs + 1;
+    opts.zcopy_send = g_bench.zcopy;
+    if (xsan_nvmf_target_set_opts(&opts) != XSAN_OK ||
+        xsan_nvmf_target_init(BENCH_NQN, "127.0.0.1", BENCH_PORT) != XSAN_OK) {
+        g_bench.rc = 1;
+        xsan_spdk_manager_request_app_stop();
+        return;
+    }
+    g_bench.num_poll_groups = xsan_nvmf_target_get_poll_group_count();
+    if (xsan_nvmf_target_add_namespace(BENCH_BDEV_NAME, 1, NULL) != XSAN_OK) {
+        g_bench.rc = 1;
+        xsan_nvmf_target_fini();
+        xsan_spdk_manager_request_app_stop();
+        return;
+    }
+    g_bench.connect_poller = SPDK_POLLER_REGISTER(_bench_connect_poll, NULL, 100000);
+}
+
+static int _write_spdk_conf(char *path) {
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return -1;
+    }
+    FILE *f = fdopen(fd, "w");
+    if (!f) {
+        close(fd);
+        return -1;
+    }
+    fprintf(f, "{\"subsystems\": [{\"subsystem\": \"bdev\", \"config\": [{\"method\": \"bdev_null_create\", "
+               "\"params\": {\"name\": \"%s\", \"num_blocks\": %u, \"block_size\": 4096}}]}]}\n",
+            BENCH_BDEV_NAME, BENCH_BDEV_BLOCKS);
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+int main(int argc, char **argv) {
+    g_bench.reactor_mask = (argc > 1) ? argv[1] : "0xF";
+    g_bench.num_qpairs = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 10) : 4;
+    g_bench.queue_depth = (argc > 3) ? (uint32_t)strtoul(argv[3], NULL, 10) : 128;
+    g_bench.io_size = (argc > 4) ? (uint32_t)strtoul(argv[4], NULL, 10) : 4096;
+    g_bench.seconds = (argc > 5) ? (uint32_t)strtoul(argv[5], NULL, 10) : 10;
+    g_bench.write = (argc > 6) && strcmp(argv[6], "write") == 0;
+    g_bench.zcopy = (argc > 7) && strtoul(argv[7], NULL, 10) != 0;
+    if (g_bench.num_qpairs == 0) g_bench.num_qpairs = 4;
+    if (g_bench.queue_depth == 0) g_bench.queue_depth = 128;
+    if (g_bench.io_size == 0) g_bench.io_size = 4096;
+    if (g_bench.seconds == 0) g_bench.seconds = 10;
+
+    char conf_path[] = "/tmp/xsan_bench_nvmf_XXXXXX";
+    if (_write_spdk_conf(conf_path) != 0) {
+        return 1;
+    }
+    xsan_spdk_manager_opts_init("xsan_bench_nvmf", conf_path, g_bench.reactor_mask, false, NULL);
+    xsan_error_t err = xsan_spdk_manager_start_app(_bench_start, NULL);
+    xsan_spdk_manager_app_fini();
+    unlink(conf_path);
+    if (err != XSAN_OK) {
+        return 1;
+    }
+
+    printf("mask %s, %u poll group(s), %u qpair(s) x QD %u, %u-byte %s, %u s, zcopy %s\n",
+           g_bench.reactor_mask, g_bench.num_poll_groups, g_bench.num_qpairs, g_bench.queue_depth,
+           g_bench.io_size, g_bench.write ? "writes" : "reads", g_bench.seconds, g_bench.zcopy ? "on" : "off");
+    printf("%-6s %6s %12s %10s %8s\n", "qpair", "core", "IOPS", "MiB/s", "errors");
+    double total_iops = 0;
+    uint64_t hz = g_bench.ticks_hz;
+    for (uint32_t i = 0; g_bench.workers && i < g_bench.num_qpairs; ++i) {
+        bench_worker_t *w = &g_bench.workers[i];
+        double secs = (w->end_ticks > w->start_ticks) ? (double)(w->end_ticks - w->start_ticks) / (double)hz : 0;
+        double iops = secs > 0 ? (double)w->completed / secs : 0;
+        total_iops += iops;
+        printf("%-6u %6u %12.0f %10.1f %8" PRIu64 "\n", i, w->core, iops,
+               iops * g_bench.io_size / (1024.0 * 1024.0), w->errors);
+    }
+    printf("%-6s %6s %12.0f %10.1f\n", "total", "", total_iops, total_iops * g_bench.io_size / (1024.0 * 1024.0));
+    free(g_bench.workers);
+    return g_bench.rc;
+}
@@ -0,0 +1,52 @@
+/*
+ * Single-core throughput of message CRC32C (xsan_protocol_message_checksum).
+ * Prints GB/s for typical replica payload sizes. Not registered with CTest; run by hand:
+ *   ./xsan_bench_protocol_crc32c [seconds_per_size]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "xsan_protocol.h"
+
+static double _now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    double seconds = (argc > 1) ? atof(argv[1]) : 1.0;
+    if (seconds <= 0) seconds = 1.0;
+    static const uint32_t sizes[] = { 512, 4096, 65536, 1024 * 1024 };
+
+    printf("%-12s %14s %10s\n", "payload", "msgs/s", "GB/s");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        xsan_message_t *msg = xsan_protocol_message_create(XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_REQ, 1, NULL, sizes[i]);
+        if (!msg) {
+            fprintf(stderr, "Failed to allocate %u-byte message.\n", sizes[i]);
+            return 1;
+        }
+        for (uint32_t b = 0; b < sizes[i]; ++b) msg->payload[b] = (unsigned char)(b * 131u + 7u);
+
+        volatile uint32_t sink = 0;
+        uint64_t iters = 0;
+        double start = _now_sec();
+        double elapsed = 0;
+        do {
+            for (int k = 0; k < 64; ++k) {
+                msg->header.transaction_id = iters + (uint64_t)k; // Defeat any caching of the result
+                sink ^= xsan_protocol_message_checksum(&msg->header, msg->payload);
+            }
+            iters += 64;
+            elapsed = _now_sec() - start;
+        } while (elapsed < seconds);
+        (void)sink;
+
+        double bytes = (double)iters * (double)(sizes[i] + XSAN_MESSAGE_HEADER_SIZE);
+        printf("%-12u %14.0f %10.2f\n", sizes[i], (double)iters / elapsed, bytes / elapsed / 1e9);
+        xsan_protocol_message_destroy(msg);
+    }
+    return 0;
+}
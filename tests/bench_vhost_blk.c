@@ -0,0 +1,412 @@
+/*
+ * vhost-user-blk controllers: starts XSAN in-process on a null bdev, creates one volume and one
+ * vhost-blk controller per volume, checks the controller lifecycle (socket created, duplicate name
+ * refused, socket removed on destroy), and reports IOPS per virtqueue and in total. The guest is
+ * stood in for in-process: one thread per virtqueue, on the controller's reactor, submits through
+ * the controller's vbdev, which is the path a controller takes once it has pulled a request off a
+ * virtqueue. The shared-memory ring handling of a real guest is not included. With spread on, the
+ * controllers land on different reactors, so adding controllers shows how they scale over cores.
+ * Not registered with CTest; needs hugepages and root. Run by hand:
+ *   ./xsan_bench_vhost_blk [reactor_mask] [controllers] [queues] [queue_depth] [io_size] [seconds] [read|write] [spread]
+ * e.g. ./xsan_bench_vhost_blk 0xF 4 2 64 4096 10 read 1
+ * For end-to-end numbers, attach a controller of a running xsan_node to a guest and run fio in it:
+ *   qemu-system-x86_64 ... -object memory-backend-file,id=mem,size=4G,mem-path=/dev/hugepages,share=on \
+ *     -numa node,memdev=mem -chardev socket,id=c0,path=<socket_dir>/xsan_blk_<uuid> \
+ *     -device vhost-user-blk-pci,chardev=c0,num-queues=4
+ *   fio --filename=/dev/vda --direct=1 --ioengine=libaio --rw=randread --bs=4k --iodepth=32 --numjobs=4 \
+ *     --time_based --runtime=10 --group_reporting
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // nftw, alongside what the SPDK headers need
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ftw.h>
+#include <sys/stat.h>
+
+#include "xsan_vhost.h"
+#include "xsan_disk_manager.h"
+#include "xsan_volume_manager.h"
+#include "xsan_spdk_manager.h"
+
+#include "spdk/stdinc.h"
+#include "spdk/env.h"
+#include "spdk/thread.h"
+#include "spdk/bdev.h"
+
+#define BENCH_BDEV_NAME "XsanBenchNull0"
+#define BENCH_BDEV_BLOCKS (1u << 20) // 4 GiB of 4 KiB blocks; a null bdev allocates no memory for them
+#define BENCH_VOL_BYTES (256ull * 1024 * 1024)
+#define BENCH_MAX_CONTROLLERS 8
+
+typedef struct bench_worker bench_worker_t;
+
+typedef struct {
+    bench_worker_t *worker;
+    void *buf;
+} bench_io_t;
+
+// One virtqueue of a stand-in guest.
+struct bench_worker {
+    uint32_t ctrlr;
+    uint32_t queue;
+    char cpumask[64];
+    struct spdk_thread *thread;
+    struct spdk_bdev_desc *desc;
+    struct spdk_io_channel *ch;
+    bench_io_t *ios;
+    uint32_t outstanding;
+    uint64_t completed;
+    uint64_t errors;
+    uint64_t start_ticks;
+    uint64_t end_ticks;
+    uint32_t rng;
+};
+
+static struct {
+    const char *reactor_mask;
+    uint32_t num_ctrlrs;
+    uint32_t num_queues;
+    uint32_t queue_depth;
+    uint32_t io_size;
+    uint32_t seconds;
+    bool write;
+    bool spread;
+    char dir[64];
+
+    struct spdk_thread *main_thread;
+    struct spdk_poller *stop_timer;
+    xsan_disk_manager_t *dm;
+    xsan_volume_manager_t *vm;
+    bool vhost_up;
+    xsan_vhost_blk_controller_info_t ctrlrs[BENCH_MAX_CONTROLLERS];
+    uint32_t ctrlrs_created;
+    uint32_t blocks_per_io;
+    uint64_t ticks_hz;
+
+    bench_worker_t *workers;
+    uint32_t num_workers;
+    uint32_t workers_done;
+    volatile bool stop;
+    int rc;
+} g_bench;
+
+static void _bench_check(bool ok, const char *what) {
+    if (!ok) {
+        fprintf(stderr, "FAILED: %s\n", what);
+        g_bench.rc = 1;
+    }
+}
+
+static bool _bench_is_socket(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISSOCK(st.st_mode);
+}
+
+static void _bench_teardown(void) {
+    for (uint32_t i = 0; i < g_bench.ctrlrs_created; ++i) {
+        xsan_vhost_blk_controller_info_t *info = &g_bench.ctrlrs[i];
+        _bench_check(xsan_vhost_blk_controller_destroy(info->name) == XSAN_OK, "destroy controller");
+        _bench_check(!_bench_is_socket(info->socket_path), "socket removed on destroy");
+    }
+    _bench_check(xsan_vhost_blk_controller_destroy(g_bench.ctrlrs_created ? g_bench.ctrlrs[0].name : "none") ==
+                     XSAN_ERROR_NOT_FOUND, "destroying a destroyed controller is NOT_FOUND");
+    if (g_bench.vhost_up) xsan_vhost_subsystem_fini();
+    xsan_volume_manager_fini(&g_bench.vm);
+    xsan_disk_manager_fini(&g_bench.dm);
+    xsan_spdk_manager_request_app_stop();
+}
+
+static void _bench_worker_done_msg(void *arg) {
+    (void)arg;
+    if (++g_bench.workers_done == g_bench.num_workers) {
+        _bench_teardown();
+    }
+}
+
+static void _bench_worker_release(bench_worker_t *w) {
+    w->end_ticks = spdk_get_ticks();
+    if (w->ch) {
+        spdk_put_io_channel(w->ch);
+        w->ch = NULL;
+    }
+    if (w->desc) {
+        spdk_bdev_close(w->desc);
+        w->desc = NULL;
+    }
+    for (uint32_t i = 0; w->ios && i < g_bench.queue_depth; ++i) {
+        spdk_dma_free(w->ios[i].buf);
+    }
+    free(w->ios);
+    w->ios = NULL;
+    spdk_thread_send_msg(g_bench.main_thread, _bench_worker_done_msg, w);
+    spdk_thread_exit(spdk_get_thread());
+}
+
+static void _bench_submit(bench_io_t *io);
+
+static void _bench_io_done(struct spdk_bdev_io *bdev_io, bool success, void *arg) {
+    bench_io_t *io = (bench_io_t *)arg;
+    bench_worker_t *w = io->worker;
+    spdk_bdev_free_io(bdev_io);
+    w->outstanding--;
+    if (success) {
+        w->completed++;
+    } else {
+        w->errors++;
+    }
+    if (!g_bench.stop) {
+        _bench_submit(io);
+    } else if (w->outstanding == 0) {
+        _bench_worker_release(w);
+    }
+}
+
+static void _bench_submit(bench_io_t *io) {
+    bench_worker_t *w = io->worker;
+    uint64_t slots = spdk_bdev_get_num_blocks(spdk_bdev_desc_get_bdev(w->desc)) / g_bench.blocks_per_io;
+    w->rng = w->rng * 1103515245u + 12345u;
+    uint64_t block = ((uint64_t)(w->rng >> 4) % slots) * g_bench.blocks_per_io;
+    int rc = g_bench.write
+        ? spdk_bdev_write_blocks(w->desc, w->ch, io->buf, block, g_bench.blocks_per_io, _bench_io_done, io)
+        : spdk_bdev_read_blocks(w->desc, w->ch, io->buf, block, g_bench.blocks_per_io, _bench_io_done, io);
+    if (rc != 0) {
+        w->errors++; // This slot stays idle for the rest of the run
+        return;
+    }
+    w->outstanding++;
+}
+
+static void _bench_bdev_event_cb(enum spdk_bdev_event_type type, struct spdk_bdev *bdev, void *ctx) {
+    (void)type; (void)bdev; (void)ctx;
+}
+
+static void _bench_worker_start_msg(void *arg) {
+    bench_worker_t *w = (bench_worker_t *)arg;
+    const char *bdev_name = g_bench.ctrlrs[w->ctrlr].bdev_name;
+    if (spdk_bdev_open_ext(bdev_name, true, _bench_bdev_event_cb, NULL, &w->desc) != 0 ||
+        !(w->ch = spdk_bdev_get_io_channel(w->desc)) ||
+        !(w->ios = (bench_io_t *)calloc(g_bench.queue_depth, sizeof(bench_io_t)))) {
+        fprintf(stderr, "Queue %u/%u: cannot open '%s'.\n", w->ctrlr, w->queue, bdev_name);
+        g_bench.rc = 1;
+        g_bench.stop = true;
+        _bench_worker_release(w);
+        return;
+    }
+    size_t align = spdk_bdev_get_buf_align(spdk_bdev_desc_get_bdev(w->desc));
+    for (uint32_t i = 0; i < g_bench.queue_depth; ++i) {
+        w->ios[i].worker = w;
+        w->ios[i].buf = spdk_dma_zmalloc(g_bench.io_size, align > 4096 ? align : 4096, NULL);
+        if (!w->ios[i].buf) {
+            fprintf(stderr, "Queue %u/%u: out of DMA memory.\n", w->ctrlr, w->queue);
+            g_bench.rc = 1;
+            g_bench.stop = true;
+            _bench_worker_release(w);
+            return;
+        }
+    }
+    w->rng = 12345u + (w->ctrlr * g_bench.num_queues + w->queue) * 7919u;
+    w->start_ticks = spdk_get_ticks();
+    for (uint32_t i = 0; i < g_bench.queue_depth; ++i) {
+        _bench_submit(&w->ios[i]);
+    }
+    if (w->outstanding == 0) {
+        fprintf(stderr, "Queue %u/%u: no I/O could be submitted.\n", w->ctrlr, w->queue);
+        g_bench.rc = 1;
+        _bench_worker_release(w);
+    }
+}
+
+static int _bench_stop_timer(void *arg) {
+    (void)arg;
+    spdk_poller_unregister(&g_bench.stop_timer);
+    g_bench.stop = true;
+    return SPDK_POLLER_BUSY;
+}
+
+// Each virtqueue gets a thread on its controller's cores: SPDK polls all of a controller's
+// queues on the controller's thread, so they share its reactor the same way.
+static void _bench_start_workers(void) {
+    g_bench.num_workers = g_bench.num_ctrlrs * g_bench.num_queues;
+    g_bench.workers = (bench_worker_t *)calloc(g_bench.num_workers, sizeof(bench_worker_t));
+    if (!g_bench.workers) {
+        g_bench.rc = 1;
+        _bench_teardown();
+        return;
+    }
+    for (uint32_t i = 0; i < g_bench.num_workers; ++i) {
+        bench_worker_t *w = &g_bench.workers[i];
+        struct spdk_cpuset mask;
+        char name[32];
+        w->ctrlr = i / g_bench.num_queues;
+        w->queue = i % g_bench.num_queues;
+        snprintf(w->cpumask, sizeof(w->cpumask), "%s", g_bench.ctrlrs[w->ctrlr].cpumask);
+        spdk_cpuset_parse(&mask, w->cpumask);
+        snprintf(name, sizeof(name), "bench_vq_%u_%u", w->ctrlr, w->queue);
+        w->thread = spdk_thread_create(name, &mask);
+        if (!w->thread) {
+            fprintf(stderr, "Failed to create the thread of queue %u/%u.\n", w->ctrlr, w->queue);
+            g_bench.rc = 1;
+            g_bench.stop = true;
+            g_bench.workers_done++; // Nothing to wait for on this one
+            continue;
+        }
+        spdk_thread_send_msg(w->thread, _bench_worker_start_msg, w);
+    }
+    if (g_bench.workers_done == g_bench.num_workers) {
+        _bench_teardown();
+        return;
+    }
+    g_bench.stop_timer = SPDK_POLLER_REGISTER(_bench_stop_timer, NULL, (uint64_t)g_bench.seconds * 1000000);
+}
+
+static xsan_error_t _bench_create_controllers(void) {
+    const char *bdev_names[] = {BENCH_BDEV_NAME};
+    xsan_group_id_t dg_id;
+    xsan_error_t err = xsan_disk_manager_disk_group_create(g_bench.dm, "bench_dg", XSAN_DISK_GROUP_TYPE_JBOD,
+                                                           bdev_names, 1, &dg_id);
+    if (err != XSAN_OK) {
+        fprintf(stderr, "Cannot create a disk group on %s (error %d).\n", BENCH_BDEV_NAME, err);
+        return err;
+    }
+    for (uint32_t i = 0; i < g_bench.num_ctrlrs; ++i) {
+        char vol_name[32], ctrlr_name[32];
+        xsan_volume_id_t vol_id;
+        snprintf(vol_name, sizeof(vol_name), "bench_vol%u", i);
+        snprintf(ctrlr_name, sizeof(ctrlr_name), "xsan_bench_blk%u", i);
+        err = xsan_volume_create(g_bench.vm, vol_name, BENCH_VOL_BYTES, dg_id, 4096, false, 0, &vol_id);
+        if (err != XSAN_OK) {
+            fprintf(stderr, "Cannot create volume %s (error %d).\n", vol_name, err);
+            return err;
+        }
+        err = xsan_vhost_blk_controller_create(vol_id, ctrlr_name);
+        if (err != XSAN_OK) {
+            fprintf(stderr, "Cannot create controller %s (error %d).\n", ctrlr_name, err);
+            return err;
+        }
+        xsan_vhost_blk_controller_info_t *info = &g_bench.ctrlrs[g_bench.ctrlrs_created++];
+        _bench_check(xsan_vhost_blk_controller_get_info(ctrlr_name, info) == XSAN_OK, "controller info");
+        _bench_check(_bench_is_socket(info->socket_path), "vhost-user socket created");
+        if (i == 0) {
+            _bench_check(xsan_vhost_blk_controller_create(vol_id, ctrlr_name) == XSAN_ERROR_ALREADY_EXISTS,
+                         "duplicate controller name is ALREADY_EXISTS");
+        }
+    }
+    _bench_check(xsan_vhost_blk_set_opts(&(xsan_vhost_blk_opts_t){.spread_controllers = true}) == XSAN_ERROR_BUSY,
+                 "options are fixed once controllers exist");
+    return g_bench.rc == 0 ? XSAN_OK : XSAN_ERROR_GENERIC;
+}
+
+static void _bench_start(void *arg, int rc) {
+    (void)arg;
+    if (rc != 0) {
+        fprintf(stderr, "SPDK failed to start (%d).\n", rc);
+        g_bench.rc = 1;
+        xsan_spdk_manager_request_app_stop();
+        return;
+    }
+    g_bench.main_thread = spdk_get_thread();
+    g_bench.ticks_hz = spdk_get_ticks_hz();
+    g_bench.blocks_per_io = g_bench.io_size / 4096;
+
+    // The metadata stores open under the working directory, which main() made a scratch directory.
+    if (xsan_disk_manager_init(&g_bench.dm) != XSAN_OK ||
+        xsan_disk_manager_scan_and_register_bdevs(g_bench.dm) != XSAN_OK ||
+        xsan_volume_manager_init(g_bench.dm, &g_bench.vm) != XSAN_OK ||
+        xsan_vhost_subsystem_init(g_bench.vm) != XSAN_OK) {
+        g_bench.rc = 1;
+        _bench_teardown();
+        return;
+    }
+    g_bench.vhost_up = true;
+
+    xsan_vhost_blk_opts_t opts;
+    xsan_vhost_blk_opts_init(&opts);
+    snprintf(opts.cpumask, sizeof(opts.cpumask), "%s", g_bench.reactor_mask);
+    snprintf(opts.socket_dir, sizeof(opts.socket_dir), "%s", g_bench.dir);
+    opts.spread_controllers = g_bench.spread;
+    if (xsan_vhost_blk_set_opts(&opts) != XSAN_OK || _bench_create_controllers() != XSAN_OK) {
+        g_bench.rc = 1;
+        _bench_teardown();
+        return;
+    }
+    _bench_start_workers();
+}
+
+static int _write_spdk_conf(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror("fopen");
+        return -1;
+    }
+    fprintf(f, "{\"subsystems\": [{\"subsystem\": \"bdev\", \"config\": [{\"method\": \"bdev_null_create\", "
+               "\"params\": {\"name\": \"%s\", \"num_blocks\": %u, \"block_size\": 4096}}]}]}\n",
+            BENCH_BDEV_NAME, BENCH_BDEV_BLOCKS);
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+static int _rm_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw) {
+    (void)st; (void)flag; (void)ftw;
+    return remove(path);
+}
+
+int main(int argc, char **argv) {
+    g_bench.reactor_mask = (argc > 1) ? argv[1] : "0xF";
+    g_bench.num_ctrlrs = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 10) : 4;
+    g_bench.num_queues = (argc > 3) ? (uint32_t)strtoul(argv[3], NULL, 10) : 2;
+    g_bench.queue_depth = (argc > 4) ? (uint32_t)strtoul(argv[4], NULL, 10) : 64;
+    g_bench.io_size = (argc > 5) ? (uint32_t)strtoul(argv[5], NULL, 10) : 4096;
+    g_bench.seconds = (argc > 6) ? (uint32_t)strtoul(argv[6], NULL, 10) : 10;
+    g_bench.write = (argc > 7) && strcmp(argv[7], "write") == 0;
+    g_bench.spread = (argc > 8) ? strtoul(argv[8], NULL, 10) != 0 : true;
+    if (g_bench.num_ctrlrs == 0) g_bench.num_ctrlrs = 4;
+    if (g_bench.num_queues == 0) g_bench.num_queues = 2;
+    if (g_bench.queue_depth == 0) g_bench.queue_depth = 64;
+    if (g_bench.io_size == 0) g_bench.io_size = 4096;
+    if (g_bench.seconds == 0) g_bench.seconds = 10;
+    if (g_bench.num_ctrlrs > BENCH_MAX_CONTROLLERS || g_bench.io_size % 4096 != 0) {
+        fprintf(stderr, "Use at most %u controllers and a multiple of 4096 bytes per I/O.\n", BENCH_MAX_CONTROLLERS);
+        return 1;
+    }
+
+    // Sockets, the SPDK config and the node metadata all go to a scratch directory.
+    snprintf(g_bench.dir, sizeof(g_bench.dir), "/tmp/xsan_bench_vblk_XXXXXX");
+    if (!mkdtemp(g_bench.dir) || chdir(g_bench.dir) != 0) {
+        perror("mkdtemp");
+        return 1;
+    }
+    char conf_path[96];
+    snprintf(conf_path, sizeof(conf_path), "%s/spdk.json", g_bench.dir);
+    if (_write_spdk_conf(conf_path) != 0) {
+        return 1;
+    }
+    xsan_spdk_manager_opts_init("xsan_bench_vhost_blk", conf_path, g_bench.reactor_mask, false, NULL);
+    xsan_error_t err = xsan_spdk_manager_start_app(_bench_start, NULL);
+    xsan_spdk_manager_app_fini();
+    if (chdir("/") == 0) nftw(g_bench.dir, _rm_entry, 16, FTW_DEPTH | FTW_PHYS);
+    if (err != XSAN_OK) {
+        return 1;
+    }
+
+    printf("mask %s, %u controller(s) x %u queue(s) x QD %u, %u-byte %s, %u s, spread %s\n",
+           g_bench.reactor_mask, g_bench.num_ctrlrs, g_bench.num_queues, g_bench.queue_depth, g_bench.io_size,
+           g_bench.write ? "writes" : "reads", g_bench.seconds, g_bench.spread ? "on" : "off");
+    printf("%-16s %6s %8s %12s %10s %8s\n", "controller", "queue", "cores", "IOPS", "MiB/s", "errors");
+    double total_iops = 0;
+    uint64_t hz = g_bench.ticks_hz;
+    for (uint32_t i = 0; g_bench.workers && i < g_bench.num_workers; ++i) {
+        bench_worker_t *w = &g_bench.workers[i];
+        double secs = (w->end_ticks > w->start_ticks) ? (double)(w->end_ticks - w->start_ticks) / (double)hz : 0;
+        double iops = secs > 0 ? (double)w->completed / secs : 0;
+        total_iops += iops;
+        printf("%-16s %6u %8s %12.0f %10.1f %8" PRIu64 "\n", g_bench.ctrlrs[w->ctrlr].name, w->queue, w->cpumask,
+               iops, iops * g_bench.io_size / (1024.0 * 1024.0), w->errors);
+    }
+    printf("%-16s %6s %8s %12.0f %10.1f\n", "total", "", "", total_iops,
+           total_iops * g_bench.io_size / (1024.0 * 1024.0));
+    printf("lifecycle checks %s\n", g_bench.rc == 0 ? "passed" : "FAILED");
+    free(g_bench.workers);
+    return g_bench.rc;
+}
@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "CUnit/Basic.h"
+
+#include "xsan_comm_credit.h"
+
+#define TEST_RELEASE_THREADS 4
+#define TEST_RELEASES_PER_THREAD 1000
+
+void test_credit_rx_charge_held_until_release(void) {
+    xsan_comm_credit_acct_t *acct = xsan_comm_credit_acct_create();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(acct);
+    CU_ASSERT_EQUAL(acct->refs, 1);
+    xsan_comm_rx_credit_t credit = { NULL, 0 };
+
+    xsan_comm_credit_rx_charge(acct, 4096, &credit);
+    CU_ASSERT_PTR_EQUAL(credit.acct, acct);
+    CU_ASSERT_EQUAL(acct->refs, 2);
+    CU_ASSERT_EQUAL(acct->released_bytes, 0);
+    CU_ASSERT_EQUAL(acct->released_msgs, 0);
+
+    xsan_comm_credit_rx_release(&credit);
+    CU_ASSERT_PTR_NULL(credit.acct);
+    CU_ASSERT_EQUAL(acct->refs, 1);
+    CU_ASSERT_EQUAL(acct->released_bytes, 4096);
+    CU_ASSERT_EQUAL(acct->released_msgs, 1);
+
+    // A second release (e.g. a payload freed through two paths) gives nothing back twice.
+    xsan_comm_credit_rx_release(&credit);
+    CU_ASSERT_EQUAL(acct->released_bytes, 4096);
+    CU_ASSERT_EQUAL(acct->released_msgs, 1);
+    xsan_comm_credit_acct_put(acct);
+}
+
+void test_credit_rx_charge_without_holder_releases_at_once(void) {
+    xsan_comm_credit_acct_t *acct = xsan_comm_credit_acct_create();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(acct);
+
+    xsan_comm_credit_rx_charge(acct, 100, NULL);
+    xsan_comm_credit_rx_charge(acct, 0, NULL);
+    CU_ASSERT_EQUAL(acct->refs, 1);
+    CU_ASSERT_EQUAL(acct->released_bytes, 100);
+    CU_ASSERT_EQUAL(acct->released_msgs, 2);
+    xsan_comm_credit_acct_put(acct);
+}
+
+void test_credit_acct_outlives_connection(void) {
+    xsan_comm_credit_acct_t *acct = xsan_comm_credit_acct_create();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(acct);
+    xsan_comm_rx_credit_t a = { NULL, 0 }, b = { NULL, 0 };
+
+    xsan_comm_credit_rx_charge(acct, 10, &a);
+    xsan_comm_credit_rx_charge(acct, 20, &b);
+    xsan_comm_credit_acct_put(acct); // Connection closed; the two payloads keep the totals alive
+    CU_ASSERT_EQUAL(acct->refs, 2);
+    xsan_comm_credit_rx_release(&a);
+    CU_ASSERT_EQUAL(acct->released_bytes, 10);
+    xsan_comm_credit_rx_release(&b); // Frees the totals; a sanitizer build catches any later use
+    CU_ASSERT_PTR_NULL(b.acct);
+    xsan_comm_credit_acct_put(NULL);
+}
+
+void test_credit_grant_due_after_quarter_window(void) {
+    xsan_comm_credit_rx_t rx;
+    memset(&rx, 0, sizeof(rx));
+    rx.acct = xsan_comm_credit_acct_create();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(rx.acct);
+    rx.window_bytes = 1000;
+    rx.window_msgs = 8;
+    uint64_t bytes_limit = 0, msgs_limit = 0;
+    xsan_comm_rx_credit_t credit[4];
+    memset(credit, 0, sizeof(credit));
+
+    // The first grant opens the whole window.
+    CU_ASSERT_TRUE(xsan_comm_credit_rx_grant_due(&rx, &bytes_limit, &msgs_limit));
+    CU_ASSERT_EQUAL(bytes_limit, 1000);
+    CU_ASSERT_EQUAL(msgs_limit, 8);
+    xsan_comm_credit_rx_granted(&rx, bytes_limit, msgs_limit);
+    CU_ASSERT_FALSE(xsan_comm_credit_rx_grant_due(&rx, &bytes_limit, &msgs_limit));
+
+    // One message of 249 bytes released: below a quarter of both windows (250 bytes, 2 messages).
+    xsan_comm_credit_rx_charge(rx.acct, 249, &credit[0]);
+    xsan_comm_credit_rx_charge(rx.acct, 1, &credit[1]);
+    CU_ASSERT_FALSE(xsan_comm_credit_rx_grant_due(&rx, &bytes_limit, &msgs_limit)); // Held, not released
+    xsan_comm_credit_rx_release(&credit[0]);
+    CU_ASSERT_FALSE(xsan_comm_credit_rx_grant_due(&rx, &bytes_limit, &msgs_limit));
+
+    // A second message reaches a quarter of the message window even though it is tiny.
+    xsan_comm_credit_rx_release(&credit[1]);
+    CU_ASSERT_TRUE(xsan_comm_credit_rx_grant_due(&rx, &bytes_limit, &msgs_limit));
+    CU_ASSERT_EQUAL(bytes_limit, 1250);
+    CU_ASSERT_EQUAL(msgs_limit, 10);
+    xsan_comm_credit_rx_granted(&rx, bytes_limit, msgs_limit);
+
+    // A quarter of the byte window in one message is enough on its own.
+    xsan_comm_credit_rx_charge(rx.acct, 250, &credit[2]);
+    xsan_comm_credit_rx_release(&credit[2]);
+    CU_ASSERT_TRUE(xsan_comm_credit_rx_grant_due(&rx, &bytes_limit, &msgs_limit));
+    CU_ASSERT_EQUAL(bytes_limit, 1500);
+    CU_ASSERT_EQUAL(msgs_limit, 11);
+    xsan_comm_credit_acct_put(rx.acct);
+}
+
+void test_credit_grant_due_tiny_window(void) {
+    xsan_comm_credit_rx_t rx;
+    memset(&rx, 0, sizeof(rx));
+    rx.acct = xsan_comm_credit_acct_create();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(rx.acct);
+    rx.window_bytes = 3;
+    rx.window_msgs = 1;
+    uint64_t bytes_limit, msgs_limit;
+
+    CU_ASSERT_TRUE(xsan_comm_credit_rx_grant_due(&rx, &bytes_limit, &msgs_limit));
+    xsan_comm_credit_rx_granted(&rx, bytes_limit, msgs_limit);
+    // Windows under 4 round their step up to 1 rather than never granting again.
+    xsan_comm_credit_rx_charge(rx.acct, 0, NULL);
+    CU_ASSERT_TRUE(xsan_comm_credit_rx_grant_due(&rx, &bytes_limit, &msgs_limit));
+    CU_ASSERT_EQUAL(msgs_limit, 2);
+    xsan_comm_credit_acct_put(rx.acct);
+}
+
+void test_credit_tx_admits_within_grant(void) {
+    xsan_comm_credit_tx_t tx;
+    memset(&tx, 0, sizeof(tx));
+
+    CU_ASSERT_FALSE(xsan_comm_credit_tx_covers(&tx, 0)); // Nothing before the first grant
+    xsan_comm_credit_tx_apply_grant(&tx, 1000, 2);
+    CU_ASSERT_TRUE(xsan_comm_credit_tx_covers(&tx, 1000));
+    CU_ASSERT_FALSE(xsan_comm_credit_tx_covers(&tx, 1001));
+
+    xsan_comm_credit_tx_consume(&tx, 600);
+    CU_ASSERT_TRUE(xsan_comm_credit_tx_covers(&tx, 400));
+    CU_ASSERT_FALSE(xsan_comm_credit_tx_covers(&tx, 401));
+    xsan_comm_credit_tx_consume(&tx, 100);
+    CU_ASSERT_FALSE(xsan_comm_credit_tx_covers(&tx, 0)); // Message window exhausted, bytes left over
+    CU_ASSERT_EQUAL(tx.bytes, 700);
+    CU_ASSERT_EQUAL(tx.msgs, 2);
+
+    // A stale or reordered grant never takes back credit.
+    xsan_comm_credit_tx_apply_grant(&tx, 500, 1);
+    CU_ASSERT_EQUAL(tx.bytes_limit, 1000);
+    CU_ASSERT_EQUAL(tx.msgs_limit, 2);
+    xsan_comm_credit_tx_apply_grant(&tx, 900, 3);
+    CU_ASSERT_EQUAL(tx.bytes_limit, 1000);
+    CU_ASSERT_EQUAL(tx.msgs_limit, 3);
+    CU_ASSERT_TRUE(xsan_comm_credit_tx_covers(&tx, 300));
+}
+
+void test_credit_sender_and_receiver_agree(void) {
+    // A sender pushing 100-byte messages into a 1000-byte, 4-message window stalls until the
+    // receiver frees payloads and grants again, and never has more than the window outstanding.
+    xsan_comm_credit_tx_t tx;
+    xsan_comm_credit_rx_t rx;
+    memset(&tx, 0, sizeof(tx));
+    memset(&rx, 0, sizeof(rx));
+    rx.acct = xsan_comm_credit_acct_create();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(rx.acct);
+    rx.window_bytes = 1000;
+    rx.window_msgs = 4;
+    xsan_comm_rx_credit_t held[64];
+    memset(held, 0, sizeof(held));
+    uint64_t bytes_limit, msgs_limit;
+    int sent = 0, freed = 0;
+
+    CU_ASSERT_TRUE_FATAL(xsan_comm_credit_rx_grant_due(&rx, &bytes_limit, &msgs_limit));
+    xsan_comm_credit_rx_granted(&rx, bytes_limit, msgs_limit);
+    xsan_comm_credit_tx_apply_grant(&tx, bytes_limit, msgs_limit);
+
+    for (int round = 0; round < 16 && sent < 64; ++round) {
+        while (sent < 64 && xsan_comm_credit_tx_covers(&tx, 100)) {
+            xsan_comm_credit_tx_consume(&tx, 100);
+            xsan_comm_credit_rx_charge(rx.acct, 100, &held[sent]);
+            sent++;
+        }
+        CU_ASSERT_TRUE(sent - freed <= 4);
+        // Free the oldest payload; a grant goes out once a quarter of the window is back.
+        xsan_comm_credit_rx_release(&held[freed++]);
+        if (xsan_comm_credit_rx_grant_due(&rx, &bytes_limit, &msgs_limit)) {
+            xsan_comm_credit_rx_granted(&rx, bytes_limit, msgs_limit);
+            xsan_comm_credit_tx_apply_grant(&tx, bytes_limit, msgs_limit);
+        }
+    }
+    CU_ASSERT_EQUAL(sent, 4 + 15); // One new message admitted per freed one after the first window
+    CU_ASSERT_EQUAL(tx.msgs, (uint64_t)sent);
+    while (freed < sent) xsan_comm_credit_rx_release(&held[freed++]);
+    CU_ASSERT_EQUAL(rx.acct->released_msgs, (uint64_t)sent);
+    CU_ASSERT_EQUAL(rx.acct->released_bytes, (uint64_t)sent * 100);
+    CU_ASSERT_EQUAL(rx.acct->refs, 1);
+    xsan_comm_credit_acct_put(rx.acct);
+}
+
+static void *_release_thread(void *arg) {
+    xsan_comm_rx_credit_t *credits = (xsan_comm_rx_credit_t *)arg;
+    for (int i = 0; i < TEST_RELEASES_PER_THREAD; ++i) {
+        xsan_comm_credit_rx_release(&credits[i]);
+    }
+    return NULL;
+}
+
+void test_credit_release_from_many_threads(void) {
+    // Payloads are freed on whichever thread finished with them, after the connection is gone.
+    static xsan_comm_rx_credit_t credits[TEST_RELEASE_THREADS][TEST_RELEASES_PER_THREAD];
+    xsan_comm_credit_acct_t *acct = xsan_comm_credit_acct_create();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(acct);
+    for (int t = 0; t < TEST_RELEASE_THREADS; ++t) {
+        for (int i = 0; i < TEST_RELEASES_PER_THREAD; ++i) {
+            xsan_comm_credit_rx_charge(acct, 3, &credits[t][i]);
+        }
+    }
+    // Hold one payload back to read the totals once every thread is done.
+    xsan_comm_rx_credit_t last = { NULL, 0 };
+    xsan_comm_credit_rx_charge(acct, 1, &last);
+    xsan_comm_credit_acct_put(acct);
+
+    pthread_t threads[TEST_RELEASE_THREADS];
+    for (int t = 0; t < TEST_RELEASE_THREADS; ++t) {
+        CU_ASSERT_EQUAL_FATAL(pthread_create(&threads[t], NULL, _release_thread, credits[t]), 0);
+    }
+    for (int t = 0; t < TEST_RELEASE_THREADS; ++t) {
+        pthread_join(threads[t], NULL);
+    }
+    CU_ASSERT_EQUAL(acct->refs, 1);
+    CU_ASSERT_EQUAL(acct->released_msgs, TEST_RELEASE_THREADS * TEST_RELEASES_PER_THREAD);
+    CU_ASSERT_EQUAL(acct->released_bytes, 3 * TEST_RELEASE_THREADS * TEST_RELEASES_PER_THREAD);
+    xsan_comm_credit_rx_release(&last);
+}
+
+int main(void) {
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry()) {
+        return CU_get_error();
+    }
+
+    pSuite = CU_add_suite("Comm_Credit_Suite", NULL, NULL);
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    if ((NULL == CU_add_test(pSuite, "test_credit_rx_charge_held_until_release", test_credit_rx_charge_held_until_release)) ||
+        (NULL == CU_add_test(pSuite, "test_credit_rx_charge_without_holder_releases_at_once", test_credit_rx_charge_without_holder_releases_at_once)) ||
+        (NULL == CU_add_test(pSuite, "test_credit_acct_outlives_connection", test_credit_acct_outlives_connection)) ||
+        (NULL == CU_add_test(pSuite, "test_credit_grant_due_after_quarter_window", test_credit_grant_due_after_quarter_window)) ||
+        (NULL == CU_add_test(pSuite, "test_credit_grant_due_tiny_window", test_credit_grant_due_tiny_window)) ||
+        (NULL == CU_add_test(pSuite, "test_credit_tx_admits_within_grant", test_credit_tx_admits_within_grant)) ||
+        (NULL == CU_add_test(pSuite, "test_credit_sender_and_receiver_agree", test_credit_sender_and_receiver_agree)) ||
+        (NULL == CU_add_test(pSuite, "test_credit_release_from_many_threads", test_credit_release_from_many_threads))
+       ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+
+    int failures = CU_get_number_of_failures();
+    CU_cleanup_registry();
+
+    return failures > 0 ? 1 : 0;
+}
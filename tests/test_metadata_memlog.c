@@ -0,0 +1,367 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "CUnit/Basic.h"
+
+#include "xsan_metadata_store.h"
+#include "xsan_memory.h"
+#include "xsan_error.h"
+
+#define TEST_MEMLOG_FILE "xsan.memlog" // Log file name inside a memlog database directory
+
+static char g_db_dir[64];
+static char g_log_path[128];
+static char g_checkpoint_dir[128];
+
+static void _use_memlog(uint64_t compact_min_bytes, uint32_t compact_ratio) {
+    xsan_metadata_store_opts_t opts;
+    xsan_metadata_store_opts_init(&opts);
+    opts.backend = XSAN_METADATA_BACKEND_MEMLOG;
+    opts.memlog_compact_min_bytes = compact_min_bytes;
+    opts.memlog_compact_ratio = compact_ratio;
+    CU_ASSERT_EQUAL(xsan_metadata_store_set_default_opts(&opts), XSAN_OK);
+}
+
+static void _remove_db(const char *dir) {
+    char path[160];
+    snprintf(path, sizeof(path), "%s/%s", dir, TEST_MEMLOG_FILE);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/%s.tmp", dir, TEST_MEMLOG_FILE);
+    unlink(path);
+    rmdir(dir);
+}
+
+static void _reset_db(void) {
+    _remove_db(g_checkpoint_dir);
+    _remove_db(g_db_dir);
+}
+
+static off_t _log_size(void) {
+    struct stat st;
+    return stat(g_log_path, &st) == 0 ? st.st_size : -1;
+}
+
+// Reads one counter from the backend's statistics text ("memlog.<name>: <value>").
+static unsigned long long _stat(xsan_metadata_store_t *store, const char *name) {
+    char *stats = xsan_metadata_store_get_statistics(store);
+    unsigned long long value = ~0ULL;
+    if (stats) {
+        char needle[64];
+        snprintf(needle, sizeof(needle), "memlog.%s: ", name);
+        const char *p = strstr(stats, needle);
+        if (p) value = strtoull(p + strlen(needle), NULL, 10);
+        XSAN_FREE(stats);
+    }
+    return value;
+}
+
+static void _put_str(xsan_metadata_store_t *store, const char *key, const char *value) {
+    CU_ASSERT_EQUAL(xsan_metadata_store_put(store, key, strlen(key), value, strlen(value)), XSAN_OK);
+}
+
+static void _expect_value(xsan_metadata_store_t *store, const char *key, const char *expected) {
+    char *value = NULL;
+    size_t len = 0;
+    xsan_error_t err = xsan_metadata_store_get(store, key, strlen(key), &value, &len);
+    if (!expected) {
+        CU_ASSERT_EQUAL(err, XSAN_ERROR_NOT_FOUND);
+        return;
+    }
+    CU_ASSERT_EQUAL_FATAL(err, XSAN_OK);
+    CU_ASSERT_EQUAL(len, strlen(expected));
+    CU_ASSERT_STRING_EQUAL(value, expected);
+    XSAN_FREE(value);
+}
+
+int suite_memlog_init(void) {
+    snprintf(g_db_dir, sizeof(g_db_dir), "/tmp/xsan_memlog_test.XXXXXX");
+    if (!mkdtemp(g_db_dir)) return -1;
+    snprintf(g_log_path, sizeof(g_log_path), "%s/%s", g_db_dir, TEST_MEMLOG_FILE);
+    snprintf(g_checkpoint_dir, sizeof(g_checkpoint_dir), "%s.ckpt", g_db_dir);
+    return 0;
+}
+
+int suite_memlog_clean(void) {
+    _reset_db();
+    return 0;
+}
+
+void test_memlog_replay_restores_state(void) {
+    _reset_db();
+    _use_memlog(0, 0);
+    xsan_metadata_store_t *store = xsan_metadata_store_open(g_db_dir, true);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(store);
+    CU_ASSERT_STRING_EQUAL(xsan_metadata_store_backend_name(store), "memlog");
+
+    _put_str(store, "v:2", "vol-two");
+    _put_str(store, "v:1", "vol-one");
+    _put_str(store, "d:1", "disk-one");
+    _put_str(store, "v:3", "vol-three");
+    _put_str(store, "v:1", "vol-one-v2"); // Overwrite
+    CU_ASSERT_EQUAL(xsan_metadata_store_delete(store, "v:3", 3), XSAN_OK);
+
+    xsan_metadata_batch_t *batch = xsan_metadata_store_batch_create(store);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(batch);
+    CU_ASSERT_EQUAL(xsan_metadata_store_batch_put(batch, "g:1", 3, "group", 5), XSAN_OK);
+    CU_ASSERT_EQUAL(xsan_metadata_store_batch_delete(batch, "d:1", 3), XSAN_OK);
+    CU_ASSERT_EQUAL(xsan_metadata_store_batch_commit(store, batch), XSAN_OK);
+    xsan_metadata_store_batch_destroy(batch);
+    xsan_metadata_store_close(store);
+
+    store = xsan_metadata_store_open(g_db_dir, false);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(store);
+    CU_ASSERT_EQUAL(_stat(store, "replayed.records"), 7);
+    CU_ASSERT_EQUAL(_stat(store, "keys"), 3);
+    _expect_value(store, "v:1", "vol-one-v2");
+    _expect_value(store, "v:2", "vol-two");
+    _expect_value(store, "v:3", NULL);
+    _expect_value(store, "d:1", NULL);
+    _expect_value(store, "g:1", "group");
+
+    // The ordered index is rebuilt after replay: a prefix scan sees the volumes in key order.
+    xsan_metadata_iterator_t *it = xsan_metadata_iterator_create_prefix(store, "v:", 2);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(it);
+    const char *expected_keys[] = { "v:1", "v:2" };
+    int n = 0;
+    for (; xsan_metadata_iterator_is_valid(it); xsan_metadata_iterator_next(it), ++n) {
+        size_t klen = 0;
+        const char *key = xsan_metadata_iterator_key(it, &klen);
+        CU_ASSERT_FATAL(n < 2);
+        CU_ASSERT_TRUE(klen == 3 && memcmp(key, expected_keys[n], 3) == 0);
+    }
+    CU_ASSERT_EQUAL(n, 2);
+    xsan_metadata_iterator_destroy(it);
+    xsan_metadata_store_close(store);
+}
+
+void test_memlog_open_missing_without_create(void) {
+    _reset_db();
+    _use_memlog(0, 0);
+    CU_ASSERT_PTR_NULL(xsan_metadata_store_open(g_db_dir, false));
+}
+
+void test_memlog_truncates_torn_tail(void) {
+    _reset_db();
+    _use_memlog(0, 0);
+    xsan_metadata_store_t *store = xsan_metadata_store_open(g_db_dir, true);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(store);
+    _put_str(store, "v:1", "one");
+    _put_str(store, "v:2", "two");
+    off_t good_size = _log_size();
+    _put_str(store, "v:3", "three");
+    off_t full_size = _log_size();
+    xsan_metadata_store_close(store);
+    CU_ASSERT_FATAL(good_size > 0 && full_size > good_size);
+
+    // Cut the last record short, as a crash in the middle of an append would.
+    CU_ASSERT_EQUAL_FATAL(truncate(g_log_path, full_size - 2), 0);
+    store = xsan_metadata_store_open(g_db_dir, false);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(store);
+    CU_ASSERT_EQUAL(_stat(store, "replayed.records"), 2);
+    _expect_value(store, "v:1", "one");
+    _expect_value(store, "v:2", "two");
+    _expect_value(store, "v:3", NULL);
+    CU_ASSERT_EQUAL(_log_size(), good_size); // The torn bytes are gone, not left ahead of new records
+
+    // New commits land after the last good record and survive the next replay.
+    _put_str(store, "v:4", "four");
+    xsan_metadata_store_close(store);
+    store = xsan_metadata_store_open(g_db_dir, false);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(store);
+    CU_ASSERT_EQUAL(_stat(store, "replayed.records"), 3);
+    _expect_value(store, "v:4", "four");
+    xsan_metadata_store_close(store);
+}
+
+void test_memlog_stops_at_corrupt_record(void) {
+    _reset_db();
+    _use_memlog(0, 0);
+    xsan_metadata_store_t *store = xsan_metadata_store_open(g_db_dir, true);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(store);
+    _put_str(store, "v:1", "one");
+    off_t first_end = _log_size();
+    _put_str(store, "v:2", "two");
+    _put_str(store, "v:3", "three");
+    xsan_metadata_store_close(store);
+
+    // Flip the last byte of the second record's value: its checksum no longer matches, and
+    // nothing after it can be trusted either.
+    int fd = open(g_log_path, O_RDWR);
+    CU_ASSERT_FATAL(fd >= 0);
+    char c = 0;
+    off_t off = first_end + 12 + 4 + 10 + 3 + 2; // Record header, op count, op header, key, value[2]
+    CU_ASSERT_EQUAL(pread(fd, &c, 1, off), 1);
+    CU_ASSERT_EQUAL(c, 'o');
+    c ^= 0x20;
+    CU_ASSERT_EQUAL(pwrite(fd, &c, 1, off), 1);
+    close(fd);
+
+    store = xsan_metadata_store_open(g_db_dir, false);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(store);
+    CU_ASSERT_EQUAL(_stat(store, "replayed.records"), 1);
+    _expect_value(store, "v:1", "one");
+    _expect_value(store, "v:2", NULL);
+    _expect_value(store, "v:3", NULL);
+    CU_ASSERT_EQUAL(_log_size(), first_end);
+    xsan_metadata_store_close(store);
+}
+
+void test_memlog_compacts_superseded_records(void) {
+    _reset_db();
+    _use_memlog(1024, 2);
+    xsan_metadata_store_t *store = xsan_metadata_store_open(g_db_dir, true);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(store);
+    char value[32];
+    for (int i = 0; i < 500; ++i) {
+        snprintf(value, sizeof(value), "generation-%03d", i);
+        _put_str(store, "v:hot", value);
+    }
+    _put_str(store, "v:cold", "kept");
+
+    // 501 records of ~40 bytes each would be ~20 KiB; compaction keeps the log near the live data.
+    CU_ASSERT_TRUE(_stat(store, "compactions") > 0);
+    CU_ASSERT_TRUE(_log_size() < 4096);
+    CU_ASSERT_EQUAL((unsigned long long)_log_size(), _stat(store, "log.bytes"));
+    xsan_metadata_store_close(store);
+
+    store = xsan_metadata_store_open(g_db_dir, false);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(store);
+    _expect_value(store, "v:hot", "generation-499");
+    _expect_value(store, "v:cold", "kept");
+    CU_ASSERT_EQUAL(_stat(store, "keys"), 2);
+    xsan_metadata_store_close(store);
+}
+
+void test_memlog_no_compaction_below_threshold(void) {
+    _reset_db();
+    _use_memlog(1024 * 1024, 2);
+    xsan_metadata_store_t *store = xsan_metadata_store_open(g_db_dir, true);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(store);
+    for (int i = 0; i < 100; ++i) {
+        _put_str(store, "v:hot", "same");
+    }
+    CU_ASSERT_EQUAL(_stat(store, "compactions"), 0);
+    CU_ASSERT_EQUAL(_stat(store, "commits"), 100);
+    xsan_metadata_store_close(store);
+}
+
+void test_memlog_checkpoint_opens_as_database(void) {
+    _reset_db();
+    _use_memlog(0, 0);
+    xsan_metadata_store_t *store = xsan_metadata_store_open(g_db_dir, true);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(store);
+    _put_str(store, "v:1", "one");
+    _put_str(store, "v:1", "one-v2");
+    _put_str(store, "d:7", "disk");
+    CU_ASSERT_EQUAL(xsan_metadata_store_checkpoint(store, g_checkpoint_dir), XSAN_OK);
+    CU_ASSERT_EQUAL(xsan_metadata_store_checkpoint(store, g_checkpoint_dir), XSAN_ERROR_ALREADY_EXISTS);
+    _put_str(store, "v:2", "after"); // Not part of the checkpoint
+    xsan_metadata_store_close(store);
+
+    store = xsan_metadata_store_open(g_checkpoint_dir, false);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(store);
+    CU_ASSERT_EQUAL(_stat(store, "replayed.records"), 1); // Written compacted, as one record
+    _expect_value(store, "v:1", "one-v2");
+    _expect_value(store, "d:7", "disk");
+    _expect_value(store, "v:2", NULL);
+    xsan_metadata_store_close(store);
+}
+
+typedef struct {
+    int done_at; // Completion order, from 1
+    xsan_error_t status;
+} _async_done_t;
+
+static int g_async_seq;
+
+static void _async_done_cb(void *cb_arg, xsan_error_t status) {
+    _async_done_t *done = (_async_done_t *)cb_arg;
+    done->status = status;
+    done->done_at = __atomic_add_fetch(&g_async_seq, 1, __ATOMIC_SEQ_CST);
+}
+
+void test_memlog_async_multi_record_batch_is_barrier(void) {
+    _reset_db();
+    _use_memlog(0, 0);
+    xsan_metadata_store_t *store = xsan_metadata_store_open(g_db_dir, true);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(store);
+
+    // The records of one volume ("v:" and "volalloc:") are one record; two volumes are not.
+    xsan_metadata_batch_t *batch = xsan_metadata_store_batch_create(store);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(batch);
+    CU_ASSERT_EQUAL(xsan_metadata_store_batch_put(batch, "v:rec0", 6, "batch", 5), XSAN_OK);
+    CU_ASSERT_EQUAL(xsan_metadata_store_batch_put(batch, "volalloc:rec0", 13, "batch", 5), XSAN_OK);
+    CU_ASSERT_FALSE(batch->multi_record);
+    CU_ASSERT_EQUAL(xsan_metadata_store_batch_put(batch, "v:rec1", 6, "batch", 5), XSAN_OK);
+    CU_ASSERT_TRUE(batch->multi_record);
+
+    enum { NUM_RECORDS = 64 };
+    static _async_done_t before[NUM_RECORDS], after[NUM_RECORDS];
+    _async_done_t batch_done = { 0, XSAN_ERROR_GENERIC };
+    char key[32];
+    g_async_seq = 0;
+    CU_ASSERT_EQUAL_FATAL(xsan_metadata_async_init(4), XSAN_OK);
+    for (int i = 0; i < NUM_RECORDS; ++i) {
+        snprintf(key, sizeof(key), "v:rec%d", i);
+        CU_ASSERT_EQUAL(xsan_metadata_store_put_async(store, key, strlen(key), "before", 6, _async_done_cb, &before[i]), XSAN_OK);
+    }
+    CU_ASSERT_EQUAL(xsan_metadata_store_batch_commit_async(store, batch, _async_done_cb, &batch_done), XSAN_OK);
+    for (int i = 0; i < NUM_RECORDS; ++i) {
+        snprintf(key, sizeof(key), "v:rec%d", i);
+        CU_ASSERT_EQUAL(xsan_metadata_store_put_async(store, key, strlen(key), "after", 5, _async_done_cb, &after[i]), XSAN_OK);
+    }
+    xsan_metadata_async_fini(); // Runs everything queued
+
+    // Whatever worker a record maps to, the batch ran after every earlier write and before every later one.
+    CU_ASSERT_EQUAL(batch_done.status, XSAN_OK);
+    for (int i = 0; i < NUM_RECORDS; ++i) {
+        CU_ASSERT_EQUAL(before[i].status, XSAN_OK);
+        CU_ASSERT_EQUAL(after[i].status, XSAN_OK);
+        CU_ASSERT_TRUE(before[i].done_at < batch_done.done_at);
+        CU_ASSERT_TRUE(after[i].done_at > batch_done.done_at);
+    }
+    _expect_value(store, "v:rec0", "after");
+    _expect_value(store, "v:rec1", "after");
+    _expect_value(store, "volalloc:rec0", "batch");
+    xsan_metadata_store_close(store);
+}
+
+int main(void) {
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry()) {
+        return CU_get_error();
+    }
+
+    pSuite = CU_add_suite("Metadata_Memlog_Suite", suite_memlog_init, suite_memlog_clean);
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    if ((NULL == CU_add_test(pSuite, "test_memlog_replay_restores_state", test_memlog_replay_restores_state)) ||
+        (NULL == CU_add_test(pSuite, "test_memlog_open_missing_without_create", test_memlog_open_missing_without_create)) ||
+        (NULL == CU_add_test(pSuite, "test_memlog_truncates_torn_tail", test_memlog_truncates_torn_tail)) ||
+        (NULL == CU_add_test(pSuite, "test_memlog_stops_at_corrupt_record", test_memlog_stops_at_corrupt_record)) ||
+        (NULL == CU_add_test(pSuite, "test_memlog_compacts_superseded_records", test_memlog_compacts_superseded_records)) ||
+        (NULL == CU_add_test(pSuite, "test_memlog_no_compaction_below_threshold", test_memlog_no_compaction_below_threshold)) ||
+        (NULL == CU_add_test(pSuite, "test_memlog_checkpoint_opens_as_database", test_memlog_checkpoint_opens_as_database)) ||
+        (NULL == CU_add_test(pSuite, "test_memlog_async_multi_record_batch_is_barrier", test_memlog_async_multi_record_batch_is_barrier))
+       ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+
+    int failures = CU_get_number_of_failures();
+    CU_cleanup_registry();
+
+    return failures > 0 ? 1 : 0;
+}
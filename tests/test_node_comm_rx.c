@@ -0,0 +1,440 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <errno.h>
+#include <sys/uio.h>
+
+#include "CUnit/Basic.h"
+
+// The receive path is static to node comm, so the test compiles it in and stands in for the
+// SPDK calls it makes. Only the socket reads do anything; the rest are never reached here.
+#include "../src/network/xsan_node_comm.c"
+
+// --- SPDK stand-ins ---
+
+// A socket reading from a prepared byte stream. Every read returns a random number of bytes, and
+// some fail with EAGAIN while data is left, so headers and payloads are split at arbitrary points.
+struct spdk_sock {
+    unsigned char *in;
+    size_t in_len;
+    size_t in_cap;
+    size_t in_pos;
+    size_t max_chunk;
+    bool closed;
+};
+
+struct spdk_sock_group { int unused; };
+struct spdk_poller { int unused; };
+
+static struct spdk_sock g_sock;
+
+ssize_t spdk_sock_readv(struct spdk_sock *sock, struct iovec *iov, int iovcnt) {
+    if (sock->in_pos >= sock->in_len || rand() % 8 == 0) { errno = EAGAIN; return -1; }
+    size_t limit = 1 + (size_t)rand() % sock->max_chunk, total = 0;
+    for (int i = 0; i < iovcnt && limit > 0; ++i) {
+        size_t n = iov[i].iov_len < limit ? iov[i].iov_len : limit;
+        if (n > sock->in_len - sock->in_pos) n = sock->in_len - sock->in_pos;
+        memcpy(iov[i].iov_base, sock->in + sock->in_pos, n);
+        sock->in_pos += n;
+        total += n;
+        limit -= n;
+        if (n < iov[i].iov_len) break;
+    }
+    if (total == 0) { errno = EAGAIN; return -1; }
+    return (ssize_t)total;
+}
+
+ssize_t spdk_sock_recv(struct spdk_sock *sock, void *buf, size_t len) {
+    struct iovec iov = { buf, len };
+    return spdk_sock_readv(sock, &iov, 1);
+}
+
+int spdk_sock_close(struct spdk_sock **sock) { (*sock)->closed = true; *sock = NULL; return 0; }
+
+int spdk_sock_get_peer_addr(struct spdk_sock *sock, char *host, int len, uint16_t *port) {
+    (void)sock; snprintf(host, (size_t)len, "192.0.2.1"); *port = 7000; return 0;
+}
+
+ssize_t spdk_sock_writev(struct spdk_sock *sock, struct iovec *iov, int iovcnt) { (void)sock; (void)iov; (void)iovcnt; errno = EAGAIN; return -1; }
+struct spdk_sock *spdk_sock_listen_ext(const char *ip, int port, const char *impl, struct spdk_sock_opts *opts) { (void)ip; (void)port; (void)impl; (void)opts; return NULL; }
+struct spdk_sock *spdk_sock_connect_ext(const char *ip, int port, const char *impl, struct spdk_sock_opts *opts) { (void)ip; (void)port; (void)impl; (void)opts; return NULL; }
+struct spdk_sock *spdk_sock_accept(struct spdk_sock *sock) { (void)sock; errno = EAGAIN; return NULL; }
+void *spdk_sock_get_cb_arg(struct spdk_sock *sock) { (void)sock; return NULL; }
+struct spdk_sock_group *spdk_sock_group_create(void *ctx) { (void)ctx; return NULL; }
+int spdk_sock_group_add_sock(struct spdk_sock_group *group, struct spdk_sock *sock, spdk_sock_cb cb_fn, void *cb_arg) { (void)group; (void)sock; (void)cb_fn; (void)cb_arg; return -1; }
+int spdk_sock_group_remove_sock(struct spdk_sock_group *group, struct spdk_sock *sock) { (void)group; (void)sock; return 0; }
+int spdk_sock_group_poll(struct spdk_sock_group *group) { (void)group; return 0; }
+int spdk_sock_group_close(struct spdk_sock_group **group) { *group = NULL; return 0; }
+
+void *spdk_dma_malloc(size_t size, size_t align, uint64_t *phys_addr) {
+    (void)phys_addr;
+    void *buf = NULL;
+    return posix_memalign(&buf, align, size) == 0 ? buf : NULL;
+}
+void spdk_dma_free(void *buf) { free(buf); }
+uint32_t spdk_env_get_current_core(void) { return 0; }
+uint64_t spdk_get_ticks(void) { return 0; }
+uint64_t spdk_get_ticks_hz(void) { return 1000000; }
+struct spdk_thread *spdk_get_thread(void) { return NULL; }
+int spdk_thread_send_msg(const struct spdk_thread *thread, spdk_msg_fn fn, void *ctx) { (void)thread; (void)fn; (void)ctx; return -1; }
+void spdk_for_each_thread(spdk_msg_fn fn, void *ctx, spdk_msg_fn cpl) { (void)fn; cpl(ctx); }
+struct spdk_poller *spdk_poller_register_named(spdk_poller_fn fn, void *arg, uint64_t period_us, const char *name) { (void)fn; (void)arg; (void)period_us; (void)name; return NULL; }
+void spdk_poller_unregister(struct spdk_poller **poller) { *poller = NULL; }
+
+// Bitwise CRC32C (Castagnoli, reflected), standing in for SPDK's.
+uint32_t spdk_crc32c_update(const void *buf, size_t len, uint32_t crc) {
+    const unsigned char *p = (const unsigned char *)buf;
+    while (len--) {
+        crc ^= *p++;
+        for (int k = 0; k < 8; ++k) crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1u)));
+    }
+    return crc;
+}
+
+// --- Stream construction and delivery checks ---
+
+#define TEST_MAX_MSGS 4096
+
+typedef struct {
+    uint16_t type;
+    uint64_t tid;
+    uint32_t len;
+} expected_msg_t;
+
+static expected_msg_t g_expected[TEST_MAX_MSGS];
+static uint32_t g_num_expected;     // Messages written to the stream that must arrive
+static uint32_t g_num_delivered;
+static uint64_t g_bytes_delivered;
+static uint32_t g_num_bad;          // Deliveries out of order or with wrong contents
+static uint32_t g_num_misaligned;   // DMA payloads whose block data is not 4K aligned
+static uint32_t g_num_dma;
+static xsan_comm_reactor_t g_reactor;
+
+static unsigned char _pattern_byte(uint64_t tid, uint32_t i) {
+    return (unsigned char)(tid * 131 + i * 7 + (i >> 8));
+}
+
+static void _stream_append(const void *data, size_t len) {
+    if (g_sock.in_len + len > g_sock.in_cap) {
+        size_t cap = g_sock.in_cap ? g_sock.in_cap : 1 << 20;
+        while (cap < g_sock.in_len + len) cap *= 2;
+        g_sock.in = (unsigned char *)realloc(g_sock.in, cap);
+        g_sock.in_cap = cap;
+    }
+    memcpy(g_sock.in + g_sock.in_len, data, len);
+    g_sock.in_len += len;
+}
+
+static unsigned char *_make_payload(uint64_t tid, uint32_t len) {
+    unsigned char *payload = (unsigned char *)malloc(len ? len : 1);
+    for (uint32_t i = 0; i < len; ++i) payload[i] = _pattern_byte(tid, i);
+    return payload;
+}
+
+static void _header_init(xsan_message_header_t *header, uint16_t type, uint64_t tid, uint32_t len) {
+    memset(header, 0, sizeof(*header));
+    header->magic = XSAN_PROTOCOL_MAGIC;
+    header->type = type;
+    header->version = XSAN_PROTOCOL_VERSION_1;
+    header->payload_length = len;
+    header->transaction_id = tid;
+}
+
+// Random message: mostly small, some spanning several ring fills, some past the pooled buffer size.
+// Replica block messages carry their fixed part plus whole blocks.
+static void _random_msg(uint16_t *type, uint32_t *len) {
+    static const uint16_t types[] = { XSAN_MSG_TYPE_HEARTBEAT, XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_REQ,
+                                      XSAN_MSG_TYPE_REPLICA_READ_BLOCK_RESP };
+    *type = types[rand() % 3];
+    uint32_t data_off = xsan_protocol_payload_data_offset((xsan_message_type_t)*type);
+    int r = rand() % 10;
+    if (data_off) {
+        uint32_t blocks = (r < 6) ? (uint32_t)(rand() % 3) : (r < 9) ? 1 + (uint32_t)(rand() % 16) : 33 + (uint32_t)(rand() % 32);
+        *len = data_off + blocks * 4096;
+    } else {
+        *len = (r < 6) ? (uint32_t)(rand() % 300) : (r < 9) ? (uint32_t)(rand() % 20000) : 60000 + (uint32_t)(rand() % 150000);
+    }
+}
+
+static void _expect(uint16_t type, uint64_t tid, uint32_t len) {
+    g_expected[g_num_expected].type = type;
+    g_expected[g_num_expected].tid = tid;
+    g_expected[g_num_expected].len = len;
+    g_num_expected++;
+}
+
+// Appends one v1 message; checksummed messages can be corrupted after the checksum is taken.
+static void _append_v1(uint16_t type, uint64_t tid, uint32_t len, bool checksum, bool corrupt) {
+    xsan_message_header_t header;
+    unsigned char hdr_buf[XSAN_MESSAGE_HEADER_SIZE];
+    unsigned char *payload = _make_payload(tid, len);
+    _header_init(&header, type, tid, len);
+    if (checksum) header.checksum = xsan_protocol_message_checksum(&header, payload);
+    if (corrupt) payload[len / 2] ^= 0x01;
+    xsan_protocol_header_serialize(&header, hdr_buf);
+    _stream_append(hdr_buf, sizeof(hdr_buf));
+    _stream_append(payload, len);
+    free(payload);
+}
+
+// Appends one v2 frame of num_msgs random messages, checksummed (and possibly corrupted) or not.
+static void _append_v2_frame(uint64_t *next_tid, uint16_t num_msgs, bool checksum, bool corrupt, bool expected) {
+    unsigned char *body = NULL;
+    size_t body_len = 0;
+    for (uint16_t i = 0; i < num_msgs; ++i) {
+        uint16_t type;
+        uint32_t len;
+        uint64_t tid = (*next_tid)++;
+        _random_msg(&type, &len);
+        xsan_message_header_t header;
+        _header_init(&header, type, tid, len);
+        unsigned char *payload = _make_payload(tid, len);
+        body = (unsigned char *)realloc(body, body_len + XSAN_PROTOCOL_V2_MSG_HEADER_SIZE + len);
+        xsan_protocol_v2_msg_header_encode(&header, 0, body + body_len);
+        memcpy(body + body_len + XSAN_PROTOCOL_V2_MSG_HEADER_SIZE, payload, len);
+        body_len += XSAN_PROTOCOL_V2_MSG_HEADER_SIZE + len;
+        free(payload);
+        if (expected) _expect(type, tid, len);
+    }
+    xsan_protocol_v2_frame_header_t frame;
+    unsigned char frame_buf[XSAN_PROTOCOL_V2_FRAME_HEADER_SIZE];
+    memset(&frame, 0, sizeof(frame));
+    frame.magic = XSAN_PROTOCOL_V2_FRAME_MAGIC;
+    frame.num_msgs = num_msgs;
+    frame.frame_length = (uint32_t)body_len;
+    if (checksum) {
+        xsan_protocol_v2_frame_header_encode(&frame, frame_buf);
+        uint32_t crc = xsan_protocol_crc32c_update(XSAN_PROTOCOL_CRC32C_INIT, frame_buf, sizeof(frame_buf));
+        crc = xsan_protocol_crc32c_update(crc, body, body_len);
+        frame.checksum = xsan_protocol_crc32c_final(crc);
+        if (corrupt) body[body_len - 1] ^= 0x80;
+    }
+    xsan_protocol_v2_frame_header_encode(&frame, frame_buf);
+    _stream_append(frame_buf, sizeof(frame_buf));
+    _stream_append(body, body_len);
+    free(body);
+}
+
+static void _check_msg(xsan_message_t *msg) {
+    const xsan_message_header_t *h = &msg->header;
+    bool ok = g_num_delivered < g_num_expected;
+    if (ok) {
+        const expected_msg_t *e = &g_expected[g_num_delivered];
+        ok = h->type == e->type && h->transaction_id == e->tid && h->payload_length == e->len &&
+             (h->payload_length == 0 || msg->payload != NULL);
+        for (uint32_t i = 0; ok && i < h->payload_length; ++i) ok = msg->payload[i] == _pattern_byte(h->transaction_id, i);
+    }
+    if (!ok) g_num_bad++;
+    uint32_t data_off = xsan_protocol_payload_data_offset((xsan_message_type_t)h->type);
+    if (data_off) {
+        g_num_dma += msg->payload_is_dma;
+        if (!msg->payload_is_dma || ((uintptr_t)(msg->payload + data_off) % XSAN_COMM_RX_DATA_ALIGN) != 0) g_num_misaligned++;
+    }
+    g_num_delivered++;
+    g_bytes_delivered += h->payload_length;
+    xsan_protocol_message_destroy(msg);
+}
+
+static void _specific_handler(struct xsan_connection_ctx *conn_ctx, xsan_message_t *msg, void *arg) {
+    (void)conn_ctx; (void)arg;
+    _check_msg(msg);
+}
+
+static void _generic_handler(struct spdk_sock *sock, const char *peer_addr_str, xsan_message_t *msg, void *arg) {
+    (void)sock; (void)peer_addr_str; (void)arg;
+    _check_msg(msg);
+}
+
+static xsan_connection_ctx_t *_connect(size_t max_chunk) {
+    free(g_sock.in);
+    memset(&g_sock, 0, sizeof(g_sock));
+    g_sock.max_chunk = max_chunk;
+    g_num_expected = g_num_delivered = g_num_bad = g_num_misaligned = g_num_dma = 0;
+    g_bytes_delivered = 0;
+    xsan_connection_ctx_t *conn = _create_connection_ctx(&g_reactor, &g_sock, _generic_handler, NULL);
+    if (conn) _add_connection_to_active_list(conn);
+    return conn;
+}
+
+// Runs the receive path as the sock group would, until the stream is consumed or the connection closed.
+static void _receive_all(xsan_connection_ctx_t *conn) {
+    while (!g_sock.closed && g_sock.in_pos < g_sock.in_len) _process_received_data_for_connection(conn);
+}
+
+static void _disconnect(xsan_connection_ctx_t *conn) {
+    if (g_sock.closed) return; // The receive path closed and freed it
+    _remove_connection_from_active_list(conn);
+    _cleanup_and_free_connection_ctx(conn, true);
+}
+
+// --- Tests ---
+
+void test_rx_v1_split_reads(void) {
+    xsan_connection_ctx_t *conn = _connect(9000);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(conn);
+    conn->flow_control = true; // Credit travels with each payload until the handler frees it
+
+    uint64_t tid = 1, bytes = 0;
+    for (int i = 0; i < 2000; ++i) {
+        uint16_t type;
+        uint32_t len;
+        _random_msg(&type, &len);
+        _append_v1(type, tid, len, rand() % 2 == 0, false);
+        _expect(type, tid++, len);
+        bytes += len;
+    }
+    _receive_all(conn);
+
+    CU_ASSERT_FALSE(g_sock.closed);
+    CU_ASSERT_EQUAL(g_num_delivered, g_num_expected);
+    CU_ASSERT_EQUAL(g_num_bad, 0);
+    CU_ASSERT_EQUAL(g_num_misaligned, 0);
+    CU_ASSERT_TRUE(g_num_dma > 0);
+    CU_ASSERT_EQUAL(g_bytes_delivered, bytes);
+    // Every payload was freed by its handler, so all of its credit came back.
+    CU_ASSERT_EQUAL(conn->rx_credit.acct->released_msgs, g_num_expected);
+    CU_ASSERT_EQUAL(conn->rx_credit.acct->released_bytes, bytes);
+    CU_ASSERT_EQUAL(conn->rx_state, XSAN_COMM_RX_HEADER);
+    CU_ASSERT_EQUAL(_xsan_comm_rx_ring_used(conn), 0);
+    _disconnect(conn);
+    CU_ASSERT_EQUAL(g_reactor.num_connections, 0);
+}
+
+void test_rx_single_byte_reads(void) {
+    xsan_connection_ctx_t *conn = _connect(1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(conn);
+
+    uint64_t tid = 1;
+    for (int i = 0; i < 40; ++i) {
+        uint16_t type = (i % 2) ? XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_REQ : XSAN_MSG_TYPE_HEARTBEAT;
+        uint32_t len = (i % 2) ? (uint32_t)XSAN_REPLICA_WRITE_REQ_PAYLOAD_SIZE + 4096 : (uint32_t)(i * 5);
+        _append_v1(type, tid, len, true, false);
+        _expect(type, tid++, len);
+    }
+    _append_v2_frame(&tid, 3, true, false, true);
+    _receive_all(conn);
+
+    CU_ASSERT_FALSE(g_sock.closed);
+    CU_ASSERT_EQUAL(g_num_delivered, g_num_expected);
+    CU_ASSERT_EQUAL(g_num_bad, 0);
+    CU_ASSERT_EQUAL(g_num_misaligned, 0);
+    _disconnect(conn);
+}
+
+void test_rx_v1_and_v2_frames_interleaved(void) {
+    xsan_connection_ctx_t *conn = _connect(20000);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(conn);
+
+    uint64_t tid = 1;
+    for (int i = 0; i < 300; ++i) {
+        if (rand() % 2) {
+            _append_v2_frame(&tid, (uint16_t)(1 + rand() % 8), rand() % 2 == 0, false, true);
+        } else {
+            uint16_t type;
+            uint32_t len;
+            _random_msg(&type, &len);
+            _append_v1(type, tid, len, true, false);
+            _expect(type, tid++, len);
+        }
+    }
+    _append_v2_frame(&tid, XSAN_PROTOCOL_V2_MAX_FRAME_MSGS, true, false, true);
+    _receive_all(conn);
+
+    CU_ASSERT_FALSE(g_sock.closed);
+    CU_ASSERT_EQUAL(g_num_delivered, g_num_expected);
+    CU_ASSERT_EQUAL(g_num_bad, 0);
+    CU_ASSERT_EQUAL(g_num_misaligned, 0);
+    CU_ASSERT_EQUAL(conn->rx_frame_msgs_left, 0);
+    CU_ASSERT_EQUAL(conn->rx_frame_num_held, 0);
+    _disconnect(conn);
+}
+
+void test_rx_bad_v1_checksum_closes(void) {
+    xsan_connection_ctx_t *conn = _connect(9000);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(conn);
+
+    uint64_t tid = 1;
+    for (int i = 0; i < 50; ++i) {
+        uint16_t type;
+        uint32_t len;
+        _random_msg(&type, &len);
+        _append_v1(type, tid, len, true, false);
+        _expect(type, tid++, len);
+    }
+    _append_v1(XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_REQ, tid++, (uint32_t)XSAN_REPLICA_WRITE_REQ_PAYLOAD_SIZE + 8192, true, true);
+    for (int i = 0; i < 10; ++i) _append_v1(XSAN_MSG_TYPE_HEARTBEAT, tid++, 100, true, false);
+    _receive_all(conn);
+
+    // Everything ahead of the bad message arrived, nothing after it; the connection is gone.
+    CU_ASSERT_TRUE(g_sock.closed);
+    CU_ASSERT_EQUAL(g_num_delivered, 50);
+    CU_ASSERT_EQUAL(g_num_bad, 0);
+    CU_ASSERT_EQUAL(g_reactor.num_connections, 0);
+}
+
+void test_rx_bad_frame_checksum_drops_frame(void) {
+    xsan_connection_ctx_t *conn = _connect(9000);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(conn);
+
+    uint64_t tid = 1;
+    for (int i = 0; i < 20; ++i) _append_v2_frame(&tid, (uint16_t)(1 + rand() % 8), true, false, true);
+    uint32_t before = g_num_expected;
+    _append_v2_frame(&tid, 6, true, true, false);
+    _append_v2_frame(&tid, 2, true, false, false);
+    _receive_all(conn);
+
+    // None of the corrupted frame's messages is delivered: they are held until the frame checks out.
+    CU_ASSERT_TRUE(g_sock.closed);
+    CU_ASSERT_EQUAL(g_num_delivered, before);
+    CU_ASSERT_EQUAL(g_num_bad, 0);
+    CU_ASSERT_EQUAL(g_reactor.num_connections, 0);
+}
+
+static int _suite_init(void) {
+    srand(20240607);
+    memset(&g_node_comm_ctx, 0, sizeof(g_node_comm_ctx));
+    memset(&g_reactor, 0, sizeof(g_reactor));
+    // Block messages go to specific handlers, the rest to the connection's generic one.
+    g_node_comm_ctx.specific_handlers[XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_REQ] = _specific_handler;
+    g_node_comm_ctx.specific_handlers[XSAN_MSG_TYPE_REPLICA_READ_BLOCK_RESP] = _specific_handler;
+    return 0;
+}
+
+static int _suite_clean(void) {
+    _xsan_comm_rx_pool_drain();
+    free(g_sock.in);
+    g_sock.in = NULL;
+    return 0;
+}
+
+int main() {
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry()) {
+        return CU_get_error();
+    }
+
+    pSuite = CU_add_suite("NodeCommRxSuite", _suite_init, _suite_clean);
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    if ((NULL == CU_add_test(pSuite, "test_rx_v1_split_reads", test_rx_v1_split_reads)) ||
+        (NULL == CU_add_test(pSuite, "test_rx_single_byte_reads", test_rx_single_byte_reads)) ||
+        (NULL == CU_add_test(pSuite, "test_rx_v1_and_v2_frames_interleaved", test_rx_v1_and_v2_frames_interleaved)) ||
+        (NULL == CU_add_test(pSuite, "test_rx_bad_v1_checksum_closes", test_rx_bad_v1_checksum_closes)) ||
+        (NULL == CU_add_test(pSuite, "test_rx_bad_frame_checksum_drops_frame", test_rx_bad_frame_checksum_drops_frame))) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    unsigned int failures = CU_get_number_of_failures();
+    CU_cleanup_registry();
+
+    return failures > 0 ? 1 : 0;
+}
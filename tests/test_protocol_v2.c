@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "CUnit/Basic.h"
+
+#include "xsan_protocol.h"
+#include "xsan_error.h"
+
+static void _frame_init(xsan_protocol_v2_frame_header_t *frame, uint16_t num_msgs, uint32_t frame_length) {
+    memset(frame, 0, sizeof(*frame));
+    frame->magic = XSAN_PROTOCOL_V2_FRAME_MAGIC;
+    frame->num_msgs = num_msgs;
+    frame->frame_length = frame_length;
+}
+
+void test_v2_frame_header_wire_layout(void) {
+    xsan_protocol_v2_frame_header_t frame;
+    _frame_init(&frame, 3, 0x01020304);
+    frame.checksum = 0xA1B2C3D4;
+    unsigned char buf[XSAN_PROTOCOL_V2_FRAME_HEADER_SIZE];
+
+    CU_ASSERT_EQUAL(XSAN_PROTOCOL_V2_FRAME_HEADER_SIZE, 16);
+    xsan_protocol_v2_frame_header_encode(&frame, buf);
+    // Little-endian at fixed offsets, whatever the host order
+    CU_ASSERT_EQUAL(memcmp(buf, "XSF2", 4), 0);
+    CU_ASSERT_TRUE(buf[4] == 3 && buf[5] == 0);
+    CU_ASSERT_TRUE(buf[6] == 0 && buf[7] == 0);
+    CU_ASSERT_TRUE(buf[8] == 0x04 && buf[9] == 0x03 && buf[10] == 0x02 && buf[11] == 0x01);
+    CU_ASSERT_TRUE(buf[12] == 0xD4 && buf[15] == 0xA1);
+
+    xsan_protocol_v2_frame_header_t decoded;
+    CU_ASSERT_EQUAL(xsan_protocol_v2_frame_header_decode(buf, &decoded), XSAN_OK);
+    CU_ASSERT_EQUAL(decoded.magic, XSAN_PROTOCOL_V2_FRAME_MAGIC);
+    CU_ASSERT_EQUAL(decoded.num_msgs, 3);
+    CU_ASSERT_EQUAL(decoded.flags, 0);
+    CU_ASSERT_EQUAL(decoded.frame_length, 0x01020304);
+    CU_ASSERT_EQUAL(decoded.checksum, 0xA1B2C3D4);
+}
+
+void test_v2_frame_header_rejects_malformed(void) {
+    xsan_protocol_v2_frame_header_t frame, decoded;
+    unsigned char buf[XSAN_PROTOCOL_V2_FRAME_HEADER_SIZE];
+    const uint32_t one_msg = XSAN_PROTOCOL_V2_MSG_HEADER_SIZE;
+
+    CU_ASSERT_EQUAL(xsan_protocol_v2_frame_header_decode(NULL, &decoded), XSAN_ERROR_INVALID_PARAM);
+    CU_ASSERT_EQUAL(xsan_protocol_v2_frame_header_decode(buf, NULL), XSAN_ERROR_INVALID_PARAM);
+
+    _frame_init(&frame, 1, one_msg);
+    frame.magic ^= 1;
+    xsan_protocol_v2_frame_header_encode(&frame, buf);
+    CU_ASSERT_EQUAL(xsan_protocol_v2_frame_header_decode(buf, &decoded), XSAN_ERROR_INVALID_PARAM);
+
+    _frame_init(&frame, 0, 0);
+    xsan_protocol_v2_frame_header_encode(&frame, buf);
+    CU_ASSERT_EQUAL(xsan_protocol_v2_frame_header_decode(buf, &decoded), XSAN_ERROR_INVALID_PARAM);
+
+    _frame_init(&frame, XSAN_PROTOCOL_V2_MAX_FRAME_MSGS + 1, (XSAN_PROTOCOL_V2_MAX_FRAME_MSGS + 1) * one_msg);
+    xsan_protocol_v2_frame_header_encode(&frame, buf);
+    CU_ASSERT_EQUAL(xsan_protocol_v2_frame_header_decode(buf, &decoded), XSAN_ERROR_INVALID_PARAM);
+
+    // Too short to hold a header for every message
+    _frame_init(&frame, 2, 2 * one_msg - 1);
+    xsan_protocol_v2_frame_header_encode(&frame, buf);
+    CU_ASSERT_EQUAL(xsan_protocol_v2_frame_header_decode(buf, &decoded), XSAN_ERROR_INVALID_PARAM);
+
+    _frame_init(&frame, 1, XSAN_PROTOCOL_V2_MAX_FRAME_SIZE + 1);
+    xsan_protocol_v2_frame_header_encode(&frame, buf);
+    CU_ASSERT_EQUAL(xsan_protocol_v2_frame_header_decode(buf, &decoded), XSAN_ERROR_INVALID_PARAM);
+
+    // Both limits themselves are accepted
+    _frame_init(&frame, XSAN_PROTOCOL_V2_MAX_FRAME_MSGS, XSAN_PROTOCOL_V2_MAX_FRAME_SIZE);
+    xsan_protocol_v2_frame_header_encode(&frame, buf);
+    CU_ASSERT_EQUAL(xsan_protocol_v2_frame_header_decode(buf, &decoded), XSAN_OK);
+}
+
+void test_v2_frame_distinguishable_from_v1(void) {
+    xsan_message_header_t v1;
+    unsigned char buf[XSAN_MESSAGE_HEADER_SIZE];
+    xsan_protocol_header_init(&v1, XSAN_MSG_TYPE_HEARTBEAT, 0, 1);
+    CU_ASSERT_EQUAL(xsan_protocol_header_serialize(&v1, buf), XSAN_OK);
+
+    // A receiver reading a v1 header as a v2 frame header must reject it on the magic alone.
+    uint32_t first_word;
+    memcpy(&first_word, buf, sizeof(first_word));
+    CU_ASSERT_NOT_EQUAL(first_word, XSAN_PROTOCOL_V2_FRAME_MAGIC);
+    xsan_protocol_v2_frame_header_t decoded;
+    CU_ASSERT_EQUAL(xsan_protocol_v2_frame_header_decode(buf, &decoded), XSAN_ERROR_INVALID_PARAM);
+}
+
+void test_v2_msg_header_round_trip(void) {
+    xsan_message_header_t hdr, decoded;
+    unsigned char buf[XSAN_PROTOCOL_V2_MSG_HEADER_SIZE];
+    uint16_t flags = 0;
+
+    CU_ASSERT_EQUAL(XSAN_PROTOCOL_V2_MSG_HEADER_SIZE, 16);
+    xsan_protocol_header_init(&hdr, XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_REQ, 4096, 0x1122334455667788ULL);
+    hdr.checksum = 0xDEADBEEF;
+    xsan_protocol_v2_msg_header_encode(&hdr, XSAN_PROTOCOL_V2_MSG_FLAG_LZ4, buf);
+    CU_ASSERT_TRUE(buf[4] == 0x00 && buf[5] == 0x10 && buf[6] == 0 && buf[7] == 0); // 4096 LE
+    CU_ASSERT_TRUE(buf[8] == 0x88 && buf[15] == 0x11);
+
+    memset(&decoded, 0xFF, sizeof(decoded));
+    CU_ASSERT_EQUAL(xsan_protocol_v2_msg_header_decode(buf, &decoded, &flags), XSAN_OK);
+    CU_ASSERT_EQUAL(decoded.magic, XSAN_PROTOCOL_MAGIC);
+    CU_ASSERT_EQUAL(decoded.version, XSAN_PROTOCOL_VERSION_2);
+    CU_ASSERT_EQUAL(decoded.type, XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_REQ);
+    CU_ASSERT_EQUAL(decoded.payload_length, 4096);
+    CU_ASSERT_EQUAL(decoded.transaction_id, 0x1122334455667788ULL);
+    CU_ASSERT_EQUAL(decoded.checksum, 0); // The frame checksum covers v2 messages
+    CU_ASSERT_EQUAL(flags, XSAN_PROTOCOL_V2_MSG_FLAG_LZ4);
+
+    // flags_out is optional
+    CU_ASSERT_EQUAL(xsan_protocol_v2_msg_header_decode(buf, &decoded, NULL), XSAN_OK);
+}
+
+void test_v2_msg_header_rejects_oversized_payload(void) {
+    xsan_message_header_t hdr, decoded;
+    unsigned char buf[XSAN_PROTOCOL_V2_MSG_HEADER_SIZE];
+
+    xsan_protocol_header_init(&hdr, XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_REQ, XSAN_PROTOCOL_MAX_PAYLOAD_SIZE, 7);
+    xsan_protocol_v2_msg_header_encode(&hdr, 0, buf);
+    CU_ASSERT_EQUAL(xsan_protocol_v2_msg_header_decode(buf, &decoded, NULL), XSAN_OK);
+
+    hdr.payload_length = XSAN_PROTOCOL_MAX_PAYLOAD_SIZE + 1;
+    xsan_protocol_v2_msg_header_encode(&hdr, 0, buf);
+    CU_ASSERT_EQUAL(xsan_protocol_v2_msg_header_decode(buf, &decoded, NULL), XSAN_ERROR_INVALID_PARAM);
+    CU_ASSERT_EQUAL(xsan_protocol_v2_msg_header_decode(NULL, &decoded, NULL), XSAN_ERROR_INVALID_PARAM);
+    CU_ASSERT_EQUAL(xsan_protocol_v2_msg_header_decode(buf, NULL, NULL), XSAN_ERROR_INVALID_PARAM);
+}
+
+void test_v2_crc32c_running_checksum(void) {
+    const char *check = "123456789";
+    // Standard CRC32C check value
+    uint32_t crc = xsan_protocol_crc32c_update(XSAN_PROTOCOL_CRC32C_INIT, check, 9);
+    CU_ASSERT_EQUAL(xsan_protocol_crc32c_final(crc), 0xE3069283u);
+
+    // Split over discontiguous buffers, with empty pieces in between, gives the same value.
+    crc = xsan_protocol_crc32c_update(XSAN_PROTOCOL_CRC32C_INIT, check, 4);
+    crc = xsan_protocol_crc32c_update(crc, NULL, 0);
+    crc = xsan_protocol_crc32c_update(crc, check + 4, 0);
+    crc = xsan_protocol_crc32c_update(crc, check + 4, 5);
+    CU_ASSERT_EQUAL(xsan_protocol_crc32c_final(crc), 0xE3069283u);
+    CU_ASSERT_EQUAL(xsan_protocol_calculate_checksum((const unsigned char *)check, 9), 0xE3069283u);
+
+    // A CRC that finishes to 0 is reported as 0xFFFFFFFF, since 0 means "not checksummed".
+    CU_ASSERT_EQUAL(xsan_protocol_crc32c_final(~0u), 0xFFFFFFFFu);
+}
+
+void test_v2_frame_round_trip(void) {
+    // Two messages packed the way the sender lays them out, checksummed with the field zeroed.
+    const char *p0 = "first payload";
+    const unsigned char p1[3] = { 0x01, 0x02, 0x03 };
+    const uint32_t len0 = (uint32_t)strlen(p0), len1 = sizeof(p1);
+    unsigned char wire[256];
+    size_t off = XSAN_PROTOCOL_V2_FRAME_HEADER_SIZE;
+    xsan_message_header_t hdr;
+
+    xsan_protocol_header_init(&hdr, XSAN_MSG_TYPE_HEARTBEAT, len0, 100);
+    xsan_protocol_v2_msg_header_encode(&hdr, 0, wire + off);
+    off += XSAN_PROTOCOL_V2_MSG_HEADER_SIZE;
+    memcpy(wire + off, p0, len0);
+    off += len0;
+    xsan_protocol_header_init(&hdr, XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_RESP, len1, 101);
+    xsan_protocol_v2_msg_header_encode(&hdr, 0, wire + off);
+    off += XSAN_PROTOCOL_V2_MSG_HEADER_SIZE;
+    memcpy(wire + off, p1, len1);
+    off += len1;
+
+    xsan_protocol_v2_frame_header_t frame;
+    _frame_init(&frame, 2, (uint32_t)(off - XSAN_PROTOCOL_V2_FRAME_HEADER_SIZE));
+    xsan_protocol_v2_frame_header_encode(&frame, wire);
+    frame.checksum = xsan_protocol_crc32c_final(xsan_protocol_crc32c_update(XSAN_PROTOCOL_CRC32C_INIT, wire, off));
+    xsan_protocol_v2_frame_header_encode(&frame, wire);
+
+    // Receiver side: decode, verify the checksum with the field zeroed, then walk the messages.
+    xsan_protocol_v2_frame_header_t rx;
+    CU_ASSERT_EQUAL_FATAL(xsan_protocol_v2_frame_header_decode(wire, &rx), XSAN_OK);
+    CU_ASSERT_EQUAL_FATAL(XSAN_PROTOCOL_V2_FRAME_HEADER_SIZE + rx.frame_length, off);
+    unsigned char check[256];
+    memcpy(check, wire, off);
+    memset(check + offsetof(xsan_protocol_v2_frame_header_t, checksum), 0, sizeof(uint32_t));
+    CU_ASSERT_EQUAL(xsan_protocol_crc32c_final(xsan_protocol_crc32c_update(XSAN_PROTOCOL_CRC32C_INIT, check, off)),
+                    rx.checksum);
+
+    size_t pos = XSAN_PROTOCOL_V2_FRAME_HEADER_SIZE;
+    xsan_message_header_t m0, m1;
+    CU_ASSERT_EQUAL(xsan_protocol_v2_msg_header_decode(wire + pos, &m0, NULL), XSAN_OK);
+    pos += XSAN_PROTOCOL_V2_MSG_HEADER_SIZE;
+    CU_ASSERT_EQUAL(m0.type, XSAN_MSG_TYPE_HEARTBEAT);
+    CU_ASSERT_EQUAL(m0.transaction_id, 100);
+    CU_ASSERT_EQUAL_FATAL(m0.payload_length, len0);
+    CU_ASSERT_EQUAL(memcmp(wire + pos, p0, len0), 0);
+    pos += m0.payload_length;
+    CU_ASSERT_EQUAL(xsan_protocol_v2_msg_header_decode(wire + pos, &m1, NULL), XSAN_OK);
+    pos += XSAN_PROTOCOL_V2_MSG_HEADER_SIZE;
+    CU_ASSERT_EQUAL(m1.type, XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_RESP);
+    CU_ASSERT_EQUAL(m1.transaction_id, 101);
+    CU_ASSERT_EQUAL_FATAL(m1.payload_length, len1);
+    CU_ASSERT_EQUAL(memcmp(wire + pos, p1, len1), 0);
+    CU_ASSERT_EQUAL(pos + m1.payload_length, off);
+
+    // A flipped payload bit no longer matches the frame checksum.
+    check[off - 1] ^= 0x40;
+    CU_ASSERT_NOT_EQUAL(xsan_protocol_crc32c_final(xsan_protocol_crc32c_update(XSAN_PROTOCOL_CRC32C_INIT, check, off)),
+                        rx.checksum);
+}
+
+int main(void) {
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry()) {
+        return CU_get_error();
+    }
+
+    pSuite = CU_add_suite("Protocol_V2_Suite", NULL, NULL);
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    if ((NULL == CU_add_test(pSuite, "test_v2_frame_header_wire_layout", test_v2_frame_header_wire_layout)) ||
+        (NULL == CU_add_test(pSuite, "test_v2_frame_header_rejects_malformed", test_v2_frame_header_rejects_malformed)) ||
+        (NULL == CU_add_test(pSuite, "test_v2_frame_distinguishable_from_v1", test_v2_frame_distinguishable_from_v1)) ||
+        (NULL == CU_add_test(pSuite, "test_v2_msg_header_round_trip", test_v2_msg_header_round_trip)) ||
+        (NULL == CU_add_test(pSuite, "test_v2_msg_header_rejects_oversized_payload", test_v2_msg_header_rejects_oversized_payload)) ||
+        (NULL == CU_add_test(pSuite, "test_v2_crc32c_running_checksum", test_v2_crc32c_running_checksum)) ||
+        (NULL == CU_add_test(pSuite, "test_v2_frame_round_trip", test_v2_frame_round_trip))
+       ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+
+    int failures = CU_get_number_of_failures();
+    CU_cleanup_registry();
+
+    return failures > 0 ? 1 : 0;
+}
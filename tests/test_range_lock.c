@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "CUnit/Basic.h"
+
+#include "xsan_range_lock.h"
+#include "xsan_error.h"
+
+// Order in which deferred grants were delivered, identified by the cb_arg of each request.
+static int g_grant_order[16];
+static int g_num_grants;
+
+static void _record_grant(xsan_range_lock_req_t *req, void *cb_arg) {
+    CU_ASSERT_TRUE(req->granted);
+    if (g_num_grants < (int)(sizeof(g_grant_order) / sizeof(g_grant_order[0]))) {
+        g_grant_order[g_num_grants] = (int)(intptr_t)cb_arg;
+    }
+    g_num_grants++;
+}
+
+static void _reset_grants(void) {
+    memset(g_grant_order, 0, sizeof(g_grant_order));
+    g_num_grants = 0;
+}
+
+void test_range_lock_invalid_params(void) {
+    xsan_range_lock_table_t *table = xsan_range_lock_table_create(0, 0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(table);
+    xsan_range_lock_req_t req;
+    bool now = false;
+
+    CU_ASSERT_EQUAL(xsan_range_lock_acquire(table, &req, 0, 0, _record_grant, NULL, &now), XSAN_ERROR_INVALID_PARAM);
+    CU_ASSERT_EQUAL(xsan_range_lock_acquire(table, &req, 0, 1, NULL, NULL, &now), XSAN_ERROR_INVALID_PARAM);
+    CU_ASSERT_EQUAL(xsan_range_lock_acquire(table, &req, UINT64_MAX, 2, _record_grant, NULL, &now), XSAN_ERROR_INVALID_PARAM);
+    xsan_range_lock_table_destroy(table);
+}
+
+void test_range_lock_disjoint_ranges_granted_at_once(void) {
+    xsan_range_lock_table_t *table = xsan_range_lock_table_create(4, 1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(table);
+    xsan_range_lock_req_t a, b;
+    bool a_now = false, b_now = false;
+    _reset_grants();
+
+    // Blocks 0-1 and 8-9 hash onto the same slot (4 slots of 2-block regions) but do not overlap.
+    CU_ASSERT_EQUAL(xsan_range_lock_acquire(table, &a, 0, 2, _record_grant, (void *)1, &a_now), XSAN_OK);
+    CU_ASSERT_EQUAL(xsan_range_lock_acquire(table, &b, 8, 2, _record_grant, (void *)2, &b_now), XSAN_OK);
+    CU_ASSERT_TRUE(a_now);
+    CU_ASSERT_TRUE(b_now);
+
+    xsan_range_lock_release(table, &a);
+    xsan_range_lock_release(table, &b);
+    CU_ASSERT_EQUAL(g_num_grants, 0); // Immediate grants never invoke the callback
+
+    xsan_range_lock_stats_t stats;
+    CU_ASSERT_EQUAL(xsan_range_lock_get_stats(table, &stats), XSAN_OK);
+    CU_ASSERT_EQUAL(stats.acquisitions, 2);
+    CU_ASSERT_EQUAL(stats.contended_acquisitions, 0);
+    CU_ASSERT_EQUAL(stats.current_holders, 0);
+    xsan_range_lock_table_destroy(table);
+}
+
+void test_range_lock_overlap_waits_for_release(void) {
+    xsan_range_lock_table_t *table = xsan_range_lock_table_create(0, 0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(table);
+    xsan_range_lock_req_t a, b;
+    bool a_now = false, b_now = true;
+    _reset_grants();
+
+    CU_ASSERT_EQUAL(xsan_range_lock_acquire(table, &a, 100, 10, _record_grant, (void *)1, &a_now), XSAN_OK);
+    CU_ASSERT_EQUAL(xsan_range_lock_acquire(table, &b, 109, 5, _record_grant, (void *)2, &b_now), XSAN_OK);
+    CU_ASSERT_TRUE(a_now);
+    CU_ASSERT_FALSE(b_now);
+    CU_ASSERT_FALSE(b.granted);
+
+    xsan_range_lock_stats_t stats;
+    xsan_range_lock_get_stats(table, &stats);
+    CU_ASSERT_EQUAL(stats.current_holders, 1);
+    CU_ASSERT_EQUAL(stats.current_waiters, 1);
+
+    xsan_range_lock_release(table, &a);
+    CU_ASSERT_EQUAL(g_num_grants, 1);
+    CU_ASSERT_EQUAL(g_grant_order[0], 2);
+    CU_ASSERT_TRUE(b.granted);
+
+    xsan_range_lock_release(table, &b);
+    xsan_range_lock_get_stats(table, &stats);
+    CU_ASSERT_EQUAL(stats.acquisitions, 2);
+    CU_ASSERT_EQUAL(stats.contended_acquisitions, 1);
+    CU_ASSERT_EQUAL(stats.current_holders, 0);
+    CU_ASSERT_EQUAL(stats.current_waiters, 0);
+    CU_ASSERT_EQUAL(stats.max_waiters, 1);
+    xsan_range_lock_table_destroy(table);
+}
+
+void test_range_lock_fifo_order(void) {
+    xsan_range_lock_table_t *table = xsan_range_lock_table_create(0, 0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(table);
+    xsan_range_lock_req_t a, b, c;
+    bool a_now = false, b_now = true, c_now = true;
+    _reset_grants();
+
+    // C does not overlap A, but it overlaps B, which arrived earlier: C must wait behind B.
+    CU_ASSERT_EQUAL(xsan_range_lock_acquire(table, &a, 0, 10, _record_grant, (void *)1, &a_now), XSAN_OK);
+    CU_ASSERT_EQUAL(xsan_range_lock_acquire(table, &b, 5, 10, _record_grant, (void *)2, &b_now), XSAN_OK);
+    CU_ASSERT_EQUAL(xsan_range_lock_acquire(table, &c, 12, 8, _record_grant, (void *)3, &c_now), XSAN_OK);
+    CU_ASSERT_TRUE(a_now);
+    CU_ASSERT_FALSE(b_now);
+    CU_ASSERT_FALSE(c_now);
+    CU_ASSERT_TRUE(a.seq < b.seq && b.seq < c.seq);
+
+    xsan_range_lock_release(table, &a);
+    CU_ASSERT_EQUAL(g_num_grants, 1);
+    CU_ASSERT_EQUAL(g_grant_order[0], 2);
+    CU_ASSERT_FALSE(c.granted);
+
+    xsan_range_lock_release(table, &b);
+    CU_ASSERT_EQUAL(g_num_grants, 2);
+    CU_ASSERT_EQUAL(g_grant_order[1], 3);
+
+    xsan_range_lock_release(table, &c);
+    xsan_range_lock_table_destroy(table);
+}
+
+void test_range_lock_release_grants_all_unblocked(void) {
+    xsan_range_lock_table_t *table = xsan_range_lock_table_create(0, 0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(table);
+    xsan_range_lock_req_t a, b, c;
+    bool a_now = false, b_now = true, c_now = true;
+    _reset_grants();
+
+    // B and C both wait only on A; one release grants both, in arrival order.
+    CU_ASSERT_EQUAL(xsan_range_lock_acquire(table, &a, 0, 100, _record_grant, (void *)1, &a_now), XSAN_OK);
+    CU_ASSERT_EQUAL(xsan_range_lock_acquire(table, &b, 10, 10, _record_grant, (void *)2, &b_now), XSAN_OK);
+    CU_ASSERT_EQUAL(xsan_range_lock_acquire(table, &c, 50, 10, _record_grant, (void *)3, &c_now), XSAN_OK);
+    CU_ASSERT_FALSE(b_now);
+    CU_ASSERT_FALSE(c_now);
+
+    xsan_range_lock_release(table, &a);
+    CU_ASSERT_EQUAL(g_num_grants, 2);
+    CU_ASSERT_EQUAL(g_grant_order[0], 2);
+    CU_ASSERT_EQUAL(g_grant_order[1], 3);
+
+    xsan_range_lock_release(table, &c);
+    xsan_range_lock_release(table, &b);
+    xsan_range_lock_table_destroy(table);
+}
+
+void test_range_lock_wide_range(void) {
+    // 2-block regions over 8 slots: a 40-block range wraps every slot and needs heap links.
+    xsan_range_lock_table_t *table = xsan_range_lock_table_create(8, 1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(table);
+    xsan_range_lock_req_t wide, small;
+    bool wide_now = false, small_now = true;
+    _reset_grants();
+
+    CU_ASSERT_EQUAL(xsan_range_lock_acquire(table, &wide, 0, 40, _record_grant, (void *)1, &wide_now), XSAN_OK);
+    CU_ASSERT_TRUE(wide_now);
+    CU_ASSERT_EQUAL(wide.num_links, 8);
+    CU_ASSERT_TRUE(wide.links != wide.inline_links);
+
+    CU_ASSERT_EQUAL(xsan_range_lock_acquire(table, &small, 39, 1, _record_grant, (void *)2, &small_now), XSAN_OK);
+    CU_ASSERT_FALSE(small_now);
+
+    xsan_range_lock_release(table, &wide);
+    CU_ASSERT_PTR_NULL(wide.links);
+    CU_ASSERT_EQUAL(g_num_grants, 1);
+    CU_ASSERT_EQUAL(g_grant_order[0], 2);
+
+    xsan_range_lock_release(table, &small);
+    xsan_range_lock_table_destroy(table);
+}
+
+int main(void) {
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry()) {
+        return CU_get_error();
+    }
+
+    pSuite = CU_add_suite("Range_Lock_Suite", NULL, NULL);
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    if ((NULL == CU_add_test(pSuite, "test_range_lock_invalid_params", test_range_lock_invalid_params)) ||
+        (NULL == CU_add_test(pSuite, "test_range_lock_disjoint_ranges_granted_at_once", test_range_lock_disjoint_ranges_granted_at_once)) ||
+        (NULL == CU_add_test(pSuite, "test_range_lock_overlap_waits_for_release", test_range_lock_overlap_waits_for_release)) ||
+        (NULL == CU_add_test(pSuite, "test_range_lock_fifo_order", test_range_lock_fifo_order)) ||
+        (NULL == CU_add_test(pSuite, "test_range_lock_release_grants_all_unblocked", test_range_lock_release_grants_all_unblocked)) ||
+        (NULL == CU_add_test(pSuite, "test_range_lock_wide_range", test_range_lock_wide_range))
+       ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+
+    int failures = CU_get_number_of_failures();
+    CU_cleanup_registry();
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "CUnit/Basic.h"
+
+#include "xsan_replica_chain.h"
+#include "xsan_error.h"
+
+// Remote replicas of a chain-mode write as the primary collects them, in forwarding order.
+static xsan_replica_location_t g_hops[XSAN_REPLICA_CHAIN_MAX_HOPS];
+static xsan_replica_chain_hop_t g_primary;
+static xsan_replica_write_req_payload_t g_write;
+
+static void _make_location(xsan_replica_location_t *loc, uint8_t id, const char *ip, uint16_t port) {
+    memset(loc, 0, sizeof(*loc));
+    memset(&loc->node_id, id, sizeof(loc->node_id));
+    snprintf(loc->node_ip_addr, sizeof(loc->node_ip_addr), "%s", ip);
+    loc->node_comm_port = port;
+}
+
+static void _make_ack(xsan_replica_chain_write_resp_payload_t *resp, const xsan_replica_location_t *responder,
+                      uint8_t num_statuses, const xsan_error_t *statuses) {
+    memset(resp, 0, sizeof(*resp));
+    memcpy(&resp->responder_node_id, &responder->node_id, sizeof(xsan_node_id_t));
+    resp->chain_num_statuses = num_statuses;
+    for (uint32_t i = 0; i < num_statuses && i < XSAN_REPLICA_CHAIN_MAX_HOPS; ++i) {
+        resp->chain_statuses[i] = statuses[i];
+    }
+    resp->write.status = num_statuses ? statuses[0] : XSAN_OK;
+}
+
+static int suite_chain_init(void) {
+    xsan_replica_location_t self;
+    _make_location(&self, 0x10, "10.0.0.1", 7001);
+    xsan_replica_chain_hop_from_location(&g_primary, &self);
+    _make_location(&g_hops[0], 0x11, "10.0.0.2", 7002);
+    _make_location(&g_hops[1], 0x12, "10.0.0.3", 7003);
+    memset(&g_write, 0, sizeof(g_write));
+    memset(&g_write.volume_id, 0xAB, sizeof(g_write.volume_id));
+    g_write.block_lba_on_volume = 128;
+    g_write.num_blocks = 8;
+    return 0;
+}
+
+static int suite_chain_clean(void) {
+    return 0;
+}
+
+void test_chain_payloads_keep_fanout_layout(void) {
+    // Fan-out messages must stay byte-compatible with nodes that know nothing of chains.
+    CU_ASSERT_EQUAL(sizeof(xsan_replica_write_req_payload_t), sizeof(xsan_volume_id_t) + 8 + 4);
+    CU_ASSERT_EQUAL(sizeof(xsan_replica_write_resp_payload_t), sizeof(xsan_error_t) + 8 + 4);
+    CU_ASSERT_EQUAL(xsan_protocol_payload_data_offset(XSAN_MSG_TYPE_REPLICA_WRITE_BLOCK_REQ),
+                    sizeof(xsan_replica_write_req_payload_t));
+    CU_ASSERT_EQUAL(xsan_protocol_payload_data_offset(XSAN_MSG_TYPE_REPLICA_CHAIN_WRITE_REQ),
+                    sizeof(xsan_replica_chain_write_req_payload_t));
+}
+
+void test_chain_req_init_from_head(void) {
+    xsan_replica_chain_write_req_payload_t req;
+    CU_ASSERT_EQUAL(xsan_replica_chain_req_init(&req, &g_write, &g_primary, g_hops, 2, 0), XSAN_OK);
+    CU_ASSERT_EQUAL(memcmp(&req.write, &g_write, sizeof(g_write)), 0);
+    CU_ASSERT_EQUAL(memcmp(&req.upstream, &g_primary, sizeof(g_primary)), 0);
+    CU_ASSERT_EQUAL(req.chain_num_downstream, 1);
+    CU_ASSERT_EQUAL(memcmp(&req.chain_downstream[0].node_id, &g_hops[1].node_id, sizeof(xsan_node_id_t)), 0);
+    CU_ASSERT_STRING_EQUAL(req.chain_downstream[0].node_ip_addr, "10.0.0.3");
+    CU_ASSERT_EQUAL(req.chain_downstream[0].node_comm_port, 7003);
+    CU_ASSERT_TRUE(xsan_replica_chain_req_hops_valid(&req));
+
+    CU_ASSERT_EQUAL(xsan_replica_chain_req_init(&req, &g_write, &g_primary, g_hops, 2, 2), XSAN_ERROR_INVALID_PARAM);
+    CU_ASSERT_EQUAL(xsan_replica_chain_req_init(NULL, &g_write, &g_primary, g_hops, 2, 0), XSAN_ERROR_INVALID_PARAM);
+}
+
+void test_chain_req_shift_drops_first_hop(void) {
+    xsan_replica_chain_write_req_payload_t req, fwd;
+    xsan_replica_chain_hop_t mid;
+    CU_ASSERT_EQUAL(xsan_replica_chain_req_init(&req, &g_write, &g_primary, g_hops, 2, 0), XSAN_OK);
+    xsan_replica_chain_hop_from_location(&mid, &g_hops[0]);
+
+    memset(&fwd, 0xFF, sizeof(fwd));
+    xsan_replica_chain_req_shift(&req, &mid, &fwd);
+    CU_ASSERT_EQUAL(memcmp(&fwd.write, &g_write, sizeof(g_write)), 0);
+    CU_ASSERT_EQUAL(memcmp(&fwd.upstream, &mid, sizeof(mid)), 0);
+    CU_ASSERT_EQUAL(fwd.chain_num_downstream, 0);
+    // Unused hop slots are cleared rather than left holding the previous list.
+    CU_ASSERT_EQUAL(fwd.chain_downstream[0].node_comm_port, 0);
+    CU_ASSERT_EQUAL(fwd.chain_downstream[0].node_ip_addr[0], '\0');
+    CU_ASSERT_TRUE(xsan_replica_chain_req_hops_valid(&fwd));
+}
+
+void test_chain_req_hops_valid_rejects_bad_hops(void) {
+    xsan_replica_chain_write_req_payload_t req, bad;
+    CU_ASSERT_EQUAL(xsan_replica_chain_req_init(&req, &g_write, &g_primary, g_hops, 2, 0), XSAN_OK);
+    CU_ASSERT_FALSE(xsan_replica_chain_req_hops_valid(NULL));
+
+    // The receiver's own status must still fit in its ack.
+    memcpy(&bad, &req, sizeof(req));
+    bad.chain_num_downstream = XSAN_REPLICA_CHAIN_MAX_HOPS;
+    CU_ASSERT_FALSE(xsan_replica_chain_req_hops_valid(&bad));
+    bad.chain_num_downstream = 0xFF;
+    CU_ASSERT_FALSE(xsan_replica_chain_req_hops_valid(&bad));
+
+    memcpy(&bad, &req, sizeof(req));
+    memset(bad.chain_downstream[0].node_ip_addr, 'A', sizeof(bad.chain_downstream[0].node_ip_addr));
+    CU_ASSERT_FALSE(xsan_replica_chain_req_hops_valid(&bad));
+
+    memcpy(&bad, &req, sizeof(req));
+    bad.chain_downstream[0].node_comm_port = 0;
+    CU_ASSERT_FALSE(xsan_replica_chain_req_hops_valid(&bad));
+
+    // Without a usable upstream hop the ack has nowhere to go.
+    memcpy(&bad, &req, sizeof(req));
+    bad.upstream.node_ip_addr[0] = '\0';
+    CU_ASSERT_FALSE(xsan_replica_chain_req_hops_valid(&bad));
+    memcpy(&bad, &req, sizeof(req));
+    bad.upstream.node_comm_port = 0;
+    CU_ASSERT_FALSE(xsan_replica_chain_req_hops_valid(&bad));
+}
+
+void test_chain_ack_statuses_full(void) {
+    xsan_replica_chain_write_resp_payload_t resp;
+    xsan_error_t reported[2] = { XSAN_OK, XSAN_ERROR_TIMEOUT };
+    xsan_error_t statuses[XSAN_REPLICA_CHAIN_MAX_HOPS];
+    _make_ack(&resp, &g_hops[0], 2, reported);
+    CU_ASSERT_EQUAL(xsan_replica_chain_ack_statuses(&resp, &g_hops[0].node_id, 2, statuses), XSAN_OK);
+    CU_ASSERT_EQUAL(statuses[0], XSAN_OK);
+    CU_ASSERT_EQUAL(statuses[1], XSAN_ERROR_TIMEOUT);
+}
+
+void test_chain_ack_statuses_short_ack_fails_missing_hops(void) {
+    xsan_replica_chain_write_resp_payload_t resp;
+    xsan_error_t reported[1] = { XSAN_OK };
+    xsan_error_t statuses[XSAN_REPLICA_CHAIN_MAX_HOPS];
+    _make_ack(&resp, &g_hops[0], 1, reported);
+    CU_ASSERT_EQUAL(xsan_replica_chain_ack_statuses(&resp, &g_hops[0].node_id, 2, statuses), XSAN_OK);
+    CU_ASSERT_EQUAL(statuses[0], XSAN_OK);
+    CU_ASSERT_EQUAL(statuses[1], XSAN_ERROR_REPLICATION_GENERIC);
+}
+
+void test_chain_ack_statuses_long_ack_is_clamped(void) {
+    xsan_replica_chain_write_resp_payload_t resp;
+    xsan_error_t reported[2] = { XSAN_ERROR_NOT_FOUND, XSAN_OK };
+    xsan_error_t statuses[XSAN_REPLICA_CHAIN_MAX_HOPS] = { XSAN_OK, 12345 };
+    _make_ack(&resp, &g_hops[1], 2, reported);
+    // More statuses than hops below the expected responder: the extra one is ignored.
+    CU_ASSERT_EQUAL(xsan_replica_chain_ack_statuses(&resp, &g_hops[1].node_id, 1, statuses), XSAN_OK);
+    CU_ASSERT_EQUAL(statuses[0], XSAN_ERROR_NOT_FOUND);
+    CU_ASSERT_EQUAL(statuses[1], 12345);
+
+    // A count beyond the array on the wire is never read past it.
+    _make_ack(&resp, &g_hops[0], 2, reported);
+    resp.chain_num_statuses = 0xFF;
+    CU_ASSERT_EQUAL(xsan_replica_chain_ack_statuses(&resp, &g_hops[0].node_id, 2, statuses), XSAN_OK);
+    CU_ASSERT_EQUAL(statuses[0], XSAN_ERROR_NOT_FOUND);
+    CU_ASSERT_EQUAL(statuses[1], XSAN_OK);
+}
+
+void test_chain_ack_statuses_rejects_bad_acks(void) {
+    xsan_replica_chain_write_resp_payload_t resp;
+    xsan_error_t reported[1] = { XSAN_OK };
+    xsan_error_t statuses[XSAN_REPLICA_CHAIN_MAX_HOPS] = { 111, 222 };
+
+    _make_ack(&resp, &g_hops[0], 0, reported);
+    CU_ASSERT_EQUAL(xsan_replica_chain_ack_statuses(&resp, &g_hops[0].node_id, 2, statuses), XSAN_ERROR_INVALID_PARAM);
+
+    _make_ack(&resp, &g_hops[1], 1, reported);
+    CU_ASSERT_EQUAL(xsan_replica_chain_ack_statuses(&resp, &g_hops[0].node_id, 2, statuses), XSAN_ERROR_REPLICA_NOT_FOUND);
+
+    CU_ASSERT_EQUAL(xsan_replica_chain_ack_statuses(&resp, &g_hops[1].node_id, 0, statuses), XSAN_ERROR_INVALID_PARAM);
+    CU_ASSERT_EQUAL(xsan_replica_chain_ack_statuses(&resp, &g_hops[1].node_id, XSAN_REPLICA_CHAIN_MAX_HOPS + 1, statuses),
+                    XSAN_ERROR_INVALID_PARAM);
+    // Rejected acks leave the caller's statuses alone.
+    CU_ASSERT_EQUAL(statuses[0], 111);
+    CU_ASSERT_EQUAL(statuses[1], 222);
+}
+
+void test_chain_head_failure_reform(void) {
+    // hops[0] could not be reached: the primary resends to hops[1], now the head and the tail.
+    xsan_replica_chain_write_req_payload_t req;
+    CU_ASSERT_EQUAL(xsan_replica_chain_req_init(&req, &g_write, &g_primary, g_hops, 2, 1), XSAN_OK);
+    CU_ASSERT_EQUAL(req.chain_num_downstream, 0);
+    CU_ASSERT_EQUAL(memcmp(&req.upstream, &g_primary, sizeof(g_primary)), 0);
+    CU_ASSERT_TRUE(xsan_replica_chain_req_hops_valid(&req));
+
+    xsan_replica_chain_write_resp_payload_t resp;
+    xsan_error_t statuses[XSAN_REPLICA_CHAIN_MAX_HOPS];
+    xsan_error_t old_head[2] = { XSAN_OK, XSAN_OK };
+    xsan_error_t new_head[1] = { XSAN_OK };
+
+    // The old head did get the first copy after all; its late ack must not count for the new head.
+    _make_ack(&resp, &g_hops[0], 2, old_head);
+    CU_ASSERT_EQUAL(xsan_replica_chain_ack_statuses(&resp, &g_hops[1].node_id, 1, statuses), XSAN_ERROR_REPLICA_NOT_FOUND);
+
+    _make_ack(&resp, &g_hops[1], 1, new_head);
+    CU_ASSERT_EQUAL(xsan_replica_chain_ack_statuses(&resp, &g_hops[1].node_id, 1, statuses), XSAN_OK);
+    CU_ASSERT_EQUAL(statuses[0], XSAN_OK);
+}
+
+int main(void) {
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry()) {
+        return CU_get_error();
+    }
+
+    pSuite = CU_add_suite("Replica_Chain_Suite", suite_chain_init, suite_chain_clean);
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    if ((NULL == CU_add_test(pSuite, "test_chain_payloads_keep_fanout_layout", test_chain_payloads_keep_fanout_layout)) ||
+        (NULL == CU_add_test(pSuite, "test_chain_req_init_from_head", test_chain_req_init_from_head)) ||
+        (NULL == CU_add_test(pSuite, "test_chain_req_shift_drops_first_hop", test_chain_req_shift_drops_first_hop)) ||
+        (NULL == CU_add_test(pSuite, "test_chain_req_hops_valid_rejects_bad_hops", test_chain_req_hops_valid_rejects_bad_hops)) ||
+        (NULL == CU_add_test(pSuite, "test_chain_ack_statuses_full", test_chain_ack_statuses_full)) ||
+        (NULL == CU_add_test(pSuite, "test_chain_ack_statuses_short_ack_fails_missing_hops", test_chain_ack_statuses_short_ack_fails_missing_hops)) ||
+        (NULL == CU_add_test(pSuite, "test_chain_ack_statuses_long_ack_is_clamped", test_chain_ack_statuses_long_ack_is_clamped)) ||
+        (NULL == CU_add_test(pSuite, "test_chain_ack_statuses_rejects_bad_acks", test_chain_ack_statuses_rejects_bad_acks)) ||
+        (NULL == CU_add_test(pSuite, "test_chain_head_failure_reform", test_chain_head_failure_reform))
+       ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+
+    int failures = CU_get_number_of_failures();
+    CU_cleanup_registry();
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,530 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "CUnit/Basic.h"
+
+#include "xsan_replica_write_batch.h"
+#include "xsan_protocol.h"
+#include "xsan_node_comm.h"
+#include "xsan_txn.h"
+#include "xsan_error.h"
+#include "spdk/thread.h"
+
+#define TEST_PEER_IP "10.0.0.2"
+#define TEST_PEER_PORT 7000
+#define TEST_OTHER_PEER_IP "10.0.0.3"
+
+// --- Node comm stand-ins ---
+// The batcher only needs a connection lookup, connect and send; these record what it asks for
+// so each test can inspect the batches and decide when sends and connects complete.
+
+typedef struct {
+    xsan_message_t *msg;
+    xsan_node_send_cb_t cb;
+    void *cb_arg;
+} test_sent_msg_t;
+
+static struct spdk_sock *g_active_sock;     // Returned by xsan_node_comm_get_active_connection
+static int g_connect_calls;
+static xsan_node_connect_cb_t g_connect_cb;
+static void *g_connect_cb_arg;
+static xsan_error_t g_connect_rc;
+static xsan_error_t g_send_rc;
+static test_sent_msg_t g_sent[16];
+static int g_num_sent;
+
+struct spdk_sock *xsan_node_comm_get_active_connection(const char *target_ip, uint16_t target_port) {
+    (void)target_ip;
+    (void)target_port;
+    return g_active_sock;
+}
+
+xsan_error_t xsan_node_comm_connect(const char *target_ip, uint16_t target_port,
+                                    xsan_node_connect_cb_t connect_cb, void *cb_arg) {
+    (void)target_ip;
+    (void)target_port;
+    g_connect_calls++;
+    if (g_connect_rc != XSAN_OK) return g_connect_rc;
+    g_connect_cb = connect_cb;
+    g_connect_cb_arg = cb_arg;
+    return XSAN_OK;
+}
+
+xsan_error_t xsan_node_comm_send_msg(struct spdk_sock *sock, xsan_message_t *msg,
+                                     xsan_node_send_cb_t send_cb, void *cb_arg) {
+    CU_ASSERT_PTR_EQUAL(sock, g_active_sock);
+    if (g_send_rc != XSAN_OK) return g_send_rc;
+    if (g_num_sent >= (int)(sizeof(g_sent) / sizeof(g_sent[0]))) return XSAN_ERROR_BUSY;
+    g_sent[g_num_sent].msg = msg;
+    g_sent[g_num_sent].cb = send_cb;
+    g_sent[g_num_sent].cb_arg = cb_arg;
+    g_num_sent++;
+    return XSAN_OK;
+}
+
+// Completes every recorded send with status, as the connection's flush would.
+static void _complete_sends(int status) {
+    int n = g_num_sent;
+    g_num_sent = 0;
+    for (int i = 0; i < n; ++i) {
+        g_sent[i].cb(status, g_sent[i].cb_arg);
+    }
+}
+
+// --- Per-write send completions ---
+
+typedef struct {
+    int calls;
+    int status;
+} test_write_done_t;
+
+static void _write_sent_cb(int status, void *cb_arg) {
+    test_write_done_t *d = (test_write_done_t *)cb_arg;
+    d->calls++;
+    d->status = status;
+}
+
+static struct spdk_thread *g_thread;
+static struct spdk_thread *g_other_thread;   // A second reactor with its own batching state
+static xsan_volume_id_t g_volume_id;
+
+static void _reset_comm(void) {
+    g_active_sock = (struct spdk_sock *)0x1;
+    g_connect_calls = 0;
+    g_connect_cb = NULL;
+    g_connect_cb_arg = NULL;
+    g_connect_rc = XSAN_OK;
+    g_send_rc = XSAN_OK;
+    g_num_sent = 0;
+}
+
+static xsan_replica_write_batcher_t *_new_batcher(uint32_t window_us, uint32_t max_extents, uint32_t max_bytes) {
+    xsan_replica_write_batcher_opts_t opts;
+    xsan_replica_write_batcher_opts_init(&opts);
+    opts.window_us = window_us;
+    opts.max_extents = max_extents;
+    opts.max_bytes = max_bytes;
+    opts.max_extent_bytes = 0; // Capped at max_bytes
+    _reset_comm();
+    return xsan_replica_write_batcher_create(&opts);
+}
+
+static xsan_error_t _submit(xsan_replica_write_batcher_t *b, const char *ip, uint64_t tid, uint32_t len,
+                            unsigned char fill, test_write_done_t *done) {
+    unsigned char data[8192];
+    memset(data, fill, len);
+    return xsan_replica_write_batcher_submit(b, ip, TEST_PEER_PORT, tid, &g_volume_id, tid * 8, len / 512,
+                                             data, len, _write_sent_cb, done);
+}
+
+// Checks that a sent batch carries the given TIDs in order, each with data_len bytes of (tid & 0xff).
+static void _check_batch(const xsan_message_t *msg, const uint64_t *tids, uint32_t n, uint32_t data_len) {
+    CU_ASSERT_EQUAL(msg->header.type, XSAN_MSG_TYPE_REPLICA_WRITE_BATCH_REQ);
+    CU_ASSERT_EQUAL(msg->header.transaction_id, tids[0]); // Labelled with the first write's TID
+    CU_ASSERT_EQUAL(msg->header.payload_length,
+                    sizeof(xsan_replica_write_batch_req_payload_t) + n * (sizeof(xsan_replica_write_extent_t) + data_len));
+    xsan_replica_write_batch_req_payload_t req;
+    memcpy(&req, msg->payload, sizeof(req));
+    CU_ASSERT_EQUAL_FATAL(req.num_extents, n);
+    const unsigned char *ext_area = msg->payload + sizeof(req);
+    const unsigned char *data = ext_area + n * sizeof(xsan_replica_write_extent_t);
+    for (uint32_t i = 0; i < n; ++i) {
+        xsan_replica_write_extent_t ext;
+        memcpy(&ext, ext_area + i * sizeof(ext), sizeof(ext));
+        CU_ASSERT_EQUAL(ext.transaction_id, tids[i]);
+        CU_ASSERT_EQUAL(ext.block_lba_on_volume, tids[i] * 8);
+        CU_ASSERT_EQUAL(ext.data_len, data_len);
+        CU_ASSERT_EQUAL(memcmp(&ext.volume_id, &g_volume_id, sizeof(g_volume_id)), 0);
+        CU_ASSERT_TRUE(data[i * data_len] == (unsigned char)tids[i] && data[(i + 1) * data_len - 1] == (unsigned char)tids[i]);
+    }
+}
+
+int suite_batch_init(void) {
+    if (spdk_thread_lib_init(NULL, 0) != 0) return -1;
+    g_thread = spdk_thread_create("batch_test", NULL);
+    g_other_thread = spdk_thread_create("batch_test_other", NULL);
+    if (!g_thread || !g_other_thread) return -1;
+    // Batching state is per transaction shard, so both threads claim one, as reactors do on their first TID.
+    spdk_set_thread(g_other_thread);
+    xsan_txn_next_tid();
+    spdk_set_thread(g_thread);
+    xsan_txn_next_tid();
+    memset(&g_volume_id, 0xA5, sizeof(g_volume_id));
+    return 0;
+}
+
+static void _thread_stop(struct spdk_thread *thread) {
+    spdk_set_thread(thread);
+    spdk_thread_exit(thread);
+    while (!spdk_thread_is_exited(thread)) {
+        spdk_thread_poll(thread, 0, 0);
+    }
+    spdk_thread_destroy(thread);
+}
+
+int suite_batch_clean(void) {
+    _thread_stop(g_other_thread);
+    _thread_stop(g_thread);
+    spdk_set_thread(NULL);
+    spdk_thread_lib_fini();
+    return 0;
+}
+
+void test_batch_rejects_oversized_writes(void) {
+    xsan_replica_write_batcher_t *b = _new_batcher(1000, 8, 4096);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+    test_write_done_t done = { 0 };
+    CU_ASSERT_TRUE(xsan_replica_write_batcher_accepts(b, 4096));
+    CU_ASSERT_FALSE(xsan_replica_write_batcher_accepts(b, 4097));
+    CU_ASSERT_FALSE(xsan_replica_write_batcher_accepts(b, 0));
+    CU_ASSERT_EQUAL(_submit(b, TEST_PEER_IP, 1, 4608, 1, &done), XSAN_ERROR_INVALID_PARAM);
+    CU_ASSERT_EQUAL(done.calls, 0);
+    xsan_replica_write_batcher_destroy(b);
+}
+
+void test_batch_coalesces_until_flush(void) {
+    xsan_replica_write_batcher_t *b = _new_batcher(1000000, 8, 65536);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+    test_write_done_t done[3];
+    memset(done, 0, sizeof(done));
+    const uint64_t tids[] = { 11, 12, 13 };
+
+    for (int i = 0; i < 3; ++i) {
+        CU_ASSERT_EQUAL(_submit(b, TEST_PEER_IP, tids[i], 512, (unsigned char)tids[i], &done[i]), XSAN_OK);
+    }
+    CU_ASSERT_EQUAL(g_num_sent, 0); // Held open for more writes
+
+    xsan_replica_write_batcher_flush(b);
+    CU_ASSERT_EQUAL_FATAL(g_num_sent, 1);
+    _check_batch(g_sent[0].msg, tids, 3, 512);
+    CU_ASSERT_EQUAL(done[0].calls, 0); // Not complete until the socket takes the batch
+
+    _complete_sends(0);
+    for (int i = 0; i < 3; ++i) {
+        CU_ASSERT_EQUAL(done[i].calls, 1);
+        CU_ASSERT_EQUAL(done[i].status, 0);
+    }
+    xsan_replica_write_batcher_stats_t stats;
+    CU_ASSERT_EQUAL(xsan_replica_write_batcher_get_stats(b, &stats), XSAN_OK);
+    CU_ASSERT_EQUAL(stats.batches_sent, 1);
+    CU_ASSERT_EQUAL(stats.extents_sent, 3);
+    CU_ASSERT_EQUAL(stats.bytes_sent, 3 * 512);
+    xsan_replica_write_batcher_destroy(b);
+}
+
+void test_batch_seals_at_max_extents(void) {
+    xsan_replica_write_batcher_t *b = _new_batcher(1000000, 4, 65536);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+    test_write_done_t done[5];
+    memset(done, 0, sizeof(done));
+    const uint64_t tids[] = { 21, 22, 23, 24, 25 };
+
+    for (int i = 0; i < 5; ++i) {
+        CU_ASSERT_EQUAL(_submit(b, TEST_PEER_IP, tids[i], 1024, (unsigned char)tids[i], &done[i]), XSAN_OK);
+    }
+    CU_ASSERT_EQUAL_FATAL(g_num_sent, 1); // The fourth write filled the batch; the fifth opened a new one
+    _check_batch(g_sent[0].msg, tids, 4, 1024);
+    _complete_sends(0);
+
+    xsan_replica_write_batcher_flush(b);
+    CU_ASSERT_EQUAL_FATAL(g_num_sent, 1);
+    _check_batch(g_sent[0].msg, &tids[4], 1, 1024);
+    _complete_sends(0);
+
+    xsan_replica_write_batcher_stats_t stats;
+    xsan_replica_write_batcher_get_stats(b, &stats);
+    CU_ASSERT_EQUAL(stats.flushes_full, 1);
+    CU_ASSERT_EQUAL(stats.batches_sent, 2);
+    xsan_replica_write_batcher_destroy(b);
+}
+
+void test_batch_seals_before_exceeding_max_bytes(void) {
+    xsan_replica_write_batcher_t *b = _new_batcher(1000000, 32, 8192);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+    test_write_done_t done[3];
+    memset(done, 0, sizeof(done));
+    const uint64_t tids[] = { 31, 32, 33 };
+
+    // 3000 + 3000 fits; a third 3000-byte write would overflow, so the first two go out alone.
+    for (int i = 0; i < 3; ++i) {
+        CU_ASSERT_EQUAL(_submit(b, TEST_PEER_IP, tids[i], 3000, (unsigned char)tids[i], &done[i]), XSAN_OK);
+    }
+    CU_ASSERT_EQUAL_FATAL(g_num_sent, 1);
+    _check_batch(g_sent[0].msg, tids, 2, 3000);
+    _complete_sends(0);
+    CU_ASSERT_EQUAL(done[2].calls, 0);
+
+    xsan_replica_write_batcher_flush(b);
+    CU_ASSERT_EQUAL_FATAL(g_num_sent, 1);
+    _check_batch(g_sent[0].msg, &tids[2], 1, 3000);
+    _complete_sends(0);
+    CU_ASSERT_EQUAL(done[2].calls, 1);
+    xsan_replica_write_batcher_destroy(b);
+}
+
+void test_batch_keeps_peers_apart(void) {
+    xsan_replica_write_batcher_t *b = _new_batcher(1000000, 8, 65536);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+    test_write_done_t done[4];
+    memset(done, 0, sizeof(done));
+    const uint64_t tids_a[] = { 41, 43 };
+    const uint64_t tids_b[] = { 42, 44 };
+
+    CU_ASSERT_EQUAL(_submit(b, TEST_PEER_IP, 41, 512, 41, &done[0]), XSAN_OK);
+    CU_ASSERT_EQUAL(_submit(b, TEST_OTHER_PEER_IP, 42, 512, 42, &done[1]), XSAN_OK);
+    CU_ASSERT_EQUAL(_submit(b, TEST_PEER_IP, 43, 512, 43, &done[2]), XSAN_OK);
+    CU_ASSERT_EQUAL(_submit(b, TEST_OTHER_PEER_IP, 44, 512, 44, &done[3]), XSAN_OK);
+    xsan_replica_write_batcher_flush(b);
+    CU_ASSERT_EQUAL_FATAL(g_num_sent, 2);
+    bool first_is_a = g_sent[0].msg->header.transaction_id == 41;
+    _check_batch(g_sent[first_is_a ? 0 : 1].msg, tids_a, 2, 512);
+    _check_batch(g_sent[first_is_a ? 1 : 0].msg, tids_b, 2, 512);
+    _complete_sends(0);
+    xsan_replica_write_batcher_destroy(b);
+}
+
+void test_batch_window_expiry_sends(void) {
+    xsan_replica_write_batcher_t *b = _new_batcher(50, 8, 65536);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+    test_write_done_t done = { 0 };
+    const uint64_t tid = 51;
+
+    CU_ASSERT_EQUAL(_submit(b, TEST_PEER_IP, tid, 512, (unsigned char)tid, &done), XSAN_OK);
+    CU_ASSERT_EQUAL(g_num_sent, 0);
+    usleep(2000);
+    spdk_thread_poll(g_thread, 0, 0);
+    CU_ASSERT_EQUAL_FATAL(g_num_sent, 1);
+    _check_batch(g_sent[0].msg, &tid, 1, 512);
+    _complete_sends(0);
+    CU_ASSERT_EQUAL(done.calls, 1);
+
+    xsan_replica_write_batcher_stats_t stats;
+    xsan_replica_write_batcher_get_stats(b, &stats);
+    CU_ASSERT_EQUAL(stats.flushes_window, 1);
+    xsan_replica_write_batcher_destroy(b);
+}
+
+void test_batch_connects_then_sends(void) {
+    xsan_replica_write_batcher_t *b = _new_batcher(1000000, 8, 65536);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+    test_write_done_t done[2];
+    memset(done, 0, sizeof(done));
+    const uint64_t tids[] = { 61, 62 };
+    struct spdk_sock *sock = g_active_sock;
+
+    g_active_sock = NULL;
+    CU_ASSERT_EQUAL(_submit(b, TEST_PEER_IP, 61, 512, 61, &done[0]), XSAN_OK);
+    xsan_replica_write_batcher_flush(b);
+    CU_ASSERT_EQUAL(g_connect_calls, 1);
+    CU_ASSERT_EQUAL(g_num_sent, 0);
+
+    // A batch sealed while connecting waits behind the first instead of connecting again.
+    CU_ASSERT_EQUAL(_submit(b, TEST_PEER_IP, 62, 512, 62, &done[1]), XSAN_OK);
+    xsan_replica_write_batcher_flush(b);
+    CU_ASSERT_EQUAL(g_connect_calls, 1);
+
+    g_active_sock = sock;
+    g_connect_cb(sock, 0, g_connect_cb_arg);
+    CU_ASSERT_EQUAL_FATAL(g_num_sent, 2);
+    _check_batch(g_sent[0].msg, &tids[0], 1, 512); // Sealed order is kept
+    _check_batch(g_sent[1].msg, &tids[1], 1, 512);
+    _complete_sends(0);
+    CU_ASSERT_EQUAL(done[0].calls, 1);
+    CU_ASSERT_EQUAL(done[1].calls, 1);
+    xsan_replica_write_batcher_destroy(b);
+}
+
+void test_batch_connect_failure_fails_writes(void) {
+    xsan_replica_write_batcher_t *b = _new_batcher(1000000, 8, 65536);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+    test_write_done_t async_done = { 0 }, sync_done = { 0 };
+
+    g_active_sock = NULL;
+    CU_ASSERT_EQUAL(_submit(b, TEST_PEER_IP, 71, 512, 71, &async_done), XSAN_OK);
+    xsan_replica_write_batcher_flush(b);
+    g_connect_cb(NULL, -ECONNREFUSED, g_connect_cb_arg);
+    CU_ASSERT_EQUAL(async_done.calls, 1);
+    CU_ASSERT_EQUAL(async_done.status, -ECONNREFUSED);
+
+    // A connect that fails immediately never calls back; the batcher fails the writes itself, once.
+    g_connect_rc = XSAN_ERROR_NETWORK;
+    CU_ASSERT_EQUAL(_submit(b, TEST_PEER_IP, 72, 512, 72, &sync_done), XSAN_OK);
+    xsan_replica_write_batcher_flush(b);
+    CU_ASSERT_EQUAL(g_connect_calls, 2);
+    CU_ASSERT_EQUAL(sync_done.calls, 1);
+    CU_ASSERT_EQUAL(sync_done.status, -ENOTCONN);
+
+    xsan_replica_write_batcher_stats_t stats;
+    xsan_replica_write_batcher_get_stats(b, &stats);
+    CU_ASSERT_EQUAL(stats.send_failures, 2);
+    CU_ASSERT_EQUAL(stats.batches_sent, 0);
+    xsan_replica_write_batcher_destroy(b);
+}
+
+void test_batch_busy_connection_retries(void) {
+    xsan_replica_write_batcher_t *b = _new_batcher(1000000, 8, 65536);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+    test_write_done_t done = { 0 };
+    const uint64_t tid = 81;
+
+    g_send_rc = XSAN_ERROR_BUSY;
+    CU_ASSERT_EQUAL(_submit(b, TEST_PEER_IP, tid, 512, (unsigned char)tid, &done), XSAN_OK);
+    xsan_replica_write_batcher_flush(b);
+    CU_ASSERT_EQUAL(g_num_sent, 0);
+    CU_ASSERT_EQUAL(done.calls, 0); // Requeued, not failed
+
+    g_send_rc = XSAN_OK;
+    xsan_replica_write_batcher_flush(b);
+    CU_ASSERT_EQUAL_FATAL(g_num_sent, 1);
+    _check_batch(g_sent[0].msg, &tid, 1, 512);
+    _complete_sends(0);
+    CU_ASSERT_EQUAL(done.calls, 1);
+    CU_ASSERT_EQUAL(done.status, 0);
+    xsan_replica_write_batcher_destroy(b);
+}
+
+void test_batch_requires_owned_shard(void) {
+    xsan_replica_write_batcher_t *b = _new_batcher(1000000, 8, 65536);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+    test_write_done_t done = { 0 };
+
+    // Threads without a transaction shard have no reactor to batch on; their writes go out unbatched.
+    spdk_set_thread(NULL);
+    CU_ASSERT_FALSE(xsan_replica_write_batcher_accepts(b, 512));
+    CU_ASSERT_EQUAL(_submit(b, TEST_PEER_IP, 101, 512, 101, &done), XSAN_ERROR_INVALID_PARAM);
+    spdk_set_thread(g_thread);
+    CU_ASSERT_TRUE(xsan_replica_write_batcher_accepts(b, 512));
+    CU_ASSERT_EQUAL(done.calls, 0);
+    xsan_replica_write_batcher_destroy(b);
+}
+
+void test_batch_reactors_batch_separately(void) {
+    xsan_replica_write_batcher_t *b = _new_batcher(1000000, 8, 65536);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+    test_write_done_t done[3];
+    memset(done, 0, sizeof(done));
+    const uint64_t tids_here[] = { 111, 113 };
+
+    CU_ASSERT_EQUAL(_submit(b, TEST_PEER_IP, 111, 512, 111, &done[0]), XSAN_OK);
+    spdk_set_thread(g_other_thread);
+    CU_ASSERT_EQUAL(_submit(b, TEST_PEER_IP, 112, 512, 112, &done[1]), XSAN_OK);
+    spdk_set_thread(g_thread);
+    CU_ASSERT_EQUAL(_submit(b, TEST_PEER_IP, 113, 512, 113, &done[2]), XSAN_OK);
+
+    // Flushing one reactor sends only its own writes, even to the same peer.
+    xsan_replica_write_batcher_flush(b);
+    CU_ASSERT_EQUAL_FATAL(g_num_sent, 1);
+    _check_batch(g_sent[0].msg, tids_here, 2, 512);
+    _complete_sends(0);
+    CU_ASSERT_EQUAL(done[1].calls, 0);
+
+    // The other reactor's window poller is stopped, and its write cancelled, on that reactor.
+    xsan_replica_write_batcher_destroy(b);
+    CU_ASSERT_EQUAL(done[1].calls, 0);
+    spdk_thread_poll(g_other_thread, 0, 0);
+    CU_ASSERT_EQUAL(done[1].calls, 1);
+    CU_ASSERT_EQUAL(done[1].status, -ECANCELED);
+}
+
+void test_batch_reuses_payload_buffers(void) {
+    xsan_replica_write_batcher_t *b = _new_batcher(1000000, 2, 65536);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+    test_write_done_t done[4];
+    memset(done, 0, sizeof(done));
+
+    CU_ASSERT_EQUAL(_submit(b, TEST_PEER_IP, 121, 512, 121, &done[0]), XSAN_OK);
+    CU_ASSERT_EQUAL(_submit(b, TEST_PEER_IP, 122, 512, 122, &done[1]), XSAN_OK);
+    CU_ASSERT_EQUAL_FATAL(g_num_sent, 1);
+    const unsigned char *first_payload = g_sent[0].msg->payload;
+    _complete_sends(0);
+
+    // Once sent, the batch's buffer is handed to the next batch instead of being freed.
+    const uint64_t tids[] = { 123, 124 };
+    CU_ASSERT_EQUAL(_submit(b, TEST_PEER_IP, 123, 512, 123, &done[2]), XSAN_OK);
+    CU_ASSERT_EQUAL(_submit(b, TEST_PEER_IP, 124, 512, 124, &done[3]), XSAN_OK);
+    CU_ASSERT_EQUAL_FATAL(g_num_sent, 1);
+    CU_ASSERT_PTR_EQUAL(g_sent[0].msg->payload, first_payload);
+    _check_batch(g_sent[0].msg, tids, 2, 512);
+    _complete_sends(0);
+    xsan_replica_write_batcher_destroy(b);
+}
+
+void test_batch_destroy_cancels_queued_writes(void) {
+    xsan_replica_write_batcher_t *b = _new_batcher(1000000, 8, 65536);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+    test_write_done_t open_done = { 0 }, sealed_done = { 0 };
+
+    g_send_rc = XSAN_ERROR_BUSY;
+    CU_ASSERT_EQUAL(_submit(b, TEST_PEER_IP, 91, 512, 91, &sealed_done), XSAN_OK);
+    xsan_replica_write_batcher_flush(b);
+    CU_ASSERT_EQUAL(_submit(b, TEST_PEER_IP, 92, 512, 92, &open_done), XSAN_OK);
+
+    xsan_replica_write_batcher_destroy(b);
+    CU_ASSERT_EQUAL(sealed_done.calls, 1);
+    CU_ASSERT_EQUAL(sealed_done.status, -ECANCELED);
+    CU_ASSERT_EQUAL(open_done.calls, 1);
+    CU_ASSERT_EQUAL(open_done.status, -ECANCELED);
+}
+
+void test_batch_destroy_waits_for_sends_in_flight(void) {
+    xsan_replica_write_batcher_t *b = _new_batcher(1000000, 8, 65536);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+    test_write_done_t done = { 0 };
+    const uint64_t tid = 131;
+
+    CU_ASSERT_EQUAL(_submit(b, TEST_PEER_IP, tid, 512, (unsigned char)tid, &done), XSAN_OK);
+    xsan_replica_write_batcher_flush(b);
+    CU_ASSERT_EQUAL_FATAL(g_num_sent, 1);
+
+    // A batch already on the connection is not cancelled; its send completes after destroy.
+    xsan_replica_write_batcher_destroy(b);
+    CU_ASSERT_EQUAL(done.calls, 0);
+    _check_batch(g_sent[0].msg, &tid, 1, 512);
+    _complete_sends(0);
+    CU_ASSERT_EQUAL(done.calls, 1);
+    CU_ASSERT_EQUAL(done.status, 0);
+}
+
+int main(void) {
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry()) {
+        return CU_get_error();
+    }
+
+    pSuite = CU_add_suite("Replica_Write_Batch_Suite", suite_batch_init, suite_batch_clean);
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    if ((NULL == CU_add_test(pSuite, "test_batch_rejects_oversized_writes", test_batch_rejects_oversized_writes)) ||
+        (NULL == CU_add_test(pSuite, "test_batch_coalesces_until_flush", test_batch_coalesces_until_flush)) ||
+        (NULL == CU_add_test(pSuite, "test_batch_seals_at_max_extents", test_batch_seals_at_max_extents)) ||
+        (NULL == CU_add_test(pSuite, "test_batch_seals_before_exceeding_max_bytes", test_batch_seals_before_exceeding_max_bytes)) ||
+        (NULL == CU_add_test(pSuite, "test_batch_keeps_peers_apart", test_batch_keeps_peers_apart)) ||
+        (NULL == CU_add_test(pSuite, "test_batch_window_expiry_sends", test_batch_window_expiry_sends)) ||
+        (NULL == CU_add_test(pSuite, "test_batch_connects_then_sends", test_batch_connects_then_sends)) ||
+        (NULL == CU_add_test(pSuite, "test_batch_connect_failure_fails_writes", test_batch_connect_failure_fails_writes)) ||
+        (NULL == CU_add_test(pSuite, "test_batch_busy_connection_retries", test_batch_busy_connection_retries)) ||
+        (NULL == CU_add_test(pSuite, "test_batch_requires_owned_shard", test_batch_requires_owned_shard)) ||
+        (NULL == CU_add_test(pSuite, "test_batch_reactors_batch_separately", test_batch_reactors_batch_separately)) ||
+        (NULL == CU_add_test(pSuite, "test_batch_reuses_payload_buffers", test_batch_reuses_payload_buffers)) ||
+        (NULL == CU_add_test(pSuite, "test_batch_destroy_cancels_queued_writes", test_batch_destroy_cancels_queued_writes)) ||
+        (NULL == CU_add_test(pSuite, "test_batch_destroy_waits_for_sends_in_flight", test_batch_destroy_waits_for_sends_in_flight))
+       ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+
+    int failures = CU_get_number_of_failures();
+    CU_cleanup_registry();
+
+    return failures > 0 ? 1 : 0;
+}
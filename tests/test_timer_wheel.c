@@ -0,0 +1,244 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "CUnit/Basic.h"
+
+#include "xsan_timer_wheel.h"
+#include "xsan_error.h"
+
+#define TEST_TICK_US 1000ULL
+#define TEST_ORIGIN_US 5000000ULL
+
+// Tick the wheel is being advanced to; expiry callbacks record it.
+static uint64_t g_now_tick;
+
+typedef struct {
+    xsan_timer_t timer;
+    uint64_t fired_tick;
+    int fire_count;
+    xsan_timer_wheel_t *wheel;
+    xsan_timer_t *cancel_on_fire;   // Cancelled from the callback, if set
+    uint64_t rearm_us;              // Re-armed from the callback while fire_count < rearm_times
+    int rearm_times;
+} test_timer_t;
+
+static void _on_expire(xsan_timer_t *timer, void *cb_arg) {
+    test_timer_t *t = (test_timer_t *)cb_arg;
+    CU_ASSERT_PTR_EQUAL(timer, &t->timer);
+    CU_ASSERT_FALSE(xsan_timer_is_armed(timer)); // Disarmed before the callback runs
+    t->fired_tick = g_now_tick;
+    t->fire_count++;
+    if (t->cancel_on_fire) {
+        xsan_timer_wheel_cancel(t->wheel, t->cancel_on_fire);
+    }
+    if (t->fire_count < t->rearm_times) {
+        xsan_timer_wheel_arm(t->wheel, timer, t->rearm_us);
+    }
+}
+
+static void _test_timer_init(test_timer_t *t, xsan_timer_wheel_t *wheel) {
+    memset(t, 0, sizeof(*t));
+    t->wheel = wheel;
+    xsan_timer_init(&t->timer, _on_expire, t);
+}
+
+// Advances one tick at a time so every expiry is attributed to its exact tick.
+static uint32_t _advance_to_tick(xsan_timer_wheel_t *wheel, uint64_t tick) {
+    uint32_t fired = 0;
+    while (g_now_tick < tick) {
+        g_now_tick++;
+        fired += xsan_timer_wheel_advance(wheel, TEST_ORIGIN_US + g_now_tick * TEST_TICK_US);
+    }
+    return fired;
+}
+
+static xsan_timer_wheel_t *_new_wheel(void) {
+    g_now_tick = 0;
+    return xsan_timer_wheel_create((uint32_t)TEST_TICK_US, TEST_ORIGIN_US);
+}
+
+void test_timer_wheel_invalid_params(void) {
+    CU_ASSERT_PTR_NULL(xsan_timer_wheel_create(0, 0));
+    xsan_timer_wheel_t *wheel = _new_wheel();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(wheel);
+    xsan_timer_t timer;
+    xsan_timer_init(&timer, NULL, NULL);
+    CU_ASSERT_EQUAL(xsan_timer_wheel_arm(wheel, &timer, 1000), XSAN_ERROR_INVALID_PARAM);
+    CU_ASSERT_EQUAL(xsan_timer_wheel_arm(NULL, &timer, 1000), XSAN_ERROR_INVALID_PARAM);
+    CU_ASSERT_FALSE(xsan_timer_wheel_cancel(wheel, &timer));
+    CU_ASSERT_EQUAL(xsan_timer_wheel_advance(wheel, TEST_ORIGIN_US - 1), 0); // Before tick 0
+    xsan_timer_wheel_destroy(wheel);
+}
+
+void test_timer_wheel_rounds_up_to_whole_ticks(void) {
+    xsan_timer_wheel_t *wheel = _new_wheel();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(wheel);
+    test_timer_t zero, partial, exact;
+    _test_timer_init(&zero, wheel);
+    _test_timer_init(&partial, wheel);
+    _test_timer_init(&exact, wheel);
+
+    CU_ASSERT_EQUAL(xsan_timer_wheel_arm(wheel, &zero.timer, 0), XSAN_OK);
+    CU_ASSERT_EQUAL(xsan_timer_wheel_arm(wheel, &partial.timer, TEST_TICK_US + 1), XSAN_OK);
+    CU_ASSERT_EQUAL(xsan_timer_wheel_arm(wheel, &exact.timer, 3 * TEST_TICK_US), XSAN_OK);
+    CU_ASSERT_EQUAL(xsan_timer_wheel_count(wheel), 3);
+
+    CU_ASSERT_EQUAL(_advance_to_tick(wheel, 3), 3);
+    CU_ASSERT_EQUAL(zero.fired_tick, 1);     // At least one tick
+    CU_ASSERT_EQUAL(partial.fired_tick, 2);  // Never early
+    CU_ASSERT_EQUAL(exact.fired_tick, 3);
+    CU_ASSERT_EQUAL(xsan_timer_wheel_count(wheel), 0);
+    xsan_timer_wheel_destroy(wheel);
+}
+
+void test_timer_wheel_cascades_every_level(void) {
+    xsan_timer_wheel_t *wheel = _new_wheel();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(wheel);
+    // One timer per level, each just past a level boundary, plus one exactly on a boundary.
+    const uint64_t ticks[] = { 63, 64, 65, 4095, 4097, 262143, 262145, 300000 };
+    const int n = (int)(sizeof(ticks) / sizeof(ticks[0]));
+    test_timer_t timers[sizeof(ticks) / sizeof(ticks[0])];
+    for (int i = 0; i < n; ++i) {
+        _test_timer_init(&timers[i], wheel);
+        CU_ASSERT_EQUAL(xsan_timer_wheel_arm(wheel, &timers[i].timer, ticks[i] * TEST_TICK_US), XSAN_OK);
+    }
+
+    CU_ASSERT_EQUAL(_advance_to_tick(wheel, 300000), (uint32_t)n);
+    for (int i = 0; i < n; ++i) {
+        CU_ASSERT_EQUAL(timers[i].fire_count, 1);
+        CU_ASSERT_EQUAL(timers[i].fired_tick, ticks[i]);
+    }
+    xsan_timer_wheel_destroy(wheel);
+}
+
+void test_timer_wheel_cascade_after_offset_start(void) {
+    xsan_timer_wheel_t *wheel = _new_wheel();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(wheel);
+    test_timer_t keepalive, t;
+    _test_timer_init(&keepalive, wheel);
+    _test_timer_init(&t, wheel);
+    // Keep the wheel busy so it walks every tick instead of skipping idle ones.
+    xsan_timer_wheel_arm(wheel, &keepalive.timer, 10000 * TEST_TICK_US);
+
+    // Armed off a level boundary, the timer's level-1 slot is not aligned with its expiry.
+    _advance_to_tick(wheel, 37);
+    CU_ASSERT_EQUAL(xsan_timer_wheel_arm(wheel, &t.timer, 100 * TEST_TICK_US), XSAN_OK);
+    _advance_to_tick(wheel, 136);
+    CU_ASSERT_EQUAL(t.fire_count, 0);
+    _advance_to_tick(wheel, 137);
+    CU_ASSERT_EQUAL(t.fire_count, 1);
+    CU_ASSERT_EQUAL(t.fired_tick, 137);
+
+    xsan_timer_wheel_cancel(wheel, &keepalive.timer);
+    xsan_timer_wheel_destroy(wheel);
+}
+
+void test_timer_wheel_cancel_and_rearm(void) {
+    xsan_timer_wheel_t *wheel = _new_wheel();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(wheel);
+    test_timer_t a, b;
+    _test_timer_init(&a, wheel);
+    _test_timer_init(&b, wheel);
+
+    xsan_timer_wheel_arm(wheel, &a.timer, 10 * TEST_TICK_US);
+    xsan_timer_wheel_arm(wheel, &b.timer, 200 * TEST_TICK_US);
+    CU_ASSERT_TRUE(xsan_timer_is_armed(&a.timer));
+    CU_ASSERT_TRUE(xsan_timer_wheel_cancel(wheel, &a.timer));
+    CU_ASSERT_FALSE(xsan_timer_wheel_cancel(wheel, &a.timer));
+    CU_ASSERT_FALSE(xsan_timer_is_armed(&a.timer));
+    CU_ASSERT_EQUAL(xsan_timer_wheel_count(wheel), 1);
+
+    // Re-arming an armed timer moves it instead of adding a second entry.
+    xsan_timer_wheel_arm(wheel, &b.timer, 5 * TEST_TICK_US);
+    CU_ASSERT_EQUAL(xsan_timer_wheel_count(wheel), 1);
+    CU_ASSERT_EQUAL(_advance_to_tick(wheel, 300), 1);
+    CU_ASSERT_EQUAL(a.fire_count, 0);
+    CU_ASSERT_EQUAL(b.fire_count, 1);
+    CU_ASSERT_EQUAL(b.fired_tick, 5);
+    xsan_timer_wheel_destroy(wheel);
+}
+
+void test_timer_wheel_callbacks_may_modify_wheel(void) {
+    xsan_timer_wheel_t *wheel = _new_wheel();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(wheel);
+    test_timer_t periodic, killer, victim;
+    _test_timer_init(&periodic, wheel);
+    _test_timer_init(&killer, wheel);
+    _test_timer_init(&victim, wheel);
+
+    // A periodic timer re-arms itself from its callback.
+    periodic.rearm_us = 70 * TEST_TICK_US;
+    periodic.rearm_times = 3;
+    xsan_timer_wheel_arm(wheel, &periodic.timer, 70 * TEST_TICK_US);
+    // Two timers in one slot: whichever fires first cancels the other.
+    killer.cancel_on_fire = &victim.timer;
+    victim.cancel_on_fire = &killer.timer;
+    xsan_timer_wheel_arm(wheel, &killer.timer, 20 * TEST_TICK_US);
+    xsan_timer_wheel_arm(wheel, &victim.timer, 20 * TEST_TICK_US);
+
+    CU_ASSERT_EQUAL(_advance_to_tick(wheel, 1000), 4);
+    CU_ASSERT_EQUAL(periodic.fire_count, 3);
+    CU_ASSERT_EQUAL(periodic.fired_tick, 210);
+    CU_ASSERT_EQUAL(killer.fire_count + victim.fire_count, 1);
+    CU_ASSERT_EQUAL(xsan_timer_wheel_count(wheel), 0);
+    xsan_timer_wheel_destroy(wheel);
+}
+
+void test_timer_wheel_idle_skip_and_clamp(void) {
+    xsan_timer_wheel_t *wheel = _new_wheel();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(wheel);
+    test_timer_t t, far;
+    _test_timer_init(&t, wheel);
+    _test_timer_init(&far, wheel);
+
+    // An idle wheel jumps straight to the current time; new timers count from there.
+    g_now_tick = 1000000;
+    CU_ASSERT_EQUAL(xsan_timer_wheel_advance(wheel, TEST_ORIGIN_US + g_now_tick * TEST_TICK_US), 0);
+    xsan_timer_wheel_arm(wheel, &t.timer, 2 * TEST_TICK_US);
+    CU_ASSERT_EQUAL(_advance_to_tick(wheel, 1000001), 0);
+    CU_ASSERT_EQUAL(_advance_to_tick(wheel, 1000002), 1);
+    CU_ASSERT_EQUAL(t.fired_tick, 1000002);
+
+    // Timeouts beyond the wheel's range are clamped, not wrapped around to fire early.
+    xsan_timer_wheel_arm(wheel, &far.timer, UINT64_MAX);
+    CU_ASSERT_EQUAL(far.timer.expires_tick, 1000002 + XSAN_TIMER_WHEEL_MAX_TICKS);
+    CU_ASSERT_EQUAL(_advance_to_tick(wheel, 1000002 + 300000), 0);
+    CU_ASSERT_TRUE(xsan_timer_is_armed(&far.timer));
+    xsan_timer_wheel_cancel(wheel, &far.timer);
+    xsan_timer_wheel_destroy(wheel);
+}
+
+int main(void) {
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry()) {
+        return CU_get_error();
+    }
+
+    pSuite = CU_add_suite("Timer_Wheel_Suite", NULL, NULL);
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    if ((NULL == CU_add_test(pSuite, "test_timer_wheel_invalid_params", test_timer_wheel_invalid_params)) ||
+        (NULL == CU_add_test(pSuite, "test_timer_wheel_rounds_up_to_whole_ticks", test_timer_wheel_rounds_up_to_whole_ticks)) ||
+        (NULL == CU_add_test(pSuite, "test_timer_wheel_cascades_every_level", test_timer_wheel_cascades_every_level)) ||
+        (NULL == CU_add_test(pSuite, "test_timer_wheel_cascade_after_offset_start", test_timer_wheel_cascade_after_offset_start)) ||
+        (NULL == CU_add_test(pSuite, "test_timer_wheel_cancel_and_rearm", test_timer_wheel_cancel_and_rearm)) ||
+        (NULL == CU_add_test(pSuite, "test_timer_wheel_callbacks_may_modify_wheel", test_timer_wheel_callbacks_may_modify_wheel)) ||
+        (NULL == CU_add_test(pSuite, "test_timer_wheel_idle_skip_and_clamp", test_timer_wheel_idle_skip_and_clamp))
+       ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+
+    int failures = CU_get_number_of_failures();
+    CU_cleanup_registry();
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "CUnit/Basic.h"
+
+#include "xsan_txn.h"
+#include "xsan_error.h"
+#include "spdk/thread.h"
+
+#define TEST_TXN_EPOCH 0xBEEF
+
+// A transaction context as the volume manager keeps them: the key lives inside the value.
+typedef struct {
+    uint64_t tid;
+    int released;
+} test_txn_entry_t;
+
+static int g_fn_calls;
+static struct spdk_thread *g_fn_thread;
+
+static void _count_fn(void *arg) {
+    (void)arg;
+    g_fn_calls++;
+    g_fn_thread = spdk_get_thread();
+}
+
+static void _mark_released(void *value) {
+    ((test_txn_entry_t *)value)->released++;
+}
+
+static void _drain(struct spdk_thread *thread) {
+    struct spdk_thread *prev = spdk_get_thread();
+    spdk_set_thread(thread);
+    while (spdk_thread_poll(thread, 0, 0) > 0) {
+    }
+    spdk_set_thread(prev);
+}
+
+static void _destroy_thread(struct spdk_thread *thread) {
+    spdk_set_thread(thread);
+    spdk_thread_exit(thread);
+    while (!spdk_thread_is_exited(thread)) {
+        spdk_thread_poll(thread, 0, 0);
+    }
+    spdk_thread_destroy(thread);
+    spdk_set_thread(NULL);
+}
+
+int suite_txn_init(void) {
+    if (spdk_thread_lib_init(NULL, 0) != 0) return -1;
+    xsan_txn_init(TEST_TXN_EPOCH);
+    return 0;
+}
+
+int suite_txn_clean(void) {
+    spdk_thread_lib_fini();
+    return 0;
+}
+
+void test_txn_tid_encoding(void) {
+    uint64_t tid = ((uint64_t)0x1234 << XSAN_TXN_EPOCH_SHIFT) | ((uint64_t)0xAB << XSAN_TXN_SHARD_SHIFT) | 0x56789ULL;
+    CU_ASSERT_EQUAL(xsan_txn_tid_epoch(tid), 0x1234);
+    CU_ASSERT_EQUAL(xsan_txn_tid_shard(tid), 0xAB);
+    CU_ASSERT_EQUAL(xsan_txn_tid_seq(tid), 0x56789ULL);
+    CU_ASSERT_EQUAL(xsan_txn_tid_seq(XSAN_TXN_SEQ_MASK), XSAN_TXN_SEQ_MASK);
+    CU_ASSERT_EQUAL(xsan_txn_tid_shard(UINT64_MAX), XSAN_TXN_MAX_SHARDS - 1);
+}
+
+void test_txn_non_spdk_thread_uses_shared_shard(void) {
+    spdk_set_thread(NULL);
+    uint64_t t1 = xsan_txn_next_tid();
+    uint64_t t2 = xsan_txn_next_tid();
+    CU_ASSERT_NOT_EQUAL(t1, 0);
+    CU_ASSERT_EQUAL(xsan_txn_tid_epoch(t1), TEST_TXN_EPOCH);
+    CU_ASSERT_EQUAL(xsan_txn_tid_shard(t1), XSAN_TXN_SHARED_SHARD);
+    CU_ASSERT_EQUAL(xsan_txn_tid_shard(t2), XSAN_TXN_SHARED_SHARD);
+    CU_ASSERT_TRUE(xsan_txn_tid_seq(t2) > xsan_txn_tid_seq(t1));
+
+    uint32_t shard = 0;
+    CU_ASSERT_FALSE(xsan_txn_local_shard(&shard));
+    CU_ASSERT_TRUE(xsan_txn_is_owner(t1));
+
+    g_fn_calls = 0;
+    CU_ASSERT_EQUAL(xsan_txn_run_on_owner(t1, _count_fn, NULL), XSAN_OK);
+    CU_ASSERT_EQUAL(g_fn_calls, 1); // The shared shard runs inline
+
+    xsan_txn_table_t *table = xsan_txn_table_create(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(table);
+    test_txn_entry_t entry = { .tid = t1 };
+    CU_ASSERT_EQUAL(xsan_txn_table_insert(table, &entry.tid, &entry), XSAN_OK);
+    CU_ASSERT_PTR_EQUAL(xsan_txn_table_lookup(table, t1), &entry);
+    CU_ASSERT_PTR_NULL(xsan_txn_table_lookup(table, t2));
+    CU_ASSERT_EQUAL(xsan_txn_table_remove(table, t1, _mark_released), XSAN_OK);
+    CU_ASSERT_EQUAL(entry.released, 1);
+    CU_ASSERT_EQUAL(xsan_txn_table_remove(table, t1, _mark_released), XSAN_ERROR_NOT_FOUND);
+    xsan_txn_table_destroy(table);
+}
+
+void test_txn_spdk_threads_own_distinct_shards(void) {
+    struct spdk_thread *a = spdk_thread_create("txn_a", NULL);
+    struct spdk_thread *b = spdk_thread_create("txn_b", NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(a);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+
+    spdk_set_thread(a);
+    uint32_t shard_a = XSAN_TXN_MAX_SHARDS;
+    CU_ASSERT_FALSE(xsan_txn_local_shard(&shard_a)); // Not registered until its first TID
+    uint64_t tid_a = xsan_txn_next_tid();
+    CU_ASSERT_TRUE(xsan_txn_local_shard(&shard_a));
+    CU_ASSERT_EQUAL(xsan_txn_tid_shard(tid_a), shard_a);
+    CU_ASSERT_NOT_EQUAL(shard_a, XSAN_TXN_SHARED_SHARD);
+    CU_ASSERT_EQUAL(xsan_txn_tid_shard(xsan_txn_next_tid()), shard_a);
+    CU_ASSERT_TRUE(xsan_txn_is_owner(tid_a));
+
+    spdk_set_thread(b);
+    uint64_t tid_b = xsan_txn_next_tid();
+    uint32_t shard_b = xsan_txn_tid_shard(tid_b);
+    CU_ASSERT_NOT_EQUAL(shard_b, shard_a);
+    CU_ASSERT_NOT_EQUAL(shard_b, XSAN_TXN_SHARED_SHARD);
+    CU_ASSERT_TRUE(xsan_txn_is_owner(tid_b));
+    CU_ASSERT_FALSE(xsan_txn_is_owner(tid_a));
+
+    // Neither a non-SPDK thread nor another reactor owns an SPDK thread's shard.
+    spdk_set_thread(NULL);
+    CU_ASSERT_FALSE(xsan_txn_is_owner(tid_a));
+    CU_ASSERT_FALSE(xsan_txn_is_owner(tid_b));
+
+    _destroy_thread(a);
+    _destroy_thread(b);
+}
+
+void test_txn_unregistered_shard(void) {
+    spdk_set_thread(NULL);
+    // The highest owned shard is only registered once 255 SPDK threads have asked for TIDs.
+    uint64_t tid = ((uint64_t)TEST_TXN_EPOCH << XSAN_TXN_EPOCH_SHIFT) |
+                   ((uint64_t)(XSAN_TXN_SHARED_SHARD - 1) << XSAN_TXN_SHARD_SHIFT) | 1;
+    CU_ASSERT_FALSE(xsan_txn_is_owner(tid));
+    g_fn_calls = 0;
+    CU_ASSERT_EQUAL(xsan_txn_run_on_owner(tid, _count_fn, NULL), XSAN_ERROR_NOT_FOUND);
+    CU_ASSERT_EQUAL(g_fn_calls, 0);
+    CU_ASSERT_EQUAL(xsan_txn_run_on_owner(tid, NULL, NULL), XSAN_ERROR_INVALID_PARAM);
+}
+
+void test_txn_run_on_owner_posts_to_owner(void) {
+    struct spdk_thread *owner = spdk_thread_create("txn_owner", NULL);
+    struct spdk_thread *other = spdk_thread_create("txn_other", NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(owner);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(other);
+
+    spdk_set_thread(owner);
+    uint64_t tid = xsan_txn_next_tid();
+    g_fn_calls = 0;
+    CU_ASSERT_EQUAL(xsan_txn_run_on_owner(tid, _count_fn, NULL), XSAN_OK);
+    CU_ASSERT_EQUAL(g_fn_calls, 1); // Inline on the owner
+
+    spdk_set_thread(other);
+    g_fn_calls = 0;
+    g_fn_thread = NULL;
+    CU_ASSERT_EQUAL(xsan_txn_run_on_owner(tid, _count_fn, NULL), XSAN_OK);
+    CU_ASSERT_EQUAL(g_fn_calls, 0); // Posted, not run on the caller
+    _drain(other);
+    CU_ASSERT_EQUAL(g_fn_calls, 0);
+    _drain(owner);
+    CU_ASSERT_EQUAL(g_fn_calls, 1);
+    CU_ASSERT_PTR_EQUAL(g_fn_thread, owner);
+
+    _destroy_thread(owner);
+    _destroy_thread(other);
+}
+
+void test_txn_table_routes_to_owner(void) {
+    struct spdk_thread *owner = spdk_thread_create("txn_tbl_owner", NULL);
+    struct spdk_thread *other = spdk_thread_create("txn_tbl_other", NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(owner);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(other);
+    xsan_txn_table_t *table = xsan_txn_table_create(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(table);
+
+    spdk_set_thread(owner);
+    test_txn_entry_t entry = { .tid = xsan_txn_next_tid() };
+    CU_ASSERT_EQUAL(xsan_txn_table_insert(table, &entry.tid, &entry), XSAN_OK);
+
+    // Off the owner, lookups see nothing and inserts are refused.
+    spdk_set_thread(other);
+    test_txn_entry_t foreign = { .tid = entry.tid + 1 };
+    CU_ASSERT_EQUAL(xsan_txn_table_insert(table, &foreign.tid, &foreign), XSAN_ERROR_INVALID_PARAM);
+    CU_ASSERT_PTR_NULL(xsan_txn_table_lookup(table, entry.tid));
+
+    // A removal off the owner is posted and released there.
+    CU_ASSERT_EQUAL(xsan_txn_table_remove(table, entry.tid, _mark_released), XSAN_OK);
+    CU_ASSERT_EQUAL(entry.released, 0);
+    _drain(owner);
+    CU_ASSERT_EQUAL(entry.released, 1);
+    spdk_set_thread(owner);
+    CU_ASSERT_PTR_NULL(xsan_txn_table_lookup(table, entry.tid));
+
+    xsan_txn_table_destroy(table);
+    _destroy_thread(owner);
+    _destroy_thread(other);
+}
+
+void test_txn_destroy_releases_leftovers(void) {
+    xsan_txn_table_t *table = xsan_txn_table_create(_mark_released);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(table);
+    spdk_set_thread(NULL);
+    test_txn_entry_t e1 = { .tid = xsan_txn_next_tid() };
+    test_txn_entry_t e2 = { .tid = xsan_txn_next_tid() };
+    CU_ASSERT_EQUAL(xsan_txn_table_insert(table, &e1.tid, &e1), XSAN_OK);
+    CU_ASSERT_EQUAL(xsan_txn_table_insert(table, &e2.tid, &e2), XSAN_OK);
+    xsan_txn_table_destroy(table);
+    CU_ASSERT_EQUAL(e1.released, 1);
+    CU_ASSERT_EQUAL(e2.released, 1);
+}
+
+void test_txn_shard_exhaustion_never_aliases(void) {
+    static struct spdk_thread *threads[XSAN_TXN_MAX_SHARDS];
+    static uint32_t shards[XSAN_TXN_MAX_SHARDS];
+    bool seen[XSAN_TXN_MAX_SHARDS];
+    memset(seen, 0, sizeof(seen));
+
+    // Earlier tests registered some shards already; keep registering until one falls back.
+    int n = 0;
+    for (; n < XSAN_TXN_MAX_SHARDS; ++n) {
+        char name[32];
+        snprintf(name, sizeof(name), "txn_exh_%d", n);
+        threads[n] = spdk_thread_create(name, NULL);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(threads[n]);
+        spdk_set_thread(threads[n]);
+        shards[n] = xsan_txn_tid_shard(xsan_txn_next_tid());
+        if (shards[n] == XSAN_TXN_SHARED_SHARD) break;
+        CU_ASSERT_FALSE(seen[shards[n]]);
+        seen[shards[n]] = true;
+    }
+    CU_ASSERT_FATAL(n < XSAN_TXN_MAX_SHARDS);
+    CU_ASSERT_EQUAL(shards[n], XSAN_TXN_SHARED_SHARD);
+    CU_ASSERT_TRUE(seen[XSAN_TXN_SHARED_SHARD - 1]); // Every owned shard was handed out first
+
+    // The unregistered thread is not an owner of anything but the shared shard.
+    uint32_t shard = 0;
+    CU_ASSERT_FALSE(xsan_txn_local_shard(&shard));
+    uint64_t shared_tid = xsan_txn_next_tid();
+    CU_ASSERT_EQUAL(xsan_txn_tid_shard(shared_tid), XSAN_TXN_SHARED_SHARD);
+    CU_ASSERT_TRUE(xsan_txn_is_owner(shared_tid));
+
+    for (int i = 0; i <= n; ++i) {
+        _destroy_thread(threads[i]);
+    }
+}
+
+int main(void) {
+    CU_pSuite pSuite = NULL;
+
+    if (CUE_SUCCESS != CU_initialize_registry()) {
+        return CU_get_error();
+    }
+
+    pSuite = CU_add_suite("Txn_Suite", suite_txn_init, suite_txn_clean);
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    // The exhaustion test consumes every owned shard, so it runs last.
+    if ((NULL == CU_add_test(pSuite, "test_txn_tid_encoding", test_txn_tid_encoding)) ||
+        (NULL == CU_add_test(pSuite, "test_txn_non_spdk_thread_uses_shared_shard", test_txn_non_spdk_thread_uses_shared_shard)) ||
+        (NULL == CU_add_test(pSuite, "test_txn_spdk_threads_own_distinct_shards", test_txn_spdk_threads_own_distinct_shards)) ||
+        (NULL == CU_add_test(pSuite, "test_txn_unregistered_shard", test_txn_unregistered_shard)) ||
+        (NULL == CU_add_test(pSuite, "test_txn_run_on_owner_posts_to_owner", test_txn_run_on_owner_posts_to_owner)) ||
+        (NULL == CU_add_test(pSuite, "test_txn_table_routes_to_owner", test_txn_table_routes_to_owner)) ||
+        (NULL == CU_add_test(pSuite, "test_txn_destroy_releases_leftovers", test_txn_destroy_releases_leftovers)) ||
+        (NULL == CU_add_test(pSuite, "test_txn_shard_exhaustion_never_aliases", test_txn_shard_exhaustion_never_aliases))
+       ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+
+    int failures = CU_get_number_of_failures();
+    CU_cleanup_registry();
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,236 @@
+#!/bin/bash
+# XSAN 本地多节点集群脚本
+# 在一台机器上以独立进程启动 N 个 xsan_node，节点间通过 127.0.0.1 上的不同端口通信。
+# 每个节点有自己的工作目录 (元数据 RocksDB)、SPDK RPC socket、CPU 核与 malloc bdev，
+# 用于在单台 CI 机器上测试复制读写延迟以及节点宕机/重启 (故障切换、重建) 场景。
+#
+# 用法: tools/xsan_local_cluster.sh <命令> [参数]
+#   start N         生成配置并启动 N 个节点 (节点 0..N-1，均以 --serve 模式运行)
+#   e2e             在已启动的集群旁再启动一个节点运行内置 E2E 测试 (副本放在其他节点上)
+#   stop [i]        正常停止全部节点或节点 i (SIGTERM)
+#   kill i          强制杀死节点 i (SIGKILL)，模拟节点故障
+#   restart i       重新启动节点 i (保留其元数据)
+#   status          显示各节点状态与地址
+#   clean           停止全部节点并删除集群目录
+#
+# 环境变量:
+#   XSAN_NODE_BIN        xsan_node 可执行文件 (默认: build/src/main/xsan_node)
+#   XSAN_CLUSTER_DIR     集群工作目录 (默认: ./xsan_local_cluster)
+#   XSAN_BASE_PORT       节点通信端口起始值，节点 i 使用 BASE+i (默认: 7600)
+#   XSAN_NVMF_BASE_PORT  NVMe-oF 监听端口起始值 (默认: 4420)
+#   XSAN_MALLOC_MB       每个 malloc bdev 的大小 (默认: 256)
+#   XSAN_E2E_FTT         e2e 命令创建的测试卷的 FTT (默认: 1)
+
+set -e
+
+XSAN_NODE_BIN="${XSAN_NODE_BIN:-build/src/main/xsan_node}"
+CLUSTER_DIR="${XSAN_CLUSTER_DIR:-./xsan_local_cluster}"
+BASE_PORT="${XSAN_BASE_PORT:-7600}"
+NVMF_BASE_PORT="${XSAN_NVMF_BASE_PORT:-4420}"
+MALLOC_MB="${XSAN_MALLOC_MB:-256}"
+E2E_FTT="${XSAN_E2E_FTT:-1}"
+BLOCK_SIZE=4096
+
+# 颜色定义
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+RED='\033[0;31m'
+NC='\033[0m' # No Color
+
+log_info() {
+    echo -e "${GREEN}[INFO]${NC} $1"
+}
+
+log_warn() {
+    echo -e "${YELLOW}[WARN]${NC} $1"
+}
+
+log_error() {
+    echo -e "${RED}[ERROR]${NC} $1"
+}
+
+usage() {
+    sed -n '2,/^$/s/^# \{0,1\}//p' "$0"
+    exit 1
+}
+
+# 节点 i 的 UUID (node.id 必须是 UUID)
+node_uuid() {
+    printf "00000000-0000-4000-8000-%012x" "$(( $1 + 1 ))"
+}
+
+node_dir() {
+    echo "$CLUSTER_DIR/node-$1"
+}
+
+node_count() {
+    cat "$CLUSTER_DIR/nodes" 2>/dev/null || echo 0
+}
+
+node_pid() {
+    local pid_file
+    pid_file="$(node_dir "$1")/node.pid"
+    if [ -f "$pid_file" ]; then
+        cat "$pid_file"
+    fi
+}
+
+node_running() {
+    local pid
+    pid="$(node_pid "$1")"
+    [ -n "$pid" ] && kill -0 "$pid" 2>/dev/null
+}
+
+# cluster.seed_nodes: 全部节点 (包括 e2e 节点之外的每个 serve 节点)
+seed_nodes() {
+    local n=$1 seeds="" i
+    for ((i = 0; i < n; i++)); do
+        seeds="${seeds:+$seeds,}$(node_uuid "$i")@127.0.0.1:$((BASE_PORT + i))"
+    done
+    echo "$seeds"
+}
+
+write_node_config() {
+    local i=$1 seeds=$2 dir
+    mkdir -p "$(node_dir "$i")"
+    dir="$(cd "$(node_dir "$i")" && pwd)"
+    cat > "$dir/xsan_node.conf" <<EOF
+# 由 xsan_local_cluster.sh 生成
+node.id = $(node_uuid "$i")
+node.name = local-node-$i
+node.bind_address = 127.0.0.1
+node.port = $((BASE_PORT + i))
+node.data_dir = $dir
+node.log_file = $dir/xsan.log
+node.log_level = INFO
+nvmf.target_nqn = nqn.2024-01.org.xsan:local-node-$i
+nvmf.listen_port = $((NVMF_BASE_PORT + i))
+cluster.name = xsan-local
+cluster.seed_nodes = $seeds
+e2e_volume_ftt = $E2E_FTT
+EOF
+    local num_blocks=$((MALLOC_MB * 1024 * 1024 / BLOCK_SIZE))
+    cat > "$dir/spdk.json" <<EOF
+{
+  "subsystems": [
+    {
+      "subsystem": "bdev",
+      "config": [
+        { "method": "bdev_malloc_create", "params": { "name": "Malloc0", "num_blocks": $num_blocks, "block_size": $BLOCK_SIZE } },
+        { "method": "bdev_malloc_create", "params": { "name": "Malloc1", "num_blocks": $num_blocks, "block_size": $BLOCK_SIZE } }
+      ]
+    }
+  ]
+}
+EOF
+}
+
+# 启动节点 i; 第二个参数为 e2e 时运行内置 E2E 测试，否则以 --serve 模式运行
+launch_node() {
+    local i=$1 mode=--serve dir cores core
+    if [ "$2" = "e2e" ]; then
+        mode=""
+    fi
+    dir="$(cd "$(node_dir "$i")" && pwd)"
+    if node_running "$i"; then
+        log_warn "节点 $i 已在运行 (pid $(node_pid "$i"))"
+        return 0
+    fi
+    cores=$(nproc)
+    core=$((i % cores))
+    # $mode 不加引号: 为空时不传参数
+    # shellcheck disable=SC2086
+    "$XSAN_NODE_BIN" -d "$dir" -c "$dir/xsan_node.conf" -j "$dir/spdk.json" \
+        -m "0x$(printf '%x' $((1 << core)))" -r "$dir/spdk.sock" $mode \
+        > "$dir/node.log" 2>&1 &
+    echo $! > "$dir/node.pid"
+    log_info "节点 $i 已启动: pid $!, 通信 127.0.0.1:$((BASE_PORT + i)), NVMe-oF 127.0.0.1:$((NVMF_BASE_PORT + i)), 核 $core"
+}
+
+cmd_start() {
+    local n=$1 i
+    if [ -z "$n" ] || [ "$n" -lt 1 ]; then
+        usage
+    fi
+    if [ ! -x "$XSAN_NODE_BIN" ]; then
+        log_error "找不到 xsan_node: $XSAN_NODE_BIN (可通过 XSAN_NODE_BIN 指定)"
+        exit 1
+    fi
+    if [ "$(node_count)" -gt 0 ]; then
+        log_error "$CLUSTER_DIR 中已有集群，请先执行 clean"
+        exit 1
+    fi
+    mkdir -p "$CLUSTER_DIR"
+    echo "$n" > "$CLUSTER_DIR/nodes"
+    # e2e 节点 (索引 n) 也写入种子列表，使 serve 节点之间与 e2e 节点都互相可见
+    local seeds
+    seeds="$(seed_nodes $((n + 1)))"
+    for ((i = 0; i <= n; i++)); do
+        write_node_config "$i" "$seeds"
+    done
+    for ((i = 0; i < n; i++)); do
+        launch_node "$i"
+    done
+}
+
+cmd_e2e() {
+    local n
+    n="$(node_count)"
+    [ "$n" -gt 0 ] || { log_error "集群未启动"; exit 1; }
+    log_info "运行 E2E 测试 (FTT=$E2E_FTT)，日志: $(node_dir "$n")/node.log"
+    launch_node "$n" e2e
+    local pid
+    pid="$(node_pid "$n")"
+    wait "$pid" || { log_error "E2E 节点退出码非零"; exit 1; }
+}
+
+stop_node() {
+    local i=$1 sig=${2:-TERM} pid
+    pid="$(node_pid "$i")"
+    if ! node_running "$i"; then
+        return 0
+    fi
+    kill -"$sig" "$pid"
+    for _ in $(seq 1 50); do
+        kill -0 "$pid" 2>/dev/null || break
+        sleep 0.1
+    done
+    if kill -0 "$pid" 2>/dev/null; then
+        log_warn "节点 $i 未在 5 秒内退出，强制杀死"
+        kill -KILL "$pid"
+    fi
+    rm -f "$(node_dir "$i")/node.pid"
+    log_info "节点 $i 已停止 (SIG$sig)"
+}
+
+cmd_stop() {
+    local n i
+    n="$(node_count)"
+    if [ -n "$1" ]; then
+        stop_node "$1"
+        return
+    fi
+    for ((i = 0; i <= n; i++)); do
+        stop_node "$i"
+    done
+}
+
+cmd_status() {
+    local n i state
+    n="$(node_count)"
+    for ((i = 0; i < n; i++)); do
+        if node_running "$i"; then state="running (pid $(node_pid "$i"))"; else state="stopped"; fi
+        echo "node-$i $(node_uuid "$i") 127.0.0.1:$((BASE_PORT + i)) nvmf:$((NVMF_BASE_PORT + i)) $state"
+    done
+}
+
+case "$1" in
+    start)   cmd_start "$2" ;;
+    e2e)     cmd_e2e ;;
+    stop)    cmd_stop "$2" ;;
+    kill)    [ -n "$2" ] || usage; stop_node "$2" KILL ;;
+    restart) [ -n "$2" ] || usage; stop_node "$2"; launch_node "$2" ;;
+    status)  cmd_status ;;
+    clean)   cmd_stop; rm -rf "$CLUSTER_DIR"; log_info "已删除 $CLUSTER_DIR" ;;
+    *)       usage ;;
+esac